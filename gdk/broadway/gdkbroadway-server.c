@@ -16,6 +16,7 @@
 #include "gdkprivate.h"
 
 #include <gdk/gdktextureprivate.h>
+#include <gdk/gdktexturesaveoptionsprivate.h>
 
 #include <glib.h>
 #include <glib/gprintf.h>
@@ -627,12 +628,15 @@ gdk_broadway_server_upload_texture (GdkBroadwayServer *server,
 {
   guint32 id;
   BroadwayRequestUploadTexture msg;
+  GdkTextureSaveOptions options;
   GBytes *bytes;
   const guchar *data;
   gsize size;
   int fd;
 
-  bytes = gdk_texture_save_to_png_bytes (texture);
+  /* Textures are sent for every frame, so speed matters more than size */
+  gdk_texture_save_options_init (&options, GDK_TEXTURE_SAVE_PRESET_FAST);
+  bytes = gdk_texture_save_to_png_bytes_full (texture, &options);
   fd = open_shared_memory ();
   data = g_bytes_get_data (bytes, &size);
 
@@ -70,6 +70,7 @@
 #include <gdk/deprecated/gdkpixbuf.h>
 #include <gdk/gdkpopup.h>
 #include <gdk/gdkpopuplayout.h>
+#include <gdk/gdkprogressiveimage.h>
 #include <gdk/gdkrectangle.h>
 #include <gdk/gdkrgba.h>
 #include <gdk/gdkseat.h>
@@ -77,6 +78,8 @@
 #include <gdk/gdksurface.h>
 #include <gdk/gdktexture.h>
 #include <gdk/gdktexturedownloader.h>
+#include <gdk/gdktexturesaveoptions.h>
+#include <gdk/gdktextureloader.h>
 #include <gdk/gdktoplevel.h>
 #include <gdk/gdktoplevellayout.h>
 #include <gdk/gdktoplevelsize.h>
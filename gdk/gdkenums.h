@@ -543,4 +543,57 @@ typedef enum {
   GDK_MEMORY_N_FORMATS
 } GdkMemoryFormat;
 
+/**
+ * GdkTextureSavePreset:
+ * @GDK_TEXTURE_SAVE_PRESET_DEFAULT: The settings used by
+ *   [method@Gdk.Texture.save_to_png_bytes] and
+ *   [method@Gdk.Texture.save_to_tiff_bytes]
+ * @GDK_TEXTURE_SAVE_PRESET_FAST: Encode as fast as possible,
+ *   at the cost of larger files
+ * @GDK_TEXTURE_SAVE_PRESET_SMALL: Produce files that are as
+ *   small as possible, at the cost of encoding time
+ *
+ * Presets for the trade-off between encoding speed and file size
+ * when saving textures.
+ *
+ * All presets are lossless.
+ *
+ * Since: 4.18
+ */
+typedef enum {
+  GDK_TEXTURE_SAVE_PRESET_DEFAULT,
+  GDK_TEXTURE_SAVE_PRESET_FAST,
+  GDK_TEXTURE_SAVE_PRESET_SMALL
+} GdkTextureSavePreset;
+
+/**
+ * GdkPngFilter:
+ * @GDK_PNG_FILTER_DEFAULT: Use the filter that suits the preset
+ * @GDK_PNG_FILTER_NONE: Don't filter rows
+ * @GDK_PNG_FILTER_SUB: Predict each byte from the pixel to the left
+ * @GDK_PNG_FILTER_UP: Predict each byte from the pixel above
+ * @GDK_PNG_FILTER_AVERAGE: Predict each byte from the average of
+ *   the pixels to the left and above
+ * @GDK_PNG_FILTER_PAETH: Use the Paeth predictor
+ * @GDK_PNG_FILTER_ADAPTIVE: Try all filters and pick the best one
+ *   for every row
+ *
+ * The filter that is applied to rows before they are compressed
+ * when saving PNG files.
+ *
+ * Filters that look at fewer neighbours are faster. The adaptive
+ * filter usually produces the smallest files.
+ *
+ * Since: 4.18
+ */
+typedef enum {
+  GDK_PNG_FILTER_DEFAULT,
+  GDK_PNG_FILTER_NONE,
+  GDK_PNG_FILTER_SUB,
+  GDK_PNG_FILTER_UP,
+  GDK_PNG_FILTER_AVERAGE,
+  GDK_PNG_FILTER_PAETH,
+  GDK_PNG_FILTER_ADAPTIVE
+} GdkPngFilter;
+
 G_END_DECLS
@@ -23,6 +23,7 @@
 
 #include "gdkdmabuffourccprivate.h"
 #include "gdkcolorstateprivate.h"
+#include "gdkmemoryformatsimdprivate.h"
 #include "gdkparalleltaskprivate.h"
 #include "gtk/gtkcolorutilsprivate.h"
 #include "gdkprofilerprivate.h"
@@ -303,6 +304,36 @@ PREMULTIPLY_FUNC(r8g8b8a8_to_b8g8r8a8_premultiplied, 0, 1, 2, 3, 2, 1, 0, 3)
 PREMULTIPLY_FUNC(r8g8b8a8_to_a8r8g8b8_premultiplied, 0, 1, 2, 3, 1, 2, 3, 0)
 PREMULTIPLY_FUNC(r8g8b8a8_to_a8b8g8r8_premultiplied, 0, 1, 2, 3, 3, 2, 1, 0)
 
+#define UNPREMULTIPLY_FUNC(name, R1, G1, B1, A1, R2, G2, B2, A2) \
+static void \
+name (guchar *dest, \
+      const guchar *src, \
+      gsize n) \
+{ \
+  for (; n > 0; n--) \
+    { \
+      guchar a = src[A1]; \
+      if (a != 0) \
+        { \
+          dest[R2] = MIN (255, (src[R1] * 255 + a / 2) / a); \
+          dest[G2] = MIN (255, (src[G1] * 255 + a / 2) / a); \
+          dest[B2] = MIN (255, (src[B1] * 255 + a / 2) / a); \
+        } \
+      else \
+        { \
+          dest[R2] = src[R1]; \
+          dest[G2] = src[G1]; \
+          dest[B2] = src[B1]; \
+        } \
+      dest[A2] = a; \
+      dest += 4; \
+      src += 4; \
+    } \
+}
+
+UNPREMULTIPLY_FUNC(r8g8b8a8_premultiplied_to_r8g8b8a8, 0, 1, 2, 3, 0, 1, 2, 3)
+UNPREMULTIPLY_FUNC(r8g8b8a8_premultiplied_to_b8g8r8a8, 0, 1, 2, 3, 2, 1, 0, 3)
+
 #define ADD_ALPHA_FUNC(name, R1, G1, B1, R2, G2, B2, A2) \
 static void \
 name (guchar *dest, \
@@ -2040,6 +2071,12 @@ static FastConversionFunc
 get_fast_conversion_func (GdkMemoryFormat dest_format,
                           GdkMemoryFormat src_format)
 {
+  FastConversionFunc simd_func;
+
+  simd_func = gdk_memory_simd_get_conversion_func (dest_format, src_format);
+  if (simd_func)
+    return simd_func;
+
   if (src_format == GDK_MEMORY_R8G8B8A8 && dest_format == GDK_MEMORY_R8G8B8A8_PREMULTIPLIED)
     return r8g8b8a8_to_r8g8b8a8_premultiplied;
   else if (src_format == GDK_MEMORY_B8G8R8A8 && dest_format == GDK_MEMORY_R8G8B8A8_PREMULTIPLIED)
@@ -2082,6 +2119,49 @@ get_fast_conversion_func (GdkMemoryFormat dest_format,
     return r8g8b8_to_a8r8g8b8;
   else if (src_format == GDK_MEMORY_B8G8R8 && dest_format == GDK_MEMORY_A8R8G8B8)
     return r8g8b8_to_a8b8g8r8;
+  else if ((src_format == GDK_MEMORY_R8G8B8A8_PREMULTIPLIED && dest_format == GDK_MEMORY_R8G8B8A8) ||
+           (src_format == GDK_MEMORY_B8G8R8A8_PREMULTIPLIED && dest_format == GDK_MEMORY_B8G8R8A8))
+    return r8g8b8a8_premultiplied_to_r8g8b8a8;
+  else if ((src_format == GDK_MEMORY_R8G8B8A8_PREMULTIPLIED && dest_format == GDK_MEMORY_B8G8R8A8) ||
+           (src_format == GDK_MEMORY_B8G8R8A8_PREMULTIPLIED && dest_format == GDK_MEMORY_R8G8B8A8))
+    return r8g8b8a8_premultiplied_to_b8g8r8a8;
+
+  return NULL;
+}
+
+typedef void (* TransferFunc) (guchar *data,
+                               gsize   n);
+
+static void convert_srgb_to_srgb_linear (guchar *data,
+                                         gsize   n);
+static void convert_srgb_linear_to_srgb (guchar *data,
+                                         gsize   n);
+
+/* Returns a function that applies the transfer function between
+ * sRGB and sRGB-linear to 8-bit premultiplied pixels with lookup
+ * tables, without going through floats.
+ *
+ * The source must be 8-bit too, as the lookup happens after converting
+ * to the destination format, and quantizing wider formats before
+ * applying the transfer function loses precision in the dark tones.
+ */
+static TransferFunc
+get_fast_transfer_func (GdkMemoryFormat  dest_format,
+                        GdkMemoryFormat  src_format,
+                        GdkColorState   *src_cs,
+                        GdkColorState   *dest_cs)
+{
+  if (dest_format != GDK_MEMORY_B8G8R8A8_PREMULTIPLIED &&
+      dest_format != GDK_MEMORY_R8G8B8A8_PREMULTIPLIED)
+    return NULL;
+
+  if (memory_formats[src_format].depth != GDK_MEMORY_U8)
+    return NULL;
+
+  if (src_cs == GDK_COLOR_STATE_SRGB && dest_cs == GDK_COLOR_STATE_SRGB_LINEAR)
+    return convert_srgb_to_srgb_linear;
+  else if (src_cs == GDK_COLOR_STATE_SRGB_LINEAR && dest_cs == GDK_COLOR_STATE_SRGB)
+    return convert_srgb_linear_to_srgb;
 
   return NULL;
 }
@@ -2100,13 +2180,21 @@ struct _MemoryConvert
   GdkColorState       *src_cs;
   gsize                width;
   gsize                height;
-  gsize                chunk_size;
-
-  /* atomic */ int     rows_done;
 };
 
+/* The number of pixels that is not worth splitting across threads */
+#define GRAIN_PIXELS 4096
+
+static inline gsize
+grain_rows (gsize width)
+{
+  return MAX (1, GRAIN_PIXELS / MAX (width, 1));
+}
+
 static void
-gdk_memory_convert_generic (gpointer data)
+gdk_memory_convert_generic (gsize    start,
+                            gsize    end,
+                            gpointer data)
 {
   MemoryConvert *mc = data;
   const GdkMemoryFormatDescription *dest_desc = &memory_formats[mc->dest_format];
@@ -2115,9 +2203,7 @@ gdk_memory_convert_generic (gpointer data)
   GdkFloatColorConvert convert_func = NULL;
   GdkFloatColorConvert convert_func2 = NULL;
   gboolean needs_premultiply, needs_unpremultiply;
-  gsize y0, y;
-  gint64 before = GDK_PROFILER_CURRENT_TIME;
-  gsize rows;
+  gsize y;
 
   if (gdk_color_state_equal (mc->src_cs, mc->dest_cs))
     {
@@ -2127,27 +2213,44 @@ gdk_memory_convert_generic (gpointer data)
 
       if (func != NULL)
         {
-          for (y0 = g_atomic_int_add (&mc->rows_done, mc->chunk_size), rows = 0;
-               y0 < mc->height;
-               y0 = g_atomic_int_add (&mc->rows_done, mc->chunk_size))
+          for (y = start; y < end; y++)
             {
-              for (y = y0; y < MIN (y0 + mc->chunk_size, mc->height); y++, rows++)
-                {
-                  const guchar *src_data = mc->src_data + y * mc->src_stride;
-                  guchar *dest_data = mc->dest_data + y * mc->dest_stride;
+              const guchar *src_data = mc->src_data + y * mc->src_stride;
+              guchar *dest_data = mc->dest_data + y * mc->dest_stride;
 
-                  func (dest_data, src_data, mc->width);
-                }
+              func (dest_data, src_data, mc->width);
             }
 
-          ADD_MARK (before,
-                    "Memory convert (thread)", "size %lux%lu, %lu rows",
-                    mc->width, mc->height, rows);
           return;
         }
     }
   else
     {
+      TransferFunc transfer_func;
+      FastConversionFunc func = NULL;
+
+      transfer_func = get_fast_transfer_func (mc->dest_format, mc->src_format, mc->src_cs, mc->dest_cs);
+      if (transfer_func && mc->src_format != mc->dest_format)
+        func = get_fast_conversion_func (mc->dest_format, mc->src_format);
+
+      if (transfer_func && (func || mc->src_format == mc->dest_format))
+        {
+          for (y = start; y < end; y++)
+            {
+              const guchar *src_data = mc->src_data + y * mc->src_stride;
+              guchar *dest_data = mc->dest_data + y * mc->dest_stride;
+
+              if (func)
+                func (dest_data, src_data, mc->width);
+              else
+                memcpy (dest_data, src_data, 4 * mc->width);
+
+              transfer_func (dest_data, mc->width);
+            }
+
+          return;
+        }
+
       convert_func = gdk_color_state_get_convert_to (mc->src_cs, mc->dest_cs);
 
       if (!convert_func)
@@ -2174,38 +2277,29 @@ gdk_memory_convert_generic (gpointer data)
 
   tmp = g_malloc (sizeof (*tmp) * mc->width);
 
-  for (y0 = g_atomic_int_add (&mc->rows_done, mc->chunk_size), rows = 0;
-       y0 < mc->height;
-       y0 = g_atomic_int_add (&mc->rows_done, mc->chunk_size))
+  for (y = start; y < end; y++)
     {
-      for (y = y0; y < MIN (y0 + mc->chunk_size, mc->height); y++, rows++)
-        {
-          const guchar *src_data = mc->src_data + y * mc->src_stride;
-          guchar *dest_data = mc->dest_data + y * mc->dest_stride;
+      const guchar *src_data = mc->src_data + y * mc->src_stride;
+      guchar *dest_data = mc->dest_data + y * mc->dest_stride;
 
-          src_desc->to_float (tmp, src_data, mc->width);
+      src_desc->to_float (tmp, src_data, mc->width);
 
-          if (needs_unpremultiply)
-            unpremultiply (tmp, mc->width);
+      if (needs_unpremultiply)
+        unpremultiply (tmp, mc->width);
 
-          if (convert_func)
-            convert_func (mc->src_cs, tmp, mc->width);
+      if (convert_func)
+        convert_func (mc->src_cs, tmp, mc->width);
 
-          if (convert_func2)
-            convert_func2 (mc->dest_cs, tmp, mc->width);
+      if (convert_func2)
+        convert_func2 (mc->dest_cs, tmp, mc->width);
 
-          if (needs_premultiply)
-            premultiply (tmp, mc->width);
+      if (needs_premultiply)
+        premultiply (tmp, mc->width);
 
-          dest_desc->from_float (dest_data, tmp, mc->width);
-        }
+      dest_desc->from_float (dest_data, tmp, mc->width);
     }
 
   g_free (tmp);
-
-  ADD_MARK (before,
-            "Memory convert (thread)", "size %lux%lu, %lu rows",
-            mc->width, mc->height, rows);
 }
 
 void
@@ -2231,10 +2325,8 @@ gdk_memory_convert (guchar              *dest_data,
     .src_cs = src_cs,
     .width = width,
     .height = height,
-    .chunk_size = MAX (1, 512 / width),
   };
-
-  guint n_tasks;
+  gint64 before = GDK_PROFILER_CURRENT_TIME;
 
   g_assert (dest_format < GDK_MEMORY_N_FORMATS);
   g_assert (src_format < GDK_MEMORY_N_FORMATS);
@@ -2267,9 +2359,11 @@ gdk_memory_convert (guchar              *dest_data,
       return;
     }
 
-  n_tasks = (mc.height + mc.chunk_size - 1) / mc.chunk_size;
+  gdk_parallel_for (height, grain_rows (width), gdk_memory_convert_generic, &mc);
 
-  gdk_parallel_task_run (gdk_memory_convert_generic, &mc, n_tasks);
+  ADD_MARK (before,
+            "Memory convert", "size %lux%lu",
+            width, height);
 }
 
 typedef struct _MemoryConvertColorState MemoryConvertColorState;
@@ -2283,9 +2377,7 @@ struct _MemoryConvertColorState
   GdkColorState *dest_cs;
   gsize width;
   gsize height;
-  gsize chunk_size;
-
-  /* atomic */ int rows_done;
+  TransferFunc transfer_func;
 };
 
 static const guchar srgb_lookup[] = {
@@ -2326,58 +2418,52 @@ static const guchar srgb_inverse_lookup[] = {
   222, 224, 226, 228, 230, 232, 235, 237, 239, 241, 243, 245, 248, 250, 252, 255
 };
 
+/* 2^24 / a rounded up, so that (x * reciprocal) >> 24 == x / a
+ * for all x that can occur when unpremultiplying 8-bit values.
+ */
+static guint32 unpremultiply_reciprocals[256];
+
 static void
-convert_srgb_to_srgb_linear (guchar *data,
-                             gsize   n)
+init_unpremultiply_reciprocals (void)
 {
-  for (gsize i = 0; i < n; i++)
-    {
-      guint16 r = data[0];
-      guint16 g = data[1];
-      guint16 b = data[2];
-      guchar a = data[3];
+  static gsize initialized = 0;
 
-      if (a != 0)
-        {
-          r = (r * 255 + a / 2) / a;
-          g = (g * 255 + a / 2) / a;
-          b = (b * 255 + a / 2) / a;
-
-          r = srgb_inverse_lookup[r];
-          g = srgb_inverse_lookup[g];
-          b = srgb_inverse_lookup[b];
+  if (g_once_init_enter (&initialized))
+    {
+      for (guint a = 1; a < 256; a++)
+        unpremultiply_reciprocals[a] = ((1 << 24) + a - 1) / a;
 
-          r = r * a + 127;
-          g = g * a + 127;
-          b = b * a + 127;
-          data[0] = (r + (r >> 8) + 1) >> 8;
-          data[1] = (g + (g >> 8) + 1) >> 8;
-          data[2] = (b + (b >> 8) + 1) >> 8;
-        }
-      data += 4;
+      g_once_init_leave (&initialized, 1);
     }
 }
 
-static void
-convert_srgb_linear_to_srgb (guchar *data,
-                             gsize   n)
+static inline guchar
+unpremultiply_u8 (guchar  c,
+                  guchar  a,
+                  guint64 reciprocal)
 {
+  return MIN (255, ((c * 255 + a / 2) * reciprocal) >> 24);
+}
+
+static inline void
+convert_srgb_transfer (guchar       *data,
+                       gsize         n,
+                       const guchar  lookup[256])
+{
+  init_unpremultiply_reciprocals ();
+
   for (gsize i = 0; i < n; i++)
     {
-      guint16 r = data[0];
-      guint16 g = data[1];
-      guint16 b = data[2];
       guchar a = data[3];
 
       if (a != 0)
         {
-          r = (r * 255 + a / 2) / a;
-          g = (g * 255 + a / 2) / a;
-          b = (b * 255 + a / 2) / a;
+          guint64 reciprocal = unpremultiply_reciprocals[a];
+          guint16 r, g, b;
 
-          r = srgb_lookup[r];
-          g = srgb_lookup[g];
-          b = srgb_lookup[b];
+          r = lookup[unpremultiply_u8 (data[0], a, reciprocal)];
+          g = lookup[unpremultiply_u8 (data[1], a, reciprocal)];
+          b = lookup[unpremultiply_u8 (data[2], a, reciprocal)];
 
           r = r * a + 127;
           g = g * a + 127;
@@ -2392,58 +2478,42 @@ convert_srgb_linear_to_srgb (guchar *data,
 }
 
 static void
-gdk_memory_convert_color_state_srgb_to_srgb_linear (gpointer data)
+convert_srgb_to_srgb_linear (guchar *data,
+                             gsize   n)
 {
-  MemoryConvertColorState *mc = data;
-  gsize y0, y;
-  guint64 before = GDK_PROFILER_CURRENT_TIME;
-  gsize rows;
-
-  for (y0 = g_atomic_int_add (&mc->rows_done, mc->chunk_size), rows = 0;
-       y0 < mc->height;
-       y0 = g_atomic_int_add (&mc->rows_done, mc->chunk_size))
-    {
-      for (y = y0; y < MIN (y0 + mc->chunk_size, mc->height); y++, rows++)
-        convert_srgb_to_srgb_linear (mc->data + y * mc->stride, mc->width);
-    }
+  convert_srgb_transfer (data, n, srgb_inverse_lookup);
+}
 
-  ADD_MARK (before,
-            "Color state convert srgb->srgb-linear (thread)", "size %lux%lu, %lu rows",
-            mc->width, mc->height, rows);
+static void
+convert_srgb_linear_to_srgb (guchar *data,
+                             gsize   n)
+{
+  convert_srgb_transfer (data, n, srgb_lookup);
 }
 
 static void
-gdk_memory_convert_color_state_srgb_linear_to_srgb (gpointer data)
+gdk_memory_convert_color_state_transfer (gsize    start,
+                                         gsize    end,
+                                         gpointer data)
 {
   MemoryConvertColorState *mc = data;
-  gsize y0, y;
-  guint64 before = GDK_PROFILER_CURRENT_TIME;
-  gsize rows;
-
-  for (y0 = g_atomic_int_add (&mc->rows_done, mc->chunk_size), rows = 0;
-       y0 < mc->height;
-       y0 = g_atomic_int_add (&mc->rows_done, mc->chunk_size))
-    {
-      for (y = y0; y < MIN (y0 + mc->chunk_size, mc->height); y++, rows++)
-        convert_srgb_linear_to_srgb (mc->data + y * mc->stride, mc->width);
-    }
+  gsize y;
 
-  ADD_MARK (before,
-            "Color state convert srgb-linear->srgb (thread)", "size %lux%lu, %lu rows",
-            mc->width, mc->height, rows);
+  for (y = start; y < end; y++)
+    mc->transfer_func (mc->data + y * mc->stride, mc->width);
 }
 
 static void
-gdk_memory_convert_color_state_generic (gpointer user_data)
+gdk_memory_convert_color_state_generic (gsize    start,
+                                        gsize    end,
+                                        gpointer user_data)
 {
   MemoryConvertColorState *mc = user_data;
   const GdkMemoryFormatDescription *desc = &memory_formats[mc->format];
   GdkFloatColorConvert convert_func = NULL;
   GdkFloatColorConvert convert_func2 = NULL;
   float (*tmp)[4];
-  gsize y0, y;
-  guint64 before = GDK_PROFILER_CURRENT_TIME;
-  gsize rows;
+  gsize y;
 
   convert_func = gdk_color_state_get_convert_to (mc->src_cs, mc->dest_cs);
 
@@ -2461,37 +2531,28 @@ gdk_memory_convert_color_state_generic (gpointer user_data)
 
   tmp = g_malloc (sizeof (*tmp) * mc->width);
 
-  for (y0 = g_atomic_int_add (&mc->rows_done, mc->chunk_size), rows = 0;
-       y0 < mc->height;
-       y0 = g_atomic_int_add (&mc->rows_done, mc->chunk_size))
+  for (y = start; y < end; y++)
     {
-      for (y = y0; y < MIN (y0 + mc->chunk_size, mc->height); y++, rows++)
-        {
-          guchar *data = mc->data + y * mc->stride;
+      guchar *data = mc->data + y * mc->stride;
 
-          desc->to_float (tmp, data, mc->width);
+      desc->to_float (tmp, data, mc->width);
 
-          if (desc->alpha == GDK_MEMORY_ALPHA_PREMULTIPLIED)
-            unpremultiply (tmp, mc->width);
+      if (desc->alpha == GDK_MEMORY_ALPHA_PREMULTIPLIED)
+        unpremultiply (tmp, mc->width);
 
-          if (convert_func)
-            convert_func (mc->src_cs, tmp, mc->width);
+      if (convert_func)
+        convert_func (mc->src_cs, tmp, mc->width);
 
-          if (convert_func2)
-            convert_func2 (mc->dest_cs, tmp, mc->width);
+      if (convert_func2)
+        convert_func2 (mc->dest_cs, tmp, mc->width);
 
-          if (desc->alpha == GDK_MEMORY_ALPHA_PREMULTIPLIED)
-            premultiply (tmp, mc->width);
+      if (desc->alpha == GDK_MEMORY_ALPHA_PREMULTIPLIED)
+        premultiply (tmp, mc->width);
 
-          desc->from_float (data, tmp, mc->width);
-        }
+      desc->from_float (data, tmp, mc->width);
     }
 
   g_free (tmp);
-
-  ADD_MARK (before,
-            "Color state convert (thread)", "size %lux%lu, %lu rows",
-            mc->width, mc->height, rows);
 }
 
 void
@@ -2511,31 +2572,28 @@ gdk_memory_convert_color_state (guchar          *data,
     .dest_cs = dest_color_state,
     .width = width,
     .height = height,
-    .chunk_size = MAX (1, 512 / width),
   };
-  guint n_tasks;
+  gint64 before = GDK_PROFILER_CURRENT_TIME;
+  gsize grain;
 
   if (gdk_color_state_equal (src_color_state, dest_color_state))
     return;
 
-  n_tasks = (mc.height + mc.chunk_size - 1) / mc.chunk_size;
+  grain = grain_rows (width);
+  mc.transfer_func = get_fast_transfer_func (format, format, src_color_state, dest_color_state);
 
-  if (format == GDK_MEMORY_B8G8R8A8_PREMULTIPLIED &&
-      src_color_state == GDK_COLOR_STATE_SRGB &&
-      dest_color_state == GDK_COLOR_STATE_SRGB_LINEAR)
+  if (mc.transfer_func)
     {
-      gdk_parallel_task_run (gdk_memory_convert_color_state_srgb_to_srgb_linear, &mc, n_tasks);
-    }
-  else if (format == GDK_MEMORY_B8G8R8A8_PREMULTIPLIED &&
-           src_color_state == GDK_COLOR_STATE_SRGB_LINEAR &&
-           dest_color_state == GDK_COLOR_STATE_SRGB)
-    {
-      gdk_parallel_task_run (gdk_memory_convert_color_state_srgb_linear_to_srgb, &mc, n_tasks);
+      gdk_parallel_for (height, grain, gdk_memory_convert_color_state_transfer, &mc);
     }
   else
     {
-      gdk_parallel_task_run (gdk_memory_convert_color_state_generic, &mc, n_tasks);
+      gdk_parallel_for (height, grain, gdk_memory_convert_color_state_generic, &mc);
     }
+
+  ADD_MARK (before,
+            "Color state convert", "size %lux%lu",
+            width, height);
 }
 
 typedef struct _MipmapData MipmapData;
@@ -2552,24 +2610,20 @@ struct _MipmapData
   gsize            src_height;
   guint            lod_level;
   gboolean         linear;
-
-  gint             rows_done;
 };
 
 static void
-gdk_memory_mipmap_same_format_nearest (gpointer data)
+gdk_memory_mipmap_same_format_nearest (gsize    start,
+                                       gsize    end,
+                                       gpointer data)
 {
   MipmapData *mipmap = data;
   const GdkMemoryFormatDescription *desc = &memory_formats[mipmap->src_format];
   gsize n, y;
-  guint64 before = GDK_PROFILER_CURRENT_TIME;
-  gsize rows;
 
   n = 1 << mipmap->lod_level;
 
-  for (y = g_atomic_int_add (&mipmap->rows_done, n), rows = 0;
-       y < mipmap->src_height;
-       y = g_atomic_int_add (&mipmap->rows_done, n), rows++)
+  for (y = start * n; y < MIN (end * n, mipmap->src_height); y += n)
     {
       guchar *dest = mipmap->dest + (y >> mipmap->lod_level) * mipmap->dest_stride;
       const guchar *src = mipmap->src + y * mipmap->src_stride;
@@ -2579,26 +2633,20 @@ gdk_memory_mipmap_same_format_nearest (gpointer data)
                             mipmap->src_width, MIN (n, mipmap->src_height - y),
                             mipmap->lod_level);
     }
-
-  ADD_MARK (before,
-            "Mipmap nearest (thread)", "size %lux%lu, lod %u, %lu rows",
-            mipmap->src_width, mipmap->src_height, mipmap->lod_level, rows);
 }
 
 static void
-gdk_memory_mipmap_same_format_linear (gpointer data)
+gdk_memory_mipmap_same_format_linear (gsize    start,
+                                      gsize    end,
+                                      gpointer data)
 {
   MipmapData *mipmap = data;
   const GdkMemoryFormatDescription *desc = &memory_formats[mipmap->src_format];
   gsize n, y;
-  guint64 before = GDK_PROFILER_CURRENT_TIME;
-  gsize rows;
 
   n = 1 << mipmap->lod_level;
 
-  for (y = g_atomic_int_add (&mipmap->rows_done, n), rows = 0;
-       y < mipmap->src_height;
-       y = g_atomic_int_add (&mipmap->rows_done, n), rows++)
+  for (y = start * n; y < MIN (end * n, mipmap->src_height); y += n)
     {
       guchar *dest = mipmap->dest + (y >> mipmap->lod_level) * mipmap->dest_stride;
       const guchar *src = mipmap->src + y * mipmap->src_stride;
@@ -2608,14 +2656,12 @@ gdk_memory_mipmap_same_format_linear (gpointer data)
                            mipmap->src_width, MIN (n, mipmap->src_height - y),
                            mipmap->lod_level);
     }
-
-  ADD_MARK (before,
-            "Mipmap linear (thread)", "size %lux%lu, lod %u, %lu rows",
-            mipmap->src_width, mipmap->src_height, mipmap->lod_level, rows);
 }
 
 static void
-gdk_memory_mipmap_generic (gpointer data)
+gdk_memory_mipmap_generic (gsize    start,
+                           gsize    end,
+                           gpointer data)
 {
   MipmapData *mipmap = data;
   const GdkMemoryFormatDescription *desc = &memory_formats[mipmap->src_format];
@@ -2624,8 +2670,6 @@ gdk_memory_mipmap_generic (gpointer data)
   gsize size;
   guchar *tmp;
   gsize n, y;
-  guint64 before = GDK_PROFILER_CURRENT_TIME;
-  gsize rows;
 
   n = 1 << mipmap->lod_level;
   dest_width = (mipmap->src_width + n - 1) >> mipmap->lod_level;
@@ -2633,9 +2677,7 @@ gdk_memory_mipmap_generic (gpointer data)
   tmp = g_malloc (size);
   func = get_fast_conversion_func (mipmap->dest_format, mipmap->src_format);
 
-  for (y = g_atomic_int_add (&mipmap->rows_done, n), rows = 0;
-       y < mipmap->src_height;
-       y = g_atomic_int_add (&mipmap->rows_done, n), rows++)
+  for (y = start * n; y < MIN (end * n, mipmap->src_height); y += n)
     {
       guchar *dest = mipmap->dest + (y >> mipmap->lod_level) * mipmap->dest_stride;
       const guchar *src = mipmap->src + y * mipmap->src_stride;
@@ -2659,10 +2701,6 @@ gdk_memory_mipmap_generic (gpointer data)
     }
 
   g_free (tmp);
-
-  ADD_MARK (before,
-            "Mipmap generic (thread)", "size %lux%lu, lod %u, %lu rows",
-            mipmap->src_width, mipmap->src_height, mipmap->lod_level, rows);
 }
 
 void
@@ -2688,26 +2726,33 @@ gdk_memory_mipmap (guchar          *dest,
     .src_height = src_height,
     .lod_level = lod_level,
     .linear = linear,
-    .rows_done = 0,
   };
-  gsize chunk_size;
-  guint n_tasks;
+  gint64 before = GDK_PROFILER_CURRENT_TIME;
+  gsize n, n_rows, grain;
 
   g_assert (lod_level > 0);
 
-  chunk_size = MAX (1, 512 / src_width),
-  n_tasks = (src_height + chunk_size - 1) / chunk_size;
+  /* We split the work into blocks of source rows that
+   * produce one destination row each.
+   */
+  n = 1 << lod_level;
+  n_rows = (src_height + n - 1) >> lod_level;
+  grain = MAX (1, grain_rows (src_width) >> lod_level);
 
   if (dest_format == src_format)
     {
       if (linear)
-        gdk_parallel_task_run (gdk_memory_mipmap_same_format_linear, &mipmap, n_tasks);
+        gdk_parallel_for (n_rows, grain, gdk_memory_mipmap_same_format_linear, &mipmap);
       else
-        gdk_parallel_task_run (gdk_memory_mipmap_same_format_nearest, &mipmap, n_tasks);
+        gdk_parallel_for (n_rows, grain, gdk_memory_mipmap_same_format_nearest, &mipmap);
     }
   else
     {
-      gdk_parallel_task_run (gdk_memory_mipmap_generic, &mipmap, n_tasks);
+      gdk_parallel_for (n_rows, grain, gdk_memory_mipmap_generic, &mipmap);
     }
+
+  ADD_MARK (before,
+            "Mipmap", "size %lux%lu, lod %u",
+            src_width, src_height, lod_level);
 }
 
@@ -0,0 +1,757 @@
+/* GDK - The GIMP Drawing Kit
+ * Copyright (C) 2026 the GTK team
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "config.h"
+
+#include "gdkmemoryformatsimdprivate.h"
+
+/* Vectorized versions of the most common conversions between memory
+ * formats. They are picked at runtime depending on what the CPU
+ * supports and must produce the same results as the scalar fast paths
+ * in gdkmemoryformat.c.
+ *
+ * All kernels work on 4-channel 8-bit destinations. The permutation
+ * describes for each destination byte of a pixel which source channel
+ * it is taken from, -1 means that the byte is an opaque alpha value.
+ */
+
+#if defined(__aarch64__) && defined(__ARM_NEON)
+#define HAVE_NEON 1
+#endif
+
+/* {{{ scalar tails */
+
+static inline void
+swizzle_scalar (guchar       *dest,
+                const guchar *src,
+                gsize         n,
+                const gint8   perm[4])
+{
+  for (; n > 0; n--)
+    {
+      guchar tmp[4] = { src[0], src[1], src[2], src[3] };
+
+      dest[0] = tmp[perm[0]];
+      dest[1] = tmp[perm[1]];
+      dest[2] = tmp[perm[2]];
+      dest[3] = tmp[perm[3]];
+      dest += 4;
+      src += 4;
+    }
+}
+
+static inline void
+add_alpha_scalar (guchar       *dest,
+                  const guchar *src,
+                  gsize         n,
+                  const gint8   perm[4])
+{
+  for (; n > 0; n--)
+    {
+      for (guint i = 0; i < 4; i++)
+        dest[i] = perm[i] < 0 ? 255 : src[perm[i]];
+      dest += 4;
+      src += 3;
+    }
+}
+
+static inline guchar
+premultiply_one (guchar c,
+                 guchar a)
+{
+  guint16 t = (guint16) c * a + 127;
+
+  return (t + (t >> 8) + 1) >> 8;
+}
+
+static inline void
+premultiply_scalar (guchar       *dest,
+                    const guchar *src,
+                    gsize         n,
+                    const gint8   perm[4])
+{
+  for (; n > 0; n--)
+    {
+      guchar a = src[3];
+
+      dest[0] = premultiply_one (src[perm[0]], a);
+      dest[1] = premultiply_one (src[perm[1]], a);
+      dest[2] = premultiply_one (src[perm[2]], a);
+      dest[3] = a;
+      dest += 4;
+      src += 4;
+    }
+}
+
+static inline guchar
+unpremultiply_one (guchar c,
+                   guchar a)
+{
+  if (a == 0)
+    return c;
+
+  return MIN (255, ((guint) c * 255 + a / 2) / a);
+}
+
+static inline void
+unpremultiply_scalar (guchar       *dest,
+                      const guchar *src,
+                      gsize         n,
+                      const gint8   perm[4])
+{
+  for (; n > 0; n--)
+    {
+      guchar a = src[3];
+
+      dest[0] = unpremultiply_one (src[perm[0]], a);
+      dest[1] = unpremultiply_one (src[perm[1]], a);
+      dest[2] = unpremultiply_one (src[perm[2]], a);
+      dest[3] = a;
+      dest += 4;
+      src += 4;
+    }
+}
+
+/* }}} */
+/* {{{ x86 */
+
+#ifdef HAVE_X86_SIMD
+
+#include <immintrin.h>
+
+#define SSE41 __attribute__((target ("sse4.1")))
+#define AVX2 __attribute__((target ("avx2")))
+#define F16C __attribute__((target ("sse4.1,f16c")))
+
+static inline SSE41 __m128i
+shuffle_mask_sse41 (const gint8 perm[4],
+                    guint       src_bpp)
+{
+  gint8 mask[16];
+
+  for (guint p = 0; p < 4; p++)
+    for (guint i = 0; i < 4; i++)
+      mask[4 * p + i] = perm[i] < 0 ? -128 : src_bpp * p + perm[i];
+
+  return _mm_loadu_si128 ((const __m128i *) mask);
+}
+
+static inline SSE41 void
+swizzle_sse41 (guchar       *dest,
+               const guchar *src,
+               gsize         n,
+               const gint8   perm[4])
+{
+  __m128i mask = shuffle_mask_sse41 (perm, 4);
+
+  for (; n >= 4; n -= 4)
+    {
+      __m128i v = _mm_loadu_si128 ((const __m128i *) src);
+      _mm_storeu_si128 ((__m128i *) dest, _mm_shuffle_epi8 (v, mask));
+      dest += 16;
+      src += 16;
+    }
+
+  swizzle_scalar (dest, src, n, perm);
+}
+
+static inline AVX2 void
+swizzle_avx2 (guchar       *dest,
+              const guchar *src,
+              gsize         n,
+              const gint8   perm[4])
+{
+  __m256i mask = _mm256_broadcastsi128_si256 (shuffle_mask_sse41 (perm, 4));
+
+  for (; n >= 8; n -= 8)
+    {
+      __m256i v = _mm256_loadu_si256 ((const __m256i *) src);
+      _mm256_storeu_si256 ((__m256i *) dest, _mm256_shuffle_epi8 (v, mask));
+      dest += 32;
+      src += 32;
+    }
+
+  swizzle_scalar (dest, src, n, perm);
+}
+
+static inline SSE41 void
+add_alpha_sse41 (guchar       *dest,
+                 const guchar *src,
+                 gsize         n,
+                 const gint8   perm[4])
+{
+  __m128i mask = shuffle_mask_sse41 (perm, 3);
+  __m128i alpha = _mm_set1_epi32 (0);
+
+  for (guint i = 0; i < 4; i++)
+    if (perm[i] < 0)
+      alpha = _mm_or_si128 (alpha, _mm_set1_epi32 ((gint) (0xffu << (8 * i))));
+
+  /* We load 16 bytes but only use 12, so make sure we don't
+   * read past the end of the row.
+   */
+  for (; n >= 6; n -= 4)
+    {
+      __m128i v = _mm_loadu_si128 ((const __m128i *) src);
+      v = _mm_or_si128 (_mm_shuffle_epi8 (v, mask), alpha);
+      _mm_storeu_si128 ((__m128i *) dest, v);
+      dest += 16;
+      src += 12;
+    }
+
+  add_alpha_scalar (dest, src, n, perm);
+}
+
+/* Computes (c * a + 127) / 255 with correct rounding on 16-bit lanes */
+static inline SSE41 __m128i
+premultiply_epi16_sse41 (__m128i c,
+                         __m128i a)
+{
+  __m128i t = _mm_add_epi16 (_mm_mullo_epi16 (c, a), _mm_set1_epi16 (127));
+
+  t = _mm_add_epi16 (t, _mm_srli_epi16 (t, 8));
+  t = _mm_add_epi16 (t, _mm_set1_epi16 (1));
+
+  return _mm_srli_epi16 (t, 8);
+}
+
+static inline SSE41 void
+premultiply_sse41 (guchar       *dest,
+                   const guchar *src,
+                   gsize         n,
+                   const gint8   perm[4])
+{
+  __m128i mask = shuffle_mask_sse41 (perm, 4);
+  /* broadcasts the alpha word of each pixel to all its 4 words */
+  __m128i alpha_mask = _mm_setr_epi8 (6, 7, 6, 7, 6, 7, 6, 7,
+                                      14, 15, 14, 15, 14, 15, 14, 15);
+
+  for (; n >= 4; n -= 4)
+    {
+      __m128i v, lo, hi, alo, ahi;
+
+      v = _mm_shuffle_epi8 (_mm_loadu_si128 ((const __m128i *) src), mask);
+      lo = _mm_cvtepu8_epi16 (v);
+      hi = _mm_cvtepu8_epi16 (_mm_srli_si128 (v, 8));
+      /* multiplying alpha by 255 keeps it unchanged */
+      alo = _mm_blend_epi16 (_mm_shuffle_epi8 (lo, alpha_mask), _mm_set1_epi16 (255), 0x88);
+      ahi = _mm_blend_epi16 (_mm_shuffle_epi8 (hi, alpha_mask), _mm_set1_epi16 (255), 0x88);
+      lo = premultiply_epi16_sse41 (lo, alo);
+      hi = premultiply_epi16_sse41 (hi, ahi);
+      _mm_storeu_si128 ((__m128i *) dest, _mm_packus_epi16 (lo, hi));
+      dest += 16;
+      src += 16;
+    }
+
+  premultiply_scalar (dest, src, n, perm);
+}
+
+static inline AVX2 __m256i
+premultiply_epi16_avx2 (__m256i c,
+                        __m256i a)
+{
+  __m256i t = _mm256_add_epi16 (_mm256_mullo_epi16 (c, a), _mm256_set1_epi16 (127));
+
+  t = _mm256_add_epi16 (t, _mm256_srli_epi16 (t, 8));
+  t = _mm256_add_epi16 (t, _mm256_set1_epi16 (1));
+
+  return _mm256_srli_epi16 (t, 8);
+}
+
+static inline AVX2 void
+premultiply_avx2 (guchar       *dest,
+                  const guchar *src,
+                  gsize         n,
+                  const gint8   perm[4])
+{
+  __m256i mask = _mm256_broadcastsi128_si256 (shuffle_mask_sse41 (perm, 4));
+  __m256i alpha_mask = _mm256_setr_epi8 (6, 7, 6, 7, 6, 7, 6, 7,
+                                         14, 15, 14, 15, 14, 15, 14, 15,
+                                         6, 7, 6, 7, 6, 7, 6, 7,
+                                         14, 15, 14, 15, 14, 15, 14, 15);
+
+  for (; n >= 8; n -= 8)
+    {
+      __m256i v, lo, hi, alo, ahi;
+
+      v = _mm256_shuffle_epi8 (_mm256_loadu_si256 ((const __m256i *) src), mask);
+      lo = _mm256_cvtepu8_epi16 (_mm256_castsi256_si128 (v));
+      hi = _mm256_cvtepu8_epi16 (_mm256_extracti128_si256 (v, 1));
+      alo = _mm256_blend_epi16 (_mm256_shuffle_epi8 (lo, alpha_mask), _mm256_set1_epi16 (255), 0x88);
+      ahi = _mm256_blend_epi16 (_mm256_shuffle_epi8 (hi, alpha_mask), _mm256_set1_epi16 (255), 0x88);
+      lo = premultiply_epi16_avx2 (lo, alo);
+      hi = premultiply_epi16_avx2 (hi, ahi);
+      /* packus works per 128-bit lane, so put the quarters back in order */
+      v = _mm256_permute4x64_epi64 (_mm256_packus_epi16 (lo, hi), 0xd8);
+      _mm256_storeu_si256 ((__m256i *) dest, v);
+      dest += 32;
+      src += 32;
+    }
+
+  premultiply_scalar (dest, src, n, perm);
+}
+
+/* Unpremultiplies one pixel with the alpha in the last lane */
+static inline SSE41 __m128
+unpremultiply_ps_sse41 (__m128 c)
+{
+  __m128 a = _mm_shuffle_ps (c, c, _MM_SHUFFLE (3, 3, 3, 3));
+  __m128 r;
+
+  r = _mm_add_ps (_mm_div_ps (_mm_mul_ps (c, _mm_set1_ps (255.f)), a), _mm_set1_ps (0.5f));
+  /* keep the color if alpha is 0, and keep alpha itself */
+  r = _mm_blendv_ps (r, c, _mm_cmpeq_ps (a, _mm_setzero_ps ()));
+  r = _mm_blend_ps (r, c, 0x8);
+
+  return _mm_min_ps (r, _mm_set1_ps (255.f));
+}
+
+static inline SSE41 void
+unpremultiply_sse41 (guchar       *dest,
+                     const guchar *src,
+                     gsize         n,
+                     const gint8   perm[4])
+{
+  __m128i mask = shuffle_mask_sse41 (perm, 4);
+
+  for (; n >= 4; n -= 4)
+    {
+      __m128i v, p0, p1, p2, p3;
+
+      v = _mm_shuffle_epi8 (_mm_loadu_si128 ((const __m128i *) src), mask);
+      p0 = _mm_cvttps_epi32 (unpremultiply_ps_sse41 (_mm_cvtepi32_ps (_mm_cvtepu8_epi32 (v))));
+      p1 = _mm_cvttps_epi32 (unpremultiply_ps_sse41 (_mm_cvtepi32_ps (_mm_cvtepu8_epi32 (_mm_srli_si128 (v, 4)))));
+      p2 = _mm_cvttps_epi32 (unpremultiply_ps_sse41 (_mm_cvtepi32_ps (_mm_cvtepu8_epi32 (_mm_srli_si128 (v, 8)))));
+      p3 = _mm_cvttps_epi32 (unpremultiply_ps_sse41 (_mm_cvtepi32_ps (_mm_cvtepu8_epi32 (_mm_srli_si128 (v, 12)))));
+      v = _mm_packus_epi16 (_mm_packus_epi32 (p0, p1), _mm_packus_epi32 (p2, p3));
+      _mm_storeu_si128 ((__m128i *) dest, v);
+      dest += 16;
+      src += 16;
+    }
+
+  unpremultiply_scalar (dest, src, n, perm);
+}
+
+/* Converts one RGBA pixel from floats in the [0, 1] range to bytes
+ * in the low 4 lanes, with the same rounding as the generic code.
+ */
+static inline F16C __m128i
+float_to_u8_f16c (__m128 f)
+{
+  f = _mm_add_ps (_mm_mul_ps (f, _mm_set1_ps (255.f)), _mm_set1_ps (0.5f));
+  /* max() returns the second argument for NaN */
+  f = _mm_min_ps (_mm_max_ps (f, _mm_setzero_ps ()), _mm_set1_ps (255.f));
+
+  return _mm_cvttps_epi32 (f);
+}
+
+static inline F16C void
+half_to_u8_f16c (guchar       *dest,
+                 const guchar *src,
+                 gsize         n,
+                 const gint8   perm[4])
+{
+  __m128i mask = shuffle_mask_sse41 (perm, 4);
+
+  for (; n >= 4; n -= 4)
+    {
+      __m128i p0, p1, p2, p3, v;
+
+      p0 = float_to_u8_f16c (_mm_cvtph_ps (_mm_loadl_epi64 ((const __m128i *) src)));
+      p1 = float_to_u8_f16c (_mm_cvtph_ps (_mm_loadl_epi64 ((const __m128i *) (src + 8))));
+      p2 = float_to_u8_f16c (_mm_cvtph_ps (_mm_loadl_epi64 ((const __m128i *) (src + 16))));
+      p3 = float_to_u8_f16c (_mm_cvtph_ps (_mm_loadl_epi64 ((const __m128i *) (src + 24))));
+      v = _mm_packus_epi16 (_mm_packus_epi32 (p0, p1), _mm_packus_epi32 (p2, p3));
+      _mm_storeu_si128 ((__m128i *) dest, _mm_shuffle_epi8 (v, mask));
+      dest += 16;
+      src += 32;
+    }
+
+  for (; n > 0; n--)
+    {
+      __m128i p;
+      guint32 tmp;
+
+      p = float_to_u8_f16c (_mm_cvtph_ps (_mm_loadl_epi64 ((const __m128i *) src)));
+      p = _mm_packus_epi16 (_mm_packus_epi32 (p, p), p);
+      tmp = _mm_cvtsi128_si32 (p);
+      swizzle_scalar (dest, (guchar *) &tmp, 1, perm);
+      dest += 4;
+      src += 8;
+    }
+}
+
+static inline F16C void
+u8_to_half_f16c (guchar       *dest,
+                 const guchar *src,
+                 gsize         n,
+                 const gint8   perm[4])
+{
+  __m128 scale = _mm_set1_ps (255.f);
+
+  for (; n > 0; n--)
+    {
+      guint32 tmp;
+      __m128 f;
+
+      swizzle_scalar ((guchar *) &tmp, src, 1, perm);
+      f = _mm_div_ps (_mm_cvtepi32_ps (_mm_cvtepu8_epi32 (_mm_cvtsi32_si128 (tmp))), scale);
+      _mm_storel_epi64 ((__m128i *) dest, _mm_cvtps_ph (f, _MM_FROUND_TO_NEAREST_INT));
+      dest += 8;
+      src += 4;
+    }
+}
+
+static gboolean
+have_sse41 (void)
+{
+  __builtin_cpu_init ();
+  return __builtin_cpu_supports ("sse4.1");
+}
+
+static gboolean
+have_avx2 (void)
+{
+  __builtin_cpu_init ();
+  return __builtin_cpu_supports ("avx2");
+}
+
+static gboolean
+have_f16c (void)
+{
+  __builtin_cpu_init ();
+  return __builtin_cpu_supports ("sse4.1") && __builtin_cpu_supports ("f16c");
+}
+
+#endif /* HAVE_X86_SIMD */
+
+/* }}} */
+/* {{{ NEON */
+
+#ifdef HAVE_NEON
+
+#include <arm_neon.h>
+
+static inline uint8x16_t
+shuffle_mask_neon (const gint8 perm[4],
+                   guint       src_bpp)
+{
+  guint8 mask[16];
+
+  /* out of range indexes produce 0 in vqtbl1q_u8() */
+  for (guint p = 0; p < 4; p++)
+    for (guint i = 0; i < 4; i++)
+      mask[4 * p + i] = perm[i] < 0 ? 0xff : src_bpp * p + perm[i];
+
+  return vld1q_u8 (mask);
+}
+
+static inline void
+swizzle_neon (guchar       *dest,
+              const guchar *src,
+              gsize         n,
+              const gint8   perm[4])
+{
+  uint8x16_t mask = shuffle_mask_neon (perm, 4);
+
+  for (; n >= 4; n -= 4)
+    {
+      vst1q_u8 (dest, vqtbl1q_u8 (vld1q_u8 (src), mask));
+      dest += 16;
+      src += 16;
+    }
+
+  swizzle_scalar (dest, src, n, perm);
+}
+
+static inline void
+add_alpha_neon (guchar       *dest,
+                const guchar *src,
+                gsize         n,
+                const gint8   perm[4])
+{
+  for (; n >= 16; n -= 16)
+    {
+      uint8x16x3_t in = vld3q_u8 (src);
+      uint8x16x4_t out;
+
+      for (guint i = 0; i < 4; i++)
+        out.val[i] = perm[i] < 0 ? vdupq_n_u8 (255) : in.val[perm[i]];
+
+      vst4q_u8 (dest, out);
+      dest += 64;
+      src += 48;
+    }
+
+  add_alpha_scalar (dest, src, n, perm);
+}
+
+static inline uint8x8_t
+premultiply_u8_neon (uint8x8_t c,
+                     uint8x8_t a)
+{
+  uint16x8_t t = vaddq_u16 (vmull_u8 (c, a), vdupq_n_u16 (127));
+
+  t = vaddq_u16 (t, vshrq_n_u16 (t, 8));
+  t = vaddq_u16 (t, vdupq_n_u16 (1));
+
+  return vshrn_n_u16 (t, 8);
+}
+
+static inline void
+premultiply_neon (guchar       *dest,
+                  const guchar *src,
+                  gsize         n,
+                  const gint8   perm[4])
+{
+  uint8x16_t mask = shuffle_mask_neon (perm, 4);
+  static const guint8 alpha_indexes[16] = { 3, 3, 3, 0xff, 7, 7, 7, 0xff,
+                                            11, 11, 11, 0xff, 15, 15, 15, 0xff };
+  static const guint8 alpha_bytes[16] = { 0, 0, 0, 255, 0, 0, 0, 255,
+                                          0, 0, 0, 255, 0, 0, 0, 255 };
+  uint8x16_t alpha_mask = vld1q_u8 (alpha_indexes);
+  uint8x16_t alpha_fill = vld1q_u8 (alpha_bytes);
+
+  for (; n >= 4; n -= 4)
+    {
+      uint8x16_t v, a;
+
+      v = vqtbl1q_u8 (vld1q_u8 (src), mask);
+      /* multiplying alpha by 255 keeps it unchanged */
+      a = vorrq_u8 (vqtbl1q_u8 (v, alpha_mask), alpha_fill);
+      v = vcombine_u8 (premultiply_u8_neon (vget_low_u8 (v), vget_low_u8 (a)),
+                       premultiply_u8_neon (vget_high_u8 (v), vget_high_u8 (a)));
+      vst1q_u8 (dest, v);
+      dest += 16;
+      src += 16;
+    }
+
+  premultiply_scalar (dest, src, n, perm);
+}
+
+#endif /* HAVE_NEON */
+
+/* }}} */
+/* {{{ dispatch */
+
+static const gint8 keep[4] = { 0, 1, 2, 3 };
+static const gint8 swap[4] = { 2, 1, 0, 3 };
+static const gint8 keep_add_alpha[4] = { 0, 1, 2, -1 };
+static const gint8 swap_add_alpha[4] = { 2, 1, 0, -1 };
+
+#define SIMD_FUNC(name, kernel, perm, attr) \
+static attr void \
+name (guchar       *dest, \
+      const guchar *src, \
+      gsize         n) \
+{ \
+  kernel (dest, src, n, perm); \
+}
+
+typedef enum {
+  KERNEL_SWIZZLE,
+  KERNEL_ADD_ALPHA,
+  KERNEL_PREMULTIPLY,
+  KERNEL_UNPREMULTIPLY,
+  KERNEL_HALF_TO_U8,
+  KERNEL_U8_TO_HALF,
+} Kernel;
+
+typedef struct _SimdConversion SimdConversion;
+
+struct _SimdConversion
+{
+  GdkMemoryFormat dest_format;
+  GdkMemoryFormat src_format;
+  Kernel kernel;
+  const gint8 *perm;
+};
+
+static const SimdConversion conversions[] = {
+  { GDK_MEMORY_R8G8B8A8, GDK_MEMORY_B8G8R8A8, KERNEL_SWIZZLE, swap },
+  { GDK_MEMORY_B8G8R8A8, GDK_MEMORY_R8G8B8A8, KERNEL_SWIZZLE, swap },
+  { GDK_MEMORY_R8G8B8A8_PREMULTIPLIED, GDK_MEMORY_B8G8R8A8_PREMULTIPLIED, KERNEL_SWIZZLE, swap },
+  { GDK_MEMORY_B8G8R8A8_PREMULTIPLIED, GDK_MEMORY_R8G8B8A8_PREMULTIPLIED, KERNEL_SWIZZLE, swap },
+
+  { GDK_MEMORY_R8G8B8A8_PREMULTIPLIED, GDK_MEMORY_R8G8B8A8, KERNEL_PREMULTIPLY, keep },
+  { GDK_MEMORY_B8G8R8A8_PREMULTIPLIED, GDK_MEMORY_R8G8B8A8, KERNEL_PREMULTIPLY, swap },
+  { GDK_MEMORY_R8G8B8A8_PREMULTIPLIED, GDK_MEMORY_B8G8R8A8, KERNEL_PREMULTIPLY, swap },
+  { GDK_MEMORY_B8G8R8A8_PREMULTIPLIED, GDK_MEMORY_B8G8R8A8, KERNEL_PREMULTIPLY, keep },
+
+  { GDK_MEMORY_R8G8B8A8, GDK_MEMORY_R8G8B8A8_PREMULTIPLIED, KERNEL_UNPREMULTIPLY, keep },
+  { GDK_MEMORY_B8G8R8A8, GDK_MEMORY_R8G8B8A8_PREMULTIPLIED, KERNEL_UNPREMULTIPLY, swap },
+  { GDK_MEMORY_R8G8B8A8, GDK_MEMORY_B8G8R8A8_PREMULTIPLIED, KERNEL_UNPREMULTIPLY, swap },
+  { GDK_MEMORY_B8G8R8A8, GDK_MEMORY_B8G8R8A8_PREMULTIPLIED, KERNEL_UNPREMULTIPLY, keep },
+
+  { GDK_MEMORY_R8G8B8A8, GDK_MEMORY_R8G8B8, KERNEL_ADD_ALPHA, keep_add_alpha },
+  { GDK_MEMORY_B8G8R8A8, GDK_MEMORY_R8G8B8, KERNEL_ADD_ALPHA, swap_add_alpha },
+  { GDK_MEMORY_R8G8B8A8, GDK_MEMORY_B8G8R8, KERNEL_ADD_ALPHA, swap_add_alpha },
+  { GDK_MEMORY_B8G8R8A8, GDK_MEMORY_B8G8R8, KERNEL_ADD_ALPHA, keep_add_alpha },
+  { GDK_MEMORY_R8G8B8A8_PREMULTIPLIED, GDK_MEMORY_R8G8B8, KERNEL_ADD_ALPHA, keep_add_alpha },
+  { GDK_MEMORY_B8G8R8A8_PREMULTIPLIED, GDK_MEMORY_R8G8B8, KERNEL_ADD_ALPHA, swap_add_alpha },
+  { GDK_MEMORY_R8G8B8A8_PREMULTIPLIED, GDK_MEMORY_B8G8R8, KERNEL_ADD_ALPHA, swap_add_alpha },
+  { GDK_MEMORY_B8G8R8A8_PREMULTIPLIED, GDK_MEMORY_B8G8R8, KERNEL_ADD_ALPHA, keep_add_alpha },
+
+  { GDK_MEMORY_R8G8B8A8, GDK_MEMORY_R16G16B16A16_FLOAT, KERNEL_HALF_TO_U8, keep },
+  { GDK_MEMORY_B8G8R8A8, GDK_MEMORY_R16G16B16A16_FLOAT, KERNEL_HALF_TO_U8, swap },
+  { GDK_MEMORY_R8G8B8A8_PREMULTIPLIED, GDK_MEMORY_R16G16B16A16_FLOAT_PREMULTIPLIED, KERNEL_HALF_TO_U8, keep },
+  { GDK_MEMORY_B8G8R8A8_PREMULTIPLIED, GDK_MEMORY_R16G16B16A16_FLOAT_PREMULTIPLIED, KERNEL_HALF_TO_U8, swap },
+
+  { GDK_MEMORY_R16G16B16A16_FLOAT, GDK_MEMORY_R8G8B8A8, KERNEL_U8_TO_HALF, keep },
+  { GDK_MEMORY_R16G16B16A16_FLOAT, GDK_MEMORY_B8G8R8A8, KERNEL_U8_TO_HALF, swap },
+  { GDK_MEMORY_R16G16B16A16_FLOAT_PREMULTIPLIED, GDK_MEMORY_R8G8B8A8_PREMULTIPLIED, KERNEL_U8_TO_HALF, keep },
+  { GDK_MEMORY_R16G16B16A16_FLOAT_PREMULTIPLIED, GDK_MEMORY_B8G8R8A8_PREMULTIPLIED, KERNEL_U8_TO_HALF, swap },
+};
+
+/* Every kernel gets one specialized function per permutation,
+ * so the compiler can build the shuffle masks at compile time.
+ */
+#define DEFINE_KERNEL_FUNCS(kernel, suffix, attr) \
+  SIMD_FUNC (kernel ## _keep_ ## suffix, kernel ## _ ## suffix, keep, attr) \
+  SIMD_FUNC (kernel ## _swap_ ## suffix, kernel ## _ ## suffix, swap, attr)
+
+#define DEFINE_ADD_ALPHA_FUNCS(suffix, attr) \
+  SIMD_FUNC (add_alpha_keep_ ## suffix, add_alpha_ ## suffix, keep_add_alpha, attr) \
+  SIMD_FUNC (add_alpha_swap_ ## suffix, add_alpha_ ## suffix, swap_add_alpha, attr)
+
+#define PICK(kernel, perm, suffix) \
+  ((perm) == keep || (perm) == keep_add_alpha ? kernel ## _keep_ ## suffix : kernel ## _swap_ ## suffix)
+
+#ifdef HAVE_X86_SIMD
+DEFINE_KERNEL_FUNCS (swizzle, sse41, SSE41)
+DEFINE_KERNEL_FUNCS (swizzle, avx2, AVX2)
+DEFINE_KERNEL_FUNCS (premultiply, sse41, SSE41)
+DEFINE_KERNEL_FUNCS (premultiply, avx2, AVX2)
+DEFINE_KERNEL_FUNCS (unpremultiply, sse41, SSE41)
+DEFINE_ADD_ALPHA_FUNCS (sse41, SSE41)
+DEFINE_KERNEL_FUNCS (half_to_u8, f16c, F16C)
+DEFINE_KERNEL_FUNCS (u8_to_half, f16c, F16C)
+
+static GdkMemorySimdFunc
+get_x86_func (const SimdConversion *conv)
+{
+  switch (conv->kernel)
+    {
+    case KERNEL_SWIZZLE:
+      if (have_avx2 ())
+        return PICK (swizzle, conv->perm, avx2);
+      if (have_sse41 ())
+        return PICK (swizzle, conv->perm, sse41);
+      break;
+
+    case KERNEL_PREMULTIPLY:
+      if (have_avx2 ())
+        return PICK (premultiply, conv->perm, avx2);
+      if (have_sse41 ())
+        return PICK (premultiply, conv->perm, sse41);
+      break;
+
+    case KERNEL_UNPREMULTIPLY:
+      if (have_sse41 ())
+        return PICK (unpremultiply, conv->perm, sse41);
+      break;
+
+    case KERNEL_ADD_ALPHA:
+      if (have_sse41 ())
+        return PICK (add_alpha, conv->perm, sse41);
+      break;
+
+    case KERNEL_HALF_TO_U8:
+      if (have_f16c ())
+        return PICK (half_to_u8, conv->perm, f16c);
+      break;
+
+    case KERNEL_U8_TO_HALF:
+      if (have_f16c ())
+        return PICK (u8_to_half, conv->perm, f16c);
+      break;
+
+    default:
+      g_assert_not_reached ();
+    }
+
+  return NULL;
+}
+#endif
+
+#ifdef HAVE_NEON
+#define NEON
+DEFINE_KERNEL_FUNCS (swizzle, neon, NEON)
+DEFINE_KERNEL_FUNCS (premultiply, neon, NEON)
+DEFINE_ADD_ALPHA_FUNCS (neon, NEON)
+
+static GdkMemorySimdFunc
+get_neon_func (const SimdConversion *conv)
+{
+  switch (conv->kernel)
+    {
+    case KERNEL_SWIZZLE:
+      return PICK (swizzle, conv->perm, neon);
+
+    case KERNEL_PREMULTIPLY:
+      return PICK (premultiply, conv->perm, neon);
+
+    case KERNEL_ADD_ALPHA:
+      return PICK (add_alpha, conv->perm, neon);
+
+    case KERNEL_UNPREMULTIPLY:
+    case KERNEL_HALF_TO_U8:
+    case KERNEL_U8_TO_HALF:
+      return NULL;
+
+    default:
+      g_assert_not_reached ();
+    }
+}
+#endif
+
+/*<private>
+ * gdk_memory_simd_get_conversion_func:
+ * @dest_format: the format to convert to
+ * @src_format: the format to convert from
+ *
+ * Looks up a vectorized function to convert rows of pixels
+ * from @src_format to @dest_format, if the CPU supports one.
+ *
+ * Returns: (nullable): the conversion function
+ */
+GdkMemorySimdFunc
+gdk_memory_simd_get_conversion_func (GdkMemoryFormat dest_format,
+                                     GdkMemoryFormat src_format)
+{
+  for (gsize i = 0; i < G_N_ELEMENTS (conversions); i++)
+    {
+      const SimdConversion *conv = &conversions[i];
+
+      if (conv->dest_format != dest_format || conv->src_format != src_format)
+        continue;
+
+#if defined(HAVE_X86_SIMD)
+      return get_x86_func (conv);
+#elif defined(HAVE_NEON)
+      return get_neon_func (conv);
+#else
+      return NULL;
+#endif
+    }
+
+  return NULL;
+}
+
+/* }}} */
+
+/* vim:set foldmethod=marker expandtab: */
@@ -26,6 +26,7 @@
 #include "gdkmemorytextureprivate.h"
 
 #include <cairo-gobject.h>
+#include <glib/gi18n-lib.h>
 
 struct _GdkMemoryTextureBuilder
 {
@@ -376,6 +377,126 @@ gdk_memory_texture_builder_set_bytes (GdkMemoryTextureBuilder *self,
   g_object_notify_by_pspec (G_OBJECT (self), properties[PROP_BYTES]);
 }
 
+static gboolean
+gdk_memory_texture_builder_set_mapped_file (GdkMemoryTextureBuilder  *self,
+                                            GMappedFile              *mapped_file,
+                                            gsize                     offset,
+                                            GError                  **error)
+{
+  GBytes *file_bytes, *bytes;
+  gsize size;
+
+  size = g_mapped_file_get_length (mapped_file);
+  if (offset >= size)
+    {
+      g_set_error (error,
+                   G_FILE_ERROR, G_FILE_ERROR_INVAL,
+                   _("Offset %" G_GSIZE_FORMAT " is beyond the end of the data (%" G_GSIZE_FORMAT " bytes)"),
+                   offset, size);
+      g_mapped_file_unref (mapped_file);
+      return FALSE;
+    }
+
+  file_bytes = g_mapped_file_get_bytes (mapped_file);
+  g_mapped_file_unref (mapped_file);
+
+  bytes = g_bytes_new_from_bytes (file_bytes, offset, size - offset);
+  g_bytes_unref (file_bytes);
+
+  gdk_memory_texture_builder_set_bytes (self, bytes);
+  g_bytes_unref (bytes);
+
+  return TRUE;
+}
+
+/**
+ * gdk_memory_texture_builder_map_file:
+ * @self: a `GdkMemoryTextureBuilder`
+ * @filename: (type filename): the file containing the pixel data
+ * @offset: the offset of the first pixel in the file
+ * @error: return location for an error
+ *
+ * Maps the file into memory and sets the mapped data, starting
+ * at @offset, as the bytes of the builder.
+ *
+ * The data is never copied. Textures built from it read straight
+ * from the mapping, and so does downloading them when no conversion
+ * is needed. This is useful for large raw images.
+ *
+ * To avoid copies, @offset and the stride must be multiples of the
+ * alignment that the memory format requires, which is at most 4 bytes.
+ *
+ * Textures are immutable, so the file must not be changed or
+ * truncated while textures built from it exist.
+ *
+ * Returns: %TRUE if the file was mapped
+ *
+ * Since: 4.18
+ */
+gboolean
+gdk_memory_texture_builder_map_file (GdkMemoryTextureBuilder  *self,
+                                     const char               *filename,
+                                     gsize                     offset,
+                                     GError                  **error)
+{
+  GMappedFile *mapped_file;
+
+  g_return_val_if_fail (GDK_IS_MEMORY_TEXTURE_BUILDER (self), FALSE);
+  g_return_val_if_fail (filename != NULL, FALSE);
+  g_return_val_if_fail (error == NULL || *error == NULL, FALSE);
+
+  mapped_file = g_mapped_file_new (filename, FALSE, error);
+  if (mapped_file == NULL)
+    return FALSE;
+
+  return gdk_memory_texture_builder_set_mapped_file (self, mapped_file, offset, error);
+}
+
+/**
+ * gdk_memory_texture_builder_map_fd:
+ * @self: a `GdkMemoryTextureBuilder`
+ * @fd: a file descriptor for a file or shared memory
+ * @offset: the offset of the first pixel
+ * @error: return location for an error
+ *
+ * Maps the file descriptor into memory and sets the mapped data,
+ * starting at @offset, as the bytes of the builder.
+ *
+ * This works with regular files as well as shared memory, such as a
+ * memfd that another process renders into. The data is never copied,
+ * see [method@Gdk.MemoryTextureBuilder.map_file] for the requirements
+ * on alignment.
+ *
+ * Textures are immutable, so the data must not be changed or shrunk
+ * while textures built from it exist. For a memfd, this can be ensured
+ * by sealing it with `F_SEAL_WRITE` and `F_SEAL_SHRINK`.
+ *
+ * The builder does not take ownership of @fd, it can be closed
+ * after this function returns.
+ *
+ * Returns: %TRUE if the file descriptor was mapped
+ *
+ * Since: 4.18
+ */
+gboolean
+gdk_memory_texture_builder_map_fd (GdkMemoryTextureBuilder  *self,
+                                   int                       fd,
+                                   gsize                     offset,
+                                   GError                  **error)
+{
+  GMappedFile *mapped_file;
+
+  g_return_val_if_fail (GDK_IS_MEMORY_TEXTURE_BUILDER (self), FALSE);
+  g_return_val_if_fail (fd >= 0, FALSE);
+  g_return_val_if_fail (error == NULL || *error == NULL, FALSE);
+
+  mapped_file = g_mapped_file_new_from_fd (fd, FALSE, error);
+  if (mapped_file == NULL)
+    return FALSE;
+
+  return gdk_memory_texture_builder_set_mapped_file (self, mapped_file, offset, error);
+}
+
 /**
  * gdk_memory_texture_builder_get_color_state:
  * @self: a `GdkMemoryTextureBuilder`
@@ -22,24 +22,456 @@
 #include "gdkparalleltaskprivate.h"
 #include "gdkdebugprivate.h"
 
+/* This is a small fork/join scheduler.
+ *
+ * Every worker thread owns a deque of range tasks. A thread that runs
+ * a task splits it in halves until it is no larger than the grain size,
+ * pushing the upper halves onto the bottom of its own deque, so the
+ * biggest pieces of work sit at the top where idle threads steal them.
+ *
+ * The thread calling gdk_parallel_for() gets a deque of its own for the
+ * duration of the call and takes part in running the job instead of
+ * waiting for it. It only blocks once there is nothing left that it
+ * could run itself.
+ */
+
+typedef struct _GdkParallelJob GdkParallelJob;
+typedef struct _GdkRangeTask GdkRangeTask;
+typedef struct _GdkTaskDeque GdkTaskDeque;
+typedef struct _GdkWorker GdkWorker;
+
+struct _GdkRangeTask
+{
+  GdkParallelJob *job;
+  gsize start;
+  gsize end;
+};
+
+struct _GdkTaskDeque
+{
+  GMutex lock;
+  GdkRangeTask *tasks;
+  gsize size; /* always a power of 2 */
+  gsize top;
+  gsize n_tasks;
+};
+
+struct _GdkParallelJob
+{
+  GdkRangeFunc func;
+  gpointer data;
+  gsize grain;
+
+  /* the deque of the thread that called gdk_parallel_for() */
+  GdkTaskDeque deque;
+  GList link;
+
+  /* atomic */ gsize remaining;
+
+  GMutex lock;
+  GCond cond;
+  gboolean done;
+};
+
+struct _GdkWorker
+{
+  GdkTaskDeque deque;
+  GThread *thread;
+  guint index;
+};
+
+static struct {
+  GMutex lock;
+  GCond cond;
+  /* jobs whose caller deque can be stolen from, protected by lock */
+  GQueue jobs;
+
+  GdkWorker *workers;
+  guint n_workers;
+
+  /* atomic */ int n_sleeping;
+  /* atomic */ int epoch;
+} scheduler;
+
+#define DEQUE_INITIAL_SIZE 16
+
+static void
+gdk_task_deque_init (GdkTaskDeque *self)
+{
+  g_mutex_init (&self->lock);
+  self->size = DEQUE_INITIAL_SIZE;
+  self->tasks = g_new (GdkRangeTask, self->size);
+  self->top = 0;
+  self->n_tasks = 0;
+}
+
+static void
+gdk_task_deque_clear (GdkTaskDeque *self)
+{
+  g_assert (self->n_tasks == 0);
+
+  g_clear_pointer (&self->tasks, g_free);
+  g_mutex_clear (&self->lock);
+}
+
+static inline GdkRangeTask *
+gdk_task_deque_get (GdkTaskDeque *self,
+                    gsize         i)
+{
+  return &self->tasks[(self->top + i) & (self->size - 1)];
+}
+
+static void
+gdk_task_deque_push (GdkTaskDeque       *self,
+                     const GdkRangeTask *task)
+{
+  g_mutex_lock (&self->lock);
+
+  if (self->n_tasks == self->size)
+    {
+      GdkRangeTask *tasks;
+      gsize i;
+
+      tasks = g_new (GdkRangeTask, self->size * 2);
+      for (i = 0; i < self->n_tasks; i++)
+        tasks[i] = *gdk_task_deque_get (self, i);
+      g_free (self->tasks);
+      self->tasks = tasks;
+      self->size *= 2;
+      self->top = 0;
+    }
+
+  *gdk_task_deque_get (self, self->n_tasks) = *task;
+  self->n_tasks++;
+
+  g_mutex_unlock (&self->lock);
+}
+
+/* Takes the most recently pushed task, used by the owner of the deque */
+static gboolean
+gdk_task_deque_pop (GdkTaskDeque *self,
+                    GdkRangeTask *task)
+{
+  gboolean result;
+
+  g_mutex_lock (&self->lock);
+
+  if (self->n_tasks > 0)
+    {
+      self->n_tasks--;
+      *task = *gdk_task_deque_get (self, self->n_tasks);
+      result = TRUE;
+    }
+  else
+    result = FALSE;
+
+  g_mutex_unlock (&self->lock);
+
+  return result;
+}
+
+/* Takes the oldest task, optionally limited to tasks of the given job.
+ * Used by threads that don't own the deque.
+ */
+static gboolean
+gdk_task_deque_steal (GdkTaskDeque   *self,
+                      GdkParallelJob *job,
+                      GdkRangeTask   *task)
+{
+  gsize i, j;
+
+  g_mutex_lock (&self->lock);
+
+  for (i = 0; i < self->n_tasks; i++)
+    {
+      if (job == NULL || gdk_task_deque_get (self, i)->job == job)
+        break;
+    }
+
+  if (i == self->n_tasks)
+    {
+      g_mutex_unlock (&self->lock);
+      return FALSE;
+    }
+
+  *task = *gdk_task_deque_get (self, i);
+  for (j = i; j > 0; j--)
+    *gdk_task_deque_get (self, j) = *gdk_task_deque_get (self, j - 1);
+  self->top = (self->top + 1) & (self->size - 1);
+  self->n_tasks--;
+
+  g_mutex_unlock (&self->lock);
+
+  return TRUE;
+}
+
+static void
+gdk_parallel_notify_work (void)
+{
+  g_atomic_int_inc (&scheduler.epoch);
+
+  if (g_atomic_int_get (&scheduler.n_sleeping) > 0)
+    {
+      g_mutex_lock (&scheduler.lock);
+      g_cond_signal (&scheduler.cond);
+      g_mutex_unlock (&scheduler.lock);
+    }
+}
+
+static void
+gdk_parallel_job_complete (GdkParallelJob *job,
+                           gsize           n_items)
+{
+  if ((gsize) g_atomic_pointer_add (&job->remaining, - (gssize) n_items) != n_items)
+    return;
+
+  g_mutex_lock (&job->lock);
+  job->done = TRUE;
+  g_cond_signal (&job->cond);
+  g_mutex_unlock (&job->lock);
+}
+
+/* Splits the task down to the grain size, leaving the upper halves
+ * in the given deque for whoever gets to them first.
+ */
+static void
+gdk_range_task_run (GdkRangeTask *task,
+                    GdkTaskDeque *deque)
+{
+  GdkParallelJob *job = task->job;
+  gsize start = task->start;
+  gsize end = task->end;
+
+  while (end - start > job->grain)
+    {
+      GdkRangeTask half;
+
+      half.job = job;
+      half.start = start + (end - start) / 2;
+      half.end = end;
+      gdk_task_deque_push (deque, &half);
+      gdk_parallel_notify_work ();
+
+      end = half.start;
+    }
+
+  job->func (start, end, job->data);
+
+  gdk_parallel_job_complete (job, end - start);
+}
+
+static gboolean
+gdk_parallel_steal (GdkWorker      *self,
+                    GdkParallelJob *job,
+                    GdkRangeTask   *task)
+{
+  guint i, start;
+  GList *l;
+
+  start = self ? self->index + 1 : g_random_int_range (0, scheduler.n_workers);
+
+  for (i = 0; i < scheduler.n_workers; i++)
+    {
+      GdkWorker *victim = &scheduler.workers[(start + i) % scheduler.n_workers];
+
+      if (victim == self)
+        continue;
+
+      if (gdk_task_deque_steal (&victim->deque, job, task))
+        return TRUE;
+    }
+
+  if (job != NULL)
+    return FALSE;
+
+  g_mutex_lock (&scheduler.lock);
+
+  for (l = scheduler.jobs.head; l; l = l->next)
+    {
+      GdkParallelJob *other = l->data;
+
+      if (gdk_task_deque_steal (&other->deque, NULL, task))
+        {
+          g_mutex_unlock (&scheduler.lock);
+          return TRUE;
+        }
+    }
+
+  g_mutex_unlock (&scheduler.lock);
+
+  return FALSE;
+}
+
+static gpointer
+gdk_parallel_worker_thread (gpointer data)
+{
+  GdkWorker *self = data;
+  GdkRangeTask task;
+
+  for (;;)
+    {
+      int epoch = g_atomic_int_get (&scheduler.epoch);
+
+      if (gdk_task_deque_pop (&self->deque, &task) ||
+          gdk_parallel_steal (self, NULL, &task))
+        {
+          gdk_range_task_run (&task, &self->deque);
+          continue;
+        }
+
+      /* If new work was announced since we started looking,
+       * look again instead of going to sleep.
+       */
+      g_mutex_lock (&scheduler.lock);
+      g_atomic_int_inc (&scheduler.n_sleeping);
+      if (g_atomic_int_get (&scheduler.epoch) == epoch)
+        g_cond_wait (&scheduler.cond, &scheduler.lock);
+      g_atomic_int_add (&scheduler.n_sleeping, -1);
+      g_mutex_unlock (&scheduler.lock);
+    }
+
+  return NULL;
+}
+
+static gboolean
+gdk_parallel_ensure_workers (void)
+{
+  static gsize initialized = 0;
+
+  if (g_once_init_enter (&initialized))
+    {
+      guint i;
+
+      g_mutex_init (&scheduler.lock);
+      g_cond_init (&scheduler.cond);
+      g_queue_init (&scheduler.jobs);
+
+      scheduler.n_workers = g_get_num_processors () - 1;
+      scheduler.workers = g_new0 (GdkWorker, scheduler.n_workers);
+
+      for (i = 0; i < scheduler.n_workers; i++)
+        {
+          scheduler.workers[i].index = i;
+          gdk_task_deque_init (&scheduler.workers[i].deque);
+        }
+
+      /* Workers steal from each other, so only start them
+       * once all the deques exist.
+       */
+      for (i = 0; i < scheduler.n_workers; i++)
+        scheduler.workers[i].thread = g_thread_new ("gdk-worker",
+                                                    gdk_parallel_worker_thread,
+                                                    &scheduler.workers[i]);
+
+      g_once_init_leave (&initialized, 1);
+    }
+
+  return scheduler.n_workers > 0;
+}
+
+/**
+ * gdk_parallel_for:
+ * @n_items: the number of items to process
+ * @grain: the number of items that is not worth splitting further
+ * @range_func: the function to call for each chunk
+ * @user_data: data to pass to the function
+ *
+ * Calls @range_func for consecutive ranges of items that together
+ * cover 0 to @n_items, spread over as many threads as are useful.
+ *
+ * Every range is at most @grain items long. If the whole range fits
+ * into a single grain, the function is called directly without
+ * involving any other threads.
+ *
+ * The calling thread takes part in the work. Once all ranges have
+ * been processed, this function returns.
+ **/
+void
+gdk_parallel_for (gsize        n_items,
+                  gsize        grain,
+                  GdkRangeFunc range_func,
+                  gpointer     user_data)
+{
+  GdkParallelJob job;
+  GdkRangeTask task;
+
+  if (n_items == 0)
+    return;
+
+  grain = MAX (grain, 1);
+
+  if (n_items <= grain ||
+      !gdk_has_feature (GDK_FEATURE_THREADS) ||
+      !gdk_parallel_ensure_workers ())
+    {
+      gsize start;
+
+      for (start = 0; start < n_items; start += grain)
+        range_func (start, MIN (start + grain, n_items), user_data);
+      return;
+    }
+
+  job.func = range_func;
+  job.data = user_data;
+  job.grain = grain;
+  job.remaining = n_items;
+  job.done = FALSE;
+  g_mutex_init (&job.lock);
+  g_cond_init (&job.cond);
+  gdk_task_deque_init (&job.deque);
+  job.link = (GList) { &job, NULL, NULL };
+
+  g_mutex_lock (&scheduler.lock);
+  g_queue_push_tail_link (&scheduler.jobs, &job.link);
+  g_mutex_unlock (&scheduler.lock);
+
+  task.job = &job;
+  task.start = 0;
+  task.end = n_items;
+
+  do
+    {
+      gdk_range_task_run (&task, &job.deque);
+    }
+  while (gdk_task_deque_pop (&job.deque, &task) ||
+         gdk_parallel_steal (NULL, &job, &task));
+
+  /* Our deque is empty and nothing but us ever pushes to it,
+   * so nobody needs to look at it anymore.
+   */
+  g_mutex_lock (&scheduler.lock);
+  g_queue_unlink (&scheduler.jobs, &job.link);
+  g_mutex_unlock (&scheduler.lock);
+
+  /* The remaining work is running on other threads */
+  g_mutex_lock (&job.lock);
+  while (!job.done)
+    g_cond_wait (&job.cond, &job.lock);
+  g_mutex_unlock (&job.lock);
+
+  gdk_task_deque_clear (&job.deque);
+  g_cond_clear (&job.cond);
+  g_mutex_clear (&job.lock);
+}
+
 typedef struct _TaskData TaskData;
 
 struct _TaskData
 {
   GdkTaskFunc task_func;
   gpointer task_data;
-  int n_running_tasks;
 };
 
 static void
-gdk_parallel_task_thread_func (gpointer data,
-                               gpointer unused)
+gdk_parallel_task_run_range (gsize    start,
+                             gsize    end,
+                             gpointer data)
 {
   TaskData *task = data;
+  gsize i;
 
-  task->task_func (task->task_data);
-
-  g_atomic_int_add (&task->n_running_tasks, -1);
+  for (i = start; i < end; i++)
+    task->task_func (task->task_data);
 }
 
 /**
@@ -50,48 +482,30 @@ gdk_parallel_task_thread_func (gpointer data,
  *
  * Spawns the given function in many threads.
  * Once all functions have exited, this function returns.
+ *
+ * New code should prefer gdk_parallel_for(), which splits
+ * the work itself.
  **/
 void
 gdk_parallel_task_run (GdkTaskFunc task_func,
                        gpointer    task_data,
                        guint       max_tasks)
 {
-  static GThreadPool *pool;
   TaskData task = {
     .task_func = task_func,
     .task_data = task_data,
   };
-  int i, n_tasks;
 
-  if (max_tasks == 1 || !gdk_has_feature (GDK_FEATURE_THREADS))
+  if (max_tasks <= 1 ||
+      !gdk_has_feature (GDK_FEATURE_THREADS) ||
+      !gdk_parallel_ensure_workers ())
     {
       task_func (task_data);
       return;
     }
 
-  if (g_once_init_enter (&pool))
-    {
-      guint num_threads = CLAMP (2, g_get_num_processors () - 1, 32);
-      GThreadPool *the_pool = g_thread_pool_new (gdk_parallel_task_thread_func,
-                                                 NULL,
-                                                 num_threads,
-                                                 FALSE,
-                                                 NULL);
-      g_thread_pool_set_max_unused_threads (num_threads);
-      g_once_init_leave (&pool, the_pool);
-    }
-
-  n_tasks = MIN (max_tasks, g_get_num_processors ());
-  task.n_running_tasks = n_tasks;
-  /* Start with 1 because we run 1 task ourselves */
-  for (i = 1; i < n_tasks; i++)
-    {
-      g_thread_pool_push (pool, &task, NULL);
-    }
-
-  gdk_parallel_task_thread_func (&task, NULL);
-
-  while (g_atomic_int_get (&task.n_running_tasks) > 0)
-    g_thread_yield ();
+  gdk_parallel_for (MIN (max_tasks, scheduler.n_workers + 1),
+                    1,
+                    gdk_parallel_task_run_range,
+                    &task);
 }
-
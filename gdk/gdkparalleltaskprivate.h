@@ -24,10 +24,17 @@
 G_BEGIN_DECLS
 
 typedef void (* GdkTaskFunc) (gpointer user_data);
+typedef void (* GdkRangeFunc) (gsize    start,
+                               gsize    end,
+                               gpointer user_data);
 
 void                    gdk_parallel_task_run               (GdkTaskFunc                 task_func,
                                                              gpointer                    task_data,
                                                              guint                       max_tasks);
+void                    gdk_parallel_for                    (gsize                       n_items,
+                                                             gsize                       grain,
+                                                             GdkRangeFunc                range_func,
+                                                             gpointer                    user_data);
 
 G_END_DECLS
 
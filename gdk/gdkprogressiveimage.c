@@ -0,0 +1,1129 @@
+/* GDK - The GIMP Drawing Kit
+ * Copyright (C) 2026 the GTK team
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "config.h"
+
+#include "gdkprogressiveimageprivate.h"
+
+#include "gdkcolorstateprivate.h"
+#include "gdkmemorytexturebuilder.h"
+#include "gdkpaintable.h"
+#include "gdkprivate.h"
+#include "gdktextureprivate.h"
+
+#include <glib/gi18n-lib.h>
+#include "loaders/gdkpngprivate.h"
+#include "loaders/gdkjpegprivate.h"
+
+/* HACK: So we don't need to include any (not-yet-created) GSK or GTK headers */
+void
+gtk_snapshot_append_texture (GdkSnapshot            *snapshot,
+                             GdkTexture             *texture,
+                             const graphene_rect_t  *bounds);
+
+/**
+ * GdkProgressiveImage:
+ *
+ * `GdkProgressiveImage` is a [iface@Gdk.Paintable] that shows an image
+ * while it is being loaded.
+ *
+ * The image data is read from a `GInputStream` with
+ * [method@Gdk.ProgressiveImage.load_async], and decoded in a thread as
+ * it arrives. Whenever more of the image has been decoded, the paintable's
+ * contents are invalidated, so that widgets showing it are redrawn.
+ * Progressive JPEGs show a coarse version of the whole image early, which
+ * is refined while loading continues. Interlaced PNGs are filled in pass
+ * by pass, starting with a sparse grid of pixels.
+ *
+ * While loading, the image is shown as horizontal bands, and updates only
+ * replace the bands that changed. Updates happen at most every 50
+ * milliseconds. Bands that won't change anymore share the decoder's
+ * buffer, and only bands that are still being decoded are copied. For
+ * images that are decoded from top to bottom, this keeps the memory
+ * needed close to the size of the image. Interlaced PNGs and progressive
+ * JPEGs refine all rows until the last pass, so they can need memory for
+ * two copies of the image while loading.
+ *
+ * Once loading is complete, the decoded data is handed to the final
+ * texture without another copy.
+ *
+ * PNG and JPEG images are decoded incrementally. Other formats are shown
+ * once they are completely loaded.
+ *
+ * Since: 4.18
+ */
+
+#define READ_CHUNK_SIZE (64 * 1024)
+#define PUBLISH_INTERVAL_MS 50
+#define BAND_HEIGHT 64
+#define SIGNATURE_SIZE 8
+
+#define N_BANDS(height) (((height) + BAND_HEIGHT - 1) / BAND_HEIGHT)
+
+struct _GdkProgressiveImage
+{
+  GObject parent_instance;
+
+  /* Used in the main thread */
+  int width;
+  int height;
+  GdkTexture **bands;           /* shown while loading, NULL once complete */
+  GdkTexture *texture;          /* the complete image, or the bands combined */
+  GMainContext *context;
+  guint loading : 1;
+
+  /* Passed from the decoding thread to the main thread */
+  GMutex lock;
+  gboolean pending_reset;       /* a new image was started */
+  int pending_width;
+  int pending_height;
+  GdkTexture **pending_bands;
+  GdkTexture *pending_texture;
+  GSource *apply_source;
+
+  /* Used in the decoding thread while loading */
+  GdkStreamDecoder *decoder;
+  GByteArray *head;             /* data received before the format is known */
+  GdkMemoryFormat format;
+  GdkColorState *color_state;
+  GBytes *bytes;                /* the decoder's buffer */
+  guchar *data;
+  gsize stride;
+  int dirty_start;              /* rows changed since the last publish */
+  int dirty_end;
+  gint64 last_publish_time;
+  int *complete_rows;           /* per band, rows that won't change anymore */
+  GdkTexture **decoded_bands;   /* the last published texture per band */
+};
+
+struct _GdkProgressiveImageClass
+{
+  GObjectClass parent_class;
+};
+
+enum
+{
+  PROP_0,
+  PROP_LOADING,
+  PROP_TEXTURE,
+
+  N_PROPS
+};
+
+static GParamSpec *properties[N_PROPS] = { NULL, };
+
+static void
+free_bands (GdkTexture **bands,
+            int          height)
+{
+  int i;
+
+  if (bands == NULL)
+    return;
+
+  for (i = 0; i < N_BANDS (height); i++)
+    g_clear_object (&bands[i]);
+
+  g_free (bands);
+}
+
+/* {{{ Fallback decoder */
+
+/* Collects all the data and loads it in the end, for the formats
+ * that can't be decoded incrementally.
+ */
+typedef struct
+{
+  GdkStreamDecoder decoder;
+  GByteArray *data;
+} GdkBufferDecoder;
+
+static gboolean
+gdk_buffer_decoder_feed (GdkStreamDecoder  *decoder,
+                         const guchar      *data,
+                         gsize              size,
+                         GError           **error)
+{
+  GdkBufferDecoder *self = (GdkBufferDecoder *) decoder;
+
+  g_byte_array_append (self->data, data, size);
+
+  return TRUE;
+}
+
+static gboolean
+gdk_buffer_decoder_close (GdkStreamDecoder  *decoder,
+                          GError           **error)
+{
+  GdkBufferDecoder *self = (GdkBufferDecoder *) decoder;
+  GdkTexture *texture;
+  GBytes *bytes;
+
+  bytes = g_byte_array_free_to_bytes (g_steal_pointer (&self->data));
+  texture = gdk_texture_new_from_bytes (bytes, error);
+  g_bytes_unref (bytes);
+  if (texture == NULL)
+    return FALSE;
+
+  gdk_progressive_image_set_texture (decoder->image, texture);
+  g_object_unref (texture);
+
+  return TRUE;
+}
+
+static void
+gdk_buffer_decoder_free (GdkStreamDecoder *decoder)
+{
+  GdkBufferDecoder *self = (GdkBufferDecoder *) decoder;
+
+  g_clear_pointer (&self->data, g_byte_array_unref);
+  g_free (self);
+}
+
+static const GdkStreamDecoderClass GDK_BUFFER_DECODER_CLASS = {
+  gdk_buffer_decoder_feed,
+  gdk_buffer_decoder_close,
+  gdk_buffer_decoder_free,
+};
+
+static GdkStreamDecoder *
+gdk_buffer_decoder_new (GdkProgressiveImage *image)
+{
+  GdkBufferDecoder *self;
+
+  self = g_new0 (GdkBufferDecoder, 1);
+  self->decoder.klass = &GDK_BUFFER_DECODER_CLASS;
+  self->decoder.image = image;
+  self->data = g_byte_array_new ();
+
+  return (GdkStreamDecoder *) self;
+}
+
+/* }}} */
+/* {{{ Showing results in the main thread */
+
+static void
+gdk_progressive_image_apply (GdkProgressiveImage *self)
+{
+  GdkTexture **pending_bands;
+  GdkTexture *texture;
+  gboolean reset, size_changed;
+  int i, width, height;
+
+  g_mutex_lock (&self->lock);
+  g_clear_pointer (&self->apply_source, g_source_destroy);
+  reset = self->pending_reset;
+  self->pending_reset = FALSE;
+  width = self->pending_width;
+  height = self->pending_height;
+  texture = g_steal_pointer (&self->pending_texture);
+  if (!reset && texture == NULL && self->pending_bands == NULL)
+    {
+      g_mutex_unlock (&self->lock);
+      return;
+    }
+  if (reset)
+    {
+      pending_bands = g_steal_pointer (&self->pending_bands);
+      if (texture == NULL)
+        self->pending_bands = g_new0 (GdkTexture *, N_BANDS (height));
+    }
+  else if (self->pending_bands)
+    {
+      pending_bands = g_memdup2 (self->pending_bands, sizeof (GdkTexture *) * N_BANDS (height));
+      memset (self->pending_bands, 0, sizeof (GdkTexture *) * N_BANDS (height));
+    }
+  else
+    pending_bands = NULL;
+  g_mutex_unlock (&self->lock);
+
+  size_changed = self->width != width || self->height != height;
+
+  if (reset)
+    {
+      free_bands (self->bands, self->height);
+      self->bands = NULL;
+      g_clear_object (&self->texture);
+      self->width = width;
+      self->height = height;
+      if (texture == NULL)
+        self->bands = g_new0 (GdkTexture *, N_BANDS (height));
+    }
+
+  if (texture)
+    {
+      /* Done, the bands are no longer needed */
+      free_bands (self->bands, self->height);
+      self->bands = NULL;
+      g_set_object (&self->texture, texture);
+      g_object_unref (texture);
+    }
+  else if (pending_bands && self->bands)
+    {
+      for (i = 0; i < N_BANDS (self->height); i++)
+        {
+          if (pending_bands[i])
+            {
+              g_set_object (&self->bands[i], pending_bands[i]);
+              /* The combined texture is outdated */
+              g_clear_object (&self->texture);
+            }
+        }
+    }
+
+  free_bands (pending_bands, height);
+
+  if (size_changed)
+    gdk_paintable_invalidate_size (GDK_PAINTABLE (self));
+  gdk_paintable_invalidate_contents (GDK_PAINTABLE (self));
+  g_object_notify_by_pspec (G_OBJECT (self), properties[PROP_TEXTURE]);
+}
+
+static gboolean
+gdk_progressive_image_apply_cb (gpointer data)
+{
+  GdkProgressiveImage *self = data;
+
+  gdk_progressive_image_apply (self);
+
+  return G_SOURCE_REMOVE;
+}
+
+/* Must be called with the lock held */
+static void
+gdk_progressive_image_queue_apply (GdkProgressiveImage *self)
+{
+  if (self->apply_source)
+    return;
+
+  self->apply_source = g_idle_source_new ();
+  g_source_set_callback (self->apply_source, gdk_progressive_image_apply_cb, self, NULL);
+  g_source_set_static_name (self->apply_source, "[gtk] gdk_progressive_image_apply");
+  g_source_attach (self->apply_source, self->context);
+  g_source_unref (self->apply_source);
+}
+
+/* Copies the bands into a single texture, for get_texture() */
+static GdkTexture *
+gdk_progressive_image_combine_bands (GdkProgressiveImage *self)
+{
+  GdkMemoryTextureBuilder *builder;
+  GdkTexture *texture, *first = NULL;
+  GdkMemoryFormat format;
+  GdkColorState *color_state;
+  GBytes *bytes;
+  guchar *data;
+  gsize stride;
+  int i;
+
+  for (i = 0; i < N_BANDS (self->height) && first == NULL; i++)
+    first = self->bands[i];
+
+  if (first == NULL)
+    return NULL;
+
+  format = gdk_texture_get_format (first);
+  color_state = gdk_texture_get_color_state (first);
+  stride = self->width * gdk_memory_format_bytes_per_pixel (format);
+  data = g_malloc0_n (self->height, stride);
+
+  for (i = 0; i < N_BANDS (self->height); i++)
+    {
+      if (self->bands[i])
+        gdk_texture_do_download (self->bands[i], format, color_state,
+                                 data + i * BAND_HEIGHT * stride, stride);
+    }
+
+  bytes = g_bytes_new_take (data, self->height * stride);
+
+  builder = gdk_memory_texture_builder_new ();
+  gdk_memory_texture_builder_set_format (builder, format);
+  gdk_memory_texture_builder_set_color_state (builder, color_state);
+  gdk_memory_texture_builder_set_width (builder, self->width);
+  gdk_memory_texture_builder_set_height (builder, self->height);
+  gdk_memory_texture_builder_set_bytes (builder, bytes);
+  gdk_memory_texture_builder_set_stride (builder, stride);
+  texture = gdk_memory_texture_builder_build (builder);
+  g_object_unref (builder);
+  g_bytes_unref (bytes);
+
+  return texture;
+}
+
+/* }}} */
+/* {{{ Decoding thread */
+
+/* Makes textures for the bands that changed and passes them
+ * to the main thread. Bands that are complete share the buffer,
+ * the others are copied, since the decoder still writes to them.
+ */
+static void
+gdk_progressive_image_publish (GdkProgressiveImage *self)
+{
+  int i;
+
+  if (self->dirty_start >= self->dirty_end)
+    return;
+
+  for (i = self->dirty_start / BAND_HEIGHT; i <= (self->dirty_end - 1) / BAND_HEIGHT; i++)
+    {
+      GdkMemoryTextureBuilder *builder;
+      GdkTexture *texture;
+      GBytes *bytes;
+      int y, height;
+
+      y = i * BAND_HEIGHT;
+      height = MIN (BAND_HEIGHT, self->pending_height - y);
+
+      if (self->complete_rows[i] >= height)
+        bytes = g_bytes_new_from_bytes (self->bytes, y * self->stride, height * self->stride);
+      else
+        bytes = g_bytes_new (self->data + y * self->stride, height * self->stride);
+
+      builder = gdk_memory_texture_builder_new ();
+      gdk_memory_texture_builder_set_format (builder, self->format);
+      gdk_memory_texture_builder_set_color_state (builder, self->color_state);
+      gdk_memory_texture_builder_set_width (builder, self->pending_width);
+      gdk_memory_texture_builder_set_height (builder, height);
+      gdk_memory_texture_builder_set_bytes (builder, bytes);
+      gdk_memory_texture_builder_set_stride (builder, self->stride);
+
+      if (self->decoded_bands[i])
+        {
+          cairo_region_t *region;
+          int start, end;
+
+          start = MAX (self->dirty_start, y) - y;
+          end = MIN (self->dirty_end, y + height) - y;
+          region = cairo_region_create_rectangle (&(cairo_rectangle_int_t) {
+                                                    0, start,
+                                                    self->pending_width, end - start
+                                                  });
+          gdk_memory_texture_builder_set_update_texture (builder, self->decoded_bands[i]);
+          gdk_memory_texture_builder_set_update_region (builder, region);
+          cairo_region_destroy (region);
+        }
+
+      texture = gdk_memory_texture_builder_build (builder);
+      g_object_unref (builder);
+      g_bytes_unref (bytes);
+
+      g_set_object (&self->decoded_bands[i], texture);
+
+      g_mutex_lock (&self->lock);
+      if (self->pending_bands)
+        g_set_object (&self->pending_bands[i], texture);
+      g_mutex_unlock (&self->lock);
+
+      g_object_unref (texture);
+    }
+
+  self->dirty_start = self->pending_height;
+  self->dirty_end = 0;
+  self->last_publish_time = g_get_monotonic_time ();
+
+  g_mutex_lock (&self->lock);
+  gdk_progressive_image_queue_apply (self);
+  g_mutex_unlock (&self->lock);
+}
+
+/* When done, the buffer is handed over instead of copied */
+static void
+gdk_progressive_image_publish_final (GdkProgressiveImage *self)
+{
+  GdkMemoryTextureBuilder *builder;
+  GdkTexture *texture;
+
+  builder = gdk_memory_texture_builder_new ();
+  gdk_memory_texture_builder_set_format (builder, self->format);
+  gdk_memory_texture_builder_set_color_state (builder, self->color_state);
+  gdk_memory_texture_builder_set_width (builder, self->pending_width);
+  gdk_memory_texture_builder_set_height (builder, self->pending_height);
+  gdk_memory_texture_builder_set_bytes (builder, self->bytes);
+  gdk_memory_texture_builder_set_stride (builder, self->stride);
+  texture = gdk_memory_texture_builder_build (builder);
+  g_object_unref (builder);
+
+  gdk_progressive_image_set_texture (self, texture);
+  g_object_unref (texture);
+}
+
+static void
+gdk_progressive_image_create_decoder (GdkProgressiveImage *self)
+{
+  GBytes *bytes;
+
+  bytes = g_bytes_new_static (self->head->data, self->head->len);
+
+  if (gdk_is_png (bytes))
+    self->decoder = gdk_png_stream_decoder_new (self);
+  else if (gdk_is_jpeg (bytes))
+    self->decoder = gdk_jpeg_stream_decoder_new (self);
+  else
+    self->decoder = gdk_buffer_decoder_new (self);
+
+  g_bytes_unref (bytes);
+}
+
+static gboolean
+gdk_progressive_image_feed (GdkProgressiveImage  *self,
+                            const guchar         *data,
+                            gsize                 size,
+                            GError              **error)
+{
+  gboolean result;
+
+  if (self->decoder)
+    return self->decoder->klass->feed (self->decoder, data, size, error);
+
+  /* Wait until the format can be detected */
+  g_byte_array_append (self->head, data, size);
+  if (self->head->len < SIGNATURE_SIZE)
+    return TRUE;
+
+  gdk_progressive_image_create_decoder (self);
+  result = self->decoder->klass->feed (self->decoder, self->head->data, self->head->len, error);
+  g_clear_pointer (&self->head, g_byte_array_unref);
+
+  return result;
+}
+
+static gboolean
+gdk_progressive_image_close (GdkProgressiveImage  *self,
+                             GError              **error)
+{
+  if (self->decoder == NULL)
+    {
+      gdk_progressive_image_create_decoder (self);
+      if (!self->decoder->klass->feed (self->decoder, self->head->data, self->head->len, error))
+        return FALSE;
+    }
+
+  return self->decoder->klass->close (self->decoder, error);
+}
+
+static void
+gdk_progressive_image_decode_thread (GTask        *task,
+                                     gpointer      source_object,
+                                     gpointer      task_data,
+                                     GCancellable *cancellable)
+{
+  GdkProgressiveImage *self = source_object;
+  GAsyncQueue *chunks = task_data;
+  GError *error = NULL;
+  gboolean ok;
+
+  self->head = g_byte_array_new ();
+
+  for (;;)
+    {
+      GBytes *bytes;
+      gint64 wait;
+
+      /* Show what has been decoded while waiting for more data */
+      wait = self->last_publish_time + PUBLISH_INTERVAL_MS * G_TIME_SPAN_MILLISECOND - g_get_monotonic_time ();
+      if (self->dirty_start < self->dirty_end && wait <= 0)
+        gdk_progressive_image_publish (self);
+
+      if (self->dirty_start < self->dirty_end)
+        {
+          bytes = g_async_queue_timeout_pop (chunks, MAX (wait, 0));
+          if (bytes == NULL)
+            continue;
+        }
+      else
+        bytes = g_async_queue_pop (chunks);
+
+      if (g_cancellable_set_error_if_cancelled (cancellable, &error))
+        ok = FALSE;
+      else if (g_bytes_get_size (bytes) == 0)
+        ok = gdk_progressive_image_close (self, &error);
+      else
+        ok = gdk_progressive_image_feed (self,
+                                         g_bytes_get_data (bytes, NULL),
+                                         g_bytes_get_size (bytes),
+                                         &error);
+
+      if (!ok || g_bytes_get_size (bytes) == 0)
+        {
+          g_bytes_unref (bytes);
+          break;
+        }
+
+      g_bytes_unref (bytes);
+    }
+
+  /* Whatever was decoded so far stays visible */
+  if (ok && self->bytes)
+    gdk_progressive_image_publish_final (self);
+  else
+    gdk_progressive_image_publish (self);
+
+  if (self->decoder)
+    {
+      self->decoder->klass->free (self->decoder);
+      self->decoder = NULL;
+    }
+  g_clear_pointer (&self->head, g_byte_array_unref);
+  g_clear_pointer (&self->bytes, g_bytes_unref);
+  self->data = NULL;
+  g_clear_pointer (&self->color_state, gdk_color_state_unref);
+  g_clear_pointer (&self->complete_rows, g_free);
+  free_bands (self->decoded_bands, self->pending_height);
+  self->decoded_bands = NULL;
+
+  if (ok)
+    g_task_return_boolean (task, TRUE);
+  else
+    g_task_return_error (task, error);
+}
+
+/* }}} */
+/* {{{ Loading */
+
+typedef struct
+{
+  GInputStream *stream;
+  GAsyncQueue *chunks;          /* data for the decoding thread */
+  GError *read_error;
+  GError *decode_error;
+  guint reading : 1;
+  guint decoding : 1;
+} LoadData;
+
+static void
+load_data_free (gpointer data)
+{
+  LoadData *load = data;
+
+  g_object_unref (load->stream);
+  g_async_queue_unref (load->chunks);
+  g_clear_error (&load->read_error);
+  g_clear_error (&load->decode_error);
+  g_free (load);
+}
+
+static void
+gdk_progressive_image_maybe_finish (GTask *task)
+{
+  GdkProgressiveImage *self = g_task_get_source_object (task);
+  LoadData *load = g_task_get_task_data (task);
+
+  if (load->reading || load->decoding)
+    return;
+
+  gdk_progressive_image_apply (self);
+
+  self->loading = FALSE;
+  g_object_notify_by_pspec (G_OBJECT (self), properties[PROP_LOADING]);
+
+  if (load->read_error)
+    g_task_return_error (task, g_steal_pointer (&load->read_error));
+  else if (load->decode_error)
+    g_task_return_error (task, g_steal_pointer (&load->decode_error));
+  else
+    g_task_return_boolean (task, TRUE);
+
+  g_object_unref (task);
+}
+
+static void
+gdk_progressive_image_decode_done (GObject      *source,
+                                   GAsyncResult *result,
+                                   gpointer      data)
+{
+  GTask *task = data;
+  LoadData *load = g_task_get_task_data (task);
+
+  g_task_propagate_boolean (G_TASK (result), &load->decode_error);
+  load->decoding = FALSE;
+
+  gdk_progressive_image_maybe_finish (task);
+}
+
+static void gdk_progressive_image_read_next (GTask *task);
+
+static void
+gdk_progressive_image_read_cb (GObject      *source,
+                               GAsyncResult *result,
+                               gpointer      data)
+{
+  GTask *task = data;
+  LoadData *load = g_task_get_task_data (task);
+  GBytes *bytes;
+
+  bytes = g_input_stream_read_bytes_finish (G_INPUT_STREAM (source), result, &load->read_error);
+
+  /* Keep reading until the end, unless decoding failed already */
+  if (bytes && g_bytes_get_size (bytes) > 0 && load->decoding)
+    {
+      g_async_queue_push (load->chunks, bytes);
+      gdk_progressive_image_read_next (task);
+      return;
+    }
+
+  g_clear_pointer (&bytes, g_bytes_unref);
+
+  /* An empty chunk ends decoding */
+  g_async_queue_push (load->chunks, g_bytes_new (NULL, 0));
+  load->reading = FALSE;
+
+  gdk_progressive_image_maybe_finish (task);
+}
+
+static void
+gdk_progressive_image_read_next (GTask *task)
+{
+  LoadData *load = g_task_get_task_data (task);
+
+  g_input_stream_read_bytes_async (load->stream,
+                                   READ_CHUNK_SIZE,
+                                   g_task_get_priority (task),
+                                   g_task_get_cancellable (task),
+                                   gdk_progressive_image_read_cb,
+                                   task);
+}
+
+/* }}} */
+/* {{{ Paintable implementation */
+
+static void
+gdk_progressive_image_paintable_snapshot (GdkPaintable *paintable,
+                                          GdkSnapshot  *snapshot,
+                                          double        width,
+                                          double        height)
+{
+  GdkProgressiveImage *self = GDK_PROGRESSIVE_IMAGE (paintable);
+  double scale;
+  int i;
+
+  if (self->bands == NULL)
+    {
+      if (self->texture)
+        gdk_paintable_snapshot (GDK_PAINTABLE (self->texture), snapshot, width, height);
+      return;
+    }
+
+  scale = height / self->height;
+
+  for (i = 0; i < N_BANDS (self->height); i++)
+    {
+      if (self->bands[i] == NULL)
+        continue;
+
+      gtk_snapshot_append_texture (snapshot,
+                                   self->bands[i],
+                                   &GRAPHENE_RECT_INIT (0, i * BAND_HEIGHT * scale,
+                                                        width, gdk_texture_get_height (self->bands[i]) * scale));
+    }
+}
+
+static int
+gdk_progressive_image_paintable_get_intrinsic_width (GdkPaintable *paintable)
+{
+  GdkProgressiveImage *self = GDK_PROGRESSIVE_IMAGE (paintable);
+
+  return self->width;
+}
+
+static int
+gdk_progressive_image_paintable_get_intrinsic_height (GdkPaintable *paintable)
+{
+  GdkProgressiveImage *self = GDK_PROGRESSIVE_IMAGE (paintable);
+
+  return self->height;
+}
+
+static void
+gdk_progressive_image_paintable_init (GdkPaintableInterface *iface)
+{
+  iface->snapshot = gdk_progressive_image_paintable_snapshot;
+  iface->get_intrinsic_width = gdk_progressive_image_paintable_get_intrinsic_width;
+  iface->get_intrinsic_height = gdk_progressive_image_paintable_get_intrinsic_height;
+}
+
+/* }}} */
+/* {{{ GObject implementation */
+
+G_DEFINE_TYPE_WITH_CODE (GdkProgressiveImage, gdk_progressive_image, G_TYPE_OBJECT,
+                         G_IMPLEMENT_INTERFACE (GDK_TYPE_PAINTABLE,
+                                                gdk_progressive_image_paintable_init))
+
+static void
+gdk_progressive_image_get_property (GObject    *object,
+                                    guint       property_id,
+                                    GValue     *value,
+                                    GParamSpec *pspec)
+{
+  GdkProgressiveImage *self = GDK_PROGRESSIVE_IMAGE (object);
+
+  switch (property_id)
+    {
+    case PROP_LOADING:
+      g_value_set_boolean (value, self->loading);
+      break;
+
+    case PROP_TEXTURE:
+      g_value_set_object (value, gdk_progressive_image_get_texture (self));
+      break;
+
+    default:
+      G_OBJECT_WARN_INVALID_PROPERTY_ID (object, property_id, pspec);
+      break;
+    }
+}
+
+/* Loading keeps a reference, so the decoding thread is done here */
+static void
+gdk_progressive_image_dispose (GObject *object)
+{
+  GdkProgressiveImage *self = GDK_PROGRESSIVE_IMAGE (object);
+
+  g_clear_pointer (&self->apply_source, g_source_destroy);
+  free_bands (self->pending_bands, self->pending_height);
+  self->pending_bands = NULL;
+  g_clear_object (&self->pending_texture);
+  free_bands (self->bands, self->height);
+  self->bands = NULL;
+  g_clear_object (&self->texture);
+  g_clear_pointer (&self->context, g_main_context_unref);
+
+  G_OBJECT_CLASS (gdk_progressive_image_parent_class)->dispose (object);
+}
+
+static void
+gdk_progressive_image_finalize (GObject *object)
+{
+  GdkProgressiveImage *self = GDK_PROGRESSIVE_IMAGE (object);
+
+  g_mutex_clear (&self->lock);
+
+  G_OBJECT_CLASS (gdk_progressive_image_parent_class)->finalize (object);
+}
+
+static void
+gdk_progressive_image_class_init (GdkProgressiveImageClass *klass)
+{
+  GObjectClass *gobject_class = G_OBJECT_CLASS (klass);
+
+  gobject_class->dispose = gdk_progressive_image_dispose;
+  gobject_class->finalize = gdk_progressive_image_finalize;
+  gobject_class->get_property = gdk_progressive_image_get_property;
+
+  /**
+   * GdkProgressiveImage:loading:
+   *
+   * Whether the image is currently being loaded.
+   *
+   * Since: 4.18
+   */
+  properties[PROP_LOADING] =
+    g_param_spec_boolean ("loading", NULL, NULL,
+                          FALSE,
+                          G_PARAM_READABLE | G_PARAM_EXPLICIT_NOTIFY | G_PARAM_STATIC_STRINGS);
+
+  /**
+   * GdkProgressiveImage:texture:
+   *
+   * The texture with the image data that has been decoded so far.
+   *
+   * Since: 4.18
+   */
+  properties[PROP_TEXTURE] =
+    g_param_spec_object ("texture", NULL, NULL,
+                         GDK_TYPE_TEXTURE,
+                         G_PARAM_READABLE | G_PARAM_EXPLICIT_NOTIFY | G_PARAM_STATIC_STRINGS);
+
+  g_object_class_install_properties (gobject_class, N_PROPS, properties);
+}
+
+static void
+gdk_progressive_image_init (GdkProgressiveImage *self)
+{
+  g_mutex_init (&self->lock);
+}
+
+/* }}} */
+/* {{{ Private API */
+
+/*
+ * gdk_progressive_image_begin:
+ * @self: a `GdkProgressiveImage`
+ * @width: the width of the image
+ * @height: the height of the image
+ * @format: the format of the decoded data
+ * @color_state: the color state of the image
+ * @out_stride: (out): the stride of the returned buffer
+ * @error: return location for an error
+ *
+ * Called by decoders once the image header has been read.
+ * Decoders run in the decoding thread.
+ *
+ * Returns: (nullable) (transfer none): the buffer to decode the
+ *   image into. It is initially transparent.
+ */
+guchar *
+gdk_progressive_image_begin (GdkProgressiveImage  *self,
+                             int                   width,
+                             int                   height,
+                             GdkMemoryFormat       format,
+                             GdkColorState        *color_state,
+                             gsize                *out_stride,
+                             GError              **error)
+{
+  gsize stride;
+  guchar *data;
+
+  g_return_val_if_fail (self->data == NULL, NULL);
+
+  if (!g_size_checked_mul (&stride, width, gdk_memory_format_bytes_per_pixel (format)) ||
+      (data = g_try_malloc0_n (height, stride)) == NULL)
+    {
+      g_set_error (error,
+                   GDK_TEXTURE_ERROR, GDK_TEXTURE_ERROR_TOO_LARGE,
+                   _("Not enough memory for image size %ux%u"), width, height);
+      return NULL;
+    }
+
+  self->format = format;
+  self->color_state = gdk_color_state_ref (color_state);
+  self->bytes = g_bytes_new_take (data, height * stride);
+  self->data = data;
+  self->stride = stride;
+  self->dirty_start = height;
+  self->dirty_end = 0;
+  self->last_publish_time = g_get_monotonic_time ();
+  self->complete_rows = g_new0 (int, N_BANDS (height));
+  self->decoded_bands = g_new0 (GdkTexture *, N_BANDS (height));
+
+  g_mutex_lock (&self->lock);
+  free_bands (self->pending_bands, self->pending_height);
+  self->pending_bands = g_new0 (GdkTexture *, N_BANDS (height));
+  g_clear_object (&self->pending_texture);
+  self->pending_width = width;
+  self->pending_height = height;
+  self->pending_reset = TRUE;
+  gdk_progressive_image_queue_apply (self);
+  g_mutex_unlock (&self->lock);
+
+  *out_stride = stride;
+
+  return data;
+}
+
+/*
+ * gdk_progressive_image_update:
+ * @self: a `GdkProgressiveImage`
+ * @y: the first changed row
+ * @n_rows: the number of changed rows
+ * @complete: whether the rows won't change anymore
+ *
+ * Called by decoders after they wrote rows into the buffer.
+ * Rows must be reported as complete only once.
+ */
+void
+gdk_progressive_image_update (GdkProgressiveImage *self,
+                              int                  y,
+                              int                  n_rows,
+                              gboolean             complete)
+{
+  int i;
+
+  self->dirty_start = MIN (self->dirty_start, y);
+  self->dirty_end = MAX (self->dirty_end, y + n_rows);
+
+  if (complete)
+    {
+      for (i = y; i < y + n_rows; i++)
+        self->complete_rows[i / BAND_HEIGHT]++;
+    }
+}
+
+/*
+ * gdk_progressive_image_set_texture:
+ * @self: a `GdkProgressiveImage`
+ * @texture: the complete image
+ *
+ * Called by decoders that can't provide partial results.
+ */
+void
+gdk_progressive_image_set_texture (GdkProgressiveImage *self,
+                                   GdkTexture          *texture)
+{
+  g_mutex_lock (&self->lock);
+  free_bands (self->pending_bands, self->pending_height);
+  self->pending_bands = NULL;
+  g_set_object (&self->pending_texture, texture);
+  if (self->pending_width != gdk_texture_get_width (texture) ||
+      self->pending_height != gdk_texture_get_height (texture))
+    {
+      self->pending_width = gdk_texture_get_width (texture);
+      self->pending_height = gdk_texture_get_height (texture);
+      self->pending_reset = TRUE;
+    }
+  gdk_progressive_image_queue_apply (self);
+  g_mutex_unlock (&self->lock);
+}
+
+/* }}} */
+/* {{{ Public API */
+
+/**
+ * gdk_progressive_image_new:
+ *
+ * Creates a new, empty progressive image.
+ *
+ * Returns: a new `GdkProgressiveImage`
+ *
+ * Since: 4.18
+ */
+GdkProgressiveImage *
+gdk_progressive_image_new (void)
+{
+  return g_object_new (GDK_TYPE_PROGRESSIVE_IMAGE, NULL);
+}
+
+/**
+ * gdk_progressive_image_load_async:
+ * @self: a `GdkProgressiveImage`
+ * @stream: the stream to read the image from
+ * @io_priority: the I/O priority of the reads
+ * @cancellable: (nullable): a `GCancellable`
+ * @callback: (scope async): callback to call when the image is loaded
+ * @user_data: data for @callback
+ *
+ * Loads an image from @stream, updating the contents of @self
+ * as the data arrives.
+ *
+ * If loading fails or is cancelled, the part of the image that was
+ * decoded until then stays visible.
+ *
+ * Only one image can be loaded at a time.
+ *
+ * Since: 4.18
+ */
+void
+gdk_progressive_image_load_async (GdkProgressiveImage *self,
+                                  GInputStream        *stream,
+                                  int                  io_priority,
+                                  GCancellable        *cancellable,
+                                  GAsyncReadyCallback  callback,
+                                  gpointer             user_data)
+{
+  GTask *task, *decode_task;
+  LoadData *load;
+
+  g_return_if_fail (GDK_IS_PROGRESSIVE_IMAGE (self));
+  g_return_if_fail (G_IS_INPUT_STREAM (stream));
+  g_return_if_fail (!self->loading);
+
+  load = g_new0 (LoadData, 1);
+  load->stream = g_object_ref (stream);
+  load->chunks = g_async_queue_new_full ((GDestroyNotify) g_bytes_unref);
+  load->reading = TRUE;
+  load->decoding = TRUE;
+
+  task = g_task_new (self, cancellable, callback, user_data);
+  g_task_set_source_tag (task, gdk_progressive_image_load_async);
+  g_task_set_priority (task, io_priority);
+  g_task_set_task_data (task, load, load_data_free);
+
+  self->loading = TRUE;
+  g_clear_pointer (&self->context, g_main_context_unref);
+  self->context = g_main_context_ref_thread_default ();
+  g_object_notify_by_pspec (G_OBJECT (self), properties[PROP_LOADING]);
+
+  /* Reading happens here, decoding in a thread */
+  decode_task = g_task_new (self, cancellable, gdk_progressive_image_decode_done, task);
+  g_task_set_source_tag (decode_task, gdk_progressive_image_decode_thread);
+  g_task_set_task_data (decode_task, g_async_queue_ref (load->chunks), (GDestroyNotify) g_async_queue_unref);
+  g_task_run_in_thread (decode_task, gdk_progressive_image_decode_thread);
+  g_object_unref (decode_task);
+
+  gdk_progressive_image_read_next (task);
+}
+
+/**
+ * gdk_progressive_image_load_finish:
+ * @self: a `GdkProgressiveImage`
+ * @result: the `GAsyncResult`
+ * @error: return location for an error
+ *
+ * Finishes a load started with [method@Gdk.ProgressiveImage.load_async].
+ *
+ * Returns: %TRUE if the image was loaded completely
+ *
+ * Since: 4.18
+ */
+gboolean
+gdk_progressive_image_load_finish (GdkProgressiveImage  *self,
+                                   GAsyncResult         *result,
+                                   GError              **error)
+{
+  g_return_val_if_fail (g_task_is_valid (result, self), FALSE);
+  g_return_val_if_fail (g_task_get_source_tag (G_TASK (result)) == gdk_progressive_image_load_async, FALSE);
+
+  return g_task_propagate_boolean (G_TASK (result), error);
+}
+
+/**
+ * gdk_progressive_image_get_texture:
+ * @self: a `GdkProgressiveImage`
+ *
+ * Gets a texture with the part of the image that has been decoded
+ * so far.
+ *
+ * While the image is loading, this copies the decoded data into a
+ * new texture every time it changed. Drawing @self as a paintable
+ * avoids that.
+ *
+ * Returns: (nullable) (transfer none): the texture
+ *
+ * Since: 4.18
+ */
+GdkTexture *
+gdk_progressive_image_get_texture (GdkProgressiveImage *self)
+{
+  g_return_val_if_fail (GDK_IS_PROGRESSIVE_IMAGE (self), NULL);
+
+  if (self->texture == NULL && self->bands)
+    self->texture = gdk_progressive_image_combine_bands (self);
+
+  return self->texture;
+}
+
+/**
+ * gdk_progressive_image_is_loading:
+ * @self: a `GdkProgressiveImage`
+ *
+ * Returns whether an image is currently being loaded.
+ *
+ * Returns: %TRUE while loading
+ *
+ * Since: 4.18
+ */
+gboolean
+gdk_progressive_image_is_loading (GdkProgressiveImage *self)
+{
+  g_return_val_if_fail (GDK_IS_PROGRESSIVE_IMAGE (self), FALSE);
+
+  return self->loading;
+}
+
+/* }}} */
+
+/* vim:set foldmethod=marker: */
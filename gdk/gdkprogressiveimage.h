@@ -0,0 +1,53 @@
+/* GDK - The GIMP Drawing Kit
+ * Copyright (C) 2026 the GTK team
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#if !defined (__GDK_H_INSIDE__) && !defined (GTK_COMPILATION)
+#error "Only <gdk/gdk.h> can be included directly."
+#endif
+
+#include <gdk/gdktypes.h>
+#include <gio/gio.h>
+
+G_BEGIN_DECLS
+
+#define GDK_TYPE_PROGRESSIVE_IMAGE (gdk_progressive_image_get_type ())
+GDK_AVAILABLE_IN_4_18
+GDK_DECLARE_INTERNAL_TYPE (GdkProgressiveImage, gdk_progressive_image, GDK, PROGRESSIVE_IMAGE, GObject)
+
+GDK_AVAILABLE_IN_4_18
+GdkProgressiveImage *   gdk_progressive_image_new               (void);
+
+GDK_AVAILABLE_IN_4_18
+void                    gdk_progressive_image_load_async        (GdkProgressiveImage    *self,
+                                                                 GInputStream           *stream,
+                                                                 int                     io_priority,
+                                                                 GCancellable           *cancellable,
+                                                                 GAsyncReadyCallback     callback,
+                                                                 gpointer                user_data);
+GDK_AVAILABLE_IN_4_18
+gboolean                gdk_progressive_image_load_finish       (GdkProgressiveImage    *self,
+                                                                 GAsyncResult           *result,
+                                                                 GError                **error);
+
+GDK_AVAILABLE_IN_4_18
+GdkTexture *            gdk_progressive_image_get_texture       (GdkProgressiveImage    *self);
+GDK_AVAILABLE_IN_4_18
+gboolean                gdk_progressive_image_is_loading        (GdkProgressiveImage    *self);
+
+G_END_DECLS
@@ -0,0 +1,64 @@
+/* GDK - The GIMP Drawing Kit
+ * Copyright (C) 2026 the GTK team
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include "gdkprogressiveimage.h"
+#include "gdkmemoryformatprivate.h"
+
+G_BEGIN_DECLS
+
+typedef struct _GdkStreamDecoder GdkStreamDecoder;
+typedef struct _GdkStreamDecoderClass GdkStreamDecoderClass;
+
+/* A decoder that gets the image data in pieces as it arrives and
+ * writes the decoded rows into the image. Decoders are used in the
+ * decoding thread only.
+ */
+struct _GdkStreamDecoderClass
+{
+  gboolean              (* feed)                (GdkStreamDecoder       *self,
+                                                 const guchar           *data,
+                                                 gsize                   size,
+                                                 GError                **error);
+  /* called at the end of the data */
+  gboolean              (* close)               (GdkStreamDecoder       *self,
+                                                 GError                **error);
+  void                  (* free)                (GdkStreamDecoder       *self);
+};
+
+struct _GdkStreamDecoder
+{
+  const GdkStreamDecoderClass *klass;
+  GdkProgressiveImage *image;
+};
+
+guchar *                gdk_progressive_image_begin             (GdkProgressiveImage    *self,
+                                                                 int                     width,
+                                                                 int                     height,
+                                                                 GdkMemoryFormat         format,
+                                                                 GdkColorState          *color_state,
+                                                                 gsize                  *out_stride,
+                                                                 GError                **error);
+void                    gdk_progressive_image_update            (GdkProgressiveImage    *self,
+                                                                 int                     y,
+                                                                 int                     n_rows,
+                                                                 gboolean                complete);
+void                    gdk_progressive_image_set_texture       (GdkProgressiveImage    *self,
+                                                                 GdkTexture             *texture);
+
+G_END_DECLS
@@ -63,6 +63,7 @@
 #include "loaders/gdkpngprivate.h"
 #include "loaders/gdktiffprivate.h"
 #include "loaders/gdkjpegprivate.h"
+#include "loaders/gdkimagescalerprivate.h"
 
 /**
  * gdk_texture_error_quark:
@@ -741,6 +742,158 @@ gdk_texture_new_from_bytes (GBytes  *bytes,
   return gdk_texture_new_from_bytes_pixbuf (bytes, error);
 }
 
+static GdkTexture *
+gdk_texture_new_from_bytes_at_size_internal (GBytes              *bytes,
+                                             const GdkRectangle  *clip,
+                                             int                  width,
+                                             int                  height,
+                                             GError             **error)
+{
+  if (gdk_is_png (bytes))
+    {
+      return gdk_load_png_at_size (bytes, clip, width, height, error);
+    }
+  else if (gdk_is_jpeg (bytes))
+    {
+      return gdk_load_jpeg_at_size (bytes, clip, width, height, error);
+    }
+  else if (gdk_is_tiff (bytes))
+    {
+      return gdk_load_tiff_at_size (bytes, clip, width, height, error);
+    }
+  else
+    {
+      g_set_error_literal (error,
+                           GDK_TEXTURE_ERROR, GDK_TEXTURE_ERROR_UNSUPPORTED_FORMAT,
+                           _("Unknown image format."));
+      return NULL;
+    }
+}
+
+/**
+ * gdk_texture_new_from_bytes_at_size:
+ * @bytes: a `GBytes` containing the data to load
+ * @clip: (nullable): the area of the image to load
+ * @width: the width of the texture, or -1
+ * @height: the height of the texture, or -1
+ * @error: Return location for an error
+ *
+ * Creates a new texture by loading a region of an image from memory
+ * and scaling it to the given size.
+ *
+ * If @clip is %NULL, the whole image is loaded. Otherwise only the
+ * part of the image inside @clip is. If @clip does not intersect the
+ * image, %G_IO_ERROR_INVALID_ARGUMENT is returned.
+ *
+ * If one of @width and @height is -1, it is chosen to preserve the
+ * aspect ratio of the loaded region. If both are -1, the region is
+ * loaded at its original size.
+ *
+ * Compared to loading the full image and scaling it afterwards,
+ * this avoids decoding the parts of the image outside of @clip, and
+ * the full-size image is never kept in memory for the supported
+ * formats. JPEG images are decoded at reduced resolution where
+ * possible, so loading thumbnails is considerably faster.
+ *
+ * The file format is detected automatically. The supported formats
+ * are PNG, JPEG and TIFF, though more formats might be available.
+ *
+ * If %NULL is returned, then @error will be set.
+ *
+ * This function is threadsafe, so that you can e.g. use GTask
+ * and [method@Gio.Task.run_in_thread] to avoid blocking the main thread
+ * while loading a big image.
+ *
+ * Return value: A newly-created `GdkTexture`
+ *
+ * Since: 4.18
+ */
+GdkTexture *
+gdk_texture_new_from_bytes_at_size (GBytes              *bytes,
+                                    const GdkRectangle  *clip,
+                                    int                  width,
+                                    int                  height,
+                                    GError             **error)
+{
+  GdkTexture *texture, *full;
+  GError *internal_error = NULL;
+  GdkRectangle area;
+
+  g_return_val_if_fail (bytes != NULL, NULL);
+  g_return_val_if_fail (clip == NULL || (clip->width > 0 && clip->height > 0), NULL);
+  g_return_val_if_fail (error == NULL || *error == NULL, NULL);
+
+  texture = gdk_texture_new_from_bytes_at_size_internal (bytes, clip, width, height, &internal_error);
+  if (texture)
+    return texture;
+
+  if (!g_error_matches (internal_error, GDK_TEXTURE_ERROR, GDK_TEXTURE_ERROR_UNSUPPORTED_CONTENT) &&
+      !g_error_matches (internal_error, GDK_TEXTURE_ERROR, GDK_TEXTURE_ERROR_UNSUPPORTED_FORMAT))
+    {
+      g_propagate_error (error, internal_error);
+      return NULL;
+    }
+
+  g_clear_error (&internal_error);
+
+  full = gdk_texture_new_from_bytes_pixbuf (bytes, error);
+  if (full == NULL)
+    return NULL;
+
+  if (gdk_image_scaler_compute_size (full->width, full->height,
+                                     clip, width, height,
+                                     &area, &width, &height,
+                                     error))
+    texture = gdk_image_scaler_scale_texture (full, &area, width, height, error);
+  else
+    texture = NULL;
+
+  g_object_unref (full);
+
+  return texture;
+}
+
+/**
+ * gdk_texture_new_from_file_at_size:
+ * @file: `GFile` to load
+ * @clip: (nullable): the area of the image to load
+ * @width: the width of the texture, or -1
+ * @height: the height of the texture, or -1
+ * @error: Return location for an error
+ *
+ * Creates a new texture by loading a region of an image from a file
+ * and scaling it to the given size.
+ *
+ * See [ctor@Gdk.Texture.new_from_bytes_at_size] for details.
+ *
+ * Return value: A newly-created `GdkTexture`
+ *
+ * Since: 4.18
+ */
+GdkTexture *
+gdk_texture_new_from_file_at_size (GFile               *file,
+                                   const GdkRectangle  *clip,
+                                   int                  width,
+                                   int                  height,
+                                   GError             **error)
+{
+  GBytes *bytes;
+  GdkTexture *texture;
+
+  g_return_val_if_fail (G_IS_FILE (file), NULL);
+  g_return_val_if_fail (error == NULL || *error == NULL, NULL);
+
+  bytes = g_file_load_bytes (file, NULL, NULL, error);
+  if (bytes == NULL)
+    return NULL;
+
+  texture = gdk_texture_new_from_bytes_at_size (bytes, clip, width, height, error);
+
+  g_bytes_unref (bytes);
+
+  return texture;
+}
+
 /**
  * gdk_texture_new_from_filename:
  * @path: (type filename): the filename to load
@@ -978,6 +1131,69 @@ gdk_texture_download_surface (GdkTexture    *texture,
   return surface;
 }
 
+static const cairo_user_data_key_t source_surface_bytes_key;
+
+/*
+ * gdk_texture_get_source_surface:
+ * @texture: a `GdkTexture`
+ * @color_state: the color state of the surface
+ *
+ * Like gdk_texture_download_surface(), but the surface may point
+ * straight at the memory of the texture, so it must only be used as
+ * a source and never be drawn to.
+ *
+ * This avoids a copy for memory textures that are already in a
+ * format cairo understands, like textures mapped from files or
+ * shared memory.
+ *
+ * Returns: (transfer full): a read-only surface
+ */
+cairo_surface_t *
+gdk_texture_get_source_surface (GdkTexture    *texture,
+                                GdkColorState *color_state)
+{
+  cairo_surface_t *surface;
+  cairo_format_t surface_format;
+  GBytes *bytes;
+  gsize stride;
+
+  if (!GDK_IS_MEMORY_TEXTURE (texture) ||
+      !gdk_color_state_equal (texture->color_state, color_state))
+    return gdk_texture_download_surface (texture, color_state);
+
+  if (texture->format == gdk_cairo_format_to_memory_format (CAIRO_FORMAT_ARGB32))
+    surface_format = CAIRO_FORMAT_ARGB32;
+  else if (texture->format == gdk_cairo_format_to_memory_format (CAIRO_FORMAT_RGB24))
+    surface_format = CAIRO_FORMAT_RGB24;
+  else
+    return gdk_texture_download_surface (texture, color_state);
+
+  bytes = gdk_memory_texture_get_bytes (GDK_MEMORY_TEXTURE (texture), &stride);
+  if (stride % 4 != 0 || stride > G_MAXINT)
+    return gdk_texture_download_surface (texture, color_state);
+
+  /* cairo doesn't write to source surfaces, so casting away the
+   * const is fine, even for read-only mappings.
+   */
+  surface = cairo_image_surface_create_for_data ((guchar *) g_bytes_get_data (bytes, NULL),
+                                                 surface_format,
+                                                 texture->width,
+                                                 texture->height,
+                                                 stride);
+  if (cairo_surface_status (surface) != CAIRO_STATUS_SUCCESS)
+    {
+      cairo_surface_destroy (surface);
+      return gdk_texture_download_surface (texture, color_state);
+    }
+
+  cairo_surface_set_user_data (surface,
+                               &source_surface_bytes_key,
+                               g_bytes_ref (bytes),
+                               (cairo_destroy_func_t) g_bytes_unref);
+
+  return surface;
+}
+
 /**
  * gdk_texture_download:
  * @texture: a `GdkTexture`
@@ -1129,7 +1345,7 @@ gdk_texture_save_to_png (GdkTexture *texture,
   g_return_val_if_fail (GDK_IS_TEXTURE (texture), FALSE);
   g_return_val_if_fail (filename != NULL, FALSE);
 
-  bytes = gdk_save_png (texture);
+  bytes = gdk_save_png (texture, NULL);
   result = g_file_set_contents (filename,
                                 g_bytes_get_data (bytes, NULL),
                                 g_bytes_get_size (bytes),
@@ -1167,7 +1383,32 @@ gdk_texture_save_to_png_bytes (GdkTexture *texture)
 {
   g_return_val_if_fail (GDK_IS_TEXTURE (texture), NULL);
 
-  return gdk_save_png (texture);
+  return gdk_save_png (texture, NULL);
+}
+
+/**
+ * gdk_texture_save_to_png_bytes_full:
+ * @texture: a `GdkTexture`
+ * @options: (nullable): options for the encoder
+ *
+ * Store the given @texture in memory as a PNG file, using
+ * the given @options.
+ *
+ * This is like [method@Gdk.Texture.save_to_png_bytes], but allows
+ * trading file size for encoding speed. With the fast preset and
+ * parallel compression, large textures are encoded many times faster.
+ *
+ * Returns: a newly allocated `GBytes` containing PNG data
+ *
+ * Since: 4.18
+ */
+GBytes *
+gdk_texture_save_to_png_bytes_full (GdkTexture                  *texture,
+                                    const GdkTextureSaveOptions *options)
+{
+  g_return_val_if_fail (GDK_IS_TEXTURE (texture), NULL);
+
+  return gdk_save_png (texture, options);
 }
 
 /**
@@ -1192,7 +1433,7 @@ gdk_texture_save_to_tiff (GdkTexture  *texture,
   g_return_val_if_fail (GDK_IS_TEXTURE (texture), FALSE);
   g_return_val_if_fail (filename != NULL, FALSE);
 
-  bytes = gdk_save_tiff (texture);
+  bytes = gdk_save_tiff (texture, NULL);
   result = g_file_set_contents (filename,
                                 g_bytes_get_data (bytes, NULL),
                                 g_bytes_get_size (bytes),
@@ -1228,6 +1469,31 @@ gdk_texture_save_to_tiff_bytes (GdkTexture *texture)
 {
   g_return_val_if_fail (GDK_IS_TEXTURE (texture), NULL);
 
-  return gdk_save_tiff (texture);
+  return gdk_save_tiff (texture, NULL);
+}
+
+/**
+ * gdk_texture_save_to_tiff_bytes_full:
+ * @texture: a `GdkTexture`
+ * @options: (nullable): options for the encoder
+ *
+ * Store the given @texture in memory as a TIFF file, using
+ * the given @options.
+ *
+ * This is like [method@Gdk.Texture.save_to_tiff_bytes]. TIFF files
+ * are stored uncompressed, unless the preset is
+ * %GDK_TEXTURE_SAVE_PRESET_SMALL, which uses deflate compression.
+ *
+ * Returns: a newly allocated `GBytes` containing TIFF data
+ *
+ * Since: 4.18
+ */
+GBytes *
+gdk_texture_save_to_tiff_bytes_full (GdkTexture                  *texture,
+                                     const GdkTextureSaveOptions *options)
+{
+  g_return_val_if_fail (GDK_IS_TEXTURE (texture), NULL);
+
+  return gdk_save_tiff (texture, options);
 }
 
@@ -75,6 +75,18 @@ GdkTexture *            gdk_texture_new_from_filename          (const char
 GDK_AVAILABLE_IN_4_6
 GdkTexture *            gdk_texture_new_from_bytes             (GBytes          *bytes,
                                                                 GError         **error);
+GDK_AVAILABLE_IN_4_18
+GdkTexture *            gdk_texture_new_from_bytes_at_size     (GBytes             *bytes,
+                                                                const GdkRectangle *clip,
+                                                                int                 width,
+                                                                int                 height,
+                                                                GError            **error);
+GDK_AVAILABLE_IN_4_18
+GdkTexture *            gdk_texture_new_from_file_at_size      (GFile              *file,
+                                                                const GdkRectangle *clip,
+                                                                int                 width,
+                                                                int                 height,
+                                                                GError            **error);
 
 GDK_AVAILABLE_IN_ALL
 int                     gdk_texture_get_width                  (GdkTexture      *texture) G_GNUC_PURE;
@@ -100,6 +112,12 @@ gboolean                gdk_texture_save_to_tiff               (GdkTexture
                                                                 const char      *filename);
 GDK_AVAILABLE_IN_4_6
 GBytes *                gdk_texture_save_to_tiff_bytes         (GdkTexture      *texture);
+GDK_AVAILABLE_IN_4_18
+GBytes *                gdk_texture_save_to_png_bytes_full     (GdkTexture                  *texture,
+                                                                const GdkTextureSaveOptions *options);
+GDK_AVAILABLE_IN_4_18
+GBytes *                gdk_texture_save_to_tiff_bytes_full    (GdkTexture                  *texture,
+                                                                const GdkTextureSaveOptions *options);
 
 G_DEFINE_AUTOPTR_CLEANUP_FUNC(GdkTexture, g_object_unref)
 
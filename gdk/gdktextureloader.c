@@ -0,0 +1,767 @@
+/* GDK - The GIMP Drawing Kit
+ * Copyright (C) 2026 the GTK team
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "config.h"
+
+#include "gdktextureloader.h"
+
+#include "gdkcolorstateprivate.h"
+#include "gdkmemoryformatprivate.h"
+#include "gdkmemorytexturebuilder.h"
+#include "gdktexture.h"
+#include "gdktexturedownloaderprivate.h"
+
+#include <glib/gi18n-lib.h>
+
+/**
+ * GdkTextureLoader:
+ *
+ * `GdkTextureLoader` loads many images in the background.
+ *
+ * It is meant for applications that show lots of images at the same
+ * time, such as the thumbnails in a photo browser.
+ *
+ * Loads are queued with [method@Gdk.TextureLoader.load_async] and
+ * decoded by a limited number of worker threads of the loader's own,
+ * so that they neither overload the machine nor compete with the
+ * threads GIO uses for other asynchronous operations.
+ *
+ * Queued loads are started in the order of their priority. Lower
+ * values are more important, and a good choice for the priority of
+ * an image is its distance from the visible area. When the visible
+ * area changes, [method@Gdk.TextureLoader.set_priority] and
+ * [method@Gdk.TextureLoader.cancel_above] can be used to reorder and
+ * drop the loads that are still queued.
+ *
+ * Loads of the same file at the same size are only done once, even
+ * if they are requested again while the first load is in progress.
+ *
+ * The resulting textures use the memory formats preferred by the GPU
+ * renderers, so they can be uploaded without further conversion.
+ *
+ * Since: 4.18
+ */
+
+typedef struct _Job Job;
+typedef struct _Request Request;
+
+struct _Job
+{
+  GdkTextureLoader *loader;     /* set while running */
+  GFile *file;
+  int width;
+  int height;
+  int priority;
+  guint64 sequence;
+  GPtrArray *requests;
+  guint running : 1;
+};
+
+struct _Request
+{
+  GdkTextureLoader *loader;
+  GTask *task;                  /* owned while attached to a job */
+  Job *job;
+  GCancellable *cancellable;
+  gulong cancelled_id;
+};
+
+struct _GdkTextureLoader
+{
+  GObject parent_instance;
+
+  GMutex lock;
+  GThreadPool *pool;
+  guint max_workers;            /* 0 to choose automatically */
+  guint n_running;
+  guint64 sequence;
+
+  GHashTable *jobs;             /* all queued and running jobs */
+  GPtrArray *pending;           /* the queued jobs */
+};
+
+struct _GdkTextureLoaderClass
+{
+  GObjectClass parent_class;
+};
+
+enum
+{
+  PROP_0,
+  PROP_MAX_WORKERS,
+
+  N_PROPS
+};
+
+G_DEFINE_TYPE (GdkTextureLoader, gdk_texture_loader, G_TYPE_OBJECT)
+
+static GParamSpec *properties[N_PROPS] = { NULL, };
+
+/* {{{ Jobs */
+
+static guint
+job_hash (gconstpointer data)
+{
+  const Job *job = data;
+
+  return g_file_hash (job->file) ^ (job->width * 31) ^ (job->height * 17);
+}
+
+static gboolean
+job_equal (gconstpointer a,
+           gconstpointer b)
+{
+  const Job *job_a = a;
+  const Job *job_b = b;
+
+  return job_a->width == job_b->width &&
+         job_a->height == job_b->height &&
+         g_file_equal (job_a->file, job_b->file);
+}
+
+static int
+job_compare (const Job *a,
+             const Job *b)
+{
+  if (a->priority != b->priority)
+    return a->priority < b->priority ? -1 : 1;
+
+  return a->sequence < b->sequence ? -1 : 1;
+}
+
+static Job *
+job_new (GFile  *file,
+         int     width,
+         int     height,
+         int     priority,
+         guint64 sequence)
+{
+  Job *job;
+
+  job = g_new0 (Job, 1);
+  job->file = g_object_ref (file);
+  job->width = width;
+  job->height = height;
+  job->priority = priority;
+  job->sequence = sequence;
+  job->requests = g_ptr_array_new ();
+
+  return job;
+}
+
+static void
+job_free (Job *job)
+{
+  g_clear_pointer (&job->requests, g_ptr_array_unref);
+  g_object_unref (job->file);
+  g_free (job);
+}
+
+static void
+request_free (gpointer data)
+{
+  Request *request = data;
+
+  if (request->cancelled_id)
+    g_cancellable_disconnect (request->cancellable, request->cancelled_id);
+  g_clear_object (&request->cancellable);
+  g_free (request);
+}
+
+/* Removes the request from its job and drops the job if it is
+ * not needed anymore.
+ *
+ * Returns: (transfer full): the task that the caller must return
+ */
+static GTask *
+gdk_texture_loader_detach_request (GdkTextureLoader *self,
+                                   Request          *request)
+{
+  Job *job = request->job;
+
+  g_ptr_array_remove (job->requests, request);
+  request->job = NULL;
+
+  if (job->requests->len == 0 && !job->running)
+    {
+      g_ptr_array_remove_fast (self->pending, job);
+      g_hash_table_remove (self->jobs, job);
+      job_free (job);
+    }
+
+  return g_steal_pointer (&request->task);
+}
+
+/* Converts the texture to the format the renderers use for its depth,
+ * so that it doesn't need to be converted when it is uploaded.
+ */
+static GdkTexture *
+gdk_texture_loader_prepare_texture (GdkTexture *texture)
+{
+  GdkTextureDownloader downloader;
+  GdkMemoryTextureBuilder *builder;
+  GdkMemoryFormat format;
+  GdkColorState *color_state;
+  GdkTexture *result;
+  GBytes *bytes;
+  gsize stride;
+
+  format = gdk_memory_depth_get_format (gdk_memory_format_get_depth (gdk_texture_get_format (texture), FALSE));
+  if (format == gdk_texture_get_format (texture))
+    return texture;
+
+  color_state = gdk_texture_get_color_state (texture);
+
+  gdk_texture_downloader_init (&downloader, texture);
+  gdk_texture_downloader_set_format (&downloader, format);
+  gdk_texture_downloader_set_color_state (&downloader, color_state);
+  bytes = gdk_texture_downloader_download_bytes (&downloader, &stride);
+  gdk_texture_downloader_finish (&downloader);
+
+  builder = gdk_memory_texture_builder_new ();
+  gdk_memory_texture_builder_set_format (builder, format);
+  gdk_memory_texture_builder_set_color_state (builder, color_state);
+  gdk_memory_texture_builder_set_width (builder, gdk_texture_get_width (texture));
+  gdk_memory_texture_builder_set_height (builder, gdk_texture_get_height (texture));
+  gdk_memory_texture_builder_set_bytes (builder, bytes);
+  gdk_memory_texture_builder_set_stride (builder, stride);
+  result = gdk_memory_texture_builder_build (builder);
+  g_object_unref (builder);
+  g_bytes_unref (bytes);
+
+  g_object_unref (texture);
+
+  return result;
+}
+
+static guint
+gdk_texture_loader_get_n_workers (GdkTextureLoader *self)
+{
+  if (self->max_workers > 0)
+    return self->max_workers;
+
+  return MAX (g_get_num_processors () / 2, 1);
+}
+
+static void gdk_texture_loader_dispatch (GdkTextureLoader *self);
+
+static void
+gdk_texture_loader_run_job (gpointer data,
+                            gpointer unused)
+{
+  Job *job = data;
+  GdkTextureLoader *self = job->loader;
+  GdkTexture *texture = NULL;
+  GError *error = NULL;
+  GPtrArray *tasks;
+  gboolean wanted;
+  guint i;
+
+  g_mutex_lock (&self->lock);
+  wanted = job->requests->len > 0;
+  g_mutex_unlock (&self->lock);
+
+  if (wanted)
+    {
+      texture = gdk_texture_new_from_file_at_size (job->file, NULL, job->width, job->height, &error);
+      if (texture)
+        texture = gdk_texture_loader_prepare_texture (texture);
+    }
+
+  tasks = g_ptr_array_new ();
+
+  g_mutex_lock (&self->lock);
+
+  g_hash_table_remove (self->jobs, job);
+  for (i = 0; i < job->requests->len; i++)
+    {
+      Request *request = g_ptr_array_index (job->requests, i);
+
+      request->job = NULL;
+      g_ptr_array_add (tasks, g_steal_pointer (&request->task));
+    }
+
+  self->n_running--;
+  gdk_texture_loader_dispatch (self);
+
+  g_mutex_unlock (&self->lock);
+
+  for (i = 0; i < tasks->len; i++)
+    {
+      GTask *task = g_ptr_array_index (tasks, i);
+
+      if (texture)
+        g_task_return_pointer (task, g_object_ref (texture), g_object_unref);
+      else if (error)
+        g_task_return_error (task, g_error_copy (error));
+      else
+        g_task_return_new_error (task, G_IO_ERROR, G_IO_ERROR_CANCELLED, "%s", _("Operation was cancelled"));
+
+      g_object_unref (task);
+    }
+
+  g_ptr_array_unref (tasks);
+  g_clear_object (&texture);
+  g_clear_error (&error);
+  job_free (job);
+  g_object_unref (self);
+}
+
+/* Starts the most important jobs, as long as there are free workers.
+ * Must be called with the lock held.
+ *
+ * The queue is searched linearly, which is fine for the few thousand
+ * jobs a viewer might queue, compared to the cost of decoding.
+ */
+static void
+gdk_texture_loader_dispatch (GdkTextureLoader *self)
+{
+  while (self->n_running < gdk_texture_loader_get_n_workers (self) && self->pending->len > 0)
+    {
+      Job *job;
+      guint i, best;
+
+      best = 0;
+      for (i = 1; i < self->pending->len; i++)
+        {
+          if (job_compare (g_ptr_array_index (self->pending, i),
+                           g_ptr_array_index (self->pending, best)) < 0)
+            best = i;
+        }
+
+      job = g_ptr_array_steal_index_fast (self->pending, best);
+      job->running = TRUE;
+      job->loader = g_object_ref (self);
+      self->n_running++;
+
+      g_thread_pool_push (self->pool, job, NULL);
+    }
+}
+
+static void
+request_cancelled_cb (GCancellable *cancellable,
+                      Request      *request)
+{
+  GdkTextureLoader *self = request->loader;
+  GTask *task = NULL;
+
+  g_mutex_lock (&self->lock);
+  if (request->job)
+    task = gdk_texture_loader_detach_request (self, request);
+  g_mutex_unlock (&self->lock);
+
+  if (task)
+    {
+      g_task_return_error_if_cancelled (task);
+      g_object_unref (task);
+    }
+}
+
+/* }}} */
+/* {{{ GObject implementation */
+
+static void
+gdk_texture_loader_get_property (GObject    *object,
+                                 guint       property_id,
+                                 GValue     *value,
+                                 GParamSpec *pspec)
+{
+  GdkTextureLoader *self = GDK_TEXTURE_LOADER (object);
+
+  switch (property_id)
+    {
+    case PROP_MAX_WORKERS:
+      g_value_set_uint (value, self->max_workers);
+      break;
+
+    default:
+      G_OBJECT_WARN_INVALID_PROPERTY_ID (object, property_id, pspec);
+      break;
+    }
+}
+
+static void
+gdk_texture_loader_set_property (GObject      *object,
+                                 guint         property_id,
+                                 const GValue *value,
+                                 GParamSpec   *pspec)
+{
+  GdkTextureLoader *self = GDK_TEXTURE_LOADER (object);
+
+  switch (property_id)
+    {
+    case PROP_MAX_WORKERS:
+      gdk_texture_loader_set_max_workers (self, g_value_get_uint (value));
+      break;
+
+    default:
+      G_OBJECT_WARN_INVALID_PROPERTY_ID (object, property_id, pspec);
+      break;
+    }
+}
+
+static void
+gdk_texture_loader_finalize (GObject *object)
+{
+  GdkTextureLoader *self = GDK_TEXTURE_LOADER (object);
+
+  /* Running jobs and pending requests keep the loader alive,
+   * so there's nothing left to cancel here.
+   */
+  g_assert (self->pending->len == 0);
+
+  /* This may run in a worker, so don't wait for them */
+  g_thread_pool_free (self->pool, TRUE, FALSE);
+  g_hash_table_unref (self->jobs);
+  g_ptr_array_unref (self->pending);
+  g_mutex_clear (&self->lock);
+
+  G_OBJECT_CLASS (gdk_texture_loader_parent_class)->finalize (object);
+}
+
+static void
+gdk_texture_loader_class_init (GdkTextureLoaderClass *klass)
+{
+  GObjectClass *gobject_class = G_OBJECT_CLASS (klass);
+
+  gobject_class->finalize = gdk_texture_loader_finalize;
+  gobject_class->get_property = gdk_texture_loader_get_property;
+  gobject_class->set_property = gdk_texture_loader_set_property;
+
+  /**
+   * GdkTextureLoader:max-workers:
+   *
+   * The maximum number of images that are decoded at the same time.
+   *
+   * If this is 0, which is the default, half the number of
+   * processors is used.
+   *
+   * Since: 4.18
+   */
+  properties[PROP_MAX_WORKERS] =
+    g_param_spec_uint ("max-workers", NULL, NULL,
+                       0, G_MAXINT, 0,
+                       G_PARAM_READWRITE | G_PARAM_EXPLICIT_NOTIFY | G_PARAM_STATIC_STRINGS);
+
+  g_object_class_install_properties (gobject_class, N_PROPS, properties);
+}
+
+static void
+gdk_texture_loader_init (GdkTextureLoader *self)
+{
+  g_mutex_init (&self->lock);
+
+  self->max_workers = 0;
+  self->pool = g_thread_pool_new (gdk_texture_loader_run_job, NULL, gdk_texture_loader_get_n_workers (self), FALSE, NULL);
+  self->jobs = g_hash_table_new (job_hash, job_equal);
+  self->pending = g_ptr_array_new ();
+}
+
+/* }}} */
+/* {{{ Public API */
+
+/**
+ * gdk_texture_loader_new:
+ *
+ * Creates a new texture loader.
+ *
+ * The number of workers defaults to half the number of processors,
+ * see [property@Gdk.TextureLoader:max-workers].
+ *
+ * Returns: a new `GdkTextureLoader`
+ *
+ * Since: 4.18
+ */
+GdkTextureLoader *
+gdk_texture_loader_new (void)
+{
+  return g_object_new (GDK_TYPE_TEXTURE_LOADER, NULL);
+}
+
+/**
+ * gdk_texture_loader_get_max_workers:
+ * @self: a `GdkTextureLoader`
+ *
+ * Gets the maximum number of images that are decoded at the same time.
+ *
+ * Returns: the number of workers, or 0 if it is chosen automatically
+ *
+ * Since: 4.18
+ */
+guint
+gdk_texture_loader_get_max_workers (GdkTextureLoader *self)
+{
+  g_return_val_if_fail (GDK_IS_TEXTURE_LOADER (self), 0);
+
+  return self->max_workers;
+}
+
+/**
+ * gdk_texture_loader_set_max_workers:
+ * @self: a `GdkTextureLoader`
+ * @max_workers: the number of workers, or 0 to choose automatically
+ *
+ * Sets the maximum number of images that are decoded at the same time.
+ *
+ * If @max_workers is 0, half the number of processors is used.
+ *
+ * Loads that are already running are not affected by lowering the number.
+ *
+ * Since: 4.18
+ */
+void
+gdk_texture_loader_set_max_workers (GdkTextureLoader *self,
+                                    guint             max_workers)
+{
+  g_return_if_fail (GDK_IS_TEXTURE_LOADER (self));
+
+  if (self->max_workers == max_workers)
+    return;
+
+  g_mutex_lock (&self->lock);
+  self->max_workers = max_workers;
+  g_thread_pool_set_max_threads (self->pool, gdk_texture_loader_get_n_workers (self), NULL);
+  gdk_texture_loader_dispatch (self);
+  g_mutex_unlock (&self->lock);
+
+  g_object_notify_by_pspec (G_OBJECT (self), properties[PROP_MAX_WORKERS]);
+}
+
+/**
+ * gdk_texture_loader_load_async:
+ * @self: a `GdkTextureLoader`
+ * @file: the file to load
+ * @width: the width of the texture, or -1
+ * @height: the height of the texture, or -1
+ * @priority: the priority of the load, lower values are loaded first
+ * @cancellable: (nullable): a `GCancellable`
+ * @callback: (scope async): callback to call when the texture is loaded
+ * @user_data: data for @callback
+ *
+ * Queues a load of @file at the given size.
+ *
+ * The size is handled like in [ctor@Gdk.Texture.new_from_file_at_size].
+ *
+ * If a load of the same file at the same size is already queued or
+ * running, the result of that load is shared, and its priority is
+ * raised if necessary.
+ *
+ * Cancelling @cancellable removes the load from the queue, and
+ * @callback is called with a %G_IO_ERROR_CANCELLED error right away.
+ *
+ * Since: 4.18
+ */
+void
+gdk_texture_loader_load_async (GdkTextureLoader    *self,
+                               GFile               *file,
+                               int                  width,
+                               int                  height,
+                               int                  priority,
+                               GCancellable        *cancellable,
+                               GAsyncReadyCallback  callback,
+                               gpointer             user_data)
+{
+  GTask *task;
+  Request *request;
+  Job key, *job;
+
+  g_return_if_fail (GDK_IS_TEXTURE_LOADER (self));
+  g_return_if_fail (G_IS_FILE (file));
+  g_return_if_fail (cancellable == NULL || G_IS_CANCELLABLE (cancellable));
+
+  task = g_task_new (self, cancellable, callback, user_data);
+  g_task_set_source_tag (task, gdk_texture_loader_load_async);
+
+  if (g_task_return_error_if_cancelled (task))
+    {
+      g_object_unref (task);
+      return;
+    }
+
+  request = g_new0 (Request, 1);
+  request->loader = self;
+  request->task = task;
+  g_task_set_task_data (task, request, request_free);
+
+  key.file = file;
+  key.width = width;
+  key.height = height;
+
+  g_mutex_lock (&self->lock);
+
+  job = g_hash_table_lookup (self->jobs, &key);
+  if (job == NULL)
+    {
+      job = job_new (file, width, height, priority, self->sequence++);
+      g_hash_table_add (self->jobs, job);
+      g_ptr_array_add (self->pending, job);
+    }
+  else if (!job->running)
+    {
+      job->priority = MIN (job->priority, priority);
+    }
+
+  g_ptr_array_add (job->requests, request);
+  request->job = job;
+
+  gdk_texture_loader_dispatch (self);
+
+  g_mutex_unlock (&self->lock);
+
+  if (cancellable)
+    {
+      request->cancellable = g_object_ref (cancellable);
+      request->cancelled_id = g_cancellable_connect (cancellable,
+                                                     G_CALLBACK (request_cancelled_cb),
+                                                     request,
+                                                     NULL);
+    }
+}
+
+/**
+ * gdk_texture_loader_load_finish:
+ * @self: a `GdkTextureLoader`
+ * @result: the `GAsyncResult`
+ * @error: return location for an error
+ *
+ * Finishes a load started with [method@Gdk.TextureLoader.load_async].
+ *
+ * Returns: (transfer full): the loaded texture
+ *
+ * Since: 4.18
+ */
+GdkTexture *
+gdk_texture_loader_load_finish (GdkTextureLoader  *self,
+                                GAsyncResult      *result,
+                                GError           **error)
+{
+  g_return_val_if_fail (g_task_is_valid (result, self), NULL);
+  g_return_val_if_fail (g_task_get_source_tag (G_TASK (result)) == gdk_texture_loader_load_async, NULL);
+
+  return g_task_propagate_pointer (G_TASK (result), error);
+}
+
+/**
+ * gdk_texture_loader_set_priority:
+ * @self: a `GdkTextureLoader`
+ * @file: the file
+ * @priority: the new priority
+ *
+ * Changes the priority of the queued loads of @file.
+ *
+ * This is useful when the visible area changes, and images that
+ * were far away become visible.
+ *
+ * Since: 4.18
+ */
+void
+gdk_texture_loader_set_priority (GdkTextureLoader *self,
+                                 GFile            *file,
+                                 int               priority)
+{
+  guint i;
+
+  g_return_if_fail (GDK_IS_TEXTURE_LOADER (self));
+  g_return_if_fail (G_IS_FILE (file));
+
+  g_mutex_lock (&self->lock);
+
+  for (i = 0; i < self->pending->len; i++)
+    {
+      Job *job = g_ptr_array_index (self->pending, i);
+
+      if (g_file_equal (job->file, file))
+        job->priority = priority;
+    }
+
+  g_mutex_unlock (&self->lock);
+}
+
+/**
+ * gdk_texture_loader_cancel_above:
+ * @self: a `GdkTextureLoader`
+ * @priority: the priority to keep
+ *
+ * Cancels all queued loads with a priority larger than @priority.
+ *
+ * When priorities are distances from the visible area, this drops
+ * the images that have been scrolled far out of view before they
+ * are decoded. Their callbacks are called with a
+ * %G_IO_ERROR_CANCELLED error.
+ *
+ * Loads that are already running are not cancelled.
+ *
+ * Returns: the number of cancelled loads
+ *
+ * Since: 4.18
+ */
+guint
+gdk_texture_loader_cancel_above (GdkTextureLoader *self,
+                                 int               priority)
+{
+  GPtrArray *tasks;
+  guint i, j, n_cancelled;
+
+  g_return_val_if_fail (GDK_IS_TEXTURE_LOADER (self), 0);
+
+  tasks = g_ptr_array_new ();
+
+  g_mutex_lock (&self->lock);
+
+  for (i = 0; i < self->pending->len; )
+    {
+      Job *job = g_ptr_array_index (self->pending, i);
+
+      if (job->priority <= priority)
+        {
+          i++;
+          continue;
+        }
+
+      for (j = 0; j < job->requests->len; j++)
+        {
+          Request *request = g_ptr_array_index (job->requests, j);
+
+          request->job = NULL;
+          g_ptr_array_add (tasks, g_steal_pointer (&request->task));
+        }
+
+      g_ptr_array_remove_index_fast (self->pending, i);
+      g_hash_table_remove (self->jobs, job);
+      job_free (job);
+    }
+
+  g_mutex_unlock (&self->lock);
+
+  n_cancelled = tasks->len;
+
+  for (i = 0; i < tasks->len; i++)
+    {
+      GTask *task = g_ptr_array_index (tasks, i);
+
+      g_task_return_new_error (task, G_IO_ERROR, G_IO_ERROR_CANCELLED, "%s", _("Operation was cancelled"));
+      g_object_unref (task);
+    }
+
+  g_ptr_array_unref (tasks);
+
+  return n_cancelled;
+}
+
+/* }}} */
+
+/* vim:set foldmethod=marker: */
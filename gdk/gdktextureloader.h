@@ -0,0 +1,64 @@
+/* GDK - The GIMP Drawing Kit
+ * Copyright (C) 2026 the GTK team
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#if !defined (__GDK_H_INSIDE__) && !defined (GTK_COMPILATION)
+#error "Only <gdk/gdk.h> can be included directly."
+#endif
+
+#include <gdk/gdktypes.h>
+#include <gio/gio.h>
+
+G_BEGIN_DECLS
+
+#define GDK_TYPE_TEXTURE_LOADER (gdk_texture_loader_get_type ())
+GDK_AVAILABLE_IN_4_18
+GDK_DECLARE_INTERNAL_TYPE (GdkTextureLoader, gdk_texture_loader, GDK, TEXTURE_LOADER, GObject)
+
+GDK_AVAILABLE_IN_4_18
+GdkTextureLoader *      gdk_texture_loader_new                  (void);
+
+GDK_AVAILABLE_IN_4_18
+guint                   gdk_texture_loader_get_max_workers      (GdkTextureLoader       *self);
+GDK_AVAILABLE_IN_4_18
+void                    gdk_texture_loader_set_max_workers      (GdkTextureLoader       *self,
+                                                                 guint                   max_workers);
+
+GDK_AVAILABLE_IN_4_18
+void                    gdk_texture_loader_load_async           (GdkTextureLoader       *self,
+                                                                 GFile                  *file,
+                                                                 int                     width,
+                                                                 int                     height,
+                                                                 int                     priority,
+                                                                 GCancellable           *cancellable,
+                                                                 GAsyncReadyCallback     callback,
+                                                                 gpointer                user_data);
+GDK_AVAILABLE_IN_4_18
+GdkTexture *            gdk_texture_loader_load_finish          (GdkTextureLoader       *self,
+                                                                 GAsyncResult           *result,
+                                                                 GError                **error);
+
+GDK_AVAILABLE_IN_4_18
+void                    gdk_texture_loader_set_priority         (GdkTextureLoader       *self,
+                                                                 GFile                  *file,
+                                                                 int                     priority);
+GDK_AVAILABLE_IN_4_18
+guint                   gdk_texture_loader_cancel_above         (GdkTextureLoader       *self,
+                                                                 int                     priority);
+
+G_END_DECLS
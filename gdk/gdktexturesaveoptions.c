@@ -0,0 +1,286 @@
+/* GDK - The GIMP Drawing Kit
+ * Copyright (C) 2026 the GTK team
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/**
+ * GdkTextureSaveOptions:
+ *
+ * `GdkTextureSaveOptions` controls how textures are encoded by
+ * [method@Gdk.Texture.save_to_png_bytes_full] and
+ * [method@Gdk.Texture.save_to_tiff_bytes_full].
+ *
+ * The preset picks a trade-off between speed and file size, and
+ * the other settings can be used to tune it further. Setting the
+ * preset resets the settings it controls, so tune them afterwards.
+ * All settings produce lossless images.
+ *
+ * A single `GdkTextureSaveOptions` can be used to save many textures.
+ *
+ * Since: 4.18
+ */
+
+#include "config.h"
+
+#include "gdktexturesaveoptionsprivate.h"
+
+#include <zlib.h>
+
+#define IS_VALID_PRESET(preset) ((guint) (preset) <= GDK_TEXTURE_SAVE_PRESET_SMALL)
+#define IS_VALID_PNG_FILTER(filter) ((guint) (filter) <= GDK_PNG_FILTER_ADAPTIVE)
+
+G_DEFINE_BOXED_TYPE (GdkTextureSaveOptions, gdk_texture_save_options,
+                     gdk_texture_save_options_copy,
+                     gdk_texture_save_options_free)
+
+void
+gdk_texture_save_options_init (GdkTextureSaveOptions *self,
+                               GdkTextureSavePreset   preset)
+{
+  self->preset = preset;
+  self->png_filter = GDK_PNG_FILTER_DEFAULT;
+  /* Splitting the data into independent chunks costs a little
+   * compression, so the default keeps the output unchanged.
+   */
+  self->parallel = preset != GDK_TEXTURE_SAVE_PRESET_DEFAULT;
+}
+
+int
+gdk_texture_save_options_get_zlib_level (const GdkTextureSaveOptions *self)
+{
+  switch (self->preset)
+    {
+    case GDK_TEXTURE_SAVE_PRESET_DEFAULT:
+      return Z_DEFAULT_COMPRESSION;
+    case GDK_TEXTURE_SAVE_PRESET_FAST:
+      return Z_BEST_SPEED;
+    case GDK_TEXTURE_SAVE_PRESET_SMALL:
+      return Z_BEST_COMPRESSION;
+    default:
+      g_assert_not_reached ();
+    }
+}
+
+GdkPngFilter
+gdk_texture_save_options_resolve_png_filter (const GdkTextureSaveOptions *self)
+{
+  if (self->png_filter != GDK_PNG_FILTER_DEFAULT)
+    return self->png_filter;
+
+  switch (self->preset)
+    {
+    case GDK_TEXTURE_SAVE_PRESET_DEFAULT:
+    case GDK_TEXTURE_SAVE_PRESET_SMALL:
+      return GDK_PNG_FILTER_ADAPTIVE;
+    case GDK_TEXTURE_SAVE_PRESET_FAST:
+      /* Cheap, and works well for user interface content */
+      return GDK_PNG_FILTER_UP;
+    default:
+      g_assert_not_reached ();
+    }
+}
+
+/**
+ * gdk_texture_save_options_new:
+ * @preset: the preset to start from
+ *
+ * Creates new save options with the settings of @preset.
+ *
+ * Returns: the new save options
+ *
+ * Since: 4.18
+ **/
+GdkTextureSaveOptions *
+gdk_texture_save_options_new (GdkTextureSavePreset preset)
+{
+  GdkTextureSaveOptions *self;
+
+  g_return_val_if_fail (IS_VALID_PRESET (preset), NULL);
+
+  self = g_new (GdkTextureSaveOptions, 1);
+  gdk_texture_save_options_init (self, preset);
+
+  return self;
+}
+
+/**
+ * gdk_texture_save_options_copy:
+ * @self: the options to copy
+ *
+ * Creates a copy of the save options.
+ *
+ * This function is meant for language bindings.
+ *
+ * Returns: A copy of the options
+ *
+ * Since: 4.18
+ **/
+GdkTextureSaveOptions *
+gdk_texture_save_options_copy (const GdkTextureSaveOptions *self)
+{
+  g_return_val_if_fail (self != NULL, NULL);
+
+  return g_memdup2 (self, sizeof (GdkTextureSaveOptions));
+}
+
+/**
+ * gdk_texture_save_options_free:
+ * @self: save options to free
+ *
+ * Frees the given save options.
+ *
+ * Since: 4.18
+ **/
+void
+gdk_texture_save_options_free (GdkTextureSaveOptions *self)
+{
+  g_return_if_fail (self != NULL);
+
+  g_free (self);
+}
+
+/**
+ * gdk_texture_save_options_set_preset:
+ * @self: save options
+ * @preset: the new preset
+ *
+ * Changes the preset.
+ *
+ * The preset determines the compression level and, for TIFF files,
+ * whether the data is compressed at all.
+ *
+ * It also decides whether compression may use multiple threads, so
+ * this resets the value set with [method@Gdk.TextureSaveOptions.set_parallel]
+ * to the default of @preset. The PNG filter is not changed, because
+ * %GDK_PNG_FILTER_DEFAULT already follows the preset.
+ *
+ * Since: 4.18
+ **/
+void
+gdk_texture_save_options_set_preset (GdkTextureSaveOptions *self,
+                                     GdkTextureSavePreset   preset)
+{
+  GdkPngFilter png_filter;
+
+  g_return_if_fail (self != NULL);
+  g_return_if_fail (IS_VALID_PRESET (preset));
+
+  png_filter = self->png_filter;
+  gdk_texture_save_options_init (self, preset);
+  self->png_filter = png_filter;
+}
+
+/**
+ * gdk_texture_save_options_get_preset:
+ * @self: save options
+ *
+ * Gets the preset set with [method@Gdk.TextureSaveOptions.set_preset].
+ *
+ * Returns: the preset
+ *
+ * Since: 4.18
+ **/
+GdkTextureSavePreset
+gdk_texture_save_options_get_preset (const GdkTextureSaveOptions *self)
+{
+  g_return_val_if_fail (self != NULL, GDK_TEXTURE_SAVE_PRESET_DEFAULT);
+
+  return self->preset;
+}
+
+/**
+ * gdk_texture_save_options_set_png_filter:
+ * @self: save options
+ * @filter: the filter to use
+ *
+ * Sets the filter that is applied to rows of PNG images before
+ * they are compressed.
+ *
+ * The default is %GDK_PNG_FILTER_DEFAULT, which picks a filter
+ * that suits the preset.
+ *
+ * Since: 4.18
+ **/
+void
+gdk_texture_save_options_set_png_filter (GdkTextureSaveOptions *self,
+                                         GdkPngFilter           filter)
+{
+  g_return_if_fail (self != NULL);
+  g_return_if_fail (IS_VALID_PNG_FILTER (filter));
+
+  self->png_filter = filter;
+}
+
+/**
+ * gdk_texture_save_options_get_png_filter:
+ * @self: save options
+ *
+ * Gets the filter set with [method@Gdk.TextureSaveOptions.set_png_filter].
+ *
+ * Returns: the PNG filter
+ *
+ * Since: 4.18
+ **/
+GdkPngFilter
+gdk_texture_save_options_get_png_filter (const GdkTextureSaveOptions *self)
+{
+  g_return_val_if_fail (self != NULL, GDK_PNG_FILTER_DEFAULT);
+
+  return self->png_filter;
+}
+
+/**
+ * gdk_texture_save_options_set_parallel:
+ * @self: save options
+ * @parallel: whether to compress on multiple threads
+ *
+ * Sets whether the image may be split into chunks of rows that are
+ * converted and compressed on multiple threads.
+ *
+ * This is much faster for large images, but the files get slightly
+ * larger. It is enabled for all presets except
+ * %GDK_TEXTURE_SAVE_PRESET_DEFAULT.
+ *
+ * Changing the preset resets this setting, so call this function
+ * after [method@Gdk.TextureSaveOptions.set_preset].
+ *
+ * Since: 4.18
+ **/
+void
+gdk_texture_save_options_set_parallel (GdkTextureSaveOptions *self,
+                                       gboolean               parallel)
+{
+  g_return_if_fail (self != NULL);
+
+  self->parallel = parallel;
+}
+
+/**
+ * gdk_texture_save_options_get_parallel:
+ * @self: save options
+ *
+ * Gets whether the image may be compressed on multiple threads.
+ *
+ * Returns: %TRUE if compression may use multiple threads
+ *
+ * Since: 4.18
+ **/
+gboolean
+gdk_texture_save_options_get_parallel (const GdkTextureSaveOptions *self)
+{
+  g_return_val_if_fail (self != NULL, FALSE);
+
+  return self->parallel;
+}
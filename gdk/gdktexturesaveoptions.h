@@ -0,0 +1,59 @@
+/* GDK - The GIMP Drawing Kit
+ * Copyright (C) 2026 the GTK team
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#if !defined (__GDK_H_INSIDE__) && !defined (GTK_COMPILATION)
+#error "Only <gdk/gdk.h> can be included directly."
+#endif
+
+#include <gdk/gdktypes.h>
+
+G_BEGIN_DECLS
+
+#define GDK_TYPE_TEXTURE_SAVE_OPTIONS    (gdk_texture_save_options_get_type ())
+
+GDK_AVAILABLE_IN_4_18
+GType                   gdk_texture_save_options_get_type       (void) G_GNUC_CONST;
+GDK_AVAILABLE_IN_4_18
+GdkTextureSaveOptions * gdk_texture_save_options_new            (GdkTextureSavePreset            preset);
+
+GDK_AVAILABLE_IN_4_18
+GdkTextureSaveOptions * gdk_texture_save_options_copy           (const GdkTextureSaveOptions    *self);
+GDK_AVAILABLE_IN_4_18
+void                    gdk_texture_save_options_free           (GdkTextureSaveOptions          *self);
+
+GDK_AVAILABLE_IN_4_18
+void                    gdk_texture_save_options_set_preset     (GdkTextureSaveOptions          *self,
+                                                                 GdkTextureSavePreset            preset);
+GDK_AVAILABLE_IN_4_18
+GdkTextureSavePreset    gdk_texture_save_options_get_preset     (const GdkTextureSaveOptions    *self);
+GDK_AVAILABLE_IN_4_18
+void                    gdk_texture_save_options_set_png_filter (GdkTextureSaveOptions          *self,
+                                                                 GdkPngFilter                    filter);
+GDK_AVAILABLE_IN_4_18
+GdkPngFilter            gdk_texture_save_options_get_png_filter (const GdkTextureSaveOptions    *self);
+GDK_AVAILABLE_IN_4_18
+void                    gdk_texture_save_options_set_parallel   (GdkTextureSaveOptions          *self,
+                                                                 gboolean                        parallel);
+GDK_AVAILABLE_IN_4_18
+gboolean                gdk_texture_save_options_get_parallel   (const GdkTextureSaveOptions    *self);
+
+G_DEFINE_AUTOPTR_CLEANUP_FUNC(GdkTextureSaveOptions, gdk_texture_save_options_free)
+
+G_END_DECLS
+
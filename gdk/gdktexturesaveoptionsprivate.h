@@ -0,0 +1,40 @@
+/* GDK - The GIMP Drawing Kit
+ * Copyright (C) 2026 the GTK team
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include "gdktexturesaveoptions.h"
+
+G_BEGIN_DECLS
+
+struct _GdkTextureSaveOptions
+{
+  /*< private >*/
+  GdkTextureSavePreset preset;
+  GdkPngFilter png_filter;
+  gboolean parallel;
+};
+
+void                    gdk_texture_save_options_init           (GdkTextureSaveOptions          *self,
+                                                                 GdkTextureSavePreset            preset);
+
+int                     gdk_texture_save_options_get_zlib_level (const GdkTextureSaveOptions    *self);
+GdkPngFilter            gdk_texture_save_options_resolve_png_filter
+                                                                (const GdkTextureSaveOptions    *self);
+
+G_END_DECLS
+
@@ -0,0 +1,455 @@
+/* GDK - The GIMP Drawing Kit
+ * Copyright (C) 2026 the GTK team
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "config.h"
+
+#include "gdkimagescalerprivate.h"
+
+#include <glib/gi18n-lib.h>
+#include "gdkcolorstateprivate.h"
+#include "gdkmemorytexturebuilder.h"
+#include "gdkrectangle.h"
+#include "gdktexturedownloaderprivate.h"
+
+/* A streaming box filter.
+ *
+ * The loaders feed decoded rows into the scaler from top to bottom,
+ * and it only keeps the row that is currently being accumulated, so
+ * that a big image can be loaded at a small size without ever holding
+ * it in memory at full resolution.
+ *
+ * Every result pixel is the average of the source pixels it covers,
+ * computed on premultiplied float values so that transparent pixels
+ * don't bleed their color. When scaling up, source pixels are simply
+ * repeated.
+ */
+
+struct _GdkImageScaler
+{
+  GdkMemoryFormat format;
+  GdkColorState *color_state;
+  GdkRectangle source;
+  int width;
+  int height;
+
+  int *x_start;         /* width + 1 entries, relative to source.x */
+  int *y_start;         /* height + 1 entries */
+
+  float *row;           /* the last source row, converted */
+  float *sum;           /* the sums for the result row at dest_y */
+  guint n_rows;
+  int dest_y;
+
+  guchar *data;
+  gsize stride;
+};
+
+/* {{{ Utilities */
+
+static inline int
+span_start (int start,
+            int source_size,
+            int dest_size,
+            int i)
+{
+  return start + (int) ((gint64) i * source_size / dest_size);
+}
+
+static void
+gdk_image_scaler_add_row (GdkImageScaler *self)
+{
+  float *sum = self->sum;
+  int dx, x;
+
+  for (dx = 0; dx < self->width; dx++)
+    {
+      int x0 = self->x_start[dx];
+      int x1 = MAX (self->x_start[dx + 1], x0 + 1);
+      float r = 0, g = 0, b = 0, a = 0;
+      float n = x1 - x0;
+
+      for (x = x0; x < x1; x++)
+        {
+          const float *p = &self->row[4 * x];
+
+          r += p[0];
+          g += p[1];
+          b += p[2];
+          a += p[3];
+        }
+
+      sum[0] += r / n;
+      sum[1] += g / n;
+      sum[2] += b / n;
+      sum[3] += a / n;
+      sum += 4;
+    }
+
+  self->n_rows++;
+}
+
+static void
+gdk_image_scaler_emit_row (GdkImageScaler *self)
+{
+  gsize i;
+
+  if (self->n_rows > 1)
+    {
+      for (i = 0; i < 4 * self->width; i++)
+        self->sum[i] /= self->n_rows;
+    }
+
+  gdk_memory_convert (self->data + self->dest_y * self->stride,
+                      self->stride,
+                      self->format,
+                      self->color_state,
+                      (const guchar *) self->sum,
+                      4 * sizeof (float) * self->width,
+                      GDK_MEMORY_R32G32B32A32_FLOAT_PREMULTIPLIED,
+                      self->color_state,
+                      self->width,
+                      1);
+
+  memset (self->sum, 0, 4 * sizeof (float) * self->width);
+  self->n_rows = 0;
+  self->dest_y++;
+}
+
+/* }}} */
+/* {{{ Private API */
+
+/*
+ * gdk_image_scaler_compute_size:
+ * @image_width: the width of the image being loaded
+ * @image_height: the height of the image being loaded
+ * @clip: (nullable): the requested area of the image
+ * @width: the requested width, or -1
+ * @height: the requested height, or -1
+ * @out_clip: (out): the area of the image to load
+ * @out_width: (out): the width of the result
+ * @out_height: (out): the height of the result
+ * @error: return location for an error
+ *
+ * Resolves a load request against the actual image size.
+ *
+ * The clip is intersected with the image. If only one of @width
+ * and @height is given, the other one is chosen to keep the aspect
+ * ratio of the clip, if neither is given, the clip is loaded at
+ * its own size.
+ *
+ * Returns: %FALSE if the clip does not intersect the image
+ */
+gboolean
+gdk_image_scaler_compute_size (int                 image_width,
+                               int                 image_height,
+                               const GdkRectangle *clip,
+                               int                 width,
+                               int                 height,
+                               GdkRectangle       *out_clip,
+                               int                *out_width,
+                               int                *out_height,
+                               GError            **error)
+{
+  GdkRectangle image = { 0, 0, image_width, image_height };
+
+  if (clip == NULL)
+    {
+      *out_clip = image;
+    }
+  else if (!gdk_rectangle_intersect (clip, &image, out_clip))
+    {
+      /* Not GDK_TEXTURE_ERROR_UNSUPPORTED_CONTENT, that would make
+       * gdk_texture_new_from_bytes_at_size() try other loaders */
+      g_set_error (error,
+                   G_IO_ERROR, G_IO_ERROR_INVALID_ARGUMENT,
+                   _("Region %d,%d %dx%d is outside of the %dx%d image"),
+                   clip->x, clip->y, clip->width, clip->height,
+                   image_width, image_height);
+      return FALSE;
+    }
+
+  if (width <= 0 && height <= 0)
+    {
+      width = out_clip->width;
+      height = out_clip->height;
+    }
+  else if (width <= 0)
+    {
+      width = MAX (1, (gint64) out_clip->width * height / out_clip->height);
+    }
+  else if (height <= 0)
+    {
+      height = MAX (1, (gint64) out_clip->height * width / out_clip->width);
+    }
+
+  *out_width = width;
+  *out_height = height;
+
+  return TRUE;
+}
+
+/*
+ * gdk_image_scaler_new:
+ * @format: the format of the rows that will be pushed
+ * @color_state: the color state of the image
+ * @source: the area of the image to scale
+ * @width: the width of the result
+ * @height: the height of the result
+ * @error: return location for an error
+ *
+ * Creates a scaler that turns the @source area of an image into
+ * a texture of the given size. The texture has the same format and
+ * color state as the image.
+ *
+ * Returns: (nullable): the new scaler
+ */
+GdkImageScaler *
+gdk_image_scaler_new (GdkMemoryFormat     format,
+                      GdkColorState      *color_state,
+                      const GdkRectangle *source,
+                      int                 width,
+                      int                 height,
+                      GError            **error)
+{
+  GdkImageScaler *self;
+  gsize stride;
+  guchar *data;
+  int i;
+
+  g_return_val_if_fail (source->width > 0 && source->height > 0, NULL);
+  g_return_val_if_fail (width > 0 && height > 0, NULL);
+
+  if (!g_size_checked_mul (&stride, width, gdk_memory_format_bytes_per_pixel (format)) ||
+      (data = g_try_malloc0_n (height, stride)) == NULL)
+    {
+      g_set_error (error,
+                   GDK_TEXTURE_ERROR, GDK_TEXTURE_ERROR_TOO_LARGE,
+                   _("Not enough memory for image size %ux%u"), width, height);
+      return NULL;
+    }
+
+  self = g_new0 (GdkImageScaler, 1);
+
+  self->format = format;
+  self->color_state = gdk_color_state_ref (color_state);
+  self->source = *source;
+  self->width = width;
+  self->height = height;
+  self->data = data;
+  self->stride = stride;
+
+  self->x_start = g_new (int, width + 1);
+  for (i = 0; i <= width; i++)
+    self->x_start[i] = span_start (0, source->width, width, i);
+
+  self->y_start = g_new (int, height + 1);
+  for (i = 0; i <= height; i++)
+    self->y_start[i] = span_start (source->y, source->height, height, i);
+
+  self->row = g_new (float, 4 * (gsize) source->width);
+  self->sum = g_new0 (float, 4 * (gsize) width);
+
+  return self;
+}
+
+void
+gdk_image_scaler_free (GdkImageScaler *self)
+{
+  gdk_color_state_unref (self->color_state);
+  g_free (self->x_start);
+  g_free (self->y_start);
+  g_free (self->row);
+  g_free (self->sum);
+  g_free (self->data);
+  g_free (self);
+}
+
+/*
+ * gdk_image_scaler_push_row:
+ * @self: a scaler
+ * @y: the row of the image
+ * @row: the pixel data of the row
+ * @row_x: the column of the image that the first pixel of @row is in
+ *
+ * Feeds a row of the image to the scaler. Rows must be pushed in
+ * increasing order, rows outside of the source area are ignored.
+ * @row must cover all columns of the source area.
+ */
+void
+gdk_image_scaler_push_row (GdkImageScaler *self,
+                           int             y,
+                           const guchar   *row,
+                           int             row_x)
+{
+  gboolean converted = FALSE;
+
+  g_assert (row_x <= self->source.x);
+
+  while (self->dest_y < self->height)
+    {
+      int y0 = self->y_start[self->dest_y];
+      int y1 = MAX (self->y_start[self->dest_y + 1], y0 + 1);
+
+      if (y < y0)
+        return;
+
+      /* The loader skipped rows, don't get stuck */
+      if (y >= y1)
+        {
+          gdk_image_scaler_emit_row (self);
+          continue;
+        }
+
+      if (!converted)
+        {
+          gsize bpp = gdk_memory_format_bytes_per_pixel (self->format);
+
+          gdk_memory_convert ((guchar *) self->row,
+                              4 * sizeof (float) * self->source.width,
+                              GDK_MEMORY_R32G32B32A32_FLOAT_PREMULTIPLIED,
+                              self->color_state,
+                              row + (self->source.x - row_x) * bpp,
+                              bpp * self->source.width,
+                              self->format,
+                              self->color_state,
+                              self->source.width,
+                              1);
+          converted = TRUE;
+        }
+
+      gdk_image_scaler_add_row (self);
+
+      if (y + 1 < y1)
+        return;
+
+      /* When scaling up, the same row contributes to the next result row, too */
+      gdk_image_scaler_emit_row (self);
+    }
+}
+
+/*
+ * gdk_image_scaler_is_done:
+ * @self: a scaler
+ *
+ * Returns whether all rows of the result have been computed, so
+ * that loaders can stop decoding.
+ *
+ * Returns: %TRUE if no more rows are needed
+ */
+gboolean
+gdk_image_scaler_is_done (GdkImageScaler *self)
+{
+  return self->dest_y >= self->height;
+}
+
+/*
+ * gdk_image_scaler_finish:
+ * @self: (transfer full): a scaler
+ *
+ * Creates the texture and frees the scaler. Result rows that
+ * never received any data are left transparent.
+ *
+ * Returns: (transfer full): the scaled texture
+ */
+GdkTexture *
+gdk_image_scaler_finish (GdkImageScaler *self)
+{
+  GdkMemoryTextureBuilder *builder;
+  GdkTexture *texture;
+  GBytes *bytes;
+
+  if (self->n_rows > 0)
+    gdk_image_scaler_emit_row (self);
+
+  bytes = g_bytes_new_take (g_steal_pointer (&self->data), self->height * self->stride);
+
+  builder = gdk_memory_texture_builder_new ();
+  gdk_memory_texture_builder_set_format (builder, self->format);
+  gdk_memory_texture_builder_set_color_state (builder, self->color_state);
+  gdk_memory_texture_builder_set_width (builder, self->width);
+  gdk_memory_texture_builder_set_height (builder, self->height);
+  gdk_memory_texture_builder_set_bytes (builder, bytes);
+  gdk_memory_texture_builder_set_stride (builder, self->stride);
+  texture = gdk_memory_texture_builder_build (builder);
+  g_object_unref (builder);
+  g_bytes_unref (bytes);
+
+  gdk_image_scaler_free (self);
+
+  return texture;
+}
+
+/*
+ * gdk_image_scaler_scale_texture:
+ * @texture: a texture
+ * @source: the area of @texture to scale
+ * @width: the width of the result
+ * @height: the height of the result
+ * @error: return location for an error
+ *
+ * Scales an already loaded texture. This is used by the loaders
+ * for the cases where the image can't be decoded row by row.
+ *
+ * Returns: (nullable) (transfer full): the scaled texture
+ */
+GdkTexture *
+gdk_image_scaler_scale_texture (GdkTexture          *texture,
+                                const GdkRectangle  *source,
+                                int                  width,
+                                int                  height,
+                                GError             **error)
+{
+  GdkTextureDownloader downloader;
+  GdkImageScaler *scaler;
+  GdkMemoryFormat format;
+  GdkColorState *color_state;
+  GBytes *bytes;
+  const guchar *data;
+  gsize stride;
+  int y;
+
+  if (source->x == 0 && source->y == 0 &&
+      source->width == gdk_texture_get_width (texture) &&
+      source->height == gdk_texture_get_height (texture) &&
+      width == source->width && height == source->height)
+    return g_object_ref (texture);
+
+  format = gdk_texture_get_format (texture);
+  color_state = gdk_texture_get_color_state (texture);
+
+  scaler = gdk_image_scaler_new (format, color_state, source, width, height, error);
+  if (scaler == NULL)
+    return NULL;
+
+  gdk_texture_downloader_init (&downloader, texture);
+  gdk_texture_downloader_set_format (&downloader, format);
+  gdk_texture_downloader_set_color_state (&downloader, color_state);
+  bytes = gdk_texture_downloader_download_bytes (&downloader, &stride);
+  gdk_texture_downloader_finish (&downloader);
+  data = g_bytes_get_data (bytes, NULL);
+
+  for (y = source->y; y < source->y + source->height && !gdk_image_scaler_is_done (scaler); y++)
+    gdk_image_scaler_push_row (scaler, y, data + y * stride, 0);
+
+  g_bytes_unref (bytes);
+
+  return gdk_image_scaler_finish (scaler);
+}
+
+/* }}} */
+
+/* vim:set foldmethod=marker: */
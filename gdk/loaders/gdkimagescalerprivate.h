@@ -0,0 +1,58 @@
+/* GDK - The GIMP Drawing Kit
+ * Copyright (C) 2026 the GTK team
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include "gdktexture.h"
+#include "gdkmemoryformatprivate.h"
+
+G_BEGIN_DECLS
+
+typedef struct _GdkImageScaler GdkImageScaler;
+
+gboolean                gdk_image_scaler_compute_size   (int                     image_width,
+                                                         int                     image_height,
+                                                         const GdkRectangle     *clip,
+                                                         int                     width,
+                                                         int                     height,
+                                                         GdkRectangle           *out_clip,
+                                                         int                    *out_width,
+                                                         int                    *out_height,
+                                                         GError                **error);
+
+GdkImageScaler *        gdk_image_scaler_new            (GdkMemoryFormat         format,
+                                                         GdkColorState          *color_state,
+                                                         const GdkRectangle     *source,
+                                                         int                     width,
+                                                         int                     height,
+                                                         GError                **error);
+void                    gdk_image_scaler_free           (GdkImageScaler         *self);
+
+void                    gdk_image_scaler_push_row       (GdkImageScaler         *self,
+                                                         int                     y,
+                                                         const guchar           *row,
+                                                         int                     row_x);
+gboolean                gdk_image_scaler_is_done        (GdkImageScaler         *self);
+GdkTexture *            gdk_image_scaler_finish         (GdkImageScaler         *self);
+
+GdkTexture *            gdk_image_scaler_scale_texture  (GdkTexture             *texture,
+                                                         const GdkRectangle     *source,
+                                                         int                     width,
+                                                         int                     height,
+                                                         GError                **error);
+
+G_END_DECLS
@@ -26,6 +26,7 @@
 #include "gdktexturedownloaderprivate.h"
 #include "gdkmemorytexturebuilder.h"
 #include "gdkcolorstateprivate.h"
+#include "gdkimagescalerprivate.h"
 
 #include "gdkprofilerprivate.h"
 
@@ -114,6 +115,31 @@ convert_cmyk_to_rgba (guchar *data,
     }
 }
 
+/* }}} */
+/* {{{ Scaling */
+
+/* Number of rows to decode per jpeg_read_scanlines() batch */
+#define JPEG_STRIP_ROWS 16
+
+/* Maps a span of the image to the output of a DCT-scaled decode,
+ * rounding outwards.
+ */
+static void
+scale_span (int    start,
+            int    size,
+            guint  image_size,
+            guint  output_size,
+            int   *out_start,
+            int   *out_size)
+{
+  gint64 end;
+
+  *out_start = (gint64) start * output_size / image_size;
+  end = ((gint64) (start + size) * output_size + image_size - 1) / image_size;
+  end = CLAMP (end, *out_start + 1, output_size);
+  *out_size = end - *out_start;
+}
+
 /* }}} */
 /* {{{ Public API */
 
@@ -230,6 +256,510 @@ gdk_load_jpeg (GBytes  *input_bytes,
   return texture;
 }
 
+/*
+ * gdk_load_jpeg_at_size:
+ * @input_bytes: the JPEG data
+ * @clip: (nullable): the area of the image to load
+ * @width: the width of the result, or -1
+ * @height: the height of the result, or -1
+ * @error: return location for an error
+ *
+ * Loads a region of a JPEG image at the given size.
+ *
+ * libjpeg is asked to do as much of the downscaling as it can while
+ * decoding, at 1/2, 1/4 or 1/8 of the image size, and the remaining
+ * scaling is done while the rows are decoded. With libjpeg-turbo,
+ * the columns and rows outside of @clip are not decoded at all.
+ *
+ * Returns: (nullable): the texture
+ */
+GdkTexture *
+gdk_load_jpeg_at_size (GBytes              *input_bytes,
+                       const GdkRectangle  *clip,
+                       int                  width,
+                       int                  height,
+                       GError             **error)
+{
+  struct jpeg_decompress_struct info;
+  struct error_handler_data jerr;
+  GdkImageScaler *scaler = NULL;
+  unsigned char *strip = NULL;
+  unsigned char *rows[JPEG_STRIP_ROWS];
+  GdkRectangle area, source;
+  int dest_width, dest_height;
+  guint denom, stride, row_x, n, i;
+  GdkMemoryFormat format;
+  GdkTexture *texture;
+  G_GNUC_UNUSED guint64 before = GDK_PROFILER_CURRENT_TIME;
+
+  info.err = jpeg_std_error (&jerr.pub);
+  jerr.pub.error_exit = fatal_error_handler;
+  jerr.pub.output_message = output_message_handler;
+  jerr.error = error;
+
+  if (sigsetjmp (jerr.setjmp_buffer, 1))
+    {
+      g_free (strip);
+      g_clear_pointer (&scaler, gdk_image_scaler_free);
+      jpeg_destroy_decompress (&info);
+      return NULL;
+    }
+
+  jpeg_create_decompress (&info);
+
+  info.mem->max_memory_to_use = 1024 * 1024 * 1024;
+
+  jpeg_mem_src (&info,
+                g_bytes_get_data (input_bytes, NULL),
+                g_bytes_get_size (input_bytes));
+
+  jpeg_read_header (&info, TRUE);
+
+  if (!gdk_image_scaler_compute_size (info.image_width, info.image_height,
+                                      clip, width, height,
+                                      &area, &dest_width, &dest_height,
+                                      error))
+    {
+      jpeg_destroy_decompress (&info);
+      return NULL;
+    }
+
+  if (area.width == (int) info.image_width && area.height == (int) info.image_height &&
+      dest_width == area.width && dest_height == area.height)
+    {
+      jpeg_destroy_decompress (&info);
+      return gdk_load_jpeg (input_bytes, error);
+    }
+
+  /* Let the IDCT do as much of the downscaling as possible */
+  for (denom = 8; denom > 1; denom /= 2)
+    {
+      if (area.width / (int) denom >= dest_width &&
+          area.height / (int) denom >= dest_height)
+        break;
+    }
+  info.scale_num = 1;
+  info.scale_denom = denom;
+
+  switch ((int)info.out_color_space)
+    {
+    case JCS_GRAYSCALE:
+      format = GDK_MEMORY_G8;
+      break;
+    case JCS_RGB:
+      format = GDK_MEMORY_R8G8B8;
+      break;
+    case JCS_CMYK:
+      format = GDK_MEMORY_R8G8B8A8_PREMULTIPLIED;
+      break;
+    default:
+      g_set_error (error,
+                   GDK_TEXTURE_ERROR, GDK_TEXTURE_ERROR_UNSUPPORTED_CONTENT,
+                   _("Unsupported JPEG colorspace (%d)"), info.out_color_space);
+      jpeg_destroy_decompress (&info);
+      return NULL;
+    }
+
+  jpeg_start_decompress (&info);
+
+  scale_span (area.x, area.width, info.image_width, info.output_width, &source.x, &source.width);
+  scale_span (area.y, area.height, info.image_height, info.output_height, &source.y, &source.height);
+
+#if LIBJPEG_TURBO_VERSION_NUMBER >= 1005000
+  {
+    JDIMENSION crop_x = source.x;
+    JDIMENSION crop_width = source.width;
+
+    /* This widens the range to iMCU boundaries */
+    jpeg_crop_scanline (&info, &crop_x, &crop_width);
+    row_x = crop_x;
+
+    if (source.y > 0)
+      jpeg_skip_scanlines (&info, source.y);
+  }
+#else
+  row_x = 0;
+#endif
+
+  scaler = gdk_image_scaler_new (format, GDK_COLOR_STATE_SRGB,
+                                 &source, dest_width, dest_height,
+                                 error);
+  if (scaler == NULL)
+    {
+      jpeg_destroy_decompress (&info);
+      return NULL;
+    }
+
+  stride = info.output_width * info.output_components;
+  strip = g_try_malloc_n (JPEG_STRIP_ROWS, stride);
+  if (!strip)
+    {
+      g_set_error (error,
+                   GDK_TEXTURE_ERROR, GDK_TEXTURE_ERROR_TOO_LARGE,
+                   _("Not enough memory for image size %ux%u"), info.output_width, info.output_height);
+      gdk_image_scaler_free (scaler);
+      jpeg_destroy_decompress (&info);
+      return NULL;
+    }
+
+  for (i = 0; i < JPEG_STRIP_ROWS; i++)
+    rows[i] = &strip[i * stride];
+
+  while (info.output_scanline < info.output_height &&
+         !gdk_image_scaler_is_done (scaler))
+    {
+      guint first = info.output_scanline;
+
+      n = 0;
+      while (n < JPEG_STRIP_ROWS && info.output_scanline < info.output_height)
+        n += jpeg_read_scanlines (&info, &rows[n], JPEG_STRIP_ROWS - n);
+
+      if (info.out_color_space == JCS_CMYK)
+        convert_cmyk_to_rgba (strip, info.output_width, n, stride);
+
+      for (i = 0; i < n; i++)
+        gdk_image_scaler_push_row (scaler, first + i, rows[i], row_x);
+    }
+
+  /* We may have stopped early, so don't finish the decompression */
+  jpeg_destroy_decompress (&info);
+  g_free (strip);
+
+  texture = gdk_image_scaler_finish (scaler);
+
+  gdk_profiler_end_mark (before, "Load jpeg at size", NULL);
+
+  return texture;
+}
+
+/* }}} */
+/* {{{ Incremental loading */
+
+typedef enum {
+  JPEG_STREAM_HEADER,
+  JPEG_STREAM_START,
+  JPEG_STREAM_SCAN_START,
+  JPEG_STREAM_SCANLINES,
+  JPEG_STREAM_SCAN_FINISH,
+  JPEG_STREAM_FINISH,
+  JPEG_STREAM_DONE
+} JpegStreamState;
+
+typedef struct
+{
+  GdkStreamDecoder decoder;
+
+  struct jpeg_decompress_struct info;
+  struct error_handler_data jerr;
+  struct jpeg_source_mgr src;
+  GError *error;
+
+  GByteArray *input;    /* data that libjpeg hasn't consumed yet */
+  gsize skip;           /* bytes to skip that haven't arrived yet */
+  gboolean eof;
+
+  JpegStreamState state;
+  guchar *data;
+  gsize stride;
+} GdkJpegStreamDecoder;
+
+static void
+stream_init_source (j_decompress_ptr cinfo)
+{
+}
+
+static boolean
+stream_fill_input_buffer (j_decompress_ptr cinfo)
+{
+  GdkJpegStreamDecoder *self = cinfo->client_data;
+  static const JOCTET eoi[2] = { 0xFF, JPEG_EOI };
+
+  /* Suspend until more data arrives */
+  if (!self->eof)
+    return FALSE;
+
+  /* Truncated data, end the image like libjpeg's own sources do */
+  WARNMS (cinfo, JWRN_JPEG_EOF);
+  self->src.next_input_byte = eoi;
+  self->src.bytes_in_buffer = 2;
+
+  return TRUE;
+}
+
+static void
+stream_skip_input_data (j_decompress_ptr cinfo,
+                        long             num_bytes)
+{
+  GdkJpegStreamDecoder *self = cinfo->client_data;
+
+  if (num_bytes <= 0)
+    return;
+
+  if ((gsize) num_bytes > self->src.bytes_in_buffer)
+    {
+      self->skip += num_bytes - self->src.bytes_in_buffer;
+      self->src.next_input_byte += self->src.bytes_in_buffer;
+      self->src.bytes_in_buffer = 0;
+    }
+  else
+    {
+      self->src.next_input_byte += num_bytes;
+      self->src.bytes_in_buffer -= num_bytes;
+    }
+}
+
+static void
+stream_term_source (j_decompress_ptr cinfo)
+{
+}
+
+/* Runs the decoder as far as the available data allows.
+ * Progressive JPEGs are decoded in buffered-image mode, and the
+ * image is output after every scan that is complete.
+ */
+static void
+gdk_jpeg_stream_decoder_run (GdkJpegStreamDecoder *self)
+{
+  struct jpeg_decompress_struct *info = &self->info;
+
+  for (;;)
+    {
+      switch (self->state)
+        {
+        case JPEG_STREAM_HEADER:
+          if (jpeg_read_header (info, TRUE) == JPEG_SUSPENDED)
+            return;
+          info->buffered_image = jpeg_has_multiple_scans (info);
+          self->state = JPEG_STREAM_START;
+          break;
+
+        case JPEG_STREAM_START:
+          {
+            GdkMemoryFormat format;
+
+            if (!jpeg_start_decompress (info))
+              return;
+
+            switch ((int)info->out_color_space)
+              {
+              case JCS_GRAYSCALE:
+                format = GDK_MEMORY_G8;
+                break;
+              case JCS_RGB:
+                format = GDK_MEMORY_R8G8B8;
+                break;
+              case JCS_CMYK:
+                format = GDK_MEMORY_R8G8B8A8_PREMULTIPLIED;
+                break;
+              default:
+                g_set_error (&self->error,
+                             GDK_TEXTURE_ERROR, GDK_TEXTURE_ERROR_UNSUPPORTED_CONTENT,
+                             _("Unsupported JPEG colorspace (%d)"), info->out_color_space);
+                siglongjmp (self->jerr.setjmp_buffer, 1);
+              }
+
+            self->data = gdk_progressive_image_begin (self->decoder.image,
+                                                      info->output_width, info->output_height,
+                                                      format, GDK_COLOR_STATE_SRGB,
+                                                      &self->stride,
+                                                      &self->error);
+            if (self->data == NULL)
+              siglongjmp (self->jerr.setjmp_buffer, 1);
+
+            self->state = info->buffered_image ? JPEG_STREAM_SCAN_START : JPEG_STREAM_SCANLINES;
+          }
+          break;
+
+        case JPEG_STREAM_SCAN_START:
+          /* Skip ahead to the most recent scan we have data for */
+          while (!jpeg_input_complete (info))
+            {
+              if (jpeg_consume_input (info) == JPEG_SUSPENDED)
+                break;
+            }
+          if (!jpeg_start_output (info, info->input_scan_number))
+            return;
+          self->state = JPEG_STREAM_SCANLINES;
+          break;
+
+        case JPEG_STREAM_SCANLINES:
+          while (info->output_scanline < info->output_height)
+            {
+              guint y = info->output_scanline;
+              guchar *row = self->data + y * self->stride;
+              gboolean complete;
+
+              if (jpeg_read_scanlines (info, &row, 1) == 0)
+                return;
+
+              if (info->out_color_space == JCS_CMYK)
+                convert_cmyk_to_rgba (row, info->output_width, 1, self->stride);
+
+              /* Progressive JPEGs output every row again after each scan */
+              complete = !info->buffered_image ||
+                         (jpeg_input_complete (info) &&
+                          info->input_scan_number == info->output_scan_number);
+
+              gdk_progressive_image_update (self->decoder.image, y, 1, complete);
+            }
+          self->state = info->buffered_image ? JPEG_STREAM_SCAN_FINISH : JPEG_STREAM_FINISH;
+          break;
+
+        case JPEG_STREAM_SCAN_FINISH:
+          if (!jpeg_finish_output (info))
+            return;
+          if (jpeg_input_complete (info) &&
+              info->input_scan_number == info->output_scan_number)
+            self->state = JPEG_STREAM_FINISH;
+          else
+            self->state = JPEG_STREAM_SCAN_START;
+          break;
+
+        case JPEG_STREAM_FINISH:
+          if (!jpeg_finish_decompress (info))
+            return;
+          self->state = JPEG_STREAM_DONE;
+          break;
+
+        case JPEG_STREAM_DONE:
+          return;
+
+        default:
+          g_assert_not_reached ();
+        }
+    }
+}
+
+static gboolean
+gdk_jpeg_stream_decoder_process (GdkJpegStreamDecoder  *self,
+                                 GError               **error)
+{
+  gsize consumed;
+
+  if (sigsetjmp (self->jerr.setjmp_buffer, 1))
+    {
+      if (self->error == NULL)
+        g_set_error_literal (&self->error,
+                             GDK_TEXTURE_ERROR, GDK_TEXTURE_ERROR_CORRUPT_IMAGE,
+                             _("Error interpreting JPEG image file"));
+      g_propagate_error (error, g_steal_pointer (&self->error));
+      return FALSE;
+    }
+
+  gdk_jpeg_stream_decoder_run (self);
+
+  /* Keep what libjpeg needs when it resumes */
+  if (self->src.next_input_byte != NULL &&
+      self->src.next_input_byte >= self->input->data &&
+      self->src.next_input_byte <= self->input->data + self->input->len)
+    {
+      consumed = self->src.next_input_byte - self->input->data;
+      g_byte_array_remove_range (self->input, 0, consumed);
+      self->src.next_input_byte = self->input->data;
+    }
+
+  return TRUE;
+}
+
+static gboolean
+gdk_jpeg_stream_decoder_feed (GdkStreamDecoder  *decoder,
+                              const guchar      *data,
+                              gsize              size,
+                              GError           **error)
+{
+  GdkJpegStreamDecoder *self = (GdkJpegStreamDecoder *) decoder;
+  gsize skip;
+
+  skip = MIN (self->skip, size);
+  self->skip -= skip;
+
+  g_byte_array_append (self->input, data + skip, size - skip);
+  self->src.next_input_byte = self->input->data;
+  self->src.bytes_in_buffer = self->input->len;
+
+  return gdk_jpeg_stream_decoder_process (self, error);
+}
+
+static gboolean
+gdk_jpeg_stream_decoder_close (GdkStreamDecoder  *decoder,
+                               GError           **error)
+{
+  GdkJpegStreamDecoder *self = (GdkJpegStreamDecoder *) decoder;
+
+  self->eof = TRUE;
+
+  if (!gdk_jpeg_stream_decoder_process (self, error))
+    return FALSE;
+
+  if (self->state != JPEG_STREAM_DONE)
+    {
+      g_set_error_literal (error,
+                           GDK_TEXTURE_ERROR, GDK_TEXTURE_ERROR_CORRUPT_IMAGE,
+                           _("Premature end of JPEG data"));
+      return FALSE;
+    }
+
+  return TRUE;
+}
+
+static void
+gdk_jpeg_stream_decoder_free (GdkStreamDecoder *decoder)
+{
+  GdkJpegStreamDecoder *self = (GdkJpegStreamDecoder *) decoder;
+
+  jpeg_destroy_decompress (&self->info);
+  g_byte_array_unref (self->input);
+  g_clear_error (&self->error);
+  g_free (self);
+}
+
+static const GdkStreamDecoderClass GDK_JPEG_STREAM_DECODER_CLASS = {
+  gdk_jpeg_stream_decoder_feed,
+  gdk_jpeg_stream_decoder_close,
+  gdk_jpeg_stream_decoder_free,
+};
+
+/*
+ * gdk_jpeg_stream_decoder_new:
+ * @image: the image to decode into
+ *
+ * Creates a decoder that uses a suspending data source, so that
+ * libjpeg can decode whatever data has arrived so far.
+ *
+ * Returns: (transfer full): the new decoder
+ */
+GdkStreamDecoder *
+gdk_jpeg_stream_decoder_new (GdkProgressiveImage *image)
+{
+  GdkJpegStreamDecoder *self;
+
+  self = g_new0 (GdkJpegStreamDecoder, 1);
+  self->decoder.klass = &GDK_JPEG_STREAM_DECODER_CLASS;
+  self->decoder.image = image;
+  self->input = g_byte_array_new ();
+
+  self->info.err = jpeg_std_error (&self->jerr.pub);
+  self->jerr.pub.error_exit = fatal_error_handler;
+  self->jerr.pub.output_message = output_message_handler;
+  self->jerr.error = &self->error;
+
+  jpeg_create_decompress (&self->info);
+  self->info.client_data = self;
+  self->info.mem->max_memory_to_use = 1024 * 1024 * 1024;
+
+  self->src.init_source = stream_init_source;
+  self->src.fill_input_buffer = stream_fill_input_buffer;
+  self->src.skip_input_data = stream_skip_input_data;
+  self->src.resync_to_restart = jpeg_resync_to_restart;
+  self->src.term_source = stream_term_source;
+  self->info.src = &self->src;
+
+  return (GdkStreamDecoder *) self;
+}
+
+/* }}} */
+/* {{{ Saving */
+
 GBytes *
 gdk_save_jpeg (GdkTexture *texture)
 {
@@ -18,12 +18,20 @@
 #pragma once
 
 #include "gdkmemorytexture.h"
+#include "gdkprogressiveimageprivate.h"
 #include <gio/gio.h>
 
 #define JPEG_SIGNATURE "\xff\xd8"
 
 GdkTexture *gdk_load_jpeg         (GBytes           *bytes,
                                    GError          **error);
+GdkTexture *gdk_load_jpeg_at_size (GBytes              *bytes,
+                                   const GdkRectangle  *clip,
+                                   int                  width,
+                                   int                  height,
+                                   GError             **error);
+
+GdkStreamDecoder *gdk_jpeg_stream_decoder_new (GdkProgressiveImage *image);
 
 GBytes     *gdk_save_jpeg         (GdkTexture     *texture);
 
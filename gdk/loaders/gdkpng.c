@@ -21,14 +21,18 @@
 
 #include <glib/gi18n-lib.h>
 #include "gdkcolorstateprivate.h"
+#include "gdkimagescalerprivate.h"
 #include "gdkmemoryformatprivate.h"
 #include "gdkmemorytexturebuilder.h"
+#include "gdkparalleltaskprivate.h"
 #include "gdkprofilerprivate.h"
 #include "gdktexturedownloaderprivate.h"
+#include "gdktexturesaveoptionsprivate.h"
 #include "gsk/gl/fp16private.h"
 
 #include <png.h>
 #include <stdio.h>
+#include <zlib.h>
 
 /* The main difference between the png load/save code here and
  * gdk-pixbuf is that we can support loading 16-bit data in the
@@ -264,63 +268,24 @@ gdk_png_set_color_state (png_struct    *png,
 }
 
 /* }}} */
-/* {{{ Public API */
+/* {{{ Reading */
 
-GdkTexture *
-gdk_load_png (GBytes      *bytes,
-              GHashTable  *options,
-              GError     **error)
+/* Sets up the transformations to get the image data in one of
+ * our memory formats. Must be called after the header was read.
+ */
+static gboolean
+gdk_png_setup_read (png_struct       *png,
+                    png_info         *info,
+                    guint            *out_width,
+                    guint            *out_height,
+                    int              *out_interlace,
+                    GdkMemoryFormat  *out_format,
+                    GError          **error)
 {
-  png_io io;
-  png_struct *png = NULL;
-  png_info *info;
-  png_textp text;
-  int num_texts;
   guint width, height;
-  gsize i, stride;
   int depth, color_type;
   int interlace;
-  GdkMemoryTextureBuilder *builder;
   GdkMemoryFormat format;
-  guchar *buffer = NULL;
-  guchar **row_pointers = NULL;
-  GBytes *out_bytes;
-  GdkColorState *color_state;
-  GdkTexture *texture;
-  int bpp;
-  CICPData cicp = { FALSE, };
-
-  G_GNUC_UNUSED gint64 before = GDK_PROFILER_CURRENT_TIME;
-
-  io.data = (guchar *)g_bytes_get_data (bytes, &io.size);
-  io.position = 0;
-
-  png = png_create_read_struct_2 (PNG_LIBPNG_VER_STRING,
-                                  error,
-                                  png_simple_error_callback,
-                                  png_simple_warning_callback,
-                                  NULL,
-                                  png_malloc_callback,
-                                  png_free_callback);
-  if (png == NULL)
-    g_error ("Out of memory");
-
-  info = png_create_info_struct (png);
-  if (info == NULL)
-    g_error ("Out of memory");
-
-  png_set_read_fn (png, &io, png_read_func);
-  png_set_read_user_chunk_fn (png, &cicp, png_read_chunk_func);
-
-  if (sigsetjmp (png_jmpbuf (png), 1))
-    {
-      g_free (buffer);
-      g_free (row_pointers);
-      png_destroy_read_struct (&png, &info, NULL);
-      return NULL;
-    }
-
-  png_read_info (png, info);
 
   png_get_IHDR (png, info,
                 &width, &height, &depth,
@@ -351,11 +316,10 @@ gdk_load_png (GBytes      *bytes,
                 &color_type, &interlace, NULL, NULL);
   if (depth != 8 && depth != 16)
     {
-      png_destroy_read_struct (&png, &info, NULL);
       g_set_error (error,
                    GDK_TEXTURE_ERROR, GDK_TEXTURE_ERROR_UNSUPPORTED_CONTENT,
                    _("Unsupported depth %u in png image"), depth);
-      return NULL;
+      return FALSE;
     }
 
   switch (color_type)
@@ -401,10 +365,81 @@ gdk_load_png (GBytes      *bytes,
         }
       break;
     default:
-      png_destroy_read_struct (&png, &info, NULL);
       g_set_error (error,
                    GDK_TEXTURE_ERROR, GDK_TEXTURE_ERROR_UNSUPPORTED_CONTENT,
                    _("Unsupported color type %u in png image"), color_type);
+      return FALSE;
+    }
+
+  *out_width = width;
+  *out_height = height;
+  *out_interlace = interlace;
+  *out_format = format;
+
+  return TRUE;
+}
+
+/* }}} */
+/* {{{ Public API */
+
+GdkTexture *
+gdk_load_png (GBytes      *bytes,
+              GHashTable  *options,
+              GError     **error)
+{
+  png_io io;
+  png_struct *png = NULL;
+  png_info *info;
+  png_textp text;
+  int num_texts;
+  guint width, height;
+  gsize i, stride;
+  int interlace;
+  GdkMemoryTextureBuilder *builder;
+  GdkMemoryFormat format;
+  guchar *buffer = NULL;
+  guchar **row_pointers = NULL;
+  GBytes *out_bytes;
+  GdkColorState *color_state;
+  GdkTexture *texture;
+  int bpp;
+  CICPData cicp = { FALSE, };
+
+  G_GNUC_UNUSED gint64 before = GDK_PROFILER_CURRENT_TIME;
+
+  io.data = (guchar *)g_bytes_get_data (bytes, &io.size);
+  io.position = 0;
+
+  png = png_create_read_struct_2 (PNG_LIBPNG_VER_STRING,
+                                  error,
+                                  png_simple_error_callback,
+                                  png_simple_warning_callback,
+                                  NULL,
+                                  png_malloc_callback,
+                                  png_free_callback);
+  if (png == NULL)
+    g_error ("Out of memory");
+
+  info = png_create_info_struct (png);
+  if (info == NULL)
+    g_error ("Out of memory");
+
+  png_set_read_fn (png, &io, png_read_func);
+  png_set_read_user_chunk_fn (png, &cicp, png_read_chunk_func);
+
+  if (sigsetjmp (png_jmpbuf (png), 1))
+    {
+      g_free (buffer);
+      g_free (row_pointers);
+      png_destroy_read_struct (&png, &info, NULL);
+      return NULL;
+    }
+
+  png_read_info (png, info);
+
+  if (!gdk_png_setup_read (png, info, &width, &height, &interlace, &format, error))
+    {
+      png_destroy_read_struct (&png, &info, NULL);
       return NULL;
     }
 
@@ -480,9 +515,726 @@ gdk_load_png (GBytes      *bytes,
   return texture;
 }
 
+/*
+ * gdk_load_png_at_size:
+ * @bytes: the PNG data
+ * @clip: (nullable): the area of the image to load
+ * @width: the width of the result, or -1
+ * @height: the height of the result, or -1
+ * @error: return location for an error
+ *
+ * Loads a region of a PNG image at the given size.
+ *
+ * The image is decoded one row at a time and scaled as it goes,
+ * and decoding stops after the last row of @clip. Interlaced images
+ * only have complete rows once the last pass is decoded, so they are
+ * loaded in full and scaled afterwards.
+ *
+ * Returns: (nullable): the texture
+ */
+GdkTexture *
+gdk_load_png_at_size (GBytes              *bytes,
+                      const GdkRectangle  *clip,
+                      int                  width,
+                      int                  height,
+                      GError             **error)
+{
+  png_io io;
+  png_struct *png = NULL;
+  png_info *info;
+  guint image_width, image_height;
+  int interlace, y;
+  GdkMemoryFormat format;
+  GdkColorState *color_state;
+  GdkImageScaler *scaler = NULL;
+  guchar *row = NULL;
+  GdkRectangle area;
+  int dest_width, dest_height;
+  GdkTexture *texture;
+  CICPData cicp = { FALSE, };
+
+  G_GNUC_UNUSED gint64 before = GDK_PROFILER_CURRENT_TIME;
+
+  io.data = (guchar *)g_bytes_get_data (bytes, &io.size);
+  io.position = 0;
+
+  png = png_create_read_struct_2 (PNG_LIBPNG_VER_STRING,
+                                  error,
+                                  png_simple_error_callback,
+                                  png_simple_warning_callback,
+                                  NULL,
+                                  png_malloc_callback,
+                                  png_free_callback);
+  if (png == NULL)
+    g_error ("Out of memory");
+
+  info = png_create_info_struct (png);
+  if (info == NULL)
+    g_error ("Out of memory");
+
+  png_set_read_fn (png, &io, png_read_func);
+  png_set_read_user_chunk_fn (png, &cicp, png_read_chunk_func);
+
+  if (sigsetjmp (png_jmpbuf (png), 1))
+    {
+      g_free (row);
+      g_clear_pointer (&scaler, gdk_image_scaler_free);
+      png_destroy_read_struct (&png, &info, NULL);
+      return NULL;
+    }
+
+  png_read_info (png, info);
+
+  if (!gdk_png_setup_read (png, info, &image_width, &image_height, &interlace, &format, error) ||
+      !gdk_image_scaler_compute_size (image_width, image_height,
+                                      clip, width, height,
+                                      &area, &dest_width, &dest_height,
+                                      error))
+    {
+      png_destroy_read_struct (&png, &info, NULL);
+      return NULL;
+    }
+
+  if (interlace != PNG_INTERLACE_NONE ||
+      (area.width == (int) image_width && area.height == (int) image_height &&
+       dest_width == area.width && dest_height == area.height))
+    {
+      GdkTexture *full;
+
+      png_destroy_read_struct (&png, &info, NULL);
+
+      full = gdk_load_png (bytes, NULL, error);
+      if (full == NULL)
+        return NULL;
+
+      texture = gdk_image_scaler_scale_texture (full, &area, dest_width, dest_height, error);
+      g_object_unref (full);
+
+      return texture;
+    }
+
+  color_state = gdk_png_get_color_state (png, info, error);
+  if (color_state == NULL)
+    {
+      png_destroy_read_struct (&png, &info, NULL);
+      return NULL;
+    }
+
+  scaler = gdk_image_scaler_new (format, color_state, &area, dest_width, dest_height, error);
+  gdk_color_state_unref (color_state);
+  if (scaler == NULL)
+    {
+      png_destroy_read_struct (&png, &info, NULL);
+      return NULL;
+    }
+
+  row = g_try_malloc (png_get_rowbytes (png, info));
+  if (!row)
+    {
+      gdk_image_scaler_free (scaler);
+      png_destroy_read_struct (&png, &info, NULL);
+      g_set_error (error,
+                   GDK_TEXTURE_ERROR, GDK_TEXTURE_ERROR_TOO_LARGE,
+                   _("Not enough memory for image size %ux%u"), image_width, image_height);
+      return NULL;
+    }
+
+  /* Rows above the clip still need to be decompressed, rows below don't */
+  for (y = 0; y < area.y + area.height && !gdk_image_scaler_is_done (scaler); y++)
+    {
+      png_read_row (png, row, NULL);
+      gdk_image_scaler_push_row (scaler, y, row, 0);
+    }
+
+  g_free (row);
+  png_destroy_read_struct (&png, &info, NULL);
+
+  texture = gdk_image_scaler_finish (scaler);
+
+  if (GDK_PROFILER_IS_RUNNING)
+    {
+      gint64 end = GDK_PROFILER_CURRENT_TIME;
+      if (end - before > 500000)
+        gdk_profiler_add_mark (before, end - before, "Load png at size", NULL);
+    }
+
+  return texture;
+}
+
+/* }}} */
+/* {{{ Incremental loading */
+
+typedef struct
+{
+  GdkStreamDecoder decoder;
+
+  png_struct *png;
+  png_info *info;
+  CICPData cicp;
+  GError *error;
+
+  guchar *data;
+  gsize stride;
+  gboolean interlaced;
+  gboolean done;
+} GdkPngStreamDecoder;
+
+static void
+png_stream_info_callback (png_structp png,
+                          png_infop   info)
+{
+  GdkPngStreamDecoder *self = png_get_progressive_ptr (png);
+  guint width, height;
+  int interlace;
+  GdkMemoryFormat format;
+  GdkColorState *color_state;
+
+  if (!gdk_png_setup_read (png, info, &width, &height, &interlace, &format, &self->error))
+    png_error (png, "Unsupported image");
+
+  color_state = gdk_png_get_color_state (png, info, &self->error);
+  if (color_state == NULL)
+    png_error (png, "Unsupported color state");
+
+  self->data = gdk_progressive_image_begin (self->decoder.image,
+                                            width, height,
+                                            format, color_state,
+                                            &self->stride,
+                                            &self->error);
+  gdk_color_state_unref (color_state);
+  if (self->data == NULL)
+    png_error (png, "Out of memory");
+
+  self->interlaced = interlace != PNG_INTERLACE_NONE;
+}
+
+static void
+png_stream_row_callback (png_structp png,
+                         png_bytep   new_row,
+                         png_uint_32 row_num,
+                         int         pass)
+{
+  GdkPngStreamDecoder *self = png_get_progressive_ptr (png);
+  gboolean complete;
+
+  /* The row didn't change in this pass */
+  if (new_row == NULL)
+    return;
+
+  /* For interlaced images, libpng calls us for every row of every
+   * pass, and this fills in the pixels that later passes will refine.
+   */
+  png_progressive_combine_row (png, self->data + row_num * self->stride, new_row);
+
+  /* Adam7 completes the even rows in pass 6 and the odd rows in pass 7 */
+  complete = !self->interlaced || pass == 6 || (pass == 5 && row_num % 2 == 0);
+
+  gdk_progressive_image_update (self->decoder.image, row_num, 1, complete);
+}
+
+static void
+png_stream_end_callback (png_structp png,
+                         png_infop   info)
+{
+  GdkPngStreamDecoder *self = png_get_progressive_ptr (png);
+
+  self->done = TRUE;
+}
+
+static gboolean
+gdk_png_stream_decoder_feed (GdkStreamDecoder  *decoder,
+                             const guchar      *data,
+                             gsize              size,
+                             GError           **error)
+{
+  GdkPngStreamDecoder *self = (GdkPngStreamDecoder *) decoder;
+
+  if (sigsetjmp (png_jmpbuf (self->png), 1))
+    {
+      g_propagate_error (error, g_steal_pointer (&self->error));
+      return FALSE;
+    }
+
+  png_process_data (self->png, self->info, (png_bytep) data, size);
+
+  return TRUE;
+}
+
+static gboolean
+gdk_png_stream_decoder_close (GdkStreamDecoder  *decoder,
+                              GError           **error)
+{
+  GdkPngStreamDecoder *self = (GdkPngStreamDecoder *) decoder;
+
+  if (!self->done)
+    {
+      g_set_error_literal (error,
+                           GDK_TEXTURE_ERROR, GDK_TEXTURE_ERROR_CORRUPT_IMAGE,
+                           _("Premature end of png data"));
+      return FALSE;
+    }
+
+  return TRUE;
+}
+
+static void
+gdk_png_stream_decoder_free (GdkStreamDecoder *decoder)
+{
+  GdkPngStreamDecoder *self = (GdkPngStreamDecoder *) decoder;
+
+  png_destroy_read_struct (&self->png, &self->info, NULL);
+  g_clear_error (&self->error);
+  g_free (self);
+}
+
+static const GdkStreamDecoderClass GDK_PNG_STREAM_DECODER_CLASS = {
+  gdk_png_stream_decoder_feed,
+  gdk_png_stream_decoder_close,
+  gdk_png_stream_decoder_free,
+};
+
+/*
+ * gdk_png_stream_decoder_new:
+ * @image: the image to decode into
+ *
+ * Creates a decoder that uses libpng's progressive reader, so that
+ * rows are available as soon as their data has arrived.
+ *
+ * Returns: (transfer full): the new decoder
+ */
+GdkStreamDecoder *
+gdk_png_stream_decoder_new (GdkProgressiveImage *image)
+{
+  GdkPngStreamDecoder *self;
+
+  self = g_new0 (GdkPngStreamDecoder, 1);
+  self->decoder.klass = &GDK_PNG_STREAM_DECODER_CLASS;
+  self->decoder.image = image;
+
+  self->png = png_create_read_struct_2 (PNG_LIBPNG_VER_STRING,
+                                        &self->error,
+                                        png_simple_error_callback,
+                                        png_simple_warning_callback,
+                                        NULL,
+                                        png_malloc_callback,
+                                        png_free_callback);
+  if (self->png == NULL)
+    g_error ("Out of memory");
+
+  self->info = png_create_info_struct (self->png);
+  if (self->info == NULL)
+    g_error ("Out of memory");
+
+  png_set_read_user_chunk_fn (self->png, &self->cicp, png_read_chunk_func);
+  png_set_progressive_read_fn (self->png,
+                               self,
+                               png_stream_info_callback,
+                               png_stream_row_callback,
+                               png_stream_end_callback);
+
+  return (GdkStreamDecoder *) self;
+}
+
+/* }}} */
+/* {{{ Saving */
+
+/* The parallel encoder splits the image into chunks of rows that are
+ * converted, filtered and deflated independently. Every chunk but the
+ * last ends with a sync flush, so the raw deflate streams can simply be
+ * concatenated into a single zlib stream, like pigz does. The adler32
+ * checksums of the chunks are combined at the end.
+ */
+
+/* uncompressed bytes per chunk */
+#define PNG_CHUNK_SIZE (256 * 1024)
+
+typedef struct
+{
+  guchar *data;
+  gsize size;
+  gsize raw_size;
+  uLong adler;
+} PngChunk;
+
+typedef struct
+{
+  const guchar *src_data;
+  gsize src_stride;
+  GdkMemoryFormat src_format;
+  GdkMemoryFormat format;
+  gboolean convert;
+  gboolean swap;
+  gsize width;
+  gsize height;
+  gsize row_bytes;
+  gsize bpp;
+  GdkPngFilter filter;
+  int level;
+  int strategy;
+  gsize rows_per_chunk;
+  gsize n_chunks;
+  PngChunk *chunks;
+} PngEncoder;
+
+static inline guchar
+png_paeth_predictor (int a,
+                     int b,
+                     int c)
+{
+  int p, pa, pb, pc;
+
+  p = a + b - c;
+  pa = ABS (p - a);
+  pb = ABS (p - b);
+  pc = ABS (p - c);
+
+  if (pa <= pb && pa <= pc)
+    return a;
+  else if (pb <= pc)
+    return b;
+  else
+    return c;
+}
+
+/* Writes the filter type byte followed by the filtered row */
+static void
+png_filter_row (guchar        type,
+                guchar       *out,
+                const guchar *row,
+                const guchar *prev,
+                gsize         row_bytes,
+                gsize         bpp)
+{
+  gsize i;
+
+  *out++ = type;
+
+  switch (type)
+    {
+    case PNG_FILTER_VALUE_NONE:
+      memcpy (out, row, row_bytes);
+      break;
+
+    case PNG_FILTER_VALUE_SUB:
+      memcpy (out, row, bpp);
+      for (i = bpp; i < row_bytes; i++)
+        out[i] = row[i] - row[i - bpp];
+      break;
+
+    case PNG_FILTER_VALUE_UP:
+      for (i = 0; i < row_bytes; i++)
+        out[i] = row[i] - prev[i];
+      break;
+
+    case PNG_FILTER_VALUE_AVG:
+      for (i = 0; i < bpp; i++)
+        out[i] = row[i] - (prev[i] >> 1);
+      for (; i < row_bytes; i++)
+        out[i] = row[i] - ((row[i - bpp] + prev[i]) >> 1);
+      break;
+
+    case PNG_FILTER_VALUE_PAETH:
+      for (i = 0; i < bpp; i++)
+        out[i] = row[i] - prev[i];
+      for (; i < row_bytes; i++)
+        out[i] = row[i] - png_paeth_predictor (row[i - bpp], prev[i], prev[i - bpp]);
+      break;
+
+    default:
+      g_assert_not_reached ();
+    }
+}
+
+/* The usual heuristic: prefer the filter whose output is closest to 0 */
+static gsize
+png_filter_cost (const guchar *data,
+                 gsize         size)
+{
+  gsize i, cost;
+
+  cost = 0;
+  for (i = 0; i < size; i++)
+    cost += ABS ((gint8) data[i]);
+
+  return cost;
+}
+
+static void
+png_filter_row_adaptive (guchar       *out,
+                         guchar       *scratch,
+                         const guchar *row,
+                         const guchar *prev,
+                         gsize         row_bytes,
+                         gsize         bpp)
+{
+  guchar type;
+  gsize cost, best_cost;
+
+  best_cost = G_MAXSIZE;
+
+  for (type = PNG_FILTER_VALUE_NONE; type <= PNG_FILTER_VALUE_PAETH; type++)
+    {
+      png_filter_row (type, scratch, row, prev, row_bytes, bpp);
+      cost = png_filter_cost (scratch + 1, row_bytes);
+      if (cost < best_cost)
+        {
+          best_cost = cost;
+          memcpy (out, scratch, row_bytes + 1);
+        }
+    }
+}
+
+static guchar
+png_filter_get_type (GdkPngFilter filter)
+{
+  switch (filter)
+    {
+    case GDK_PNG_FILTER_NONE:
+      return PNG_FILTER_VALUE_NONE;
+    case GDK_PNG_FILTER_SUB:
+      return PNG_FILTER_VALUE_SUB;
+    case GDK_PNG_FILTER_UP:
+      return PNG_FILTER_VALUE_UP;
+    case GDK_PNG_FILTER_AVERAGE:
+      return PNG_FILTER_VALUE_AVG;
+    case GDK_PNG_FILTER_PAETH:
+      return PNG_FILTER_VALUE_PAETH;
+    case GDK_PNG_FILTER_DEFAULT:
+    case GDK_PNG_FILTER_ADAPTIVE:
+    default:
+      g_assert_not_reached ();
+    }
+}
+
+static int
+png_filter_get_mask (GdkPngFilter filter)
+{
+  switch (filter)
+    {
+    case GDK_PNG_FILTER_NONE:
+      return PNG_FILTER_NONE;
+    case GDK_PNG_FILTER_SUB:
+      return PNG_FILTER_SUB;
+    case GDK_PNG_FILTER_UP:
+      return PNG_FILTER_UP;
+    case GDK_PNG_FILTER_AVERAGE:
+      return PNG_FILTER_AVG;
+    case GDK_PNG_FILTER_PAETH:
+      return PNG_FILTER_PAETH;
+    case GDK_PNG_FILTER_ADAPTIVE:
+      return PNG_ALL_FILTERS;
+    case GDK_PNG_FILTER_DEFAULT:
+    default:
+      g_assert_not_reached ();
+    }
+}
+
+static void
+png_swap_16 (guchar *data,
+             gsize   size)
+{
+  guint16 *data16 = (guint16 *) data;
+  gsize i;
+
+  for (i = 0; i < size / 2; i++)
+    data16[i] = GUINT16_SWAP_LE_BE (data16[i]);
+}
+
+static void
+png_encoder_deflate (PngEncoder   *enc,
+                     PngChunk     *chunk,
+                     const guchar *data,
+                     gsize         size,
+                     gboolean      last)
+{
+  z_stream strm = { 0, };
+  gsize allocated;
+  int status;
+
+  if (deflateInit2 (&strm, enc->level, Z_DEFLATED, -MAX_WBITS, 8, enc->strategy) != Z_OK)
+    g_error ("Failed to initialize zlib: %s", strm.msg ? strm.msg : "unknown error");
+
+  /* deflateBound() doesn't account for the sync flush */
+  allocated = deflateBound (&strm, size) + 16;
+  chunk->data = g_malloc (allocated);
+
+  strm.next_in = (Bytef *) data;
+  strm.avail_in = size;
+  strm.next_out = chunk->data;
+  strm.avail_out = allocated;
+
+  for (;;)
+    {
+      status = deflate (&strm, last ? Z_FINISH : Z_SYNC_FLUSH);
+      if (last ? status == Z_STREAM_END : strm.avail_out > 0)
+        break;
+
+      g_assert (status == Z_OK || status == Z_BUF_ERROR);
+
+      chunk->data = g_realloc (chunk->data, allocated * 2);
+      strm.next_out = chunk->data + allocated;
+      strm.avail_out = allocated;
+      allocated *= 2;
+    }
+
+  chunk->size = strm.total_out;
+  chunk->raw_size = size;
+  chunk->adler = adler32 (adler32 (0, NULL, 0), data, size);
+
+  deflateEnd (&strm);
+}
+
+static void
+png_encoder_encode_chunks (gsize    start,
+                           gsize    end,
+                           gpointer user_data)
+{
+  PngEncoder *enc = user_data;
+  gsize row_size = enc->row_bytes + 1;
+  guchar *rows, *filtered, *scratch, *zero;
+  gsize i;
+
+  rows = enc->convert ? g_malloc_n (enc->rows_per_chunk + 1, enc->row_bytes) : NULL;
+  filtered = g_malloc_n (enc->rows_per_chunk, row_size);
+  scratch = enc->filter == GDK_PNG_FILTER_ADAPTIVE ? g_malloc (row_size) : NULL;
+  zero = g_malloc0 (enc->row_bytes);
+
+  for (i = start; i < end; i++)
+    {
+      gsize y, first, last;
+      const guchar *row, *prev;
+      gsize row_stride;
+
+      first = i * enc->rows_per_chunk;
+      last = MIN (first + enc->rows_per_chunk, enc->height);
+
+      /* The filters need the row above the chunk, too */
+      if (enc->convert)
+        {
+          gsize from = first > 0 ? first - 1 : 0;
+
+          gdk_memory_convert (rows, enc->row_bytes, enc->format, GDK_COLOR_STATE_SRGB,
+                              enc->src_data + from * enc->src_stride, enc->src_stride, enc->src_format, GDK_COLOR_STATE_SRGB,
+                              enc->width, last - from);
+          if (enc->swap)
+            png_swap_16 (rows, (last - from) * enc->row_bytes);
+
+          row = rows + (first - from) * enc->row_bytes;
+          row_stride = enc->row_bytes;
+        }
+      else
+        {
+          row = enc->src_data + first * enc->src_stride;
+          row_stride = enc->src_stride;
+        }
+
+      prev = first > 0 ? row - row_stride : zero;
+
+      for (y = first; y < last; y++)
+        {
+          guchar *out = filtered + (y - first) * row_size;
+
+          if (enc->filter == GDK_PNG_FILTER_ADAPTIVE)
+            png_filter_row_adaptive (out, scratch, row, prev, enc->row_bytes, enc->bpp);
+          else
+            png_filter_row (png_filter_get_type (enc->filter), out, row, prev, enc->row_bytes, enc->bpp);
+
+          prev = row;
+          row += row_stride;
+        }
+
+      png_encoder_deflate (enc,
+                           &enc->chunks[i],
+                           filtered,
+                           (last - first) * row_size,
+                           i + 1 == enc->n_chunks);
+    }
+
+  g_free (zero);
+  g_free (scratch);
+  g_free (filtered);
+  g_free (rows);
+}
+
+static void
+png_encoder_clear (PngEncoder *enc)
+{
+  gsize i;
+
+  if (enc->chunks == NULL)
+    return;
+
+  for (i = 0; i < enc->n_chunks; i++)
+    g_free (enc->chunks[i].data);
+  g_clear_pointer (&enc->chunks, g_free);
+}
+
+/* Writes the image data and the end of the file, replacing
+ * png_write_row() and png_write_end().
+ */
+static void
+png_encoder_write (PngEncoder *enc,
+                   png_struct *png)
+{
+  png_byte header[2];
+  png_byte trailer[4];
+  guint flevel;
+  uLong adler;
+  gsize i;
+
+  enc->chunks = g_new0 (PngChunk, enc->n_chunks);
+  gdk_parallel_for (enc->n_chunks, 1, png_encoder_encode_chunks, enc);
+
+  if (enc->level == Z_DEFAULT_COMPRESSION || enc->level == 6)
+    flevel = 2;
+  else if (enc->level < 2)
+    flevel = 0;
+  else if (enc->level < 6)
+    flevel = 1;
+  else
+    flevel = 3;
+
+  /* deflate with a 32k window, and the check bits */
+  header[0] = 0x78;
+  header[1] = flevel << 6;
+  header[1] += 31 - (header[0] * 256 + header[1]) % 31;
+
+  adler = adler32 (0, NULL, 0);
+
+  for (i = 0; i < enc->n_chunks; i++)
+    {
+      PngChunk *chunk = &enc->chunks[i];
+
+      if (i == 0)
+        {
+          png_write_chunk_start (png, (png_const_bytep) "IDAT", sizeof (header) + chunk->size);
+          png_write_chunk_data (png, header, sizeof (header));
+        }
+      else
+        {
+          png_write_chunk_start (png, (png_const_bytep) "IDAT", chunk->size);
+        }
+      png_write_chunk_data (png, chunk->data, chunk->size);
+      png_write_chunk_end (png);
+
+      adler = adler32_combine (adler, chunk->adler, chunk->raw_size);
+    }
+
+  png_save_uint_32 (trailer, adler);
+  png_write_chunk (png, (png_const_bytep) "IDAT", trailer, sizeof (trailer));
+  png_write_chunk (png, (png_const_bytep) "IEND", NULL, 0);
+
+  png_encoder_clear (enc);
+}
+
 GBytes *
-gdk_save_png (GdkTexture *texture)
+gdk_save_png (GdkTexture                  *texture,
+              const GdkTextureSaveOptions *options)
 {
+  GdkTextureSaveOptions default_options;
+  PngEncoder enc = { 0, };
+  GdkPngFilter filter;
+  gboolean parallel;
   png_struct *png = NULL;
   png_info *info;
   png_io io = { NULL, 0, 0 };
@@ -498,6 +1250,12 @@ gdk_save_png (GdkTexture *texture)
   int depth;
   png_byte chunk_data[4];
 
+  if (options == NULL)
+    {
+      gdk_texture_save_options_init (&default_options, GDK_TEXTURE_SAVE_PRESET_DEFAULT);
+      options = &default_options;
+    }
+
   width = gdk_texture_get_width (texture);
   height = gdk_texture_get_height (texture);
   color_state = gdk_texture_get_color_state (texture);
@@ -611,6 +1369,7 @@ gdk_save_png (GdkTexture *texture)
     {
       gdk_color_state_unref (color_state);
       g_clear_pointer (&bytes, g_bytes_unref);
+      png_encoder_clear (&enc);
       g_free (io.data);
       png_destroy_read_struct (&png, &info, NULL);
       return NULL;
@@ -626,22 +1385,73 @@ gdk_save_png (GdkTexture *texture)
 
   gdk_png_set_color_state (png, info, color_state, chunk_data);
 
+  filter = gdk_texture_save_options_resolve_png_filter (options);
+
+  enc.format = format;
+  enc.width = width;
+  enc.height = height;
+  enc.bpp = gdk_memory_format_bytes_per_pixel (format);
+  enc.row_bytes = enc.width * enc.bpp;
+  enc.filter = filter;
+  enc.level = gdk_texture_save_options_get_zlib_level (options);
+  if (options->preset == GDK_TEXTURE_SAVE_PRESET_FAST)
+    enc.strategy = Z_RLE;
+  else if (filter != GDK_PNG_FILTER_NONE)
+    enc.strategy = Z_FILTERED;
+  else
+    enc.strategy = Z_DEFAULT_STRATEGY;
+  enc.rows_per_chunk = MAX (1, PNG_CHUNK_SIZE / (enc.row_bytes + 1));
+  enc.n_chunks = (enc.height + enc.rows_per_chunk - 1) / enc.rows_per_chunk;
+
+  parallel = options->parallel && enc.n_chunks > 1;
+
+  if (!parallel &&
+      (options->preset != GDK_TEXTURE_SAVE_PRESET_DEFAULT ||
+       options->png_filter != GDK_PNG_FILTER_DEFAULT))
+    {
+      png_set_compression_level (png, enc.level);
+      png_set_compression_strategy (png, enc.strategy);
+      png_set_filter (png, PNG_FILTER_TYPE_BASE, png_filter_get_mask (filter));
+    }
+
   png_write_info (png, info);
 
+  if (parallel)
+    {
+      /* Download in the texture's own format, so memory textures
+       * don't need to be copied. The conversion to the PNG layout
+       * happens per chunk, on the threads doing the compression.
+       */
+      gdk_texture_downloader_init (&downloader, texture);
+      gdk_texture_downloader_set_format (&downloader, gdk_texture_get_format (texture));
+      bytes = gdk_texture_downloader_download_bytes (&downloader, &stride);
+      gdk_texture_downloader_finish (&downloader);
+
+      enc.src_data = g_bytes_get_data (bytes, NULL);
+      enc.src_stride = stride;
+      enc.src_format = gdk_texture_get_format (texture);
+      enc.swap = depth == 16 && G_BYTE_ORDER == G_LITTLE_ENDIAN;
+      enc.convert = enc.src_format != enc.format || enc.swap;
+
+      png_encoder_write (&enc, png);
+    }
+  else
+    {
 #if G_BYTE_ORDER == G_LITTLE_ENDIAN
-  png_set_swap (png);
+      png_set_swap (png);
 #endif
 
-  gdk_texture_downloader_init (&downloader, texture);
-  gdk_texture_downloader_set_format (&downloader, format);
-  bytes = gdk_texture_downloader_download_bytes (&downloader, &stride);
-  gdk_texture_downloader_finish (&downloader);
-  data = g_bytes_get_data (bytes, NULL);
+      gdk_texture_downloader_init (&downloader, texture);
+      gdk_texture_downloader_set_format (&downloader, format);
+      bytes = gdk_texture_downloader_download_bytes (&downloader, &stride);
+      gdk_texture_downloader_finish (&downloader);
+      data = g_bytes_get_data (bytes, NULL);
 
-  for (y = 0; y < height; y++)
-    png_write_row (png, data + y * stride);
+      for (y = 0; y < height; y++)
+        png_write_row (png, data + y * stride);
 
-  png_write_end (png, info);
+      png_write_end (png, info);
+    }
 
   png_destroy_write_struct (&png, &info);
 
@@ -18,6 +18,7 @@
 #pragma once
 
 #include "gdktexture.h"
+#include "gdkprogressiveimageprivate.h"
 #include <gio/gio.h>
 
 #define PNG_SIGNATURE "\x89PNG"
@@ -25,8 +26,16 @@
 GdkTexture *gdk_load_png        (GBytes         *bytes,
                                  GHashTable     *options,
                                  GError        **error);
+GdkTexture *gdk_load_png_at_size (GBytes              *bytes,
+                                  const GdkRectangle  *clip,
+                                  int                  width,
+                                  int                  height,
+                                  GError             **error);
 
-GBytes     *gdk_save_png        (GdkTexture     *texture);
+GdkStreamDecoder *gdk_png_stream_decoder_new (GdkProgressiveImage *image);
+
+GBytes     *gdk_save_png        (GdkTexture                  *texture,
+                                 const GdkTextureSaveOptions *options);
 
 static inline gboolean
 gdk_is_png (GBytes *bytes)
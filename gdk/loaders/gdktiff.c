@@ -20,12 +20,17 @@
 #include "gdktiffprivate.h"
 
 #include <glib/gi18n-lib.h>
+#include "gdkcolorstateprivate.h"
+#include "gdkimagescalerprivate.h"
 #include "gdkmemoryformatprivate.h"
 #include "gdkmemorytexture.h"
+#include "gdkparalleltaskprivate.h"
 #include "gdkprofilerprivate.h"
 #include "gdktexturedownloaderprivate.h"
+#include "gdktexturesaveoptionsprivate.h"
 
 #include <tiffio.h>
+#include <zlib.h>
 
 /* Our main interest in tiff as an image format is that it is
  * flexible enough to save all our texture formats without
@@ -271,8 +276,132 @@ static const FormatData format_data[] = {
 /* if this fails, somebody forgot to add formats above */
 G_STATIC_ASSERT (G_N_ELEMENTS (format_data) == GDK_MEMORY_N_FORMATS);
 
+/* Compressed images are written as strips that we deflate ourselves,
+ * so that the strips can be compressed in parallel. libtiff just
+ * writes them with TIFFWriteRawStrip().
+ */
+
+/* uncompressed bytes per strip */
+#define TIFF_STRIP_SIZE (256 * 1024)
+
+typedef struct
+{
+  guchar *data;
+  gsize size;
+} TiffStrip;
+
+typedef struct
+{
+  const guchar *data;
+  gsize stride;
+  gsize height;
+  gsize row_bytes;
+  guint16 bits_per_sample;
+  guint16 samples_per_pixel;
+  gboolean predictor;
+  int level;
+  gsize rows_per_strip;
+  gsize n_strips;
+  TiffStrip *strips;
+} TiffEncoder;
+
+/* PREDICTOR_HORIZONTAL: store the difference to the previous pixel */
+static void
+tiff_predict_row (guchar  *row,
+                  gsize    row_bytes,
+                  guint16  bits_per_sample,
+                  guint16  samples_per_pixel)
+{
+  gsize i;
+
+  if (bits_per_sample == 8)
+    {
+      for (i = row_bytes - 1; i >= samples_per_pixel; i--)
+        row[i] -= row[i - samples_per_pixel];
+    }
+  else
+    {
+      guint16 *row16 = (guint16 *) row;
+
+      g_assert (bits_per_sample == 16);
+
+      for (i = row_bytes / 2 - 1; i >= samples_per_pixel; i--)
+        row16[i] -= row16[i - samples_per_pixel];
+    }
+}
+
+static void
+tiff_encoder_encode_strips (gsize    start,
+                            gsize    end,
+                            gpointer user_data)
+{
+  TiffEncoder *enc = user_data;
+  guchar *rows;
+  gsize i, y;
+
+  rows = g_malloc_n (enc->rows_per_strip, enc->row_bytes);
+
+  for (i = start; i < end; i++)
+    {
+      TiffStrip *strip = &enc->strips[i];
+      gsize first, n_rows, size;
+      uLongf compressed_size;
+
+      first = i * enc->rows_per_strip;
+      n_rows = MIN (enc->rows_per_strip, enc->height - first);
+      size = n_rows * enc->row_bytes;
+
+      for (y = 0; y < n_rows; y++)
+        {
+          guchar *row = rows + y * enc->row_bytes;
+
+          memcpy (row, enc->data + (first + y) * enc->stride, enc->row_bytes);
+          if (enc->predictor)
+            tiff_predict_row (row, enc->row_bytes, enc->bits_per_sample, enc->samples_per_pixel);
+        }
+
+      compressed_size = compressBound (size);
+      strip->data = g_malloc (compressed_size);
+      if (compress2 (strip->data, &compressed_size, rows, size, enc->level) != Z_OK)
+        g_error ("Failed to compress TIFF strip");
+      strip->size = compressed_size;
+    }
+
+  g_free (rows);
+}
+
+static gboolean
+tiff_encoder_write (TiffEncoder *enc,
+                    TIFF        *tif,
+                    gboolean     parallel)
+{
+  gboolean result = TRUE;
+  gsize i;
+
+  enc->strips = g_new0 (TiffStrip, enc->n_strips);
+
+  if (parallel)
+    gdk_parallel_for (enc->n_strips, 1, tiff_encoder_encode_strips, enc);
+  else
+    tiff_encoder_encode_strips (0, enc->n_strips, enc);
+
+  for (i = 0; i < enc->n_strips; i++)
+    {
+      if (result &&
+          TIFFWriteRawStrip (tif, i, enc->strips[i].data, enc->strips[i].size) == -1)
+        result = FALSE;
+
+      g_free (enc->strips[i].data);
+    }
+
+  g_free (enc->strips);
+
+  return result;
+}
+
 GBytes *
-gdk_save_tiff (GdkTexture *texture)
+gdk_save_tiff (GdkTexture                  *texture,
+               const GdkTextureSaveOptions *options)
 {
   TIFF *tif;
   int width, height;
@@ -283,6 +412,11 @@ gdk_save_tiff (GdkTexture *texture)
   GdkTextureDownloader downloader;
   GdkMemoryFormat format;
   const FormatData *fdata = NULL;
+  gboolean compress, ok;
+
+  compress = options != NULL &&
+             options->preset == GDK_TEXTURE_SAVE_PRESET_SMALL &&
+             TIFFIsCODECConfigured (COMPRESSION_ADOBE_DEFLATE);
 
   tif = tiff_open_write (&result);
 
@@ -301,7 +435,6 @@ gdk_save_tiff (GdkTexture *texture)
   TIFFSetField (tif, TIFFTAG_SAMPLESPERPIXEL, fdata->samples_per_pixel);
   TIFFSetField (tif, TIFFTAG_SAMPLEFORMAT, fdata->sample_format);
   TIFFSetField (tif, TIFFTAG_ORIENTATION, ORIENTATION_TOPLEFT);
-  TIFFSetField (tif, TIFFTAG_COMPRESSION, COMPRESSION_NONE);
   if (fdata->alpha_samples >= 0)
     TIFFSetField (tif, TIFFTAG_EXTRASAMPLES, 1, &fdata->alpha_samples);
 
@@ -314,17 +447,51 @@ gdk_save_tiff (GdkTexture *texture)
   gdk_texture_downloader_finish (&downloader);
   data = g_bytes_get_data (bytes, NULL);
 
-  line = (const guchar *)data;
-  for (int y = 0; y < height; y++)
+  if (compress)
     {
-      if (TIFFWriteScanline (tif, (void *)line, y, 0) == -1)
+      TiffEncoder enc = { 0, };
+
+      enc.data = data;
+      enc.stride = stride;
+      enc.height = height;
+      enc.row_bytes = (gsize) width * gdk_memory_format_bytes_per_pixel (fdata->format);
+      enc.bits_per_sample = fdata->bits_per_sample;
+      enc.samples_per_pixel = fdata->samples_per_pixel;
+      /* The floating point predictor shuffles bytes, we don't bother */
+      enc.predictor = fdata->sample_format == SAMPLEFORMAT_UINT;
+      enc.level = gdk_texture_save_options_get_zlib_level (options);
+      enc.rows_per_strip = MAX (1, TIFF_STRIP_SIZE / enc.row_bytes);
+      enc.n_strips = (enc.height + enc.rows_per_strip - 1) / enc.rows_per_strip;
+
+      TIFFSetField (tif, TIFFTAG_COMPRESSION, COMPRESSION_ADOBE_DEFLATE);
+      TIFFSetField (tif, TIFFTAG_PREDICTOR, enc.predictor ? PREDICTOR_HORIZONTAL : PREDICTOR_NONE);
+      TIFFSetField (tif, TIFFTAG_ROWSPERSTRIP, (guint32) enc.rows_per_strip);
+
+      ok = tiff_encoder_write (&enc, tif, options->parallel);
+    }
+  else
+    {
+      TIFFSetField (tif, TIFFTAG_COMPRESSION, COMPRESSION_NONE);
+
+      ok = TRUE;
+      line = (const guchar *)data;
+      for (int y = 0; y < height; y++)
         {
-          TIFFClose (tif);
-          g_bytes_unref (bytes);
-          return NULL;
+          if (TIFFWriteScanline (tif, (void *)line, y, 0) == -1)
+            {
+              ok = FALSE;
+              break;
+            }
+
+          line += stride;
         }
+    }
 
-      line += stride;
+  if (!ok)
+    {
+      TIFFClose (tif);
+      g_bytes_unref (bytes);
+      return NULL;
     }
 
   TIFFFlushData (tif);
@@ -372,37 +539,22 @@ load_fallback (TIFF    *tif,
   return texture;
 }
 
-GdkTexture *
-gdk_load_tiff (GBytes  *input_bytes,
-               GError **error)
+/* Finds the memory format that matches the image data, so that
+ * it can be read directly. Returns %FALSE if the image needs to be
+ * converted by libtiff.
+ */
+static gboolean
+tiff_get_native_format (TIFF            *tif,
+                        GdkMemoryFormat *out_format)
 {
-  TIFF *tif;
   guint16 samples_per_pixel;
   guint16 bits_per_sample;
   guint16 photometric;
   guint16 planarconfig;
   guint16 sample_format;
   guint16 orientation;
-  guint32 width, height;
   gint16 alpha_samples;
   GdkMemoryFormat format;
-  guchar *data, *line;
-  gsize stride;
-  int bpp;
-  GBytes *bytes;
-  GdkTexture *texture;
-  G_GNUC_UNUSED gint64 before = GDK_PROFILER_CURRENT_TIME;
-
-  tif = tiff_open_read (input_bytes);
-  if (!tif)
-    {
-      g_set_error_literal (error,
-                           GDK_TEXTURE_ERROR, GDK_TEXTURE_ERROR_CORRUPT_IMAGE,
-                           _("Could not load TIFF data"));
-      return NULL;
-    }
-
-  TIFFSetDirectory (tif, 0);
 
   TIFFGetFieldDefaulted (tif, TIFFTAG_SAMPLESPERPIXEL, &samples_per_pixel);
   TIFFGetFieldDefaulted (tif, TIFFTAG_BITSPERSAMPLE, &bits_per_sample);
@@ -410,8 +562,6 @@ gdk_load_tiff (GBytes  *input_bytes,
   TIFFGetFieldDefaulted (tif, TIFFTAG_PHOTOMETRIC, &photometric);
   TIFFGetFieldDefaulted (tif, TIFFTAG_PLANARCONFIG, &planarconfig);
   TIFFGetFieldDefaulted (tif, TIFFTAG_ORIENTATION, &orientation);
-  TIFFGetFieldDefaulted (tif, TIFFTAG_IMAGEWIDTH, &width);
-  TIFFGetFieldDefaulted (tif, TIFFTAG_IMAGELENGTH, &height);
 
   if (samples_per_pixel == 2 || samples_per_pixel == 4)
     {
@@ -424,11 +574,7 @@ gdk_load_tiff (GBytes  *input_bytes,
         alpha_samples = -1;
 
       if (alpha_samples >= 0 && alpha_samples != EXTRASAMPLE_ASSOCALPHA && alpha_samples != EXTRASAMPLE_UNASSALPHA && alpha_samples != 0)
-        {
-          texture = load_fallback (tif, error);
-          TIFFClose (tif);
-          return texture;
-        }
+        return FALSE;
     }
   else
     alpha_samples = -1;
@@ -452,8 +598,44 @@ gdk_load_tiff (GBytes  *input_bytes,
   if (format == G_N_ELEMENTS(format_data) ||
       (photometric != PHOTOMETRIC_RGB && photometric != PHOTOMETRIC_MINISBLACK) ||
       planarconfig != PLANARCONFIG_CONTIG ||
-      TIFFIsTiled (tif) ||
       orientation != ORIENTATION_TOPLEFT)
+    return FALSE;
+
+  *out_format = format;
+
+  return TRUE;
+}
+
+GdkTexture *
+gdk_load_tiff (GBytes  *input_bytes,
+               GError **error)
+{
+  TIFF *tif;
+  guint32 width, height;
+  GdkMemoryFormat format;
+  guchar *data, *line;
+  gsize stride;
+  int bpp;
+  GBytes *bytes;
+  GdkTexture *texture;
+  G_GNUC_UNUSED gint64 before = GDK_PROFILER_CURRENT_TIME;
+
+  tif = tiff_open_read (input_bytes);
+  if (!tif)
+    {
+      g_set_error_literal (error,
+                           GDK_TEXTURE_ERROR, GDK_TEXTURE_ERROR_CORRUPT_IMAGE,
+                           _("Could not load TIFF data"));
+      return NULL;
+    }
+
+  TIFFSetDirectory (tif, 0);
+
+  TIFFGetFieldDefaulted (tif, TIFFTAG_IMAGEWIDTH, &width);
+  TIFFGetFieldDefaulted (tif, TIFFTAG_IMAGELENGTH, &height);
+
+  if (!tiff_get_native_format (tif, &format) ||
+      TIFFIsTiled (tif))
     {
       texture = load_fallback (tif, error);
       TIFFClose (tif);
@@ -510,6 +692,324 @@ gdk_load_tiff (GBytes  *input_bytes,
   return texture;
 }
 
+/* }}} */
+/* {{{ Loading at size */
+
+/* Number of rows to convert per TIFFRGBAImageGet() call */
+#define TIFF_BAND_ROWS 64
+
+static GdkTexture *
+load_scanlines_at_size (TIFF                *tif,
+                        GdkMemoryFormat      format,
+                        const GdkRectangle  *area,
+                        int                  width,
+                        int                  height,
+                        GError             **error)
+{
+  GdkImageScaler *scaler;
+  guchar *line;
+  int y;
+
+  scaler = gdk_image_scaler_new (format, GDK_COLOR_STATE_SRGB, area, width, height, error);
+  if (scaler == NULL)
+    return NULL;
+
+  line = g_try_malloc (TIFFScanlineSize (tif));
+  if (!line)
+    {
+      g_set_error_literal (error,
+                           GDK_TEXTURE_ERROR, GDK_TEXTURE_ERROR_TOO_LARGE,
+                           _("Not enough memory"));
+      gdk_image_scaler_free (scaler);
+      return NULL;
+    }
+
+  /* libtiff only decodes the strips containing these rows */
+  for (y = area->y; y < area->y + area->height && !gdk_image_scaler_is_done (scaler); y++)
+    {
+      if (TIFFReadScanline (tif, line, y, 0) == -1)
+        {
+          g_set_error (error,
+                       GDK_TEXTURE_ERROR, GDK_TEXTURE_ERROR_CORRUPT_IMAGE,
+                       _("Reading data failed at row %d"), y);
+          gdk_image_scaler_free (scaler);
+          g_free (line);
+          return NULL;
+        }
+
+      gdk_image_scaler_push_row (scaler, y, line, 0);
+    }
+
+  g_free (line);
+
+  return gdk_image_scaler_finish (scaler);
+}
+
+static GdkTexture *
+load_tiles_at_size (TIFF                *tif,
+                    GdkMemoryFormat      format,
+                    const GdkRectangle  *area,
+                    int                  width,
+                    int                  height,
+                    GError             **error)
+{
+  GdkImageScaler *scaler;
+  guint32 tile_width, tile_height, image_height;
+  int tw, th;
+  guchar *tile, *band;
+  gsize bpp, tile_stride, band_stride;
+  int band_x0, band_x1, tx, ty, r;
+
+  TIFFGetField (tif, TIFFTAG_TILEWIDTH, &tile_width);
+  TIFFGetField (tif, TIFFTAG_TILELENGTH, &tile_height);
+  TIFFGetFieldDefaulted (tif, TIFFTAG_IMAGELENGTH, &image_height);
+
+  if (tile_width == 0 || tile_height == 0)
+    {
+      g_set_error_literal (error,
+                           GDK_TEXTURE_ERROR, GDK_TEXTURE_ERROR_CORRUPT_IMAGE,
+                           _("Could not load TIFF data"));
+      return NULL;
+    }
+
+  tw = tile_width;
+  th = tile_height;
+
+  scaler = gdk_image_scaler_new (format, GDK_COLOR_STATE_SRGB, area, width, height, error);
+  if (scaler == NULL)
+    return NULL;
+
+  /* Only the columns of tiles that intersect the clip are read */
+  band_x0 = area->x / tw * tw;
+  band_x1 = (area->x + area->width + tw - 1) / tw * tw;
+
+  bpp = gdk_memory_format_bytes_per_pixel (format);
+  tile_stride = TIFFTileRowSize (tif);
+  band_stride = (band_x1 - band_x0) * bpp;
+
+  g_assert (tile_stride == tile_width * bpp);
+
+  tile = g_try_malloc (TIFFTileSize (tif));
+  band = g_try_malloc_n (tile_height, band_stride);
+  if (!tile || !band)
+    {
+      g_set_error_literal (error,
+                           GDK_TEXTURE_ERROR, GDK_TEXTURE_ERROR_TOO_LARGE,
+                           _("Not enough memory"));
+      gdk_image_scaler_free (scaler);
+      g_free (tile);
+      g_free (band);
+      return NULL;
+    }
+
+  for (ty = area->y / th * th;
+       ty < area->y + area->height && !gdk_image_scaler_is_done (scaler);
+       ty += th)
+    {
+      for (tx = band_x0; tx < band_x1; tx += tw)
+        {
+          if (TIFFReadTile (tif, tile, tx, ty, 0, 0) == -1)
+            {
+              g_set_error (error,
+                           GDK_TEXTURE_ERROR, GDK_TEXTURE_ERROR_CORRUPT_IMAGE,
+                           _("Reading data failed at row %d"), ty);
+              gdk_image_scaler_free (scaler);
+              g_free (tile);
+              g_free (band);
+              return NULL;
+            }
+
+          for (r = 0; r < th; r++)
+            memcpy (band + r * band_stride + (tx - band_x0) * bpp,
+                    tile + r * tile_stride,
+                    tile_stride);
+        }
+
+      for (r = 0; r < th && ty + r < (int) image_height; r++)
+        gdk_image_scaler_push_row (scaler, ty + r, band + r * band_stride, band_x0);
+    }
+
+  g_free (tile);
+  g_free (band);
+
+  return gdk_image_scaler_finish (scaler);
+}
+
+static GdkTexture *
+load_fallback_at_size (TIFF                *tif,
+                       const GdkRectangle  *area,
+                       int                  width,
+                       int                  height,
+                       GError             **error)
+{
+  GdkImageScaler *scaler;
+  TIFFRGBAImage img;
+  char emsg[1024];
+  guchar *band;
+  gsize band_stride;
+  int y, n, r;
+
+  if (!TIFFRGBAImageOK (tif, emsg) ||
+      !TIFFRGBAImageBegin (&img, tif, 0, emsg))
+    {
+      g_set_error_literal (error,
+                           GDK_TEXTURE_ERROR, GDK_TEXTURE_ERROR_CORRUPT_IMAGE,
+                           _("Failed to load RGB data from TIFF file"));
+      return NULL;
+    }
+
+  img.req_orientation = ORIENTATION_TOPLEFT;
+
+  scaler = gdk_image_scaler_new (GDK_MEMORY_R8G8B8A8_PREMULTIPLIED, GDK_COLOR_STATE_SRGB,
+                                 area, width, height,
+                                 error);
+  if (scaler == NULL)
+    {
+      TIFFRGBAImageEnd (&img);
+      return NULL;
+    }
+
+  band_stride = area->width * 4;
+  band = g_try_malloc_n (TIFF_BAND_ROWS, band_stride);
+  if (!band)
+    {
+      g_set_error_literal (error,
+                           GDK_TEXTURE_ERROR, GDK_TEXTURE_ERROR_TOO_LARGE,
+                           _("Not enough memory"));
+      gdk_image_scaler_free (scaler);
+      TIFFRGBAImageEnd (&img);
+      return NULL;
+    }
+
+  /* Convert the clip in bands, instead of the whole image at once */
+  for (y = area->y; y < area->y + area->height && !gdk_image_scaler_is_done (scaler); y += n)
+    {
+      n = MIN (TIFF_BAND_ROWS, area->y + area->height - y);
+
+      img.row_offset = y;
+      img.col_offset = area->x;
+
+      if (!TIFFRGBAImageGet (&img, (guint32 *) band, area->width, n))
+        {
+          g_set_error_literal (error,
+                               GDK_TEXTURE_ERROR, GDK_TEXTURE_ERROR_CORRUPT_IMAGE,
+                               _("Failed to load RGB data from TIFF file"));
+          gdk_image_scaler_free (scaler);
+          TIFFRGBAImageEnd (&img);
+          g_free (band);
+          return NULL;
+        }
+
+      for (r = 0; r < n; r++)
+        gdk_image_scaler_push_row (scaler, y + r, band + r * band_stride, area->x);
+    }
+
+  TIFFRGBAImageEnd (&img);
+  g_free (band);
+
+  return gdk_image_scaler_finish (scaler);
+}
+
+/*
+ * gdk_load_tiff_at_size:
+ * @input_bytes: the TIFF data
+ * @clip: (nullable): the area of the image to load
+ * @width: the width of the result, or -1
+ * @height: the height of the result, or -1
+ * @error: return location for an error
+ *
+ * Loads a region of a TIFF image at the given size.
+ *
+ * Only the strips or tiles that intersect @clip are decoded,
+ * and they are scaled as they are read.
+ *
+ * Returns: (nullable): the texture
+ */
+GdkTexture *
+gdk_load_tiff_at_size (GBytes              *input_bytes,
+                       const GdkRectangle  *clip,
+                       int                  width,
+                       int                  height,
+                       GError             **error)
+{
+  TIFF *tif;
+  guint32 image_width, image_height;
+  guint16 orientation;
+  GdkMemoryFormat format;
+  GdkRectangle area;
+  int dest_width, dest_height;
+  GdkTexture *texture;
+  G_GNUC_UNUSED gint64 before = GDK_PROFILER_CURRENT_TIME;
+
+  tif = tiff_open_read (input_bytes);
+  if (!tif)
+    {
+      g_set_error_literal (error,
+                           GDK_TEXTURE_ERROR, GDK_TEXTURE_ERROR_CORRUPT_IMAGE,
+                           _("Could not load TIFF data"));
+      return NULL;
+    }
+
+  TIFFSetDirectory (tif, 0);
+
+  TIFFGetFieldDefaulted (tif, TIFFTAG_IMAGEWIDTH, &image_width);
+  TIFFGetFieldDefaulted (tif, TIFFTAG_IMAGELENGTH, &image_height);
+  TIFFGetFieldDefaulted (tif, TIFFTAG_ORIENTATION, &orientation);
+
+  if (!gdk_image_scaler_compute_size (image_width, image_height,
+                                      clip, width, height,
+                                      &area, &dest_width, &dest_height,
+                                      error))
+    {
+      TIFFClose (tif);
+      return NULL;
+    }
+
+  if (area.width == (int) image_width && area.height == (int) image_height &&
+      dest_width == area.width && dest_height == area.height)
+    {
+      TIFFClose (tif);
+      return gdk_load_tiff (input_bytes, error);
+    }
+
+  if (tiff_get_native_format (tif, &format))
+    {
+      if (TIFFIsTiled (tif))
+        texture = load_tiles_at_size (tif, format, &area, dest_width, dest_height, error);
+      else
+        texture = load_scanlines_at_size (tif, format, &area, dest_width, dest_height, error);
+    }
+  else if (orientation == ORIENTATION_TOPLEFT)
+    {
+      texture = load_fallback_at_size (tif, &area, dest_width, dest_height, error);
+    }
+  else
+    {
+      /* libtiff flips each band on its own, so this needs the full image */
+      GdkTexture *full;
+
+      full = load_fallback (tif, error);
+      if (full)
+        {
+          texture = gdk_image_scaler_scale_texture (full, &area, dest_width, dest_height, error);
+          g_object_unref (full);
+        }
+      else
+        texture = NULL;
+    }
+
+  TIFFClose (tif);
+
+  if (GDK_PROFILER_IS_RUNNING)
+    {
+      gint64 end = GDK_PROFILER_CURRENT_TIME;
+      if (end - before > 500000)
+        gdk_profiler_add_mark (before, end - before, "Load tiff at size", NULL);
+    }
+
+  return texture;
+}
+
 /* }}} */
 
 /* vim:set foldmethod=marker: */
@@ -25,8 +25,14 @@
 
 GdkTexture *gdk_load_tiff         (GBytes           *bytes,
                                    GError          **error);
-
-GBytes *    gdk_save_tiff         (GdkTexture       *texture);
+GdkTexture *gdk_load_tiff_at_size (GBytes              *bytes,
+                                   const GdkRectangle  *clip,
+                                   int                  width,
+                                   int                  height,
+                                   GError             **error);
+
+GBytes *    gdk_save_tiff         (GdkTexture                  *texture,
+                                   const GdkTextureSaveOptions *options);
 
 static inline gboolean
 gdk_is_tiff (GBytes *bytes)
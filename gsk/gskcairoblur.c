@@ -25,7 +25,7 @@
 #include "gskcairoblurprivate.h"
 #include "gdkcairoprivate.h"
 
-#include "gdkcairoprivate.h"
+#include "gdk/gdkparalleltaskprivate.h"
 
 #include <math.h>
 #include <string.h>
@@ -43,184 +43,377 @@
 
 #define get_box_filter_size(radius) ((int)(GAUSSIAN_SCALE_FACTOR * (radius)))
 
-/* Sadly, clang is picky about get_box_filter_size(2) not being a
- * constant expression, thus we have to use precomputed values.
+/* Divisions by the filter size are done as multiplication with a
+ * reciprocal, which is exact for all possible sums if the filter
+ * is not larger than this.
+ */
+#define MAX_RECIPROCAL_SIZE 180
+#define RECIPROCAL_SHIFT 23
+
+/* Number of bytes per column strip in the vertical pass */
+#define STRIP_WIDTH 64
+
+/* Minimum number of bytes for a work item of the parallel passes */
+#define MIN_BYTES_PER_TASK 16384
+
+typedef struct
+{
+  guchar *data;
+  int width;
+  int height;
+  int stride;
+  int n_channels;
+  int d;
+} BlurData;
+
+static inline guint32
+box_reciprocal (int d)
+{
+  if (d > MAX_RECIPROCAL_SIZE)
+    return 0;
+
+  return ((1u << RECIPROCAL_SHIFT) + d - 1) / d;
+}
+
+static inline int
+box_offset (int d,
+            int shift)
+{
+  if (d % 2 == 1)
+    return d / 2;
+  else
+    return (d - shift) / 2;
+}
+
+/* We want to produce a symmetric blur that spreads a pixel equally far
+ * in both directions. If d is odd that happens naturally, but for d
+ * even, we approximate by using a blur on either side and then a
+ * centered blur of size d + 1 (technique also from the SVG specification).
+ *
+ * This returns the filter size and shift for each of the three passes.
  */
-#define BOX_FILTER_SIZE_2 3
-#define BOX_FILTER_SIZE_3 5
-#define BOX_FILTER_SIZE_4 7
-#define BOX_FILTER_SIZE_5 9
-#define BOX_FILTER_SIZE_6 11
-#define BOX_FILTER_SIZE_7 13
-#define BOX_FILTER_SIZE_8 15
-#define BOX_FILTER_SIZE_9 16
-#define BOX_FILTER_SIZE_10 18
+static inline void
+box_pass (int  d,
+          int  pass,
+          int *pass_d,
+          int *pass_shift)
+{
+  static const int shifts[3] = { 1, -1, 0 };
+
+  if (d % 2 == 1)
+    {
+      *pass_d = d;
+      *pass_shift = 0;
+    }
+  else
+    {
+      *pass_d = pass == 2 ? d + 1 : d;
+      *pass_shift = shifts[pass];
+    }
+}
+
+static inline guchar
+box_divide (guint32 sum,
+            int     d,
+            guint32 mul)
+{
+  if (mul)
+    return ((sum + d / 2) * mul) >> RECIPROCAL_SHIFT;
+  else
+    return (sum + d / 2) / d;
+}
 
 /* This applies a single box blur pass to a horizontal range of pixels;
  * since the box blur has the same weight for all pixels, we can
  * implement an efficient sliding window algorithm where we add
  * in pixels coming into the window from the right and remove
- * them when they leave the windw to the left.
+ * them when they leave the window to the left.
  *
  * d is the filter width; for even d shift indicates how the blurred
  * result is aligned with the original - does ' x ' go to ' yy' (shift=1)
  * or 'yy ' (shift=-1)
  */
 static void
-blur_xspan (guchar *row,
-            guchar *tmp_buffer,
-            int     row_width,
-            int     d,
-            int     shift)
+blur_xspan_a8 (guchar       *dest,
+               const guchar *src,
+               int           width,
+               int           d,
+               int           shift)
 {
-  int offset;
-  int sum = 0;
+  guint32 mul = box_reciprocal (d);
+  int offset = box_offset (d, shift);
+  guint32 sum = 0;
   int i;
 
-  if (d % 2 == 1)
-    offset = d / 2;
-  else
-    offset = (d - shift) / 2;
-
-  /* All the conditionals in here look slow, but the branches will
-   * be well predicted and there are enough different possibilities
-   * that trying to write this as a series of unconditional loops
-   * is hard and not an obvious win. The main slow down here seems
-   * to be the integer division per pixel; one possible optimization
-   * would be to accumulate into two 16-bit integer buffers and
-   * only divide down after all three passes. (SSE parallel implementation
-   * of the divide step is possible.)
-   */
+  /* Fill the window up to the first pixel we write */
+  for (i = 0; i < MIN (offset, width); i++)
+    sum += src[i];
 
-#define BLUR_ROW_KERNEL(D)                                      \
-  for (i = -(D) + offset; i < row_width + offset; i++)		\
-    {                                                           \
-      if (i >= 0 && i < row_width)                              \
-        sum += row[i];                                          \
-                                                                \
-      if (i >= offset)						\
-	{							\
-	  if (i >= (D))						\
-	    sum -= row[i - (D)];				\
-                                                                \
-	  tmp_buffer[i - offset] = (sum + (D) / 2) / (D);	\
-	}							\
-    }								\
-  break;
-
-  /* We unroll the values for d for radius 2-10 to avoid a generic
-   * divide operation (not radius 1, because its a no-op) */
-  switch (d)
+  for (i = offset; i < width + offset; i++)
     {
-    case BOX_FILTER_SIZE_2: BLUR_ROW_KERNEL (BOX_FILTER_SIZE_2);
-    case BOX_FILTER_SIZE_3: BLUR_ROW_KERNEL (BOX_FILTER_SIZE_3);
-    case BOX_FILTER_SIZE_4: BLUR_ROW_KERNEL (BOX_FILTER_SIZE_4);
-    case BOX_FILTER_SIZE_5: BLUR_ROW_KERNEL (BOX_FILTER_SIZE_5);
-    case BOX_FILTER_SIZE_6: BLUR_ROW_KERNEL (BOX_FILTER_SIZE_6);
-    case BOX_FILTER_SIZE_7: BLUR_ROW_KERNEL (BOX_FILTER_SIZE_7);
-    case BOX_FILTER_SIZE_8: BLUR_ROW_KERNEL (BOX_FILTER_SIZE_8);
-    case BOX_FILTER_SIZE_9: BLUR_ROW_KERNEL (BOX_FILTER_SIZE_9);
-    case BOX_FILTER_SIZE_10: BLUR_ROW_KERNEL (BOX_FILTER_SIZE_10);
-    default: BLUR_ROW_KERNEL (d);
-    }
+      if (i < width)
+        sum += src[i];
+      if (i >= d)
+        sum -= src[i - d];
 
-  memcpy (row, tmp_buffer, row_width);
+      dest[i - offset] = box_divide (sum, d, mul);
+    }
 }
 
+/* The same for 4 channels. Keeping the sums in separate variables
+ * lets the compiler keep them in registers.
+ */
 static void
-blur_rows (guchar *dst_buffer,
-           guchar *tmp_buffer,
-           int     buffer_width,
-           int     buffer_height,
-           int     d)
+blur_xspan_argb32 (guchar       *dest,
+                   const guchar *src,
+                   int           width,
+                   int           d,
+                   int           shift)
 {
+  guint32 mul = box_reciprocal (d);
+  int offset = box_offset (d, shift);
+  guint32 s0 = 0, s1 = 0, s2 = 0, s3 = 0;
   int i;
 
-  for (i = 0; i < buffer_height; i++)
+  for (i = 0; i < MIN (offset, width); i++)
+    {
+      s0 += src[4 * i];
+      s1 += src[4 * i + 1];
+      s2 += src[4 * i + 2];
+      s3 += src[4 * i + 3];
+    }
+
+  for (i = offset; i < width + offset; i++)
     {
-      guchar *row = dst_buffer + i * buffer_width;
-
-      /* We want to produce a symmetric blur that spreads a pixel
-       * equally far to the left and right. If d is odd that happens
-       * naturally, but for d even, we approximate by using a blur
-       * on either side and then a centered blur of size d + 1.
-       * (technique also from the SVG specification)
-       */
-      if (d % 2 == 1)
+      guchar *out = dest + 4 * (i - offset);
+
+      if (i < width)
         {
-          blur_xspan (row, tmp_buffer, buffer_width, d, 0);
-          blur_xspan (row, tmp_buffer, buffer_width, d, 0);
-          blur_xspan (row, tmp_buffer, buffer_width, d, 0);
+          s0 += src[4 * i];
+          s1 += src[4 * i + 1];
+          s2 += src[4 * i + 2];
+          s3 += src[4 * i + 3];
         }
-      else
+      if (i >= d)
         {
-          blur_xspan (row, tmp_buffer, buffer_width, d, 1);
-          blur_xspan (row, tmp_buffer, buffer_width, d, -1);
-          blur_xspan (row, tmp_buffer, buffer_width, d + 1, 0);
+          s0 -= src[4 * (i - d)];
+          s1 -= src[4 * (i - d) + 1];
+          s2 -= src[4 * (i - d) + 2];
+          s3 -= src[4 * (i - d) + 3];
         }
+
+      out[0] = box_divide (s0, d, mul);
+      out[1] = box_divide (s1, d, mul);
+      out[2] = box_divide (s2, d, mul);
+      out[3] = box_divide (s3, d, mul);
+    }
+}
+
+static inline void
+blur_xspan (guchar       *dest,
+            const guchar *src,
+            int           width,
+            int           n_channels,
+            int           d,
+            int           shift)
+{
+  if (n_channels == 4)
+    blur_xspan_argb32 (dest, src, width, d, shift);
+  else
+    blur_xspan_a8 (dest, src, width, d, shift);
+}
+
+static inline void
+blur_row (guchar *row,
+          guchar *tmp1,
+          guchar *tmp2,
+          int     width,
+          int     n_channels,
+          int     d)
+{
+  int pass_d, pass_shift;
+
+  box_pass (d, 0, &pass_d, &pass_shift);
+  blur_xspan (tmp1, row, width, n_channels, pass_d, pass_shift);
+  box_pass (d, 1, &pass_d, &pass_shift);
+  blur_xspan (tmp2, tmp1, width, n_channels, pass_d, pass_shift);
+  box_pass (d, 2, &pass_d, &pass_shift);
+  blur_xspan (row, tmp2, width, n_channels, pass_d, pass_shift);
+}
+
+static void
+blur_rows (gsize    start,
+           gsize    end,
+           gpointer user_data)
+{
+  BlurData *data = user_data;
+  gsize row_size = (gsize) data->width * data->n_channels;
+  guchar *tmp1, *tmp2;
+  gsize y;
+
+  tmp1 = g_malloc (2 * row_size);
+  tmp2 = tmp1 + row_size;
+
+  for (y = start; y < end; y++)
+    {
+      guchar *row = data->data + y * data->stride;
+
+      blur_row (row, tmp1, tmp2, data->width, data->n_channels, data->d);
     }
+
+  g_free (tmp1);
 }
 
-/* Swaps width and height.
+/* The vertical version of blur_xspan().
+ *
+ * Instead of transposing the image, this walks down a strip of
+ * columns and keeps a running sum for every byte of the strip.
+ * As all bytes are independent, this works for any number of
+ * channels, and the memory accesses stay within a few cache lines
+ * per row.
  */
+static inline void
+blur_yspan (guchar       *dest,
+            gsize         dest_stride,
+            const guchar *src,
+            gsize         src_stride,
+            int           width,
+            int           height,
+            int           d,
+            int           shift)
+{
+  guint32 sum[STRIP_WIDTH] = { 0, };
+  guint32 mul = box_reciprocal (d);
+  int offset = box_offset (d, shift);
+  int i, c;
+
+  /* Fill the window up to the first row we write */
+  for (i = 0; i < MIN (offset, height); i++)
+    {
+      const guchar *in = src + i * src_stride;
+
+      for (c = 0; c < width; c++)
+        sum[c] += in[c];
+    }
+
+  for (i = offset; i < height + offset; i++)
+    {
+      guchar *out = dest + (i - offset) * dest_stride;
+
+      /* The common case, do it all in one go */
+      if (i < height && i >= d && mul)
+        {
+          const guchar *add = src + i * src_stride;
+          const guchar *sub = src + (i - d) * src_stride;
+
+          for (c = 0; c < width; c++)
+            {
+              sum[c] += add[c] - sub[c];
+              out[c] = ((sum[c] + d / 2) * mul) >> RECIPROCAL_SHIFT;
+            }
+          continue;
+        }
+
+      if (i < height)
+        {
+          const guchar *in = src + i * src_stride;
+
+          for (c = 0; c < width; c++)
+            sum[c] += in[c];
+        }
+
+      if (i >= d)
+        {
+          const guchar *in = src + (i - d) * src_stride;
+
+          for (c = 0; c < width; c++)
+            sum[c] -= in[c];
+        }
+
+      for (c = 0; c < width; c++)
+        out[c] = box_divide (sum[c], d, mul);
+    }
+}
+
+static inline void
+blur_strip (guchar *strip,
+            gsize   stride,
+            guchar *tmp1,
+            guchar *tmp2,
+            int     width,
+            int     height,
+            int     d)
+{
+  int pass_d, pass_shift;
+
+  box_pass (d, 0, &pass_d, &pass_shift);
+  blur_yspan (tmp1, STRIP_WIDTH, strip, stride, width, height, pass_d, pass_shift);
+  box_pass (d, 1, &pass_d, &pass_shift);
+  blur_yspan (tmp2, STRIP_WIDTH, tmp1, STRIP_WIDTH, width, height, pass_d, pass_shift);
+  box_pass (d, 2, &pass_d, &pass_shift);
+  blur_yspan (strip, stride, tmp2, STRIP_WIDTH, width, height, pass_d, pass_shift);
+}
+
 static void
-flip_buffer (guchar *dst_buffer,
-             guchar *src_buffer,
-             int     width,
-             int     height)
+blur_columns (gsize    start,
+              gsize    end,
+              gpointer user_data)
 {
-  /* Working in blocks increases cache efficiency, compared to reading
-   * or writing an entire column at once
-   */
-#define BLOCK_SIZE 16
-
-  int i0, j0;
-
-  for (i0 = 0; i0 < width; i0 += BLOCK_SIZE)
-    for (j0 = 0; j0 < height; j0 += BLOCK_SIZE)
-      {
-        int max_j = MIN(j0 + BLOCK_SIZE, height);
-        int max_i = MIN(i0 + BLOCK_SIZE, width);
-        int i, j;
-
-        for (i = i0; i < max_i; i++)
-          for (j = j0; j < max_j; j++)
-            dst_buffer[i * height + j] = src_buffer[j * width + i];
-      }
-#undef BLOCK_SIZE
+  BlurData *data = user_data;
+  int row_size = data->width * data->n_channels;
+  guchar *tmp1, *tmp2;
+  gsize i;
+
+  tmp1 = g_malloc_n (2 * STRIP_WIDTH, data->height);
+  tmp2 = tmp1 + (gsize) STRIP_WIDTH * data->height;
+
+  for (i = start; i < end; i++)
+    {
+      int x = i * STRIP_WIDTH;
+
+      blur_strip (data->data + x, data->stride, tmp1, tmp2,
+                  MIN (STRIP_WIDTH, row_size - x), data->height, data->d);
+    }
+
+  g_free (tmp1);
 }
 
 static void
 _boxblur (guchar      *buffer,
           int          width,
           int          height,
+          int          stride,
+          int          n_channels,
           int          radius,
           GskBlurFlags flags)
 {
-  guchar *flipped_buffer;
-  int d = get_box_filter_size (radius);
-
-  flipped_buffer = g_malloc (width * height);
+  BlurData data = {
+    .data = buffer,
+    .width = width,
+    .height = height,
+    .stride = stride,
+    .n_channels = n_channels,
+    .d = get_box_filter_size (radius),
+  };
+  gsize row_size = (gsize) width * n_channels;
 
   if (flags & GSK_BLUR_Y)
     {
-      /* Step 1: swap rows and columns */
-      flip_buffer (flipped_buffer, buffer, width, height);
+      gsize n_strips = (row_size + STRIP_WIDTH - 1) / STRIP_WIDTH;
 
-      /* Step 2: blur rows (really columns) */
-      blur_rows (flipped_buffer, buffer, height, width, d);
-
-      /* Step 3: swap rows and columns */
-      flip_buffer (buffer, flipped_buffer, height, width);
+      gdk_parallel_for (n_strips,
+                        MAX (1, MIN_BYTES_PER_TASK / (STRIP_WIDTH * height)),
+                        blur_columns,
+                        &data);
     }
 
   if (flags & GSK_BLUR_X)
     {
-      /* Step 4: blur rows */
-      blur_rows (buffer, flipped_buffer, width, height, d);
+      gdk_parallel_for (height,
+                        MAX (1, MIN_BYTES_PER_TASK / row_size),
+                        blur_rows,
+                        &data);
     }
-
-  g_free (flipped_buffer);
 }
 
 /*
@@ -229,6 +422,8 @@ _boxblur (guchar      *buffer,
  * @radius: the blur radius.
  *
  * Blurs the cairo image surface at the given radius.
+ *
+ * The surface must be in the A8 or ARGB32 format.
  */
 void
 gsk_cairo_blur_surface (cairo_surface_t* surface,
@@ -236,10 +431,24 @@ gsk_cairo_blur_surface (cairo_surface_t* surface,
                         GskBlurFlags     flags)
 {
   int radius = radius_d;
+  int n_channels;
 
   g_return_if_fail (surface != NULL);
   g_return_if_fail (cairo_surface_get_type (surface) == CAIRO_SURFACE_TYPE_IMAGE);
-  g_return_if_fail (cairo_image_surface_get_format (surface) == CAIRO_FORMAT_A8);
+
+  switch (cairo_image_surface_get_format (surface))
+    {
+    case CAIRO_FORMAT_A8:
+      n_channels = 1;
+      break;
+
+    case CAIRO_FORMAT_ARGB32:
+      n_channels = 4;
+      break;
+
+    default:
+      g_return_if_reached ();
+    }
 
   /* The code doesn't actually do any blurring for radius 1, as it
    * ends up with box filter size 1 */
@@ -252,9 +461,14 @@ gsk_cairo_blur_surface (cairo_surface_t* surface,
   /* Before we mess with the surface, execute any pending drawing. */
   cairo_surface_flush (surface);
 
+  /* The padding at the end of the rows is blurred, too. This keeps
+   * the output of A8 surfaces unchanged from older versions.
+   */
   _boxblur (cairo_image_surface_get_data (surface),
-            cairo_image_surface_get_stride (surface),
+            cairo_image_surface_get_stride (surface) / n_channels,
             cairo_image_surface_get_height (surface),
+            cairo_image_surface_get_stride (surface),
+            n_channels,
             radius, flags);
 
   /* Inform cairo we altered the surface contents. */
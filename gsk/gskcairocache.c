@@ -0,0 +1,580 @@
+/* GSK - The GIMP Toolkit
+ * Copyright (C) 2026 the GTK team
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "config.h"
+
+#include "gskcairocacheprivate.h"
+
+#include "gskrendernodeprivate.h"
+
+#include "gdk/gdktextureprivate.h"
+
+#include <math.h>
+
+/* The cairo cache keeps the rasterized results of expensive nodes
+ * around, so that they can be reused in the next frames as long as
+ * the node is drawn again.
+ *
+ * Widgets reuse the render nodes of unchanged subtrees, so the node
+ * pointer is a good key. Entries keep a reference to their node, so
+ * the pointer cannot be reused by a different node while it is cached.
+ *
+ * The raster is only valid for the same scale and the same subpixel
+ * position, so those are part of the key, too. Integer translations
+ * are fine, they just move the image.
+ */
+
+/* Entries that weren't used in that many frames are dropped, even
+ * if the cache isn't full, to not keep nodes alive forever.
+ */
+#define MAX_UNUSED_FRAMES 60
+
+/* Entries that weren't used for that long are dropped, too. This
+ * matters when no frames are drawn, see gsk_cairo_cache_gc().
+ */
+#define MAX_UNUSED_TIME (5 * G_TIME_SPAN_SECOND)
+
+/* Nodes larger than this are not worth caching */
+#define MAX_ENTRY_PIXELS (1024 * 1024)
+
+/* Subpixel positions that differ by less than this are treated as equal */
+#define SUBPIXEL_STEPS 64.0
+
+typedef struct _GskCairoCacheKey GskCairoCacheKey;
+typedef struct _GskCairoCacheEntry GskCairoCacheEntry;
+
+struct _GskCairoCacheKey
+{
+  GskRenderNode *node;
+  GdkColorState *ccs;
+  double x_scale;
+  double y_scale;
+  double x_offset;
+  double y_offset;
+};
+
+struct _GskCairoCacheEntry
+{
+  GskCairoCacheKey key;
+
+  GList link;
+  cairo_surface_t *surface;
+  gsize size;
+  guint64 last_used;
+  gint64 last_used_time;
+};
+
+struct _GskCairoCache
+{
+  GMutex lock;
+
+  GHashTable *entries;
+  GQueue lru;
+
+  gsize size;
+  gsize max_size;
+  guint64 frame;
+  gint64 frame_time;
+
+  guint n_hits;
+  guint n_misses;
+
+  /* Surfaces of textures prepared for the current frame, so that
+   * drawing threads don't download them again.
+   * Only changed while no threads are drawing.
+   */
+  GHashTable *textures;
+  GdkColorState *textures_ccs;
+};
+
+static const cairo_user_data_key_t cache_key;
+static const cairo_user_data_key_t textures_key;
+
+static guint
+gsk_cairo_cache_key_hash (gconstpointer data)
+{
+  const GskCairoCacheKey *key = data;
+
+  return g_direct_hash (key->node) ^
+         g_direct_hash (key->ccs) ^
+         g_double_hash (&key->x_scale) ^
+         (g_double_hash (&key->y_scale) << 7) ^
+         (g_double_hash (&key->x_offset) << 13) ^
+         (g_double_hash (&key->y_offset) << 19);
+}
+
+static gboolean
+gsk_cairo_cache_key_equal (gconstpointer a,
+                           gconstpointer b)
+{
+  const GskCairoCacheKey *ka = a;
+  const GskCairoCacheKey *kb = b;
+
+  return ka->node == kb->node &&
+         ka->ccs == kb->ccs &&
+         ka->x_scale == kb->x_scale &&
+         ka->y_scale == kb->y_scale &&
+         ka->x_offset == kb->x_offset &&
+         ka->y_offset == kb->y_offset;
+}
+
+static void
+gsk_cairo_cache_entry_free (gpointer data)
+{
+  GskCairoCacheEntry *entry = data;
+
+  cairo_surface_destroy (entry->surface);
+  gsk_render_node_unref (entry->key.node);
+  gdk_color_state_unref (entry->key.ccs);
+  g_free (entry);
+}
+
+GskCairoCache *
+gsk_cairo_cache_new (gsize max_size)
+{
+  GskCairoCache *self;
+
+  self = g_new0 (GskCairoCache, 1);
+
+  g_mutex_init (&self->lock);
+  self->entries = g_hash_table_new_full (gsk_cairo_cache_key_hash,
+                                         gsk_cairo_cache_key_equal,
+                                         NULL,
+                                         gsk_cairo_cache_entry_free);
+  g_queue_init (&self->lru);
+  self->textures = g_hash_table_new_full (NULL, NULL,
+                                          g_object_unref,
+                                          (GDestroyNotify) cairo_surface_destroy);
+  self->max_size = max_size;
+  self->frame_time = g_get_monotonic_time ();
+
+  return self;
+}
+
+void
+gsk_cairo_cache_free (GskCairoCache *self)
+{
+  gsk_cairo_cache_clear_textures (self);
+  g_hash_table_unref (self->textures);
+  g_queue_init (&self->lru);
+  g_hash_table_unref (self->entries);
+  g_mutex_clear (&self->lock);
+
+  g_free (self);
+}
+
+/* Must be called with the lock held */
+static void
+gsk_cairo_cache_remove (GskCairoCache      *self,
+                        GskCairoCacheEntry *entry)
+{
+  g_queue_unlink (&self->lru, &entry->link);
+  self->size -= entry->size;
+  g_hash_table_remove (self->entries, &entry->key);
+}
+
+/* Must be called with the lock held */
+static void
+gsk_cairo_cache_shrink (GskCairoCache *self,
+                        gsize          max_size)
+{
+  while (self->size > max_size)
+    gsk_cairo_cache_remove (self, self->lru.tail->data);
+}
+
+/*<private>
+ * gsk_cairo_cache_attach:
+ * @self: (nullable): a cache
+ * @cr: the cairo context to use @self with
+ *
+ * Makes gsk_render_node_draw_ccs() use @self for drawing to @cr.
+ * Passing %NULL detaches the cache again.
+ *
+ * The cache must stay alive as long as it is attached to @cr.
+ */
+void
+gsk_cairo_cache_attach (GskCairoCache *self,
+                        cairo_t       *cr)
+{
+  cairo_set_user_data (cr, &cache_key, self, NULL);
+  cairo_set_user_data (cr, &textures_key, self, NULL);
+}
+
+static gboolean
+gsk_cairo_cache_should_cache (GskRenderNode *node)
+{
+  switch (gsk_render_node_get_node_type (node))
+    {
+    case GSK_BLUR_NODE:
+    case GSK_SHADOW_NODE:
+    case GSK_INSET_SHADOW_NODE:
+    case GSK_OUTSET_SHADOW_NODE:
+    case GSK_TEXT_NODE:
+    case GSK_MASK_NODE:
+      return TRUE;
+
+    default:
+      return FALSE;
+    }
+}
+
+static cairo_surface_t *
+gsk_cairo_cache_rasterize (GskCairoCache *self,
+                           GskRenderNode *node,
+                           GdkColorState *ccs,
+                           double         x_scale,
+                           double         y_scale,
+                           double         x_offset,
+                           double         y_offset,
+                           int            width,
+                           int            height)
+{
+  cairo_surface_t *surface;
+  cairo_t *cr;
+
+  surface = cairo_image_surface_create (CAIRO_FORMAT_ARGB32, width, height);
+  cairo_surface_set_device_scale (surface, x_scale, y_scale);
+  cairo_surface_set_device_offset (surface, x_offset, y_offset);
+
+  /* Don't attach the cache, cached nodes inside cached nodes would
+   * only waste memory. Prepared textures are fine to use though.
+   */
+  cr = cairo_create (surface);
+  cairo_set_user_data (cr, &textures_key, self, NULL);
+  GSK_RENDER_NODE_GET_CLASS (node)->draw (node, cr, ccs);
+  cairo_destroy (cr);
+
+  /* From now on, the surface is only used as a source for a pattern
+   * mapping it to device pixels.
+   */
+  cairo_surface_set_device_scale (surface, 1, 1);
+  cairo_surface_set_device_offset (surface, 0, 0);
+
+  return surface;
+}
+
+/*<private>
+ * gsk_cairo_cache_draw_node:
+ * @node: the node to draw
+ * @cr: the cairo context to draw to
+ * @ccs: the compositing color state
+ *
+ * Draws @node using the cache attached to @cr, if there is one
+ * and @node is worth caching.
+ *
+ * Returns: %TRUE if @node was drawn
+ */
+gboolean
+gsk_cairo_cache_draw_node (GskRenderNode *node,
+                           cairo_t       *cr,
+                           GdkColorState *ccs)
+{
+  GskCairoCache *self;
+  GskCairoCacheKey key;
+  GskCairoCacheEntry *entry;
+  cairo_surface_t *target, *surface;
+  cairo_pattern_t *pattern;
+  cairo_matrix_t ctm;
+  double device_x_scale, device_y_scale, device_x_offset, device_y_offset;
+  double x_offset, y_offset;
+  int x, y, width, height;
+
+  if (!gsk_cairo_cache_should_cache (node))
+    return FALSE;
+
+  self = cairo_get_user_data (cr, &cache_key);
+  if (self == NULL)
+    return FALSE;
+
+  if (cairo_get_operator (cr) != CAIRO_OPERATOR_OVER)
+    return FALSE;
+
+  /* Only scales and translations keep rasters reusable */
+  cairo_get_matrix (cr, &ctm);
+  if (ctm.xy != 0 || ctm.yx != 0 || ctm.xx <= 0 || ctm.yy <= 0)
+    return FALSE;
+
+  target = cairo_get_group_target (cr);
+  cairo_surface_get_device_scale (target, &device_x_scale, &device_y_scale);
+  cairo_surface_get_device_offset (target, &device_x_offset, &device_y_offset);
+
+  key.x_scale = ctm.xx * device_x_scale;
+  key.y_scale = ctm.yy * device_y_scale;
+  x_offset = ctm.x0 * device_x_scale + device_x_offset;
+  y_offset = ctm.y0 * device_y_scale + device_y_offset;
+
+  x = floor (node->bounds.origin.x * key.x_scale + x_offset);
+  y = floor (node->bounds.origin.y * key.y_scale + y_offset);
+  width = ceil ((node->bounds.origin.x + node->bounds.size.width) * key.x_scale + x_offset) - x;
+  height = ceil ((node->bounds.origin.y + node->bounds.size.height) * key.y_scale + y_offset) - y;
+  if (width <= 0 || height <= 0 || (gsize) width * height > MAX_ENTRY_PIXELS)
+    return FALSE;
+
+  /* Quantize the subpixel offsets, so that rounding errors don't
+   * cause misses when the node moves by whole pixels.
+   */
+  key.node = node;
+  key.ccs = ccs;
+  key.x_offset = round ((x_offset - x) * SUBPIXEL_STEPS) / SUBPIXEL_STEPS;
+  key.y_offset = round ((y_offset - y) * SUBPIXEL_STEPS) / SUBPIXEL_STEPS;
+
+  g_mutex_lock (&self->lock);
+
+  entry = g_hash_table_lookup (self->entries, &key);
+  if (entry)
+    {
+      self->n_hits++;
+      entry->last_used = self->frame;
+      entry->last_used_time = self->frame_time;
+      g_queue_unlink (&self->lru, &entry->link);
+      g_queue_push_head_link (&self->lru, &entry->link);
+      surface = cairo_surface_reference (entry->surface);
+      g_mutex_unlock (&self->lock);
+    }
+  else
+    {
+      gsize size;
+
+      self->n_misses++;
+      g_mutex_unlock (&self->lock);
+
+      /* Rasterize without holding the lock, other threads may want
+       * to use the cache at the same time.
+       */
+      surface = gsk_cairo_cache_rasterize (self, node, ccs,
+                                           key.x_scale, key.y_scale,
+                                           x_offset - x, y_offset - y,
+                                           width, height);
+      size = (gsize) cairo_image_surface_get_stride (surface) * height;
+
+      g_mutex_lock (&self->lock);
+      if (size <= self->max_size &&
+          !g_hash_table_contains (self->entries, &key))
+        {
+          entry = g_new0 (GskCairoCacheEntry, 1);
+          entry->key = key;
+          gsk_render_node_ref (node);
+          gdk_color_state_ref (ccs);
+          entry->link.data = entry;
+          entry->surface = cairo_surface_reference (surface);
+          entry->size = size;
+          entry->last_used = self->frame;
+          entry->last_used_time = self->frame_time;
+
+          gsk_cairo_cache_shrink (self, self->max_size - size);
+          g_hash_table_add (self->entries, entry);
+          g_queue_push_head_link (&self->lru, &entry->link);
+          self->size += size;
+        }
+      g_mutex_unlock (&self->lock);
+    }
+
+  /* Place the image at (x, y) in the pixels of the target */
+  cairo_save (cr);
+  cairo_identity_matrix (cr);
+  pattern = cairo_pattern_create_for_surface (surface);
+  cairo_matrix_init (&ctm,
+                     device_x_scale, 0,
+                     0, device_y_scale,
+                     device_x_offset - x, device_y_offset - y);
+  cairo_pattern_set_matrix (pattern, &ctm);
+  cairo_set_source (cr, pattern);
+  cairo_paint (cr);
+  cairo_pattern_destroy (pattern);
+  cairo_restore (cr);
+  cairo_surface_destroy (surface);
+
+  return TRUE;
+}
+
+/*<private>
+ * gsk_cairo_cache_add_texture:
+ * @self: a cache
+ * @texture: a texture
+ * @ccs: the compositing color state
+ *
+ * Downloads @texture now, so that drawing it to a context that @self
+ * is attached to reuses the result, see
+ * gsk_cairo_cache_get_texture_surface().
+ *
+ * This must not be called while other threads are drawing.
+ * All textures must be added for the same @ccs.
+ */
+void
+gsk_cairo_cache_add_texture (GskCairoCache *self,
+                             GdkTexture    *texture,
+                             GdkColorState *ccs)
+{
+  g_return_if_fail (self->textures_ccs == NULL || self->textures_ccs == ccs);
+
+  if (g_hash_table_contains (self->textures, texture))
+    return;
+
+  self->textures_ccs = ccs;
+  g_hash_table_insert (self->textures,
+                       g_object_ref (texture),
+                       gdk_texture_get_source_surface (texture, ccs));
+}
+
+/*<private>
+ * gsk_cairo_cache_clear_textures:
+ * @self: a cache
+ *
+ * Drops the surfaces of all textures added with
+ * gsk_cairo_cache_add_texture().
+ */
+void
+gsk_cairo_cache_clear_textures (GskCairoCache *self)
+{
+  g_hash_table_remove_all (self->textures);
+  self->textures_ccs = NULL;
+}
+
+/*<private>
+ * gsk_cairo_cache_get_texture_surface:
+ * @cr: the cairo context that @texture is drawn to
+ * @texture: a texture
+ * @ccs: the compositing color state
+ *
+ * Like gdk_texture_get_source_surface(), but reuses the surface
+ * prepared by gsk_cairo_cache_add_texture() for the cache attached
+ * to @cr, if there is one.
+ *
+ * Returns: (transfer full): a surface with the contents of @texture
+ */
+cairo_surface_t *
+gsk_cairo_cache_get_texture_surface (cairo_t       *cr,
+                                     GdkTexture    *texture,
+                                     GdkColorState *ccs)
+{
+  GskCairoCache *self;
+  cairo_surface_t *surface;
+
+  self = cairo_get_user_data (cr, &textures_key);
+  if (self != NULL && self->textures_ccs == ccs)
+    {
+      surface = g_hash_table_lookup (self->textures, texture);
+      if (surface)
+        return cairo_surface_reference (surface);
+    }
+
+  return gdk_texture_get_source_surface (texture, ccs);
+}
+
+/* Must be called with the lock held */
+static void
+gsk_cairo_cache_expire (GskCairoCache *self,
+                        gint64         timestamp)
+{
+  /* The lru list is sorted by both frame and time of last use */
+  while (self->lru.tail)
+    {
+      GskCairoCacheEntry *entry = self->lru.tail->data;
+
+      if (self->frame - entry->last_used < MAX_UNUSED_FRAMES &&
+          timestamp - entry->last_used_time < MAX_UNUSED_TIME)
+        break;
+
+      gsk_cairo_cache_remove (self, entry);
+    }
+}
+
+/*<private>
+ * gsk_cairo_cache_end_frame:
+ * @self: a cache
+ * @n_hits: (out): return location for the number of cache hits
+ * @n_misses: (out): return location for the number of cache misses
+ *
+ * Drops entries that haven't been used in a while and returns
+ * the statistics for the frame that ended.
+ */
+void
+gsk_cairo_cache_end_frame (GskCairoCache *self,
+                           guint         *n_hits,
+                           guint         *n_misses)
+{
+  g_mutex_lock (&self->lock);
+
+  self->frame_time = g_get_monotonic_time ();
+  gsk_cairo_cache_expire (self, self->frame_time);
+
+  self->frame++;
+
+  *n_hits = self->n_hits;
+  *n_misses = self->n_misses;
+  self->n_hits = 0;
+  self->n_misses = 0;
+
+  g_mutex_unlock (&self->lock);
+}
+
+/*<private>
+ * gsk_cairo_cache_gc:
+ * @self: a cache
+ * @timestamp: the current monotonic time
+ *
+ * Drops entries that haven't been used for a while.
+ *
+ * Entries only expire at the end of frames, so this needs to be
+ * called regularly when no frames are drawn, or they would be kept
+ * forever.
+ *
+ * Returns: %TRUE if the cache is empty now
+ */
+gboolean
+gsk_cairo_cache_gc (GskCairoCache *self,
+                    gint64         timestamp)
+{
+  gboolean result;
+
+  g_mutex_lock (&self->lock);
+
+  gsk_cairo_cache_expire (self, timestamp);
+  result = self->lru.tail == NULL;
+
+  g_mutex_unlock (&self->lock);
+
+  return result;
+}
+
+/*<private>
+ * gsk_cairo_cache_clear:
+ * @self: a cache
+ *
+ * Drops all entries.
+ */
+void
+gsk_cairo_cache_clear (GskCairoCache *self)
+{
+  g_mutex_lock (&self->lock);
+
+  gsk_cairo_cache_shrink (self, 0);
+
+  g_mutex_unlock (&self->lock);
+}
+
+gsize
+gsk_cairo_cache_get_size (GskCairoCache *self)
+{
+  gsize size;
+
+  g_mutex_lock (&self->lock);
+  size = self->size;
+  g_mutex_unlock (&self->lock);
+
+  return size;
+}
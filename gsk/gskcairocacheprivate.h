@@ -0,0 +1,53 @@
+/* GSK - The GIMP Toolkit
+ * Copyright (C) 2026 the GTK team
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include "gskrendernode.h"
+
+#include <cairo.h>
+
+G_BEGIN_DECLS
+
+typedef struct _GskCairoCache GskCairoCache;
+
+GskCairoCache *         gsk_cairo_cache_new                     (gsize                   max_size);
+void                    gsk_cairo_cache_free                    (GskCairoCache          *self);
+
+void                    gsk_cairo_cache_attach                  (GskCairoCache          *self,
+                                                                 cairo_t                *cr);
+gboolean                gsk_cairo_cache_draw_node               (GskRenderNode          *node,
+                                                                 cairo_t                *cr,
+                                                                 GdkColorState          *ccs);
+
+void                    gsk_cairo_cache_add_texture             (GskCairoCache          *self,
+                                                                 GdkTexture             *texture,
+                                                                 GdkColorState          *ccs);
+void                    gsk_cairo_cache_clear_textures          (GskCairoCache          *self);
+cairo_surface_t *       gsk_cairo_cache_get_texture_surface     (cairo_t                *cr,
+                                                                 GdkTexture             *texture,
+                                                                 GdkColorState          *ccs);
+
+void                    gsk_cairo_cache_end_frame               (GskCairoCache          *self,
+                                                                 guint                  *n_hits,
+                                                                 guint                  *n_misses);
+gboolean                gsk_cairo_cache_gc                      (GskCairoCache          *self,
+                                                                 gint64                  timestamp);
+void                    gsk_cairo_cache_clear                   (GskCairoCache          *self);
+gsize                   gsk_cairo_cache_get_size                (GskCairoCache          *self);
+
+G_END_DECLS
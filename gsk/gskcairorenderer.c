@@ -22,25 +22,52 @@
 
 #include "gskcairorenderer.h"
 
+#include "gskcairocacheprivate.h"
 #include "gskdebugprivate.h"
 #include "gskrendererprivate.h"
 #include "gskrendernodeprivate.h"
 #include "gdk/gdkcolorstateprivate.h"
 #include "gdk/gdkdrawcontextprivate.h"
+#include "gdk/gdkparalleltaskprivate.h"
 #include "gdk/gdktextureprivate.h"
 
+/* Tiles smaller than this spend more time on setup than on drawing */
+#define MIN_TILE_SIZE 64
+
+/* Textures larger than this are drawn from a full download every
+ * time, see gsk_texture_node_draw_oversized().
+ */
+#define MAX_PREPARED_TEXTURE_SIZE 16384
+
+#define CACHE_SIZE (32 * 1024 * 1024)
+
+/* How often to drop unused entries from the cache when idle, in seconds */
+#define CACHE_GC_INTERVAL 5
+
 typedef struct {
   GQuark cpu_time;
   GQuark gpu_time;
 } ProfileTimers;
 
+typedef struct {
+  GQuark cache_hits;
+  GQuark cache_misses;
+} ProfileCounters;
+
 struct _GskCairoRenderer
 {
   GskRenderer parent_instance;
 
   GdkCairoContext *cairo_context;
 
+  /* in device pixels, 0 if tiled rendering is disabled */
+  int tile_size;
+
+  GskCairoCache *cache;
+  guint cache_gc_source;
+
   ProfileTimers profile_timers;
+  ProfileCounters profile_counters;
 };
 
 struct _GskCairoRendererClass
@@ -70,25 +97,345 @@ gsk_cairo_renderer_unrealize (GskRenderer *renderer)
   GskCairoRenderer *self = GSK_CAIRO_RENDERER (renderer);
 
   g_clear_object (&self->cairo_context);
+
+  /* Nothing is going to be drawn anymore */
+  g_clear_handle_id (&self->cache_gc_source, g_source_remove);
+  gsk_cairo_cache_clear (self->cache);
+}
+
+static gboolean
+cache_gc_cb (gpointer data)
+{
+  GskCairoRenderer *self = data;
+
+  GSK_RENDERER_DEBUG (GSK_RENDERER (self), CACHE, "Periodic Cairo cache GC");
+
+  if (gsk_cairo_cache_gc (self->cache, g_get_monotonic_time ()))
+    {
+      self->cache_gc_source = 0;
+      return G_SOURCE_REMOVE;
+    }
+
+  return G_SOURCE_CONTINUE;
 }
 
+/* Makes sure the cache is emptied eventually, even if no more
+ * frames are drawn.
+ */
 static void
-gsk_cairo_renderer_do_render (GskRenderer   *renderer,
-                              cairo_t       *cr,
-                              GdkColorState *ccs,
-                              GskRenderNode *root)
+gsk_cairo_renderer_queue_cache_gc (GskCairoRenderer *self)
+{
+  if (self->cache_gc_source != 0 ||
+      gsk_cairo_cache_get_size (self->cache) == 0)
+    return;
+
+  self->cache_gc_source = g_timeout_add_seconds (CACHE_GC_INTERVAL, cache_gc_cb, self);
+}
+
+static gboolean
+gsk_cairo_renderer_can_draw_texture_threaded (GdkTexture *texture,
+                                              GPtrArray  *textures)
+{
+  if (!GDK_IS_MEMORY_TEXTURE (texture) ||
+      gdk_texture_get_width (texture) > MAX_PREPARED_TEXTURE_SIZE ||
+      gdk_texture_get_height (texture) > MAX_PREPARED_TEXTURE_SIZE)
+    return FALSE;
+
+  g_ptr_array_add (textures, texture);
+  return TRUE;
+}
+
+/* Checks if @node can be drawn from multiple threads at the same time.
+ *
+ * This is the case for most nodes, as drawing only reads from them.
+ * The exceptions are nodes that need to call into non-threadsafe
+ * code, like downloading GL textures, replaying recording surfaces
+ * or rendering text with fonts that are shared with the rest of
+ * the application.
+ *
+ * The textures of @node are added to @textures, so they can be
+ * downloaded once before the threads start drawing.
+ */
+static gboolean
+gsk_cairo_renderer_can_draw_threaded (GskRenderNode *node,
+                                      GPtrArray     *textures)
+{
+  switch (gsk_render_node_get_node_type (node))
+    {
+    case GSK_COLOR_NODE:
+    case GSK_LINEAR_GRADIENT_NODE:
+    case GSK_REPEATING_LINEAR_GRADIENT_NODE:
+    case GSK_RADIAL_GRADIENT_NODE:
+    case GSK_REPEATING_RADIAL_GRADIENT_NODE:
+    case GSK_CONIC_GRADIENT_NODE:
+    case GSK_BORDER_NODE:
+    case GSK_INSET_SHADOW_NODE:
+    case GSK_OUTSET_SHADOW_NODE:
+    case GSK_GL_SHADER_NODE:
+      return TRUE;
+
+    case GSK_TEXTURE_NODE:
+      return gsk_cairo_renderer_can_draw_texture_threaded (gsk_texture_node_get_texture (node), textures);
+
+    case GSK_TEXTURE_SCALE_NODE:
+      return gsk_cairo_renderer_can_draw_texture_threaded (gsk_texture_scale_node_get_texture (node), textures);
+
+    case GSK_CONTAINER_NODE:
+      {
+        guint i;
+
+        for (i = 0; i < gsk_container_node_get_n_children (node); i++)
+          {
+            if (!gsk_cairo_renderer_can_draw_threaded (gsk_container_node_get_child (node, i), textures))
+              return FALSE;
+          }
+        return TRUE;
+      }
+
+    case GSK_TRANSFORM_NODE:
+      return gsk_cairo_renderer_can_draw_threaded (gsk_transform_node_get_child (node), textures);
+
+    case GSK_OPACITY_NODE:
+      return gsk_cairo_renderer_can_draw_threaded (gsk_opacity_node_get_child (node), textures);
+
+    case GSK_COLOR_MATRIX_NODE:
+      return gsk_cairo_renderer_can_draw_threaded (gsk_color_matrix_node_get_child (node), textures);
+
+    case GSK_REPEAT_NODE:
+      return gsk_cairo_renderer_can_draw_threaded (gsk_repeat_node_get_child (node), textures);
+
+    case GSK_CLIP_NODE:
+      return gsk_cairo_renderer_can_draw_threaded (gsk_clip_node_get_child (node), textures);
+
+    case GSK_ROUNDED_CLIP_NODE:
+      return gsk_cairo_renderer_can_draw_threaded (gsk_rounded_clip_node_get_child (node), textures);
+
+    case GSK_SHADOW_NODE:
+      return gsk_cairo_renderer_can_draw_threaded (gsk_shadow_node_get_child (node), textures);
+
+    case GSK_BLUR_NODE:
+      return gsk_cairo_renderer_can_draw_threaded (gsk_blur_node_get_child (node), textures);
+
+    case GSK_DEBUG_NODE:
+      return gsk_cairo_renderer_can_draw_threaded (gsk_debug_node_get_child (node), textures);
+
+    case GSK_FILL_NODE:
+      return gsk_cairo_renderer_can_draw_threaded (gsk_fill_node_get_child (node), textures);
+
+    case GSK_STROKE_NODE:
+      return gsk_cairo_renderer_can_draw_threaded (gsk_stroke_node_get_child (node), textures);
+
+    case GSK_SUBSURFACE_NODE:
+      return gsk_cairo_renderer_can_draw_threaded (gsk_subsurface_node_get_child (node), textures);
+
+    case GSK_BLEND_NODE:
+      return gsk_cairo_renderer_can_draw_threaded (gsk_blend_node_get_bottom_child (node), textures) &&
+             gsk_cairo_renderer_can_draw_threaded (gsk_blend_node_get_top_child (node), textures);
+
+    case GSK_CROSS_FADE_NODE:
+      return gsk_cairo_renderer_can_draw_threaded (gsk_cross_fade_node_get_start_child (node), textures) &&
+             gsk_cairo_renderer_can_draw_threaded (gsk_cross_fade_node_get_end_child (node), textures);
+
+    case GSK_MASK_NODE:
+      return gsk_cairo_renderer_can_draw_threaded (gsk_mask_node_get_source (node), textures) &&
+             gsk_cairo_renderer_can_draw_threaded (gsk_mask_node_get_mask (node), textures);
+
+    /* Replaying recording surfaces is not threadsafe */
+    case GSK_CAIRO_NODE:
+    /* Pango and cairo share font objects with the rest of the app */
+    case GSK_TEXT_NODE:
+    case GSK_NOT_A_RENDER_NODE:
+    default:
+      return FALSE;
+    }
+}
+
+typedef struct
+{
+  GskCairoCache *cache;
+  GskRenderNode *root;
+  GdkColorState *ccs;
+  const cairo_region_t *clip;
+  cairo_matrix_t matrix;
+  double x_scale, y_scale;
+  double x_offset, y_offset;
+  cairo_rectangle_int_t *tiles;
+  cairo_surface_t **surfaces;
+} TileData;
+
+static void
+gsk_cairo_renderer_draw_tiles (gsize    start,
+                               gsize    end,
+                               gpointer user_data)
+{
+  TileData *data = user_data;
+  gsize i;
+
+  for (i = start; i < end; i++)
+    {
+      const cairo_rectangle_int_t *tile = &data->tiles[i];
+      cairo_surface_t *surface;
+      cairo_t *cr;
+
+      surface = cairo_image_surface_create (CAIRO_FORMAT_ARGB32, tile->width, tile->height);
+      cairo_surface_set_device_scale (surface, data->x_scale, data->y_scale);
+      cairo_surface_set_device_offset (surface,
+                                       data->x_offset - tile->x,
+                                       data->y_offset - tile->y);
+
+      cr = cairo_create (surface);
+      gsk_cairo_cache_attach (data->cache, cr);
+      gdk_cairo_region (cr, data->clip);
+      cairo_clip (cr);
+      cairo_set_matrix (cr, &data->matrix);
+
+      gsk_render_node_draw_with_color_state (data->root, cr, data->ccs);
+
+      cairo_destroy (cr);
+
+      data->surfaces[i] = surface;
+    }
+}
+
+/* Draws @root by splitting @clip into tiles that are drawn into
+ * separate image surfaces by the worker threads, which are then
+ * composited onto @cr.
+ *
+ * @clip is given in the coordinate system of @cr without its
+ * transform applied.
+ *
+ * Returns: %FALSE if tiling isn't possible and nothing was drawn
+ */
+static gboolean
+gsk_cairo_renderer_render_tiles (GskCairoRenderer     *self,
+                                 cairo_t              *cr,
+                                 GdkColorState        *ccs,
+                                 GskRenderNode        *root,
+                                 const cairo_region_t *clip)
+{
+  cairo_surface_t *target;
+  cairo_rectangle_int_t extents;
+  TileData data;
+  GArray *tiles;
+  GPtrArray *textures;
+  int x, y, x1, y1, x2, y2;
+  gsize i;
+
+  if (self->tile_size <= 0)
+    return FALSE;
+
+  target = cairo_get_target (cr);
+  cairo_surface_get_device_scale (target, &data.x_scale, &data.y_scale);
+  cairo_surface_get_device_offset (target, &data.x_offset, &data.y_offset);
+
+  cairo_region_get_extents (clip, &extents);
+  x1 = floor (extents.x * data.x_scale + data.x_offset);
+  y1 = floor (extents.y * data.y_scale + data.y_offset);
+  x2 = ceil ((extents.x + extents.width) * data.x_scale + data.x_offset);
+  y2 = ceil ((extents.y + extents.height) * data.y_scale + data.y_offset);
+
+  if (x2 - x1 <= self->tile_size && y2 - y1 <= self->tile_size)
+    return FALSE;
+
+  textures = g_ptr_array_new ();
+  if (!gsk_cairo_renderer_can_draw_threaded (root, textures))
+    {
+      GSK_RENDERER_DEBUG (GSK_RENDERER (self), FALLBACK,
+                          "Not using tiles, node tree can't be drawn from threads");
+      g_ptr_array_unref (textures);
+      return FALSE;
+    }
+
+  /* Download every texture once, instead of once per tile */
+  for (i = 0; i < textures->len; i++)
+    gsk_cairo_cache_add_texture (self->cache, g_ptr_array_index (textures, i), ccs);
+  g_ptr_array_unref (textures);
+
+  tiles = g_array_new (FALSE, FALSE, sizeof (cairo_rectangle_int_t));
+  for (y = y1; y < y2; y += self->tile_size)
+    {
+      for (x = x1; x < x2; x += self->tile_size)
+        {
+          cairo_rectangle_int_t tile, area;
+
+          tile.x = x;
+          tile.y = y;
+          tile.width = MIN (self->tile_size, x2 - x);
+          tile.height = MIN (self->tile_size, y2 - y);
+
+          area.x = floor ((tile.x - data.x_offset) / data.x_scale);
+          area.y = floor ((tile.y - data.y_offset) / data.y_scale);
+          area.width = ceil ((tile.x + tile.width - data.x_offset) / data.x_scale) - area.x;
+          area.height = ceil ((tile.y + tile.height - data.y_offset) / data.y_scale) - area.y;
+          if (cairo_region_contains_rectangle (clip, &area) == CAIRO_REGION_OVERLAP_OUT)
+            continue;
+
+          g_array_append_val (tiles, tile);
+        }
+    }
+
+  data.cache = self->cache;
+  data.root = root;
+  data.ccs = ccs;
+  data.clip = clip;
+  cairo_get_matrix (cr, &data.matrix);
+  data.tiles = (cairo_rectangle_int_t *) tiles->data;
+  data.surfaces = g_new0 (cairo_surface_t *, tiles->len);
+
+  gdk_parallel_for (tiles->len, 1, gsk_cairo_renderer_draw_tiles, &data);
+
+  gsk_cairo_cache_clear_textures (self->cache);
+
+  /* The tiles carry the device transform of the target, so with an
+   * identity matrix they line up with the target's pixels.
+   */
+  cairo_save (cr);
+  cairo_identity_matrix (cr);
+  for (i = 0; i < tiles->len; i++)
+    {
+      cairo_set_source_surface (cr, data.surfaces[i], 0, 0);
+      cairo_paint (cr);
+      cairo_surface_destroy (data.surfaces[i]);
+    }
+  cairo_restore (cr);
+
+  g_free (data.surfaces);
+  g_array_unref (tiles);
+
+  return TRUE;
+}
+
+static void
+gsk_cairo_renderer_do_render (GskRenderer          *renderer,
+                              cairo_t              *cr,
+                              GdkColorState        *ccs,
+                              GskRenderNode        *root,
+                              const cairo_region_t *clip)
 {
   GskCairoRenderer *self = GSK_CAIRO_RENDERER (renderer);
   GskProfiler *profiler;
   gint64 cpu_time;
+  guint n_hits, n_misses;
 
   profiler = gsk_renderer_get_profiler (renderer);
   gsk_profiler_timer_begin (profiler, self->profile_timers.cpu_time);
 
-  gsk_render_node_draw_with_color_state (root, cr, ccs);
+  gsk_cairo_cache_attach (self->cache, cr);
+
+  if (!gsk_cairo_renderer_render_tiles (self, cr, ccs, root, clip))
+    gsk_render_node_draw_with_color_state (root, cr, ccs);
+
+  gsk_cairo_cache_attach (NULL, cr);
+  gsk_cairo_cache_end_frame (self->cache, &n_hits, &n_misses);
+  gsk_cairo_renderer_queue_cache_gc (self);
 
   cpu_time = gsk_profiler_timer_end (profiler, self->profile_timers.cpu_time);
   gsk_profiler_timer_set (profiler, self->profile_timers.cpu_time, cpu_time);
+  gsk_profiler_counter_add (profiler, self->profile_counters.cache_hits, n_hits);
+  gsk_profiler_counter_add (profiler, self->profile_counters.cache_misses, n_misses);
+
+  GSK_RENDERER_DEBUG (renderer, CACHE, "Cairo cache: %u hits, %u misses, %zu kB used",
+                      n_hits, n_misses, gsk_cairo_cache_get_size (self->cache) / 1024);
 
   gsk_profiler_push_samples (profiler);
 }
@@ -100,6 +447,7 @@ gsk_cairo_renderer_render_texture (GskRenderer           *renderer,
 {
   GdkTexture *texture;
   cairo_surface_t *surface;
+  cairo_region_t *region;
   cairo_t *cr;
   int width, height;
   /* limit from cairo's source code */
@@ -143,7 +491,9 @@ gsk_cairo_renderer_render_texture (GskRenderer           *renderer,
 
   cairo_translate (cr, - viewport->origin.x, - viewport->origin.y);
 
-  gsk_cairo_renderer_do_render (renderer, cr, GDK_COLOR_STATE_SRGB, root);
+  region = cairo_region_create_rectangle (&(cairo_rectangle_int_t) { 0, 0, width, height });
+  gsk_cairo_renderer_do_render (renderer, cr, GDK_COLOR_STATE_SRGB, root, region);
+  cairo_region_destroy (region);
 
   cairo_destroy (cr);
 
@@ -192,18 +542,33 @@ gsk_cairo_renderer_render (GskRenderer          *renderer,
   gsk_cairo_renderer_do_render (renderer,
                                 cr,
                                 gdk_draw_context_get_color_state (GDK_DRAW_CONTEXT (self->cairo_context)),
-                                root);
+                                root,
+                                gdk_draw_context_get_frame_region (GDK_DRAW_CONTEXT (self->cairo_context)));
 
   cairo_destroy (cr);
 
   gdk_draw_context_end_frame_full (GDK_DRAW_CONTEXT (self->cairo_context));
 }
 
+static void
+gsk_cairo_renderer_finalize (GObject *object)
+{
+  GskCairoRenderer *self = GSK_CAIRO_RENDERER (object);
+
+  g_clear_handle_id (&self->cache_gc_source, g_source_remove);
+  gsk_cairo_cache_free (self->cache);
+
+  G_OBJECT_CLASS (gsk_cairo_renderer_parent_class)->finalize (object);
+}
+
 static void
 gsk_cairo_renderer_class_init (GskCairoRendererClass *klass)
 {
+  GObjectClass *object_class = G_OBJECT_CLASS (klass);
   GskRendererClass *renderer_class = GSK_RENDERER_CLASS (klass);
 
+  object_class->finalize = gsk_cairo_renderer_finalize;
+
   renderer_class->realize = gsk_cairo_renderer_realize;
   renderer_class->unrealize = gsk_cairo_renderer_unrealize;
   renderer_class->render = gsk_cairo_renderer_render;
@@ -215,7 +580,30 @@ gsk_cairo_renderer_init (GskCairoRenderer *self)
 {
   GskProfiler *profiler = gsk_renderer_get_profiler (GSK_RENDERER (self));
 
+  const char *str;
+
   self->profile_timers.cpu_time = gsk_profiler_add_timer (profiler, "cpu-time", "CPU time", FALSE, TRUE);
+  self->profile_counters.cache_hits = gsk_profiler_add_counter (profiler, "cache-hits", "Cache hits", TRUE);
+  self->profile_counters.cache_misses = gsk_profiler_add_counter (profiler, "cache-misses", "Cache misses", TRUE);
+
+  self->cache = gsk_cairo_cache_new (CACHE_SIZE);
+
+  str = g_getenv ("GSK_CAIRO_TILE_SIZE");
+  if (str != NULL)
+    {
+      gint64 value;
+      GError *error = NULL;
+
+      if (!g_ascii_string_to_signed (str, 10, 0, G_MAXINT, &value, &error))
+        {
+          g_warning ("Failed to parse GSK_CAIRO_TILE_SIZE: %s", error->message);
+          g_error_free (error);
+        }
+      else if (value > 0)
+        {
+          self->tile_size = MAX ((int) value, MIN_TILE_SIZE);
+        }
+    }
 }
 
 /**
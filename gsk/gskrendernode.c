@@ -38,6 +38,7 @@
 
 #include "gskrendernodeprivate.h"
 
+#include "gskcairocacheprivate.h"
 #include "gskdebugprivate.h"
 #include "gskrendererprivate.h"
 #include "gskrendernodeparserprivate.h"
@@ -375,7 +376,8 @@ gsk_render_node_draw_ccs (GskRenderNode *node,
 
   cairo_save (cr);
 
-  GSK_RENDER_NODE_GET_CLASS (node)->draw (node, cr, ccs);
+  if (!gsk_cairo_cache_draw_node (node, cr, ccs))
+    GSK_RENDER_NODE_GET_CLASS (node)->draw (node, cr, ccs);
 
   if (GSK_DEBUG_CHECK (GEOMETRY))
     {
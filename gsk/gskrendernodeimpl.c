@@ -21,6 +21,7 @@
 #include "gskrendernodeprivate.h"
 
 #include "gskcairoblurprivate.h"
+#include "gskcairocacheprivate.h"
 #include "gskcairorenderer.h"
 #include "gskdebugprivate.h"
 #include "gskdiffprivate.h"
@@ -2797,7 +2798,7 @@ gsk_texture_node_draw (GskRenderNode *node,
       return;
     }
 
-  surface = gdk_texture_download_surface (self->texture, ccs);
+  surface = gsk_cairo_cache_get_texture_surface (cr, self->texture, ccs);
   pattern = cairo_pattern_create_for_surface (surface);
   cairo_pattern_set_extend (pattern, CAIRO_EXTEND_PAD);
 
@@ -2976,7 +2977,7 @@ gsk_texture_scale_node_draw (GskRenderNode *node,
   cairo_surface_set_device_offset (surface2, -clip_rect.origin.x, -clip_rect.origin.y);
   cr2 = cairo_create (surface2);
 
-  surface = gdk_texture_download_surface (self->texture, ccs);
+  surface = gsk_cairo_cache_get_texture_surface (cr, self->texture, ccs);
   pattern = cairo_pattern_create_for_surface (surface);
   cairo_pattern_set_extend (pattern, CAIRO_EXTEND_PAD);
 
@@ -3237,6 +3238,8 @@ corner_mask_equal (CornerMask *mask1,
     mask1->corner.height == mask2->corner.height;
 }
 
+G_LOCK_DEFINE_STATIC (corner_mask_cache);
+
 static void
 draw_shadow_corner (cairo_t               *cr,
                     GdkColorState         *ccs,
@@ -3344,6 +3347,12 @@ draw_shadow_corner (cairo_t               *cr,
    * mask, so we cache rendered masks based on the blur radius and the
    * corner radius.
    */
+  /* The cairo renderer may draw from multiple threads, see
+   * gsk_cairo_renderer_render_tiles(). Masks are never evicted,
+   * so they can be used after dropping the lock.
+   */
+  G_LOCK (corner_mask_cache);
+
   if (corner_mask_cache == NULL)
     corner_mask_cache = g_hash_table_new_full ((GHashFunc)corner_mask_hash,
                                                (GEqualFunc)corner_mask_equal,
@@ -3368,6 +3377,8 @@ draw_shadow_corner (cairo_t               *cr,
       g_hash_table_insert (corner_mask_cache, g_memdup2 (&key, sizeof (key)), mask);
     }
 
+  G_UNLOCK (corner_mask_cache);
+
   gdk_cairo_set_source_color (cr, ccs, color);
   pattern = cairo_pattern_create_for_surface (mask);
   cairo_matrix_init_identity (&matrix);
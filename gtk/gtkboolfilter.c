@@ -21,6 +21,7 @@
 
 #include "gtkboolfilter.h"
 
+#include "gtkfilterprivate.h"
 #include "gtktypebuiltins.h"
 
 /**
@@ -80,6 +81,20 @@ gtk_bool_filter_get_strictness (GtkFilter *filter)
   return GTK_FILTER_MATCH_SOME;
 }
 
+static GtkFilter *
+gtk_bool_filter_copy_thread_safe (GtkFilter *filter)
+{
+  GtkBoolFilter *self = GTK_BOOL_FILTER (filter);
+  GtkBoolFilter *copy;
+
+  copy = g_object_new (GTK_TYPE_BOOL_FILTER, NULL);
+  if (self->expression)
+    copy->expression = gtk_expression_ref (self->expression);
+  copy->invert = self->invert;
+
+  return GTK_FILTER (copy);
+}
+
 static void
 gtk_bool_filter_set_property (GObject      *object,
                               guint         prop_id,
@@ -146,6 +161,7 @@ gtk_bool_filter_class_init (GtkBoolFilterClass *class)
 
   filter_class->match = gtk_bool_filter_match;
   filter_class->get_strictness = gtk_bool_filter_get_strictness;
+  gtk_filter_class_set_thread_safe_copy (filter_class, gtk_bool_filter_copy_thread_safe);
 
   object_class->get_property = gtk_bool_filter_get_property;
   object_class->set_property = gtk_bool_filter_set_property;
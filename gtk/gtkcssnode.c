@@ -21,6 +21,7 @@
 
 #include "gtkcssstaticstyleprivate.h"
 #include "gtkcssanimatedstyleprivate.h"
+#include "gtkcssselectorprivate.h"
 #include "gtkcssstylepropertyprivate.h"
 #include "gtkmarshalers.h"
 #include "gtksettingsprivate.h"
@@ -1370,6 +1371,9 @@ gtk_css_node_validate (GtkCssNode *cssnode)
 
   gtk_css_node_validate_internal (cssnode, &filter, timestamp);
 
+  gtk_css_selector_tree_report_statistics ();
+  gtk_css_static_style_report_statistics ();
+
   if (GDK_PROFILER_IS_RUNNING)
     {
       gdk_profiler_end_mark (before,  "Validate CSS", "");
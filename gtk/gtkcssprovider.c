@@ -31,6 +31,7 @@
 #include "gtkcssreferencevalueprivate.h"
 #include "gtkcssselectorprivate.h"
 #include "gtkcssshorthandpropertyprivate.h"
+#include "gtkcssstylepropertyprivate.h"
 #include "gtksettingsprivate.h"
 #include "gtkstyleprovider.h"
 #include "gtkstylepropertyprivate.h"
@@ -41,6 +42,7 @@
 
 #include <string.h>
 #include <stdlib.h>
+#include <glib/gstdio.h>
 
 #include <gdk-pixbuf/gdk-pixbuf.h>
 #include "gdk/gdkprofilerprivate.h"
@@ -91,6 +93,17 @@ G_STATIC_ASSERT (GTK_DEBUG_CSS == GTK_CSS_PARSER_DEBUG_CSS);
 
 #define MAX_SELECTOR_LIST_LENGTH 64
 
+/* Style sheets with fewer rulesets parse fast enough without a cache */
+#define CACHE_MIN_RULESETS 100
+/* Bump when the cache format or anything it depends on changes */
+#define CACHE_FORMAT_VERSION 2
+/* (imports, colors, keyframes, strings, values, blocks, rulesets, tree) */
+#define CACHE_VARIANT_TYPE "(a(ss)a(ss)a(ss)asa(us)aauauay)"
+/* Cache files that weren't used for that long are deleted */
+#define CACHE_MAX_AGE (30 * G_TIME_SPAN_DAY)
+/* At most that many cache files are kept */
+#define CACHE_MAX_FILES 16
+
 struct _GtkCssProviderClass
 {
   GObjectClass parent_class;
@@ -141,6 +154,10 @@ struct _GtkCssProviderPrivate
   GResource *resource;
   char *path;
   GBytes *bytes; /* *no* reference */
+
+  /* imported files while loading a style sheet that will be cached */
+  GVariantBuilder *cache_imports;
+  guint cache_blocked : 1;
 };
 
 enum {
@@ -391,8 +408,12 @@ gtk_css_scanner_parser_error (GtkCssParser         *parser,
                               gpointer              user_data)
 {
   GtkCssScanner *scanner = user_data;
+  GtkCssProviderPrivate *priv = gtk_css_provider_get_instance_private (scanner->provider);
   GtkCssSection *section;
 
+  /* Errors must be reported on every load, so don't cache */
+  priv->cache_blocked = TRUE;
+
   section = gtk_css_section_new_with_bytes (gtk_css_parser_get_file (parser),
                                             gtk_css_parser_get_bytes (parser),
                                             start,
@@ -1203,6 +1224,711 @@ gtk_css_provider_postprocess (GtkCssProvider *css_provider)
   gdk_profiler_end_mark (before, "Create CSS selector tree", NULL);
 }
 
+/* Loading a big theme spends most of its time tokenizing, parsing
+ * selectors and building the selector tree. The cache stores the result
+ * of that in the user's cache directory, keyed by a hash of the style
+ * sheet. Each distinct value is stored once in its printed form and
+ * parsed again on load, the selector tree is stored as is.
+ *
+ * Only style sheets without errors or warnings are cached, as those
+ * need to be reported on every load.
+ *
+ * Every change to a style sheet creates a new cache file, so old ones
+ * are deleted when a new one is written. Loading a cache file updates
+ * its modification time, so the ones in use are kept.
+ */
+
+static char *
+gtk_css_provider_get_cache_key (GFile  *file,
+                                GBytes *bytes)
+{
+  GChecksum *checksum;
+  char *header;
+  char *key;
+
+  if (gtk_keep_css_sections || GTK_DEBUG_CHECK (NO_CSS_CACHE))
+    return NULL;
+
+  checksum = g_checksum_new (G_CHECKSUM_SHA256);
+
+  /* Deprecation warnings are only emitted when debugging CSS, so
+   * style sheets may only be cacheable in one of the modes
+   */
+  header = g_strdup_printf ("%d %d.%d.%d %d %d",
+                            CACHE_FORMAT_VERSION,
+                            GTK_MAJOR_VERSION, GTK_MINOR_VERSION, GTK_MICRO_VERSION,
+                            GLIB_SIZEOF_VOID_P,
+                            GTK_DEBUG_CHECK (CSS) ? 1 : 0);
+  g_checksum_update (checksum, (const guchar *) header, strlen (header) + 1);
+  g_free (header);
+
+  if (file)
+    {
+      char *uri = g_file_get_uri (file);
+      g_checksum_update (checksum, (const guchar *) uri, strlen (uri) + 1);
+      g_free (uri);
+    }
+
+  g_checksum_update (checksum, g_bytes_get_data (bytes, NULL), g_bytes_get_size (bytes));
+
+  key = g_strdup (g_checksum_get_string (checksum));
+  g_checksum_free (checksum);
+
+  return key;
+}
+
+static char *
+gtk_css_provider_get_cache_dir (void)
+{
+  return g_build_filename (g_get_user_cache_dir (), "gtk-4.0", "css", NULL);
+}
+
+static char *
+gtk_css_provider_get_cache_path (const char *key,
+                                 gboolean    create_dir)
+{
+  char *basename;
+  char *dir;
+  char *path;
+
+  basename = g_strconcat (key, ".cache", NULL);
+  dir = gtk_css_provider_get_cache_dir ();
+  path = g_build_filename (dir, basename, NULL);
+
+  if (create_dir && g_mkdir_with_parents (dir, 0755) != 0)
+    {
+      g_warning ("Failed to mkdir %s", dir);
+      g_clear_pointer (&path, g_free);
+    }
+
+  g_free (dir);
+  g_free (basename);
+
+  return path;
+}
+
+static void
+gtk_css_provider_cache_parser_error (GtkCssParser         *parser,
+                                     const GtkCssLocation *start,
+                                     const GtkCssLocation *end,
+                                     const GError         *error,
+                                     gpointer              user_data)
+{
+  gboolean *failed = user_data;
+
+  *failed = TRUE;
+}
+
+typedef gpointer (* CacheParseFunc) (GtkCssParser *parser,
+                                     gpointer      data);
+
+/* Parses @text completely, or returns %NULL */
+static gpointer
+gtk_css_provider_cache_parse (GFile          *file,
+                              const char     *text,
+                              CacheParseFunc  parse_func,
+                              gpointer        data,
+                              GDestroyNotify  free_func)
+{
+  GtkCssParser *parser;
+  GBytes *bytes;
+  gboolean failed = FALSE;
+  gpointer result;
+
+  bytes = g_bytes_new_static (text, strlen (text));
+  parser = gtk_css_parser_new_for_bytes (bytes, file, gtk_css_provider_cache_parser_error, &failed, NULL);
+  g_bytes_unref (bytes);
+
+  result = parse_func (parser, data);
+  if (result && (failed || !gtk_css_parser_has_token (parser, GTK_CSS_TOKEN_EOF)))
+    g_clear_pointer (&result, free_func);
+
+  gtk_css_parser_unref (parser);
+
+  return result;
+}
+
+static gpointer
+parse_cached_value (GtkCssParser *parser,
+                    gpointer      property)
+{
+  return _gtk_style_property_parse_value (property, parser);
+}
+
+static gpointer
+parse_cached_color (GtkCssParser *parser,
+                    gpointer      unused)
+{
+  return gtk_css_color_value_parse (parser);
+}
+
+static gpointer
+parse_cached_keyframes (GtkCssParser *parser,
+                        gpointer      unused)
+{
+  return _gtk_css_keyframes_parse (parser);
+}
+
+static char *
+print_keyframes (GtkCssKeyframes *keyframes)
+{
+  GString *str = g_string_new (NULL);
+
+  _gtk_css_keyframes_print (keyframes, str);
+
+  return g_string_free (str, FALSE);
+}
+
+/* Checks that @text parses back into @value, so it can be cached */
+static gboolean
+gtk_css_provider_cache_check_value (GFile          *file,
+                                    const char     *text,
+                                    GtkCssValue    *value,
+                                    CacheParseFunc  parse_func,
+                                    gpointer        data)
+{
+  GtkCssValue *parsed;
+  char *reprinted;
+  gboolean result;
+
+  parsed = gtk_css_provider_cache_parse (file, text, parse_func, data, (GDestroyNotify) gtk_css_value_unref);
+  if (parsed == NULL)
+    return FALSE;
+
+  reprinted = gtk_css_value_to_string (parsed);
+  result = strcmp (text, reprinted) == 0 && gtk_css_value_equal (value, parsed);
+
+  g_free (reprinted);
+  gtk_css_value_unref (parsed);
+
+  return result;
+}
+
+static GVariant *
+gtk_css_provider_serialize (GtkCssProvider *self,
+                            GFile          *file)
+{
+  GtkCssProviderPrivate *priv = gtk_css_provider_get_instance_private (self);
+  GVariantBuilder colors, keyframes, values, blocks, rulesets;
+  GHashTable *value_indexes, *block_indexes;
+  GPtrArray *strings;
+  GHashTableIter iter;
+  gpointer key, value;
+  GVariant *result = NULL;
+  GBytes *tree;
+  guint n_values = 0;
+  guint i, j;
+
+  g_variant_builder_init (&colors, G_VARIANT_TYPE ("a(ss)"));
+  g_variant_builder_init (&keyframes, G_VARIANT_TYPE ("a(ss)"));
+  g_variant_builder_init (&values, G_VARIANT_TYPE ("a(us)"));
+  g_variant_builder_init (&blocks, G_VARIANT_TYPE ("aau"));
+  g_variant_builder_init (&rulesets, G_VARIANT_TYPE ("au"));
+  value_indexes = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, NULL);
+  block_indexes = g_hash_table_new (NULL, NULL);
+  strings = g_ptr_array_new ();
+
+  g_hash_table_iter_init (&iter, priv->symbolic_colors);
+  while (g_hash_table_iter_next (&iter, &key, &value))
+    {
+      char *text = gtk_css_value_to_string (value);
+      gboolean ok = gtk_css_provider_cache_check_value (file, text, value, parse_cached_color, NULL);
+
+      if (ok)
+        g_variant_builder_add (&colors, "(ss)", key, text);
+      g_free (text);
+      if (!ok)
+        goto out;
+    }
+
+  g_hash_table_iter_init (&iter, priv->keyframes);
+  while (g_hash_table_iter_next (&iter, &key, &value))
+    {
+      GtkCssKeyframes *parsed;
+      char *text, *reprinted;
+      gboolean ok;
+
+      text = print_keyframes (value);
+      parsed = gtk_css_provider_cache_parse (file, text, parse_cached_keyframes, NULL,
+                                             (GDestroyNotify) _gtk_css_keyframes_unref);
+      reprinted = parsed ? print_keyframes (parsed) : NULL;
+      ok = g_strcmp0 (text, reprinted) == 0;
+
+      if (ok)
+        g_variant_builder_add (&keyframes, "(ss)", key, text);
+      g_clear_pointer (&parsed, _gtk_css_keyframes_unref);
+      g_free (reprinted);
+      g_free (text);
+      if (!ok)
+        goto out;
+    }
+
+  for (i = 0; i < priv->rulesets->len; i++)
+    {
+      GtkCssRuleset *ruleset = &g_array_index (priv->rulesets, GtkCssRuleset, i);
+      gpointer block;
+
+      /* Custom properties are token streams, not values */
+      if (ruleset->custom_properties)
+        goto out;
+
+      if (!g_hash_table_lookup_extended (block_indexes, ruleset->styles, NULL, &block))
+        {
+          GVariantBuilder indexes;
+
+          g_variant_builder_init (&indexes, G_VARIANT_TYPE ("au"));
+
+          for (j = 0; j < ruleset->n_styles; j++)
+            {
+              GtkCssStyleProperty *property = ruleset->styles[j].property;
+              guint id = _gtk_css_style_property_get_id (property);
+              char *text, *text_key;
+              gpointer index;
+
+              text = gtk_css_value_to_string (ruleset->styles[j].value);
+              text_key = g_strdup_printf ("%u:%s", id, text);
+
+              if (!g_hash_table_lookup_extended (value_indexes, text_key, NULL, &index))
+                {
+                  if (!gtk_css_provider_cache_check_value (file, text, ruleset->styles[j].value,
+                                                           parse_cached_value, property))
+                    {
+                      GTK_DEBUG (CSS, "Not caching style sheet, can't store %s: %s",
+                                 _gtk_style_property_get_name (GTK_STYLE_PROPERTY (property)), text);
+                      g_variant_builder_clear (&indexes);
+                      g_free (text_key);
+                      g_free (text);
+                      goto out;
+                    }
+
+                  index = GUINT_TO_POINTER (n_values++);
+                  g_variant_builder_add (&values, "(us)", id, text);
+                  g_hash_table_insert (value_indexes, g_steal_pointer (&text_key), index);
+                }
+
+              g_variant_builder_add (&indexes, "u", GPOINTER_TO_UINT (index));
+
+              g_free (text_key);
+              g_free (text);
+            }
+
+          block = GUINT_TO_POINTER (g_hash_table_size (block_indexes));
+          g_hash_table_insert (block_indexes, ruleset->styles, block);
+          g_variant_builder_add (&blocks, "@au", g_variant_builder_end (&indexes));
+        }
+
+      g_variant_builder_add (&rulesets, "u", GPOINTER_TO_UINT (block));
+    }
+
+  tree = gtk_css_selector_tree_serialize (priv->tree,
+                                          priv->rulesets->data,
+                                          sizeof (GtkCssRuleset),
+                                          strings);
+  g_ptr_array_add (strings, NULL);
+
+  result = g_variant_new ("(@a(ss)@a(ss)@a(ss)^as@a(us)@aau@au@ay)",
+                          g_variant_builder_end (priv->cache_imports),
+                          g_variant_builder_end (&colors),
+                          g_variant_builder_end (&keyframes),
+                          (const char * const *) strings->pdata,
+                          g_variant_builder_end (&values),
+                          g_variant_builder_end (&blocks),
+                          g_variant_builder_end (&rulesets),
+                          g_variant_new_from_bytes (G_VARIANT_TYPE_BYTESTRING, tree, TRUE));
+  g_variant_ref_sink (result);
+  g_bytes_unref (tree);
+
+out:
+  if (result == NULL)
+    {
+      g_variant_builder_clear (&colors);
+      g_variant_builder_clear (&keyframes);
+      g_variant_builder_clear (&values);
+      g_variant_builder_clear (&blocks);
+      g_variant_builder_clear (&rulesets);
+    }
+  g_hash_table_unref (value_indexes);
+  g_hash_table_unref (block_indexes);
+  g_ptr_array_unref (strings);
+
+  return result;
+}
+
+typedef struct {
+  char *path;
+  gint64 mtime;
+} CacheFile;
+
+static void
+cache_file_clear (gpointer data)
+{
+  CacheFile *cache_file = data;
+
+  g_free (cache_file->path);
+}
+
+static int
+cache_file_compare_newest_first (gconstpointer a,
+                                 gconstpointer b)
+{
+  const CacheFile *fa = a;
+  const CacheFile *fb = b;
+
+  if (fa->mtime != fb->mtime)
+    return fa->mtime > fb->mtime ? -1 : 1;
+
+  return strcmp (fa->path, fb->path);
+}
+
+/* Deletes cache files that are too old, and the oldest ones
+ * if there are too many.
+ */
+static void
+gtk_css_provider_prune_cache (void)
+{
+  GArray *files;
+  const char *name;
+  char *dir_name;
+  GDir *dir;
+  gint64 now;
+  guint i;
+
+  dir_name = gtk_css_provider_get_cache_dir ();
+  dir = g_dir_open (dir_name, 0, NULL);
+  if (dir == NULL)
+    {
+      g_free (dir_name);
+      return;
+    }
+
+  files = g_array_new (FALSE, FALSE, sizeof (CacheFile));
+  g_array_set_clear_func (files, cache_file_clear);
+
+  while ((name = g_dir_read_name (dir)))
+    {
+      GStatBuf buf;
+      CacheFile cache_file;
+
+      if (!g_str_has_suffix (name, ".cache"))
+        continue;
+
+      cache_file.path = g_build_filename (dir_name, name, NULL);
+      if (g_stat (cache_file.path, &buf) != 0)
+        {
+          g_free (cache_file.path);
+          continue;
+        }
+
+      cache_file.mtime = (gint64) buf.st_mtime * G_TIME_SPAN_SECOND;
+      g_array_append_val (files, cache_file);
+    }
+
+  g_dir_close (dir);
+  g_free (dir_name);
+
+  g_array_sort (files, cache_file_compare_newest_first);
+
+  now = g_get_real_time ();
+  for (i = 0; i < files->len; i++)
+    {
+      CacheFile *cache_file = &g_array_index (files, CacheFile, i);
+
+      if (i < CACHE_MAX_FILES && now - cache_file->mtime < CACHE_MAX_AGE)
+        continue;
+
+      GTK_DEBUG (CSS, "Deleting old CSS cache %s", cache_file->path);
+      g_remove (cache_file->path);
+    }
+
+  g_array_unref (files);
+}
+
+static void
+gtk_css_provider_save_cache (GtkCssProvider *self,
+                             GFile          *file,
+                             const char     *key)
+{
+  GtkCssProviderPrivate *priv = gtk_css_provider_get_instance_private (self);
+  GVariant *variant;
+  GError *error = NULL;
+  char *path;
+
+  if (priv->cache_blocked || priv->rulesets->len < CACHE_MIN_RULESETS)
+    return;
+
+  variant = gtk_css_provider_serialize (self, file);
+  if (variant == NULL)
+    return;
+
+  path = gtk_css_provider_get_cache_path (key, TRUE);
+  if (path &&
+      !g_file_set_contents (path,
+                            g_variant_get_data (variant),
+                            g_variant_get_size (variant),
+                            &error))
+    {
+      g_warning ("Failed to save CSS cache %s: %s", path, error->message);
+      g_error_free (error);
+    }
+
+  g_free (path);
+  g_variant_unref (variant);
+
+  gtk_css_provider_prune_cache ();
+}
+
+static gboolean
+gtk_css_provider_cache_check_imports (GVariant *imports)
+{
+  GVariantIter iter;
+  const char *uri, *expected;
+
+  g_variant_iter_init (&iter, imports);
+  while (g_variant_iter_next (&iter, "(&s&s)", &uri, &expected))
+    {
+      GFile *file;
+      GBytes *bytes;
+      char *checksum;
+      gboolean same;
+
+      file = g_file_new_for_uri (uri);
+      bytes = g_file_load_bytes (file, NULL, NULL, NULL);
+      g_object_unref (file);
+      if (bytes == NULL)
+        return FALSE;
+
+      checksum = g_compute_checksum_for_bytes (G_CHECKSUM_SHA256, bytes);
+      same = strcmp (checksum, expected) == 0;
+      g_free (checksum);
+      g_bytes_unref (bytes);
+
+      if (!same)
+        return FALSE;
+    }
+
+  return TRUE;
+}
+
+static gboolean
+gtk_css_provider_deserialize (GtkCssProvider *self,
+                              GFile          *file,
+                              GVariant       *variant)
+{
+  GtkCssProviderPrivate *priv = gtk_css_provider_get_instance_private (self);
+  GVariant *imports, *colors, *keyframes, *values, *blocks, *rulesets, *tree;
+  GtkCssValue **parsed_values = NULL;
+  GtkCssStyleProperty **properties = NULL;
+  gssize *block_owners = NULL;
+  GtkCssSelectorTree **selector_matches = NULL;
+  GBytes *tree_bytes = NULL;
+  const char **strings = NULL;
+  gsize n_values = 0, n_blocks, n_rulesets, n_strings;
+  GVariantIter iter;
+  const char *name, *text;
+  guint id;
+  gsize i, j;
+  gboolean result = FALSE;
+
+  g_variant_get (variant, "(@a(ss)@a(ss)@a(ss)^a&s@a(us)@aau@au@ay)",
+                 &imports, &colors, &keyframes, &strings, &values, &blocks, &rulesets, &tree);
+
+  if (!gtk_css_provider_cache_check_imports (imports))
+    goto out;
+
+  g_variant_iter_init (&iter, colors);
+  while (g_variant_iter_next (&iter, "(&s&s)", &name, &text))
+    {
+      GtkCssValue *color;
+
+      color = gtk_css_provider_cache_parse (file, text, parse_cached_color, NULL,
+                                            (GDestroyNotify) gtk_css_value_unref);
+      if (color == NULL)
+        goto out;
+
+      g_hash_table_insert (priv->symbolic_colors, g_strdup (name), color);
+    }
+
+  g_variant_iter_init (&iter, keyframes);
+  while (g_variant_iter_next (&iter, "(&s&s)", &name, &text))
+    {
+      GtkCssKeyframes *parsed;
+
+      parsed = gtk_css_provider_cache_parse (file, text, parse_cached_keyframes, NULL,
+                                             (GDestroyNotify) _gtk_css_keyframes_unref);
+      if (parsed == NULL)
+        goto out;
+
+      g_hash_table_insert (priv->keyframes, g_strdup (name), parsed);
+    }
+
+  parsed_values = g_new0 (GtkCssValue *, g_variant_n_children (values));
+  properties = g_new0 (GtkCssStyleProperty *, g_variant_n_children (values));
+  g_variant_iter_init (&iter, values);
+  while (g_variant_iter_next (&iter, "(u&s)", &id, &text))
+    {
+      if (id >= GTK_CSS_PROPERTY_N_PROPERTIES)
+        goto out;
+
+      properties[n_values] = _gtk_css_style_property_lookup_by_id (id);
+      parsed_values[n_values] = gtk_css_provider_cache_parse (file, text,
+                                                              parse_cached_value,
+                                                              properties[n_values],
+                                                              (GDestroyNotify) gtk_css_value_unref);
+      if (parsed_values[n_values] == NULL)
+        goto out;
+      n_values++;
+    }
+
+  n_blocks = g_variant_n_children (blocks);
+  block_owners = g_new (gssize, n_blocks);
+  for (i = 0; i < n_blocks; i++)
+    block_owners[i] = -1;
+
+  n_rulesets = g_variant_n_children (rulesets);
+  if (n_rulesets == 0)
+    goto out;
+
+  g_array_set_size (priv->rulesets, n_rulesets);
+  memset (priv->rulesets->data, 0, sizeof (GtkCssRuleset) * n_rulesets);
+
+  for (i = 0; i < n_rulesets; i++)
+    {
+      GtkCssRuleset *ruleset = &g_array_index (priv->rulesets, GtkCssRuleset, i);
+      guint block;
+
+      g_variant_get_child (rulesets, i, "u", &block);
+      if (block >= n_blocks)
+        goto out;
+
+      /* Rulesets from the same selector list share their styles */
+      if (block_owners[block] < 0)
+        {
+          GVariant *indexes = g_variant_get_child_value (blocks, block);
+          gsize n_styles = g_variant_n_children (indexes);
+          const guint32 *index = g_variant_get_fixed_array (indexes, &n_styles, sizeof (guint32));
+
+          ruleset->styles = g_new0 (PropertyValue, n_styles);
+          ruleset->n_styles = n_styles;
+          ruleset->owns_styles = TRUE;
+
+          for (j = 0; j < n_styles; j++)
+            {
+              if (index[j] >= n_values)
+                {
+                  g_variant_unref (indexes);
+                  goto out;
+                }
+
+              ruleset->styles[j].property = properties[index[j]];
+              ruleset->styles[j].value = gtk_css_value_ref (parsed_values[index[j]]);
+            }
+
+          g_variant_unref (indexes);
+          block_owners[block] = i;
+        }
+      else
+        {
+          GtkCssRuleset *owner = &g_array_index (priv->rulesets, GtkCssRuleset, block_owners[block]);
+
+          ruleset->styles = owner->styles;
+          ruleset->n_styles = owner->n_styles;
+        }
+    }
+
+  n_strings = g_strv_length ((char **) strings);
+  selector_matches = g_new (GtkCssSelectorTree *, n_rulesets);
+  tree_bytes = g_variant_get_data_as_bytes (tree);
+  priv->tree = gtk_css_selector_tree_deserialize (tree_bytes,
+                                                  strings,
+                                                  n_strings,
+                                                  priv->rulesets->data,
+                                                  sizeof (GtkCssRuleset),
+                                                  n_rulesets,
+                                                  selector_matches);
+  if (priv->tree == NULL)
+    goto out;
+
+  for (i = 0; i < n_rulesets; i++)
+    g_array_index (priv->rulesets, GtkCssRuleset, i).selector_match = selector_matches[i];
+
+  result = TRUE;
+
+out:
+  if (!result)
+    {
+      g_hash_table_remove_all (priv->symbolic_colors);
+      g_hash_table_remove_all (priv->keyframes);
+      for (i = 0; i < priv->rulesets->len; i++)
+        gtk_css_ruleset_clear (&g_array_index (priv->rulesets, GtkCssRuleset, i));
+      g_array_set_size (priv->rulesets, 0);
+    }
+
+  for (i = 0; i < n_values; i++)
+    gtk_css_value_unref (parsed_values[i]);
+  g_free (parsed_values);
+  g_free (properties);
+  g_free (block_owners);
+  g_free (selector_matches);
+  g_clear_pointer (&tree_bytes, g_bytes_unref);
+  g_free (strings);
+  g_variant_unref (imports);
+  g_variant_unref (colors);
+  g_variant_unref (keyframes);
+  g_variant_unref (values);
+  g_variant_unref (blocks);
+  g_variant_unref (rulesets);
+  g_variant_unref (tree);
+
+  return result;
+}
+
+static gboolean
+gtk_css_provider_load_cache (GtkCssProvider *self,
+                             GFile          *file,
+                             const char     *key)
+{
+  GMappedFile *mapped;
+  GVariant *variant;
+  GBytes *bytes;
+  char *path;
+  gboolean result;
+  gint64 before G_GNUC_UNUSED;
+
+  before = GDK_PROFILER_CURRENT_TIME;
+
+  path = gtk_css_provider_get_cache_path (key, FALSE);
+  mapped = g_mapped_file_new (path, FALSE, NULL);
+  if (mapped == NULL)
+    {
+      g_free (path);
+      return FALSE;
+    }
+
+  bytes = g_mapped_file_get_bytes (mapped);
+  variant = g_variant_new_from_bytes (G_VARIANT_TYPE (CACHE_VARIANT_TYPE), bytes, FALSE);
+  g_variant_ref_sink (variant);
+
+  result = gtk_css_provider_deserialize (self, file, variant);
+
+  if (result)
+    {
+      GTK_DEBUG (CSS, "Loaded style sheet from cache %s", path);
+      /* Mark it as used, see gtk_css_provider_prune_cache() */
+      g_utime (path, NULL);
+    }
+  else
+    GTK_DEBUG (CSS, "Ignoring outdated or broken CSS cache %s", path);
+
+  g_variant_unref (variant);
+  g_bytes_unref (bytes);
+  g_mapped_file_unref (mapped);
+  g_free (path);
+
+  gdk_profiler_end_mark (before, "Load CSS cache", NULL);
+
+  return result;
+}
+
 static void
 gtk_css_provider_load_internal (GtkCssProvider *self,
                                 GtkCssScanner  *parent,
@@ -1249,6 +1975,34 @@ gtk_css_provider_load_internal (GtkCssProvider *self,
   if (bytes)
     {
       GtkCssScanner *scanner;
+      char *cache_key = NULL;
+
+      if (parent == NULL)
+        {
+          cache_key = gtk_css_provider_get_cache_key (file, bytes);
+          if (cache_key && gtk_css_provider_load_cache (self, file, cache_key))
+            {
+              g_free (cache_key);
+              g_bytes_unref (bytes);
+              goto out;
+            }
+
+          if (cache_key)
+            {
+              priv->cache_imports = g_variant_builder_new (G_VARIANT_TYPE ("a(ss)"));
+              priv->cache_blocked = FALSE;
+            }
+        }
+      else if (priv->cache_imports && file)
+        {
+          char *uri = g_file_get_uri (file);
+          char *checksum = g_compute_checksum_for_bytes (G_CHECKSUM_SHA256, bytes);
+
+          g_variant_builder_add (priv->cache_imports, "(ss)", uri, checksum);
+
+          g_free (checksum);
+          g_free (uri);
+        }
 
       scanner = gtk_css_scanner_new (self,
                                      parent,
@@ -1260,11 +2014,21 @@ gtk_css_provider_load_internal (GtkCssProvider *self,
       gtk_css_scanner_destroy (scanner);
 
       if (parent == NULL)
-        gtk_css_provider_postprocess (self);
+        {
+          gtk_css_provider_postprocess (self);
+
+          if (cache_key)
+            {
+              gtk_css_provider_save_cache (self, file, cache_key);
+              g_clear_pointer (&priv->cache_imports, g_variant_builder_unref);
+              g_free (cache_key);
+            }
+        }
 
       g_bytes_unref (bytes);
     }
 
+out:
   if (GDK_PROFILER_IS_RUNNING)
     {
       const char *uri G_GNUC_UNUSED;
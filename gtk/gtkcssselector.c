@@ -24,6 +24,7 @@
 #include <string.h>
 
 #include "gtkcssprovider.h"
+#include "gtkprivate.h"
 
 #include <errno.h>
 #if defined(_MSC_VER) && _MSC_VER >= 1500
@@ -117,6 +118,7 @@ union _GtkCssSelector
 };
 
 #define GTK_CSS_SELECTOR_TREE_EMPTY_OFFSET G_MAXINT32
+#define GTK_CSS_SELECTOR_TREE_MAX_ANCESTOR_HASHES 3
 struct _GtkCssSelectorTree
 {
   GtkCssSelector selector;
@@ -124,8 +126,24 @@ struct _GtkCssSelectorTree
   gint32 previous_offset;
   gint32 sibling_offset;
   gint32 matches_offset; /* pointers that we return as matches if selector matches */
+  /* Bloom filter hashes that every selector going through this node needs
+   * when it is matched against an ancestor, see
+   * gtk_css_selector_tree_compute_ancestor_hashes() */
+  guint16 n_ancestor_hashes;
+  guint16 ancestor_hashes[GTK_CSS_SELECTOR_TREE_MAX_ANCESTOR_HASHES];
 };
 
+/* Statistics for GTK_DEBUG=css. Styles may be computed from
+ * several threads, so the counters are atomic.
+ */
+static struct {
+  int lookups;
+  int rejected;
+  int walks;
+  int ancestors;
+  gint64 last_report;
+} bloom_stats;
+
 static gboolean
 gtk_css_selector_equal (const GtkCssSelector *a,
 			const GtkCssSelector *b)
@@ -1869,6 +1887,22 @@ gtk_css_selectors_skip_initial_selector (GtkCssSelector *selector, const GtkCssS
  * be kept in sync with the definition of 'radical change' in gtkcssnode.c.
  */
 
+/* Checks the hashes that selectors through @tree need in the ancestors */
+static inline gboolean
+gtk_css_selector_tree_may_match_ancestors (const GtkCssSelectorTree     *tree,
+                                           const GtkCountingBloomFilter *filter)
+{
+  guint i;
+
+  for (i = 0; i < tree->n_ancestor_hashes; i++)
+    {
+      if (!gtk_counting_bloom_filter_may_contain (filter, tree->ancestor_hashes[i]))
+        return FALSE;
+    }
+
+  return TRUE;
+}
+
 static GtkCssChange
 gtk_css_selector_tree_get_change (const GtkCssSelectorTree     *tree,
                                   const GtkCountingBloomFilter *filter,
@@ -1913,7 +1947,13 @@ gtk_css_selector_tree_get_change (const GtkCssSelectorTree     *tree,
   for (prev = gtk_css_selector_tree_get_previous (tree);
        prev != NULL;
        prev = gtk_css_selector_tree_get_sibling (prev))
-    change |= gtk_css_selector_tree_get_change (prev, filter, node, skipping);
+    {
+      if (node == NULL && !skipping && filter &&
+          !gtk_css_selector_tree_may_match_ancestors (prev, filter))
+        continue;
+
+      change |= gtk_css_selector_tree_get_change (prev, filter, node, skipping);
+    }
 
   if (change || gtk_css_selector_tree_get_matches (tree))
     change = tree->selector.class->get_change (&tree->selector, change & ~GTK_CSS_CHANGE_GOT_MATCH) | GTK_CSS_CHANGE_GOT_MATCH;
@@ -1962,10 +2002,23 @@ gtk_css_selector_tree_match (const GtkCssSelectorTree      *tree,
        prev != NULL;
        prev = gtk_css_selector_tree_get_sibling (prev))
     {
+      /* Reject selectors needing ancestors we don't have before walking them */
+      if (match_filter && !gtk_css_selector_tree_may_match_ancestors (prev, filter))
+        {
+          g_atomic_int_inc (&bloom_stats.rejected);
+          continue;
+        }
+
+      if (filter && tree->selector.class->category == GTK_CSS_SELECTOR_CATEGORY_PARENT)
+        g_atomic_int_inc (&bloom_stats.walks);
+
       for (child = gtk_css_selector_iterator (&tree->selector, node, NULL);
            child;
            child = gtk_css_selector_iterator (&tree->selector, node, child))
         {
+          if (filter && tree->selector.class->category == GTK_CSS_SELECTOR_CATEGORY_PARENT)
+            g_atomic_int_inc (&bloom_stats.ancestors);
+
           if (!gtk_css_selector_tree_match (prev, filter, match_filter, child, results))
             break;
         }
@@ -1982,6 +2035,9 @@ _gtk_css_selector_tree_match_all (const GtkCssSelectorTree     *tree,
 {
   const GtkCssSelectorTree *iter;
 
+  if (filter)
+    g_atomic_int_inc (&bloom_stats.lookups);
+
   for (iter = tree;
        iter != NULL;
        iter = gtk_css_selector_tree_get_sibling (iter))
@@ -1990,6 +2046,38 @@ _gtk_css_selector_tree_match_all (const GtkCssSelectorTree     *tree,
     }
 }
 
+/*<private>
+ * gtk_css_selector_tree_report_statistics:
+ *
+ * Prints how well the bloom filter avoided walking ancestors
+ * during selector matching, if CSS debugging is enabled.
+ *
+ * To keep the output readable, this prints at most once a second.
+ */
+void
+gtk_css_selector_tree_report_statistics (void)
+{
+  gint64 now;
+  int lookups, rejected, walks, ancestors;
+
+  if (!GTK_DEBUG_CHECK (CSS) || g_atomic_int_get (&bloom_stats.lookups) == 0)
+    return;
+
+  now = g_get_monotonic_time ();
+  if (now - bloom_stats.last_report < G_USEC_PER_SEC)
+    return;
+
+  lookups = g_atomic_int_exchange (&bloom_stats.lookups, 0);
+  rejected = g_atomic_int_exchange (&bloom_stats.rejected, 0);
+  walks = g_atomic_int_exchange (&bloom_stats.walks, 0);
+  ancestors = g_atomic_int_exchange (&bloom_stats.ancestors, 0);
+  bloom_stats.last_report = now;
+
+  gdk_debug_message ("CSS selector matching: %d lookups, %d subtrees rejected by bloom filter, "
+                     "%d ancestor walks visiting %d nodes",
+                     lookups, rejected, walks, ancestors);
+}
+
 gboolean
 _gtk_css_selector_tree_is_empty (const GtkCssSelectorTree *tree)
 {
@@ -2295,6 +2383,57 @@ _gtk_css_selector_tree_builder_add (GtkCssSelectorTreeBuilder *builder,
   info->selector_match = selector_match;
 }
 
+static void
+gtk_css_selector_tree_add_ancestor_hash (GtkCssSelectorTree *tree,
+                                         guint16             hash)
+{
+  guint i;
+
+  if (tree->n_ancestor_hashes == GTK_CSS_SELECTOR_TREE_MAX_ANCESTOR_HASHES)
+    return;
+
+  for (i = 0; i < tree->n_ancestor_hashes; i++)
+    {
+      if (tree->ancestor_hashes[i] == hash)
+        return;
+    }
+
+  tree->ancestor_hashes[tree->n_ancestor_hashes++] = hash;
+}
+
+/* When a node is matched against an ancestor of the styled node, its
+ * name, id and classes must be in the bloom filter of ancestors. That
+ * is also true for all nodes that follow as long as no sibling
+ * combinator intervenes. So we collect those hashes for as long as
+ * the tree does not branch and no selector ends.
+ */
+static void
+gtk_css_selector_tree_compute_ancestor_hashes (GtkCssSelectorTree *tree)
+{
+  for (; tree != NULL; tree = (GtkCssSelectorTree *) gtk_css_selector_tree_get_sibling (tree))
+    {
+      GtkCssSelectorTree *prev = (GtkCssSelectorTree *) gtk_css_selector_tree_get_previous (tree);
+      guint i;
+
+      if (prev)
+        gtk_css_selector_tree_compute_ancestor_hashes (prev);
+
+      tree->n_ancestor_hashes = 0;
+
+      if (tree->selector.class->category == GTK_CSS_SELECTOR_CATEGORY_SIMPLE_RADICAL)
+        gtk_css_selector_tree_add_ancestor_hash (tree, gtk_css_selector_hash_one (&tree->selector));
+
+      if (prev == NULL ||
+          gtk_css_selector_tree_get_sibling (prev) != NULL ||
+          tree->matches_offset != GTK_CSS_SELECTOR_TREE_EMPTY_OFFSET ||
+          tree->selector.class->category == GTK_CSS_SELECTOR_CATEGORY_SIBLING)
+        continue;
+
+      for (i = 0; i < prev->n_ancestor_hashes; i++)
+        gtk_css_selector_tree_add_ancestor_hash (tree, prev->ancestor_hashes[i]);
+    }
+}
+
 /* Convert all offsets to node-relative */
 static void
 fixup_offsets (GtkCssSelectorTree *tree, guint8 *data)
@@ -2346,6 +2485,7 @@ _gtk_css_selector_tree_builder_build (GtkCssSelectorTreeBuilder *builder)
   tree = (GtkCssSelectorTree *)data;
 
   fixup_offsets (tree, data);
+  gtk_css_selector_tree_compute_ancestor_hashes (tree);
 
   /* Convert offsets to final pointers */
   for (i = 0; i < builder->infos->len; i++)
@@ -2368,3 +2508,418 @@ _gtk_css_selector_tree_builder_build (GtkCssSelectorTreeBuilder *builder)
 
   return tree;
 }
+
+/* SERIALIZATION */
+
+/* The tree is a single block of memory using relative offsets, so it
+ * can be written out as is. Only the class pointers, the quarks and the
+ * match pointers need to be converted to indexes and back.
+ */
+
+static const GtkCssSelectorClass * const selector_classes[] = {
+  &GTK_CSS_SELECTOR_DESCENDANT,
+  &GTK_CSS_SELECTOR_CHILD,
+  &GTK_CSS_SELECTOR_SIBLING,
+  &GTK_CSS_SELECTOR_ADJACENT,
+  &GTK_CSS_SELECTOR_ANY,
+  &GTK_CSS_SELECTOR_NOT_ANY,
+  &GTK_CSS_SELECTOR_NAME,
+  &GTK_CSS_SELECTOR_NOT_NAME,
+  &GTK_CSS_SELECTOR_CLASS,
+  &GTK_CSS_SELECTOR_NOT_CLASS,
+  &GTK_CSS_SELECTOR_ID,
+  &GTK_CSS_SELECTOR_NOT_ID,
+  &GTK_CSS_SELECTOR_PSEUDOCLASS_STATE,
+  &GTK_CSS_SELECTOR_NOT_PSEUDOCLASS_STATE,
+  &GTK_CSS_SELECTOR_PSEUDOCLASS_POSITION,
+  &GTK_CSS_SELECTOR_NOT_PSEUDOCLASS_POSITION,
+  &GTK_CSS_SELECTOR_PSEUDOCLASS_ROOT,
+  &GTK_CSS_SELECTOR_NOT_PSEUDOCLASS_ROOT,
+};
+
+#define SERIALIZE_MAX_DEPTH 1024
+
+static guint
+gtk_css_selector_class_get_index (const GtkCssSelectorClass *class)
+{
+  guint i;
+
+  for (i = 0; i < G_N_ELEMENTS (selector_classes); i++)
+    {
+      if (selector_classes[i] == class)
+        return i;
+    }
+
+  g_assert_not_reached ();
+  return 0;
+}
+
+static GQuark *
+gtk_css_selector_get_quark (GtkCssSelector            *selector,
+                            const GtkCssSelectorClass *class)
+{
+  if (class == &GTK_CSS_SELECTOR_NAME || class == &GTK_CSS_SELECTOR_NOT_NAME)
+    return &selector->name.name;
+  else if (class == &GTK_CSS_SELECTOR_CLASS || class == &GTK_CSS_SELECTOR_NOT_CLASS)
+    return &selector->style_class.style_class;
+  else if (class == &GTK_CSS_SELECTOR_ID || class == &GTK_CSS_SELECTOR_NOT_ID)
+    return &selector->id.name;
+  else
+    return NULL;
+}
+
+static gsize
+gtk_css_selector_tree_get_extent (const GtkCssSelectorTree *tree,
+                                  const guint8             *base)
+{
+  gsize extent = 0;
+
+  for (; tree != NULL; tree = gtk_css_selector_tree_get_sibling (tree))
+    {
+      gpointer *matches;
+      const GtkCssSelectorTree *prev;
+
+      extent = MAX (extent, (const guint8 *) (tree + 1) - base);
+
+      matches = gtk_css_selector_tree_get_matches (tree);
+      if (matches)
+        {
+          gsize n;
+
+          for (n = 0; matches[n] != NULL; n++) ;
+          extent = MAX (extent, (const guint8 *) (matches + n + 1) - base);
+        }
+
+      prev = gtk_css_selector_tree_get_previous (tree);
+      if (prev)
+        extent = MAX (extent, gtk_css_selector_tree_get_extent (prev, base));
+    }
+
+  return extent;
+}
+
+typedef struct {
+  const guint8 *base;
+  guint8 *data;
+  const guint8 *matches;
+  gsize match_size;
+  GHashTable *string_indexes;
+  GPtrArray *strings;
+} SerializeData;
+
+/* Writes the nodes of @tree to data->data field by field, so that
+ * padding and unused union members stay zeroed and the file contents
+ * only depend on the style sheet.
+ */
+static void
+gtk_css_selector_tree_serialize_nodes (const GtkCssSelectorTree *tree,
+                                       SerializeData            *data)
+{
+  for (; tree != NULL; tree = gtk_css_selector_tree_get_sibling (tree))
+    {
+      const GtkCssSelectorClass *class = tree->selector.class;
+      GtkCssSelectorTree *copy;
+      gpointer *matches;
+      GQuark *quark;
+
+      copy = (GtkCssSelectorTree *) (data->data + ((const guint8 *) tree - data->base));
+
+      copy->selector.class = GUINT_TO_POINTER (gtk_css_selector_class_get_index (class));
+
+      quark = gtk_css_selector_get_quark (&copy->selector, class);
+      if (quark)
+        {
+          GQuark value = *gtk_css_selector_get_quark ((GtkCssSelector *) &tree->selector, class);
+          gpointer index;
+
+          if (!g_hash_table_lookup_extended (data->string_indexes, GUINT_TO_POINTER (value), NULL, &index))
+            {
+              index = GUINT_TO_POINTER (data->strings->len);
+              g_ptr_array_add (data->strings, (gpointer) g_quark_to_string (value));
+              g_hash_table_insert (data->string_indexes, GUINT_TO_POINTER (value), index);
+            }
+
+          *quark = GPOINTER_TO_UINT (index);
+        }
+      else if (class == &GTK_CSS_SELECTOR_PSEUDOCLASS_STATE ||
+               class == &GTK_CSS_SELECTOR_NOT_PSEUDOCLASS_STATE)
+        {
+          copy->selector.state.state = tree->selector.state.state;
+        }
+      else if (class == &GTK_CSS_SELECTOR_PSEUDOCLASS_POSITION ||
+               class == &GTK_CSS_SELECTOR_NOT_PSEUDOCLASS_POSITION)
+        {
+          copy->selector.position.type = tree->selector.position.type;
+          copy->selector.position.a = tree->selector.position.a;
+          copy->selector.position.b = tree->selector.position.b;
+        }
+
+      copy->parent_offset = tree->parent_offset;
+      copy->previous_offset = tree->previous_offset;
+      copy->sibling_offset = tree->sibling_offset;
+      copy->matches_offset = tree->matches_offset;
+      /* The ancestor hashes depend on the quarks, they are computed
+       * again when loading.
+       */
+
+      matches = gtk_css_selector_tree_get_matches (tree);
+      if (matches)
+        {
+          gpointer *copy_matches;
+          gsize i;
+
+          copy_matches = (gpointer *) (data->data + ((guint8 *) matches - data->base));
+          for (i = 0; matches[i] != NULL; i++)
+            {
+              gsize index = ((const guint8 *) matches[i] - data->matches) / data->match_size;
+
+              copy_matches[i] = GSIZE_TO_POINTER (index + 1);
+            }
+        }
+
+      if (gtk_css_selector_tree_get_previous (tree))
+        gtk_css_selector_tree_serialize_nodes (gtk_css_selector_tree_get_previous (tree), data);
+    }
+}
+
+/*<private>
+ * gtk_css_selector_tree_serialize:
+ * @tree: the tree to serialize
+ * @matches: the array holding all match pointers passed to the builder
+ * @match_size: size of the elements of @matches
+ * @strings: array to append the strings used by the tree to
+ *
+ * Converts @tree into a form that can be stored on disk and loaded with
+ * gtk_css_selector_tree_deserialize() in the same GTK build.
+ *
+ * All matches added to the tree must point into the @matches array.
+ *
+ * Returns: the serialized tree
+ */
+GBytes *
+gtk_css_selector_tree_serialize (const GtkCssSelectorTree *tree,
+                                 gconstpointer             matches,
+                                 gsize                     match_size,
+                                 GPtrArray                *strings)
+{
+  SerializeData data;
+  gsize size;
+
+  g_return_val_if_fail (tree != NULL, NULL);
+
+  size = gtk_css_selector_tree_get_extent (tree, (const guint8 *) tree);
+
+  data.base = (const guint8 *) tree;
+  data.data = g_malloc0 (size);
+  data.matches = matches;
+  data.match_size = match_size;
+  data.string_indexes = g_hash_table_new (NULL, NULL);
+  data.strings = strings;
+
+  gtk_css_selector_tree_serialize_nodes (tree, &data);
+
+  g_hash_table_unref (data.string_indexes);
+
+  return g_bytes_new_take (data.data, size);
+}
+
+typedef struct {
+  guint8 *data;
+  gsize size;
+  guint *used;
+  const char * const *strings;
+  gsize n_strings;
+  guint8 *matches;
+  gsize match_size;
+  gsize n_matches;
+  GtkCssSelectorTree **selector_matches;
+} DeserializeData;
+
+/* Marks the words in [offset, offset + size) as used, fails on overlap */
+static gboolean
+deserialize_claim (DeserializeData *data,
+                   gsize            offset,
+                   gsize            size)
+{
+  gsize i;
+
+  if (offset % sizeof (gpointer) != 0 ||
+      offset > data->size ||
+      size > data->size - offset)
+    return FALSE;
+
+  for (i = offset / sizeof (gpointer); i < (offset + size) / sizeof (gpointer); i++)
+    {
+      if (data->used[i / 32] & (1u << (i % 32)))
+        return FALSE;
+      data->used[i / 32] |= 1u << (i % 32);
+    }
+
+  return TRUE;
+}
+
+static gboolean
+gtk_css_selector_tree_deserialize_nodes (DeserializeData *data,
+                                         gsize            offset,
+                                         gsize            parent,
+                                         guint            depth)
+{
+  if (depth > SERIALIZE_MAX_DEPTH)
+    return FALSE;
+
+  while (TRUE)
+    {
+      GtkCssSelectorTree *tree;
+      const GtkCssSelectorClass *class;
+      guint class_index;
+      GQuark *quark;
+
+      if (!deserialize_claim (data, offset, sizeof (GtkCssSelectorTree)))
+        return FALSE;
+
+      tree = (GtkCssSelectorTree *) (data->data + offset);
+
+      class_index = GPOINTER_TO_UINT (tree->selector.class);
+      if (class_index >= G_N_ELEMENTS (selector_classes))
+        return FALSE;
+      class = selector_classes[class_index];
+      tree->selector.class = class;
+
+      quark = gtk_css_selector_get_quark (&tree->selector, class);
+      if (quark)
+        {
+          if (*quark >= data->n_strings)
+            return FALSE;
+          *quark = g_quark_from_string (data->strings[*quark]);
+        }
+
+      if ((class == &GTK_CSS_SELECTOR_PSEUDOCLASS_POSITION ||
+           class == &GTK_CSS_SELECTOR_NOT_PSEUDOCLASS_POSITION) &&
+          tree->selector.position.type > POSITION_ONLY)
+        return FALSE;
+
+      if (parent == GTK_CSS_SELECTOR_TREE_EMPTY_OFFSET)
+        {
+          if (tree->parent_offset != GTK_CSS_SELECTOR_TREE_EMPTY_OFFSET)
+            return FALSE;
+        }
+      else if (tree->parent_offset == GTK_CSS_SELECTOR_TREE_EMPTY_OFFSET ||
+               (gssize) offset + tree->parent_offset != (gssize) parent)
+        return FALSE;
+
+      if (tree->matches_offset != GTK_CSS_SELECTOR_TREE_EMPTY_OFFSET)
+        {
+          gpointer *matches;
+          gsize matches_offset, i;
+
+          if (tree->matches_offset <= 0)
+            return FALSE;
+
+          matches_offset = offset + tree->matches_offset;
+          matches = (gpointer *) (data->data + matches_offset);
+
+          for (i = 0; ; i++)
+            {
+              gsize index;
+
+              if (!deserialize_claim (data, matches_offset + i * sizeof (gpointer), sizeof (gpointer)))
+                return FALSE;
+
+              index = GPOINTER_TO_SIZE (matches[i]);
+              if (index == 0)
+                break;
+              if (index > data->n_matches)
+                return FALSE;
+
+              matches[i] = data->matches + (index - 1) * data->match_size;
+              data->selector_matches[index - 1] = tree;
+            }
+        }
+
+      if (tree->previous_offset != GTK_CSS_SELECTOR_TREE_EMPTY_OFFSET)
+        {
+          if (tree->previous_offset <= 0 ||
+              !gtk_css_selector_tree_deserialize_nodes (data, offset + tree->previous_offset, offset, depth + 1))
+            return FALSE;
+        }
+
+      if (tree->sibling_offset == GTK_CSS_SELECTOR_TREE_EMPTY_OFFSET)
+        break;
+
+      if (tree->sibling_offset <= 0)
+        return FALSE;
+
+      offset += tree->sibling_offset;
+    }
+
+  return TRUE;
+}
+
+/*<private>
+ * gtk_css_selector_tree_deserialize:
+ * @bytes: data returned by gtk_css_selector_tree_serialize()
+ * @strings: (array length=n_strings): the strings that were collected
+ *   by gtk_css_selector_tree_serialize()
+ * @n_strings: number of strings
+ * @matches: the array to point the matches into
+ * @match_size: size of the elements of @matches
+ * @n_matches: number of elements in @matches
+ * @selector_matches: (array length=n_matches) (out caller-allocates): returns
+ *   the tree node matching each element of @matches
+ *
+ * Recreates a tree serialized with gtk_css_selector_tree_serialize().
+ *
+ * The data is validated, so it is safe to pass data read from
+ * a file. If it is not valid, %NULL is returned.
+ *
+ * Returns: (nullable): the tree
+ */
+GtkCssSelectorTree *
+gtk_css_selector_tree_deserialize (GBytes              *bytes,
+                                   const char * const  *strings,
+                                   gsize                n_strings,
+                                   gpointer             matches,
+                                   gsize                match_size,
+                                   gsize                n_matches,
+                                   GtkCssSelectorTree **selector_matches)
+{
+  DeserializeData data;
+  gsize i;
+
+  data.size = g_bytes_get_size (bytes);
+  if (data.size < sizeof (GtkCssSelectorTree) ||
+      data.size % sizeof (gpointer) != 0)
+    return NULL;
+
+  data.data = g_memdup2 (g_bytes_get_data (bytes, NULL), data.size);
+  data.used = g_new0 (guint, (data.size / sizeof (gpointer) + 31) / 32);
+  data.strings = strings;
+  data.n_strings = n_strings;
+  data.matches = matches;
+  data.match_size = match_size;
+  data.n_matches = n_matches;
+  data.selector_matches = selector_matches;
+
+  memset (selector_matches, 0, sizeof (GtkCssSelectorTree *) * n_matches);
+
+  if (!gtk_css_selector_tree_deserialize_nodes (&data, 0, GTK_CSS_SELECTOR_TREE_EMPTY_OFFSET, 0))
+    goto fail;
+
+  for (i = 0; i < n_matches; i++)
+    {
+      if (selector_matches[i] == NULL)
+        goto fail;
+    }
+
+  /* The hashes depend on the quarks */
+  gtk_css_selector_tree_compute_ancestor_hashes ((GtkCssSelectorTree *) data.data);
+
+  g_free (data.used);
+
+  return (GtkCssSelectorTree *) data.data;
+
+fail:
+  g_free (data.used);
+  g_free (data.data);
+  return NULL;
+}
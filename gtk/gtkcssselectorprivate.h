@@ -59,6 +59,20 @@ GtkCssChange gtk_css_selector_tree_get_change_all    (const GtkCssSelectorTree *
 void         _gtk_css_selector_tree_match_print      (const GtkCssSelectorTree *tree,
 						      GString                  *str);
 gboolean     _gtk_css_selector_tree_is_empty         (const GtkCssSelectorTree *tree) G_GNUC_CONST;
+void         gtk_css_selector_tree_report_statistics (void);
+
+GBytes *     gtk_css_selector_tree_serialize         (const GtkCssSelectorTree *tree,
+                                                      gconstpointer             matches,
+                                                      gsize                     match_size,
+                                                      GPtrArray                *strings);
+GtkCssSelectorTree *
+             gtk_css_selector_tree_deserialize       (GBytes                   *bytes,
+                                                      const char * const       *strings,
+                                                      gsize                     n_strings,
+                                                      gpointer                  matches,
+                                                      gsize                     match_size,
+                                                      gsize                     n_matches,
+                                                      GtkCssSelectorTree      **selector_matches);
 
 
 
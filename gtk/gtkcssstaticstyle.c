@@ -39,6 +39,8 @@
 #include "gtkstyleproviderprivate.h"
 #include "gtkcssdimensionvalueprivate.h"
 
+#include <stdlib.h>
+
 
 static void gtk_css_static_style_compute_value (GtkCssStaticStyle    *style,
                                                 guint                 id,
@@ -204,11 +206,15 @@ gtk_css_static_style_get_section (GtkCssStyle *style,
   return g_ptr_array_index (sstyle->sections, id);
 }
 
+static void gtk_css_style_store_remove (GtkCssStaticStyle *style);
+
 static void
 gtk_css_static_style_dispose (GObject *object)
 {
   GtkCssStaticStyle *style = GTK_CSS_STATIC_STYLE (object);
 
+  gtk_css_style_store_remove (style);
+
   if (style->sections)
     {
       g_ptr_array_unref (style->sections);
@@ -986,6 +992,339 @@ resolve:
     }
 }
 
+/* The style store
+ *
+ * A computed style only depends on the declarations that won the
+ * lookup, the parent style and the provider. So nodes that resolve
+ * to the same of those can share one style, no matter where they
+ * are in the tree. This is the case for the rows and cells of long
+ * lists, which the per-parent GtkCssNodeStyleCache can't help with,
+ * because every row has its own parent.
+ *
+ * The store does not keep styles alive: styles remove themselves
+ * when they are finalized. It is cleared whenever a style provider
+ * changes, because that may change the outcome of computing values.
+ */
+
+typedef struct {
+  guint id;
+  gpointer value;
+  GtkCssSection *section;
+} GtkCssStyleStoreItem;
+
+struct _GtkCssStyleStoreKey
+{
+  guint hash;
+  GtkStyleProvider *provider;
+  GtkCssStyle *parent;
+  GtkCssChange change;
+  guint n_values;
+  guint n_custom;
+  gboolean owns_references;
+  GtkCssStyleStoreItem items[];
+};
+
+static GHashTable *style_store;
+
+static struct {
+  guint hits;
+  guint misses;
+  gint64 last_report;
+} style_store_stats;
+
+static guint
+gtk_css_style_store_key_hash (gconstpointer data)
+{
+  const GtkCssStyleStoreKey *key = data;
+
+  return key->hash;
+}
+
+static gboolean
+gtk_css_style_store_key_equal (gconstpointer data1,
+                               gconstpointer data2)
+{
+  const GtkCssStyleStoreKey *key1 = data1;
+  const GtkCssStyleStoreKey *key2 = data2;
+  guint i;
+
+  if (key1->hash != key2->hash ||
+      key1->provider != key2->provider ||
+      key1->parent != key2->parent ||
+      key1->change != key2->change ||
+      key1->n_values != key2->n_values ||
+      key1->n_custom != key2->n_custom)
+    return FALSE;
+
+  for (i = 0; i < key1->n_values + key1->n_custom; i++)
+    {
+      if (key1->items[i].id != key2->items[i].id ||
+          key1->items[i].value != key2->items[i].value ||
+          key1->items[i].section != key2->items[i].section)
+        return FALSE;
+    }
+
+  return TRUE;
+}
+
+static int
+compare_store_items (gconstpointer a,
+                     gconstpointer b)
+{
+  const GtkCssStyleStoreItem *item1 = a;
+  const GtkCssStyleStoreItem *item2 = b;
+
+  return item1->id < item2->id ? -1 : (item1->id > item2->id);
+}
+
+/* The key does not hold references yet, so it can be used for lookups */
+static GtkCssStyleStoreKey *
+gtk_css_style_store_key_new (GtkStyleProvider   *provider,
+                             GtkCssStyle        *parent,
+                             GtkCssChange        change,
+                             const GtkCssLookup *lookup)
+{
+  GtkCssStyleStoreKey *key;
+  guint n_values, n_custom, i, n;
+  guint hash;
+
+  n_values = 0;
+  for (i = 0; i < GTK_CSS_PROPERTY_N_PROPERTIES; i++)
+    {
+      if (lookup->values[i].value)
+        n_values++;
+    }
+  n_custom = lookup->custom_values ? g_hash_table_size (lookup->custom_values) : 0;
+
+  key = g_malloc0 (sizeof (GtkCssStyleStoreKey) + (n_values + n_custom) * sizeof (GtkCssStyleStoreItem));
+  key->provider = provider;
+  key->parent = parent;
+  key->change = change;
+  key->n_values = n_values;
+  key->n_custom = n_custom;
+
+  n = 0;
+  for (i = 0; i < GTK_CSS_PROPERTY_N_PROPERTIES; i++)
+    {
+      if (lookup->values[i].value == NULL)
+        continue;
+
+      key->items[n].id = i;
+      key->items[n].value = lookup->values[i].value;
+      key->items[n].section = lookup->values[i].section;
+      n++;
+    }
+
+  if (n_custom)
+    {
+      GHashTableIter iter;
+      gpointer id, value;
+
+      g_hash_table_iter_init (&iter, lookup->custom_values);
+      while (g_hash_table_iter_next (&iter, &id, &value))
+        {
+          key->items[n].id = GPOINTER_TO_UINT (id);
+          key->items[n].value = value;
+          n++;
+        }
+
+      /* hash table order is arbitrary */
+      qsort (key->items + n_values, n_custom, sizeof (GtkCssStyleStoreItem), compare_store_items);
+    }
+
+  hash = g_direct_hash (provider);
+  hash = hash * 31 + g_direct_hash (parent);
+  hash = hash * 31 + (guint) (change ^ (change >> 32));
+  for (i = 0; i < n_values + n_custom; i++)
+    {
+      hash = hash * 31 + key->items[i].id;
+      hash = hash * 31 + g_direct_hash (key->items[i].value);
+      hash = hash * 31 + g_direct_hash (key->items[i].section);
+    }
+  key->hash = hash;
+
+  return key;
+}
+
+/* Once a key is stored, the things it points to must stay alive,
+ * so their addresses can't be reused by something else.
+ */
+static void
+gtk_css_style_store_key_take_references (GtkCssStyleStoreKey *key)
+{
+  guint i;
+
+  g_object_ref (key->provider);
+  if (key->parent)
+    g_object_ref (key->parent);
+
+  for (i = 0; i < key->n_values; i++)
+    {
+      gtk_css_value_ref (key->items[i].value);
+      if (key->items[i].section)
+        gtk_css_section_ref (key->items[i].section);
+    }
+
+  for (i = key->n_values; i < key->n_values + key->n_custom; i++)
+    gtk_css_variable_value_ref (key->items[i].value);
+
+  key->owns_references = TRUE;
+}
+
+static void
+gtk_css_style_store_key_free (GtkCssStyleStoreKey *key)
+{
+  guint i;
+
+  if (key->owns_references)
+    {
+      g_object_unref (key->provider);
+      if (key->parent)
+        g_object_unref (key->parent);
+
+      for (i = 0; i < key->n_values; i++)
+        {
+          gtk_css_value_unref (key->items[i].value);
+          if (key->items[i].section)
+            gtk_css_section_unref (key->items[i].section);
+        }
+
+      for (i = key->n_values; i < key->n_values + key->n_custom; i++)
+        gtk_css_variable_value_unref (key->items[i].value);
+    }
+
+  g_free (key);
+}
+
+static gboolean
+gtk_css_style_store_is_enabled (GtkCssStyle *parent)
+{
+  /* GTK_DEBUG=no-css-cache disables all caching */
+  if (GTK_DEBUG_CHECK (NO_CSS_CACHE))
+    return FALSE;
+
+  /* Animated parents are replaced every frame, so their
+   * children would never be shared.
+   */
+  if (parent && !GTK_IS_CSS_STATIC_STYLE (parent))
+    return FALSE;
+
+  return TRUE;
+}
+
+static void
+gtk_css_style_store_insert (GtkCssStaticStyle   *style,
+                            GtkCssStyleStoreKey *key)
+{
+  if (style_store == NULL)
+    style_store = g_hash_table_new (gtk_css_style_store_key_hash,
+                                    gtk_css_style_store_key_equal);
+
+  gtk_css_style_store_key_take_references (key);
+  style->store_key = key;
+  g_hash_table_insert (style_store, key, style);
+}
+
+static void
+gtk_css_style_store_remove (GtkCssStaticStyle *style)
+{
+  if (style->store_key == NULL)
+    return;
+
+  g_hash_table_remove (style_store, style->store_key);
+  g_clear_pointer (&style->store_key, gtk_css_style_store_key_free);
+}
+
+/*<private>
+ * gtk_css_static_style_store_clear:
+ *
+ * Removes all styles from the style store, so that new styles
+ * get computed from scratch.
+ *
+ * This must be called when a style provider changes.
+ */
+void
+gtk_css_static_style_store_clear (void)
+{
+  GHashTable *store;
+  GHashTableIter iter;
+  gpointer style;
+  GPtrArray *keys;
+
+  if (style_store == NULL)
+    return;
+
+  /* Freeing a key drops references to parent styles, which may get
+   * finalized and remove themselves from the store. So take the styles
+   * out of the store before freeing anything.
+   */
+  store = g_steal_pointer (&style_store);
+  keys = g_ptr_array_new_full (g_hash_table_size (store),
+                               (GDestroyNotify) gtk_css_style_store_key_free);
+
+  g_hash_table_iter_init (&iter, store);
+  while (g_hash_table_iter_next (&iter, NULL, &style))
+    g_ptr_array_add (keys, g_steal_pointer (&GTK_CSS_STATIC_STYLE (style)->store_key));
+
+  g_hash_table_unref (store);
+  g_ptr_array_unref (keys);
+}
+
+/*<private>
+ * gtk_css_static_style_get_store_statistics:
+ * @hits: (out) (optional): return location for the number of shared styles
+ * @misses: (out) (optional): return location for the number of computed styles
+ *
+ * Returns how often gtk_css_static_style_new_compute() found a style
+ * in the style store since the last call to this function, and resets
+ * the counters.
+ *
+ * Returns: the number of styles in the store
+ */
+guint
+gtk_css_static_style_get_store_statistics (guint *hits,
+                                           guint *misses)
+{
+  if (hits)
+    *hits = style_store_stats.hits;
+  if (misses)
+    *misses = style_store_stats.misses;
+
+  style_store_stats.hits = 0;
+  style_store_stats.misses = 0;
+
+  return style_store ? g_hash_table_size (style_store) : 0;
+}
+
+/*<private>
+ * gtk_css_static_style_report_statistics:
+ *
+ * Prints the hit rate of the style store if CSS debugging is enabled,
+ * at most once a second.
+ */
+void
+gtk_css_static_style_report_statistics (void)
+{
+  guint hits, misses, size;
+  gint64 now;
+
+  if (!GTK_DEBUG_CHECK (CSS))
+    return;
+
+  if (style_store_stats.hits + style_store_stats.misses == 0)
+    return;
+
+  now = g_get_monotonic_time ();
+  if (now - style_store_stats.last_report < G_USEC_PER_SEC)
+    return;
+
+  size = gtk_css_static_style_get_store_statistics (&hits, &misses);
+  gdk_debug_message ("CSS style store: %u hits, %u misses (%.1f%% hit rate), %u styles",
+                     hits, misses, 100.0 * hits / (hits + misses), size);
+
+  style_store_stats.last_report = now;
+}
+
 GtkCssStyle *
 gtk_css_static_style_new_compute (GtkStyleProvider             *provider,
                                   const GtkCountingBloomFilter *filter,
@@ -995,6 +1334,8 @@ gtk_css_static_style_new_compute (GtkStyleProvider             *provider,
   GtkCssStaticStyle *result;
   GtkCssLookup lookup;
   GtkCssNode *parent;
+  GtkCssStyle *parent_style;
+  GtkCssStyleStoreKey *key = NULL;
 
   _gtk_css_lookup_init (&lookup);
 
@@ -1005,19 +1346,41 @@ gtk_css_static_style_new_compute (GtkStyleProvider             *provider,
                                &lookup,
                                change == 0 ? &change : NULL);
 
-  result = g_object_new (GTK_TYPE_CSS_STATIC_STYLE, NULL);
-
-  result->change = change;
-
   if (node)
     parent = gtk_css_node_get_parent (node);
   else
     parent = NULL;
 
+  parent_style = parent ? gtk_css_node_get_style (parent) : NULL;
+
+  if (node && gtk_css_style_store_is_enabled (parent_style))
+    {
+      key = gtk_css_style_store_key_new (provider, parent_style, change, &lookup);
+
+      result = style_store ? g_hash_table_lookup (style_store, key) : NULL;
+      if (result)
+        {
+          style_store_stats.hits++;
+          gtk_css_style_store_key_free (key);
+          _gtk_css_lookup_destroy (&lookup);
+
+          return g_object_ref (GTK_CSS_STYLE (result));
+        }
+
+      style_store_stats.misses++;
+    }
+
+  result = g_object_new (GTK_TYPE_CSS_STATIC_STYLE, NULL);
+
+  result->change = change;
+
   gtk_css_lookup_resolve (&lookup,
                           provider,
                           result,
-                          parent ? gtk_css_node_get_style (parent) : NULL);
+                          parent_style);
+
+  if (key)
+    gtk_css_style_store_insert (result, key);
 
   _gtk_css_lookup_destroy (&lookup);
 
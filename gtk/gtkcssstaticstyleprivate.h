@@ -33,6 +33,7 @@ G_BEGIN_DECLS
 #define GTK_CSS_STATIC_STYLE_GET_CLASS(obj) (G_TYPE_INSTANCE_GET_CLASS ((obj), GTK_TYPE_CSS_STATIC_STYLE, GtkCssStaticStyleClass))
 
 typedef struct _GtkCssStaticStyleClass      GtkCssStaticStyleClass;
+typedef struct _GtkCssStyleStoreKey         GtkCssStyleStoreKey;
 
 
 struct _GtkCssStaticStyle
@@ -43,6 +44,8 @@ struct _GtkCssStaticStyle
   GPtrArray             *original_values;
 
   GtkCssChange           change;               /* change as returned by value lookup */
+
+  GtkCssStyleStoreKey   *store_key;            /* key in the shared style store or NULL */
 };
 
 struct _GtkCssStaticStyleClass
@@ -59,5 +62,10 @@ GtkCssStyle *           gtk_css_static_style_new_compute        (GtkStyleProvide
                                                                  GtkCssChange                    change);
 GtkCssChange            gtk_css_static_style_get_change         (GtkCssStaticStyle              *style);
 
+void                    gtk_css_static_style_store_clear        (void);
+guint                   gtk_css_static_style_get_store_statistics (guint                        *hits,
+                                                                   guint                        *misses);
+void                    gtk_css_static_style_report_statistics  (void);
+
 G_END_DECLS
 
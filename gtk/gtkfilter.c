@@ -19,7 +19,7 @@
 
 #include "config.h"
 
-#include "gtkfilter.h"
+#include "gtkfilterprivate.h"
 
 #include "gtktypebuiltins.h"
 #include "gtkprivate.h"
@@ -54,6 +54,7 @@ enum {
 G_DEFINE_TYPE (GtkFilter, gtk_filter, G_TYPE_OBJECT)
 
 static guint signals[LAST_SIGNAL] = { 0 };
+static GQuark thread_safe_copy_quark;
 
 static gboolean
 gtk_filter_default_match (GtkFilter *self,
@@ -78,6 +79,8 @@ gtk_filter_class_init (GtkFilterClass *class)
   class->match = gtk_filter_default_match;
   class->get_strictness = gtk_filter_default_get_strictness;
 
+  thread_safe_copy_quark = g_quark_from_static_string ("gtk-filter-thread-safe-copy");
+
   /**
    * GtkFilter::changed:
    * @self: the filter
@@ -182,3 +185,50 @@ gtk_filter_changed (GtkFilter       *self,
 
   g_signal_emit (self, signals[CHANGED], 0, change);
 }
+
+/*<private>
+ * gtk_filter_class_set_thread_safe_copy:
+ * @class: the class of a final filter type
+ * @copy_func: function to copy filters of this type
+ *
+ * Sets the function used by gtk_filter_copy_thread_safe()
+ * for this class.
+ *
+ * This is not inherited, so it is only useful for final types.
+ */
+void
+gtk_filter_class_set_thread_safe_copy (GtkFilterClass    *class,
+                                       GtkFilterCopyFunc  copy_func)
+{
+  g_type_set_qdata (G_TYPE_FROM_CLASS (class), thread_safe_copy_quark, copy_func);
+}
+
+/*<private>
+ * gtk_filter_copy_thread_safe:
+ * @self: a filter
+ *
+ * Creates a filter that matches the same items as @self does
+ * right now, and that can be used from any thread.
+ *
+ * The copy will never change, so it keeps matching the old items
+ * when @self changes. It should not be exposed to applications.
+ *
+ * Note that it is up to the caller to make sure that the items
+ * themselves are safe to look at from other threads.
+ *
+ * Returns: (transfer full) (nullable): a thread-safe copy of @self
+ *   or %NULL if @self does not support that
+ */
+GtkFilter *
+gtk_filter_copy_thread_safe (GtkFilter *self)
+{
+  GtkFilterCopyFunc copy_func;
+
+  g_return_val_if_fail (GTK_IS_FILTER (self), NULL);
+
+  copy_func = g_type_get_qdata (G_OBJECT_TYPE (self), thread_safe_copy_quark);
+  if (copy_func == NULL)
+    return NULL;
+
+  return copy_func (self);
+}
@@ -22,9 +22,20 @@
 #include "gtkfilterlistmodel.h"
 
 #include "gtkbitset.h"
+#include "gtkfilterprivate.h"
 #include "gtkprivate.h"
 #include "gtksectionmodelprivate.h"
 
+#include "gdk/gdkparalleltaskprivate.h"
+
+/* Only filter in threads when there are at least this many
+ * items, the overhead isn't worth it otherwise.
+ */
+#define GTK_FILTER_THREADED_MIN_ITEMS (4 * 1024)
+
+/* The number of items a thread filters at once */
+#define GTK_FILTER_THREADED_CHUNK_SIZE 1024
+
 /**
  * GtkFilterListModel:
  *
@@ -38,6 +49,9 @@
  * filtering long lists doesn't block the UI. See
  * [method@Gtk.FilterListModel.set_incremental] for details.
  *
+ * Long lists can also be filtered in other threads, see
+ * [method@Gtk.FilterListModel.set_threaded].
+ *
  * `GtkFilterListModel` passes through sections from the underlying model.
  */
 
@@ -49,9 +63,12 @@ enum {
   PROP_MODEL,
   PROP_N_ITEMS,
   PROP_PENDING,
+  PROP_THREADED,
   NUM_PROPERTIES
 };
 
+typedef struct _FilterTask FilterTask;
+
 struct _GtkFilterListModel
 {
   GObject parent_instance;
@@ -60,10 +77,32 @@ struct _GtkFilterListModel
   GtkFilter *filter;
   GtkFilterMatch strictness;
   gboolean incremental;
+  gboolean threaded;
 
   GtkBitset *matches; /* NULL if strictness != GTK_FILTER_MATCH_SOME */
+  GtkBitset *next_matches; /* matches of a filter that is filtered in threads while matches are still shown, or NULL */
   GtkBitset *pending; /* not yet filtered items or NULL if all filtered */
   guint pending_cb; /* idle callback handle */
+  FilterTask *filter_task; /* NULL or filtering of pending in threads */
+};
+
+/* Filtering of a snapshot of the pending items with a copy of
+ * the filter, so it doesn't share anything with the model.
+ *
+ * Anything that changes the pending items or the filter must
+ * cancel the task, and the results are thrown away then.
+ */
+struct _FilterTask
+{
+  GtkFilterListModel *self; /* NULL once the model doesn't care anymore */
+
+  GtkFilter *filter;
+  guint n_items;
+  guint *positions;
+  gpointer *items;
+  GtkBitset **chunk_matches;
+
+  int cancelled; /* atomic */
 };
 
 struct _GtkFilterListModelClass
@@ -268,7 +307,7 @@ gtk_filter_list_model_run_filter (GtkFilterListModel *self,
        i++, more = gtk_bitset_iter_next (&iter, &pos))
     {
       if (gtk_filter_list_model_run_filter_on_item (self, pos))
-        gtk_bitset_add (self->matches, pos);
+        gtk_bitset_add (self->next_matches ? self->next_matches : self->matches, pos);
     }
 
   if (more)
@@ -277,18 +316,6 @@ gtk_filter_list_model_run_filter (GtkFilterListModel *self,
     g_clear_pointer (&self->pending, gtk_bitset_unref);
 }
 
-static void
-gtk_filter_list_model_stop_filtering (GtkFilterListModel *self)
-{
-  gboolean notify_pending = self->pending != NULL;
-
-  g_clear_pointer (&self->pending, gtk_bitset_unref);
-  g_clear_handle_id (&self->pending_cb, g_source_remove);
-
-  if (notify_pending)
-    g_object_notify_by_pspec (G_OBJECT (self), properties[PROP_PENDING]);
-}
-
 static void
 gtk_filter_list_model_emit_items_changed_for_changes (GtkFilterListModel *self,
                                                       GtkBitset          *old)
@@ -316,6 +343,217 @@ gtk_filter_list_model_emit_items_changed_for_changes (GtkFilterListModel *self,
   gtk_bitset_unref (old);
 }
 
+/* Replaces the shown matches with the ones of the new filter,
+ * without emitting anything.
+ */
+static void
+gtk_filter_list_model_take_next_matches (GtkFilterListModel *self)
+{
+  if (self->next_matches == NULL)
+    return;
+
+  gtk_bitset_unref (self->matches);
+  self->matches = g_steal_pointer (&self->next_matches);
+}
+
+static void
+gtk_filter_list_model_show_next_matches (GtkFilterListModel *self)
+{
+  GtkBitset *old;
+
+  if (self->next_matches == NULL)
+    return;
+
+  old = gtk_bitset_copy (self->matches);
+  gtk_filter_list_model_take_next_matches (self);
+  gtk_filter_list_model_emit_items_changed_for_changes (self, old);
+}
+
+static void
+filter_task_filter_chunks (gsize    start,
+                           gsize    end,
+                           gpointer data)
+{
+  FilterTask *task = data;
+  gsize i, j, offset, n;
+
+  for (i = start; i < end; i++)
+    {
+      GtkBitset *matches;
+
+      if (g_atomic_int_get (&task->cancelled))
+        return;
+
+      offset = i * GTK_FILTER_THREADED_CHUNK_SIZE;
+      n = MIN (GTK_FILTER_THREADED_CHUNK_SIZE, task->n_items - offset);
+
+      matches = gtk_bitset_new_empty ();
+      for (j = offset; j < offset + n; j++)
+        {
+          if (gtk_filter_match (task->filter, task->items[j]))
+            gtk_bitset_add (matches, task->positions[j]);
+        }
+
+      task->chunk_matches[i] = matches;
+    }
+}
+
+static guint
+filter_task_get_n_chunks (FilterTask *task)
+{
+  return (task->n_items + GTK_FILTER_THREADED_CHUNK_SIZE - 1) / GTK_FILTER_THREADED_CHUNK_SIZE;
+}
+
+static void
+filter_task_thread (GTask        *gtask,
+                    gpointer      source_object,
+                    gpointer      task_data,
+                    GCancellable *cancellable)
+{
+  FilterTask *task = task_data;
+
+  gdk_parallel_for (filter_task_get_n_chunks (task), 1, filter_task_filter_chunks, task);
+
+  g_task_return_boolean (gtask, TRUE);
+}
+
+/* This drops the references to the items, so it must
+ * happen in the main thread.
+ */
+static void
+filter_task_free (FilterTask *task)
+{
+  guint i;
+
+  for (i = 0; i < filter_task_get_n_chunks (task); i++)
+    g_clear_pointer (&task->chunk_matches[i], gtk_bitset_unref);
+  for (i = 0; i < task->n_items; i++)
+    g_object_unref (task->items[i]);
+
+  g_free (task->chunk_matches);
+  g_free (task->items);
+  g_free (task->positions);
+  g_object_unref (task->filter);
+  g_free (task);
+}
+
+static void
+gtk_filter_list_model_filter_task_done (GObject      *source_object,
+                                        GAsyncResult *result,
+                                        gpointer      data)
+{
+  FilterTask *task = data;
+  GtkFilterListModel *self = task->self;
+  guint i;
+
+  if (self == NULL)
+    {
+      filter_task_free (task);
+      return;
+    }
+
+  g_assert (self->filter_task == task);
+  self->filter_task = NULL;
+
+  if (self->next_matches == NULL)
+    self->next_matches = gtk_bitset_copy (self->matches);
+  for (i = 0; i < filter_task_get_n_chunks (task); i++)
+    gtk_bitset_union (self->next_matches, task->chunk_matches[i]);
+  filter_task_free (task);
+
+  g_clear_pointer (&self->pending, gtk_bitset_unref);
+
+  gtk_filter_list_model_show_next_matches (self);
+  g_object_notify_by_pspec (G_OBJECT (self), properties[PROP_PENDING]);
+}
+
+/* Starts filtering the pending items in other threads if that is
+ * possible. The items are collected here, because models aren't
+ * thread-safe.
+ */
+static gboolean
+gtk_filter_list_model_start_filter_task (GtkFilterListModel *self)
+{
+  GtkFilter *filter;
+  FilterTask *task;
+  GtkBitsetIter iter;
+  GTask *gtask;
+  guint i, pos;
+
+  g_assert (self->filter_task == NULL);
+  g_assert (self->pending != NULL);
+
+  if (!self->threaded ||
+      gtk_bitset_get_size (self->pending) < GTK_FILTER_THREADED_MIN_ITEMS)
+    return FALSE;
+
+  filter = gtk_filter_copy_thread_safe (self->filter);
+  if (filter == NULL)
+    return FALSE;
+
+  task = g_new0 (FilterTask, 1);
+  task->self = self;
+  task->filter = filter;
+  task->n_items = gtk_bitset_get_size (self->pending);
+  task->positions = g_new (guint, task->n_items);
+  task->items = g_new (gpointer, task->n_items);
+  task->chunk_matches = g_new0 (GtkBitset *, filter_task_get_n_chunks (task));
+
+  for (i = 0, gtk_bitset_iter_init_first (&iter, self->pending, &pos);
+       gtk_bitset_iter_is_valid (&iter);
+       i++, gtk_bitset_iter_next (&iter, &pos))
+    {
+      task->positions[i] = pos;
+      task->items[i] = g_list_model_get_item (self->model, pos);
+    }
+
+  self->filter_task = task;
+  g_clear_handle_id (&self->pending_cb, g_source_remove);
+
+  gtask = g_task_new (NULL, NULL, gtk_filter_list_model_filter_task_done, task);
+  g_task_set_source_tag (gtask, gtk_filter_list_model_start_filter_task);
+  g_task_set_static_name (gtask, "[gtk] gtk_filter_list_model_filter_task");
+  g_task_set_task_data (gtask, task, NULL);
+  g_task_run_in_thread (gtask, filter_task_thread);
+  g_object_unref (gtask);
+
+  return TRUE;
+}
+
+/* The thread will notice soon and stop. It doesn't touch anything
+ * the model uses, so there is no need to wait for it.
+ *
+ * Returns: %TRUE if a task was running
+ */
+static gboolean
+gtk_filter_list_model_cancel_filter_task (GtkFilterListModel *self)
+{
+  FilterTask *task = self->filter_task;
+
+  if (task == NULL)
+    return FALSE;
+
+  g_atomic_int_set (&task->cancelled, TRUE);
+  task->self = NULL;
+  self->filter_task = NULL;
+
+  return TRUE;
+}
+
+static void
+gtk_filter_list_model_stop_filtering (GtkFilterListModel *self)
+{
+  gboolean notify_pending = self->pending != NULL;
+
+  gtk_filter_list_model_cancel_filter_task (self);
+  g_clear_pointer (&self->pending, gtk_bitset_unref);
+  g_clear_pointer (&self->next_matches, gtk_bitset_unref);
+  g_clear_handle_id (&self->pending_cb, g_source_remove);
+
+  if (notify_pending)
+    g_object_notify_by_pspec (G_OBJECT (self), properties[PROP_PENDING]);
+}
+
 static gboolean
 gtk_filter_list_model_run_filter_cb (gpointer data)
 {
@@ -355,6 +593,12 @@ gtk_filter_list_model_start_filtering (GtkFilterListModel *self,
 
   self->pending = items;
 
+  if (gtk_filter_list_model_start_filter_task (self))
+    {
+      g_object_notify_by_pspec (G_OBJECT (self), properties[PROP_PENDING]);
+      return;
+    }
+
   if (!self->incremental)
     {
       gtk_filter_list_model_run_filter (self, G_MAXUINT);
@@ -368,6 +612,34 @@ gtk_filter_list_model_start_filtering (GtkFilterListModel *self,
   gdk_source_set_static_name_by_id (self->pending_cb, "[gtk] gtk_filter_list_model_run_filter_cb");
 }
 
+/* Continues filtering the pending items after a filter task was
+ * cancelled. If it can't be done in threads anymore, this shows
+ * the results so far and uses the idle handler even if not
+ * incremental, so that items-changed can be emitted for items
+ * that were pending before.
+ */
+static void
+gtk_filter_list_model_resume_filtering (GtkFilterListModel *self)
+{
+  if (self->pending == NULL || self->filter_task != NULL || self->pending_cb != 0)
+    return;
+
+  if (gtk_bitset_is_empty (self->pending))
+    {
+      gtk_filter_list_model_show_next_matches (self);
+      gtk_filter_list_model_stop_filtering (self);
+      return;
+    }
+
+  if (gtk_filter_list_model_start_filter_task (self))
+    return;
+
+  gtk_filter_list_model_show_next_matches (self);
+
+  self->pending_cb = g_idle_add (gtk_filter_list_model_run_filter_cb, self);
+  gdk_source_set_static_name_by_id (self->pending_cb, "[gtk] gtk_filter_list_model_run_filter_cb");
+}
+
 static void
 gtk_filter_list_model_items_changed_cb (GListModel         *model,
                                         guint               position,
@@ -376,6 +648,7 @@ gtk_filter_list_model_items_changed_cb (GListModel         *model,
                                         GtkFilterListModel *self)
 {
   guint filter_removed, filter_added;
+  gboolean resume;
 
   switch (self->strictness)
     {
@@ -395,12 +668,17 @@ gtk_filter_list_model_items_changed_cb (GListModel         *model,
       g_assert_not_reached ();
     }
 
+  /* the task would report matches at the old positions */
+  resume = gtk_filter_list_model_cancel_filter_task (self);
+
   if (removed > 0)
     filter_removed = gtk_bitset_get_size_in_range (self->matches, position, position + removed - 1);
   else
     filter_removed = 0;
 
   gtk_bitset_splice (self->matches, position, removed, added);
+  if (self->next_matches)
+    gtk_bitset_splice (self->next_matches, position, removed, added);
   if (self->pending)
     gtk_bitset_splice (self->pending, position, removed, added);
 
@@ -418,6 +696,9 @@ gtk_filter_list_model_items_changed_cb (GListModel         *model,
                                 filter_removed, filter_added);
   if (filter_removed != filter_added)
     g_object_notify_by_pspec (G_OBJECT (self), properties[PROP_N_ITEMS]);
+
+  if (resume)
+    gtk_filter_list_model_resume_filtering (self);
 }
 
 static void
@@ -442,6 +723,10 @@ gtk_filter_list_model_set_property (GObject      *object,
       gtk_filter_list_model_set_model (self, g_value_get_object (value));
       break;
 
+    case PROP_THREADED:
+      gtk_filter_list_model_set_threaded (self, g_value_get_boolean (value));
+      break;
+
     default:
       G_OBJECT_WARN_INVALID_PROPERTY_ID (object, prop_id, pspec);
       break;
@@ -482,6 +767,10 @@ gtk_filter_list_model_get_property (GObject     *object,
       g_value_set_uint (value, gtk_filter_list_model_get_pending (self));
       break;
 
+    case PROP_THREADED:
+      g_value_set_boolean (value, self->threaded);
+      break;
+
     default:
       G_OBJECT_WARN_INVALID_PROPERTY_ID (object, prop_id, pspec);
       break;
@@ -596,42 +885,57 @@ gtk_filter_list_model_refilter (GtkFilterListModel *self,
 
     case GTK_FILTER_MATCH_SOME:
       {
-        GtkBitset *old, *pending;
+        GtkBitset *known, *next, *pending;
+        gboolean resume;
+
+        /* the task uses a copy of the old filter */
+        resume = gtk_filter_list_model_cancel_filter_task (self);
 
         if (self->matches == NULL)
           {
             if (self->strictness == GTK_FILTER_MATCH_ALL)
-              old = gtk_bitset_new_range (0, g_list_model_get_n_items (self->model));
+              self->matches = gtk_bitset_new_range (0, g_list_model_get_n_items (self->model));
             else
-              old = gtk_bitset_new_empty ();
-          }
-        else
-          {
-            old = self->matches;
+              self->matches = gtk_bitset_new_empty ();
           }
         self->strictness = new_strictness;
+
+        /* The matches of the previous filter, which may still be
+         * filtered in threads.
+         */
+        known = self->next_matches ? self->next_matches : self->matches;
         switch (change)
           {
           default:
             g_assert_not_reached ();
             /* fall thru */
           case GTK_FILTER_CHANGE_DIFFERENT:
-            self->matches = gtk_bitset_new_empty ();
+            next = gtk_bitset_new_empty ();
             pending = gtk_bitset_new_range (0, g_list_model_get_n_items (self->model));
             break;
           case GTK_FILTER_CHANGE_LESS_STRICT:
-            self->matches = gtk_bitset_copy (old);
+            next = gtk_bitset_copy (known);
             pending = gtk_bitset_new_range (0, g_list_model_get_n_items (self->model));
-            gtk_bitset_subtract (pending, self->matches);
+            gtk_bitset_subtract (pending, next);
             break;
           case GTK_FILTER_CHANGE_MORE_STRICT:
-            self->matches = gtk_bitset_new_empty ();
-            pending = gtk_bitset_copy (old);
+            next = gtk_bitset_new_empty ();
+            pending = gtk_bitset_copy (known);
             break;
           }
+        g_clear_pointer (&self->next_matches, gtk_bitset_unref);
+        self->next_matches = next;
+
         gtk_filter_list_model_start_filtering (self, pending);
 
-        gtk_filter_list_model_emit_items_changed_for_changes (self, old);
+        if (resume)
+          gtk_filter_list_model_resume_filtering (self);
+
+        /* When filtering in threads, keep showing the old matches
+         * until the task is done, so that there is only one change.
+         */
+        if (self->filter_task == NULL)
+          gtk_filter_list_model_show_next_matches (self);
       }
     }
 }
@@ -739,6 +1043,18 @@ gtk_filter_list_model_class_init (GtkFilterListModelClass *class)
                          0, G_MAXUINT, 0,
                          GTK_PARAM_READABLE | G_PARAM_EXPLICIT_NOTIFY);
 
+  /**
+   * GtkFilterListModel:threaded:
+   *
+   * If the model should filter long lists in other threads.
+   *
+   * Since: 4.18
+   */
+  properties[PROP_THREADED] =
+      g_param_spec_boolean ("threaded", NULL, NULL,
+                            FALSE,
+                            GTK_PARAM_READWRITE | G_PARAM_EXPLICIT_NOTIFY);
+
   g_object_class_install_properties (gobject_class, NUM_PROPERTIES, properties);
 }
 
@@ -946,6 +1262,7 @@ gtk_filter_list_model_set_incremental (GtkFilterListModel *self,
     {
       GtkBitset *old;
       gtk_filter_list_model_run_filter (self, G_MAXUINT);
+      gtk_filter_list_model_show_next_matches (self);
 
       old = gtk_bitset_copy (self->matches);
       gtk_filter_list_model_run_filter (self, 512);
@@ -977,6 +1294,93 @@ gtk_filter_list_model_get_incremental (GtkFilterListModel *self)
   return self->incremental;
 }
 
+/**
+ * gtk_filter_list_model_set_threaded:
+ * @self: a `GtkFilterListModel`
+ * @threaded: %TRUE to filter in other threads
+ *
+ * Sets whether the filter model filters long lists in other threads.
+ *
+ * When threaded filtering is enabled, the `GtkFilterListModel` will
+ * filter many items at once by running the filter in multiple other
+ * threads. While that happens, the model keeps the items that matched
+ * the previous filter. Once all items are filtered, the model switches
+ * to the new matches with a single [signal@Gio.ListModel::items-changed]
+ * emission. This keeps the UI responsive without making the results
+ * trickle in like [property@Gtk.FilterListModel:incremental] does.
+ *
+ * This is only possible with filters that GTK knows to be usable from
+ * other threads, such as [class@Gtk.StringFilter], [class@Gtk.BoolFilter]
+ * and [class@Gtk.AnyFilter] or [class@Gtk.EveryFilter] combining them.
+ * Other filters and short lists are filtered like before, according
+ * to [property@Gtk.FilterListModel:incremental].
+ *
+ * The filter evaluates its expressions on the items in other threads,
+ * so the items and the expressions must not change while filtering.
+ * In particular, expressions must not use closures that are not
+ * thread-safe.
+ *
+ * By default, threaded filtering is disabled.
+ *
+ * Since: 4.18
+ */
+void
+gtk_filter_list_model_set_threaded (GtkFilterListModel *self,
+                                    gboolean            threaded)
+{
+  g_return_if_fail (GTK_IS_FILTER_LIST_MODEL (self));
+
+  if (self->threaded == threaded)
+    return;
+
+  self->threaded = threaded;
+
+  if (threaded)
+    {
+      if (self->pending && self->filter_task == NULL)
+        gtk_filter_list_model_start_filter_task (self);
+    }
+  else if (gtk_filter_list_model_cancel_filter_task (self))
+    {
+      if (self->incremental)
+        {
+          gtk_filter_list_model_resume_filtering (self);
+        }
+      else
+        {
+          GtkBitset *old;
+
+          old = gtk_bitset_copy (self->matches);
+          gtk_filter_list_model_run_filter (self, G_MAXUINT);
+          gtk_filter_list_model_take_next_matches (self);
+          gtk_filter_list_model_stop_filtering (self);
+          gtk_filter_list_model_emit_items_changed_for_changes (self, old);
+        }
+    }
+
+  g_object_notify_by_pspec (G_OBJECT (self), properties[PROP_THREADED]);
+}
+
+/**
+ * gtk_filter_list_model_get_threaded:
+ * @self: a `GtkFilterListModel`
+ *
+ * Returns whether threaded filtering is enabled.
+ *
+ * See [method@Gtk.FilterListModel.set_threaded].
+ *
+ * Returns: %TRUE if threaded filtering is enabled
+ *
+ * Since: 4.18
+ */
+gboolean
+gtk_filter_list_model_get_threaded (GtkFilterListModel *self)
+{
+  g_return_val_if_fail (GTK_IS_FILTER_LIST_MODEL (self), FALSE);
+
+  return self->threaded;
+}
+
 /**
  * gtk_filter_list_model_get_pending:
  * @self: a `GtkFilterListModel`
@@ -995,9 +1399,13 @@ gtk_filter_list_model_get_incremental (GtkFilterListModel *self)
  * ```
  *
  * If no filter operation is ongoing - in particular when
- * [property@Gtk.FilterListModel:incremental] is %FALSE - this
+ * [property@Gtk.FilterListModel:incremental] and
+ * [property@Gtk.FilterListModel:threaded] are %FALSE - this
  * function returns 0.
  *
+ * While items are filtered in other threads, all of them are
+ * counted as pending until the results are added at once.
+ *
  * Returns: The number of items not yet filtered
  */
 guint
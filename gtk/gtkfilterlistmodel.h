@@ -54,6 +54,11 @@ void                    gtk_filter_list_model_set_incremental   (GtkFilterListMo
                                                                  gboolean                incremental);
 GDK_AVAILABLE_IN_ALL
 gboolean                gtk_filter_list_model_get_incremental   (GtkFilterListModel     *self);
+GDK_AVAILABLE_IN_4_18
+void                    gtk_filter_list_model_set_threaded      (GtkFilterListModel     *self,
+                                                                 gboolean                threaded);
+GDK_AVAILABLE_IN_4_18
+gboolean                gtk_filter_list_model_get_threaded      (GtkFilterListModel     *self);
 GDK_AVAILABLE_IN_ALL
 guint                   gtk_filter_list_model_get_pending       (GtkFilterListModel     *self);
 
@@ -110,6 +110,7 @@ struct _GtkGridViewClass
 enum
 {
   PROP_0,
+  PROP_BIND_BUDGET,
   PROP_ENABLE_RUBBERBAND,
   PROP_FACTORY,
   PROP_MAX_COLUMNS,
@@ -673,7 +674,8 @@ gtk_grid_view_measure_list (GtkWidget *widget,
        tile != NULL;
        tile = gtk_rb_tree_node_get_next (tile))
     {
-      if (tile->widget)
+      /* Placeholders don't tell anything about the size of their row */
+      if (tile->widget && !gtk_list_tile_is_placeholder (tile))
         {
           gtk_widget_measure (tile->widget,
                               gtk_list_base_get_orientation (GTK_LIST_BASE (self)),
@@ -980,6 +982,10 @@ gtk_grid_view_get_property (GObject    *object,
 
   switch (property_id)
     {
+    case PROP_BIND_BUDGET:
+      g_value_set_uint (value, gtk_list_item_manager_get_bind_budget (self->item_manager));
+      break;
+
     case PROP_ENABLE_RUBBERBAND:
       g_value_set_boolean (value, gtk_list_base_get_enable_rubberband (GTK_LIST_BASE (self)));
       break;
@@ -1024,6 +1030,10 @@ gtk_grid_view_set_property (GObject      *object,
 
   switch (property_id)
     {
+    case PROP_BIND_BUDGET:
+      gtk_grid_view_set_bind_budget (self, g_value_get_uint (value));
+      break;
+
     case PROP_ENABLE_RUBBERBAND:
       gtk_grid_view_set_enable_rubberband (self, g_value_get_boolean (value));
       break;
@@ -1102,6 +1112,25 @@ gtk_grid_view_class_init (GtkGridViewClass *klass)
   gobject_class->get_property = gtk_grid_view_get_property;
   gobject_class->set_property = gtk_grid_view_set_property;
 
+  /**
+   * GtkGridView:bind-budget:
+   *
+   * Time in microseconds that may be spent per frame binding items.
+   *
+   * Items that don't fit into the budget are shown as placeholders
+   * with the `.placeholder` style class and are bound in the
+   * following frames. This keeps scrolling smooth when binding
+   * items is expensive.
+   *
+   * If set to 0, all items are bound right away.
+   *
+   * Since: 4.18
+   */
+  properties[PROP_BIND_BUDGET] =
+    g_param_spec_uint ("bind-budget", NULL, NULL,
+                       0, G_MAXUINT, 0,
+                       G_PARAM_READWRITE | G_PARAM_EXPLICIT_NOTIFY);
+
   /**
    * GtkGridView:enable-rubberband:
    *
@@ -1539,6 +1568,49 @@ gtk_grid_view_get_enable_rubberband (GtkGridView *self)
   return gtk_list_base_get_enable_rubberband (GTK_LIST_BASE (self));
 }
 
+/**
+ * gtk_grid_view_set_bind_budget:
+ * @self: a `GtkGridView`
+ * @budget: time in microseconds, or 0 for no limit
+ *
+ * Sets how much time per frame may be spent binding items.
+ *
+ * See [property@Gtk.GridView:bind-budget].
+ *
+ * Since: 4.18
+ */
+void
+gtk_grid_view_set_bind_budget (GtkGridView *self,
+                              guint        budget)
+{
+  g_return_if_fail (GTK_IS_GRID_VIEW (self));
+
+  if (budget == gtk_list_item_manager_get_bind_budget (self->item_manager))
+    return;
+
+  gtk_list_item_manager_set_bind_budget (self->item_manager, budget);
+
+  g_object_notify_by_pspec (G_OBJECT (self), properties[PROP_BIND_BUDGET]);
+}
+
+/**
+ * gtk_grid_view_get_bind_budget:
+ * @self: a `GtkGridView`
+ *
+ * Gets the time per frame that may be spent binding items.
+ *
+ * Returns: The bind budget in microseconds
+ *
+ * Since: 4.18
+ */
+guint
+gtk_grid_view_get_bind_budget (GtkGridView *self)
+{
+  g_return_val_if_fail (GTK_IS_GRID_VIEW (self), 0);
+
+  return gtk_list_item_manager_get_bind_budget (self->item_manager);
+}
+
 /**
  * gtk_grid_view_set_tab_behavior:
  * @self: a `GtkGridView`
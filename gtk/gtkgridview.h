@@ -79,6 +79,12 @@ GDK_AVAILABLE_IN_4_12
 GtkListTabBehavior
                 gtk_grid_view_get_tab_behavior                  (GtkGridView            *self);
 
+GDK_AVAILABLE_IN_4_18
+void            gtk_grid_view_set_bind_budget                   (GtkGridView            *self,
+                                                                 guint                   budget);
+GDK_AVAILABLE_IN_4_18
+guint           gtk_grid_view_get_bind_budget                   (GtkGridView            *self);
+
 GDK_AVAILABLE_IN_ALL
 void            gtk_grid_view_set_single_click_activate         (GtkGridView            *self,
                                                                  gboolean                single_click_activate);
@@ -43,6 +43,14 @@ struct _GtkListItemManager
   GtkListItemBase * (* create_widget) (GtkWidget *);
   void (* prepare_section) (GtkWidget *, GtkListTile *, guint);
   GtkListHeaderBase * (* create_header_widget) (GtkWidget *);
+
+  /* time per frame for binding items, 0 for no limit */
+  guint bind_budget;
+  /* running average of the time a bind takes */
+  gint64 bind_cost;
+  gint64 bind_frame;
+  gint64 bind_deadline;
+  guint bind_tick_id;
 };
 
 struct _GtkListItemManagerClass
@@ -111,6 +119,13 @@ static void
 gtk_list_item_change_release (GtkListItemChange *change,
                               GtkListItemBase   *widget)
 {
+  /* placeholders have no item to be found by */
+  if (gtk_list_item_base_get_item (widget) == NULL)
+    {
+      gtk_list_item_change_recycle (change, widget);
+      return;
+    }
+
   if (change->deleted_items == NULL)
     change->deleted_items = g_hash_table_new_full (g_direct_hash, g_direct_equal, NULL, (GDestroyNotify) gtk_widget_unparent);
 
@@ -183,6 +198,8 @@ gtk_list_item_manager_augment_node (GtkRbTree *tree,
 
   aug->n_items = tile->n_items;
   aug->area = tile->area;
+  aug->n_measured = tile->n_measured;
+  aug->measured_size = tile->measured_size;
 
   switch (tile->type)
   {
@@ -211,6 +228,8 @@ gtk_list_item_manager_augment_node (GtkRbTree *tree,
       GtkListTileAugment *left_aug = gtk_rb_tree_get_augment (tree, left);
 
       aug->n_items += left_aug->n_items;
+      aug->n_measured += left_aug->n_measured;
+      aug->measured_size += left_aug->measured_size;
       aug->has_header |= left_aug->has_header;
       aug->has_footer |= left_aug->has_footer;
       potentially_empty_rectangle_union (&aug->area, &left_aug->area);
@@ -221,10 +240,35 @@ gtk_list_item_manager_augment_node (GtkRbTree *tree,
       GtkListTileAugment *right_aug = gtk_rb_tree_get_augment (tree, right);
 
       aug->n_items += right_aug->n_items;
+      aug->n_measured += right_aug->n_measured;
+      aug->measured_size += right_aug->measured_size;
       aug->has_header |= right_aug->has_header;
       aug->has_footer |= right_aug->has_footer;
       potentially_empty_rectangle_union (&aug->area, &right_aug->area);
     }
+
+  aug->lead_n_measured = 0;
+  aug->lead_measured_size = 0;
+  if (left)
+    {
+      GtkListTileAugment *left_aug = gtk_rb_tree_get_augment (tree, left);
+
+      aug->lead_n_measured = left_aug->lead_n_measured;
+      aug->lead_measured_size = left_aug->lead_measured_size;
+      if (left_aug->has_header)
+        return;
+    }
+  if (gtk_list_tile_is_header (tile))
+    return;
+  aug->lead_n_measured += tile->n_measured;
+  aug->lead_measured_size += tile->measured_size;
+  if (right)
+    {
+      GtkListTileAugment *right_aug = gtk_rb_tree_get_augment (tree, right);
+
+      aug->lead_n_measured += right_aug->lead_n_measured;
+      aug->lead_measured_size += right_aug->lead_measured_size;
+    }
 }
 
 static void
@@ -713,6 +757,126 @@ gtk_list_tile_set_area_size (GtkListItemManager *self,
   gtk_rb_tree_node_mark_dirty (tile);
 }
 
+/*
+ * gtk_list_tile_set_measured_size:
+ * @self: the list item manager
+ * @tile: a tile with a single item
+ * @size: the size of the item along the list
+ *
+ * Remembers the size the item was measured with, so that it can
+ * be used for size estimates once the item is no longer realized.
+ *
+ * Remembered sizes are kept when tiles are merged and distributed
+ * evenly when they are split, so the total for a range of items
+ * stays accurate.
+ **/
+void
+gtk_list_tile_set_measured_size (GtkListItemManager *self,
+                                 GtkListTile        *tile,
+                                 int                 size)
+{
+  g_assert (tile->n_items == 1);
+
+  if (tile->n_measured == 1 && tile->measured_size == size)
+    return;
+
+  tile->n_measured = 1;
+  tile->measured_size = size;
+  gtk_rb_tree_node_mark_dirty (tile);
+}
+
+/*
+ * gtk_list_tile_get_section_measured_size:
+ * @self: the list item manager
+ * @header: a header tile
+ * @n_measured: (out): the number of items with a remembered size
+ * @measured_size: (out): the sum of their sizes
+ *
+ * Sums up the remembered sizes in the section that starts at @header,
+ * using the augments, so this takes logarithmic time.
+ **/
+void
+gtk_list_tile_get_section_measured_size (GtkListItemManager *self,
+                                         GtkListTile        *header,
+                                         guint              *n_measured,
+                                         gint64             *measured_size)
+{
+  GtkListTileAugment *aug;
+  GtkListTile *tile, *parent, *right;
+
+  g_assert (gtk_list_tile_is_header (header));
+
+  *n_measured = 0;
+  *measured_size = 0;
+
+  /* Sum up everything after the header until the next one: first the
+   * right subtree, then every parent we reach from the left together
+   * with its right subtree. */
+  right = gtk_rb_tree_node_get_right (header);
+  if (right)
+    {
+      aug = gtk_list_tile_get_augment (self, right);
+      *n_measured += aug->lead_n_measured;
+      *measured_size += aug->lead_measured_size;
+      if (aug->has_header)
+        return;
+    }
+
+  for (tile = header, parent = gtk_rb_tree_node_get_parent (tile);
+       parent != NULL;
+       tile = parent, parent = gtk_rb_tree_node_get_parent (tile))
+    {
+      if (gtk_rb_tree_node_get_left (parent) != tile)
+        continue;
+
+      if (gtk_list_tile_is_header (parent))
+        return;
+
+      *n_measured += parent->n_measured;
+      *measured_size += parent->measured_size;
+
+      right = gtk_rb_tree_node_get_right (parent);
+      if (right)
+        {
+          aug = gtk_list_tile_get_augment (self, right);
+          *n_measured += aug->lead_n_measured;
+          *measured_size += aug->lead_measured_size;
+          if (aug->has_header)
+            return;
+        }
+    }
+}
+
+void
+gtk_list_tile_clear_measured_size (GtkListItemManager *self,
+                                   GtkListTile        *tile)
+{
+  if (tile->n_measured == 0 && tile->measured_size == 0)
+    return;
+
+  tile->n_measured = 0;
+  tile->measured_size = 0;
+  gtk_rb_tree_node_mark_dirty (tile);
+}
+
+/*
+ * gtk_list_tile_is_placeholder:
+ * @tile: a tile
+ *
+ * Checks if the tile's widget is a placeholder that is waiting
+ * to be bound. The size of such a widget says nothing about the
+ * size of the item.
+ *
+ * Returns: %TRUE if the tile shows a placeholder
+ **/
+gboolean
+gtk_list_tile_is_placeholder (GtkListTile *tile)
+{
+  return tile->type == GTK_LIST_TILE_ITEM &&
+         tile->widget != NULL &&
+         gtk_list_item_base_get_item (GTK_LIST_ITEM_BASE (tile->widget)) == NULL;
+}
+
 static void
 gtk_list_tile_set_type (GtkListTile     *tile,
                         GtkListTileType  type)
@@ -723,6 +887,11 @@ gtk_list_tile_set_type (GtkListTile     *tile,
 
   g_assert (tile->widget == NULL);
   tile->type = type;
+  if (type == GTK_LIST_TILE_REMOVED)
+    {
+      tile->n_measured = 0;
+      tile->measured_size = 0;
+    }
   gtk_rb_tree_node_mark_dirty (tile);
 }
 
@@ -1004,6 +1173,8 @@ gtk_list_item_manager_merge_list_items (GtkListItemManager *self,
     return FALSE;
 
   first->n_items += second->n_items;
+  first->n_measured += second->n_measured;
+  first->measured_size += second->measured_size;
   gtk_rb_tree_node_mark_dirty (first);
   gtk_rb_tree_remove (self->items, second);
 
@@ -1042,6 +1213,14 @@ gtk_list_tile_split (GtkListItemManager *self,
   result = gtk_rb_tree_insert_after (self->items, tile);
   result->type = GTK_LIST_TILE_ITEM;
   result->n_items = tile->n_items - n_items;
+  if (tile->n_measured > 0)
+    {
+      /* We don't know which items were measured, assume an even spread */
+      result->n_measured = (guint64) tile->n_measured * result->n_items / tile->n_items;
+      result->measured_size = (gint64) tile->measured_size * result->n_measured / tile->n_measured;
+      tile->n_measured -= result->n_measured;
+      tile->measured_size -= result->measured_size;
+    }
   tile->n_items = n_items;
   gtk_rb_tree_node_mark_dirty (tile);
 
@@ -1279,6 +1458,162 @@ gtk_list_tile_find_widget_before (GtkListTile *tile)
   return NULL;
 }
 
+static gint64
+gtk_list_item_manager_get_bind_deadline (GtkListItemManager *self)
+{
+  GdkFrameClock *frame_clock;
+  gint64 frame;
+
+  if (self->bind_budget == 0)
+    return G_MAXINT64;
+
+  /* Without a frame clock, there is nothing to finish the binds */
+  frame_clock = gtk_widget_get_frame_clock (self->widget);
+  if (frame_clock == NULL)
+    return G_MAXINT64;
+
+  frame = gdk_frame_clock_get_frame_counter (frame_clock);
+  if (frame != self->bind_frame)
+    {
+      self->bind_frame = frame;
+      self->bind_deadline = g_get_monotonic_time () + self->bind_budget;
+    }
+
+  return self->bind_deadline;
+}
+
+static gboolean gtk_list_item_manager_bind_tick_cb (GtkWidget     *widget,
+                                                    GdkFrameClock *frame_clock,
+                                                    gpointer       data);
+
+/*
+ * gtk_list_item_manager_update_item:
+ * @self: the listitemmanager
+ * @tile: an item tile with a widget
+ * @position: the position of the tile
+ * @item: the item at @position
+ * @deadline: monotonic time by which binding has to be done
+ *
+ * Updates the tile's widget for @item. If that needs a bind that
+ * is not expected to finish before @deadline, the widget is turned
+ * into a placeholder instead, and the bind is done in a later frame.
+ *
+ * Returns: %TRUE if the widget was bound to @item
+ **/
+static gboolean
+gtk_list_item_manager_update_item (GtkListItemManager *self,
+                                   GtkListTile        *tile,
+                                   guint               position,
+                                   gpointer            item,
+                                   gint64              deadline)
+{
+  GtkListItemBase *widget = GTK_LIST_ITEM_BASE (tile->widget);
+  gboolean selected;
+  gint64 start;
+
+  selected = gtk_selection_model_is_selected (self->model, position);
+
+  if (gtk_list_item_base_get_item (widget) == item || deadline == G_MAXINT64)
+    {
+      gtk_list_item_base_update (widget, position, item, selected);
+    }
+  else
+    {
+      start = g_get_monotonic_time ();
+      if (start + self->bind_cost > deadline)
+        {
+          gtk_list_item_base_update (widget, position, NULL, selected);
+          if (!gtk_widget_has_css_class (tile->widget, "placeholder"))
+            {
+              gtk_widget_add_css_class (tile->widget, "placeholder");
+              /* don't show what the widget was bound to before */
+              gtk_widget_set_opacity (tile->widget, 0.0);
+            }
+
+          if (self->bind_tick_id == 0)
+            self->bind_tick_id = gtk_widget_add_tick_callback (self->widget,
+                                                               gtk_list_item_manager_bind_tick_cb,
+                                                               self,
+                                                               NULL);
+          return FALSE;
+        }
+
+      gtk_list_item_base_update (widget, position, item, selected);
+
+      self->bind_cost = (3 * self->bind_cost + g_get_monotonic_time () - start) / 4;
+    }
+
+  if (gtk_widget_has_css_class (tile->widget, "placeholder"))
+    {
+      gtk_widget_remove_css_class (tile->widget, "placeholder");
+      gtk_widget_set_opacity (tile->widget, 1.0);
+    }
+
+  return TRUE;
+}
+
+static gboolean
+gtk_list_item_manager_bind_tick_cb (GtkWidget     *widget,
+                                    GdkFrameClock *frame_clock,
+                                    gpointer       data)
+{
+  GtkListItemManager *self = data;
+  GtkListTile *tile;
+  gint64 deadline;
+  guint position, n_bound, pass;
+  gboolean pending;
+
+  deadline = gtk_list_item_manager_get_bind_deadline (self);
+  n_bound = 0;
+  pending = FALSE;
+
+  if (self->model == NULL)
+    goto out;
+
+  /* Bind what is on screen first, then the rest */
+  for (pass = 0; pass < 2 && !pending; pass++)
+    {
+      position = 0;
+
+      for (tile = gtk_list_item_manager_get_first (self);
+           tile != NULL;
+           tile = gtk_rb_tree_node_get_next (tile))
+        {
+          if (gtk_list_tile_is_placeholder (tile) &&
+              (pass > 0 || gtk_widget_get_child_visible (tile->widget)))
+            {
+              gpointer item = g_list_model_get_item (G_LIST_MODEL (self->model), position);
+              gboolean bound;
+
+              /* Always make progress, even if binds exceed the budget */
+              bound = gtk_list_item_manager_update_item (self, tile, position, item,
+                                                         n_bound == 0 ? G_MAXINT64 : deadline);
+              g_object_unref (item);
+
+              if (!bound)
+                {
+                  pending = TRUE;
+                  break;
+                }
+
+              n_bound++;
+            }
+
+          position += tile->n_items;
+        }
+    }
+
+out:
+  if (n_bound > 0)
+    gtk_widget_queue_resize (self->widget);
+
+  if (pending)
+    return G_SOURCE_CONTINUE;
+
+  self->bind_tick_id = 0;
+  return G_SOURCE_REMOVE;
+}
+
 static void
 gtk_list_item_manager_ensure_items (GtkListItemManager *self,
                                     GtkListItemChange  *change,
@@ -1289,6 +1624,7 @@ gtk_list_item_manager_ensure_items (GtkListItemManager *self,
   GtkWidget *insert_after;
   guint position, i, n_items, query_n_items, offset;
   gboolean tracked, has_sections;
+  gint64 deadline;
 
   if (self->model == NULL)
     return;
@@ -1296,6 +1632,7 @@ gtk_list_item_manager_ensure_items (GtkListItemManager *self,
   n_items = g_list_model_get_n_items (G_LIST_MODEL (self->model));
   position = 0;
   has_sections = gtk_list_item_manager_has_sections (self);
+  deadline = gtk_list_item_manager_get_bind_deadline (self);
 
   gtk_list_item_manager_release_items (self, change);
 
@@ -1372,13 +1709,16 @@ gtk_list_item_manager_ensure_items (GtkListItemManager *self,
                   tile->widget = GTK_WIDGET (gtk_list_item_change_get (change, item));
                   if (tile->widget == NULL)
                     tile->widget = GTK_WIDGET (self->create_widget (self->widget));
-                  gtk_list_item_base_update (GTK_LIST_ITEM_BASE (tile->widget),
-                                             position + i,
-                                             item,
-                                             gtk_selection_model_is_selected (self->model, position + i));
+                  gtk_list_item_manager_update_item (self, tile, position + i, item, deadline);
                   g_object_unref (item);
                   gtk_widget_insert_after (tile->widget, self->widget, insert_after);
                 }
+              else if (gtk_list_tile_is_placeholder (tile))
+                {
+                  gpointer item = g_list_model_get_item (G_LIST_MODEL (self->model), position + i);
+                  gtk_list_item_manager_update_item (self, tile, position + i, item, deadline);
+                  g_object_unref (item);
+                }
               else
                 {
                   if (update_start <= position + i)
@@ -1548,12 +1888,15 @@ gtk_list_item_manager_model_items_changed_cb (GListModel         *model,
         }
       else if (tracker->position >= position)
         {
-          GtkListItemBase *widget = gtk_list_item_change_find (&change, gtk_list_item_base_get_item (tracker->widget));
-          if (widget)
+          gpointer item = gtk_list_item_base_get_item (tracker->widget);
+          GtkListItemBase *widget = item ? gtk_list_item_change_find (&change, item) : NULL;
+          if (widget || item == NULL)
             {
               /* The item is still in the recycling pool, which means it got deleted.
+               * Placeholders can't be found again, so they count as deleted, too.
                * Put the widget back and then guess a good new position */
-              gtk_list_item_change_release (&change, widget);
+              if (widget)
+                gtk_list_item_change_release (&change, widget);
 
               tracker->position = position + (tracker->position - position) * added / removed;
               if (tracker->position >= n_items)
@@ -1742,6 +2085,12 @@ gtk_list_item_manager_dispose (GObject *object)
 
   gtk_list_item_manager_clear_model (self);
 
+  if (self->bind_tick_id)
+    {
+      gtk_widget_remove_tick_callback (self->widget, self->bind_tick_id);
+      self->bind_tick_id = 0;
+    }
+
   g_clear_pointer (&self->items, gtk_rb_tree_unref);
 
   G_OBJECT_CLASS (gtk_list_item_manager_parent_class)->dispose (object);
@@ -1758,6 +2107,7 @@ gtk_list_item_manager_class_init (GtkListItemManagerClass *klass)
 static void
 gtk_list_item_manager_init (GtkListItemManager *self)
 {
+  self->bind_frame = -1;
 }
 
 void
@@ -1875,6 +2225,30 @@ gtk_list_item_manager_get_has_sections (GtkListItemManager *self)
   return self->has_sections;
 }
 
+/*
+ * gtk_list_item_manager_set_bind_budget:
+ * @self: the listitemmanager
+ * @budget: time in microseconds
+ *
+ * Sets how much time per frame may be spent binding items to
+ * widgets. Items that don't fit get a placeholder widget that
+ * is bound in one of the next frames.
+ *
+ * A budget of 0 binds all items right away.
+ **/
+void
+gtk_list_item_manager_set_bind_budget (GtkListItemManager *self,
+                                       guint               budget)
+{
+  self->bind_budget = budget;
+}
+
+guint
+gtk_list_item_manager_get_bind_budget (GtkListItemManager *self)
+{
+  return self->bind_budget;
+}
+
 GtkListItemTracker *
 gtk_list_item_tracker_new (GtkListItemManager *self)
 {
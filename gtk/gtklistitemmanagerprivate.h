@@ -61,6 +61,10 @@ struct _GtkListTile
   guint n_items;
   /* area occupied by tile. May be empty if tile has no allocation */
   cairo_rectangle_int_t area;
+  /* sizes remembered from the last time items were realized:
+   * the sum of sizes along the list, and how many items it covers */
+  guint n_measured;
+  int measured_size;
 };
 
 struct _GtkListTileAugment
@@ -72,6 +76,13 @@ struct _GtkListTileAugment
 
   /* union of all areas of tile and children */
   cairo_rectangle_int_t area;
+
+  /* sum of remembered sizes of tile and children */
+  guint n_measured;
+  gint64 measured_size;
+  /* the same, but only up to the first header */
+  guint lead_n_measured;
+  gint64 lead_measured_size;
 };
 
 
@@ -123,6 +134,16 @@ void                    gtk_list_tile_set_area_size             (GtkListItemMana
                                                                  GtkListTile            *tile,
                                                                  int                     width,
                                                                  int                     height);
+void                    gtk_list_tile_set_measured_size         (GtkListItemManager     *self,
+                                                                 GtkListTile            *tile,
+                                                                 int                     size);
+void                    gtk_list_tile_get_section_measured_size (GtkListItemManager     *self,
+                                                                 GtkListTile            *header,
+                                                                 guint                  *n_measured,
+                                                                 gint64                 *measured_size);
+void                    gtk_list_tile_clear_measured_size       (GtkListItemManager     *self,
+                                                                 GtkListTile            *tile);
+gboolean                gtk_list_tile_is_placeholder            (GtkListTile            *tile);
 
 GtkListTile *           gtk_list_tile_split                     (GtkListItemManager     *self,
                                                                  GtkListTile            *tile,
@@ -134,6 +155,9 @@ GtkSelectionModel *     gtk_list_item_manager_get_model         (GtkListItemMana
 void                    gtk_list_item_manager_set_has_sections  (GtkListItemManager     *self,
                                                                  gboolean                has_sections);
 gboolean                gtk_list_item_manager_get_has_sections  (GtkListItemManager     *self);
+void                    gtk_list_item_manager_set_bind_budget   (GtkListItemManager     *self,
+                                                                 guint                   budget);
+guint                   gtk_list_item_manager_get_bind_budget   (GtkListItemManager     *self);
 
 GtkListItemTracker *    gtk_list_item_tracker_new               (GtkListItemManager     *self);
 void                    gtk_list_item_tracker_free              (GtkListItemManager     *self,
@@ -151,6 +151,7 @@
 enum
 {
   PROP_0,
+  PROP_BIND_BUDGET,
   PROP_ENABLE_RUBBERBAND,
   PROP_FACTORY,
   PROP_HEADER_FACTORY,
@@ -172,6 +173,22 @@ G_DEFINE_TYPE (GtkListView, gtk_list_view, GTK_TYPE_LIST_BASE)
 static GParamSpec *properties[N_PROPS] = { NULL, };
 static guint signals[LAST_SIGNAL] = { 0 };
 
+/* Weight of the overall average when estimating the size of
+ * a section's items, in items. Keeps sections with only a few
+ * measured items from swinging the estimate around.
+ */
+#define SECTION_ESTIMATE_PRIOR 4
+
+static int
+gtk_list_view_get_tile_size (GtkListTile *tile,
+                             int          row_height,
+                             int          spacing)
+{
+  return tile->measured_size
+         + row_height * (int) (tile->n_items - tile->n_measured)
+         + spacing * (tile->n_items - 1);
+}
+
 static GtkListTile *
 gtk_list_view_split (GtkListBase *base,
                      GtkListTile *tile,
@@ -182,20 +199,24 @@ gtk_list_view_split (GtkListBase *base,
   int spacing, row_height;
 
   gtk_list_base_get_border_spacing (GTK_LIST_BASE (self), NULL, &spacing);
-  row_height = (tile->area.height - (tile->n_items - 1) * spacing) / tile->n_items;
+  if (tile->n_items > tile->n_measured)
+    row_height = MAX (0, (tile->area.height - (int) (tile->n_items - 1) * spacing - tile->measured_size)
+                         / (int) (tile->n_items - tile->n_measured));
+  else
+    row_height = 0;
 
   new_tile = gtk_list_tile_split (self->item_manager, tile, n_items);
   gtk_list_tile_set_area_size (self->item_manager,
                                tile,
                                tile->area.width,
-                               row_height * tile->n_items + spacing * (tile->n_items - 1));
+                               gtk_list_view_get_tile_size (tile, row_height, spacing));
   gtk_list_tile_set_area (self->item_manager,
                           new_tile,
                           &(GdkRectangle) {
                             tile->area.x,
                             tile->area.y + tile->area.height + spacing,
                             tile->area.width,
-                            row_height * new_tile->n_items + spacing * (new_tile->n_items - 1)
+                            gtk_list_view_get_tile_size (new_tile, row_height, spacing)
                           });
 
   return new_tile;
@@ -484,6 +505,44 @@ gtk_list_view_get_unknown_row_height (GtkListView *self,
   return g_array_index (heights, int, heights->len / 2);
 }
 
+/* The average size of all items we have measured so far. As the
+ * number of measured items grows, this changes less and less, so
+ * the estimated size of the list - and with it the scrollbar -
+ * stays stable while scrolling.
+ */
+static int
+gtk_list_view_get_average_row_height (GtkListView *self)
+{
+  GtkListTileAugment *aug;
+  GtkListTile *root;
+
+  root = gtk_list_item_manager_get_root (self->item_manager);
+  if (root == NULL)
+    return 0;
+
+  aug = gtk_list_tile_get_augment (self->item_manager, root);
+  if (aug->n_measured == 0)
+    return 0;
+
+  return aug->measured_size / aug->n_measured;
+}
+
+static int
+gtk_list_view_get_section_row_height (GtkListView *self,
+                                      GtkListTile *header,
+                                      int          average_height)
+{
+  gint64 measured_size;
+  guint n_measured;
+
+  gtk_list_tile_get_section_measured_size (self->item_manager, header, &n_measured, &measured_size);
+
+  /* Lean on the overall average until the section has enough
+   * measured items of its own. */
+  return (measured_size + (gint64) SECTION_ESTIMATE_PRIOR * average_height)
+         / (n_measured + SECTION_ESTIMATE_PRIOR);
+}
+
 static void
 gtk_list_view_measure_across (GtkWidget      *widget,
                               GtkOrientation  orientation,
@@ -529,7 +588,7 @@ gtk_list_view_measure_list (GtkWidget      *widget,
 {
   GtkListView *self = GTK_LIST_VIEW (widget);
   GtkListTile *tile;
-  int min, nat, child_min, child_nat, spacing;
+  int min, nat, child_min, child_nat, spacing, average_height, row_height;
   GArray *min_heights, *nat_heights;
   guint n_unknown, n_items;
 
@@ -544,10 +603,19 @@ gtk_list_view_measure_list (GtkWidget      *widget,
   min = 0;
   nat = 0;
 
+  /* Estimate unknown rows the same way size_allocate() does, so the
+   * size doesn't change when they are allocated. Without remembered
+   * sizes, fall back to the median of the current rows. */
+  average_height = gtk_list_view_get_average_row_height (self);
+  row_height = average_height;
+
   for (tile = gtk_list_item_manager_get_first (self->item_manager);
        tile != NULL;
        tile = gtk_rb_tree_node_get_next (tile))
     {
+      if (average_height > 0 && gtk_list_tile_is_header (tile))
+        row_height = gtk_list_view_get_section_row_height (self, tile, average_height);
+
       if (tile->widget)
         {
           gtk_widget_measure (tile->widget,
@@ -561,6 +629,12 @@ gtk_list_view_measure_list (GtkWidget      *widget,
           min += child_min;
           nat += child_nat;
         }
+      else if (average_height > 0)
+        {
+          child_min = gtk_list_view_get_tile_size (tile, row_height, 0);
+          min += child_min;
+          nat += child_min;
+        }
       else
         {
           n_unknown += tile->n_items;
@@ -604,8 +678,7 @@ gtk_list_view_size_allocate (GtkWidget *widget,
 {
   GtkListView *self = GTK_LIST_VIEW (widget);
   GtkListTile *tile;
-  GArray *heights;
-  int min, nat, row_height, y, list_width, spacing;
+  int min, nat, row_height, average_height, y, list_width, spacing;
   GtkOrientation orientation, opposite_orientation;
   GtkScrollablePolicy scroll_policy, opposite_scroll_policy;
 
@@ -635,8 +708,19 @@ gtk_list_view_size_allocate (GtkWidget *widget,
   else
     list_width = MAX (nat, list_width);
 
-  /* step 2: determine height of known list items and gc the list */
-  heights = g_array_new (FALSE, FALSE, sizeof (int));
+  /* step 2: determine height of known list items and remember them */
+  if (list_width != self->measured_for_size || scroll_policy != self->measured_policy)
+    {
+      /* Remembered sizes are for a different width, forget them */
+      for (;
+           tile != NULL;
+           tile = gtk_rb_tree_node_get_next (tile))
+        gtk_list_tile_clear_measured_size (self->item_manager, tile);
+
+      self->measured_for_size = list_width;
+      self->measured_policy = scroll_policy;
+      tile = gtk_list_item_manager_get_first (self->item_manager);
+    }
 
   for (;
        tile != NULL;
@@ -653,27 +737,30 @@ gtk_list_view_size_allocate (GtkWidget *widget,
       else
         row_height = nat;
       gtk_list_tile_set_area_size (self->item_manager, tile, list_width, row_height);
-      if (tile->type == GTK_LIST_TILE_ITEM)
-        g_array_append_val (heights, row_height);
+      /* Placeholders are measured again once they are bound */
+      if (tile->type == GTK_LIST_TILE_ITEM && !gtk_list_tile_is_placeholder (tile))
+        gtk_list_tile_set_measured_size (self->item_manager, tile, row_height);
     }
 
-  /* step 3: determine height of unknown items and set the positions */
-  row_height = gtk_list_view_get_unknown_row_height (self, heights);
-  g_array_free (heights, TRUE);
+  /* step 3: estimate height of unknown items and set the positions */
+  average_height = gtk_list_view_get_average_row_height (self);
+  row_height = average_height;
 
   y = 0;
   for (tile = gtk_list_item_manager_get_first (self->item_manager);
        tile != NULL;
        tile = gtk_rb_tree_node_get_next (tile))
     {
+      if (gtk_list_tile_is_header (tile))
+        row_height = gtk_list_view_get_section_row_height (self, tile, average_height);
+
       gtk_list_tile_set_area_position (self->item_manager, tile, 0, y);
       if (tile->widget == NULL)
         {
           gtk_list_tile_set_area_size (self->item_manager,
                                        tile,
                                        list_width,
-                                       row_height * tile->n_items
-                                       + spacing * (tile->n_items - 1));
+                                       gtk_list_view_get_tile_size (tile, row_height, spacing));
         }
 
       y += tile->area.height + spacing;
@@ -750,6 +837,10 @@ gtk_list_view_get_property (GObject    *object,
 
   switch (property_id)
     {
+    case PROP_BIND_BUDGET:
+      g_value_set_uint (value, gtk_list_item_manager_get_bind_budget (self->item_manager));
+      break;
+
     case PROP_ENABLE_RUBBERBAND:
       g_value_set_boolean (value, gtk_list_base_get_enable_rubberband (GTK_LIST_BASE (self)));
       break;
@@ -794,6 +885,10 @@ gtk_list_view_set_property (GObject      *object,
 
   switch (property_id)
     {
+    case PROP_BIND_BUDGET:
+      gtk_list_view_set_bind_budget (self, g_value_get_uint (value));
+      break;
+
     case PROP_ENABLE_RUBBERBAND:
       gtk_list_view_set_enable_rubberband (self, g_value_get_boolean (value));
       break;
@@ -874,6 +969,25 @@ gtk_list_view_class_init (GtkListViewClass *klass)
   gobject_class->get_property = gtk_list_view_get_property;
   gobject_class->set_property = gtk_list_view_set_property;
 
+  /**
+   * GtkListView:bind-budget:
+   *
+   * Time in microseconds that may be spent per frame binding items.
+   *
+   * Items that don't fit into the budget are shown as placeholders
+   * with the `.placeholder` style class and are bound in the
+   * following frames. This keeps scrolling smooth when binding
+   * items is expensive.
+   *
+   * If set to 0, all items are bound right away.
+   *
+   * Since: 4.18
+   */
+  properties[PROP_BIND_BUDGET] =
+    g_param_spec_uint ("bind-budget", NULL, NULL,
+                       0, G_MAXUINT, 0,
+                       G_PARAM_READWRITE | G_PARAM_EXPLICIT_NOTIFY);
+
   /**
    * GtkListView:enable-rubberband:
    *
@@ -1000,6 +1114,7 @@ static void
 gtk_list_view_init (GtkListView *self)
 {
   self->item_manager = gtk_list_base_get_manager (GTK_LIST_BASE (self));
+  self->measured_for_size = -1;
 
   gtk_list_base_set_anchor_max_widgets (GTK_LIST_BASE (self),
                                         GTK_LIST_VIEW_MAX_LIST_ITEMS,
@@ -1319,6 +1434,49 @@ gtk_list_view_get_enable_rubberband (GtkListView *self)
   return gtk_list_base_get_enable_rubberband (GTK_LIST_BASE (self));
 }
 
+/**
+ * gtk_list_view_set_bind_budget:
+ * @self: a `GtkListView`
+ * @budget: time in microseconds, or 0 for no limit
+ *
+ * Sets how much time per frame may be spent binding items.
+ *
+ * See [property@Gtk.ListView:bind-budget].
+ *
+ * Since: 4.18
+ */
+void
+gtk_list_view_set_bind_budget (GtkListView *self,
+                              guint        budget)
+{
+  g_return_if_fail (GTK_IS_LIST_VIEW (self));
+
+  if (budget == gtk_list_item_manager_get_bind_budget (self->item_manager))
+    return;
+
+  gtk_list_item_manager_set_bind_budget (self->item_manager, budget);
+
+  g_object_notify_by_pspec (G_OBJECT (self), properties[PROP_BIND_BUDGET]);
+}
+
+/**
+ * gtk_list_view_get_bind_budget:
+ * @self: a `GtkListView`
+ *
+ * Gets the time per frame that may be spent binding items.
+ *
+ * Returns: The bind budget in microseconds
+ *
+ * Since: 4.18
+ */
+guint
+gtk_list_view_get_bind_budget (GtkListView *self)
+{
+  g_return_val_if_fail (GTK_IS_LIST_VIEW (self), 0);
+
+  return gtk_list_item_manager_get_bind_budget (self->item_manager);
+}
+
 /**
  * gtk_list_view_set_tab_behavior:
  * @self: a `GtkListView`
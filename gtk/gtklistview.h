@@ -89,6 +89,12 @@ GDK_AVAILABLE_IN_4_12
 GtkListTabBehavior
                 gtk_list_view_get_tab_behavior                  (GtkListView            *self);
 
+GDK_AVAILABLE_IN_4_18
+void            gtk_list_view_set_bind_budget                   (GtkListView            *self,
+                                                                 guint                   budget);
+GDK_AVAILABLE_IN_4_18
+guint           gtk_list_view_get_bind_budget                   (GtkListView            *self);
+
 GDK_AVAILABLE_IN_4_12
 void            gtk_list_view_scroll_to                         (GtkListView            *self,
                                                                  guint                   pos,
@@ -33,6 +33,10 @@ struct _GtkListView
   GtkListItemFactory *header_factory;
   gboolean show_separators;
   gboolean single_click_activate;
+
+  /* what the remembered item sizes were measured for */
+  int measured_for_size;
+  GtkScrollablePolicy measured_policy;
 };
 
 struct _GtkListViewClass
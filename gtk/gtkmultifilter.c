@@ -22,6 +22,7 @@
 #include "gtkmultifilter.h"
 
 #include "gtkbuildable.h"
+#include "gtkfilterprivate.h"
 #include "gtktypebuiltins.h"
 
 #define GDK_ARRAY_TYPE_NAME GtkFilters
@@ -148,6 +149,34 @@ gtk_multi_filter_changed_cb (GtkFilter       *filter,
   gtk_filter_changed (GTK_FILTER (self), change);
 }
 
+/* Copies all the filters. The copy is never changed, so it
+ * doesn't need to listen to them.
+ */
+static GtkFilter *
+gtk_multi_filter_copy_thread_safe (GtkFilter *filter)
+{
+  GtkMultiFilter *self = GTK_MULTI_FILTER (filter);
+  GtkMultiFilter *copy;
+  guint i;
+
+  copy = g_object_new (G_OBJECT_TYPE (self), NULL);
+
+  for (i = 0; i < gtk_filters_get_size (&self->filters); i++)
+    {
+      GtkFilter *child = gtk_filter_copy_thread_safe (gtk_filters_get (&self->filters, i));
+
+      if (child == NULL)
+        {
+          g_object_unref (copy);
+          return NULL;
+        }
+
+      gtk_filters_append (&copy->filters, child);
+    }
+
+  return GTK_FILTER (copy);
+}
+
 static void
 gtk_multi_filter_get_property (GObject    *object,
                                guint       prop_id,
@@ -360,6 +389,7 @@ gtk_any_filter_class_init (GtkAnyFilterClass *class)
 
   filter_class->match = gtk_any_filter_match;
   filter_class->get_strictness = gtk_any_filter_get_strictness;
+  gtk_filter_class_set_thread_safe_copy (filter_class, gtk_multi_filter_copy_thread_safe);
 }
 
 static void
@@ -458,6 +488,7 @@ gtk_every_filter_class_init (GtkEveryFilterClass *class)
 
   filter_class->match = gtk_every_filter_match;
   filter_class->get_strictness = gtk_every_filter_get_strictness;
+  gtk_filter_class_set_thread_safe_copy (filter_class, gtk_multi_filter_copy_thread_safe);
 }
 
 static void
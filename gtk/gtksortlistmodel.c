@@ -28,6 +28,8 @@
 #include "gtksorterprivate.h"
 #include "timsort/gtktimsortprivate.h"
 
+#include "gdk/gdkparalleltaskprivate.h"
+
 /* The maximum amount of items to merge for a single merge step
  *
  * Making this smaller will result in more steps, which has more overhead and slows
@@ -53,6 +55,17 @@
  */
 #define GTK_SORT_STEP_TIME_US (1000) /* 1 millisecond */
 
+/* Lists with at least this many items are sorted on multiple threads
+ * if the sort keys allow it. For smaller lists, the overhead of
+ * distributing the work is not worth it.
+ */
+#define GTK_SORT_PARALLEL_MIN_ITEMS (16 * 1024)
+
+/* The number of items each thread sorts before the sorted chunks
+ * get merged.
+ */
+#define GTK_SORT_PARALLEL_CHUNK_SIZE (4 * 1024)
+
 /**
  * GtkSortListModel:
  *
@@ -70,6 +83,10 @@
  * sorting long lists doesn't block the UI. See
  * [method@Gtk.SortListModel.set_incremental] for details.
  *
+ * Long lists are sorted using multiple threads when the sorter allows
+ * it, which is the case for [class@Gtk.StringSorter], [class@Gtk.NumericSorter]
+ * and [class@Gtk.MultiSorter]s made from them.
+ *
  * `GtkSortListModel` is a generic model and because of that it
  * cannot take advantage of any external knowledge when sorting.
  * If you run into performance issues with `GtkSortListModel`,
@@ -96,6 +113,8 @@ enum {
   NUM_PROPERTIES
 };
 
+typedef struct _SortTask SortTask;
+
 struct _GtkSortListModel
 {
   GObject parent_instance;
@@ -108,6 +127,7 @@ struct _GtkSortListModel
 
   GtkTimSort sort; /* ongoing sort operation */
   guint sort_cb; /* 0 or current ongoing sort callback */
+  SortTask *sort_task; /* NULL or sort running in a thread */
 
   guint n_items;
   GtkSortKeys *sort_keys;
@@ -126,6 +146,29 @@ struct _GtkSortListModelClass
 
 static GParamSpec *properties[NUM_PROPERTIES] = { NULL, };
 
+/* A sort of a copy of the positions array, using multiple threads.
+ *
+ * Only the keys are looked at, so this can happen while the main
+ * thread keeps using the model. Anything that changes the keys
+ * must cancel the task first.
+ */
+struct _SortTask
+{
+  GtkSortListModel *self; /* NULL once the model doesn't care anymore */
+
+  GtkSortKeys *sort_keys;
+  gpointer *positions;
+  gpointer *tmp;
+  gsize n_items;
+  gsize merge_width;
+
+  int cancelled; /* atomic */
+
+  GMutex lock;
+  GCond cond;
+  gboolean done;
+};
+
 static guint
 pos_from_key (GtkSortListModel *self,
               gpointer          key)
@@ -325,7 +368,7 @@ gtk_sort_list_model_get_section (GtkSectionModel *model,
    * The fast path is O(log N) and will be used for I guess
    * 99% of cases.
    */
-  if (self->sort_cb)
+  if (self->sort_cb || self->sort_task)
     gtk_sort_list_model_get_section_unsorted (self, position, out_start, out_end);
   else
     gtk_sort_list_model_get_section_sorted (self, position, out_start, out_end);
@@ -341,17 +384,328 @@ G_DEFINE_TYPE_WITH_CODE (GtkSortListModel, gtk_sort_list_model, G_TYPE_OBJECT,
                          G_IMPLEMENT_INTERFACE (G_TYPE_LIST_MODEL, gtk_sort_list_model_model_init)
                          G_IMPLEMENT_INTERFACE (GTK_TYPE_SECTION_MODEL, gtk_sort_list_model_section_model_init))
 
+static int
+sort_func (gconstpointer a,
+           gconstpointer b,
+           gpointer      data)
+{
+  gpointer *sa = (gpointer *) a;
+  gpointer *sb = (gpointer *) b;
+  int result;
+
+  result = gtk_sort_keys_compare (data, *sa, *sb);
+  if (result)
+    return result;
+
+  return *sa < *sb ? -1 : 1;
+}
+
+/* When parts of the list are known to be sorted already, merging
+ * them is cheaper than sorting everything again.
+ */
+static gboolean
+gtk_sort_list_model_can_sort_parallel (GtkSortListModel *self)
+{
+  return self->n_items >= GTK_SORT_PARALLEL_MIN_ITEMS &&
+         self->sort.pending_runs == 0 &&
+         gtk_sort_keys_is_thread_safe (self->sort_keys);
+}
+
+static void
+sort_task_sort_chunks (gsize    start,
+                       gsize    end,
+                       gpointer data)
+{
+  SortTask *task = data;
+  gsize i, offset;
+
+  for (i = start; i < end; i++)
+    {
+      if (g_atomic_int_get (&task->cancelled))
+        return;
+
+      offset = i * GTK_SORT_PARALLEL_CHUNK_SIZE;
+      gtk_tim_sort (task->positions + offset,
+                    MIN (GTK_SORT_PARALLEL_CHUNK_SIZE, task->n_items - offset),
+                    sizeof (gpointer),
+                    sort_func,
+                    task->sort_keys);
+    }
+}
+
+static void
+sort_task_merge_chunks (gsize    start,
+                        gsize    end,
+                        gpointer data)
+{
+  SortTask *task = data;
+  gsize i;
+
+  for (i = start; i < end; i++)
+    {
+      gpointer *a, *a_end, *b, *b_end, *out;
+      gsize lo, mid, hi;
+      guint n = 0;
+
+      lo = i * 2 * task->merge_width;
+      mid = MIN (lo + task->merge_width, task->n_items);
+      hi = MIN (mid + task->merge_width, task->n_items);
+
+      a = task->positions + lo;
+      a_end = task->positions + mid;
+      b = a_end;
+      b_end = task->positions + hi;
+      out = task->tmp + lo;
+
+      while (a < a_end && b < b_end)
+        {
+          /* sort_func never returns 0, so this keeps the order stable */
+          if (sort_func (a, b, task->sort_keys) < 0)
+            *out++ = *a++;
+          else
+            *out++ = *b++;
+
+          if ((++n & 0xFFF) == 0 && g_atomic_int_get (&task->cancelled))
+            return;
+        }
+
+      memcpy (out, a, (a_end - a) * sizeof (gpointer));
+      out += a_end - a;
+      memcpy (out, b, (b_end - b) * sizeof (gpointer));
+    }
+}
+
+/* Sorts task->positions by sorting chunks in parallel and then
+ * merging them pairwise, again in parallel.
+ * Returns %FALSE if the task was cancelled.
+ */
+static gboolean
+sort_task_run (SortTask *task)
+{
+  gsize n_chunks;
+
+  n_chunks = (task->n_items + GTK_SORT_PARALLEL_CHUNK_SIZE - 1) / GTK_SORT_PARALLEL_CHUNK_SIZE;
+  gdk_parallel_for (n_chunks, 1, sort_task_sort_chunks, task);
+
+  for (task->merge_width = GTK_SORT_PARALLEL_CHUNK_SIZE;
+       task->merge_width < task->n_items;
+       task->merge_width *= 2)
+    {
+      gpointer *swap;
+
+      if (g_atomic_int_get (&task->cancelled))
+        return FALSE;
+
+      gdk_parallel_for ((task->n_items + 2 * task->merge_width - 1) / (2 * task->merge_width),
+                        1,
+                        sort_task_merge_chunks,
+                        task);
+
+      swap = task->positions;
+      task->positions = task->tmp;
+      task->tmp = swap;
+    }
+
+  return !g_atomic_int_get (&task->cancelled);
+}
+
+static SortTask *
+sort_task_new (GtkSortListModel *self)
+{
+  SortTask *task;
+
+  task = g_new0 (SortTask, 1);
+  task->self = self;
+  task->sort_keys = gtk_sort_keys_ref (self->sort_keys);
+  task->n_items = self->n_items;
+  task->positions = g_memdup2 (self->positions, sizeof (gpointer) * self->n_items);
+  task->tmp = g_new (gpointer, self->n_items);
+  g_mutex_init (&task->lock);
+  g_cond_init (&task->cond);
+
+  return task;
+}
+
+static void
+sort_task_free (SortTask *task)
+{
+  gtk_sort_keys_unref (task->sort_keys);
+  g_free (task->positions);
+  g_free (task->tmp);
+  g_mutex_clear (&task->lock);
+  g_cond_clear (&task->cond);
+  g_free (task);
+}
+
+/* Replaces the positions with the sorted ones and returns
+ * the range that changed.
+ */
+static void
+gtk_sort_list_model_apply_sort_task (GtkSortListModel *self,
+                                     SortTask         *task,
+                                     guint            *out_position,
+                                     guint            *out_n_items)
+{
+  guint start, end;
+
+  for (start = 0; start < self->n_items; start++)
+    {
+      if (self->positions[start] != task->positions[start])
+        break;
+    }
+  for (end = self->n_items; end > start; end--)
+    {
+      if (self->positions[end - 1] != task->positions[end - 1])
+        break;
+    }
+
+  g_free (self->positions);
+  self->positions = task->positions;
+  task->positions = NULL;
+
+  *out_position = end > start ? start : 0;
+  *out_n_items = end - start;
+}
+
+static void
+sort_task_thread (GTask        *gtask,
+                  gpointer      source_object,
+                  gpointer      task_data,
+                  GCancellable *cancellable)
+{
+  SortTask *task = task_data;
+
+  sort_task_run (task);
+
+  g_mutex_lock (&task->lock);
+  task->done = TRUE;
+  g_cond_signal (&task->cond);
+  g_mutex_unlock (&task->lock);
+
+  g_task_return_boolean (gtask, TRUE);
+}
+
+static void
+gtk_sort_list_model_sort_task_done (GObject      *source_object,
+                                    GAsyncResult *result,
+                                    gpointer      data)
+{
+  SortTask *task = g_task_get_task_data (G_TASK (result));
+  GtkSortListModel *self = task->self;
+  guint pos, n_items;
+
+  if (self == NULL)
+    return;
+
+  g_assert (self->sort_task == task);
+
+  gtk_sort_list_model_apply_sort_task (self, task, &pos, &n_items);
+  self->sort_task = NULL;
+  gtk_tim_sort_finish (&self->sort);
+
+  if (n_items)
+    g_list_model_items_changed (G_LIST_MODEL (self), pos, n_items, n_items);
+  g_object_notify_by_pspec (G_OBJECT (self), properties[PROP_PENDING]);
+}
+
+static void
+gtk_sort_list_model_start_sort_task (GtkSortListModel *self)
+{
+  GTask *gtask;
+
+  g_assert (self->sort_task == NULL);
+
+  self->sort_task = sort_task_new (self);
+
+  gtask = g_task_new (NULL, NULL, gtk_sort_list_model_sort_task_done, NULL);
+  g_task_set_source_tag (gtask, gtk_sort_list_model_start_sort_task);
+  g_task_set_static_name (gtask, "[gtk] gtk_sort_list_model_sort_task");
+  g_task_set_task_data (gtask, self->sort_task, (GDestroyNotify) sort_task_free);
+  g_task_run_in_thread (gtask, sort_task_thread);
+  g_object_unref (gtask);
+}
+
+/* Stops the thread from looking at the keys. This blocks until
+ * the thread notices, which happens quickly.
+ */
+static void
+gtk_sort_list_model_cancel_sort_task (GtkSortListModel *self)
+{
+  SortTask *task = self->sort_task;
+
+  if (task == NULL)
+    return;
+
+  g_atomic_int_set (&task->cancelled, TRUE);
+
+  g_mutex_lock (&task->lock);
+  while (!task->done)
+    g_cond_wait (&task->cond, &task->lock);
+  g_mutex_unlock (&task->lock);
+
+  /* The task will be freed when the GTask returns */
+  task->self = NULL;
+  self->sort_task = NULL;
+}
+
+/* Creates the missing keys until @end_time is reached.
+ * Returns %FALSE if it ran out of time before that.
+ */
+static gboolean
+gtk_sort_list_model_init_keys (GtkSortListModel *self,
+                               gboolean          finish,
+                               gint64            end_time)
+{
+  GtkBitsetIter iter;
+  guint pos;
+
+  for (gtk_bitset_iter_init_first (&iter, self->missing_keys, &pos);
+       gtk_bitset_iter_is_valid (&iter);
+       gtk_bitset_iter_next (&iter, &pos))
+    {
+      gpointer item = g_list_model_get_item (self->model, pos);
+      gtk_sort_keys_init_key (self->sort_keys, item, key_from_pos (self, pos));
+      g_object_unref (item);
+
+      if (g_get_monotonic_time () >= end_time && !finish)
+        {
+          gtk_bitset_remove_range_closed (self->missing_keys, 0, pos);
+          return FALSE;
+        }
+    }
+
+  gtk_bitset_remove_all (self->missing_keys);
+
+  return TRUE;
+}
+
+/* Sorts everything right now, using all threads */
+static void
+gtk_sort_list_model_sort_parallel (GtkSortListModel *self,
+                                   guint            *out_position,
+                                   guint            *out_n_items)
+{
+  SortTask *task;
+
+  gtk_sort_list_model_init_keys (self, TRUE, 0);
+
+  task = sort_task_new (self);
+  sort_task_run (task);
+  gtk_sort_list_model_apply_sort_task (self, task, out_position, out_n_items);
+  sort_task_free (task);
+}
+
 static gboolean
 gtk_sort_list_model_is_sorting (GtkSortListModel *self)
 {
-  return self->sort_cb != 0;
+  return self->sort_cb != 0 || self->sort_task != NULL;
 }
 
 static void
 gtk_sort_list_model_stop_sorting (GtkSortListModel *self,
                                   gsize            *runs)
 {
-  if (self->sort_cb == 0)
+  if (!gtk_sort_list_model_is_sorting (self))
     {
       if (runs)
         {
@@ -361,6 +715,9 @@ gtk_sort_list_model_stop_sorting (GtkSortListModel *self,
       return;
     }
 
+  /* A sort task doesn't touch self->sort, so the runs are still valid */
+  gtk_sort_list_model_cancel_sort_task (self);
+
   if (runs)
     gtk_tim_sort_get_runs (&self->sort, runs);
   gtk_tim_sort_finish (&self->sort);
@@ -384,27 +741,13 @@ gtk_sort_list_model_sort_step (GtkSortListModel *self,
 
   if (!gtk_bitset_is_empty (self->missing_keys))
     {
-      GtkBitsetIter iter;
-      guint pos;
-
-      for (gtk_bitset_iter_init_first (&iter, self->missing_keys, &pos);
-           gtk_bitset_iter_is_valid (&iter);
-           gtk_bitset_iter_next (&iter, &pos))
+      if (!gtk_sort_list_model_init_keys (self, finish, end_time))
         {
-          gpointer item = g_list_model_get_item (self->model, pos);
-          gtk_sort_keys_init_key (self->sort_keys, item, key_from_pos (self, pos));
-          g_object_unref (item);
-
-          if (g_get_monotonic_time () >= end_time && !finish)
-            {
-              gtk_bitset_remove_range_closed (self->missing_keys, 0, pos);
-              *out_position = 0;
-              *out_n_items = 0;
-              return TRUE;
-            }
+          *out_position = 0;
+          *out_n_items = 0;
+          return TRUE;
         }
       result = TRUE;
-      gtk_bitset_remove_all (self->missing_keys);
     }
 
   end_change = self->positions;
@@ -443,6 +786,20 @@ gtk_sort_list_model_sort_cb (gpointer data)
   GtkSortListModel *self = data;
   guint pos, n_items;
 
+  /* Create the keys here, and leave the sorting to other threads */
+  if (gtk_sort_list_model_can_sort_parallel (self))
+    {
+      if (!gtk_sort_list_model_init_keys (self, FALSE, g_get_monotonic_time () + GTK_SORT_STEP_TIME_US))
+        {
+          g_object_notify_by_pspec (G_OBJECT (self), properties[PROP_PENDING]);
+          return G_SOURCE_CONTINUE;
+        }
+
+      self->sort_cb = 0;
+      gtk_sort_list_model_start_sort_task (self);
+      return G_SOURCE_REMOVE;
+    }
+
   if (gtk_sort_list_model_sort_step (self, FALSE, &pos, &n_items))
     {
       if (n_items)
@@ -455,22 +812,6 @@ gtk_sort_list_model_sort_cb (gpointer data)
   return G_SOURCE_REMOVE;
 }
 
-static int
-sort_func (gconstpointer a,
-           gconstpointer b,
-           gpointer      data)
-{
-  gpointer *sa = (gpointer *) a;
-  gpointer *sb = (gpointer *) b;
-  int result;
-
-  result = gtk_sort_keys_compare (data, *sa, *sb);
-  if (result)
-    return result;
-
-  return *sa < *sb ? -1 : 1;
-}
-
 static gboolean
 gtk_sort_list_model_start_sorting (GtkSortListModel *self,
                                    gsize            *runs)
@@ -502,12 +843,24 @@ gtk_sort_list_model_finish_sorting (GtkSortListModel *self,
                                     guint            *pos,
                                     guint            *n_items)
 {
-  gtk_tim_sort_set_max_merge_size (&self->sort, 0);
+  gboolean had_task = self->sort_task != NULL;
+
+  gtk_sort_list_model_cancel_sort_task (self);
 
-  gtk_sort_list_model_sort_step (self, TRUE, pos, n_items);
+  if (gtk_sort_list_model_can_sort_parallel (self))
+    {
+      gtk_sort_list_model_sort_parallel (self, pos, n_items);
+    }
+  else
+    {
+      gtk_tim_sort_set_max_merge_size (&self->sort, 0);
+      gtk_sort_list_model_sort_step (self, TRUE, pos, n_items);
+    }
   gtk_tim_sort_finish (&self->sort);
 
   gtk_sort_list_model_stop_sorting (self, NULL);
+  if (had_task)
+    g_object_notify_by_pspec (G_OBJECT (self), properties[PROP_PENDING]);
 }
 
 static void
@@ -1305,6 +1658,10 @@ gtk_sort_list_model_get_section_sorter (GtkSortListModel *self)
  * turning this on. Depending on your model and sorters, this may become
  * interesting around 10,000 to 100,000 items.
  *
+ * For sorters that support sorting in other threads, only the sort
+ * keys are created incrementally. The items are then sorted in other
+ * threads, and moved to their correct position all at once.
+ *
  * By default, incremental sorting is disabled.
  *
  * See [method@Gtk.SortListModel.get_pending] for progress information
@@ -1380,9 +1737,13 @@ gtk_sort_list_model_get_pending (GtkSortListModel *self)
 {
   g_return_val_if_fail (GTK_IS_SORT_LIST_MODEL (self), FALSE);
 
-  if (self->sort_cb == 0)
+  if (!gtk_sort_list_model_is_sorting (self))
     return 0;
 
+  /* Sorting in threads doesn't report progress */
+  if (self->sort_task)
+    return self->n_items / 2;
+
   /* We do a random guess that 50% of time is spent generating keys
    * and the other 50% is spent actually sorting.
    *
@@ -21,8 +21,11 @@
 
 #include "gtkstringfilter.h"
 
+#include "gtkfilterprivate.h"
 #include "gtktypebuiltins.h"
 
+#include <string.h>
+
 /**
  * GtkStringFilter:
  *
@@ -38,19 +41,42 @@
  *
  * It is also possible to make case-insensitive comparisons, with
  * [method@Gtk.StringFilter.set_ignore_case].
+ *
+ * The filter remembers the normalized strings of the items it has
+ * seen, so changing the search term does not need to evaluate the
+ * expression again. The expression is watched to notice when an
+ * item's string changes.
  */
 
+typedef struct _GtkStringFilterKey GtkStringFilterKey;
+
 struct _GtkStringFilter
 {
   GtkFilter parent_instance;
 
   char *search;
   char *search_prepared;
+  gsize search_len;
 
   gboolean ignore_case;
   GtkStringFilterMatchMode match_mode;
 
   GtkExpression *expression;
+
+  GHashTable *keys; /* item => GtkStringFilterKey */
+  gboolean uncached; /* thread-safe copies must not touch keys */
+};
+
+/* The prepared string of an item, kept until the item goes away */
+struct _GtkStringFilterKey
+{
+  GtkStringFilter *self; /* NULL when no longer in self->keys */
+  gpointer item;
+  GtkExpressionWatch *watch;
+
+  gboolean valid;
+  char *prepared;
+  gsize prepared_len;
 };
 
 enum {
@@ -87,6 +113,14 @@ gtk_string_filter_prepare (GtkStringFilter *self,
   return result;
 }
 
+static void
+gtk_string_filter_set_search_prepared (GtkStringFilter *self)
+{
+  g_free (self->search_prepared);
+  self->search_prepared = gtk_string_filter_prepare (self, self->search);
+  self->search_len = self->search_prepared ? strlen (self->search_prepared) : 0;
+}
+
 /* This is necessary because code just looks at self->search otherwise
  * and that can be the empty string...
  */
@@ -96,6 +130,167 @@ gtk_string_filter_has_search (GtkStringFilter *self)
   return self->search_prepared != NULL;
 }
 
+static void
+gtk_string_filter_key_invalidate (gpointer data)
+{
+  GtkStringFilterKey *key = data;
+
+  key->valid = FALSE;
+  g_clear_pointer (&key->prepared, g_free);
+}
+
+/* Called when the watch goes away, either because the item was
+ * finalized or because we dropped the key.
+ */
+static void
+gtk_string_filter_key_free (gpointer data)
+{
+  GtkStringFilterKey *key = data;
+
+  if (key->self)
+    g_hash_table_remove (key->self->keys, key->item);
+
+  g_free (key->prepared);
+  g_free (key);
+}
+
+static void
+gtk_string_filter_invalidate_keys (GtkStringFilter *self)
+{
+  GHashTableIter iter;
+  gpointer key;
+
+  if (self->keys == NULL)
+    return;
+
+  g_hash_table_iter_init (&iter, self->keys);
+  while (g_hash_table_iter_next (&iter, NULL, &key))
+    gtk_string_filter_key_invalidate (key);
+}
+
+static void
+gtk_string_filter_clear_keys (GtkStringFilter *self)
+{
+  GHashTableIter iter;
+  GPtrArray *keys;
+  gpointer data;
+  guint i;
+
+  if (self->keys == NULL || g_hash_table_size (self->keys) == 0)
+    return;
+
+  keys = g_ptr_array_sized_new (g_hash_table_size (self->keys));
+
+  g_hash_table_iter_init (&iter, self->keys);
+  while (g_hash_table_iter_next (&iter, NULL, &data))
+    {
+      GtkStringFilterKey *key = data;
+
+      key->self = NULL;
+      g_ptr_array_add (keys, key);
+    }
+  g_hash_table_remove_all (self->keys);
+
+  for (i = 0; i < keys->len; i++)
+    {
+      GtkStringFilterKey *key = g_ptr_array_index (keys, i);
+
+      gtk_expression_watch_unwatch (key->watch);
+    }
+
+  g_ptr_array_unref (keys);
+}
+
+static GtkStringFilterKey *
+gtk_string_filter_get_key (GtkStringFilter *self,
+                           gpointer         item)
+{
+  GtkStringFilterKey *key;
+
+  if (self->keys == NULL)
+    self->keys = g_hash_table_new (NULL, NULL);
+
+  key = g_hash_table_lookup (self->keys, item);
+  if (key == NULL)
+    {
+      key = g_new0 (GtkStringFilterKey, 1);
+      key->self = self;
+      key->item = item;
+      key->watch = gtk_expression_watch (self->expression,
+                                         item,
+                                         gtk_string_filter_key_invalidate,
+                                         key,
+                                         gtk_string_filter_key_free);
+      g_hash_table_insert (self->keys, item, key);
+    }
+
+  if (!key->valid)
+    {
+      GValue value = G_VALUE_INIT;
+
+      if (gtk_expression_evaluate (self->expression, item, &value))
+        {
+          key->prepared = gtk_string_filter_prepare (self, g_value_get_string (&value));
+          key->prepared_len = key->prepared ? strlen (key->prepared) : 0;
+          g_value_unset (&value);
+        }
+      key->valid = TRUE;
+    }
+
+  return key;
+}
+
+/* memchr() is vectorized by the C library, so we let it skip
+ * to the candidates and only compare the rest there.
+ */
+static gboolean
+find_substring (const char *haystack,
+                gsize       haystack_len,
+                const char *needle,
+                gsize       needle_len)
+{
+  const char *end;
+
+  if (needle_len > haystack_len)
+    return FALSE;
+
+  end = haystack + haystack_len - needle_len + 1;
+
+  while (haystack < end)
+    {
+      haystack = memchr (haystack, needle[0], end - haystack);
+      if (haystack == NULL)
+        return FALSE;
+
+      if (memcmp (haystack + 1, needle + 1, needle_len - 1) == 0)
+        return TRUE;
+
+      haystack++;
+    }
+
+  return FALSE;
+}
+
+static gboolean
+gtk_string_filter_match_prepared (GtkStringFilter *self,
+                                  const char      *prepared,
+                                  gsize            prepared_len)
+{
+  switch (self->match_mode)
+    {
+    case GTK_STRING_FILTER_MATCH_MODE_EXACT:
+      return prepared_len == self->search_len &&
+             memcmp (prepared, self->search_prepared, prepared_len) == 0;
+    case GTK_STRING_FILTER_MATCH_MODE_SUBSTRING:
+      return find_substring (prepared, prepared_len, self->search_prepared, self->search_len);
+    case GTK_STRING_FILTER_MATCH_MODE_PREFIX:
+      return prepared_len >= self->search_len &&
+             memcmp (prepared, self->search_prepared, self->search_len) == 0;
+    default:
+      g_assert_not_reached ();
+    }
+}
+
 static gboolean
 gtk_string_filter_match (GtkFilter *filter,
                          gpointer   item)
@@ -103,45 +298,57 @@ gtk_string_filter_match (GtkFilter *filter,
   GtkStringFilter *self = GTK_STRING_FILTER (filter);
   GValue value = G_VALUE_INIT;
   char *prepared;
-  const char *s;
   gboolean result;
 
   if (!gtk_string_filter_has_search (self))
     return TRUE;
 
-  if (self->expression == NULL ||
-      !gtk_expression_evaluate (self->expression, item, &value))
-    return FALSE;
-  s = g_value_get_string (&value);
-  prepared = gtk_string_filter_prepare (self, s);
-  if (prepared == NULL)
+  if (self->expression == NULL)
     return FALSE;
 
-  switch (self->match_mode)
+  if (!self->uncached && G_IS_OBJECT (item))
     {
-    case GTK_STRING_FILTER_MATCH_MODE_EXACT:
-      result = strcmp (prepared, self->search_prepared) == 0;
-      break;
-    case GTK_STRING_FILTER_MATCH_MODE_SUBSTRING:
-      result = strstr (prepared, self->search_prepared) != NULL;
-      break;
-    case GTK_STRING_FILTER_MATCH_MODE_PREFIX:
-      result = g_str_has_prefix (prepared, self->search_prepared);
-      break;
-    default:
-      g_assert_not_reached ();
+      GtkStringFilterKey *key = gtk_string_filter_get_key (self, item);
+
+      if (key->prepared == NULL)
+        return FALSE;
+
+      return gtk_string_filter_match_prepared (self, key->prepared, key->prepared_len);
     }
 
-#if 0
-  g_print ("%s (%s) %s %s (%s)\n", s, prepared, result ? "==" : "!=", self->search, self->search_prepared);
-#endif
+  if (!gtk_expression_evaluate (self->expression, item, &value))
+    return FALSE;
+  prepared = gtk_string_filter_prepare (self, g_value_get_string (&value));
+  g_value_unset (&value);
+  if (prepared == NULL)
+    return FALSE;
+
+  result = gtk_string_filter_match_prepared (self, prepared, strlen (prepared));
 
   g_free (prepared);
-  g_value_unset (&value);
 
   return result;
 }
 
+static GtkFilter *
+gtk_string_filter_copy_thread_safe (GtkFilter *filter)
+{
+  GtkStringFilter *self = GTK_STRING_FILTER (filter);
+  GtkStringFilter *copy;
+
+  copy = g_object_new (GTK_TYPE_STRING_FILTER, NULL);
+  copy->search = g_strdup (self->search);
+  copy->search_prepared = g_strdup (self->search_prepared);
+  copy->search_len = self->search_len;
+  copy->ignore_case = self->ignore_case;
+  copy->match_mode = self->match_mode;
+  if (self->expression)
+    copy->expression = gtk_expression_ref (self->expression);
+  copy->uncached = TRUE;
+
+  return GTK_FILTER (copy);
+}
+
 static GtkFilterMatch
 gtk_string_filter_get_strictness (GtkFilter *filter)
 {
@@ -225,6 +432,8 @@ gtk_string_filter_dispose (GObject *object)
 {
   GtkStringFilter *self = GTK_STRING_FILTER (object);
 
+  gtk_string_filter_clear_keys (self);
+  g_clear_pointer (&self->keys, g_hash_table_unref);
   g_clear_pointer (&self->search, g_free);
   g_clear_pointer (&self->search_prepared, g_free);
   g_clear_pointer (&self->expression, gtk_expression_unref);
@@ -240,6 +449,7 @@ gtk_string_filter_class_init (GtkStringFilterClass *class)
 
   filter_class->match = gtk_string_filter_match;
   filter_class->get_strictness = gtk_string_filter_get_strictness;
+  gtk_filter_class_set_thread_safe_copy (filter_class, gtk_string_filter_copy_thread_safe);
 
   object_class->get_property = gtk_string_filter_get_property;
   object_class->set_property = gtk_string_filter_set_property;
@@ -368,10 +578,8 @@ gtk_string_filter_set_search (GtkStringFilter *self,
     change = GTK_FILTER_CHANGE_DIFFERENT;
 
   g_free (self->search);
-  g_free (self->search_prepared);
-
   self->search = g_strdup (search);
-  self->search_prepared = gtk_string_filter_prepare (self, search);
+  gtk_string_filter_set_search_prepared (self);
 
   gtk_filter_changed (GTK_FILTER (self), change);
 
@@ -415,8 +623,10 @@ gtk_string_filter_set_expression (GtkStringFilter *self,
   if (self->expression == expression)
     return;
 
+  gtk_string_filter_clear_keys (self);
   g_clear_pointer (&self->expression, gtk_expression_unref);
-  self->expression = gtk_expression_ref (expression);
+  if (expression)
+    self->expression = gtk_expression_ref (expression);
 
   if (gtk_string_filter_has_search (self))
     gtk_filter_changed (GTK_FILTER (self), GTK_FILTER_CHANGE_DIFFERENT);
@@ -457,11 +667,11 @@ gtk_string_filter_set_ignore_case (GtkStringFilter *self,
     return;
 
   self->ignore_case = ignore_case;
+  gtk_string_filter_invalidate_keys (self);
 
   if (self->search)
     {
-      g_free (self->search_prepared);
-      self->search_prepared = gtk_string_filter_prepare (self, self->search);
+      gtk_string_filter_set_search_prepared (self);
       gtk_filter_changed (GTK_FILTER (self), ignore_case ? GTK_FILTER_CHANGE_LESS_STRICT : GTK_FILTER_CHANGE_MORE_STRICT);
     }
 
@@ -25,6 +25,8 @@
 #include "gtkbuilderprivate.h"
 #include "gtkprivate.h"
 
+#include <string.h>
+
 /**
  * GtkStringList:
  *
@@ -36,6 +38,13 @@
  * `GtkStringList` is well-suited for any place where you would
  * typically use a `char*[]`, but need a list model.
  *
+ * The strings are stored in large blocks of memory, and the
+ * [class@Gtk.StringObject]s are only created when they are requested
+ * and only kept around while they are in use. This makes it possible
+ * to use `GtkStringList` with millions of strings. See
+ * [ctor@Gtk.StringList.new_from_bytes] for a way to create such a
+ * list without copying the strings.
+ *
  * ## GtkStringList as GtkBuildable
  *
  * The `GtkStringList` implementation of the `GtkBuildable` interface
@@ -57,6 +66,78 @@
  * ```
  */
 
+/* {{{ String storage */
+
+/* A block of memory holding the strings of one or more rows.
+ *
+ * Every row and every string object using one of its strings holds
+ * a reference, so it is only freed once all of them are gone.
+ */
+typedef struct _GtkStringChunk GtkStringChunk;
+
+struct _GtkStringChunk
+{
+  int ref_count; /* atomic */
+  GBytes *bytes; /* if the strings are stored there */
+  char *owned; /* from gtk_string_list_take() */
+  char data[];
+};
+
+static GtkStringChunk *
+gtk_string_chunk_new (gsize size,
+                      int   ref_count)
+{
+  GtkStringChunk *chunk;
+
+  chunk = g_malloc (sizeof (GtkStringChunk) + size);
+  chunk->ref_count = ref_count;
+  chunk->bytes = NULL;
+  chunk->owned = NULL;
+
+  return chunk;
+}
+
+static GtkStringChunk *
+gtk_string_chunk_ref (GtkStringChunk *chunk)
+{
+  g_atomic_int_inc (&chunk->ref_count);
+
+  return chunk;
+}
+
+static void
+gtk_string_chunk_unref (GtkStringChunk *chunk)
+{
+  if (!g_atomic_int_dec_and_test (&chunk->ref_count))
+    return;
+
+  g_clear_pointer (&chunk->bytes, g_bytes_unref);
+  g_free (chunk->owned);
+  g_free (chunk);
+}
+
+typedef struct _GtkStringListRow GtkStringListRow;
+
+struct _GtkStringListRow
+{
+  const char *string;
+  GtkStringChunk *chunk;
+};
+
+static void
+gtk_string_list_row_clear (GtkStringListRow *row)
+{
+  gtk_string_chunk_unref (row->chunk);
+}
+
+#define GDK_ARRAY_ELEMENT_TYPE GtkStringListRow
+#define GDK_ARRAY_NAME rows
+#define GDK_ARRAY_TYPE_NAME Rows
+#define GDK_ARRAY_BY_VALUE 1
+#define GDK_ARRAY_FREE_FUNC gtk_string_list_row_clear
+#include "gdk/gdkarrayimpl.c"
+
+/* }}} */
 /* {{{ GtkStringObject */
 
 /**
@@ -69,18 +150,20 @@
  * for property bindings and expressions.
  */
 
-#define GDK_ARRAY_ELEMENT_TYPE GtkStringObject *
-#define GDK_ARRAY_NAME objects
-#define GDK_ARRAY_TYPE_NAME Objects
-#define GDK_ARRAY_FREE_FUNC g_object_unref
-#include "gdk/gdkarrayimpl.c"
-
 struct _GtkStringObject
 {
   GObject parent_instance;
   char *string;
+
+  GtkStringChunk *chunk; /* owns string if set */
+  GtkStringList *list; /* not referenced, set while it caches us */
 };
 
+/* Objects can be dropped on any thread, so the object caches
+ * and the list pointers of the objects are protected by this.
+ */
+G_LOCK_DEFINE_STATIC (objects);
+
 enum {
   PROP_STRING = 1,
   PROP_NUM_PROPERTIES
@@ -88,17 +171,40 @@ enum {
 
 G_DEFINE_TYPE (GtkStringObject, gtk_string_object, G_TYPE_OBJECT);
 
+static void gtk_string_list_forget_object (GtkStringList   *self,
+                                           GtkStringObject *object);
+
 static void
 gtk_string_object_init (GtkStringObject *object)
 {
 }
 
+/* This is done in dispose, not finalize, so that the list can
+ * still hand out the object while we wait for the lock. If that
+ * happens, it survives the unref and just isn't cached anymore.
+ */
+static void
+gtk_string_object_dispose (GObject *object)
+{
+  GtkStringObject *self = GTK_STRING_OBJECT (object);
+
+  G_LOCK (objects);
+  if (self->list)
+    gtk_string_list_forget_object (self->list, self);
+  G_UNLOCK (objects);
+
+  G_OBJECT_CLASS (gtk_string_object_parent_class)->dispose (object);
+}
+
 static void
 gtk_string_object_finalize (GObject *object)
 {
   GtkStringObject *self = GTK_STRING_OBJECT (object);
 
-  g_free (self->string);
+  if (self->chunk)
+    gtk_string_chunk_unref (self->chunk);
+  else
+    g_free (self->string);
 
   G_OBJECT_CLASS (gtk_string_object_parent_class)->finalize (object);
 }
@@ -129,6 +235,7 @@ gtk_string_object_class_init (GtkStringObjectClass *class)
   GObjectClass *object_class = G_OBJECT_CLASS (class);
   GParamSpec *pspec;
 
+  object_class->dispose = gtk_string_object_dispose;
   object_class->finalize = gtk_string_object_finalize;
   object_class->get_property = gtk_string_object_get_property;
 
@@ -157,6 +264,21 @@ gtk_string_object_new_take (char *string)
   return obj;
 }
 
+/* Uses the string of the row without copying it */
+static GtkStringObject *
+gtk_string_object_new_for_row (GtkStringList    *list,
+                               GtkStringListRow *row)
+{
+  GtkStringObject *obj;
+
+  obj = g_object_new (GTK_TYPE_STRING_OBJECT, NULL);
+  obj->string = (char *) row->string;
+  obj->chunk = gtk_string_chunk_ref (row->chunk);
+  obj->list = list;
+
+  return obj;
+}
+
 /**
  * gtk_string_object_new:
  * @string: (not nullable): The string to wrap
@@ -194,7 +316,10 @@ struct _GtkStringList
 {
   GObject parent_instance;
 
-  Objects items;
+  Rows items;
+
+  /* row string => GtkStringObject, not referenced */
+  GHashTable *objects;
 };
 
 struct _GtkStringListClass
@@ -213,19 +338,113 @@ gtk_string_list_get_n_items (GListModel *list)
 {
   GtkStringList *self = GTK_STRING_LIST (list);
 
-  return objects_get_size (&self->items);
+  return rows_get_size (&self->items);
 }
 
+/* Objects are only created on demand, and we keep track of them
+ * while they are alive so we can keep handing out the same one.
+ */
 static gpointer
 gtk_string_list_get_item (GListModel *list,
                           guint       position)
 {
   GtkStringList *self = GTK_STRING_LIST (list);
+  GtkStringListRow *row;
+  GtkStringObject *object;
 
-  if (position >= objects_get_size (&self->items))
+  if (position >= rows_get_size (&self->items))
     return NULL;
 
-  return g_object_ref (objects_get (&self->items, position));
+  row = rows_index (&self->items, position);
+
+  G_LOCK (objects);
+
+  if (self->objects == NULL)
+    self->objects = g_hash_table_new (NULL, NULL);
+
+  object = g_hash_table_lookup (self->objects, row->string);
+  if (object)
+    {
+      g_object_ref (object);
+    }
+  else
+    {
+      object = gtk_string_object_new_for_row (self, row);
+      g_hash_table_insert (self->objects, (gpointer) row->string, object);
+    }
+
+  G_UNLOCK (objects);
+
+  return object;
+}
+
+/* Must be called with the objects lock held */
+static void
+gtk_string_list_forget_object (GtkStringList   *self,
+                               GtkStringObject *object)
+{
+  g_hash_table_remove (self->objects, object->string);
+  object->list = NULL;
+}
+
+/* Copies the strings into a single chunk for the rows
+ * starting at @position, which must exist already.
+ */
+static void
+gtk_string_list_set_strings (GtkStringList      *self,
+                             guint               position,
+                             const char * const *strings,
+                             guint               n_strings)
+{
+  GtkStringChunk *chunk;
+  gsize size;
+  char *p;
+  guint i;
+
+  size = 0;
+  for (i = 0; i < n_strings; i++)
+    size += strlen (strings[i]) + 1;
+
+  chunk = gtk_string_chunk_new (size, n_strings);
+
+  p = chunk->data;
+  for (i = 0; i < n_strings; i++)
+    {
+      GtkStringListRow *row = rows_index (&self->items, position + i);
+      gsize len = strlen (strings[i]) + 1;
+
+      memcpy (p, strings[i], len);
+      row->string = p;
+      row->chunk = chunk;
+      p += len;
+    }
+}
+
+/* Called before rows go away, so that the objects for them are not
+ * found anymore. They keep their chunk alive.
+ */
+static void
+gtk_string_list_forget_rows (GtkStringList *self,
+                             guint          position,
+                             guint          n_rows)
+{
+  guint i;
+
+  if (self->objects == NULL)
+    return;
+
+  G_LOCK (objects);
+
+  for (i = 0; i < n_rows && g_hash_table_size (self->objects) > 0; i++)
+    {
+      GtkStringListRow *row = rows_index (&self->items, position + i);
+      GtkStringObject *object = g_hash_table_lookup (self->objects, row->string);
+
+      if (object)
+        gtk_string_list_forget_object (self, object);
+    }
+
+  G_UNLOCK (objects);
 }
 
 static void
@@ -428,7 +647,21 @@ gtk_string_list_dispose (GObject *object)
 {
   GtkStringList *self = GTK_STRING_LIST (object);
 
-  objects_clear (&self->items);
+  if (self->objects)
+    {
+      GHashTableIter iter;
+      gpointer value;
+
+      G_LOCK (objects);
+      g_hash_table_iter_init (&iter, self->objects);
+      while (g_hash_table_iter_next (&iter, NULL, &value))
+        ((GtkStringObject *) value)->list = NULL;
+
+      g_clear_pointer (&self->objects, g_hash_table_unref);
+      G_UNLOCK (objects);
+    }
+
+  rows_clear (&self->items);
 
   G_OBJECT_CLASS (gtk_string_list_parent_class)->dispose (object);
 }
@@ -529,7 +762,7 @@ gtk_string_list_class_init (GtkStringListClass *class)
 static void
 gtk_string_list_init (GtkStringList *self)
 {
-  objects_init (&self->items);
+  rows_init (&self->items);
 }
 
 /* }}} */
@@ -551,6 +784,73 @@ gtk_string_list_new (const char * const *strings)
                        NULL);
 }
 
+/**
+ * gtk_string_list_new_from_bytes:
+ * @bytes: the strings to put in the model
+ *
+ * Creates a new `GtkStringList` with the strings contained in @bytes.
+ *
+ * The data in @bytes must be a sequence of UTF-8 strings that are
+ * each terminated by a NUL byte. The strings are not copied, the
+ * model keeps a reference to @bytes instead.
+ *
+ * This is the fastest way to create a model with a very large
+ * number of strings. To use the strings in a file without reading
+ * it into memory, create @bytes with g_mapped_file_get_bytes().
+ *
+ * Returns: a new `GtkStringList`
+ *
+ * Since: 4.18
+ */
+GtkStringList *
+gtk_string_list_new_from_bytes (GBytes *bytes)
+{
+  GtkStringList *self;
+  const char *data, *end, *p, *nul;
+  GtkStringChunk *chunk;
+  gsize size;
+  guint i, n;
+
+  g_return_val_if_fail (bytes != NULL, NULL);
+
+  self = g_object_new (GTK_TYPE_STRING_LIST, NULL);
+
+  data = g_bytes_get_data (bytes, &size);
+  if (size == 0)
+    return self;
+  end = data + size;
+
+  n = 0;
+  for (p = data; (nul = memchr (p, '\0', end - p)) != NULL; p = nul + 1)
+    n++;
+
+  rows_splice (&self->items, 0, 0, FALSE, NULL, n);
+
+  if (n > 0)
+    {
+      chunk = gtk_string_chunk_new (0, n);
+      chunk->bytes = g_bytes_ref (bytes);
+
+      for (i = 0, p = data; i < n; i++, p += strlen (p) + 1)
+        {
+          GtkStringListRow *row = rows_index (&self->items, i);
+
+          row->string = p;
+          row->chunk = chunk;
+        }
+    }
+
+  /* be nice to files without a terminating NUL */
+  if (p < end)
+    {
+      chunk = gtk_string_chunk_new (0, 1);
+      chunk->owned = g_strndup (p, end - p);
+      rows_append (&self->items, &(GtkStringListRow) { chunk->owned, chunk });
+    }
+
+  return self;
+}
+
 /**
  * gtk_string_list_splice:
  * @self: a `GtkStringList`
@@ -565,7 +865,9 @@ gtk_string_list_new (const char * const *strings)
  * and [method@Gtk.StringList.remove], because it only emits the
  * ::items-changed signal once for the change.
  *
- * This function copies the strings in @additions.
+ * This function copies the strings in @additions. They are
+ * copied into a single block of memory, so splicing in many
+ * strings at once is much cheaper than appending them one by one.
  *
  * The parameters @position and @n_removals must be correct (ie:
  * @position + @n_removals must be less than or equal to the length
@@ -577,23 +879,22 @@ gtk_string_list_splice (GtkStringList      *self,
                         guint               n_removals,
                         const char * const *additions)
 {
-  guint i, n_additions;
+  guint n_additions;
 
   g_return_if_fail (GTK_IS_STRING_LIST (self));
   g_return_if_fail (position + n_removals >= position); /* overflow */
-  g_return_if_fail (position + n_removals <= objects_get_size (&self->items));
+  g_return_if_fail (position + n_removals <= rows_get_size (&self->items));
 
   if (additions)
     n_additions = g_strv_length ((char **) additions);
   else
     n_additions = 0;
 
-  objects_splice (&self->items, position, n_removals, FALSE, NULL, n_additions);
+  gtk_string_list_forget_rows (self, position, n_removals);
+  rows_splice (&self->items, position, n_removals, FALSE, NULL, n_additions);
 
-  for (i = 0; i < n_additions; i++)
-    {
-      *objects_index (&self->items, position + i) = gtk_string_object_new (additions[i]);
-    }
+  if (n_additions > 0)
+    gtk_string_list_set_strings (self, position, additions, n_additions);
 
   if (n_removals || n_additions)
     g_list_model_items_changed (G_LIST_MODEL (self), position, n_removals, n_additions);
@@ -616,11 +917,15 @@ void
 gtk_string_list_append (GtkStringList *self,
                         const char    *string)
 {
+  guint position;
+
   g_return_if_fail (GTK_IS_STRING_LIST (self));
 
-  objects_append (&self->items, gtk_string_object_new (string));
+  position = rows_get_size (&self->items);
+  rows_splice (&self->items, position, 0, FALSE, NULL, 1);
+  gtk_string_list_set_strings (self, position, (const char * const *) &string, 1);
 
-  g_list_model_items_changed (G_LIST_MODEL (self), objects_get_size (&self->items) - 1, 0, 1);
+  g_list_model_items_changed (G_LIST_MODEL (self), position, 0, 1);
   g_object_notify_by_pspec (G_OBJECT (self), properties[PROP_N_ITEMS]);
 }
 
@@ -643,11 +948,15 @@ void
 gtk_string_list_take (GtkStringList *self,
                       char          *string)
 {
+  GtkStringChunk *chunk;
+
   g_return_if_fail (GTK_IS_STRING_LIST (self));
 
-  objects_append (&self->items, gtk_string_object_new_take (string));
+  chunk = gtk_string_chunk_new (0, 1);
+  chunk->owned = string;
+  rows_append (&self->items, &(GtkStringListRow) { string, chunk });
 
-  g_list_model_items_changed (G_LIST_MODEL (self), objects_get_size (&self->items) - 1, 0, 1);
+  g_list_model_items_changed (G_LIST_MODEL (self), rows_get_size (&self->items) - 1, 0, 1);
   g_object_notify_by_pspec (G_OBJECT (self), properties[PROP_N_ITEMS]);
 }
 
@@ -690,10 +999,10 @@ gtk_string_list_get_string (GtkStringList *self,
 {
   g_return_val_if_fail (GTK_IS_STRING_LIST (self), NULL);
 
-  if (position >= objects_get_size (&self->items))
+  if (position >= rows_get_size (&self->items))
     return NULL;
 
-  return objects_get (&self->items, position)->string;
+  return rows_get (&self->items, position)->string;
 }
 
 /**
@@ -719,10 +1028,10 @@ gtk_string_list_find (GtkStringList *self,
   g_return_val_if_fail (GTK_IS_STRING_LIST (self), G_MAXUINT);
 
   position = G_MAXUINT;
-  items_size = objects_get_size (&self->items);
+  items_size = rows_get_size (&self->items);
   for (guint i = 0; i < items_size; i++)
   {
-    if (strcmp (string, objects_get (&self->items, i)->string) == 0)
+    if (strcmp (string, rows_get (&self->items, i)->string) == 0)
     {
       position = i;
       break;
@@ -239,6 +239,7 @@ gtk_string_sort_keys_new (GtkStringSorter *self)
   result->expression = gtk_expression_ref (self->expression);
   result->ignore_case = self->ignore_case;
   result->collation = self->collation;
+  result->keys.thread_safe = TRUE;
 
   return (GtkSortKeys *) result;
 }
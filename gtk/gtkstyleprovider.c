@@ -20,6 +20,7 @@
 #include "gtksettingsprivate.h"
 #include "gtkstyleproviderprivate.h"
 
+#include "gtkcssstaticstyleprivate.h"
 #include "gtkprivate.h"
 
 /**
@@ -124,6 +125,9 @@ gtk_style_provider_changed (GtkStyleProvider *provider)
 {
   gtk_internal_return_if_fail (GTK_IS_STYLE_PROVIDER (provider));
 
+  /* Shared styles may have been computed from the old state */
+  gtk_css_static_style_store_clear ();
+
   g_signal_emit (provider, signals[CHANGED], 0);
 }
 
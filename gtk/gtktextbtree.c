@@ -209,6 +209,13 @@ struct _GtkTextBTree {
   guint end_iter_segment_stamp;
 
   GHashTable *child_anchor_table;
+
+  /* The number of lines at the start and at the end of the buffer
+   * that didn't change since _gtk_text_btree_reset_unchanged_lines()
+   * was last called. Used to update buffer snapshots.
+   */
+  int unchanged_head;
+  int unchanged_tail;
 };
 
 
@@ -346,6 +353,21 @@ chars_changed (GtkTextBTree *tree)
   tree->chars_changed_stamp += 1;
 }
 
+static void
+lines_changed (GtkTextBTree *tree,
+               GtkTextLine  *first,
+               GtkTextLine  *last)
+{
+  int first_number, last_number;
+
+  first_number = _gtk_text_line_get_number (first);
+  last_number = last == first ? first_number : _gtk_text_line_get_number (last);
+
+  tree->unchanged_head = MIN (tree->unchanged_head, first_number);
+  tree->unchanged_tail = MIN (tree->unchanged_tail,
+                              _gtk_text_btree_line_count (tree) - 1 - last_number);
+}
+
 /*
  * BTree operations
  */
@@ -530,6 +552,33 @@ _gtk_text_btree_get_chars_changed_stamp (GtkTextBTree *tree)
   return tree->chars_changed_stamp;
 }
 
+/*
+ * _gtk_text_btree_get_unchanged_lines:
+ * @tree: a GtkTextBTree
+ * @head: (out): number of unchanged lines at the start
+ * @tail: (out): number of unchanged lines at the end
+ *
+ * Returns how many lines at the start and at the end of the
+ * buffer kept their contents since the last call to
+ * _gtk_text_btree_reset_unchanged_lines(). The values may be
+ * larger than the number of lines in the buffer.
+ */
+void
+_gtk_text_btree_get_unchanged_lines (GtkTextBTree *tree,
+                                     int          *head,
+                                     int          *tail)
+{
+  *head = tree->unchanged_head;
+  *tail = tree->unchanged_tail;
+}
+
+void
+_gtk_text_btree_reset_unchanged_lines (GtkTextBTree *tree)
+{
+  tree->unchanged_head = G_MAXINT;
+  tree->unchanged_tail = G_MAXINT;
+}
+
 guint
 _gtk_text_btree_get_segments_changed_stamp (GtkTextBTree *tree)
 {
@@ -1058,6 +1107,8 @@ _gtk_text_btree_delete (GtkTextIter *start,
 
   gtk_text_btree_rebalance (tree, start_line->parent);
 
+  lines_changed (tree, start_line, start_line);
+
   /* Notify outstanding iterators that they
      are now hosed */
   chars_changed (tree);
@@ -1211,6 +1262,7 @@ _gtk_text_btree_insert (GtkTextIter *iter,
     }
 
   post_insert_fixup (tree, line, line_count_delta, char_count_delta);
+  lines_changed (tree, start_line, line);
 
   /* Invalidate our region, and reset the iterator the user
      passed in to point to the end of the inserted text. */
@@ -1268,6 +1320,7 @@ insert_paintable_or_widget_segment (GtkTextIter        *iter,
     }
 
   post_insert_fixup (tree, line, 0, seg->char_count);
+  lines_changed (tree, line, line);
 
   chars_changed (tree);
   segments_changed (tree);
@@ -1740,11 +1793,15 @@ queue_tag_redisplay (GtkTextBTree      *tree,
   /* We don't need to do anything if the tag doesn't affect display */
 }
 
-void
-_gtk_text_btree_tag (const GtkTextIter *start_orig,
-                     const GtkTextIter *end_orig,
-                     GtkTextTag        *tag,
-                     gboolean           add)
+/* Adds or removes @tag between @start_iter and @end_iter, which must
+ * be ordered. Queueing the redisplay is left to the caller.
+ */
+static void
+gtk_text_btree_tag_range (GtkTextBTree      *tree,
+                          GtkTextTag        *tag,
+                          const GtkTextIter *start_iter,
+                          const GtkTextIter *end_iter,
+                          gboolean           add)
 {
   GtkTextLineSegment *seg, *prev;
   GtkTextLine *cleanupline;
@@ -1753,36 +1810,11 @@ _gtk_text_btree_tag (const GtkTextIter *start_orig,
   GtkTextLine *end_line;
   GtkTextIter iter;
   GtkTextIter start, end;
-  GtkTextBTree *tree;
   IterStack *stack;
   GtkTextTagInfo *info;
 
-  g_return_if_fail (start_orig != NULL);
-  g_return_if_fail (end_orig != NULL);
-  g_return_if_fail (GTK_IS_TEXT_TAG (tag));
-  g_return_if_fail (_gtk_text_iter_get_btree (start_orig) ==
-                    _gtk_text_iter_get_btree (end_orig));
-  g_return_if_fail (tag->priv->table == _gtk_text_iter_get_btree (start_orig)->table);
-
-#if 0
-  printf ("%s tag %s from %d to %d\n",
-          add ? "Adding" : "Removing",
-          tag->name,
-          gtk_text_buffer_get_offset (start_orig),
-          gtk_text_buffer_get_offset (end_orig));
-#endif
-
-  if (gtk_text_iter_equal (start_orig, end_orig))
-    return;
-
-  start = *start_orig;
-  end = *end_orig;
-
-  gtk_text_iter_order (&start, &end);
-
-  tree = _gtk_text_iter_get_btree (&start);
-
-  queue_tag_redisplay (tree, tag, &start, &end);
+  start = *start_iter;
+  end = *end_iter;
 
   info = gtk_text_btree_get_tag_info (tree, tag);
 
@@ -1990,6 +2022,45 @@ _gtk_text_btree_tag (const GtkTextIter *start_orig,
     }
 
   segments_changed (tree);
+}
+
+void
+_gtk_text_btree_tag (const GtkTextIter *start_orig,
+                     const GtkTextIter *end_orig,
+                     GtkTextTag        *tag,
+                     gboolean           add)
+{
+  GtkTextIter start, end;
+  GtkTextBTree *tree;
+
+  g_return_if_fail (start_orig != NULL);
+  g_return_if_fail (end_orig != NULL);
+  g_return_if_fail (GTK_IS_TEXT_TAG (tag));
+  g_return_if_fail (_gtk_text_iter_get_btree (start_orig) ==
+                    _gtk_text_iter_get_btree (end_orig));
+  g_return_if_fail (tag->priv->table == _gtk_text_iter_get_btree (start_orig)->table);
+
+#if 0
+  printf ("%s tag %s from %d to %d\n",
+          add ? "Adding" : "Removing",
+          tag->name,
+          gtk_text_buffer_get_offset (start_orig),
+          gtk_text_buffer_get_offset (end_orig));
+#endif
+
+  if (gtk_text_iter_equal (start_orig, end_orig))
+    return;
+
+  start = *start_orig;
+  end = *end_orig;
+
+  gtk_text_iter_order (&start, &end);
+
+  tree = _gtk_text_iter_get_btree (&start);
+
+  queue_tag_redisplay (tree, tag, &start, &end);
+
+  gtk_text_btree_tag_range (tree, tag, &start, &end, add);
 
   queue_tag_redisplay (tree, tag, &start, &end);
 
@@ -1997,6 +2068,169 @@ _gtk_text_btree_tag (const GtkTextIter *start_orig,
     _gtk_text_btree_check (tree);
 }
 
+typedef struct
+{
+  int start;
+  int end;
+} TagDamage;
+
+static int
+compare_tag_damage (gconstpointer a,
+                    gconstpointer b)
+{
+  const TagDamage *da = a;
+  const TagDamage *db = b;
+
+  return (da->start > db->start) - (da->start < db->start);
+}
+
+/* Sorts @damage and merges the spans that overlap or touch,
+ * so every part of the buffer is queued at most once.
+ */
+static void
+merge_tag_damage (GArray *damage)
+{
+  guint i, j;
+
+  if (damage->len < 2)
+    return;
+
+  g_array_sort (damage, compare_tag_damage);
+
+  for (i = 0, j = 1; j < damage->len; j++)
+    {
+      TagDamage *last = &g_array_index (damage, TagDamage, i);
+      const TagDamage *next = &g_array_index (damage, TagDamage, j);
+
+      if (next->start <= last->end)
+        last->end = MAX (last->end, next->end);
+      else
+        g_array_index (damage, TagDamage, ++i) = *next;
+    }
+
+  g_array_set_size (damage, i + 1);
+}
+
+/* Collects the spans of the ranges whose tags affect the display,
+ * separately for size-affecting tags and for those that only need
+ * a redraw.
+ */
+static void
+get_tag_ranges_damage (const GtkTextTagRange *ranges,
+                       gsize                  n_ranges,
+                       int                    char_count,
+                       GArray                *size_damage,
+                       GArray                *redraw_damage)
+{
+  for (gsize i = 0; i < n_ranges; i++)
+    {
+      const GtkTextTagRange *range = &ranges[i];
+      TagDamage damage;
+
+      damage.start = CLAMP (MIN (range->start, range->end), 0, char_count);
+      damage.end = CLAMP (MAX (range->start, range->end), 0, char_count);
+
+      if (damage.start == damage.end)
+        continue;
+
+      if (_gtk_text_tag_affects_size (range->tag))
+        g_array_append_val (size_damage, damage);
+      else if (_gtk_text_tag_affects_nonsize_appearance (range->tag))
+        g_array_append_val (redraw_damage, damage);
+    }
+
+  merge_tag_damage (size_damage);
+  merge_tag_damage (redraw_damage);
+}
+
+static void
+queue_tag_ranges_redisplay (GtkTextBTree *tree,
+                            GArray       *size_damage,
+                            GArray       *redraw_damage)
+{
+  GtkTextIter start, end;
+  guint i;
+
+  for (i = 0; i < size_damage->len; i++)
+    {
+      const TagDamage *damage = &g_array_index (size_damage, TagDamage, i);
+
+      _gtk_text_btree_get_iter_at_char (tree, &start, damage->start);
+      _gtk_text_btree_get_iter_at_char (tree, &end, damage->end);
+      _gtk_text_btree_invalidate_region (tree, &start, &end, FALSE);
+    }
+
+  for (i = 0; i < redraw_damage->len; i++)
+    {
+      const TagDamage *damage = &g_array_index (redraw_damage, TagDamage, i);
+
+      _gtk_text_btree_get_iter_at_char (tree, &start, damage->start);
+      _gtk_text_btree_get_iter_at_char (tree, &end, damage->end);
+      redisplay_region (tree, &start, &end, FALSE);
+    }
+}
+
+/* Adds or removes the tags of many ranges at once. The damage
+ * is collected and the views are invalidated once for every run
+ * of overlapping ranges, rather than once for every range.
+ *
+ * The ranges should be sorted by their start offset, since
+ * that keeps the iterator lookups local.
+ */
+void
+_gtk_text_btree_tag_ranges (GtkTextBTree          *tree,
+                            const GtkTextTagRange *ranges,
+                            gsize                  n_ranges,
+                            gboolean               add)
+{
+  GArray *size_damage, *redraw_damage;
+  int char_count;
+
+  g_return_if_fail (tree != NULL);
+  g_return_if_fail (ranges != NULL || n_ranges == 0);
+
+  for (gsize i = 0; i < n_ranges; i++)
+    {
+      g_return_if_fail (GTK_IS_TEXT_TAG (ranges[i].tag));
+      g_return_if_fail (ranges[i].tag->priv->table == tree->table);
+    }
+
+  if (n_ranges == 0)
+    return;
+
+  char_count = _gtk_text_btree_char_count (tree);
+
+  size_damage = g_array_new (FALSE, FALSE, sizeof (TagDamage));
+  redraw_damage = g_array_new (FALSE, FALSE, sizeof (TagDamage));
+  get_tag_ranges_damage (ranges, n_ranges, char_count,
+                         size_damage, redraw_damage);
+  queue_tag_ranges_redisplay (tree, size_damage, redraw_damage);
+
+  for (gsize i = 0; i < n_ranges; i++)
+    {
+      const GtkTextTagRange *range = &ranges[i];
+      int start_offset = CLAMP (MIN (range->start, range->end), 0, char_count);
+      int end_offset = CLAMP (MAX (range->start, range->end), 0, char_count);
+      GtkTextIter start, end;
+
+      if (start_offset == end_offset)
+        continue;
+
+      _gtk_text_btree_get_iter_at_char (tree, &start, start_offset);
+      _gtk_text_btree_get_iter_at_char (tree, &end, end_offset);
+
+      gtk_text_btree_tag_range (tree, range->tag, &start, &end, add);
+    }
+
+  queue_tag_ranges_redisplay (tree, size_damage, redraw_damage);
+
+  g_array_unref (size_damage);
+  g_array_unref (redraw_damage);
+
+  if (GTK_DEBUG_CHECK (TEXT))
+    _gtk_text_btree_check (tree);
+}
+
 
 /*
  * "Getters"
@@ -4341,10 +4575,6 @@ _gtk_text_line_next_could_contain_tag (GtkTextLine  *line,
    * count of toggles under the node. But for now I'm going with KISS.
    */
 
-  /* return same-node line, if any. */
-  if (line->next)
-    return line->next;
-
   info = gtk_text_btree_get_existing_tag_info (tree, tag);
   if (info == NULL)
     return NULL;
@@ -4352,6 +4582,15 @@ _gtk_text_line_next_could_contain_tag (GtkTextLine  *line,
   if (info->tag_root == NULL)
     return NULL;
 
+  /* return same-node line, if any. We can skip the rest of the
+   * node if it is below the tag root and has no summary for the
+   * tag, since then none of its lines toggle the tag.
+   */
+  if (line->next &&
+      (info->tag_root == line->parent ||
+       gtk_text_btree_node_has_tag (line->parent, tag)))
+    return line->next;
+
   if (info->tag_root == line->parent)
     return NULL; /* we were at the last line under the tag root */
 
@@ -4495,11 +4734,6 @@ _gtk_text_line_previous_could_contain_tag (GtkTextLine  *line,
       return _gtk_text_line_previous (line);
     }
 
-  /* Return same-node line, if any. */
-  prev = prev_line_under_node (line->parent, line);
-  if (prev)
-    return prev;
-
   info = gtk_text_btree_get_existing_tag_info (tree, tag);
   if (info == NULL)
     return NULL;
@@ -4507,6 +4741,15 @@ _gtk_text_line_previous_could_contain_tag (GtkTextLine  *line,
   if (info->tag_root == NULL)
     return NULL;
 
+  /* Return same-node line, if any, unless the node has no toggles. */
+  if (info->tag_root == line->parent ||
+      gtk_text_btree_node_has_tag (line->parent, tag))
+    {
+      prev = prev_line_under_node (line->parent, line);
+      if (prev)
+        return prev;
+    }
+
   if (info->tag_root == line->parent)
     return NULL; /* we were at the first line under the tag root */
 
@@ -4541,11 +4784,8 @@ _gtk_text_line_previous_could_contain_tag (GtkTextLine  *line,
 
       while (line_ancestor != info->tag_root)
         {
-          GSList *child_nodes = NULL;
-          GSList *tmp;
-
-          /* Create reverse-order list of nodes before
-           * line_ancestor
+          /* Find the last node before line_ancestor that has
+           * our tag on it.
            */
           if (line_ancestor_parent != NULL)
 	    node = line_ancestor_parent->children.node;
@@ -4554,30 +4794,14 @@ _gtk_text_line_previous_could_contain_tag (GtkTextLine  *line,
 
           while (node != line_ancestor && node != NULL)
             {
-              child_nodes = g_slist_prepend (child_nodes, node);
+              if (gtk_text_btree_node_has_tag (node, tag))
+                found_node = node;
 
               node = node->next;
             }
 
-          /* Try to find a node with our tag on it in the list */
-          tmp = child_nodes;
-          while (tmp != NULL)
-            {
-              GtkTextBTreeNode *this_node = tmp->data;
-
-              g_assert (this_node != line_ancestor);
-
-              if (gtk_text_btree_node_has_tag (this_node, tag))
-                {
-                  found_node = this_node;
-                  g_slist_free (child_nodes);
-                  goto found;
-                }
-
-              tmp = tmp->next;
-            }
-
-          g_slist_free (child_nodes);
+          if (found_node != NULL)
+            goto found;
 
           /* Didn't find anything on this level; go up one level. */
           line_ancestor = line_ancestor_parent;
@@ -4623,38 +4847,22 @@ _gtk_text_line_previous_could_contain_tag (GtkTextLine  *line,
 
   while (node->level > 0)
     {
-      GSList *child_nodes = NULL;
-      GSList *iter;
-      g_assert (node != NULL); /* If this fails, it likely means an
-                                  incorrect tag summary led us on a
-                                  wild goose chase down this branch of
-                                  the tree. */
-
-      node = node->children.node;
-      while (node != NULL)
-        {
-          child_nodes = g_slist_prepend (child_nodes, node);
-          node = node->next;
-        }
+      GtkTextBTreeNode *child;
 
+      /* Recurse into the last child that has the tag. */
+      child = node->children.node;
       node = NULL; /* detect failure to find a child node. */
 
-      iter = child_nodes;
-      while (iter != NULL)
+      for (; child != NULL; child = child->next)
         {
-          if (gtk_text_btree_node_has_tag (iter->data, tag))
-            {
-              /* recurse into this node. */
-              node = iter->data;
-              break;
-            }
-
-          iter = iter->next;
+          if (gtk_text_btree_node_has_tag (child, tag))
+            node = child;
         }
 
-      g_slist_free (child_nodes);
-
-      g_assert (node != NULL);
+      g_assert (node != NULL); /* If this fails, it likely means an
+                                  incorrect tag summary led us on a
+                                  wild goose chase down this branch of
+                                  the tree. */
     }
 
   g_assert (node != NULL);
@@ -5276,6 +5484,71 @@ _gtk_text_btree_validate (GtkTextBTree *tree,
     return FALSE;
 }
 
+static guint
+gtk_text_btree_node_collect_invalid_lines (GtkTextBTreeNode  *node,
+                                           gpointer           view_id,
+                                           GtkTextLine      **lines,
+                                           guint              max_lines)
+{
+  NodeData *nd;
+  guint n = 0;
+
+  nd = node_data_find (node->node_data, view_id);
+  if (nd && nd->valid)
+    return 0;
+
+  if (node->level == 0)
+    {
+      GtkTextLine *line;
+
+      for (line = node->children.line; line != NULL && n < max_lines; line = line->next)
+        {
+          GtkTextLineData *ld = _gtk_text_line_get_data (line, view_id);
+
+          if (!ld || !ld->valid)
+            lines[n++] = line;
+        }
+    }
+  else
+    {
+      GtkTextBTreeNode *child;
+
+      for (child = node->children.node; child != NULL && n < max_lines; child = child->next)
+        n += gtk_text_btree_node_collect_invalid_lines (child, view_id,
+                                                        lines + n, max_lines - n);
+    }
+
+  return n;
+}
+
+/**
+ * _gtk_text_btree_get_invalid_lines:
+ * @tree: a GtkTextBTree
+ * @view_id: view id
+ * @lines: (out caller-allocates): array to store the lines in
+ * @max_lines: size of @lines
+ *
+ * Collects the first @max_lines lines that need to be wrapped for
+ * the given view, in buffer order. Valid subtrees are skipped, so
+ * this is cheap even for large, mostly valid buffers.
+ *
+ * Returns: the number of lines stored in @lines
+ **/
+guint
+_gtk_text_btree_get_invalid_lines (GtkTextBTree  *tree,
+                                   gpointer       view_id,
+                                   GtkTextLine  **lines,
+                                   guint          max_lines)
+{
+  g_return_val_if_fail (tree != NULL, 0);
+
+  if (max_lines == 0)
+    return 0;
+
+  return gtk_text_btree_node_collect_invalid_lines (tree->root_node, view_id,
+                                                    lines, max_lines);
+}
+
 static void
 gtk_text_btree_node_compute_view_aggregates (GtkTextBTreeNode *node,
                                              gpointer          view_id,
@@ -53,6 +53,10 @@ GtkTextBuffer *_gtk_text_btree_get_buffer (GtkTextBTree    *tree);
 guint _gtk_text_btree_get_chars_changed_stamp    (GtkTextBTree *tree);
 guint _gtk_text_btree_get_segments_changed_stamp (GtkTextBTree *tree);
 void  _gtk_text_btree_segments_changed           (GtkTextBTree *tree);
+void  _gtk_text_btree_get_unchanged_lines        (GtkTextBTree *tree,
+                                                  int          *head,
+                                                  int          *tail);
+void  _gtk_text_btree_reset_unchanged_lines      (GtkTextBTree *tree);
 
 gboolean _gtk_text_btree_is_end (GtkTextBTree       *tree,
                                  GtkTextLine        *line,
@@ -106,6 +110,10 @@ gboolean     _gtk_text_btree_validate          (GtkTextBTree      *tree,
 void         _gtk_text_btree_validate_line     (GtkTextBTree      *tree,
                                                 GtkTextLine       *line,
                                                 gpointer           view_id);
+guint        _gtk_text_btree_get_invalid_lines (GtkTextBTree      *tree,
+                                                gpointer           view_id,
+                                                GtkTextLine      **lines,
+                                                guint              max_lines);
 
 /* Tag */
 
@@ -113,6 +121,10 @@ void _gtk_text_btree_tag (const GtkTextIter *start,
                           const GtkTextIter *end,
                           GtkTextTag        *tag,
                           gboolean           apply);
+void _gtk_text_btree_tag_ranges (GtkTextBTree          *tree,
+                                 const GtkTextTagRange *ranges,
+                                 gsize                  n_ranges,
+                                 gboolean               apply);
 
 /* "Getters" */
 
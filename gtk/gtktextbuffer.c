@@ -32,6 +32,7 @@
 #include "gtktexthistoryprivate.h"
 #include "gtktextbufferprivate.h"
 #include "gtktextbtreeprivate.h"
+#include "gtktextbuffersnapshotprivate.h"
 #include "gtktextiterprivate.h"
 #include "gtktexttagprivate.h"
 #include "gtktexttagtableprivate.h"
@@ -39,6 +40,7 @@
 #include "gtkprivate.h"
 
 #define DEFAULT_MAX_UNDO 200
+#define DEFAULT_MAX_UNDO_BYTES (16 * 1024 * 1024)
 
 /**
  * GtkTextBuffer:
@@ -71,6 +73,10 @@ struct _GtkTextBufferPrivate
   GArray *commit_funcs;
   guint last_commit_handler;
 
+  /* The last snapshot, reused until the text changes */
+  GtkTextBufferSnapshot *snapshot;
+  guint snapshot_stamp;
+
   guint user_action_count;
 
   /* Whether the buffer has been modified since last save */
@@ -997,6 +1003,7 @@ gtk_text_buffer_init (GtkTextBuffer *buffer)
   buffer->priv->history = gtk_text_history_new (&history_funcs, buffer);
 
   gtk_text_history_set_max_undo_levels (buffer->priv->history, DEFAULT_MAX_UNDO);
+  gtk_text_history_set_max_bytes (buffer->priv->history, DEFAULT_MAX_UNDO_BYTES);
 }
 
 static void
@@ -1149,6 +1156,7 @@ gtk_text_buffer_finalize (GObject *object)
   g_clear_pointer (&buffer->priv->commit_funcs, g_array_unref);
 
   g_clear_object (&buffer->priv->history);
+  g_clear_pointer (&priv->snapshot, gtk_text_buffer_snapshot_unref);
 
   if (priv->tag_table)
     {
@@ -2361,6 +2369,50 @@ gtk_text_buffer_get_slice (GtkTextBuffer     *buffer,
     return gtk_text_iter_get_visible_slice (start, end);
 }
 
+/**
+ * gtk_text_buffer_get_snapshot:
+ * @buffer: a `GtkTextBuffer`
+ *
+ * Returns an immutable snapshot of the text in the buffer.
+ *
+ * The snapshot contains the same text as [method@Gtk.TextBuffer.get_slice]
+ * with hidden characters included, and can be used from other threads.
+ *
+ * Snapshots share their storage with earlier snapshots of the same
+ * buffer, so calling this after every change only copies the lines
+ * that changed, and calling it again without a change in between
+ * returns the same snapshot.
+ *
+ * Returns: (transfer full): a snapshot of the buffer text
+ *
+ * Since: 4.18
+ */
+GtkTextBufferSnapshot *
+gtk_text_buffer_get_snapshot (GtkTextBuffer *buffer)
+{
+  GtkTextBufferPrivate *priv;
+  GtkTextBTree *btree;
+  guint stamp;
+
+  g_return_val_if_fail (GTK_IS_TEXT_BUFFER (buffer), NULL);
+
+  priv = buffer->priv;
+  btree = get_btree (buffer);
+  stamp = _gtk_text_btree_get_chars_changed_stamp (btree);
+
+  if (priv->snapshot == NULL || priv->snapshot_stamp != stamp)
+    {
+      GtkTextBufferSnapshot *snapshot;
+
+      snapshot = gtk_text_buffer_snapshot_new_from_btree (btree, priv->snapshot);
+      g_clear_pointer (&priv->snapshot, gtk_text_buffer_snapshot_unref);
+      priv->snapshot = snapshot;
+      priv->snapshot_stamp = stamp;
+    }
+
+  return gtk_text_buffer_snapshot_ref (priv->snapshot);
+}
+
 /*
  * Pixbufs
  */
@@ -3355,6 +3407,76 @@ gtk_text_buffer_remove_all_tags (GtkTextBuffer     *buffer,
   g_slist_free_full (tags, g_object_unref);
 }
 
+static gboolean
+check_tag_ranges (GtkTextBuffer         *buffer,
+                  const GtkTextTagRange *ranges,
+                  gsize                  n_ranges)
+{
+  for (gsize i = 0; i < n_ranges; i++)
+    {
+      if (!GTK_IS_TEXT_TAG (ranges[i].tag) ||
+          ranges[i].tag->priv->table != buffer->priv->tag_table)
+        return FALSE;
+    }
+
+  return TRUE;
+}
+
+/**
+ * gtk_text_buffer_apply_tag_ranges:
+ * @buffer: a `GtkTextBuffer`
+ * @ranges: (array length=n_ranges): the ranges to tag
+ * @n_ranges: the number of ranges
+ *
+ * Applies the tags to the given ranges.
+ *
+ * This is meant for applying many small ranges at once, as done
+ * by syntax highlighters. The ranges should be sorted by their
+ * start offset. The views of @buffer are updated once for all of
+ * them, instead of once per range.
+ *
+ * Unlike [method@Gtk.TextBuffer.apply_tag], this does not emit the
+ * [signal@Gtk.TextBuffer::apply-tag] signal.
+ *
+ * Since: 4.18
+ */
+void
+gtk_text_buffer_apply_tag_ranges (GtkTextBuffer         *buffer,
+                                  const GtkTextTagRange *ranges,
+                                  gsize                  n_ranges)
+{
+  g_return_if_fail (GTK_IS_TEXT_BUFFER (buffer));
+  g_return_if_fail (ranges != NULL || n_ranges == 0);
+  g_return_if_fail (check_tag_ranges (buffer, ranges, n_ranges));
+
+  _gtk_text_btree_tag_ranges (get_btree (buffer), ranges, n_ranges, TRUE);
+}
+
+/**
+ * gtk_text_buffer_remove_tag_ranges:
+ * @buffer: a `GtkTextBuffer`
+ * @ranges: (array length=n_ranges): the ranges to untag
+ * @n_ranges: the number of ranges
+ *
+ * Removes the tags from the given ranges.
+ *
+ * See [method@Gtk.TextBuffer.apply_tag_ranges]. This does not emit
+ * the [signal@Gtk.TextBuffer::remove-tag] signal.
+ *
+ * Since: 4.18
+ */
+void
+gtk_text_buffer_remove_tag_ranges (GtkTextBuffer         *buffer,
+                                   const GtkTextTagRange *ranges,
+                                   gsize                  n_ranges)
+{
+  g_return_if_fail (GTK_IS_TEXT_BUFFER (buffer));
+  g_return_if_fail (ranges != NULL || n_ranges == 0);
+  g_return_if_fail (check_tag_ranges (buffer, ranges, n_ranges));
+
+  _gtk_text_btree_tag_ranges (get_btree (buffer), ranges, n_ranges, FALSE);
+}
+
 
 /*
  * Obtain various iterators
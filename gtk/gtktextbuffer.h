@@ -33,6 +33,7 @@
 #include <gtk/gtktextiter.h>
 #include <gtk/gtktextmark.h>
 #include <gtk/gtktextchild.h>
+#include <gtk/gtktextbuffersnapshot.h>
 
 G_BEGIN_DECLS
 
@@ -102,6 +103,26 @@ typedef void (*GtkTextBufferCommitNotify) (GtkTextBuffer            *buffer,
                                            guint                     length,
                                            gpointer                  user_data);
 
+/**
+ * GtkTextTagRange:
+ * @tag: the tag
+ * @start: the character offset at which the range starts
+ * @end: the character offset at which the range ends
+ *
+ * A range of text in a `GtkTextBuffer` together with a tag,
+ * as used by [method@Gtk.TextBuffer.apply_tag_ranges].
+ *
+ * Since: 4.18
+ */
+typedef struct _GtkTextTagRange GtkTextTagRange;
+
+struct _GtkTextTagRange
+{
+  GtkTextTag *tag;
+  int         start;
+  int         end;
+};
+
 /**
  * GtkTextBufferClass:
  * @parent_class: The object class structure needs to be the first.
@@ -292,6 +313,9 @@ char           *gtk_text_buffer_get_slice           (GtkTextBuffer     *buffer,
                                                      const GtkTextIter *end,
                                                      gboolean           include_hidden_chars);
 
+GDK_AVAILABLE_IN_4_18
+GtkTextBufferSnapshot *gtk_text_buffer_get_snapshot (GtkTextBuffer     *buffer);
+
 /* Insert a paintable */
 GDK_AVAILABLE_IN_ALL
 void gtk_text_buffer_insert_paintable      (GtkTextBuffer *buffer,
@@ -379,6 +403,14 @@ GDK_AVAILABLE_IN_ALL
 void gtk_text_buffer_remove_all_tags       (GtkTextBuffer     *buffer,
                                             const GtkTextIter *start,
                                             const GtkTextIter *end);
+GDK_AVAILABLE_IN_4_18
+void gtk_text_buffer_apply_tag_ranges      (GtkTextBuffer         *buffer,
+                                            const GtkTextTagRange *ranges,
+                                            gsize                  n_ranges);
+GDK_AVAILABLE_IN_4_18
+void gtk_text_buffer_remove_tag_ranges     (GtkTextBuffer         *buffer,
+                                            const GtkTextTagRange *ranges,
+                                            gsize                  n_ranges);
 
 
 /* You can either ignore the return value, or use it to
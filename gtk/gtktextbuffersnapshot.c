@@ -0,0 +1,684 @@
+/* GTK - The GIMP Toolkit
+ * Copyright (C) 2026 the GTK team
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "config.h"
+
+#include "gtktextbuffersnapshotprivate.h"
+
+#include "gtktexttypesprivate.h"
+
+#include <string.h>
+
+/**
+ * GtkTextBufferSnapshot:
+ *
+ * An immutable copy of the text of a [class@Gtk.TextBuffer].
+ *
+ * Snapshots are obtained with [method@Gtk.TextBuffer.get_snapshot].
+ * They contain the same text as [method@Gtk.TextBuffer.get_slice]
+ * with hidden characters included, so paintables and child anchors
+ * are represented by the object replacement character, and character
+ * offsets match the ones of [struct@Gtk.TextIter].
+ *
+ * The text is stored in chunks of whole lines. Successive snapshots
+ * of the same buffer share the chunks that didn't change, so taking
+ * a snapshot after an edit only copies the lines around the edit,
+ * and taking one without an edit in between is free.
+ *
+ * Snapshots never change, so unlike the buffer they can be used
+ * from any thread. This makes them useful for handing the text to
+ * spell checkers, syntax highlighters or autosave code that runs in
+ * a different thread.
+ *
+ * Since: 4.18
+ */
+
+/* Chunks stop growing once they reach this many bytes */
+#define GTK_TEXT_BUFFER_SNAPSHOT_CHUNK_SIZE 4096
+
+typedef struct _GtkTextChunk GtkTextChunk;
+
+struct _GtkTextChunk
+{
+  gatomicrefcount ref_count;
+
+  gsize n_bytes;
+  gsize n_chars;
+  guint n_lines;
+  /* Byte offset of every line that starts in this chunk */
+  gsize *line_starts;
+  /* nul-terminated */
+  char *text;
+};
+
+struct _GtkTextBufferSnapshot
+{
+  gatomicrefcount ref_count;
+
+  guint n_chunks;
+  GtkTextChunk **chunks;
+
+  /* Where each chunk starts, with an extra entry at the end
+   * for the totals */
+  gsize *byte_offsets;
+  gsize *char_offsets;
+  gsize *line_offsets;
+};
+
+G_DEFINE_BOXED_TYPE (GtkTextBufferSnapshot, gtk_text_buffer_snapshot,
+                     gtk_text_buffer_snapshot_ref,
+                     gtk_text_buffer_snapshot_unref)
+
+static GtkTextChunk *
+gtk_text_chunk_new (const char  *text,
+                    gsize        n_bytes,
+                    gsize        n_chars,
+                    const gsize *line_starts,
+                    guint        n_lines)
+{
+  GtkTextChunk *self;
+
+  self = g_malloc (sizeof (GtkTextChunk) + n_lines * sizeof (gsize) + n_bytes + 1);
+  g_atomic_ref_count_init (&self->ref_count);
+  self->n_bytes = n_bytes;
+  self->n_chars = n_chars;
+  self->n_lines = n_lines;
+  self->line_starts = (gsize *) (self + 1);
+  memcpy (self->line_starts, line_starts, n_lines * sizeof (gsize));
+  self->text = (char *) (self->line_starts + n_lines);
+  memcpy (self->text, text, n_bytes);
+  self->text[n_bytes] = '\0';
+
+  return self;
+}
+
+static GtkTextChunk *
+gtk_text_chunk_ref (GtkTextChunk *self)
+{
+  g_atomic_ref_count_inc (&self->ref_count);
+
+  return self;
+}
+
+static void
+gtk_text_chunk_unref (GtkTextChunk *self)
+{
+  if (g_atomic_ref_count_dec (&self->ref_count))
+    g_free (self);
+}
+
+/* Returns the last line that starts at or before @byte_offset */
+static guint
+gtk_text_chunk_find_line (const GtkTextChunk *self,
+                          gsize               byte_offset)
+{
+  guint min, max;
+
+  min = 0;
+  max = self->n_lines;
+  while (max - min > 1)
+    {
+      guint mid = (min + max) / 2;
+
+      if (self->line_starts[mid] <= byte_offset)
+        min = mid;
+      else
+        max = mid;
+    }
+
+  return min;
+}
+
+typedef struct
+{
+  GString *text;
+  GArray *line_starts;
+  gsize n_chars;
+  GPtrArray *chunks;
+} ChunkBuilder;
+
+static void
+chunk_builder_init (ChunkBuilder *builder,
+                    GPtrArray    *chunks)
+{
+  builder->text = g_string_sized_new (GTK_TEXT_BUFFER_SNAPSHOT_CHUNK_SIZE);
+  builder->line_starts = g_array_new (FALSE, FALSE, sizeof (gsize));
+  builder->n_chars = 0;
+  builder->chunks = chunks;
+}
+
+static void
+chunk_builder_flush (ChunkBuilder *builder)
+{
+  if (builder->line_starts->len == 0)
+    return;
+
+  g_ptr_array_add (builder->chunks,
+                   gtk_text_chunk_new (builder->text->str,
+                                       builder->text->len,
+                                       builder->n_chars,
+                                       (gsize *) builder->line_starts->data,
+                                       builder->line_starts->len));
+
+  g_string_truncate (builder->text, 0);
+  g_array_set_size (builder->line_starts, 0);
+  builder->n_chars = 0;
+}
+
+static void
+chunk_builder_clear (ChunkBuilder *builder)
+{
+  chunk_builder_flush (builder);
+
+  g_string_free (builder->text, TRUE);
+  g_array_unref (builder->line_starts);
+}
+
+/* This must produce the same text as gtk_text_iter_get_slice() */
+static void
+chunk_builder_add_line (ChunkBuilder *builder,
+                        GtkTextLine  *line,
+                        gboolean      is_last)
+{
+  GtkTextLineSegment *seg;
+
+  g_array_append_val (builder->line_starts, builder->text->len);
+
+  for (seg = line->segments; seg != NULL; seg = seg->next)
+    {
+      if (seg->type == &gtk_text_char_type)
+        {
+          g_string_append_len (builder->text, seg->body.chars, seg->byte_count);
+          builder->n_chars += seg->char_count;
+        }
+      else if (seg->type == &gtk_text_paintable_type)
+        {
+          g_string_append_len (builder->text, _gtk_text_unknown_char_utf8, seg->byte_count);
+          builder->n_chars += seg->char_count;
+        }
+      else if (seg->type == &gtk_text_child_type)
+        {
+          g_string_append_len (builder->text,
+                               gtk_text_child_anchor_get_replacement (seg->body.child.obj),
+                               seg->byte_count);
+          builder->n_chars += seg->char_count;
+        }
+    }
+
+  /* The last line ends with a newline that is not part of the buffer */
+  if (is_last &&
+      builder->text->len > 0 &&
+      builder->text->str[builder->text->len - 1] == '\n')
+    {
+      g_string_truncate (builder->text, builder->text->len - 1);
+      builder->n_chars--;
+    }
+
+  if (builder->text->len >= GTK_TEXT_BUFFER_SNAPSHOT_CHUNK_SIZE)
+    chunk_builder_flush (builder);
+}
+
+/*
+ * gtk_text_buffer_snapshot_new_from_btree:
+ * @tree: the tree to copy
+ * @previous: (nullable): the last snapshot that was created for @tree
+ *
+ * Creates a snapshot of the text in @tree.
+ *
+ * If @previous is given, the chunks of lines that didn't change since
+ * it was created are reused, so only the changed lines are copied.
+ *
+ * Returns: (transfer full): a new snapshot
+ */
+GtkTextBufferSnapshot *
+gtk_text_buffer_snapshot_new_from_btree (GtkTextBTree          *tree,
+                                         GtkTextBufferSnapshot *previous)
+{
+  GtkTextBufferSnapshot *self;
+  GPtrArray *chunks;
+  ChunkBuilder builder;
+  GtkTextLine *line;
+  guint i, n_lines, head_chunks, tail_chunks, head_lines, tail_lines;
+  int unchanged_head, unchanged_tail;
+
+  n_lines = _gtk_text_btree_line_count (tree);
+  _gtk_text_btree_get_unchanged_lines (tree, &unchanged_head, &unchanged_tail);
+  _gtk_text_btree_reset_unchanged_lines (tree);
+
+  head_chunks = 0;
+  tail_chunks = 0;
+  head_lines = 0;
+  tail_lines = 0;
+
+  if (previous)
+    {
+      gsize previous_n_lines = previous->line_offsets[previous->n_chunks];
+
+      while (head_chunks < previous->n_chunks &&
+             previous->line_offsets[head_chunks + 1] <= MIN ((guint) unchanged_head, n_lines))
+        head_chunks++;
+      head_lines = previous->line_offsets[head_chunks];
+
+      while (head_chunks + tail_chunks < previous->n_chunks)
+        {
+          gsize chunk_lines = previous_n_lines - previous->line_offsets[previous->n_chunks - tail_chunks - 1];
+
+          if (chunk_lines > (gsize) unchanged_tail ||
+              head_lines + chunk_lines > n_lines)
+            break;
+
+          tail_chunks++;
+          tail_lines = chunk_lines;
+        }
+    }
+
+  chunks = g_ptr_array_new ();
+
+  for (i = 0; i < head_chunks; i++)
+    g_ptr_array_add (chunks, gtk_text_chunk_ref (previous->chunks[i]));
+
+  chunk_builder_init (&builder, chunks);
+  if (head_lines + tail_lines < n_lines)
+    {
+      line = _gtk_text_btree_get_line (tree, head_lines, NULL);
+      for (i = head_lines; i < n_lines - tail_lines; i++)
+        {
+          chunk_builder_add_line (&builder, line, i + 1 == n_lines);
+          line = _gtk_text_line_next (line);
+        }
+    }
+  chunk_builder_clear (&builder);
+
+  for (i = previous ? previous->n_chunks - tail_chunks : 0; i < (previous ? previous->n_chunks : 0); i++)
+    g_ptr_array_add (chunks, gtk_text_chunk_ref (previous->chunks[i]));
+
+  self = g_new0 (GtkTextBufferSnapshot, 1);
+  g_atomic_ref_count_init (&self->ref_count);
+  self->n_chunks = chunks->len;
+  self->chunks = (GtkTextChunk **) g_ptr_array_free (chunks, FALSE);
+  self->byte_offsets = g_new (gsize, self->n_chunks + 1);
+  self->char_offsets = g_new (gsize, self->n_chunks + 1);
+  self->line_offsets = g_new (gsize, self->n_chunks + 1);
+
+  self->byte_offsets[0] = 0;
+  self->char_offsets[0] = 0;
+  self->line_offsets[0] = 0;
+  for (i = 0; i < self->n_chunks; i++)
+    {
+      self->byte_offsets[i + 1] = self->byte_offsets[i] + self->chunks[i]->n_bytes;
+      self->char_offsets[i + 1] = self->char_offsets[i] + self->chunks[i]->n_chars;
+      self->line_offsets[i + 1] = self->line_offsets[i] + self->chunks[i]->n_lines;
+    }
+
+  g_assert (self->line_offsets[self->n_chunks] == n_lines);
+
+  return self;
+}
+
+/**
+ * gtk_text_buffer_snapshot_ref:
+ * @self: a `GtkTextBufferSnapshot`
+ *
+ * Acquires a reference on the given snapshot.
+ *
+ * Returns: (transfer full): the snapshot with an additional reference
+ *
+ * Since: 4.18
+ */
+GtkTextBufferSnapshot *
+gtk_text_buffer_snapshot_ref (GtkTextBufferSnapshot *self)
+{
+  g_return_val_if_fail (self != NULL, NULL);
+
+  g_atomic_ref_count_inc (&self->ref_count);
+
+  return self;
+}
+
+/**
+ * gtk_text_buffer_snapshot_unref:
+ * @self: (transfer full): a `GtkTextBufferSnapshot`
+ *
+ * Releases a reference on the given snapshot.
+ *
+ * If the reference was the last, the resources associated
+ * to the snapshot are freed.
+ *
+ * Since: 4.18
+ */
+void
+gtk_text_buffer_snapshot_unref (GtkTextBufferSnapshot *self)
+{
+  guint i;
+
+  g_return_if_fail (self != NULL);
+
+  if (!g_atomic_ref_count_dec (&self->ref_count))
+    return;
+
+  for (i = 0; i < self->n_chunks; i++)
+    gtk_text_chunk_unref (self->chunks[i]);
+
+  g_free (self->chunks);
+  g_free (self->byte_offsets);
+  g_free (self->char_offsets);
+  g_free (self->line_offsets);
+  g_free (self);
+}
+
+/* Returns the last chunk that starts at or before @offset */
+static guint
+gtk_text_buffer_snapshot_find_chunk (const GtkTextBufferSnapshot *self,
+                                     const gsize                 *offsets,
+                                     gsize                        offset)
+{
+  guint min, max;
+
+  min = 0;
+  max = self->n_chunks;
+  while (max - min > 1)
+    {
+      guint mid = (min + max) / 2;
+
+      if (offsets[mid] <= offset)
+        min = mid;
+      else
+        max = mid;
+    }
+
+  return min;
+}
+
+/**
+ * gtk_text_buffer_snapshot_get_n_bytes:
+ * @self: a `GtkTextBufferSnapshot`
+ *
+ * Returns the length of the text in bytes.
+ *
+ * Returns: the number of bytes
+ *
+ * Since: 4.18
+ */
+gsize
+gtk_text_buffer_snapshot_get_n_bytes (const GtkTextBufferSnapshot *self)
+{
+  g_return_val_if_fail (self != NULL, 0);
+
+  return self->byte_offsets[self->n_chunks];
+}
+
+/**
+ * gtk_text_buffer_snapshot_get_n_chars:
+ * @self: a `GtkTextBufferSnapshot`
+ *
+ * Returns the length of the text in characters.
+ *
+ * This is the same as [method@Gtk.TextBuffer.get_char_count]
+ * returned when the snapshot was taken.
+ *
+ * Returns: the number of characters
+ *
+ * Since: 4.18
+ */
+gsize
+gtk_text_buffer_snapshot_get_n_chars (const GtkTextBufferSnapshot *self)
+{
+  g_return_val_if_fail (self != NULL, 0);
+
+  return self->char_offsets[self->n_chunks];
+}
+
+/**
+ * gtk_text_buffer_snapshot_get_n_lines:
+ * @self: a `GtkTextBufferSnapshot`
+ *
+ * Returns the number of lines in the text.
+ *
+ * This is the same as [method@Gtk.TextBuffer.get_line_count]
+ * returned when the snapshot was taken.
+ *
+ * Returns: the number of lines
+ *
+ * Since: 4.18
+ */
+guint
+gtk_text_buffer_snapshot_get_n_lines (const GtkTextBufferSnapshot *self)
+{
+  g_return_val_if_fail (self != NULL, 0);
+
+  return self->line_offsets[self->n_chunks];
+}
+
+/**
+ * gtk_text_buffer_snapshot_get_n_chunks:
+ * @self: a `GtkTextBufferSnapshot`
+ *
+ * Returns the number of chunks the text is stored in.
+ *
+ * Use [method@Gtk.TextBufferSnapshot.get_chunk] to iterate
+ * over the text without copying it.
+ *
+ * Returns: the number of chunks
+ *
+ * Since: 4.18
+ */
+guint
+gtk_text_buffer_snapshot_get_n_chunks (const GtkTextBufferSnapshot *self)
+{
+  g_return_val_if_fail (self != NULL, 0);
+
+  return self->n_chunks;
+}
+
+/**
+ * gtk_text_buffer_snapshot_get_chunk:
+ * @self: a `GtkTextBufferSnapshot`
+ * @position: the index of the chunk
+ * @offset: (out) (optional): return location for the byte offset
+ *   of the chunk in the text
+ * @n_bytes: (out) (optional): return location for the length of
+ *   the chunk in bytes
+ *
+ * Gets the text of a chunk.
+ *
+ * Chunks always contain whole lines and are nul-terminated.
+ * The returned text is owned by the snapshot and stays valid
+ * as long as the snapshot.
+ *
+ * Returns: (transfer none): the text of the chunk
+ *
+ * Since: 4.18
+ */
+const char *
+gtk_text_buffer_snapshot_get_chunk (const GtkTextBufferSnapshot *self,
+                                    guint                        position,
+                                    gsize                       *offset,
+                                    gsize                       *n_bytes)
+{
+  g_return_val_if_fail (self != NULL, NULL);
+  g_return_val_if_fail (position < self->n_chunks, NULL);
+
+  if (offset)
+    *offset = self->byte_offsets[position];
+  if (n_bytes)
+    *n_bytes = self->chunks[position]->n_bytes;
+
+  return self->chunks[position]->text;
+}
+
+/**
+ * gtk_text_buffer_snapshot_get_byte_offset:
+ * @self: a `GtkTextBufferSnapshot`
+ * @char_offset: a character offset
+ *
+ * Converts a character offset into a byte offset.
+ *
+ * Offsets past the end of the text are clamped.
+ *
+ * Returns: the byte offset
+ *
+ * Since: 4.18
+ */
+gsize
+gtk_text_buffer_snapshot_get_byte_offset (const GtkTextBufferSnapshot *self,
+                                          gsize                        char_offset)
+{
+  const GtkTextChunk *chunk;
+  guint i;
+
+  g_return_val_if_fail (self != NULL, 0);
+
+  char_offset = MIN (char_offset, self->char_offsets[self->n_chunks]);
+  i = gtk_text_buffer_snapshot_find_chunk (self, self->char_offsets, char_offset);
+  chunk = self->chunks[i];
+
+  return self->byte_offsets[i] +
+         (g_utf8_offset_to_pointer (chunk->text, char_offset - self->char_offsets[i]) - chunk->text);
+}
+
+/**
+ * gtk_text_buffer_snapshot_get_char_offset:
+ * @self: a `GtkTextBufferSnapshot`
+ * @byte_offset: a byte offset at a character boundary
+ *
+ * Converts a byte offset into a character offset.
+ *
+ * Offsets past the end of the text are clamped.
+ *
+ * Returns: the character offset
+ *
+ * Since: 4.18
+ */
+gsize
+gtk_text_buffer_snapshot_get_char_offset (const GtkTextBufferSnapshot *self,
+                                          gsize                        byte_offset)
+{
+  const GtkTextChunk *chunk;
+  guint i;
+
+  g_return_val_if_fail (self != NULL, 0);
+
+  byte_offset = MIN (byte_offset, self->byte_offsets[self->n_chunks]);
+  i = gtk_text_buffer_snapshot_find_chunk (self, self->byte_offsets, byte_offset);
+  chunk = self->chunks[i];
+
+  return self->char_offsets[i] +
+         g_utf8_pointer_to_offset (chunk->text, chunk->text + (byte_offset - self->byte_offsets[i]));
+}
+
+/**
+ * gtk_text_buffer_snapshot_get_line_offset:
+ * @self: a `GtkTextBufferSnapshot`
+ * @line: a line number, counting from 0
+ *
+ * Gets the byte offset of the start of @line.
+ *
+ * If @line is past the last line, the length of the
+ * text is returned.
+ *
+ * Returns: the byte offset of the line
+ *
+ * Since: 4.18
+ */
+gsize
+gtk_text_buffer_snapshot_get_line_offset (const GtkTextBufferSnapshot *self,
+                                          guint                        line)
+{
+  guint i;
+
+  g_return_val_if_fail (self != NULL, 0);
+
+  if (line >= self->line_offsets[self->n_chunks])
+    return self->byte_offsets[self->n_chunks];
+
+  i = gtk_text_buffer_snapshot_find_chunk (self, self->line_offsets, line);
+
+  return self->byte_offsets[i] + self->chunks[i]->line_starts[line - self->line_offsets[i]];
+}
+
+/**
+ * gtk_text_buffer_snapshot_get_line_at_offset:
+ * @self: a `GtkTextBufferSnapshot`
+ * @byte_offset: a byte offset
+ *
+ * Gets the line containing the given byte offset.
+ *
+ * Returns: the line number
+ *
+ * Since: 4.18
+ */
+guint
+gtk_text_buffer_snapshot_get_line_at_offset (const GtkTextBufferSnapshot *self,
+                                             gsize                        byte_offset)
+{
+  guint i;
+
+  g_return_val_if_fail (self != NULL, 0);
+
+  byte_offset = MIN (byte_offset, self->byte_offsets[self->n_chunks]);
+  i = gtk_text_buffer_snapshot_find_chunk (self, self->byte_offsets, byte_offset);
+
+  return self->line_offsets[i] +
+         gtk_text_chunk_find_line (self->chunks[i], byte_offset - self->byte_offsets[i]);
+}
+
+/**
+ * gtk_text_buffer_snapshot_get_text:
+ * @self: a `GtkTextBufferSnapshot`
+ * @start: byte offset of the start
+ * @end: byte offset of the end, or `G_MAXSIZE` for the end of the text
+ *
+ * Copies the text between @start and @end into a new string.
+ *
+ * Returns: (transfer full): the text
+ *
+ * Since: 4.18
+ */
+char *
+gtk_text_buffer_snapshot_get_text (const GtkTextBufferSnapshot *self,
+                                   gsize                        start,
+                                   gsize                        end)
+{
+  char *result;
+  gsize n_bytes, copied;
+  guint i;
+
+  g_return_val_if_fail (self != NULL, NULL);
+
+  end = MIN (end, self->byte_offsets[self->n_chunks]);
+  start = MIN (start, end);
+  n_bytes = end - start;
+
+  result = g_malloc (n_bytes + 1);
+  copied = 0;
+
+  for (i = gtk_text_buffer_snapshot_find_chunk (self, self->byte_offsets, start);
+       copied < n_bytes;
+       i++)
+    {
+      const GtkTextChunk *chunk = self->chunks[i];
+      gsize chunk_start = start + copied - self->byte_offsets[i];
+      gsize len = MIN (chunk->n_bytes - chunk_start, n_bytes - copied);
+
+      memcpy (result + copied, chunk->text + chunk_start, len);
+      copied += len;
+    }
+
+  result[n_bytes] = '\0';
+
+  return result;
+}
@@ -0,0 +1,75 @@
+/* GTK - The GIMP Toolkit
+ * Copyright (C) 2026 the GTK team
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#if !defined (__GTK_H_INSIDE__) && !defined (GTK_COMPILATION)
+#error "Only <gtk/gtk.h> can be included directly."
+#endif
+
+#include <gdk/gdk.h>
+
+G_BEGIN_DECLS
+
+#define GTK_TYPE_TEXT_BUFFER_SNAPSHOT (gtk_text_buffer_snapshot_get_type ())
+
+typedef struct _GtkTextBufferSnapshot GtkTextBufferSnapshot;
+
+GDK_AVAILABLE_IN_4_18
+GType                   gtk_text_buffer_snapshot_get_type               (void) G_GNUC_CONST;
+
+GDK_AVAILABLE_IN_4_18
+GtkTextBufferSnapshot * gtk_text_buffer_snapshot_ref                    (GtkTextBufferSnapshot          *self);
+GDK_AVAILABLE_IN_4_18
+void                    gtk_text_buffer_snapshot_unref                  (GtkTextBufferSnapshot          *self);
+
+GDK_AVAILABLE_IN_4_18
+gsize                   gtk_text_buffer_snapshot_get_n_bytes            (const GtkTextBufferSnapshot    *self);
+GDK_AVAILABLE_IN_4_18
+gsize                   gtk_text_buffer_snapshot_get_n_chars            (const GtkTextBufferSnapshot    *self);
+GDK_AVAILABLE_IN_4_18
+guint                   gtk_text_buffer_snapshot_get_n_lines            (const GtkTextBufferSnapshot    *self);
+
+GDK_AVAILABLE_IN_4_18
+guint                   gtk_text_buffer_snapshot_get_n_chunks           (const GtkTextBufferSnapshot    *self);
+GDK_AVAILABLE_IN_4_18
+const char *            gtk_text_buffer_snapshot_get_chunk              (const GtkTextBufferSnapshot    *self,
+                                                                         guint                           position,
+                                                                         gsize                          *offset,
+                                                                         gsize                          *n_bytes);
+
+GDK_AVAILABLE_IN_4_18
+gsize                   gtk_text_buffer_snapshot_get_byte_offset        (const GtkTextBufferSnapshot    *self,
+                                                                         gsize                           char_offset);
+GDK_AVAILABLE_IN_4_18
+gsize                   gtk_text_buffer_snapshot_get_char_offset        (const GtkTextBufferSnapshot    *self,
+                                                                         gsize                           byte_offset);
+GDK_AVAILABLE_IN_4_18
+gsize                   gtk_text_buffer_snapshot_get_line_offset        (const GtkTextBufferSnapshot    *self,
+                                                                         guint                           line);
+GDK_AVAILABLE_IN_4_18
+guint                   gtk_text_buffer_snapshot_get_line_at_offset     (const GtkTextBufferSnapshot    *self,
+                                                                         gsize                           byte_offset);
+
+GDK_AVAILABLE_IN_4_18
+char *                  gtk_text_buffer_snapshot_get_text               (const GtkTextBufferSnapshot    *self,
+                                                                         gsize                           start,
+                                                                         gsize                           end);
+
+G_DEFINE_AUTOPTR_CLEANUP_FUNC(GtkTextBufferSnapshot, gtk_text_buffer_snapshot_unref)
+
+G_END_DECLS
@@ -16,9 +16,10 @@
 
 #include "config.h"
 
-#include "gtkistringprivate.h"
 #include "gtktexthistoryprivate.h"
 
+#include <string.h>
+
 /*
  * The GtkTextHistory works in a way that allows text widgets to deliver
  * information about changes to the underlying text at given offsets within
@@ -36,10 +37,26 @@
  * gtk_text_history_end_irreversible_action() can be used to denote a
  * section of operations that cannot be undone. This will cause all previous
  * changes tracked by the GtkTextHistory to be discarded.
+ *
+ * The text of the actions is not allocated separately. It is appended to
+ * a shared arena of large chunks, so that adjacent typing or deletions
+ * can usually be coalesced by extending a run in place. Texts that are
+ * larger than a fraction of a chunk (think pastes) get a chunk of their
+ * own, so their memory is returned as soon as the action is dropped.
+ * Chunks are reference counted by the actions pointing into them.
+ *
+ * gtk_text_history_set_max_bytes() limits the memory kept around for the
+ * text. A chunk is charged in full as long as any action points into it,
+ * since that is what it keeps alive. When the limit is exceeded, the
+ * oldest undo steps are dropped first.
  */
 
-typedef struct _Action     Action;
-typedef enum   _ActionKind ActionKind;
+typedef struct _Action      Action;
+typedef enum   _ActionKind  ActionKind;
+typedef struct _TextChunk   TextChunk;
+typedef struct _HistoryText HistoryText;
+
+#define TEXT_CHUNK_SIZE (64 * 1024)
 
 enum _ActionKind
 {
@@ -52,6 +69,23 @@ enum _ActionKind
   ACTION_KIND_INSERT              = 7,
 };
 
+struct _TextChunk
+{
+  guint ref_count;
+  guint n_texts; /* the refs held by HistoryTexts */
+  gsize len;
+  gsize size;
+  char  data[];
+};
+
+struct _HistoryText
+{
+  TextChunk *chunk;
+  gsize      offset;
+  guint      n_bytes;
+  guint      n_chars;
+};
+
 struct _Action
 {
   ActionKind kind;
@@ -60,12 +94,12 @@ struct _Action
   guint is_modified_set : 1;
   union {
     struct {
-      IString istr;
+      HistoryText text;
       guint begin;
       guint end;
     } insert;
     struct {
-      IString istr;
+      HistoryText text;
       guint begin;
       guint end;
       struct {
@@ -95,6 +129,10 @@ struct _GtkTextHistory
     int bound;
   } selection;
 
+  TextChunk          *arena;
+  gsize               n_bytes;
+  gsize               max_bytes;
+
   guint               irreversible;
   guint               in_user;
   guint               max_undo_levels;
@@ -107,7 +145,8 @@ struct _GtkTextHistory
   guint               enabled : 1;
 };
 
-static void action_free (Action *action);
+static void action_free (GtkTextHistory *self,
+                         Action         *action);
 
 G_DEFINE_TYPE (GtkTextHistory, gtk_text_history, G_TYPE_OBJECT)
 
@@ -127,6 +166,303 @@ G_DEFINE_TYPE (GtkTextHistory, gtk_text_history, G_TYPE_OBJECT)
       return;                            \
   } G_STMT_END
 
+static TextChunk *
+text_chunk_new (gsize size)
+{
+  TextChunk *chunk;
+
+  chunk = g_malloc (sizeof (TextChunk) + size);
+  chunk->ref_count = 1;
+  chunk->n_texts = 0;
+  chunk->len = 0;
+  chunk->size = size;
+
+  return chunk;
+}
+
+static TextChunk *
+text_chunk_ref (TextChunk *chunk)
+{
+  chunk->ref_count++;
+
+  return chunk;
+}
+
+static void
+text_chunk_unref (TextChunk *chunk)
+{
+  if (--chunk->ref_count == 0)
+    g_free (chunk);
+}
+
+static inline gsize
+text_chunk_get_cost (TextChunk *chunk)
+{
+  return sizeof (TextChunk) + chunk->size;
+}
+
+/* References @chunk for a HistoryText, charging it to the
+ * budget if it wasn't used by any text yet.
+ */
+static TextChunk *
+gtk_text_history_ref_chunk (GtkTextHistory *self,
+                            TextChunk      *chunk)
+{
+  if (chunk->n_texts++ == 0)
+    self->n_bytes += text_chunk_get_cost (chunk);
+
+  return text_chunk_ref (chunk);
+}
+
+static void
+gtk_text_history_unref_chunk (GtkTextHistory *self,
+                              TextChunk      *chunk)
+{
+  g_assert (chunk->n_texts > 0);
+
+  if (--chunk->n_texts == 0)
+    {
+      g_assert (self->n_bytes >= text_chunk_get_cost (chunk));
+      self->n_bytes -= text_chunk_get_cost (chunk);
+    }
+
+  text_chunk_unref (chunk);
+}
+
+static inline const char *
+history_text_str (const HistoryText *text)
+{
+  if (text->chunk == NULL)
+    return "";
+
+  return text->chunk->data + text->offset;
+}
+
+static inline gboolean
+history_text_empty (const HistoryText *text)
+{
+  return text->n_bytes == 0;
+}
+
+static inline gboolean
+history_text_ends_with_space (const HistoryText *text)
+{
+  return g_ascii_isspace (history_text_str (text)[text->n_bytes - 1]);
+}
+
+static inline gboolean
+history_text_starts_with_space (const HistoryText *text)
+{
+  return g_unichar_isspace (g_utf8_get_char (history_text_str (text)));
+}
+
+static inline gboolean
+history_text_contains_newline (const HistoryText *text)
+{
+  return memchr (history_text_str (text), '\n', text->n_bytes) != NULL;
+}
+
+static gboolean
+history_text_only_contains_space (const HistoryText *text)
+{
+  const char *str = history_text_str (text);
+  const char *end = str + text->n_bytes;
+
+  for (const char *iter = str; iter < end; iter = g_utf8_next_char (iter))
+    {
+      if (!g_unichar_isspace (g_utf8_get_char (iter)))
+        return FALSE;
+    }
+
+  return TRUE;
+}
+
+static gboolean
+history_text_contains_space (const HistoryText *text)
+{
+  const char *str = history_text_str (text);
+  const char *end = str + text->n_bytes;
+
+  for (const char *iter = str; iter < end; iter = g_utf8_next_char (iter))
+    {
+      if (g_unichar_isspace (g_utf8_get_char (iter)))
+        return TRUE;
+    }
+
+  return FALSE;
+}
+
+/* Reserves @n_bytes of storage for @text, which must be empty */
+static char *
+gtk_text_history_alloc_text (GtkTextHistory *self,
+                             HistoryText    *text,
+                             gsize           n_bytes)
+{
+  TextChunk *chunk;
+
+  g_assert (text->chunk == NULL);
+
+  if (n_bytes > TEXT_CHUNK_SIZE / 4)
+    {
+      chunk = text_chunk_new (n_bytes);
+      text->chunk = gtk_text_history_ref_chunk (self, chunk);
+      text_chunk_unref (chunk);
+      text->chunk->len = n_bytes;
+      text->offset = 0;
+    }
+  else
+    {
+      if (self->arena == NULL || self->arena->size - self->arena->len < n_bytes)
+        {
+          g_clear_pointer (&self->arena, text_chunk_unref);
+          self->arena = text_chunk_new (TEXT_CHUNK_SIZE);
+        }
+
+      text->chunk = gtk_text_history_ref_chunk (self, self->arena);
+      text->offset = self->arena->len;
+      self->arena->len += n_bytes;
+    }
+
+  text->n_bytes = n_bytes;
+
+  return text->chunk->data + text->offset;
+}
+
+static void
+gtk_text_history_set_text (GtkTextHistory *self,
+                           HistoryText    *text,
+                           const char     *str,
+                           guint           n_bytes,
+                           guint           n_chars)
+{
+  if (n_bytes > 0)
+    memcpy (gtk_text_history_alloc_text (self, text, n_bytes), str, n_bytes);
+
+  text->n_chars = n_chars;
+}
+
+static void
+gtk_text_history_clear_text (GtkTextHistory *self,
+                             HistoryText    *text)
+{
+  if (text->chunk != NULL)
+    {
+      gtk_text_history_unref_chunk (self, text->chunk);
+      text->chunk = NULL;
+    }
+
+  text->offset = 0;
+  text->n_bytes = 0;
+  text->n_chars = 0;
+}
+
+static void
+gtk_text_history_concat_text (GtkTextHistory *self,
+                              HistoryText    *text,
+                              HistoryText    *first,
+                              HistoryText    *second)
+{
+  HistoryText result = { NULL, };
+  char *dest;
+
+  dest = gtk_text_history_alloc_text (self, &result, first->n_bytes + second->n_bytes);
+  memcpy (dest, history_text_str (first), first->n_bytes);
+  memcpy (dest + first->n_bytes, history_text_str (second), second->n_bytes);
+  result.n_chars = first->n_chars + second->n_chars;
+
+  gtk_text_history_clear_text (self, first);
+  gtk_text_history_clear_text (self, second);
+
+  *text = result;
+}
+
+static inline gboolean
+history_text_is_followed_by (const HistoryText *text,
+                             const HistoryText *other)
+{
+  return text->chunk != NULL &&
+         text->chunk == other->chunk &&
+         text->offset + text->n_bytes == other->offset;
+}
+
+/* Appends @other to @text and clears @other */
+static void
+gtk_text_history_append_text (GtkTextHistory *self,
+                              HistoryText    *text,
+                              HistoryText    *other)
+{
+  if (history_text_empty (other))
+    {
+      gtk_text_history_clear_text (self, other);
+      return;
+    }
+
+  if (history_text_empty (text))
+    {
+      gtk_text_history_clear_text (self, text);
+      *text = *other;
+      *other = (HistoryText) { NULL, };
+      return;
+    }
+
+  /* The common case when typing: the new text was stored right
+   * after the one it continues, so we only need to extend the run.
+   */
+  if (history_text_is_followed_by (text, other))
+    {
+      text->n_bytes += other->n_bytes;
+      text->n_chars += other->n_chars;
+      gtk_text_history_unref_chunk (self, other->chunk);
+      *other = (HistoryText) { NULL, };
+      return;
+    }
+
+  gtk_text_history_concat_text (self, text, text, other);
+}
+
+/* Prepends @other to @text and clears @other */
+static void
+gtk_text_history_prepend_text (GtkTextHistory *self,
+                               HistoryText    *text,
+                               HistoryText    *other)
+{
+  if (history_text_empty (other))
+    {
+      gtk_text_history_clear_text (self, other);
+      return;
+    }
+
+  if (history_text_empty (text))
+    {
+      gtk_text_history_clear_text (self, text);
+      *text = *other;
+      *other = (HistoryText) { NULL, };
+      return;
+    }
+
+  /* When deleting with backspace, the new text is usually stored
+   * right after the one it precedes, so swapping the two in place
+   * avoids leaving a stale copy of the run behind in the arena.
+   */
+  if (history_text_is_followed_by (text, other) && other->n_bytes <= 64)
+    {
+      char *data = text->chunk->data + text->offset;
+      char tmp[64];
+
+      memcpy (tmp, data + text->n_bytes, other->n_bytes);
+      memmove (data + other->n_bytes, data, text->n_bytes);
+      memcpy (data, tmp, other->n_bytes);
+
+      text->n_bytes += other->n_bytes;
+      text->n_chars += other->n_chars;
+      gtk_text_history_unref_chunk (self, other->chunk);
+      *other = (HistoryText) { NULL, };
+      return;
+    }
+
+  gtk_text_history_concat_text (self, text, other, text);
+}
+
 static const char *
 action_kind_name (ActionKind kind)
 {
@@ -177,6 +513,7 @@ gtk_text_history_printf_action (Action  *action,
     case ACTION_KIND_DELETE_SELECTION:
       {
         char *escaped;
+        char *text;
 
         gtk_text_history_printf_space (str, depth+1);
         g_string_append_printf (str, "begin: %u\n", action->u.delete.begin);
@@ -191,24 +528,31 @@ gtk_text_history_printf_action (Action  *action,
         gtk_text_history_printf_space (str, depth+1);
         g_string_append (str, "}\n");
         gtk_text_history_printf_space (str, depth+1);
-        escaped = g_strescape (istring_str (&action->u.delete.istr), NULL);
+        text = g_strndup (history_text_str (&action->u.delete.text),
+                           action->u.delete.text.n_bytes);
+        escaped = g_strescape (text, NULL);
         g_string_append_printf (str, "text: \"%s\"\n", escaped);
         g_free (escaped);
+        g_free (text);
       }
       break;
 
     case ACTION_KIND_INSERT:
       {
         char *escaped;
+        char *text;
 
         gtk_text_history_printf_space (str, depth+1);
         g_string_append_printf (str, "begin: %u\n", action->u.insert.begin);
         gtk_text_history_printf_space (str, depth+1);
         g_string_append_printf (str, "end: %u\n", action->u.insert.end);
         gtk_text_history_printf_space (str, depth+1);
-        escaped = g_strescape (istring_str (&action->u.insert.istr), NULL);
+        text = g_strndup (history_text_str (&action->u.insert.text),
+                           action->u.insert.text.n_bytes);
+        escaped = g_strescape (text, NULL);
         g_string_append_printf (str, "text: \"%s\"\n", escaped);
         g_free (escaped);
+        g_free (text);
       }
       break;
 
@@ -268,7 +612,8 @@ uint_order (guint *a,
 }
 
 static void
-clear_action_queue (GQueue *queue)
+clear_action_queue (GtkTextHistory *self,
+                    GQueue         *queue)
 {
   g_assert (queue != NULL);
 
@@ -276,7 +621,7 @@ clear_action_queue (GQueue *queue)
     {
       Action *action = g_queue_peek_head (queue);
       g_queue_unlink (queue, &action->link);
-      action_free (action);
+      action_free (self, action);
     }
 }
 
@@ -293,17 +638,18 @@ action_new (ActionKind kind)
 }
 
 static void
-action_free (Action *action)
+action_free (GtkTextHistory *self,
+             Action         *action)
 {
   if (action->kind == ACTION_KIND_INSERT)
-    istring_clear (&action->u.insert.istr);
+    gtk_text_history_clear_text (self, &action->u.insert.text);
   else if (action->kind == ACTION_KIND_DELETE_BACKSPACE ||
            action->kind == ACTION_KIND_DELETE_KEY ||
            action->kind == ACTION_KIND_DELETE_PROGRAMMATIC ||
            action->kind == ACTION_KIND_DELETE_SELECTION)
-    istring_clear (&action->u.delete.istr);
+    gtk_text_history_clear_text (self, &action->u.delete.text);
   else if (action->kind == ACTION_KIND_GROUP)
-    clear_action_queue (&action->u.group.actions);
+    clear_action_queue (self, &action->u.group.actions);
 
   g_free (action);
 }
@@ -332,9 +678,10 @@ action_group_is_empty (const Action *action)
 }
 
 static gboolean
-action_chain (Action   *action,
-              Action   *other,
-              gboolean  in_user_action)
+action_chain (GtkTextHistory *self,
+              Action         *action,
+              Action         *other,
+              gboolean        in_user_action)
 {
   g_assert (action != NULL);
   g_assert (other != NULL);
@@ -358,7 +705,7 @@ action_chain (Action   *action,
           if (!in_user_action && action->u.group.depth == 0)
             return FALSE;
 
-          action_free (other);
+          action_free (self, other);
           return TRUE;
         }
 
@@ -369,7 +716,7 @@ action_chain (Action   *action,
        */
       if (tail != NULL && tail->kind == other->kind)
         {
-          if (action_chain (tail, other, in_user_action))
+          if (action_chain (self, tail, other, in_user_action))
             return TRUE;
         }
 
@@ -394,40 +741,40 @@ action_chain (Action   *action,
       if (!in_user_action)
         {
           /* Avoid pathological cases */
-          if (other->u.insert.istr.n_chars > 1000)
+          if (other->u.insert.text.n_chars > 1000)
             return FALSE;
 
           /* We will coalesce space, but not new lines. */
-          if (istring_contains_unichar (&action->u.insert.istr, '\n') ||
-              istring_contains_unichar (&other->u.insert.istr, '\n'))
+          if (history_text_contains_newline (&action->u.insert.text) ||
+              history_text_contains_newline (&other->u.insert.text))
             return FALSE;
 
           /* Chain space to items that ended in space. This is generally
            * just at the start of a line where we could have indentation
            * space.
            */
-          if ((istring_empty (&action->u.insert.istr) ||
-               istring_ends_with_space (&action->u.insert.istr)) &&
-              istring_only_contains_space (&other->u.insert.istr))
+          if ((history_text_empty (&action->u.insert.text) ||
+               history_text_ends_with_space (&action->u.insert.text)) &&
+              history_text_only_contains_space (&other->u.insert.text))
             goto do_chain;
 
           /* Starting a new word, don't chain this */
-          if (istring_starts_with_space (&other->u.insert.istr))
+          if (history_text_starts_with_space (&other->u.insert.text))
             return FALSE;
 
           /* Check for possible paste (multi-character input) or word input that
            * has spaces in it (and should treat as one operation).
            */
-          if (other->u.insert.istr.n_chars > 1 &&
-              istring_contains_space (&other->u.insert.istr))
+          if (other->u.insert.text.n_chars > 1 &&
+              history_text_contains_space (&other->u.insert.text))
             return FALSE;
         }
 
     do_chain:
 
-      istring_append (&action->u.insert.istr, &other->u.insert.istr);
       action->u.insert.end += other->u.insert.end - other->u.insert.begin;
-      action_free (other);
+      gtk_text_history_append_text (self, &action->u.insert.text, &other->u.insert.text);
+      action_free (self, other);
 
       return TRUE;
     }
@@ -449,10 +796,11 @@ action_chain (Action   *action,
     case ACTION_KIND_DELETE_BACKSPACE:
       if (other->u.delete.end == action->u.delete.begin)
         {
-          istring_prepend (&action->u.delete.istr,
-                           &other->u.delete.istr);
+          gtk_text_history_prepend_text (self,
+                                         &action->u.delete.text,
+                                         &other->u.delete.text);
           action->u.delete.begin = other->u.delete.begin;
-          action_free (other);
+          action_free (self, other);
           return TRUE;
         }
 
@@ -461,12 +809,14 @@ action_chain (Action   *action,
     case ACTION_KIND_DELETE_KEY:
       if (action->u.delete.begin == other->u.delete.begin)
         {
-          if (!istring_contains_space (&other->u.delete.istr) ||
-              istring_only_contains_space (&action->u.delete.istr))
+          if (!history_text_contains_space (&other->u.delete.text) ||
+              history_text_only_contains_space (&action->u.delete.text))
             {
-              istring_append (&action->u.delete.istr, &other->u.delete.istr);
-              action->u.delete.end += other->u.delete.istr.n_chars;
-              action_free (other);
+              action->u.delete.end += other->u.delete.text.n_chars;
+              gtk_text_history_append_text (self,
+                                            &action->u.delete.text,
+                                            &other->u.delete.text);
+              action_free (self, other);
               return TRUE;
             }
         }
@@ -475,7 +825,7 @@ action_chain (Action   *action,
 
     case ACTION_KIND_BARRIER:
       /* Only allow a single barrier to be added. */
-      action_free (other);
+      action_free (self, other);
       return TRUE;
 
     case ACTION_KIND_GROUP:
@@ -541,13 +891,13 @@ gtk_text_history_truncate_one (GtkTextHistory *self)
     {
       Action *action = g_queue_peek_head (&self->undo_queue);
       g_queue_unlink (&self->undo_queue, &action->link);
-      action_free (action);
+      action_free (self, action);
     }
   else if (self->redo_queue.length > 0)
     {
       Action *action = g_queue_peek_tail (&self->redo_queue);
       g_queue_unlink (&self->redo_queue, &action->link);
-      action_free (action);
+      action_free (self, action);
     }
   else
     {
@@ -555,16 +905,52 @@ gtk_text_history_truncate_one (GtkTextHistory *self)
     }
 }
 
+static gboolean
+gtk_text_history_is_last_step (GtkTextHistory *self,
+                               Action         *action)
+{
+  GList *tail = self->undo_queue.tail;
+
+  if (tail != NULL && ((Action *)tail->data)->kind == ACTION_KIND_BARRIER)
+    tail = tail->prev;
+
+  return tail == &action->link;
+}
+
 static void
 gtk_text_history_truncate (GtkTextHistory *self)
 {
   g_assert (GTK_IS_TEXT_HISTORY (self));
 
-  if (self->max_undo_levels == 0)
-    return;
+  if (self->max_undo_levels > 0)
+    {
+      while (self->undo_queue.length + self->redo_queue.length > self->max_undo_levels)
+        gtk_text_history_truncate_one (self);
+    }
+
+  if (self->max_bytes > 0)
+    {
+      /* Drop the oldest steps until we are within budget, but always
+       * keep the most recent one so that a large paste can be undone.
+       */
+      while (self->n_bytes > self->max_bytes)
+        {
+          Action *action = g_queue_peek_head (&self->undo_queue);
 
-  while (self->undo_queue.length + self->redo_queue.length > self->max_undo_levels)
-    gtk_text_history_truncate_one (self);
+          if (action != NULL && !gtk_text_history_is_last_step (self, action))
+            {
+              g_queue_unlink (&self->undo_queue, &action->link);
+              action_free (self, action);
+            }
+          else if ((action = g_queue_peek_tail (&self->redo_queue)))
+            {
+              g_queue_unlink (&self->redo_queue, &action->link);
+              action_free (self, action);
+            }
+          else
+            break;
+        }
+    }
 }
 
 static void
@@ -572,8 +958,9 @@ gtk_text_history_finalize (GObject *object)
 {
   GtkTextHistory *self = (GtkTextHistory *)object;
 
-  clear_action_queue (&self->undo_queue);
-  clear_action_queue (&self->redo_queue);
+  clear_action_queue (self, &self->undo_queue);
+  clear_action_queue (self, &self->redo_queue);
+  g_clear_pointer (&self->arena, text_chunk_unref);
 
   G_OBJECT_CLASS (gtk_text_history_parent_class)->finalize (object);
 }
@@ -654,13 +1041,13 @@ gtk_text_history_push (GtkTextHistory *self,
     {
       peek = g_queue_peek_head (&self->redo_queue);
       g_queue_unlink (&self->redo_queue, &peek->link);
-      action_free (peek);
+      action_free (self, peek);
     }
 
   peek = g_queue_peek_tail (&self->undo_queue);
   in_user_action = self->in_user > 0;
 
-  if (peek == NULL || !action_chain (peek, action, in_user_action))
+  if (peek == NULL || !action_chain (self, peek, action, in_user_action))
     g_queue_push_tail_link (&self->undo_queue, &action->link);
 
   gtk_text_history_truncate (self);
@@ -712,8 +1099,8 @@ gtk_text_history_apply (GtkTextHistory *self,
       gtk_text_history_do_insert (self,
                                   action->u.insert.begin,
                                   action->u.insert.end,
-                                  istring_str (&action->u.insert.istr),
-                                  action->u.insert.istr.n_bytes);
+                                  history_text_str (&action->u.insert.text),
+                                  action->u.insert.text.n_bytes);
 
       /* If the next item is a DELETE_SELECTION, then we want to
        * pre-select the text for the user. Otherwise, just place
@@ -737,8 +1124,8 @@ gtk_text_history_apply (GtkTextHistory *self,
       gtk_text_history_do_delete (self,
                                   action->u.delete.begin,
                                   action->u.delete.end,
-                                  istring_str (&action->u.delete.istr),
-                                  action->u.delete.istr.n_bytes);
+                                  history_text_str (&action->u.delete.text),
+                                  action->u.delete.text.n_bytes);
       gtk_text_history_do_select (self,
                                   action->u.delete.begin,
                                   action->u.delete.begin);
@@ -777,8 +1164,8 @@ gtk_text_history_reverse (GtkTextHistory *self,
       gtk_text_history_do_delete (self,
                                   action->u.insert.begin,
                                   action->u.insert.end,
-                                  istring_str (&action->u.insert.istr),
-                                  action->u.insert.istr.n_bytes);
+                                  history_text_str (&action->u.insert.text),
+                                  action->u.insert.text.n_bytes);
       gtk_text_history_do_select (self,
                                   action->u.insert.begin,
                                   action->u.insert.begin);
@@ -791,8 +1178,8 @@ gtk_text_history_reverse (GtkTextHistory *self,
       gtk_text_history_do_insert (self,
                                   action->u.delete.begin,
                                   action->u.delete.end,
-                                  istring_str (&action->u.delete.istr),
-                                  action->u.delete.istr.n_bytes);
+                                  history_text_str (&action->u.delete.text),
+                                  action->u.delete.text.n_bytes);
       if (action->u.delete.selection.insert != -1 &&
           action->u.delete.selection.bound != -1)
         gtk_text_history_do_select (self,
@@ -951,7 +1338,7 @@ gtk_text_history_end_user_action (GtkTextHistory *self)
   return_if_applying (self);
   return_if_irreversible (self);
 
-  clear_action_queue (&self->redo_queue);
+  clear_action_queue (self, &self->redo_queue);
 
   peek = g_queue_peek_tail (&self->undo_queue);
 
@@ -974,7 +1361,7 @@ gtk_text_history_end_user_action (GtkTextHistory *self)
   if (action_group_is_empty (peek))
     {
       g_queue_unlink (&self->undo_queue, &peek->link);
-      action_free (peek);
+      action_free (self, peek);
       goto update_state;
     }
 
@@ -991,7 +1378,7 @@ gtk_text_history_end_user_action (GtkTextHistory *self)
 
       g_queue_unlink (&peek->u.group.actions, link_);
       g_queue_unlink (&self->undo_queue, &peek->link);
-      action_free (peek);
+      action_free (self, peek);
 
       gtk_text_history_push (self, replaced);
 
@@ -1023,8 +1410,8 @@ gtk_text_history_begin_irreversible_action (GtkTextHistory *self)
 
   self->irreversible++;
 
-  clear_action_queue (&self->undo_queue);
-  clear_action_queue (&self->redo_queue);
+  clear_action_queue (self, &self->undo_queue);
+  clear_action_queue (self, &self->redo_queue);
 
   gtk_text_history_update_state (self);
 }
@@ -1045,8 +1432,8 @@ gtk_text_history_end_irreversible_action (GtkTextHistory *self)
 
   self->irreversible--;
 
-  clear_action_queue (&self->undo_queue);
-  clear_action_queue (&self->redo_queue);
+  clear_action_queue (self, &self->undo_queue);
+  clear_action_queue (self, &self->redo_queue);
 
   gtk_text_history_update_state (self);
 }
@@ -1156,7 +1543,7 @@ gtk_text_history_text_inserted (GtkTextHistory *self,
   action = action_new (ACTION_KIND_INSERT);
   action->u.insert.begin = position;
   action->u.insert.end = position + n_chars;
-  istring_set (&action->u.insert.istr, text, len, n_chars);
+  gtk_text_history_set_text (self, &action->u.insert.text, text, len, n_chars);
 
   gtk_text_history_push (self, action);
 }
@@ -1194,7 +1581,8 @@ gtk_text_history_text_deleted (GtkTextHistory *self,
   action->u.delete.end = end;
   action->u.delete.selection.insert = self->selection.insert;
   action->u.delete.selection.bound = self->selection.bound;
-  istring_set (&action->u.delete.istr, text, len, MAX (end, begin) - MIN (end, begin));
+  gtk_text_history_set_text (self, &action->u.delete.text,
+                             text, len, MAX (end, begin) - MIN (end, begin));
 
   gtk_text_history_push (self, action);
 }
@@ -1223,8 +1611,8 @@ gtk_text_history_set_enabled (GtkTextHistory *self,
         {
           self->irreversible = 0;
           self->in_user = 0;
-          clear_action_queue (&self->undo_queue);
-          clear_action_queue (&self->redo_queue);
+          clear_action_queue (self, &self->undo_queue);
+          clear_action_queue (self, &self->redo_queue);
         }
 
       gtk_text_history_update_state (self);
@@ -1251,3 +1639,43 @@ gtk_text_history_set_max_undo_levels (GtkTextHistory *self,
       gtk_text_history_truncate (self);
     }
 }
+
+gsize
+gtk_text_history_get_max_bytes (GtkTextHistory *self)
+{
+  g_return_val_if_fail (GTK_IS_TEXT_HISTORY (self), 0);
+
+  return self->max_bytes;
+}
+
+/*
+ * gtk_text_history_set_max_bytes:
+ * @self: a `GtkTextHistory`
+ * @max_bytes: the maximum amount of memory to keep, or 0 for no limit
+ *
+ * Limits the memory used by the text kept for undo and redo. This
+ * counts the whole storage chunks that the text keeps alive, not
+ * just the bytes of the text. It is applied in addition to the
+ * maximum number of undo levels.
+ */
+void
+gtk_text_history_set_max_bytes (GtkTextHistory *self,
+                                gsize           max_bytes)
+{
+  g_return_if_fail (GTK_IS_TEXT_HISTORY (self));
+
+  if (self->max_bytes != max_bytes)
+    {
+      self->max_bytes = max_bytes;
+      gtk_text_history_truncate (self);
+      gtk_text_history_update_state (self);
+    }
+}
+
+gsize
+gtk_text_history_get_n_bytes (GtkTextHistory *self)
+{
+  g_return_val_if_fail (GTK_IS_TEXT_HISTORY (self), 0);
+
+  return self->n_bytes;
+}
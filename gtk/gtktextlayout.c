@@ -93,12 +93,21 @@
 #include "gtkprivate.h"
 #include "gtkrenderlayoutprivate.h"
 
+#include "gdk/gdkparalleltaskprivate.h"
+
+#include <pango/pangocairo.h>
+#ifdef HAVE_PANGOFT
+#include <pango/pangofc-fontmap.h>
+#endif
+
 #include <stdlib.h>
 #include <string.h>
 
 #define GTK_TEXT_LAYOUT_GET_PRIVATE(o)  ((GtkTextLayoutPrivate *) gtk_text_layout_get_instance_private ((o)))
 
 typedef struct _GtkTextLayoutPrivate GtkTextLayoutPrivate;
+typedef struct _PrefetchTask PrefetchTask;
+typedef struct _PrefetchedSize PrefetchedSize;
 
 struct _GtkTextLayoutPrivate
 {
@@ -109,6 +118,24 @@ struct _GtkTextLayoutPrivate
 
   /* Cache for GtkTextLineDisplay to reduce overhead creating layouts */
   GtkTextLineDisplayCache *cache;
+
+  /* Sizes of invalid lines that were measured in other threads,
+   * see gtk_text_layout_prefetch_sizes(). Bumping the generation
+   * discards the results of a running task.
+   */
+  GHashTable *prefetched;
+  PrefetchTask *prefetch_task;
+  guint prefetch_generation;
+  /* For tests: how many lines used a prefetched size */
+  guint n_prefetch_hits;
+};
+
+struct _PrefetchedSize
+{
+  int width;
+  int height;
+  int top_ink;
+  int bottom_ink;
 };
 
 static void gtk_text_layout_invalidated     (GtkTextLayout     *layout);
@@ -124,6 +151,7 @@ static void gtk_text_layout_emit_changed           (GtkTextLayout     *layout,
 						    int                new_height);
 
 static void gtk_text_layout_invalidate_all (GtkTextLayout *layout);
+static void gtk_text_layout_cancel_prefetch (GtkTextLayout *layout);
 
 static PangoAttribute *gtk_text_attr_appearance_new (const GtkTextAppearance *appearance);
 
@@ -194,6 +222,7 @@ gtk_text_layout_dispose (GObject *object)
   GtkTextLayoutPrivate *priv = GTK_TEXT_LAYOUT_GET_PRIVATE (layout);
 
   g_clear_pointer (&priv->cache, gtk_text_line_display_cache_free);
+  gtk_text_layout_cancel_prefetch (layout);
 
   gtk_text_layout_set_buffer (layout, NULL);
 
@@ -219,10 +248,13 @@ static void
 gtk_text_layout_finalize (GObject *object)
 {
   GtkTextLayout *layout;
+  GtkTextLayoutPrivate *priv;
 
   layout = GTK_TEXT_LAYOUT (object);
+  priv = GTK_TEXT_LAYOUT_GET_PRIVATE (layout);
 
   g_free (layout->preedit_string);
+  g_hash_table_unref (priv->prefetched);
 
   G_OBJECT_CLASS (gtk_text_layout_parent_class)->finalize (object);
 }
@@ -283,6 +315,7 @@ gtk_text_layout_init (GtkTextLayout *text_layout)
 
   text_layout->cursor_visible = TRUE;
   priv->cache = gtk_text_line_display_cache_new ();
+  priv->prefetched = g_hash_table_new_full (NULL, NULL, NULL, g_free);
 }
 
 GtkTextLayout*
@@ -305,6 +338,9 @@ gtk_text_layout_set_buffer (GtkTextLayout *layout,
   if (layout->buffer == buffer)
     return;
 
+  gtk_text_layout_cancel_prefetch (layout);
+  g_hash_table_remove_all (GTK_TEXT_LAYOUT_GET_PRIVATE (layout)->prefetched);
+
   if (layout->buffer)
     {
       _gtk_text_btree_remove_view (_gtk_text_buffer_get_btree (layout->buffer),
@@ -690,6 +726,12 @@ gtk_text_layout_invalidate_cache (GtkTextLayout *layout,
       else
         gtk_text_line_display_cache_invalidate_line (priv->cache, line);
     }
+
+  if (!cursors_only)
+    {
+      g_hash_table_remove (priv->prefetched, line);
+      priv->prefetch_generation++;
+    }
 }
 
 /* Now invalidate the paragraph containing the cursor
@@ -1008,8 +1050,10 @@ gtk_text_layout_wrap (GtkTextLayout   *layout,
                       /* may be NULL */
                       GtkTextLineData *line_data)
 {
+  GtkTextLayoutPrivate *priv = GTK_TEXT_LAYOUT_GET_PRIVATE (layout);
   GtkTextLineDisplay *display;
   PangoRectangle ink_rect, logical_rect;
+  PrefetchedSize *size;
 
   g_return_val_if_fail (GTK_IS_TEXT_LAYOUT (layout), NULL);
   g_return_val_if_fail (line != NULL, NULL);
@@ -1020,6 +1064,27 @@ gtk_text_layout_wrap (GtkTextLayout   *layout,
       _gtk_text_line_add_data (line, line_data);
     }
 
+  /* The cursor line may use the keyboard direction, which the
+   * prefetch didn't know about, so we wrap it ourselves.
+   */
+  if (g_hash_table_steal_extended (priv->prefetched, line, NULL, (gpointer *) &size))
+    {
+      if (line != priv->cursor_line)
+        {
+          priv->n_prefetch_hits++;
+          line_data->width = size->width;
+          line_data->height = size->height;
+          line_data->valid = TRUE;
+          line_data->top_ink = size->top_ink;
+          line_data->bottom_ink = size->bottom_ink;
+          g_free (size);
+
+          return line_data;
+        }
+
+      g_free (size);
+    }
+
   display = gtk_text_layout_get_line_display (layout, line, TRUE);
   line_data->width = display->width;
   line_data->height = display->height;
@@ -1120,32 +1185,30 @@ totally_invisible_line (GtkTextLayout *layout,
   return TRUE;
 }
 
-static void
-set_para_values (GtkTextLayout      *layout,
-                 PangoDirection      base_dir,
-                 GtkTextAttributes  *style,
-                 GtkTextLineDisplay *display)
+/* Resolves the base direction of a paragraph, falling back to the
+ * style direction if the text has no strong direction.
+ */
+static GtkTextDirection
+resolve_para_direction (PangoDirection    *base_dir,
+                        GtkTextAttributes *style)
 {
-  PangoAlignment pango_align = PANGO_ALIGN_LEFT;
-  PangoWrapMode pango_wrap = PANGO_WRAP_WORD;
-  int h_margin;
-  int h_padding;
+  GtkTextDirection direction;
 
-  switch (base_dir)
+  switch (*base_dir)
     {
     /* If no base direction was found, then use the style direction */
     case PANGO_DIRECTION_NEUTRAL :
-      display->direction = style->direction;
+      direction = style->direction;
 
       /* Override the base direction */
-      if (display->direction == GTK_TEXT_DIR_RTL)
-        base_dir = PANGO_DIRECTION_RTL;
+      if (direction == GTK_TEXT_DIR_RTL)
+        *base_dir = PANGO_DIRECTION_RTL;
       else
-        base_dir = PANGO_DIRECTION_LTR;
+        *base_dir = PANGO_DIRECTION_LTR;
 
       break;
     case PANGO_DIRECTION_RTL :
-      display->direction = GTK_TEXT_DIR_RTL;
+      direction = GTK_TEXT_DIR_RTL;
       break;
     case PANGO_DIRECTION_LTR:
     case PANGO_DIRECTION_TTB_LTR:
@@ -1153,14 +1216,26 @@ set_para_values (GtkTextLayout      *layout,
     case PANGO_DIRECTION_WEAK_LTR:
     case PANGO_DIRECTION_WEAK_RTL:
     default:
-      display->direction = GTK_TEXT_DIR_LTR;
+      direction = GTK_TEXT_DIR_LTR;
       break;
     }
 
-  if (display->direction == GTK_TEXT_DIR_RTL)
-    display->layout = pango_layout_new (layout->rtl_context);
-  else
-    display->layout = pango_layout_new (layout->ltr_context);
+  return direction;
+}
+
+/* Sets up the paragraph-wide values of a PangoLayout. This only
+ * uses its arguments, so it is safe to call from other threads.
+ */
+static void
+set_pango_para_values (PangoLayout       *pango_layout,
+                       PangoDirection     base_dir,
+                       GtkTextAttributes *style,
+                       int                screen_width,
+                       int                h_padding)
+{
+  PangoAlignment pango_align = PANGO_ALIGN_LEFT;
+  PangoWrapMode pango_wrap = PANGO_WRAP_WORD;
+  int h_margin;
 
   switch (style->justification)
     {
@@ -1175,29 +1250,21 @@ set_para_values (GtkTextLayout      *layout,
       break;
     case GTK_JUSTIFY_FILL:
       pango_align = (base_dir == PANGO_DIRECTION_LTR) ? PANGO_ALIGN_LEFT : PANGO_ALIGN_RIGHT;
-      pango_layout_set_justify (display->layout, TRUE);
+      pango_layout_set_justify (pango_layout, TRUE);
       break;
     default:
       g_assert_not_reached ();
       break;
     }
 
-  pango_layout_set_alignment (display->layout, pango_align);
-  pango_layout_set_spacing (display->layout,
+  pango_layout_set_alignment (pango_layout, pango_align);
+  pango_layout_set_spacing (pango_layout,
                             style->pixels_inside_wrap * PANGO_SCALE);
 
   if (style->tabs)
-    pango_layout_set_tabs (display->layout, style->tabs);
+    pango_layout_set_tabs (pango_layout, style->tabs);
 
-  display->top_margin = style->pixels_above_lines;
-  display->height = style->pixels_above_lines + style->pixels_below_lines;
-  display->bottom_margin = style->pixels_below_lines;
-  display->left_margin = style->left_margin;
-  display->right_margin = style->right_margin;
-
-  display->x_offset = display->left_margin;
-
-  pango_layout_set_indent (display->layout,
+  pango_layout_set_indent (pango_layout,
                            style->indent * PANGO_SCALE);
 
   switch (style->wrap_mode)
@@ -1218,15 +1285,47 @@ set_para_values (GtkTextLayout      *layout,
       break;
     }
 
-  h_margin = display->left_margin + display->right_margin;
-  h_padding = layout->left_padding + layout->right_padding;
+  h_margin = style->left_margin + style->right_margin;
 
   if (style->wrap_mode != GTK_WRAP_NONE)
     {
-      int layout_width = (layout->screen_width - h_margin - h_padding);
-      pango_layout_set_width (display->layout, layout_width * PANGO_SCALE);
-      pango_layout_set_wrap (display->layout, pango_wrap);
+      int layout_width = (screen_width - h_margin - h_padding);
+      pango_layout_set_width (pango_layout, layout_width * PANGO_SCALE);
+      pango_layout_set_wrap (pango_layout, pango_wrap);
     }
+}
+
+static void
+set_para_values (GtkTextLayout      *layout,
+                 PangoDirection      base_dir,
+                 GtkTextAttributes  *style,
+                 GtkTextLineDisplay *display)
+{
+  int h_margin;
+  int h_padding;
+
+  display->direction = resolve_para_direction (&base_dir, style);
+
+  if (display->direction == GTK_TEXT_DIR_RTL)
+    display->layout = pango_layout_new (layout->rtl_context);
+  else
+    display->layout = pango_layout_new (layout->ltr_context);
+
+  h_padding = layout->left_padding + layout->right_padding;
+
+  set_pango_para_values (display->layout, base_dir, style,
+                         layout->screen_width, h_padding);
+
+  display->top_margin = style->pixels_above_lines;
+  display->height = style->pixels_above_lines + style->pixels_below_lines;
+  display->bottom_margin = style->pixels_below_lines;
+  display->left_margin = style->left_margin;
+  display->right_margin = style->right_margin;
+
+  display->x_offset = display->left_margin;
+
+  h_margin = display->left_margin + display->right_margin;
+
   display->total_width = MAX (layout->screen_width, layout->width) - h_margin - h_padding;
 
   if (style->pg_bg_rgba)
@@ -2203,6 +2302,38 @@ tags_array_toggle_tag (GPtrArray  *array,
   return array;
 }
 
+/* Returns the length of @text without its trailing paragraph
+ * delimiters.
+ */
+static int
+strip_paragraph_delimiters (const char *text,
+                            int         length)
+{
+  /* Only one character has type G_UNICODE_PARAGRAPH_SEPARATOR in
+   * Unicode 3.0; update this if that changes.
+   */
+#define PARAGRAPH_SEPARATOR 0x2029
+  gunichar ch = 0;
+
+  if (length > 0)
+    {
+      const char *prev = g_utf8_prev_char (text + length);
+      ch = g_utf8_get_char (prev);
+      if (ch == PARAGRAPH_SEPARATOR || ch == '\r' || ch == '\n')
+        length = prev - text; /* chop off */
+
+      if (ch == '\n' && length > 0)
+        {
+          /* Possibly chop a CR as well */
+          prev = g_utf8_prev_char (text + length);
+          if (*prev == '\r')
+            --length;
+        }
+    }
+
+  return length;
+}
+
 GtkTextLineDisplay *
 gtk_text_layout_create_display (GtkTextLayout *layout,
                                 GtkTextLine   *line,
@@ -2465,30 +2596,7 @@ gtk_text_layout_create_display (GtkTextLayout *layout,
     }
 
   /* Pango doesn't want the trailing paragraph delimiters */
-
-  {
-    /* Only one character has type G_UNICODE_PARAGRAPH_SEPARATOR in
-     * Unicode 3.0; update this if that changes.
-     */
-#define PARAGRAPH_SEPARATOR 0x2029
-    gunichar ch = 0;
-
-    if (layout_byte_offset > 0)
-      {
-        const char *prev = g_utf8_prev_char (text + layout_byte_offset);
-        ch = g_utf8_get_char (prev);
-        if (ch == PARAGRAPH_SEPARATOR || ch == '\r' || ch == '\n')
-          layout_byte_offset = prev - text; /* chop off */
-
-        if (ch == '\n' && layout_byte_offset > 0)
-          {
-            /* Possibly chop a CR as well */
-            prev = g_utf8_prev_char (text + layout_byte_offset);
-            if (*prev == '\r')
-              --layout_byte_offset;
-          }
-      }
-  }
+  layout_byte_offset = strip_paragraph_delimiters (text, layout_byte_offset);
 
   pango_layout_set_text (display->layout, text, layout_byte_offset);
   pango_layout_set_attributes (display->layout, attrs);
@@ -2559,6 +2667,489 @@ gtk_text_layout_get_line_display (GtkTextLayout *layout,
   return gtk_text_line_display_cache_get (priv->cache, layout, line, size_only);
 }
 
+/*
+ * Measuring lines in other threads
+ *
+ * Validating a large buffer wraps every paragraph once, and most of
+ * that time is spent in Pango. Paragraphs that only contain text in
+ * the default style don't need anything from the buffer once their
+ * text has been copied, so we measure those in other threads ahead
+ * of the validation, and gtk_text_layout_wrap() picks up the result.
+ *
+ * Everything else (tags, paintables, child widgets, the cursor line
+ * with its preedit string) is still wrapped in the main thread.
+ */
+
+/* Invalid lines that are left to the main thread, because the
+ * next validation step is going to wrap them anyway */
+#define GTK_TEXT_LAYOUT_PREFETCH_SKIP_LINES 64
+/* Don't bother with threads for less lines than this */
+#define GTK_TEXT_LAYOUT_PREFETCH_MIN_LINES 256
+#define GTK_TEXT_LAYOUT_PREFETCH_MAX_LINES 2048
+#define GTK_TEXT_LAYOUT_PREFETCH_CHUNK_SIZE 64
+
+typedef struct _PrefetchContext PrefetchContext;
+typedef struct _PrefetchLine PrefetchLine;
+
+/* The settings of a PangoContext, so that worker threads
+ * can create their own equivalent one */
+struct _PrefetchContext
+{
+  PangoFontDescription *font_desc;
+  cairo_font_options_t *font_options;
+  double resolution;
+  PangoLanguage *language;
+  PangoDirection base_dir;
+  PangoGravity base_gravity;
+  PangoGravityHint gravity_hint;
+  gboolean round_glyph_positions;
+};
+
+struct _PrefetchLine
+{
+  GtkTextLine *line;
+  char *text;
+  int length;
+  PangoDirection base_dir;
+  gboolean rtl;
+  PrefetchedSize size;
+};
+
+struct _PrefetchTask
+{
+  GtkTextLayout *layout; /* NULL once cancelled */
+  guint generation;
+
+  GtkTextAttributes *style;
+  PangoAttrList *attrs;
+  PrefetchContext contexts[2]; /* LTR and RTL */
+  /* Of the main thread's default font map */
+  guint font_map_serial;
+#ifdef HAVE_PANGOFT
+  FcConfig *font_config;
+#endif
+  int screen_width;
+  int h_padding;
+
+  PrefetchLine *lines;
+  guint n_lines;
+
+  int cancelled;
+};
+
+static gboolean
+prefetch_context_init (PrefetchContext *self,
+                       PangoContext    *context)
+{
+  const cairo_font_options_t *font_options;
+
+  /* Worker threads use their own default font map, so
+   * this has to be the default font map, too. */
+  if (pango_context_get_font_map (context) != pango_cairo_font_map_get_default () ||
+      pango_context_get_matrix (context) != NULL)
+    return FALSE;
+
+  self->font_desc = pango_font_description_copy (pango_context_get_font_description (context));
+  font_options = pango_cairo_context_get_font_options (context);
+  self->font_options = font_options ? cairo_font_options_copy (font_options) : NULL;
+  self->resolution = pango_cairo_context_get_resolution (context);
+  self->language = pango_context_get_language (context);
+  self->base_dir = pango_context_get_base_dir (context);
+  self->base_gravity = pango_context_get_base_gravity (context);
+  self->gravity_hint = pango_context_get_gravity_hint (context);
+  self->round_glyph_positions = pango_context_get_round_glyph_positions (context);
+
+  return TRUE;
+}
+
+static void
+prefetch_context_clear (PrefetchContext *self)
+{
+  g_clear_pointer (&self->font_desc, pango_font_description_free);
+  g_clear_pointer (&self->font_options, cairo_font_options_destroy);
+}
+
+#ifdef HAVE_PANGOFT
+/* The serial of the main thread's font map that the default
+ * font map of the current thread was last updated for */
+static GPrivate prefetch_font_map_serial;
+#endif
+
+/* Returns the default font map of the current thread, which
+ * is a different one than in the main thread. Fonts that the
+ * application added to the main thread's font map are only
+ * known to its font config, so that one is used here, too.
+ */
+static PangoFontMap *
+prefetch_task_get_font_map (PrefetchTask *task)
+{
+  PangoFontMap *font_map = pango_cairo_font_map_get_default ();
+
+#ifdef HAVE_PANGOFT
+  if (PANGO_IS_FC_FONT_MAP (font_map) &&
+      GPOINTER_TO_UINT (g_private_get (&prefetch_font_map_serial)) != task->font_map_serial)
+    {
+      PangoFcFontMap *fc_font_map = PANGO_FC_FONT_MAP (font_map);
+
+      if (pango_fc_font_map_get_config (fc_font_map) != task->font_config)
+        pango_fc_font_map_set_config (fc_font_map, task->font_config);
+      else
+        pango_fc_font_map_config_changed (fc_font_map);
+
+      g_private_set (&prefetch_font_map_serial, GUINT_TO_POINTER (task->font_map_serial));
+    }
+#endif
+
+  return font_map;
+}
+
+static PangoContext *
+prefetch_context_create_pango_context (PrefetchTask          *task,
+                                       const PrefetchContext *self)
+{
+  PangoContext *context;
+
+  context = pango_font_map_create_context (prefetch_task_get_font_map (task));
+  pango_context_set_font_description (context, self->font_desc);
+  pango_cairo_context_set_font_options (context, self->font_options);
+  pango_cairo_context_set_resolution (context, self->resolution);
+  pango_context_set_language (context, self->language);
+  pango_context_set_base_dir (context, self->base_dir);
+  pango_context_set_base_gravity (context, self->base_gravity);
+  pango_context_set_gravity_hint (context, self->gravity_hint);
+  pango_context_set_round_glyph_positions (context, self->round_glyph_positions);
+
+  return context;
+}
+
+/* This must match what gtk_text_layout_create_display() and
+ * gtk_text_layout_wrap() compute for the line.
+ */
+static void
+prefetch_task_measure_line (PrefetchTask  *task,
+                            PangoContext  *context,
+                            PangoAttrList *attrs,
+                            PrefetchLine  *line)
+{
+  GtkTextAttributes *style = task->style;
+  PangoLayout *pango_layout;
+  PangoRectangle extents, ink_rect, logical_rect;
+  int h_margin;
+
+  pango_layout = pango_layout_new (context);
+  set_pango_para_values (pango_layout, line->base_dir, style,
+                         task->screen_width, task->h_padding);
+  pango_layout_set_text (pango_layout, line->text, line->length);
+  pango_layout_set_attributes (pango_layout, attrs);
+
+  pango_layout_get_extents (pango_layout, NULL, &extents);
+  pango_layout_get_pixel_extents (pango_layout, &ink_rect, &logical_rect);
+
+  h_margin = style->left_margin + style->right_margin;
+
+  line->size.width = PIXEL_BOUND (extents.width) + h_margin + task->h_padding;
+  line->size.height = style->pixels_above_lines + style->pixels_below_lines + PANGO_PIXELS (extents.height);
+  line->size.top_ink = MAX (0, logical_rect.x - ink_rect.x);
+  line->size.bottom_ink = MAX (0, logical_rect.x + logical_rect.width - ink_rect.x - ink_rect.width);
+
+  g_object_unref (pango_layout);
+}
+
+static void
+prefetch_task_measure_chunks (gsize    start,
+                              gsize    end,
+                              gpointer data)
+{
+  PrefetchTask *task = data;
+  PangoContext *contexts[2] = { NULL, NULL };
+  PangoAttrList *attrs;
+  gsize i, j;
+
+  /* Attribute lists are not thread-safe */
+  attrs = pango_attr_list_copy (task->attrs);
+
+  for (i = start; i < end; i++)
+    {
+      if (g_atomic_int_get (&task->cancelled))
+        break;
+
+      for (j = i * GTK_TEXT_LAYOUT_PREFETCH_CHUNK_SIZE;
+           j < MIN ((i + 1) * GTK_TEXT_LAYOUT_PREFETCH_CHUNK_SIZE, task->n_lines);
+           j++)
+        {
+          PrefetchLine *line = &task->lines[j];
+
+          if (contexts[line->rtl] == NULL)
+            contexts[line->rtl] = prefetch_context_create_pango_context (task, &task->contexts[line->rtl]);
+
+          prefetch_task_measure_line (task, contexts[line->rtl], attrs, line);
+        }
+    }
+
+  g_clear_object (&contexts[0]);
+  g_clear_object (&contexts[1]);
+  pango_attr_list_unref (attrs);
+}
+
+static guint
+prefetch_task_get_n_chunks (PrefetchTask *task)
+{
+  return (task->n_lines + GTK_TEXT_LAYOUT_PREFETCH_CHUNK_SIZE - 1) / GTK_TEXT_LAYOUT_PREFETCH_CHUNK_SIZE;
+}
+
+static void
+prefetch_task_thread (GTask        *gtask,
+                      gpointer      source_object,
+                      gpointer      task_data,
+                      GCancellable *cancellable)
+{
+  PrefetchTask *task = task_data;
+
+  gdk_parallel_for (prefetch_task_get_n_chunks (task), 1, prefetch_task_measure_chunks, task);
+
+  g_task_return_boolean (gtask, TRUE);
+}
+
+static void
+prefetch_task_free (PrefetchTask *task)
+{
+  guint i;
+
+  for (i = 0; i < task->n_lines; i++)
+    g_free (task->lines[i].text);
+
+  prefetch_context_clear (&task->contexts[0]);
+  prefetch_context_clear (&task->contexts[1]);
+#ifdef HAVE_PANGOFT
+  g_clear_pointer (&task->font_config, FcConfigDestroy);
+#endif
+  g_free (task->lines);
+  pango_attr_list_unref (task->attrs);
+  gtk_text_attributes_unref (task->style);
+  g_free (task);
+}
+
+static void
+gtk_text_layout_prefetch_done (GObject      *source_object,
+                               GAsyncResult *result,
+                               gpointer      data)
+{
+  PrefetchTask *task = data;
+  GtkTextLayout *layout = task->layout;
+  GtkTextLayoutPrivate *priv;
+  guint i;
+
+  if (layout == NULL)
+    {
+      prefetch_task_free (task);
+      return;
+    }
+
+  priv = GTK_TEXT_LAYOUT_GET_PRIVATE (layout);
+  g_assert (priv->prefetch_task == task);
+  priv->prefetch_task = NULL;
+
+  /* Any invalidation since the task was started may have changed
+   * or freed the lines, so the results can't be trusted anymore.
+   */
+  if (task->generation == priv->prefetch_generation)
+    {
+      for (i = 0; i < task->n_lines; i++)
+        {
+          GtkTextLineData *line_data = _gtk_text_line_get_data (task->lines[i].line, layout);
+
+          if (line_data && line_data->valid)
+            continue;
+
+          g_hash_table_insert (priv->prefetched,
+                               task->lines[i].line,
+                               g_memdup2 (&task->lines[i].size, sizeof (PrefetchedSize)));
+        }
+    }
+
+  prefetch_task_free (task);
+}
+
+static void
+gtk_text_layout_cancel_prefetch (GtkTextLayout *layout)
+{
+  GtkTextLayoutPrivate *priv = GTK_TEXT_LAYOUT_GET_PRIVATE (layout);
+  PrefetchTask *task = priv->prefetch_task;
+
+  if (task == NULL)
+    return;
+
+  g_atomic_int_set (&task->cancelled, TRUE);
+  task->layout = NULL;
+  priv->prefetch_task = NULL;
+}
+
+/* Whether the line can be measured without looking at
+ * anything but its text and the default style.
+ */
+static gboolean
+line_is_plain_text (GtkTextLayout *layout,
+                    GtkTextLine   *line)
+{
+  GtkTextLineSegment *seg;
+  GtkTextIter iter;
+  GPtrArray *tags;
+  gboolean result;
+
+  for (seg = line->segments; seg != NULL; seg = seg->next)
+    {
+      if (seg->type != &gtk_text_char_type &&
+          seg->type != &gtk_text_right_mark_type &&
+          seg->type != &gtk_text_left_mark_type)
+        return FALSE;
+    }
+
+  gtk_text_layout_get_iter_at_line (layout, &iter, line, 0);
+  tags = _gtk_text_btree_get_tags (&iter);
+  result = tags == NULL || tags->len == 0;
+  if (tags != NULL)
+    g_ptr_array_free (tags, TRUE);
+
+  return result;
+}
+
+static void
+prefetch_line_init (PrefetchLine      *self,
+                    GtkTextLine       *line,
+                    GtkTextAttributes *style)
+{
+  GtkTextLineSegment *seg;
+  int length;
+
+  self->line = line;
+  self->text = g_malloc (_gtk_text_line_byte_count (line));
+
+  length = 0;
+  for (seg = line->segments; seg != NULL; seg = seg->next)
+    {
+      if (seg->type == &gtk_text_char_type)
+        {
+          memcpy (self->text + length, seg->body.chars, seg->byte_count);
+          length += seg->byte_count;
+        }
+    }
+  self->length = strip_paragraph_delimiters (self->text, length);
+
+  self->base_dir = line->dir_propagated_forward;
+  if (self->base_dir == PANGO_DIRECTION_NEUTRAL)
+    self->base_dir = line->dir_propagated_back;
+  self->rtl = resolve_para_direction (&self->base_dir, style) == GTK_TEXT_DIR_RTL;
+}
+
+/**
+ * gtk_text_layout_prefetch_sizes:
+ * @layout: a `GtkTextLayout`
+ *
+ * Starts measuring upcoming invalid lines in other threads, so that
+ * later calls to gtk_text_layout_validate() don't have to.
+ *
+ * This only handles lines of plain text in the default style and
+ * does nothing if a previous prefetch is still running or if there
+ * is not enough work to make it worthwhile.
+ */
+void
+gtk_text_layout_prefetch_sizes (GtkTextLayout *layout)
+{
+  GtkTextLayoutPrivate *priv = GTK_TEXT_LAYOUT_GET_PRIVATE (layout);
+  GtkTextLine **lines;
+  PrefetchTask *task;
+  PangoAttribute *last_font_attr = NULL;
+  PangoAttribute *last_scale_attr = NULL;
+  PangoAttribute *last_fallback_attr = NULL;
+  PangoFontMap *font_map;
+  GTask *gtask;
+  guint i, n_lines;
+
+  g_return_if_fail (GTK_IS_TEXT_LAYOUT (layout));
+
+  if (priv->prefetch_task != NULL ||
+      layout->buffer == NULL ||
+      layout->default_style == NULL ||
+      layout->default_style->invisible ||
+      layout->ltr_context == NULL ||
+      layout->rtl_context == NULL ||
+      g_hash_table_size (priv->prefetched) >= GTK_TEXT_LAYOUT_PREFETCH_MAX_LINES)
+    return;
+
+  lines = g_new (GtkTextLine *, GTK_TEXT_LAYOUT_PREFETCH_SKIP_LINES + GTK_TEXT_LAYOUT_PREFETCH_MAX_LINES);
+  n_lines = _gtk_text_btree_get_invalid_lines (_gtk_text_buffer_get_btree (layout->buffer),
+                                               layout,
+                                               lines,
+                                               GTK_TEXT_LAYOUT_PREFETCH_SKIP_LINES + GTK_TEXT_LAYOUT_PREFETCH_MAX_LINES);
+  if (n_lines < GTK_TEXT_LAYOUT_PREFETCH_SKIP_LINES + GTK_TEXT_LAYOUT_PREFETCH_MIN_LINES)
+    {
+      g_free (lines);
+      return;
+    }
+
+  task = g_new0 (PrefetchTask, 1);
+  if (!prefetch_context_init (&task->contexts[0], layout->ltr_context) ||
+      !prefetch_context_init (&task->contexts[1], layout->rtl_context))
+    {
+      prefetch_context_clear (&task->contexts[0]);
+      g_free (task);
+      g_free (lines);
+      return;
+    }
+
+  task->layout = layout;
+  task->generation = priv->prefetch_generation;
+  font_map = pango_cairo_font_map_get_default ();
+  task->font_map_serial = pango_font_map_get_serial (font_map);
+#ifdef HAVE_PANGOFT
+  if (PANGO_IS_FC_FONT_MAP (font_map))
+    {
+      task->font_config = pango_fc_font_map_get_config (PANGO_FC_FONT_MAP (font_map));
+      if (task->font_config)
+        FcConfigReference (task->font_config);
+    }
+#endif
+  task->style = gtk_text_attributes_copy (layout->default_style);
+  task->screen_width = layout->screen_width;
+  task->h_padding = layout->left_padding + layout->right_padding;
+
+  /* The attributes of a line without tags only depend on the default
+   * style, so they can cover any text */
+  task->attrs = pango_attr_list_new ();
+  add_generic_attrs (layout, &task->style->appearance, G_MAXINT,
+                     task->attrs, 0, TRUE, TRUE);
+  add_text_attrs (layout, task->style, G_MAXINT, task->attrs, 0, TRUE,
+                  &last_font_attr, &last_scale_attr, &last_fallback_attr);
+
+  task->lines = g_new (PrefetchLine, n_lines - GTK_TEXT_LAYOUT_PREFETCH_SKIP_LINES);
+  for (i = GTK_TEXT_LAYOUT_PREFETCH_SKIP_LINES; i < n_lines; i++)
+    {
+      if (lines[i] == priv->cursor_line ||
+          g_hash_table_contains (priv->prefetched, lines[i]) ||
+          !line_is_plain_text (layout, lines[i]))
+        continue;
+
+      prefetch_line_init (&task->lines[task->n_lines], lines[i], task->style);
+      task->n_lines++;
+    }
+  g_free (lines);
+
+  if (task->n_lines < GTK_TEXT_LAYOUT_PREFETCH_MIN_LINES)
+    {
+      prefetch_task_free (task);
+      return;
+    }
+
+  priv->prefetch_task = task;
+
+  gtask = g_task_new (NULL, NULL, gtk_text_layout_prefetch_done, task);
+  g_task_set_source_tag (gtask, gtk_text_layout_prefetch_sizes);
+  g_task_set_static_name (gtask, "[gtk] gtk_text_layout_prefetch_sizes");
+  g_task_set_task_data (gtask, task, NULL);
+  g_task_run_in_thread (gtask, prefetch_task_thread);
+  g_object_unref (gtask);
+}
+
 static void
 gtk_text_line_display_finalize (GtkTextLineDisplay *display)
 {
@@ -4239,8 +4830,8 @@ gtk_text_layout_snapshot (GtkTextLayout         *layout,
         }
     }
 
-  /* Only update eviction source once per snapshot */
-  gtk_text_line_display_cache_delay_eviction (priv->cache);
+  /* Only update eviction source and cache sizing once per snapshot */
+  gtk_text_layout_set_visible_lines (layout, first_line, last_line);
 
   gdk_color_finish (&crenderer->fg_color);
 
@@ -4274,3 +4865,69 @@ gtk_text_layout_set_mru_size (GtkTextLayout *layout,
 
   gtk_text_line_display_cache_set_mru_size (priv->cache, mru_size);
 }
+
+void
+gtk_text_layout_get_display_cache_stats (GtkTextLayout                *layout,
+                                         GtkTextLineDisplayCacheStats *stats)
+{
+  GtkTextLayoutPrivate *priv = GTK_TEXT_LAYOUT_GET_PRIVATE (layout);
+
+  g_return_if_fail (GTK_IS_TEXT_LAYOUT (layout));
+  g_return_if_fail (stats != NULL);
+
+  gtk_text_line_display_cache_get_stats (priv->cache, stats);
+}
+
+/*
+ * gtk_text_layout_get_n_prefetch_hits:
+ * @layout: a `GtkTextLayout`
+ *
+ * Returns how many lines were validated with a size that was
+ * measured by gtk_text_layout_prefetch_sizes(). This is meant
+ * for tests.
+ */
+guint
+gtk_text_layout_get_n_prefetch_hits (GtkTextLayout *layout)
+{
+  GtkTextLayoutPrivate *priv = GTK_TEXT_LAYOUT_GET_PRIVATE (layout);
+
+  g_return_val_if_fail (GTK_IS_TEXT_LAYOUT (layout), 0);
+
+  return priv->n_prefetch_hits;
+}
+
+/*
+ * gtk_text_layout_set_visible_lines:
+ * @layout: a `GtkTextLayout`
+ * @first_line: the first visible line
+ * @last_line: the last visible line
+ *
+ * Tells the display cache which lines are shown, so it can size
+ * itself and prefetch the lines around them.
+ */
+void
+gtk_text_layout_set_visible_lines (GtkTextLayout *layout,
+                                   GtkTextLine   *first_line,
+                                   GtkTextLine   *last_line)
+{
+  GtkTextLayoutPrivate *priv = GTK_TEXT_LAYOUT_GET_PRIVATE (layout);
+
+  gtk_text_line_display_cache_set_visible_range (priv->cache, layout, first_line, last_line);
+}
+
+/*
+ * gtk_text_layout_trim_display_cache:
+ * @layout: a `GtkTextLayout`
+ *
+ * Drops the cached displays of all lines that are not visible,
+ * like the cache does by itself after a while without frames.
+ */
+void
+gtk_text_layout_trim_display_cache (GtkTextLayout *layout)
+{
+  GtkTextLayoutPrivate *priv = GTK_TEXT_LAYOUT_GET_PRIVATE (layout);
+
+  g_return_if_fail (GTK_IS_TEXT_LAYOUT (layout));
+
+  gtk_text_line_display_cache_trim (priv->cache);
+}
@@ -179,6 +179,9 @@ struct _GtkTextLineDisplay
   /* GQueue link for use in MRU to help cull cache */
   GList          mru_link;
 
+  /* Estimated memory use, accounted for while in the cache */
+  gsize          cache_cost;
+
   GtkTextDirection direction;
 
   int width;                   /* Width of layout */
@@ -290,6 +293,8 @@ void     gtk_text_layout_validate_yrange (GtkTextLayout *layout,
                                           int            y1_);
 void     gtk_text_layout_validate        (GtkTextLayout *layout,
                                           int            max_pixels);
+void     gtk_text_layout_prefetch_sizes  (GtkTextLayout *layout);
+guint    gtk_text_layout_get_n_prefetch_hits (GtkTextLayout *layout);
 
 GtkTextLineData* gtk_text_layout_wrap  (GtkTextLayout   *layout,
                                         GtkTextLine     *line,
@@ -374,5 +379,32 @@ void gtk_text_layout_snapshot (GtkTextLayout         *layout,
 void gtk_text_layout_set_mru_size (GtkTextLayout *layout,
                                    guint          mru_size);
 
+typedef struct _GtkTextLineDisplayCacheStats GtkTextLineDisplayCacheStats;
+
+struct _GtkTextLineDisplayCacheStats
+{
+  guint64 hits;
+  guint64 misses;
+  guint64 prefetched;
+  guint64 evicted;
+  guint64 inval;
+  guint64 inval_cursors;
+  guint64 inval_by_line;
+  guint64 inval_by_range;
+  guint64 inval_by_y_range;
+
+  guint   n_displays;    /* displays currently cached */
+  guint   capacity;      /* current maximum number of displays */
+  gsize   cost;          /* estimated memory use of the cached displays */
+  double  velocity;      /* scroll speed, in lines per second */
+};
+
+void gtk_text_layout_get_display_cache_stats (GtkTextLayout                *layout,
+                                              GtkTextLineDisplayCacheStats *stats);
+void gtk_text_layout_set_visible_lines       (GtkTextLayout                *layout,
+                                              GtkTextLine                  *first_line,
+                                              GtkTextLine                  *last_line);
+void gtk_text_layout_trim_display_cache      (GtkTextLayout                *layout);
+
 G_END_DECLS
 
@@ -25,8 +25,16 @@
 #include "gtktextlinedisplaycacheprivate.h"
 #include "gtkprivate.h"
 
+#include "gdk/gdkprofilerprivate.h"
+
 #define DEFAULT_MRU_SIZE         250
-#define BLOW_CACHE_TIMEOUT_SEC   20
+#define MAX_MRU_SIZE             4000
+#define TRIM_CACHE_TIMEOUT_SEC   20
+#define MEMORY_BUDGET            (16 * 1024 * 1024)
+#define DISPLAY_COST_BASE        512
+#define DISPLAY_COST_PER_CHAR    48
+#define LOOKAHEAD_USEC           (G_USEC_PER_SEC / 2)
+#define PREFETCH_SLICE_USEC      1000
 #define DEBUG_LINE_DISPLAY_CACHE 0
 
 struct _GtkTextLineDisplayCache
@@ -37,42 +45,69 @@ struct _GtkTextLineDisplayCache
   GQueue       mru;
   GSource     *evict_source;
   guint        mru_size;
+  guint        base_mru_size;
+  gsize        cost;
+
+  /* The visible lines at the last snapshot, and how fast they
+   * move, in lines per second. The first line is kept rather than
+   * its number, since edits above it change the number. It is
+   * cleared when its display is invalidated.
+   */
+  GtkTextLine *first_visible;
+  int          n_visible;
+  gint64       last_visible_time;
+  double       velocity;
+
+  /* Lines to create displays for when idle. Ahead of the
+   * scroll direction first, then behind it.
+   */
+  GtkTextLayout *prefetch_layout;
+  GSource     *prefetch_source;
+  struct {
+    int next;
+    int last;
+    int step;
+  } prefetch[2];
+
+  GtkTextLineDisplayCacheStats stats;
+  guint64      reported_hits;
+  guint64      reported_misses;
 
 #if DEBUG_LINE_DISPLAY_CACHE
   guint       log_source;
-  int         hits;
-  int         misses;
-  int         inval;
-  int         inval_cursors;
-  int         inval_by_line;
-  int         inval_by_range;
-  int         inval_by_y_range;
 #endif
 };
 
 static GQueue purge_in_idle;
 static guint purge_in_idle_source;
 
+static guint hits_counter;
+static guint misses_counter;
+static guint size_counter;
+
+#define STAT_ADD(val,n) ((val) += n)
+#define STAT_INC(val)   STAT_ADD(val,1)
+
 #if DEBUG_LINE_DISPLAY_CACHE
-# define STAT_ADD(val,n) ((val) += n)
-# define STAT_INC(val)   STAT_ADD(val,1)
 static gboolean
 dump_stats (gpointer data)
 {
   GtkTextLineDisplayCache *cache = data;
-  g_printerr ("%p: size=%u hits=%d misses=%d inval_total=%d "
-              "inval_cursors=%d inval_by_line=%d "
-              "inval_by_range=%d inval_by_y_range=%d\n",
+  g_printerr ("%p: size=%u capacity=%u cost=%"G_GSIZE_FORMAT" hits=%"G_GUINT64_FORMAT" "
+              "misses=%"G_GUINT64_FORMAT" prefetched=%"G_GUINT64_FORMAT" "
+              "evicted=%"G_GUINT64_FORMAT" inval_total=%"G_GUINT64_FORMAT" "
+              "inval_cursors=%"G_GUINT64_FORMAT" inval_by_line=%"G_GUINT64_FORMAT" "
+              "inval_by_range=%"G_GUINT64_FORMAT" inval_by_y_range=%"G_GUINT64_FORMAT" "
+              "velocity=%.1f\n",
               cache, g_hash_table_size (cache->line_to_display),
-              cache->hits, cache->misses,
-              cache->inval, cache->inval_cursors,
-              cache->inval_by_line, cache->inval_by_range,
-              cache->inval_by_y_range);
+              cache->mru_size, cache->cost,
+              cache->stats.hits, cache->stats.misses,
+              cache->stats.prefetched, cache->stats.evicted,
+              cache->stats.inval, cache->stats.inval_cursors,
+              cache->stats.inval_by_line, cache->stats.inval_by_range,
+              cache->stats.inval_by_y_range, cache->velocity);
   return G_SOURCE_CONTINUE;
 }
-#else
-# define STAT_ADD(val,n)
-# define STAT_INC(val)
 #endif
 
 GtkTextLineDisplayCache *
@@ -84,11 +119,19 @@ gtk_text_line_display_cache_new (void)
   ret->sorted_by_line = g_sequence_new (NULL);
   ret->line_to_display = g_hash_table_new (NULL, NULL);
   ret->mru_size = DEFAULT_MRU_SIZE;
+  ret->base_mru_size = DEFAULT_MRU_SIZE;
 
 #if DEBUG_LINE_DISPLAY_CACHE
   ret->log_source = g_timeout_add_seconds (1, dump_stats, ret);
 #endif
 
+  if (hits_counter == 0)
+    {
+      hits_counter = gdk_profiler_define_int_counter ("text-display-hits", "Text line display cache hits");
+      misses_counter = gdk_profiler_define_int_counter ("text-display-misses", "Text line display cache misses");
+      size_counter = gdk_profiler_define_int_counter ("text-display-size", "Text line display cache size");
+    }
+
   return g_steal_pointer (&ret);
 }
 
@@ -104,30 +147,139 @@ gtk_text_line_display_cache_free (GtkTextLineDisplayCache *cache)
   g_assert (g_sequence_get_begin_iter (cache->sorted_by_line) == g_sequence_get_end_iter (cache->sorted_by_line));
 
   g_clear_pointer (&cache->evict_source, g_source_destroy);
+  g_clear_pointer (&cache->prefetch_source, g_source_destroy);
   g_clear_pointer (&cache->sorted_by_line, g_sequence_free);
   g_clear_pointer (&cache->line_to_display, g_hash_table_unref);
   g_free (cache);
 }
 
+static gsize
+display_cost (GtkTextLineDisplay *display)
+{
+  gsize cost = sizeof (GtkTextLineDisplay);
+
+  if (display->layout != NULL)
+    cost += DISPLAY_COST_BASE + DISPLAY_COST_PER_CHAR * pango_layout_get_character_count (display->layout);
+
+  return cost;
+}
+
+/* Returns the current number of the first visible line,
+ * or -1 if it isn't known.
+ */
+static int
+gtk_text_line_display_cache_get_first_visible (GtkTextLineDisplayCache *cache)
+{
+  if (cache->first_visible == NULL || cache->n_visible <= 0)
+    return -1;
+
+  return _gtk_text_line_get_number (cache->first_visible);
+}
+
+/* Prefetched lines are more recently used than the visible ones,
+ * so the MRU order can't tell what is on screen.
+ *
+ * @first is the result of gtk_text_line_display_cache_get_first_visible().
+ */
 static gboolean
-gtk_text_line_display_cache_blow_cb (gpointer data)
+gtk_text_line_display_cache_is_visible (GtkTextLineDisplayCache *cache,
+                                        GtkTextLineDisplay      *display,
+                                        int                      first)
 {
-  GtkTextLineDisplayCache *cache = data;
+  int line;
+
+  if (first < 0)
+    return FALSE;
+
+  line = _gtk_text_line_get_number (display->line);
+
+  return line >= first && line < first + cache->n_visible;
+}
+
+/* Evicts least recently used displays until we are within our
+ * capacity and memory budget, but never below @min_size, and
+ * never the visible ones.
+ */
+static void
+gtk_text_line_display_cache_cull (GtkTextLineDisplayCache *cache,
+                                  guint                    min_size)
+{
+  GList *link, *prev;
+  int first = -2;
+
+  for (link = cache->mru.tail; link != NULL; link = prev)
+    {
+      GtkTextLineDisplay *display = link->data;
+
+      if (cache->mru.length <= min_size ||
+          (cache->mru.length <= cache->mru_size && cache->cost <= MEMORY_BUDGET))
+        break;
+
+      prev = link->prev;
+
+      /* Only look up the visible lines once there is work to do */
+      if (first == -2)
+        first = gtk_text_line_display_cache_get_first_visible (cache);
+
+      if (gtk_text_line_display_cache_is_visible (cache, display, first))
+        continue;
+
+      STAT_INC (cache->stats.evicted);
+      gtk_text_line_display_cache_invalidate_display (cache, display, FALSE);
+    }
+}
+
+/*
+ * gtk_text_line_display_cache_trim:
+ * @cache: a GtkTextLineDisplayCache
+ *
+ * Drops all displays except the visible ones, and resets the
+ * capacity to what the view asked for.
+ */
+void
+gtk_text_line_display_cache_trim (GtkTextLineDisplayCache *cache)
+{
+  GList *link, *prev;
+  int first;
 
   g_assert (cache != NULL);
 
 #if DEBUG_LINE_DISPLAY_CACHE
-  g_printerr ("Evicting GtkTextLineDisplayCache\n");
+  g_printerr ("Trimming GtkTextLineDisplayCache\n");
 #endif
 
+  first = gtk_text_line_display_cache_get_first_visible (cache);
+
+  cache->velocity = 0;
+  cache->mru_size = cache->base_mru_size;
+
+  for (link = cache->mru.tail; link != NULL; link = prev)
+    {
+      GtkTextLineDisplay *display = link->data;
+
+      prev = link->prev;
+
+      if (!gtk_text_line_display_cache_is_visible (cache, display, first))
+        gtk_text_line_display_cache_invalidate_display (cache, display, FALSE);
+    }
+}
+
+static gboolean
+gtk_text_line_display_cache_trim_cb (gpointer data)
+{
+  GtkTextLineDisplayCache *cache = data;
+
+  g_assert (cache != NULL);
+
   cache->evict_source = NULL;
 
-  gtk_text_line_display_cache_invalidate (cache);
+  /* Nothing happened for a while, keep only what is on screen */
+  gtk_text_line_display_cache_trim (cache);
 
   return G_SOURCE_REMOVE;
 }
 
-void
+static void
 gtk_text_line_display_cache_delay_eviction (GtkTextLineDisplayCache *cache)
 {
   g_assert (cache != NULL);
@@ -136,18 +288,18 @@ gtk_text_line_display_cache_delay_eviction (GtkTextLineDisplayCache *cache)
     {
       gint64 deadline;
 
-      deadline = g_get_monotonic_time () + (BLOW_CACHE_TIMEOUT_SEC * G_USEC_PER_SEC);
+      deadline = g_get_monotonic_time () + (TRIM_CACHE_TIMEOUT_SEC * G_USEC_PER_SEC);
       g_source_set_ready_time (cache->evict_source, deadline);
     }
   else
     {
       guint tag;
 
-      tag = g_timeout_add_seconds (BLOW_CACHE_TIMEOUT_SEC,
-                                   gtk_text_line_display_cache_blow_cb,
+      tag = g_timeout_add_seconds (TRIM_CACHE_TIMEOUT_SEC,
+                                   gtk_text_line_display_cache_trim_cb,
                                    cache);
       cache->evict_source = g_main_context_find_source_by_id (NULL, tag);
-      g_source_set_static_name (cache->evict_source, "[gtk+] gtk_text_line_display_cache_blow_cb");
+      g_source_set_static_name (cache->evict_source, "[gtk+] gtk_text_line_display_cache_trim_cb");
     }
 }
 
@@ -207,13 +359,11 @@ gtk_text_line_display_cache_take_display (GtkTextLineDisplayCache *cache,
   g_hash_table_insert (cache->line_to_display, display->line, display);
   g_queue_push_head_link (&cache->mru, &display->mru_link);
 
-  /* Cull the cache if we're at capacity */
-  while (cache->mru.length > cache->mru_size)
-    {
-      display = g_queue_peek_tail (&cache->mru);
+  display->cache_cost = display_cost (display);
+  cache->cost += display->cache_cost;
 
-      gtk_text_line_display_cache_invalidate_display (cache, display, FALSE);
-    }
+  /* Cull the cache if we're at capacity, but keep what is visible */
+  gtk_text_line_display_cache_cull (cache, MAX (cache->n_visible, 1));
 }
 
 static gboolean
@@ -279,6 +429,10 @@ gtk_text_line_display_cache_invalidate_display (GtkTextLineDisplayCache *cache,
       g_hash_table_remove (cache->line_to_display, display->line);
       g_queue_unlink (&cache->mru, &display->mru_link);
 
+      g_assert (cache->cost >= display->cache_cost);
+      cache->cost -= display->cache_cost;
+      display->cache_cost = 0;
+
       if (iter != NULL)
         {
           g_sequence_remove (iter);
@@ -304,7 +458,7 @@ gtk_text_line_display_cache_invalidate_display (GtkTextLineDisplayCache *cache,
         }
     }
 
-  STAT_INC (cache->inval);
+  STAT_INC (cache->stats.inval);
 }
 
 /*
@@ -341,7 +495,7 @@ gtk_text_line_display_cache_get (GtkTextLineDisplayCache *cache,
     {
       if (size_only || !display->size_only)
         {
-          STAT_INC (cache->hits);
+          STAT_INC (cache->stats.hits);
 
           if (!size_only && display->line == cache->cursor_line)
             gtk_text_layout_update_display_cursors (layout, display->line, display);
@@ -363,7 +517,7 @@ gtk_text_line_display_cache_get (GtkTextLineDisplayCache *cache,
       gtk_text_line_display_cache_invalidate_display (cache, display, FALSE);
     }
 
-  STAT_INC (cache->misses);
+  STAT_INC (cache->stats.misses);
 
   g_assert (!g_hash_table_lookup (cache->line_to_display, line));
 
@@ -395,9 +549,10 @@ gtk_text_line_display_cache_invalidate (GtkTextLineDisplayCache *cache)
   g_assert (cache->sorted_by_line != NULL);
   g_assert (cache->line_to_display != NULL);
 
-  STAT_ADD (cache->inval, g_hash_table_size (cache->line_to_display));
+  STAT_ADD (cache->stats.inval, g_hash_table_size (cache->line_to_display));
 
   cache->cursor_line = NULL;
+  cache->first_visible = NULL;
 
   while (cache->mru.head != NULL)
     {
@@ -420,7 +575,7 @@ gtk_text_line_display_cache_invalidate_cursors (GtkTextLineDisplayCache *cache,
   g_assert (cache != NULL);
   g_assert (line != NULL);
 
-  STAT_INC (cache->inval_cursors);
+  STAT_INC (cache->stats.inval_cursors);
 
   display = g_hash_table_lookup (cache->line_to_display, line);
 
@@ -447,12 +602,16 @@ gtk_text_line_display_cache_invalidate_line (GtkTextLineDisplayCache *cache,
   g_assert (cache != NULL);
   g_assert (line != NULL);
 
+  /* @line may be about to be freed */
+  if (line == cache->first_visible)
+    cache->first_visible = NULL;
+
   display = g_hash_table_lookup (cache->line_to_display, line);
 
   if (display != NULL)
     gtk_text_line_display_cache_invalidate_display (cache, display, FALSE);
 
-  STAT_INC (cache->inval_by_line);
+  STAT_INC (cache->stats.inval_by_line);
 }
 
 static GSequenceIter *
@@ -553,7 +712,7 @@ gtk_text_line_display_cache_invalidate_range (GtkTextLineDisplayCache *cache,
   g_assert (begin != NULL);
   g_assert (end != NULL);
 
-  STAT_INC (cache->inval_by_range);
+  STAT_INC (cache->stats.inval_by_range);
 
   /* Short-circuit, is_empty() is O(1) */
   if (g_sequence_is_empty (cache->sorted_by_line))
@@ -721,7 +880,7 @@ gtk_text_line_display_cache_invalidate_y_range (GtkTextLineDisplayCache *cache,
   g_assert (cache != NULL);
   g_assert (layout != NULL);
 
-  STAT_INC (cache->inval_by_y_range);
+  STAT_INC (cache->stats.inval_by_y_range);
 
   /* A common pattern is to invalidate the whole buffer using y==0 and
    * old_height==new_height. So special case that instead of walking through
@@ -790,26 +949,234 @@ gtk_text_line_display_cache_set_cursor_line (GtkTextLineDisplayCache *cache,
     gtk_text_line_display_cache_invalidate_display (cache, display, FALSE);
 }
 
+static void
+gtk_text_line_display_cache_update_capacity (GtkTextLineDisplayCache *cache)
+{
+  guint lookahead;
+
+  /* Room for what scrolls by in the lookahead time, in both
+   * directions, on top of what the view asked for.
+   */
+  lookahead = ABS (cache->velocity) * LOOKAHEAD_USEC / G_USEC_PER_SEC;
+  cache->mru_size = MIN (cache->base_mru_size + 2 * lookahead,
+                         MAX (MAX_MRU_SIZE, cache->base_mru_size));
+
+  gtk_text_line_display_cache_cull (cache, cache->n_visible);
+}
+
 void
 gtk_text_line_display_cache_set_mru_size (GtkTextLineDisplayCache *cache,
                                           guint                    mru_size)
 {
-  GtkTextLineDisplay *display;
-
   g_assert (cache != NULL);
 
   if (mru_size == 0)
     mru_size = DEFAULT_MRU_SIZE;
 
-  if (mru_size != cache->mru_size)
+  if (mru_size != cache->base_mru_size)
     {
-      cache->mru_size = mru_size;
+      cache->base_mru_size = mru_size;
+      gtk_text_line_display_cache_update_capacity (cache);
+    }
+}
+
+static inline gboolean
+prefetch_range_is_empty (GtkTextLineDisplayCache *cache,
+                         guint                    i)
+{
+  return (cache->prefetch[i].next - cache->prefetch[i].last) * cache->prefetch[i].step > 0;
+}
+
+static gboolean
+gtk_text_line_display_cache_prefetch_cb (gpointer data)
+{
+  GtkTextLineDisplayCache *cache = data;
+  GtkTextLayout *layout = cache->prefetch_layout;
+  GtkTextBTree *btree;
+  gint64 deadline;
+
+  g_assert (cache != NULL);
+  g_assert (layout != NULL);
+
+  if (layout->buffer == NULL || layout->default_style == NULL)
+    goto done;
 
-      while (cache->mru.length > cache->mru_size)
+  btree = _gtk_text_buffer_get_btree (layout->buffer);
+  deadline = g_get_monotonic_time () + PREFETCH_SLICE_USEC;
+
+  for (guint i = 0; i < G_N_ELEMENTS (cache->prefetch); i++)
+    {
+      while (!prefetch_range_is_empty (cache, i))
         {
-          display = g_queue_peek_tail (&cache->mru);
+          GtkTextLineDisplay *display;
+          GtkTextLine *line;
+          int real_line;
+
+          if (g_get_monotonic_time () > deadline)
+            return G_SOURCE_CONTINUE;
+
+          /* Don't push out what is already there for nothing */
+          if (cache->cost >= MEMORY_BUDGET)
+            goto done;
 
-          gtk_text_line_display_cache_invalidate_display (cache, display, FALSE);
+          line = _gtk_text_btree_get_line_no_last (btree, cache->prefetch[i].next, &real_line);
+          if (line == NULL || real_line != cache->prefetch[i].next)
+            break;
+
+          cache->prefetch[i].next += cache->prefetch[i].step;
+
+          if (g_hash_table_contains (cache->line_to_display, line))
+            continue;
+
+          display = gtk_text_layout_create_display (layout, line, FALSE);
+
+          /* Children need to be positioned, leave that to the
+           * frame that shows them.
+           */
+          if (!display->has_children)
+            {
+              if (line == cache->cursor_line)
+                gtk_text_layout_update_display_cursors (layout, line, display);
+
+              gtk_text_line_display_cache_take_display (cache,
+                                                        gtk_text_line_display_ref (display),
+                                                        layout);
+              STAT_INC (cache->stats.prefetched);
+            }
+
+          gtk_text_line_display_unref (display);
         }
     }
+
+done:
+  cache->prefetch_source = NULL;
+
+  return G_SOURCE_REMOVE;
+}
+
+static void
+gtk_text_line_display_cache_queue_prefetch (GtkTextLineDisplayCache *cache,
+                                            GtkTextLayout           *layout,
+                                            int                      first,
+                                            int                      last)
+{
+  int n_lines;
+  int room;
+  int ahead;
+  int behind;
+
+  n_lines = _gtk_text_btree_line_count (_gtk_text_buffer_get_btree (layout->buffer));
+  room = MAX (0, (int) cache->mru_size - cache->n_visible);
+  ahead = MIN (room, MAX (cache->n_visible, ABS (cache->velocity) * LOOKAHEAD_USEC / G_USEC_PER_SEC));
+  behind = MIN (room - ahead, cache->n_visible / 2);
+
+  if (cache->velocity >= 0)
+    {
+      cache->prefetch[0].next = last + 1;
+      cache->prefetch[0].last = MIN (last + ahead, n_lines - 1);
+      cache->prefetch[0].step = 1;
+      cache->prefetch[1].next = first - 1;
+      cache->prefetch[1].last = MAX (first - behind, 0);
+      cache->prefetch[1].step = -1;
+    }
+  else
+    {
+      cache->prefetch[0].next = first - 1;
+      cache->prefetch[0].last = MAX (first - ahead, 0);
+      cache->prefetch[0].step = -1;
+      cache->prefetch[1].next = last + 1;
+      cache->prefetch[1].last = MIN (last + behind, n_lines - 1);
+      cache->prefetch[1].step = 1;
+    }
+
+  cache->prefetch_layout = layout;
+
+  if (cache->prefetch_source == NULL &&
+      (!prefetch_range_is_empty (cache, 0) || !prefetch_range_is_empty (cache, 1)))
+    {
+      guint tag;
+
+      /* Run after the purge of evicted displays */
+      tag = g_idle_add_full (G_PRIORITY_LOW + 10,
+                             gtk_text_line_display_cache_prefetch_cb,
+                             cache, NULL);
+      cache->prefetch_source = g_main_context_find_source_by_id (NULL, tag);
+      g_source_set_static_name (cache->prefetch_source, "[gtk+] gtk_text_line_display_cache_prefetch_cb");
+    }
+}
+
+/*
+ * gtk_text_line_display_cache_set_visible_range:
+ * @cache: a GtkTextLineDisplayCache
+ * @layout: the GtkTextLayout that was snapshotted
+ * @first_line: the first visible line
+ * @last_line: the last visible line
+ *
+ * Called once per snapshot to let the cache adapt its size to the
+ * viewport and the scrolling speed, and to prefetch the lines that
+ * are about to become visible.
+ */
+void
+gtk_text_line_display_cache_set_visible_range (GtkTextLineDisplayCache *cache,
+                                               GtkTextLayout           *layout,
+                                               GtkTextLine             *first_line,
+                                               GtkTextLine             *last_line)
+{
+  gint64 now;
+  int first;
+  int last;
+
+  g_assert (cache != NULL);
+  g_assert (layout != NULL);
+  g_assert (first_line != NULL);
+  g_assert (last_line != NULL);
+
+  first = _gtk_text_line_get_number (first_line);
+  last = _gtk_text_line_get_number (last_line);
+  now = g_get_monotonic_time ();
+
+  if (cache->first_visible != NULL && now > cache->last_visible_time)
+    {
+      gint64 elapsed = now - cache->last_visible_time;
+      int previous = _gtk_text_line_get_number (cache->first_visible);
+
+      /* Smooth things out a bit, frames are not evenly spaced */
+      if (elapsed < LOOKAHEAD_USEC)
+        cache->velocity = (cache->velocity +
+                           (first - previous) * (double) G_USEC_PER_SEC / elapsed) / 2;
+      else
+        cache->velocity = 0;
+    }
+
+  cache->first_visible = first_line;
+  cache->n_visible = last - first + 1;
+  cache->last_visible_time = now;
+
+  gtk_text_line_display_cache_update_capacity (cache);
+  gtk_text_line_display_cache_queue_prefetch (cache, layout, first, last);
+
+  if (GDK_PROFILER_IS_RUNNING)
+    {
+      gdk_profiler_set_int_counter (hits_counter, cache->stats.hits - cache->reported_hits);
+      gdk_profiler_set_int_counter (misses_counter, cache->stats.misses - cache->reported_misses);
+      gdk_profiler_set_int_counter (size_counter, cache->mru.length);
+      cache->reported_hits = cache->stats.hits;
+      cache->reported_misses = cache->stats.misses;
+    }
+
+  gtk_text_line_display_cache_delay_eviction (cache);
+}
+
+void
+gtk_text_line_display_cache_get_stats (GtkTextLineDisplayCache      *cache,
+                                       GtkTextLineDisplayCacheStats *stats)
+{
+  g_assert (cache != NULL);
+  g_assert (stats != NULL);
+
+  *stats = cache->stats;
+  stats->n_displays = cache->mru.length;
+  stats->capacity = cache->mru_size;
+  stats->cost = cache->cost;
+  stats->velocity = cache->velocity;
 }
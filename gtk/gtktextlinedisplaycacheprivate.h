@@ -31,7 +31,6 @@ GtkTextLineDisplay      *gtk_text_line_display_cache_get                (GtkText
                                                                          GtkTextLayout           *layout,
                                                                          GtkTextLine             *line,
                                                                          gboolean                 size_only);
-void                     gtk_text_line_display_cache_delay_eviction     (GtkTextLineDisplayCache *cache);
 void                     gtk_text_line_display_cache_set_cursor_line    (GtkTextLineDisplayCache *cache,
                                                                          GtkTextLine             *line);
 void                     gtk_text_line_display_cache_invalidate         (GtkTextLineDisplayCache *cache);
@@ -55,6 +54,13 @@ void                     gtk_text_line_display_cache_invalidate_y_range (GtkText
                                                                          gboolean                 cursors_only);
 void                     gtk_text_line_display_cache_set_mru_size       (GtkTextLineDisplayCache *cache,
                                                                          guint                    mru_size);
+void                     gtk_text_line_display_cache_set_visible_range  (GtkTextLineDisplayCache *cache,
+                                                                         GtkTextLayout           *layout,
+                                                                         GtkTextLine             *first_line,
+                                                                         GtkTextLine             *last_line);
+void                     gtk_text_line_display_cache_get_stats          (GtkTextLineDisplayCache      *cache,
+                                                                         GtkTextLineDisplayCacheStats *stats);
+void                     gtk_text_line_display_cache_trim               (GtkTextLineDisplayCache *cache);
 
 G_END_DECLS
 
@@ -5053,6 +5053,7 @@ incremental_validate_callback (gpointer data)
 
   DV(g_print(G_STRLOC"\n"));
 
+  gtk_text_layout_prefetch_sizes (text_view->priv->layout);
   gtk_text_layout_validate (text_view->priv->layout, 2000);
 
   gtk_text_view_update_adjustments (text_view);
@@ -10580,6 +10581,18 @@ gtk_text_view_get_key_controller (GtkTextView *text_view)
   return text_view->priv->key_controller;
 }
 
+gboolean
+gtk_text_view_get_display_cache_stats (GtkTextView                  *text_view,
+                                       GtkTextLineDisplayCacheStats *stats)
+{
+  if (text_view->priv->layout == NULL)
+    return FALSE;
+
+  gtk_text_layout_get_display_cache_stats (text_view->priv->layout, stats);
+
+  return TRUE;
+}
+
 static double
 quantize_value (GtkAdjustment *adjustment,
                 GtkWidget     *widget)
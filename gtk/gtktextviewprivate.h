@@ -21,6 +21,7 @@
 #include "gtktextview.h"
 #include "gtktextattributesprivate.h"
 #include "gtkcssnodeprivate.h"
+#include "gtktextlayoutprivate.h"
 
 G_BEGIN_DECLS
 
@@ -31,6 +32,9 @@ GtkTextAttributes * gtk_text_view_get_default_attributes (GtkTextView *text_view
 
 GtkEventController *gtk_text_view_get_key_controller    (GtkTextView *text_view);
 
+gboolean        gtk_text_view_get_display_cache_stats   (GtkTextView                  *text_view,
+                                                         GtkTextLineDisplayCacheStats *stats);
+
 GHashTable *    gtk_text_view_get_attributes_run        (GtkTextView *self,
                                                          int          offset,
                                                          gboolean     include_defaults,
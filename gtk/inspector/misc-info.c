@@ -32,6 +32,7 @@
 #include "gtkmenubutton.h"
 #include "gtkwidgetprivate.h"
 #include "gtkbinlayout.h"
+#include "gtktextviewprivate.h"
 #include "gtkwidgetprivate.h"
 #include "gdk/gdksurfaceprivate.h"
 
@@ -72,6 +73,8 @@ struct _GtkInspectorMiscInfo
   GtkWidget *renderer_row;
   GtkWidget *renderer;
   GtkWidget *renderer_button;
+  GtkWidget *text_display_cache_row;
+  GtkWidget *text_display_cache;
   GtkWidget *frame_clock_row;
   GtkWidget *frame_clock;
   GtkWidget *frame_clock_button;
@@ -309,6 +312,33 @@ update_renderer (GtkInspectorMiscInfo *sl)
     }
 }
 
+static void
+update_text_display_cache (GtkInspectorMiscInfo *sl)
+{
+  GtkTextLineDisplayCacheStats stats;
+
+  if (GTK_IS_TEXT_VIEW (sl->object) &&
+      gtk_text_view_get_display_cache_stats (GTK_TEXT_VIEW (sl->object), &stats))
+    {
+      guint64 total = stats.hits + stats.misses;
+      char *tmp;
+
+      tmp = g_strdup_printf ("%u / %u lines, %" G_GSIZE_FORMAT " kB, %.0f%% hits, %" G_GUINT64_FORMAT " prefetched",
+                             stats.n_displays, stats.capacity,
+                             stats.cost / 1024,
+                             total > 0 ? 100.0 * stats.hits / total : 0.0,
+                             stats.prefetched);
+      gtk_label_set_label (GTK_LABEL (sl->text_display_cache), tmp);
+      g_free (tmp);
+
+      gtk_widget_set_visible (sl->text_display_cache_row, TRUE);
+    }
+  else
+    {
+      gtk_widget_set_visible (sl->text_display_cache_row, FALSE);
+    }
+}
+
 static void
 update_frame_clock (GtkInspectorMiscInfo *sl)
 {
@@ -413,6 +443,7 @@ update_info (gpointer data)
 
   update_surface (sl);
   update_renderer (sl);
+  update_text_display_cache (sl);
   update_frame_clock (sl);
 
   if (GTK_IS_BUILDABLE (sl->object))
@@ -636,6 +667,8 @@ gtk_inspector_misc_info_class_init (GtkInspectorMiscInfoClass *klass)
   gtk_widget_class_bind_template_child (widget_class, GtkInspectorMiscInfo, renderer_row);
   gtk_widget_class_bind_template_child (widget_class, GtkInspectorMiscInfo, renderer);
   gtk_widget_class_bind_template_child (widget_class, GtkInspectorMiscInfo, renderer_button);
+  gtk_widget_class_bind_template_child (widget_class, GtkInspectorMiscInfo, text_display_cache_row);
+  gtk_widget_class_bind_template_child (widget_class, GtkInspectorMiscInfo, text_display_cache);
   gtk_widget_class_bind_template_child (widget_class, GtkInspectorMiscInfo, frame_clock_row);
   gtk_widget_class_bind_template_child (widget_class, GtkInspectorMiscInfo, frame_clock);
   gtk_widget_class_bind_template_child (widget_class, GtkInspectorMiscInfo, frame_clock_button);
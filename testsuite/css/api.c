@@ -19,6 +19,8 @@
  */
 
 #include <gtk/gtk.h>
+#include <glib/gstdio.h>
+#include <string.h>
 
 static void
 gtk_css_provider_load_data_not_null_terminated (void)
@@ -36,14 +38,274 @@ gtk_css_provider_load_data_not_null_terminated (void)
   g_object_unref (p);
 }
 
+static char *cache_dir;
+
+static char *
+create_stylesheet (const char *color)
+{
+  GString *str = g_string_new (NULL);
+  guint i;
+
+  /* enough rulesets to be cached */
+  for (i = 0; i < 200; i++)
+    g_string_append_printf (str,
+                            "box.item-%u > label:hover, #id-%u:not(:backdrop) {\n"
+                            "  color: %s;\n"
+                            "  margin: %upx 2px;\n"
+                            "  background-image: linear-gradient(to bottom, %s, rgba(0,0,0,0.5));\n"
+                            "}\n",
+                            i, i, color, i % 7, color);
+
+  return g_string_free (str, FALSE);
+}
+
+static char *
+load_to_string (GFile *file)
+{
+  GtkCssProvider *p;
+  char *result;
+
+  p = gtk_css_provider_new ();
+  gtk_css_provider_load_from_file (p, file);
+  result = gtk_css_provider_to_string (p);
+  g_object_unref (p);
+
+  return result;
+}
+
+static guint
+count_cache_files (void)
+{
+  char *dir_name;
+  const char *name;
+  GDir *dir;
+  guint count = 0;
+
+  dir_name = g_build_filename (cache_dir, "gtk-4.0", "css", NULL);
+  dir = g_dir_open (dir_name, 0, NULL);
+  if (dir)
+    {
+      while ((name = g_dir_read_name (dir)))
+        count++;
+      g_dir_close (dir);
+    }
+  g_free (dir_name);
+
+  return count;
+}
+
+static void
+gtk_css_provider_cache (void)
+{
+  char *dir, *main_path, *import_path, *contents;
+  char *uncached, *first, *second;
+  GFile *file;
+  guint n_files;
+
+  dir = g_dir_make_tmp ("gtk-css-XXXXXX", NULL);
+  main_path = g_build_filename (dir, "main.css", NULL);
+  import_path = g_build_filename (dir, "import.css", NULL);
+  file = g_file_new_for_path (main_path);
+
+  g_file_set_contents (main_path, "@import url(\"import.css\");", -1, NULL);
+  contents = create_stylesheet ("red");
+  g_file_set_contents (import_path, contents, -1, NULL);
+  g_free (contents);
+
+  n_files = count_cache_files ();
+
+  /* The first load writes the cache, the second one uses it */
+  first = load_to_string (file);
+  g_assert_cmpuint (count_cache_files (), ==, n_files + 1);
+  second = load_to_string (file);
+  g_assert_cmpstr (first, ==, second);
+  g_free (second);
+
+  /* Changing an imported file invalidates the cache */
+  contents = create_stylesheet ("blue");
+  g_file_set_contents (import_path, contents, -1, NULL);
+  g_free (contents);
+
+  second = load_to_string (file);
+  g_assert_cmpstr (first, !=, second);
+  g_assert_nonnull (strstr (second, "blue"));
+
+  gtk_set_debug_flags (gtk_get_debug_flags () | GTK_DEBUG_NO_CSS_CACHE);
+  uncached = load_to_string (file);
+  gtk_set_debug_flags (gtk_get_debug_flags () & ~GTK_DEBUG_NO_CSS_CACHE);
+  g_assert_cmpstr (uncached, ==, second);
+
+  g_free (uncached);
+  g_free (first);
+  g_free (second);
+  g_object_unref (file);
+  g_remove (import_path);
+  g_remove (main_path);
+  g_rmdir (dir);
+  g_free (import_path);
+  g_free (main_path);
+  g_free (dir);
+}
+
+static char *
+get_cache_file_path (const char *name)
+{
+  return g_build_filename (cache_dir, "gtk-4.0", "css", name, NULL);
+}
+
+static void
+clear_cache_files (void)
+{
+  char *dir_name, *path;
+  const char *name;
+  GDir *dir;
+
+  dir_name = g_build_filename (cache_dir, "gtk-4.0", "css", NULL);
+  dir = g_dir_open (dir_name, 0, NULL);
+  if (dir)
+    {
+      while ((name = g_dir_read_name (dir)))
+        {
+          path = g_build_filename (dir_name, name, NULL);
+          g_remove (path);
+          g_free (path);
+        }
+      g_dir_close (dir);
+    }
+  g_free (dir_name);
+}
+
+/* Returns the contents of the only cache file */
+static GBytes *
+get_cache_contents (void)
+{
+  char *dir_name, *path, *contents;
+  const char *name;
+  GDir *dir;
+  gsize length;
+
+  dir_name = g_build_filename (cache_dir, "gtk-4.0", "css", NULL);
+  dir = g_dir_open (dir_name, 0, NULL);
+  g_assert_nonnull (dir);
+  name = g_dir_read_name (dir);
+  g_assert_nonnull (name);
+  path = g_build_filename (dir_name, name, NULL);
+  g_assert_null (g_dir_read_name (dir));
+  g_dir_close (dir);
+
+  g_assert_true (g_file_get_contents (path, &contents, &length, NULL));
+
+  g_free (path);
+  g_free (dir_name);
+
+  return g_bytes_new_take (contents, length);
+}
+
+static void
+set_mtime (const char *path,
+           gint64      mtime)
+{
+  GFile *file;
+  GError *error = NULL;
+
+  file = g_file_new_for_path (path);
+  g_file_set_attribute_uint64 (file, G_FILE_ATTRIBUTE_TIME_MODIFIED,
+                               mtime / G_TIME_SPAN_SECOND,
+                               G_FILE_QUERY_INFO_NONE, NULL, &error);
+  g_assert_no_error (error);
+  g_object_unref (file);
+}
+
+static void
+gtk_css_provider_cache_prune (void)
+{
+  char *dir, *path, *contents, *string;
+  GBytes *first, *second;
+  GFile *file;
+  gint64 now;
+  guint i;
+
+  dir = g_dir_make_tmp ("gtk-css-XXXXXX", NULL);
+  path = g_build_filename (dir, "main.css", NULL);
+  file = g_file_new_for_path (path);
+  contents = create_stylesheet ("green");
+  g_file_set_contents (path, contents, -1, NULL);
+  g_free (contents);
+
+  clear_cache_files ();
+
+  /* Writing the same style sheet twice gives the same file,
+   * no uninitialized memory is written
+   */
+  string = load_to_string (file);
+  g_free (string);
+  first = get_cache_contents ();
+  clear_cache_files ();
+  string = load_to_string (file);
+  g_free (string);
+  second = get_cache_contents ();
+  g_assert_true (g_bytes_equal (first, second));
+  g_bytes_unref (first);
+  g_bytes_unref (second);
+  clear_cache_files ();
+
+  /* Fill the cache with files of different age, and one that
+   * wasn't used for a long time
+   */
+  now = g_get_real_time ();
+  for (i = 0; i < 20; i++)
+    {
+      char *name = g_strdup_printf ("old-%02u.cache", i);
+      char *cache_path = get_cache_file_path (name);
+
+      g_file_set_contents (cache_path, "", 0, NULL);
+      set_mtime (cache_path, now - (i + 1) * G_TIME_SPAN_MINUTE);
+
+      g_free (cache_path);
+      g_free (name);
+    }
+  contents = get_cache_file_path ("old-00.cache");
+  set_mtime (contents, now - 365 * G_TIME_SPAN_DAY);
+  g_free (contents);
+
+  /* Writing a new cache file deletes the oldest ones */
+  string = load_to_string (file);
+  g_free (string);
+  g_assert_cmpuint (count_cache_files (), ==, 16);
+
+  for (i = 0; i < 20; i++)
+    {
+      char *name = g_strdup_printf ("old-%02u.cache", i);
+      char *cache_path = get_cache_file_path (name);
+
+      /* the new file and 15 of the recent ones are kept */
+      g_assert_cmpint (g_file_test (cache_path, G_FILE_TEST_EXISTS), ==, i > 0 && i <= 15);
+
+      g_free (cache_path);
+      g_free (name);
+    }
+
+  clear_cache_files ();
+  g_object_unref (file);
+  g_remove (path);
+  g_rmdir (dir);
+  g_free (path);
+  g_free (dir);
+}
 
 int
 main (int argc, char *argv[])
 {
+  /* Keep the style sheet cache out of the user's cache */
+  cache_dir = g_dir_make_tmp ("gtk-css-cache-XXXXXX", NULL);
+  g_setenv ("XDG_CACHE_HOME", cache_dir, TRUE);
+
   gtk_test_init (&argc, &argv, NULL);
 
   g_test_add_func ("/gtk_css_provider_load_data/not_null_terminated",
       gtk_css_provider_load_data_not_null_terminated);
+  g_test_add_func ("/gtk_css_provider/cache", gtk_css_provider_cache);
+  g_test_add_func ("/gtk_css_provider/cache-prune", gtk_css_provider_cache_prune);
 
   return g_test_run ();
 }
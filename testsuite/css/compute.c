@@ -27,6 +27,9 @@
 #include "gtk/css/gtkcssparserprivate.h"
 #include "gtk/gtkwidgetprivate.h"
 #include "gtk/gtkcssnodeprivate.h"
+#include "gtk/gtkcssstaticstyleprivate.h"
+#include "gtk/gtkcssselectorprivate.h"
+#include "gtk/gtkcssstyleprivate.h"
 
 static GtkWidget *dummy;
 
@@ -231,6 +234,263 @@ test_color_value (gconstpointer data)
 
 }
 
+#define N_ROWS 10
+
+/* Rows depend on their position, so they don't share a node style
+ * cache and each label is looked up under a different parent. The
+ * style store must still hand out one style per distinct style.
+ */
+static void
+test_shared_styles (void)
+{
+  GtkCssProvider *provider;
+  GtkCssNode *root, *rows[N_ROWS], *labels[N_ROWS];
+  guint hits, misses;
+  int i;
+
+  provider = gtk_css_provider_new ();
+  gtk_css_provider_load_from_string (provider,
+                                     "row:nth-child(odd) { color: red; }\n"
+                                     "row:nth-child(even) { color: blue; }\n"
+                                     "row > label { padding: 1px; }\n");
+  gtk_style_context_add_provider_for_display (gdk_display_get_default (),
+                                              GTK_STYLE_PROVIDER (provider),
+                                              GTK_STYLE_PROVIDER_PRIORITY_APPLICATION);
+
+  root = gtk_css_node_new ();
+  gtk_css_node_set_name (root, g_quark_from_static_string ("list"));
+
+  for (i = 0; i < N_ROWS; i++)
+    {
+      rows[i] = gtk_css_node_new ();
+      gtk_css_node_set_name (rows[i], g_quark_from_static_string ("row"));
+      gtk_css_node_set_parent (rows[i], root);
+      g_object_unref (rows[i]);
+
+      labels[i] = gtk_css_node_new ();
+      gtk_css_node_set_name (labels[i], g_quark_from_static_string ("label"));
+      gtk_css_node_set_parent (labels[i], rows[i]);
+      g_object_unref (labels[i]);
+    }
+
+  gtk_css_static_style_get_store_statistics (NULL, NULL);
+
+  gtk_css_node_validate (root);
+
+  g_assert_true (gtk_css_node_get_style (rows[0]) != gtk_css_node_get_style (rows[1]));
+  g_assert_true (gtk_css_node_get_style (labels[0]) != gtk_css_node_get_style (labels[1]));
+
+  for (i = 2; i < N_ROWS; i++)
+    {
+      g_assert_true (gtk_css_node_get_style (rows[i]) == gtk_css_node_get_style (rows[i % 2]));
+      g_assert_true (gtk_css_node_get_style (labels[i]) == gtk_css_node_get_style (labels[i % 2]));
+    }
+
+  gtk_css_static_style_get_store_statistics (&hits, &misses);
+  g_assert_cmpuint (hits, >=, 2 * (N_ROWS - 2));
+
+  g_object_unref (root);
+
+  gtk_style_context_remove_provider_for_display (gdk_display_get_default (),
+                                                 GTK_STYLE_PROVIDER (provider));
+  g_object_unref (provider);
+}
+
+/* The matching node in the tree built by create_selector_tree() */
+typedef struct {
+  const char *selector;
+  gboolean matches;
+} SelectorTest;
+
+static SelectorTest selector_tests[] = {
+  { "label.target", TRUE },
+  { "box label.target", TRUE },
+  { "#outer label.target", TRUE },
+  { "window #outer .middle label", TRUE },
+  { "#outer > box > label.target", TRUE },
+  { "window > box#outer.ancestor > box.middle > label.target:not(.sibling)", TRUE },
+  { "box box label", TRUE },
+  { ".ancestor .middle > .target", TRUE },
+  { "#outer label.sibling ~ label.target", TRUE },
+  { ".middle > .sibling + .target", TRUE },
+  { "#outer > label.target", FALSE },
+  { ".middle .ancestor label", FALSE },
+  { "#outer .ancestor label", FALSE },
+  { "box box box label", FALSE },
+  { "frame label.target", FALSE },
+  { ".absent label", FALSE },
+  { ".absent ~ label", FALSE },
+  { "#outer .absent > label", FALSE },
+};
+
+/* Returns a class that ends up in the same bloom filter bucket
+ * as @style_class, so the filter can't tell them apart
+ */
+static const char *
+find_colliding_class (const char *style_class)
+{
+  GQuark quark = g_quark_from_string (style_class);
+  guint bucket = (guint16) gtk_css_hash_class (quark) % GTK_COUNTING_BLOOM_FILTER_SIZE;
+  guint i;
+
+  for (i = 0; ; i++)
+    {
+      char *name = g_strdup_printf ("collision-%u", i);
+      GQuark collision = g_quark_from_string (name);
+
+      g_free (name);
+
+      if (collision != quark &&
+          (guint16) gtk_css_hash_class (collision) % GTK_COUNTING_BLOOM_FILTER_SIZE == bucket)
+        return g_quark_to_string (collision);
+    }
+}
+
+static GtkCssNode *
+create_node (GtkCssNode *parent,
+             const char *name,
+             const char *id,
+             const char *style_class)
+{
+  GtkCssNode *node;
+
+  node = gtk_css_node_new ();
+  gtk_css_node_set_name (node, g_quark_from_string (name));
+  if (id)
+    gtk_css_node_set_id (node, g_quark_from_string (id));
+  if (style_class)
+    gtk_css_node_add_class (node, g_quark_from_string (style_class));
+  if (parent)
+    {
+      gtk_css_node_set_parent (node, parent);
+      g_object_unref (node);
+    }
+
+  return node;
+}
+
+/* window
+ *   box#outer.ancestor
+ *     box.middle
+ *       label.sibling
+ *       label.target
+ *   frame.other
+ *     label.target
+ */
+static GtkCssNode *
+create_selector_tree (GtkCssNode **target,
+                      GtkCssNode **others)
+{
+  GtkCssNode *root, *outer, *middle, *frame;
+
+  root = create_node (NULL, "window", NULL, NULL);
+  outer = create_node (root, "box", "outer", "ancestor");
+  middle = create_node (outer, "box", NULL, "middle");
+  others[0] = create_node (middle, "label", NULL, "sibling");
+  *target = create_node (middle, "label", NULL, "target");
+  frame = create_node (root, "frame", NULL, "other");
+  others[1] = create_node (frame, "label", NULL, "target");
+
+  return root;
+}
+
+static gboolean
+selector_matches (const char *text,
+                  GtkCssNode *node)
+{
+  GtkCssParser *parser;
+  GtkCssSelector *selector;
+  GBytes *bytes;
+  gboolean result;
+
+  bytes = g_bytes_new_static (text, strlen (text));
+  parser = gtk_css_parser_new_for_bytes (bytes, NULL, error_func, NULL, NULL);
+  selector = _gtk_css_selector_parse (parser);
+  g_assert_nonnull (selector);
+
+  result = gtk_css_selector_matches (selector, node);
+
+  _gtk_css_selector_free (selector);
+  gtk_css_parser_unref (parser);
+  g_bytes_unref (bytes);
+
+  return result;
+}
+
+static gboolean
+node_is_red (GtkCssNode *node)
+{
+  GtkCssStyle *style = gtk_css_node_get_style (node);
+
+  return gdk_rgba_equal (gtk_css_color_value_get_rgba (style->core->color),
+                         &(GdkRGBA) { 1, 0, 0, 1 });
+}
+
+/* Style validation uses the selector tree and rejects subtrees
+ * with the bloom filter of ancestors. That must match the same
+ * nodes as matching the selector on its own.
+ */
+static void
+check_selector (const char *selector,
+                gboolean    matches)
+{
+  GtkCssProvider *provider;
+  GtkCssNode *root, *target, *others[2];
+  char *css;
+  guint i;
+
+  provider = gtk_css_provider_new ();
+  css = g_strdup_printf ("%s { color: rgb(255,0,0); }", selector);
+  gtk_css_provider_load_from_string (provider, css);
+  g_free (css);
+  gtk_style_context_add_provider_for_display (gdk_display_get_default (),
+                                              GTK_STYLE_PROVIDER (provider),
+                                              GTK_STYLE_PROVIDER_PRIORITY_APPLICATION);
+
+  root = create_selector_tree (&target, others);
+  gtk_css_node_validate (root);
+
+  g_assert_cmpint (selector_matches (selector, target), ==, matches);
+  g_assert_cmpint (node_is_red (target), ==, matches);
+
+  for (i = 0; i < G_N_ELEMENTS (others); i++)
+    g_assert_cmpint (node_is_red (others[i]), ==, selector_matches (selector, others[i]));
+
+  g_object_unref (root);
+
+  gtk_style_context_remove_provider_for_display (gdk_display_get_default (),
+                                                 GTK_STYLE_PROVIDER (provider));
+  g_object_unref (provider);
+}
+
+static void
+test_selector_bloom_filter (void)
+{
+  const char *collision;
+  char *selector;
+  guint i;
+
+  for (i = 0; i < G_N_ELEMENTS (selector_tests); i++)
+    check_selector (selector_tests[i].selector, selector_tests[i].matches);
+
+  /* The filter says the class may be present in the ancestors, so
+   * they need to be walked to find out that it isn't
+   */
+  collision = find_colliding_class ("ancestor");
+
+  selector = g_strdup_printf (".%s label.target", collision);
+  check_selector (selector, FALSE);
+  g_free (selector);
+
+  selector = g_strdup_printf ("#outer .%s > label.target", collision);
+  check_selector (selector, FALSE);
+  g_free (selector);
+
+  selector = g_strdup_printf ("window :not(.%s) > label.target", collision);
+  check_selector (selector, TRUE);
+  g_free (selector);
+}
+
 int
 main (int argc, char **argv)
 {
@@ -257,5 +517,8 @@ main (int argc, char **argv)
       g_free (path);
     }
 
+  g_test_add_func ("/css/compute/shared-styles", test_shared_styles);
+  g_test_add_func ("/css/compute/selector-bloom-filter", test_selector_bloom_filter);
+
   return g_test_run ();
 }
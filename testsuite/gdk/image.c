@@ -68,6 +68,205 @@ test_load_image (gconstpointer data)
   g_free (path);
 }
 
+static float *
+download_float (GdkTexture *texture)
+{
+  GdkTextureDownloader *downloader;
+  gsize stride;
+  float *data;
+
+  stride = 4 * sizeof (float) * gdk_texture_get_width (texture);
+  data = g_malloc (stride * gdk_texture_get_height (texture));
+
+  downloader = gdk_texture_downloader_new (texture);
+  gdk_texture_downloader_set_format (downloader, GDK_MEMORY_R32G32B32A32_FLOAT_PREMULTIPLIED);
+  gdk_texture_downloader_download_into (downloader, (guchar *) data, stride);
+  gdk_texture_downloader_free (downloader);
+
+  return data;
+}
+
+/* Checks that every pixel of @texture is the average of the
+ * @scale x @scale box of @full it was made from, starting at
+ * the origin of @clip.
+ */
+static void
+assert_texture_region (GdkTexture         *texture,
+                       GdkTexture         *full,
+                       const GdkRectangle *clip,
+                       int                 scale,
+                       float               tolerance)
+{
+  int width, height, full_width, x, y, i, j, c;
+  float *data, *full_data;
+
+  width = gdk_texture_get_width (texture);
+  height = gdk_texture_get_height (texture);
+  full_width = gdk_texture_get_width (full);
+  g_assert_cmpint (width * scale, ==, clip->width);
+  g_assert_cmpint (height * scale, ==, clip->height);
+
+  data = download_float (texture);
+  full_data = download_float (full);
+
+  for (y = 0; y < height; y++)
+    for (x = 0; x < width; x++)
+      for (c = 0; c < 4; c++)
+        {
+          float expected = 0;
+
+          for (j = 0; j < scale; j++)
+            for (i = 0; i < scale; i++)
+              expected += full_data[4 * ((clip->y + y * scale + j) * full_width + clip->x + x * scale + i) + c];
+          expected /= scale * scale;
+
+          g_assert_cmpfloat_with_epsilon (data[4 * (y * width + x) + c], expected, tolerance);
+        }
+
+  g_free (full_data);
+  g_free (data);
+}
+
+static GdkTexture *
+load_image_at_size (const char         *filename,
+                    GBytes             *bytes,
+                    const GdkRectangle *clip,
+                    int                 width,
+                    int                 height,
+                    GError            **error)
+{
+  if (g_str_has_suffix (filename, ".png"))
+    return gdk_load_png_at_size (bytes, clip, width, height, error);
+  else if (g_str_has_suffix (filename, ".tiff"))
+    return gdk_load_tiff_at_size (bytes, clip, width, height, error);
+  else if (g_str_has_suffix (filename, ".jpeg"))
+    return gdk_load_jpeg_at_size (bytes, clip, width, height, error);
+  else
+    g_assert_not_reached ();
+}
+
+static void
+test_load_image_at_size (gconstpointer data)
+{
+  const char *filename = data;
+  GdkTexture *full, *texture;
+  char *path;
+  GFile *file;
+  GBytes *bytes;
+  GError *error = NULL;
+  GdkRectangle clip;
+  float exact, approximate;
+  int width, height;
+
+  path = g_test_build_filename (G_TEST_DIST, "image-data", filename, NULL);
+  file = g_file_new_for_path (path);
+  bytes = g_file_load_bytes (file, NULL, NULL, &error);
+  g_assert_no_error (error);
+
+  full = load_image_at_size (filename, bytes, NULL, -1, -1, &error);
+  g_assert_no_error (error);
+  width = gdk_texture_get_width (full);
+  height = gdk_texture_get_height (full);
+
+  if (g_str_has_suffix (filename, ".jpeg"))
+    {
+      /* libjpeg upsamples chroma differently at the edges of a crop,
+       * and scales in the DCT, which is not a box filter */
+      exact = 0.04;
+      approximate = 0.1;
+    }
+  else
+    {
+      exact = 1e-6;
+      approximate = 2.5 / 255;
+    }
+
+  /* Loading everything at the original size is the full image */
+  texture = load_image_at_size (filename, bytes, &(GdkRectangle) { 0, 0, width, height }, width, height, &error);
+  g_assert_no_error (error);
+  assert_texture_region (texture, full, &(GdkRectangle) { 0, 0, width, height }, 1, 1e-6);
+  g_object_unref (texture);
+
+  /* Scaled down by a whole factor, each pixel is the average of a box */
+  g_assert_true (width % 4 == 0 && height % 4 == 0);
+  texture = load_image_at_size (filename, bytes, NULL, width / 4, height / 4, &error);
+  g_assert_no_error (error);
+  assert_texture_region (texture, full, &(GdkRectangle) { 0, 0, width, height }, 4, approximate);
+  g_object_unref (texture);
+
+  /* Scaled down, keeping the aspect ratio */
+  texture = load_image_at_size (filename, bytes, NULL, MAX (width / 3, 1), -1, &error);
+  g_assert_no_error (error);
+  g_assert_cmpint (gdk_texture_get_width (texture), ==, MAX (width / 3, 1));
+  g_assert_cmpint (gdk_texture_get_height (texture), ==, MAX ((gint64) height * MAX (width / 3, 1) / width, 1));
+  g_object_unref (texture);
+
+  /* Scaled up */
+  texture = load_image_at_size (filename, bytes, NULL, width + 7, height * 2, &error);
+  g_assert_no_error (error);
+  g_assert_cmpint (gdk_texture_get_width (texture), ==, width + 7);
+  g_assert_cmpint (gdk_texture_get_height (texture), ==, height * 2);
+  g_object_unref (texture);
+
+  /* Clipped, the clip gets intersected with the image */
+  texture = load_image_at_size (filename, bytes,
+                                &(GdkRectangle) { width / 2, height / 2, width, height },
+                                -1, -1,
+                                &error);
+  g_assert_no_error (error);
+  g_assert_cmpint (gdk_texture_get_width (texture), ==, width - width / 2);
+  g_assert_cmpint (gdk_texture_get_height (texture), ==, height - height / 2);
+  assert_texture_region (texture, full, &(GdkRectangle) { width / 2, height / 2, width - width / 2, height - height / 2 }, 1, exact);
+  g_object_unref (texture);
+
+  /* Clipped at an odd position, the pixels are the ones of the full image */
+  clip = (GdkRectangle) { 5, 7, MIN (17, width - 5), MIN (13, height - 7) };
+  texture = load_image_at_size (filename, bytes, &clip, -1, -1, &error);
+  g_assert_no_error (error);
+  assert_texture_region (texture, full, &clip, 1, exact);
+  g_object_unref (texture);
+
+  /* Clipped and scaled by a whole factor */
+  clip = (GdkRectangle) { 2, 6, 16, 8 };
+  texture = load_image_at_size (filename, bytes, &clip, 8, 4, &error);
+  g_assert_no_error (error);
+  assert_texture_region (texture, full, &clip, 2, approximate);
+  g_object_unref (texture);
+
+  /* Clipped and scaled */
+  texture = load_image_at_size (filename, bytes,
+                                &(GdkRectangle) { 0, height / 4, width / 2, height / 2 },
+                                5, 3,
+                                &error);
+  g_assert_no_error (error);
+  g_assert_cmpint (gdk_texture_get_width (texture), ==, 5);
+  g_assert_cmpint (gdk_texture_get_height (texture), ==, 3);
+  g_object_unref (texture);
+
+  /* Outside of the image */
+  texture = load_image_at_size (filename, bytes,
+                                &(GdkRectangle) { width, 0, 10, 10 },
+                                -1, -1,
+                                &error);
+  g_assert_error (error, G_IO_ERROR, G_IO_ERROR_INVALID_ARGUMENT);
+  g_assert_null (texture);
+  g_clear_error (&error);
+
+  /* The public API doesn't fall back to other loaders for that */
+  texture = gdk_texture_new_from_bytes_at_size (bytes,
+                                                &(GdkRectangle) { width, 0, 10, 10 },
+                                                -1, -1,
+                                                &error);
+  g_assert_error (error, G_IO_ERROR, G_IO_ERROR_INVALID_ARGUMENT);
+  g_assert_null (texture);
+  g_clear_error (&error);
+
+  g_object_unref (full);
+  g_bytes_unref (bytes);
+  g_object_unref (file);
+  g_free (path);
+}
+
 static void
 test_save_image (gconstpointer test_data)
 {
@@ -86,9 +285,9 @@ test_save_image (gconstpointer test_data)
 
   /* Test the internal apis here */
   if (g_str_has_suffix (filename, ".png"))
-    bytes = gdk_save_png (texture);
+    bytes = gdk_save_png (texture, NULL);
   else if (g_str_has_suffix (filename, ".tiff"))
-    bytes = gdk_save_tiff (texture);
+    bytes = gdk_save_tiff (texture, NULL);
   else if (g_str_has_suffix (filename, ".jpeg"))
     bytes = gdk_save_jpeg (texture);
   else
@@ -117,6 +316,113 @@ test_save_image (gconstpointer test_data)
   g_free (path);
 }
 
+/* Big enough to be split into many chunks */
+static GdkTexture *
+make_pattern_texture (GdkMemoryFormat format)
+{
+  GdkTexture *texture;
+  GBytes *bytes;
+  guchar *data;
+  gsize bpp, stride;
+  int width = 512, height = 700;
+  int x, y;
+
+  bpp = format == GDK_MEMORY_R16G16B16A16 ? 8 : 4;
+  stride = width * bpp;
+  /* padding, so the code that reads rows directly has to use the stride */
+  if (format == GDK_MEMORY_R8G8B8A8)
+    stride += 12;
+  data = g_malloc (stride * height);
+  memset (data, 0xAB, stride * height);
+
+  for (y = 0; y < height; y++)
+    for (x = 0; x < width; x++)
+      {
+        guchar *pixel = data + y * stride + x * bpp;
+
+        if (format == GDK_MEMORY_R16G16B16A16)
+          {
+            guint16 *p = (guint16 *) pixel;
+
+            p[0] = x * 97 + y;
+            p[1] = y * 89;
+            p[2] = (x ^ y) * 31;
+            p[3] = 0xFFFF;
+          }
+        else
+          {
+            pixel[0] = x + y;
+            pixel[1] = x * y;
+            pixel[2] = (x / 16) * 16;
+            pixel[3] = 0xFF;
+          }
+      }
+
+  bytes = g_bytes_new_take (data, stride * height);
+  texture = gdk_memory_texture_new (width, height, format, bytes, stride);
+  g_bytes_unref (bytes);
+
+  return texture;
+}
+
+static void
+test_save_options (void)
+{
+  /* R8G8B8A8 is the PNG layout, so it is compressed without converting */
+  GdkMemoryFormat formats[] = { GDK_MEMORY_B8G8R8A8, GDK_MEMORY_R8G8B8A8, GDK_MEMORY_R16G16B16A16 };
+  GdkTextureSavePreset presets[] = {
+    GDK_TEXTURE_SAVE_PRESET_DEFAULT,
+    GDK_TEXTURE_SAVE_PRESET_FAST,
+    GDK_TEXTURE_SAVE_PRESET_SMALL
+  };
+  GdkPngFilter filters[] = {
+    GDK_PNG_FILTER_DEFAULT,
+    GDK_PNG_FILTER_NONE,
+    GDK_PNG_FILTER_SUB,
+    GDK_PNG_FILTER_UP,
+    GDK_PNG_FILTER_AVERAGE,
+    GDK_PNG_FILTER_PAETH,
+    GDK_PNG_FILTER_ADAPTIVE
+  };
+  gsize i, j, k;
+
+  for (i = 0; i < G_N_ELEMENTS (formats); i++)
+    {
+      GdkTexture *texture = make_pattern_texture (formats[i]);
+
+      for (j = 0; j < G_N_ELEMENTS (presets); j++)
+        for (k = 0; k < G_N_ELEMENTS (filters); k++)
+          {
+            GdkTextureSaveOptions *options;
+            GdkTexture *texture2;
+            GBytes *bytes;
+            GError *error = NULL;
+
+            options = gdk_texture_save_options_new (presets[j]);
+            gdk_texture_save_options_set_png_filter (options, filters[k]);
+            gdk_texture_save_options_set_parallel (options, TRUE);
+
+            bytes = gdk_texture_save_to_png_bytes_full (texture, options);
+            texture2 = gdk_texture_new_from_bytes (bytes, &error);
+            g_assert_no_error (error);
+            assert_texture_equal (texture, texture2);
+            g_object_unref (texture2);
+            g_bytes_unref (bytes);
+
+            bytes = gdk_texture_save_to_tiff_bytes_full (texture, options);
+            texture2 = gdk_texture_new_from_bytes (bytes, &error);
+            g_assert_no_error (error);
+            assert_texture_equal (texture, texture2);
+            g_object_unref (texture2);
+            g_bytes_unref (bytes);
+
+            gdk_texture_save_options_free (options);
+          }
+
+      g_object_unref (texture);
+    }
+}
+
 static void
 test_load_image_fail (gconstpointer data)
 {
@@ -135,6 +441,39 @@ test_load_image_fail (gconstpointer data)
   g_free (path);
 }
 
+static void
+test_save_options_preset (void)
+{
+  GdkTextureSaveOptions *options;
+
+  options = gdk_texture_save_options_new (GDK_TEXTURE_SAVE_PRESET_DEFAULT);
+  g_assert_false (gdk_texture_save_options_get_parallel (options));
+
+  gdk_texture_save_options_set_png_filter (options, GDK_PNG_FILTER_PAETH);
+
+  /* the preset decides about parallel compression */
+  gdk_texture_save_options_set_preset (options, GDK_TEXTURE_SAVE_PRESET_FAST);
+  g_assert_cmpint (gdk_texture_save_options_get_preset (options), ==, GDK_TEXTURE_SAVE_PRESET_FAST);
+  g_assert_true (gdk_texture_save_options_get_parallel (options));
+  g_assert_cmpint (gdk_texture_save_options_get_png_filter (options), ==, GDK_PNG_FILTER_PAETH);
+
+  /* invalid filters are rejected */
+  g_test_expect_message ("Gdk", G_LOG_LEVEL_CRITICAL, "*IS_VALID_PNG_FILTER*");
+  gdk_texture_save_options_set_png_filter (options, GDK_PNG_FILTER_ADAPTIVE + 1);
+  g_test_assert_expected_messages ();
+  g_assert_cmpint (gdk_texture_save_options_get_png_filter (options), ==, GDK_PNG_FILTER_PAETH);
+
+  gdk_texture_save_options_set_preset (options, GDK_TEXTURE_SAVE_PRESET_DEFAULT);
+  g_assert_false (gdk_texture_save_options_get_parallel (options));
+
+  /* but can be overridden afterwards */
+  gdk_texture_save_options_set_parallel (options, TRUE);
+  g_assert_true (gdk_texture_save_options_get_parallel (options));
+  g_assert_cmpint (gdk_texture_save_options_get_preset (options), ==, GDK_TEXTURE_SAVE_PRESET_DEFAULT);
+
+  gdk_texture_save_options_free (options);
+}
+
 int
 main (int argc, char *argv[])
 {
@@ -155,6 +494,9 @@ main (int argc, char *argv[])
      char *test = g_strconcat ("/image/load/", name, NULL);
      g_test_add_data_func_full (test, g_strdup (name), test_load_image, g_free);
      g_free (test);
+     test = g_strconcat ("/image/load-at-size/", name, NULL);
+     g_test_add_data_func_full (test, g_strdup (name), test_load_image_at_size, g_free);
+     g_free (test);
    }
 
   g_dir_close (dir);
@@ -176,6 +518,8 @@ main (int argc, char *argv[])
   g_test_add_data_func ("/image/save/image.png", "image.png", test_save_image);
   g_test_add_data_func ("/image/save/image.tiff", "image.tiff", test_save_image);
   g_test_add_data_func ("/image/save/image.jpeg", "image.jpeg", test_save_image);
+  g_test_add_func ("/image/save/options", test_save_options);
+  g_test_add_func ("/image/save/options-preset", test_save_options_preset);
 
   return g_test_run ();
 }
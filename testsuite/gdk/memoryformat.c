@@ -1,5 +1,6 @@
 #include <gdk/gdk.h>
 #include <gdk/gdkmemoryformatprivate.h>
+#include <gdk/gdkcolorstateprivate.h>
 
 static void
 test_depth_merge (void)
@@ -14,12 +15,189 @@ test_depth_merge (void)
     }
 }
 
+static guchar *
+create_random_data (GdkMemoryFormat format,
+                    gsize           width)
+{
+  float (*pixels)[4];
+  guchar *data;
+
+  pixels = g_malloc (sizeof (float) * 4 * width);
+  for (gsize i = 0; i < width; i++)
+    for (gsize c = 0; c < 4; c++)
+      pixels[i][c] = g_test_rand_int_range (0, 256) / 255.f;
+
+  data = g_malloc (gdk_memory_format_bytes_per_pixel (format) * width);
+  gdk_memory_convert (data, gdk_memory_format_bytes_per_pixel (format) * width, format, GDK_COLOR_STATE_SRGB,
+                      (guchar *) pixels, sizeof (float) * 4 * width, GDK_MEMORY_R32G32B32A32_FLOAT, GDK_COLOR_STATE_SRGB,
+                      width, 1);
+
+  g_free (pixels);
+
+  return data;
+}
+
+static float *
+to_float (const guchar    *data,
+          GdkMemoryFormat  format,
+          gsize            width)
+{
+  float *result = g_new (float, 4 * width);
+
+  gdk_memory_convert ((guchar *) result, sizeof (float) * 4 * width, GDK_MEMORY_R32G32B32A32_FLOAT, GDK_COLOR_STATE_SRGB,
+                      data, gdk_memory_format_bytes_per_pixel (format) * width, format, GDK_COLOR_STATE_SRGB,
+                      width, 1);
+
+  return result;
+}
+
+static void
+test_convert_fast_paths (void)
+{
+  static const struct {
+    GdkMemoryFormat src;
+    GdkMemoryFormat dest;
+  } pairs[] = {
+    { GDK_MEMORY_B8G8R8A8_PREMULTIPLIED, GDK_MEMORY_R8G8B8A8_PREMULTIPLIED },
+    { GDK_MEMORY_R8G8B8A8, GDK_MEMORY_B8G8R8A8 },
+    { GDK_MEMORY_R8G8B8A8, GDK_MEMORY_R8G8B8A8_PREMULTIPLIED },
+    { GDK_MEMORY_R8G8B8A8, GDK_MEMORY_B8G8R8A8_PREMULTIPLIED },
+    { GDK_MEMORY_B8G8R8A8, GDK_MEMORY_A8R8G8B8_PREMULTIPLIED },
+    { GDK_MEMORY_R8G8B8A8_PREMULTIPLIED, GDK_MEMORY_R8G8B8A8 },
+    { GDK_MEMORY_B8G8R8A8_PREMULTIPLIED, GDK_MEMORY_R8G8B8A8 },
+    { GDK_MEMORY_R8G8B8, GDK_MEMORY_R8G8B8A8 },
+    { GDK_MEMORY_B8G8R8, GDK_MEMORY_R8G8B8A8_PREMULTIPLIED },
+    { GDK_MEMORY_R16G16B16A16_FLOAT_PREMULTIPLIED, GDK_MEMORY_B8G8R8A8_PREMULTIPLIED },
+    { GDK_MEMORY_R16G16B16A16_FLOAT, GDK_MEMORY_R8G8B8A8 },
+    { GDK_MEMORY_B8G8R8A8_PREMULTIPLIED, GDK_MEMORY_R16G16B16A16_FLOAT_PREMULTIPLIED },
+    { GDK_MEMORY_R8G8B8A8, GDK_MEMORY_R16G16B16A16_FLOAT },
+  };
+  static const gsize widths[] = { 1, 3, 7, 16, 33, 257 };
+
+  g_test_summary ("Checks that the fast conversion paths agree with the generic code");
+
+  for (gsize p = 0; p < G_N_ELEMENTS (pairs); p++)
+    {
+      GdkMemoryFormat src_format = pairs[p].src;
+      GdkMemoryFormat dest_format = pairs[p].dest;
+      gsize src_bpp = gdk_memory_format_bytes_per_pixel (src_format);
+      gsize dest_bpp = gdk_memory_format_bytes_per_pixel (dest_format);
+
+      for (gsize w = 0; w < G_N_ELEMENTS (widths); w++)
+        {
+          gsize width = widths[w];
+          guchar *src, *fast, *slow;
+          float *fast_float, *slow_float, *tmp;
+
+          src = create_random_data (src_format, width);
+
+          fast = g_malloc (dest_bpp * width);
+          gdk_memory_convert (fast, dest_bpp * width, dest_format, GDK_COLOR_STATE_SRGB,
+                              src, src_bpp * width, src_format, GDK_COLOR_STATE_SRGB,
+                              width, 1);
+
+          /* go through floats, which always uses the generic code */
+          tmp = to_float (src, src_format, width);
+          slow = g_malloc (dest_bpp * width);
+          gdk_memory_convert (slow, dest_bpp * width, dest_format, GDK_COLOR_STATE_SRGB,
+                              (guchar *) tmp, sizeof (float) * 4 * width, GDK_MEMORY_R32G32B32A32_FLOAT, GDK_COLOR_STATE_SRGB,
+                              width, 1);
+
+          fast_float = to_float (fast, dest_format, width);
+          slow_float = to_float (slow, dest_format, width);
+
+          for (gsize i = 0; i < 4 * width; i++)
+            g_assert_cmpfloat_with_epsilon (fast_float[i], slow_float[i], 1.5 / 255);
+
+          g_free (fast_float);
+          g_free (slow_float);
+          g_free (tmp);
+          g_free (slow);
+          g_free (fast);
+          g_free (src);
+        }
+    }
+}
+
+static void
+test_convert_color_state_wide (void)
+{
+  static const struct {
+    GdkMemoryFormat src;
+    GdkMemoryFormat dest;
+  } pairs[] = {
+    { GDK_MEMORY_R16G16B16A16_FLOAT_PREMULTIPLIED, GDK_MEMORY_B8G8R8A8_PREMULTIPLIED },
+    { GDK_MEMORY_R16G16B16A16_FLOAT_PREMULTIPLIED, GDK_MEMORY_R8G8B8A8_PREMULTIPLIED },
+    { GDK_MEMORY_R16G16B16A16_FLOAT, GDK_MEMORY_R8G8B8A8_PREMULTIPLIED },
+  };
+  static const struct {
+    GdkColorState *src;
+    GdkColorState *dest;
+  } color_states[] = {
+    { GDK_COLOR_STATE_SRGB_LINEAR, GDK_COLOR_STATE_SRGB },
+    { GDK_COLOR_STATE_SRGB, GDK_COLOR_STATE_SRGB_LINEAR },
+  };
+  const gsize width = 256;
+
+  g_test_summary ("Checks that converting wide formats between color states doesn't quantize to 8 bits first");
+
+  for (gsize p = 0; p < G_N_ELEMENTS (pairs); p++)
+    for (gsize c = 0; c < G_N_ELEMENTS (color_states); c++)
+      {
+        GdkMemoryFormat src_format = pairs[p].src;
+        GdkMemoryFormat dest_format = pairs[p].dest;
+        gsize src_bpp = gdk_memory_format_bytes_per_pixel (src_format);
+        gsize dest_bpp = gdk_memory_format_bytes_per_pixel (dest_format);
+        float (*pixels)[4];
+        guchar *src, *result;
+        float *expected, *result_float;
+
+        /* Dark values that fall between 8-bit steps, where the
+         * transfer functions are steepest */
+        pixels = g_malloc (sizeof (float) * 4 * width);
+        for (gsize i = 0; i < width; i++)
+          {
+            pixels[i][0] = i / (width * 32.f);
+            pixels[i][1] = i / (width * 8.f);
+            pixels[i][2] = g_test_rand_double_range (0, 0.02);
+            pixels[i][3] = 1.f;
+          }
+
+        src = g_malloc (src_bpp * width);
+        gdk_memory_convert (src, src_bpp * width, src_format, color_states[c].src,
+                            (guchar *) pixels, sizeof (float) * 4 * width, GDK_MEMORY_R32G32B32A32_FLOAT, color_states[c].src,
+                            width, 1);
+
+        expected = g_new (float, 4 * width);
+        gdk_memory_convert ((guchar *) expected, sizeof (float) * 4 * width, GDK_MEMORY_R32G32B32A32_FLOAT, color_states[c].dest,
+                            src, src_bpp * width, src_format, color_states[c].src,
+                            width, 1);
+
+        result = g_malloc (dest_bpp * width);
+        gdk_memory_convert (result, dest_bpp * width, dest_format, color_states[c].dest,
+                            src, src_bpp * width, src_format, color_states[c].src,
+                            width, 1);
+        result_float = to_float (result, dest_format, width);
+
+        for (gsize i = 0; i < 4 * width; i++)
+          g_assert_cmpfloat_with_epsilon (result_float[i], expected[i], 0.5 / 255 + 0.001);
+
+        g_free (result_float);
+        g_free (result);
+        g_free (expected);
+        g_free (src);
+        g_free (pixels);
+      }
+}
+
 int
 main (int argc, char *argv[])
 {
   (g_test_init) (&argc, &argv, NULL);
 
   g_test_add_func ("/depth/merge", test_depth_merge);
+  g_test_add_func ("/convert/fast-paths", test_convert_fast_paths);
+  g_test_add_func ("/convert/color-state-wide", test_convert_color_state_wide);
 
   return g_test_run ();
 }
@@ -0,0 +1,127 @@
+#include <gtk.h>
+
+#include "gdk/gdkparalleltaskprivate.h"
+
+typedef struct {
+  gsize grain;
+  int *hits;
+} RangeData;
+
+static void
+count_range (gsize    start,
+             gsize    end,
+             gpointer user_data)
+{
+  RangeData *data = user_data;
+
+  g_assert_cmpuint (start, <, end);
+  g_assert_cmpuint (end - start, <=, data->grain);
+
+  for (gsize i = start; i < end; i++)
+    g_atomic_int_inc (&data->hits[i]);
+}
+
+static void
+run_and_check (gsize n_items,
+               gsize grain)
+{
+  RangeData data;
+
+  data.grain = grain;
+  data.hits = g_new0 (int, n_items);
+
+  gdk_parallel_for (n_items, grain, count_range, &data);
+
+  for (gsize i = 0; i < n_items; i++)
+    g_assert_cmpint (data.hits[i], ==, 1);
+
+  g_free (data.hits);
+}
+
+static void
+test_parallel_for (void)
+{
+  g_test_summary ("Checks that gdk_parallel_for covers every item exactly once");
+
+  run_and_check (0, 1);
+  run_and_check (1, 1);
+  run_and_check (17, 100);
+  run_and_check (1000, 1);
+  run_and_check (100000, 7);
+  run_and_check (123457, 512);
+}
+
+static void
+nested_range (gsize    start,
+              gsize    end,
+              gpointer user_data)
+{
+  for (gsize i = start; i < end; i++)
+    run_and_check (1000, 3);
+}
+
+static void
+test_parallel_for_nested (void)
+{
+  g_test_summary ("Checks that gdk_parallel_for can be called from inside a task");
+
+  gdk_parallel_for (64, 1, nested_range, NULL);
+}
+
+static gpointer
+parallel_for_thread (gpointer unused)
+{
+  for (guint i = 0; i < 50; i++)
+    run_and_check (g_random_int_range (0, 10000), g_random_int_range (1, 64));
+
+  return NULL;
+}
+
+static void
+test_parallel_for_threads (void)
+{
+  GThread *threads[4];
+
+  g_test_summary ("Checks that gdk_parallel_for can be called from many threads at once");
+
+  for (guint i = 0; i < G_N_ELEMENTS (threads); i++)
+    threads[i] = g_thread_new ("parallel-for", parallel_for_thread, NULL);
+
+  for (guint i = 0; i < G_N_ELEMENTS (threads); i++)
+    g_thread_join (threads[i]);
+}
+
+static void
+count_task (gpointer user_data)
+{
+  g_atomic_int_inc ((int *) user_data);
+}
+
+static void
+test_task_run (void)
+{
+  int count = 0;
+
+  g_test_summary ("Checks that gdk_parallel_task_run runs the task at least once and at most max_tasks times");
+
+  gdk_parallel_task_run (count_task, &count, 1);
+  g_assert_cmpint (count, ==, 1);
+
+  count = 0;
+  gdk_parallel_task_run (count_task, &count, 8);
+  g_assert_cmpint (count, >=, 1);
+  g_assert_cmpint (count, <=, 8);
+}
+
+int
+main (int argc, char *argv[])
+{
+  gtk_test_init (&argc, &argv, NULL);
+
+  g_test_add_func ("/paralleltask/for", test_parallel_for);
+  g_test_add_func ("/paralleltask/for-nested", test_parallel_for_nested);
+  g_test_add_func ("/paralleltask/for-threads", test_parallel_for_threads);
+  g_test_add_func ("/paralleltask/task-run", test_task_run);
+
+  return g_test_run ();
+}
@@ -0,0 +1,237 @@
+#include <gtk/gtk.h>
+
+/* {{{ A stream that returns the data in small pieces */
+
+#define CHUNKED_TYPE_INPUT_STREAM (chunked_input_stream_get_type ())
+G_DECLARE_FINAL_TYPE (ChunkedInputStream, chunked_input_stream, CHUNKED, INPUT_STREAM, GInputStream)
+
+struct _ChunkedInputStream
+{
+  GInputStream parent_instance;
+
+  GBytes *bytes;
+  gsize position;
+  gsize chunk_size;
+};
+
+G_DEFINE_TYPE (ChunkedInputStream, chunked_input_stream, G_TYPE_INPUT_STREAM)
+
+static gssize
+chunked_input_stream_read (GInputStream  *stream,
+                           void          *buffer,
+                           gsize          count,
+                           GCancellable  *cancellable,
+                           GError       **error)
+{
+  ChunkedInputStream *self = CHUNKED_INPUT_STREAM (stream);
+  const guchar *data;
+  gsize size;
+
+  data = g_bytes_get_data (self->bytes, &size);
+  count = MIN (count, MIN (self->chunk_size, size - self->position));
+  memcpy (buffer, data + self->position, count);
+  self->position += count;
+
+  return count;
+}
+
+static void
+chunked_input_stream_finalize (GObject *object)
+{
+  ChunkedInputStream *self = CHUNKED_INPUT_STREAM (object);
+
+  g_bytes_unref (self->bytes);
+
+  G_OBJECT_CLASS (chunked_input_stream_parent_class)->finalize (object);
+}
+
+static void
+chunked_input_stream_class_init (ChunkedInputStreamClass *klass)
+{
+  G_OBJECT_CLASS (klass)->finalize = chunked_input_stream_finalize;
+  G_INPUT_STREAM_CLASS (klass)->read_fn = chunked_input_stream_read;
+}
+
+static void
+chunked_input_stream_init (ChunkedInputStream *self)
+{
+}
+
+static GInputStream *
+chunked_input_stream_new (GBytes *bytes,
+                          gsize   chunk_size)
+{
+  ChunkedInputStream *self;
+
+  self = g_object_new (CHUNKED_TYPE_INPUT_STREAM, NULL);
+  self->bytes = g_bytes_ref (bytes);
+  self->chunk_size = chunk_size;
+
+  return G_INPUT_STREAM (self);
+}
+
+/* }}} */
+
+static void
+assert_texture_equal (GdkTexture *t1,
+                      GdkTexture *t2)
+{
+  int width;
+  int height;
+  int stride;
+  guchar *d1;
+  guchar *d2;
+
+  width = gdk_texture_get_width (t1);
+  height = gdk_texture_get_height (t1);
+  stride = 4 * width;
+
+  g_assert_cmpint (width, ==, gdk_texture_get_width (t2));
+  g_assert_cmpint (height, ==, gdk_texture_get_height (t2));
+
+  d1 = g_malloc (stride * height);
+  d2 = g_malloc (stride * height);
+
+  gdk_texture_download (t1, d1, stride);
+  gdk_texture_download (t2, d2, stride);
+
+  g_assert_cmpmem (d1, stride * height, d2, stride * height);
+
+  g_free (d1);
+  g_free (d2);
+}
+
+static gboolean done;
+
+static void
+load_done (GObject      *source,
+           GAsyncResult *result,
+           gpointer      data)
+{
+  GError **error = data;
+
+  gdk_progressive_image_load_finish (GDK_PROGRESSIVE_IMAGE (source), result, error);
+
+  done = TRUE;
+  g_main_context_wakeup (NULL);
+}
+
+static void
+load_stream (GdkProgressiveImage  *image,
+             GInputStream         *stream,
+             GError              **error)
+{
+  done = FALSE;
+  gdk_progressive_image_load_async (image, stream, G_PRIORITY_DEFAULT, NULL, load_done, error);
+  g_assert_true (gdk_progressive_image_is_loading (image));
+
+  while (!done)
+    g_main_context_iteration (NULL, TRUE);
+
+  g_assert_false (gdk_progressive_image_is_loading (image));
+}
+
+static GBytes *
+get_image_bytes (const char *name)
+{
+  GBytes *bytes;
+  char *path;
+  char *contents;
+  gsize length;
+  GError *error = NULL;
+
+  path = g_test_build_filename (G_TEST_DIST, "image-data", name, NULL);
+  g_file_get_contents (path, &contents, &length, &error);
+  g_assert_no_error (error);
+  bytes = g_bytes_new_take (contents, length);
+  g_free (path);
+
+  return bytes;
+}
+
+static void
+check_load (const char *name,
+            gsize       chunk_size)
+{
+  GdkProgressiveImage *image;
+  GInputStream *stream;
+  GdkTexture *expected, *texture;
+  GBytes *bytes;
+  GError *error = NULL;
+
+  bytes = get_image_bytes (name);
+  expected = gdk_texture_new_from_bytes (bytes, &error);
+  g_assert_no_error (error);
+
+  image = gdk_progressive_image_new ();
+  g_assert_null (gdk_progressive_image_get_texture (image));
+
+  stream = chunked_input_stream_new (bytes, chunk_size);
+  load_stream (image, stream, &error);
+  g_assert_no_error (error);
+
+  texture = gdk_progressive_image_get_texture (image);
+  g_assert_nonnull (texture);
+  assert_texture_equal (texture, expected);
+  g_assert_cmpint (gdk_paintable_get_intrinsic_width (GDK_PAINTABLE (image)), ==, gdk_texture_get_width (expected));
+  g_assert_cmpint (gdk_paintable_get_intrinsic_height (GDK_PAINTABLE (image)), ==, gdk_texture_get_height (expected));
+
+  g_object_unref (stream);
+  g_object_unref (image);
+  g_object_unref (expected);
+  g_bytes_unref (bytes);
+}
+
+static void
+test_load (gconstpointer data)
+{
+  const char *name = data;
+
+  /* all at once */
+  check_load (name, G_MAXSIZE);
+  /* in small pieces, so the decoders need to suspend and resume */
+  check_load (name, 100);
+  /* byte by byte */
+  check_load (name, 1);
+}
+
+static void
+test_truncated_png (void)
+{
+  GdkProgressiveImage *image;
+  GInputStream *stream;
+  GBytes *bytes, *truncated;
+  GError *error = NULL;
+
+  bytes = get_image_bytes ("image.png");
+  truncated = g_bytes_new_from_bytes (bytes, 0, g_bytes_get_size (bytes) / 2);
+
+  image = gdk_progressive_image_new ();
+  stream = chunked_input_stream_new (truncated, 100);
+  load_stream (image, stream, &error);
+  g_assert_error (error, GDK_TEXTURE_ERROR, GDK_TEXTURE_ERROR_CORRUPT_IMAGE);
+
+  g_clear_error (&error);
+  g_object_unref (stream);
+  g_object_unref (image);
+  g_bytes_unref (truncated);
+  g_bytes_unref (bytes);
+}
+
+int
+main (int argc, char *argv[])
+{
+  (g_test_init) (&argc, &argv, NULL);
+
+  g_test_add_data_func ("/progressiveimage/load/png", "image.png", test_load);
+  g_test_add_data_func ("/progressiveimage/load/png-interlaced", "image-interlaced.png", test_load);
+  g_test_add_data_func ("/progressiveimage/load/png-gray", "image-gray.png", test_load);
+  g_test_add_data_func ("/progressiveimage/load/jpeg-progressive", "image.jpeg", test_load);
+  g_test_add_data_func ("/progressiveimage/load/jpeg-gray", "image-gray.jpeg", test_load);
+  g_test_add_data_func ("/progressiveimage/load/tiff", "image.tiff", test_load);
+  g_test_add_func ("/progressiveimage/truncated-png", test_truncated_png);
+
+  return g_test_run ();
+}
+
+/* vim:set foldmethod=marker: */
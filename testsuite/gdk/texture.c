@@ -1,7 +1,18 @@
+#include "config.h"
+
 #include <gtk.h>
 
 #include "gdk/gdkmemorytextureprivate.h"
 #include "gdk/gdktextureprivate.h"
+#include "gdk/gdktexturedownloaderprivate.h"
+
+#include <glib/gstdio.h>
+
+#ifdef HAVE_MEMFD_CREATE
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+#endif
 
 
 #define assert_texture_diff_equal(a, b, expected) G_STMT_START { \
@@ -448,6 +459,168 @@ test_texture_downloader (void)
   g_object_unref (texture);
 }
 
+#ifdef __linux__
+/* Returns the start of the mapping of @name that contains @data,
+ * according to /proc/self/maps
+ */
+static const guchar *
+find_mapping (gconstpointer  data,
+              const char    *name)
+{
+  const guchar *result = NULL;
+  char *contents;
+  char **lines;
+  guint i;
+
+  if (!g_file_get_contents ("/proc/self/maps", &contents, NULL, NULL))
+    return NULL;
+
+  lines = g_strsplit (contents, "\n", -1);
+  for (i = 0; lines[i] != NULL; i++)
+    {
+      guint64 start, end;
+      char *s;
+
+      start = g_ascii_strtoull (lines[i], &s, 16);
+      if (*s != '-')
+        continue;
+      end = g_ascii_strtoull (s + 1, NULL, 16);
+
+      if ((guintptr) data < start || (guintptr) data >= end)
+        continue;
+
+      if (strstr (lines[i], name) != NULL)
+        result = GSIZE_TO_POINTER (start);
+      break;
+    }
+
+  g_strfreev (lines);
+  g_free (contents);
+
+  return result;
+}
+#endif
+
+static void
+check_mapped_texture (GdkMemoryTextureBuilder *builder,
+                      const guint32           *pixels,
+                      const char              *mapping_name,
+                      gsize                    offset)
+{
+  GdkTexture *texture, *expected;
+  GdkTextureDownloader downloader;
+  cairo_surface_t *surface;
+  GBytes *bytes, *downloaded;
+  const guchar *data;
+  gsize stride;
+
+  texture = gdk_memory_texture_builder_build (builder);
+
+  bytes = g_bytes_new_static (pixels, 16 * 16 * 4);
+  expected = gdk_memory_texture_new (16, 16, GDK_MEMORY_DEFAULT, bytes, 16 * 4);
+  g_bytes_unref (bytes);
+  compare_textures (texture, expected);
+
+  /* The texture uses the mapping itself, not a copy of it */
+  bytes = gdk_memory_texture_get_bytes (GDK_MEMORY_TEXTURE (texture), &stride);
+  data = g_bytes_get_data (bytes, NULL);
+  g_assert_cmpuint (g_bytes_get_size (bytes), ==, 16 * 16 * 4);
+#ifdef __linux__
+  {
+    const guchar *base = find_mapping (data, mapping_name);
+
+    g_assert_nonnull (base);
+    g_assert_true (data == base + offset);
+  }
+#endif
+
+  /* Consumers read the mapped data directly */
+  gdk_texture_downloader_init (&downloader, texture);
+  gdk_texture_downloader_set_format (&downloader, GDK_MEMORY_DEFAULT);
+  downloaded = gdk_texture_downloader_download_bytes (&downloader, &stride);
+  gdk_texture_downloader_finish (&downloader);
+  g_assert_true (g_bytes_get_data (downloaded, NULL) == data);
+  g_bytes_unref (downloaded);
+
+  surface = gdk_texture_get_source_surface (texture, GDK_COLOR_STATE_SRGB);
+  g_assert_true (cairo_image_surface_get_data (surface) == data);
+  cairo_surface_destroy (surface);
+
+  g_object_unref (texture);
+  g_object_unref (expected);
+}
+
+static GdkMemoryTextureBuilder *
+mapped_texture_builder_new (void)
+{
+  GdkMemoryTextureBuilder *builder;
+
+  builder = gdk_memory_texture_builder_new ();
+  gdk_memory_texture_builder_set_width (builder, 16);
+  gdk_memory_texture_builder_set_height (builder, 16);
+  gdk_memory_texture_builder_set_stride (builder, 16 * 4);
+  gdk_memory_texture_builder_set_format (builder, GDK_MEMORY_DEFAULT);
+
+  return builder;
+}
+
+static void
+test_texture_mapped (void)
+{
+  GdkMemoryTextureBuilder *builder;
+  GError *error = NULL;
+  guint32 data[4 + 16 * 16];
+  char *path;
+  guint i;
+  int fd;
+
+  /* a 16 byte header, followed by the pixels */
+  for (i = 0; i < G_N_ELEMENTS (data); i++)
+    data[i] = i < 4 ? 0 : 0xFF000000 | (i * 0x010203);
+
+  /* a file */
+  fd = g_file_open_tmp ("textureXXXXXX", &path, &error);
+  g_assert_no_error (error);
+  g_close (fd, NULL);
+  g_file_set_contents (path, (const char *) data, sizeof (data), &error);
+  g_assert_no_error (error);
+
+  builder = mapped_texture_builder_new ();
+
+  g_assert_false (gdk_memory_texture_builder_map_file (builder, path, sizeof (data), &error));
+  g_assert_error (error, G_FILE_ERROR, G_FILE_ERROR_INVAL);
+  g_clear_error (&error);
+
+  g_assert_true (gdk_memory_texture_builder_map_file (builder, path, 16, &error));
+  g_assert_no_error (error);
+  check_mapped_texture (builder, data + 4, path, 16);
+
+  g_object_unref (builder);
+  g_unlink (path);
+  g_free (path);
+
+#ifdef HAVE_MEMFD_CREATE
+  /* a sealed memfd, as shared by another process */
+  fd = memfd_create ("gdk-texture-test", MFD_CLOEXEC | MFD_ALLOW_SEALING);
+  g_assert_no_errno (fd);
+  g_assert_cmpint (write (fd, data, sizeof (data)), ==, sizeof (data));
+#ifdef F_ADD_SEALS
+  g_assert_no_errno (fcntl (fd, F_ADD_SEALS, F_SEAL_WRITE | F_SEAL_SHRINK | F_SEAL_GROW));
+#endif
+
+  builder = mapped_texture_builder_new ();
+  g_assert_true (gdk_memory_texture_builder_map_fd (builder, fd, 16, &error));
+  g_assert_no_error (error);
+
+  /* the builder does not need the fd anymore */
+  g_close (fd, NULL);
+
+  check_mapped_texture (builder, data + 4, "memfd:gdk-texture-test", 16);
+
+  g_object_unref (builder);
+#endif
+}
+
 int
 main (int argc, char *argv[])
 {
@@ -464,6 +637,7 @@ main (int argc, char *argv[])
   g_test_add_func ("/texture/icon/serialize", test_texture_icon_serialize);
   g_test_add_func ("/texture/diff", test_texture_diff);
   g_test_add_func ("/texture/downloader", test_texture_downloader);
+  g_test_add_func ("/texture/mapped", test_texture_mapped);
 
   return g_test_run ();
 }
@@ -0,0 +1,327 @@
+#include <gtk/gtk.h>
+
+#ifdef G_OS_UNIX
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <glib/gstdio.h>
+#endif
+
+typedef struct {
+  int priority;
+  GdkTexture *texture;
+  GError *error;
+} LoadResult;
+
+static guint n_outstanding;
+
+static void
+load_done (GObject      *source,
+           GAsyncResult *result,
+           gpointer      data)
+{
+  LoadResult *res = data;
+
+  res->texture = gdk_texture_loader_load_finish (GDK_TEXTURE_LOADER (source), result, &res->error);
+  g_assert_true ((res->texture == NULL) != (res->error == NULL));
+
+  n_outstanding--;
+  g_main_context_wakeup (NULL);
+}
+
+static void
+wait_for_loads (void)
+{
+  while (n_outstanding > 0)
+    g_main_context_iteration (NULL, TRUE);
+}
+
+static GFile *
+get_image_file (const char *name)
+{
+  GFile *file;
+  char *path;
+
+  path = g_test_build_filename (G_TEST_DIST, "image-data", name, NULL);
+  file = g_file_new_for_path (path);
+  g_free (path);
+
+  return file;
+}
+
+static void
+test_load (void)
+{
+  GdkTextureLoader *loader;
+  GFile *file;
+  LoadResult res = { 0, };
+
+  loader = gdk_texture_loader_new ();
+  file = get_image_file ("image.jpeg");
+
+  n_outstanding = 1;
+  gdk_texture_loader_load_async (loader, file, 10, -1, 0, NULL, load_done, &res);
+  wait_for_loads ();
+
+  g_assert_no_error (res.error);
+  g_assert_cmpint (gdk_texture_get_width (res.texture), ==, 10);
+  /* Converted to a format that can be uploaded directly */
+  g_assert_cmpint (gdk_texture_get_format (res.texture), ==, GDK_MEMORY_R8G8B8A8_PREMULTIPLIED);
+
+  g_object_unref (res.texture);
+  g_object_unref (file);
+  g_object_unref (loader);
+}
+
+static void
+test_same_file (void)
+{
+  GdkTextureLoader *loader;
+  GFile *file;
+  LoadResult res[4] = { { 0, }, };
+  guint i;
+#ifdef G_OS_UNIX
+  LoadResult blocker = { 0, };
+  GError *error = NULL;
+  GFile *fifo;
+  char *dir, *path;
+  int fd;
+#endif
+
+  loader = gdk_texture_loader_new ();
+  gdk_texture_loader_set_max_workers (loader, 1);
+  file = get_image_file ("image.png");
+  n_outstanding = G_N_ELEMENTS (res);
+
+#ifdef G_OS_UNIX
+  /* Keep the only worker busy reading from a pipe, so that all
+   * requests are queued before the image is decoded. Otherwise the
+   * first load could finish before the others are made.
+   */
+  dir = g_dir_make_tmp ("textureloader-XXXXXX", &error);
+  g_assert_no_error (error);
+  path = g_build_filename (dir, "fifo", NULL);
+  g_assert_cmpint (mkfifo (path, 0600), ==, 0);
+  fifo = g_file_new_for_path (path);
+
+  n_outstanding++;
+  gdk_texture_loader_load_async (loader, fifo, -1, -1, 0, NULL, load_done, &blocker);
+#endif
+
+  for (i = 0; i < G_N_ELEMENTS (res); i++)
+    gdk_texture_loader_load_async (loader, file, 16, 16, i + 1, NULL, load_done, &res[i]);
+
+#ifdef G_OS_UNIX
+  /* Blocks until the worker opens the pipe, and closing it
+   * lets that load fail */
+  fd = g_open (path, O_WRONLY, 0);
+  g_assert_cmpint (fd, >=, 0);
+  close (fd);
+#endif
+
+  wait_for_loads ();
+
+#ifdef G_OS_UNIX
+  g_assert_nonnull (blocker.error);
+  g_assert_null (blocker.texture);
+  g_clear_error (&blocker.error);
+
+  g_object_unref (fifo);
+  g_remove (path);
+  g_rmdir (dir);
+  g_free (path);
+  g_free (dir);
+#endif
+
+  for (i = 0; i < G_N_ELEMENTS (res); i++)
+    {
+      g_assert_no_error (res[i].error);
+      g_assert_cmpint (gdk_texture_get_width (res[i].texture), ==, 16);
+      g_assert_cmpint (gdk_texture_get_height (res[i].texture), ==, 16);
+      /* the image was decoded once, and everyone got the result */
+      g_assert_true (res[i].texture == res[0].texture);
+    }
+
+  for (i = 0; i < G_N_ELEMENTS (res); i++)
+    g_object_unref (res[i].texture);
+
+  g_object_unref (file);
+  g_object_unref (loader);
+}
+
+static void
+test_cancellable (void)
+{
+  GdkTextureLoader *loader;
+  GCancellable *cancellable;
+  GFile *file;
+  LoadResult res = { 0, };
+
+  loader = gdk_texture_loader_new ();
+  file = get_image_file ("image.png");
+  cancellable = g_cancellable_new ();
+  g_cancellable_cancel (cancellable);
+
+  n_outstanding = 1;
+  gdk_texture_loader_load_async (loader, file, -1, -1, 0, cancellable, load_done, &res);
+  wait_for_loads ();
+
+  g_assert_error (res.error, G_IO_ERROR, G_IO_ERROR_CANCELLED);
+  g_assert_null (res.texture);
+
+  g_clear_error (&res.error);
+  g_object_unref (cancellable);
+  g_object_unref (file);
+  g_object_unref (loader);
+}
+
+static void
+test_cancel_above (void)
+{
+  GdkTextureLoader *loader;
+  GFile *file;
+  LoadResult res[8] = { { 0, }, };
+  guint i, n_cancelled, n_errors;
+
+  loader = gdk_texture_loader_new ();
+  gdk_texture_loader_set_max_workers (loader, 1);
+  file = get_image_file ("image.tiff");
+
+  n_outstanding = G_N_ELEMENTS (res);
+  for (i = 0; i < G_N_ELEMENTS (res); i++)
+    {
+      res[i].priority = i;
+      /* different sizes, so the loads are not shared */
+      gdk_texture_loader_load_async (loader, file, i + 1, -1, i, NULL, load_done, &res[i]);
+    }
+
+  n_cancelled = gdk_texture_loader_cancel_above (loader, 3);
+  wait_for_loads ();
+
+  n_errors = 0;
+  for (i = 0; i < G_N_ELEMENTS (res); i++)
+    {
+      if (res[i].error)
+        {
+          g_assert_error (res[i].error, G_IO_ERROR, G_IO_ERROR_CANCELLED);
+          g_assert_cmpint (res[i].priority, >, 3);
+          g_clear_error (&res[i].error);
+          n_errors++;
+        }
+      else
+        {
+          g_assert_cmpint (gdk_texture_get_width (res[i].texture), ==, i + 1);
+          g_object_unref (res[i].texture);
+        }
+    }
+
+  g_assert_cmpuint (n_errors, ==, n_cancelled);
+
+  g_object_unref (file);
+  g_object_unref (loader);
+}
+
+static void
+wait_for_finalize (GObject *object)
+{
+  GWeakRef ref;
+  GObject *alive;
+
+  g_weak_ref_init (&ref, object);
+  g_object_unref (object);
+
+  /* Running jobs keep the loader alive until they are done */
+  while ((alive = g_weak_ref_get (&ref)) != NULL)
+    {
+      g_object_unref (alive);
+      g_main_context_iteration (NULL, FALSE);
+      g_usleep (1000);
+    }
+
+  g_weak_ref_clear (&ref);
+}
+
+static void
+test_cancel_in_flight (void)
+{
+  GdkTextureLoader *loader;
+  GCancellable *cancellable[2];
+  GFile *file;
+  LoadResult res[3] = { { 0, }, };
+  guint i;
+
+  loader = gdk_texture_loader_new ();
+  gdk_texture_loader_set_max_workers (loader, 1);
+  file = get_image_file ("image.tiff");
+
+  /* The first load is running, the second one queued behind it */
+  n_outstanding = G_N_ELEMENTS (res);
+  for (i = 0; i < G_N_ELEMENTS (res); i++)
+    {
+      if (i < G_N_ELEMENTS (cancellable))
+        cancellable[i] = g_cancellable_new ();
+      gdk_texture_loader_load_async (loader, file, i + 1, -1, 0,
+                                     i < G_N_ELEMENTS (cancellable) ? cancellable[i] : NULL,
+                                     load_done, &res[i]);
+    }
+
+  for (i = 0; i < G_N_ELEMENTS (cancellable); i++)
+    g_cancellable_cancel (cancellable[i]);
+
+  wait_for_loads ();
+
+  for (i = 0; i < G_N_ELEMENTS (cancellable); i++)
+    {
+      g_assert_error (res[i].error, G_IO_ERROR, G_IO_ERROR_CANCELLED);
+      g_assert_null (res[i].texture);
+      g_clear_error (&res[i].error);
+      g_object_unref (cancellable[i]);
+    }
+
+  /* other loads are not affected */
+  g_assert_no_error (res[2].error);
+  g_assert_cmpint (gdk_texture_get_width (res[2].texture), ==, 3);
+  g_object_unref (res[2].texture);
+
+  g_object_unref (file);
+  wait_for_finalize (G_OBJECT (loader));
+}
+
+static void
+test_max_workers (void)
+{
+  GdkTextureLoader *loader;
+  GParamSpec *pspec;
+  guint max_workers;
+
+  loader = gdk_texture_loader_new ();
+
+  /* The default is chosen automatically, and documented as 0 */
+  pspec = g_object_class_find_property (G_OBJECT_GET_CLASS (loader), "max-workers");
+  g_assert_cmpuint (G_PARAM_SPEC_UINT (pspec)->default_value, ==, 0);
+  g_object_get (loader, "max-workers", &max_workers, NULL);
+  g_assert_cmpuint (max_workers, ==, 0);
+  g_assert_cmpuint (gdk_texture_loader_get_max_workers (loader), ==, 0);
+
+  gdk_texture_loader_set_max_workers (loader, 3);
+  g_assert_cmpuint (gdk_texture_loader_get_max_workers (loader), ==, 3);
+  gdk_texture_loader_set_max_workers (loader, 0);
+  g_assert_cmpuint (gdk_texture_loader_get_max_workers (loader), ==, 0);
+
+  g_object_unref (loader);
+}
+
+int
+main (int argc, char *argv[])
+{
+  (g_test_init) (&argc, &argv, NULL);
+
+  g_test_add_func ("/textureloader/load", test_load);
+  g_test_add_func ("/textureloader/same-file", test_same_file);
+  g_test_add_func ("/textureloader/cancellable", test_cancellable);
+  g_test_add_func ("/textureloader/cancel-above", test_cancel_above);
+  g_test_add_func ("/textureloader/cancel-in-flight", test_cancel_in_flight);
+  g_test_add_func ("/textureloader/max-workers", test_max_workers);
+
+  return g_test_run ();
+}
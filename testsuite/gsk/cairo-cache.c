@@ -0,0 +1,224 @@
+#include <gtk/gtk.h>
+
+#include "gsk/gskcairocacheprivate.h"
+
+static GskRenderNode *
+create_shadow_node (float x,
+                    float y)
+{
+  GskRoundedRect outline;
+
+  gsk_rounded_rect_init_from_rect (&outline, &GRAPHENE_RECT_INIT (x, y, 40, 30), 6);
+
+  return gsk_outset_shadow_node_new (&outline,
+                                     &(GdkRGBA) { 0, 0, 0, 0.5 },
+                                     2, 3, 4, 8);
+}
+
+static cairo_surface_t *
+draw_node (GskCairoCache *cache,
+           GskRenderNode *node,
+           double         dx,
+           double         dy)
+{
+  cairo_surface_t *surface;
+  cairo_t *cr;
+
+  surface = cairo_image_surface_create (CAIRO_FORMAT_ARGB32, 100, 100);
+  cr = cairo_create (surface);
+  if (cache)
+    gsk_cairo_cache_attach (cache, cr);
+  cairo_translate (cr, dx, dy);
+  gsk_render_node_draw (node, cr);
+  cairo_destroy (cr);
+
+  return surface;
+}
+
+static void
+assert_surfaces_equal (cairo_surface_t *a,
+                       cairo_surface_t *b)
+{
+  int y;
+
+  cairo_surface_flush (a);
+  cairo_surface_flush (b);
+
+  for (y = 0; y < cairo_image_surface_get_height (a); y++)
+    {
+      g_assert_cmpmem (cairo_image_surface_get_data (a) + y * cairo_image_surface_get_stride (a),
+                       cairo_image_surface_get_width (a) * 4,
+                       cairo_image_surface_get_data (b) + y * cairo_image_surface_get_stride (b),
+                       cairo_image_surface_get_width (b) * 4);
+    }
+}
+
+static void
+test_hit (void)
+{
+  GskCairoCache *cache;
+  GskRenderNode *node;
+  cairo_surface_t *reference, *first, *second;
+  guint n_hits, n_misses;
+
+  cache = gsk_cairo_cache_new (1024 * 1024);
+  node = create_shadow_node (20, 20);
+
+  reference = draw_node (NULL, node, 0, 0);
+
+  first = draw_node (cache, node, 0, 0);
+  gsk_cairo_cache_end_frame (cache, &n_hits, &n_misses);
+  g_assert_cmpuint (n_hits, ==, 0);
+  g_assert_cmpuint (n_misses, ==, 1);
+  g_assert_cmpuint (gsk_cairo_cache_get_size (cache), >, 0);
+
+  second = draw_node (cache, node, 0, 0);
+  gsk_cairo_cache_end_frame (cache, &n_hits, &n_misses);
+  g_assert_cmpuint (n_hits, ==, 1);
+  g_assert_cmpuint (n_misses, ==, 0);
+
+  assert_surfaces_equal (reference, first);
+  assert_surfaces_equal (reference, second);
+
+  cairo_surface_destroy (reference);
+  cairo_surface_destroy (first);
+  cairo_surface_destroy (second);
+  gsk_render_node_unref (node);
+  gsk_cairo_cache_free (cache);
+}
+
+static void
+test_translate (void)
+{
+  GskCairoCache *cache;
+  GskRenderNode *node;
+  cairo_surface_t *reference, *surface;
+  guint n_hits, n_misses;
+
+  cache = gsk_cairo_cache_new (1024 * 1024);
+  node = create_shadow_node (20, 20);
+
+  surface = draw_node (cache, node, 0, 0);
+  cairo_surface_destroy (surface);
+  gsk_cairo_cache_end_frame (cache, &n_hits, &n_misses);
+  g_assert_cmpuint (n_misses, ==, 1);
+
+  /* Moving by whole pixels reuses the raster */
+  reference = draw_node (NULL, node, 7, 11);
+  surface = draw_node (cache, node, 7, 11);
+  gsk_cairo_cache_end_frame (cache, &n_hits, &n_misses);
+  g_assert_cmpuint (n_hits, ==, 1);
+  g_assert_cmpuint (n_misses, ==, 0);
+  assert_surfaces_equal (reference, surface);
+  cairo_surface_destroy (reference);
+  cairo_surface_destroy (surface);
+
+  /* Moving by half a pixel needs a new one */
+  reference = draw_node (NULL, node, 0.5, 0);
+  surface = draw_node (cache, node, 0.5, 0);
+  gsk_cairo_cache_end_frame (cache, &n_hits, &n_misses);
+  g_assert_cmpuint (n_hits, ==, 0);
+  g_assert_cmpuint (n_misses, ==, 1);
+  assert_surfaces_equal (reference, surface);
+  cairo_surface_destroy (reference);
+  cairo_surface_destroy (surface);
+
+  gsk_render_node_unref (node);
+  gsk_cairo_cache_free (cache);
+}
+
+static void
+test_evict (void)
+{
+  GskCairoCache *cache;
+  GskRenderNode *nodes[4];
+  cairo_surface_t *surface;
+  guint n_hits, n_misses;
+  gsize entry_size;
+  guint i;
+
+  for (i = 0; i < G_N_ELEMENTS (nodes); i++)
+    nodes[i] = create_shadow_node (20, 20);
+
+  cache = gsk_cairo_cache_new (1024 * 1024);
+  surface = draw_node (cache, nodes[0], 0, 0);
+  cairo_surface_destroy (surface);
+  gsk_cairo_cache_end_frame (cache, &n_hits, &n_misses);
+  entry_size = gsk_cairo_cache_get_size (cache);
+  gsk_cairo_cache_free (cache);
+
+  /* Room for two entries */
+  cache = gsk_cairo_cache_new (2 * entry_size);
+
+  for (i = 0; i < G_N_ELEMENTS (nodes); i++)
+    {
+      surface = draw_node (cache, nodes[i], 0, 0);
+      cairo_surface_destroy (surface);
+    }
+  gsk_cairo_cache_end_frame (cache, &n_hits, &n_misses);
+  g_assert_cmpuint (n_misses, ==, G_N_ELEMENTS (nodes));
+  g_assert_cmpuint (gsk_cairo_cache_get_size (cache), ==, 2 * entry_size);
+
+  /* The most recently used nodes are still there, the others are gone */
+  surface = draw_node (cache, nodes[3], 0, 0);
+  cairo_surface_destroy (surface);
+  surface = draw_node (cache, nodes[0], 0, 0);
+  cairo_surface_destroy (surface);
+  gsk_cairo_cache_end_frame (cache, &n_hits, &n_misses);
+  g_assert_cmpuint (n_hits, ==, 1);
+  g_assert_cmpuint (n_misses, ==, 1);
+
+  gsk_cairo_cache_free (cache);
+  for (i = 0; i < G_N_ELEMENTS (nodes); i++)
+    gsk_render_node_unref (nodes[i]);
+}
+
+static void
+test_gc (void)
+{
+  GskCairoCache *cache;
+  GskRenderNode *node;
+  cairo_surface_t *surface;
+  guint n_hits, n_misses;
+
+  cache = gsk_cairo_cache_new (1024 * 1024);
+  node = create_shadow_node (20, 20);
+
+  surface = draw_node (cache, node, 0, 0);
+  cairo_surface_destroy (surface);
+  gsk_cairo_cache_end_frame (cache, &n_hits, &n_misses);
+  g_assert_cmpuint (gsk_cairo_cache_get_size (cache), >, 0);
+
+  /* Recently used entries are kept while no frames are drawn */
+  g_assert_false (gsk_cairo_cache_gc (cache, g_get_monotonic_time ()));
+  g_assert_cmpuint (gsk_cairo_cache_get_size (cache), >, 0);
+
+  /* but not forever */
+  g_assert_true (gsk_cairo_cache_gc (cache, g_get_monotonic_time () + 60 * G_TIME_SPAN_SECOND));
+  g_assert_cmpuint (gsk_cairo_cache_get_size (cache), ==, 0);
+
+  surface = draw_node (cache, node, 0, 0);
+  cairo_surface_destroy (surface);
+  gsk_cairo_cache_end_frame (cache, &n_hits, &n_misses);
+  g_assert_cmpuint (n_misses, ==, 1);
+  g_assert_cmpuint (gsk_cairo_cache_get_size (cache), >, 0);
+
+  gsk_cairo_cache_clear (cache);
+  g_assert_cmpuint (gsk_cairo_cache_get_size (cache), ==, 0);
+
+  gsk_render_node_unref (node);
+  gsk_cairo_cache_free (cache);
+}
+
+int
+main (int argc, char *argv[])
+{
+  gtk_test_init (&argc, &argv, NULL);
+
+  g_test_add_func ("/cairo-cache/hit", test_hit);
+  g_test_add_func ("/cairo-cache/translate", test_translate);
+  g_test_add_func ("/cairo-cache/evict", test_evict);
+  g_test_add_func ("/cairo-cache/gc", test_gc);
+
+  return g_test_run ();
+}
@@ -0,0 +1,193 @@
+#include <gtk/gtk.h>
+#include "../reftests/reftest-compare.h"
+
+/* The tile size is read when the renderer is created */
+static GskRenderer *
+create_renderer (const char *tile_size)
+{
+  GskRenderer *renderer;
+  GError *error = NULL;
+
+  if (tile_size)
+    g_setenv ("GSK_CAIRO_TILE_SIZE", tile_size, TRUE);
+  else
+    g_unsetenv ("GSK_CAIRO_TILE_SIZE");
+
+  renderer = gsk_cairo_renderer_new ();
+  gsk_renderer_realize_for_display (renderer, gdk_display_get_default (), &error);
+  g_assert_no_error (error);
+
+  g_unsetenv ("GSK_CAIRO_TILE_SIZE");
+
+  return renderer;
+}
+
+static GdkTexture *
+create_texture (GdkMemoryFormat format)
+{
+  GdkTexture *texture;
+  GBytes *bytes;
+  guint32 data[32 * 32];
+  guint x, y;
+
+  for (y = 0; y < 32; y++)
+    for (x = 0; x < 32; x++)
+      data[y * 32 + x] = 0xFF000000 | (x * 8) << 16 | (y * 8) << 8 | ((x ^ y) & 1 ? 0xFF : 0);
+
+  bytes = g_bytes_new (data, sizeof (data));
+  texture = gdk_memory_texture_new (32, 32, format, bytes, 32 * 4);
+  g_bytes_unref (bytes);
+
+  return texture;
+}
+
+/* All nodes here can be drawn from threads, so they are
+ * drawn in tiles, unless @with_text is set. Text is always
+ * drawn without tiles. Most nodes cross the borders of the
+ * 64 pixel tiles.
+ */
+static GskRenderNode *
+create_node (gboolean with_text)
+{
+  GtkSnapshot *snapshot;
+  GskRoundedRect outline;
+  GdkTexture *texture;
+  PangoContext *context;
+  PangoLayout *layout;
+
+  snapshot = gtk_snapshot_new ();
+
+  gtk_snapshot_append_color (snapshot,
+                             &(GdkRGBA) { 1, 1, 1, 1 },
+                             &GRAPHENE_RECT_INIT (0, 0, 300, 200));
+
+  gtk_snapshot_append_linear_gradient (snapshot,
+                                       &GRAPHENE_RECT_INIT (10, 10, 280, 40),
+                                       &GRAPHENE_POINT_INIT (10, 10),
+                                       &GRAPHENE_POINT_INIT (290, 50),
+                                       (GskColorStop[]) {
+                                         { 0, { 1, 0, 0, 1 } },
+                                         { 1, { 0, 0, 1, 1 } },
+                                       }, 2);
+
+  /* a blurred shadow and a border around a tile corner */
+  gsk_rounded_rect_init_from_rect (&outline, &GRAPHENE_RECT_INIT (40, 40, 50, 50), 10);
+  gtk_snapshot_append_outset_shadow (snapshot, &outline,
+                                     &(GdkRGBA) { 0, 0, 0, 0.6 },
+                                     3, 4, 2, 12);
+  gtk_snapshot_append_border (snapshot, &outline,
+                              (float[4]) { 3, 3, 3, 3 },
+                              (GdkRGBA[4]) {
+                                { 0, 0.5, 0, 1 },
+                                { 0, 0.5, 0, 1 },
+                                { 0, 0.5, 0, 1 },
+                                { 0, 0.5, 0, 1 },
+                              });
+
+  /* a blur needs pixels from neighboring tiles */
+  gtk_snapshot_push_blur (snapshot, 6);
+  gtk_snapshot_append_color (snapshot,
+                             &(GdkRGBA) { 1, 0.5, 0, 1 },
+                             &GRAPHENE_RECT_INIT (110, 50, 40, 40));
+  gtk_snapshot_pop (snapshot);
+
+  /* rotated, so the edges are antialiased */
+  gtk_snapshot_save (snapshot);
+  gtk_snapshot_translate (snapshot, &GRAPHENE_POINT_INIT (200, 100));
+  gtk_snapshot_rotate (snapshot, 30);
+  gtk_snapshot_append_color (snapshot,
+                             &(GdkRGBA) { 0.5, 0, 0.5, 0.8 },
+                             &GRAPHENE_RECT_INIT (-30, -20, 60, 40));
+  gtk_snapshot_restore (snapshot);
+
+  /* a scaled texture at a fractional position */
+  texture = create_texture (GDK_MEMORY_DEFAULT);
+  gtk_snapshot_append_texture (snapshot, texture, &GRAPHENE_RECT_INIT (50.5, 110.25, 48, 48));
+  g_object_unref (texture);
+
+  /* a texture that needs to be converted for cairo, drawn twice */
+  texture = create_texture (GDK_MEMORY_R8G8B8A8);
+  gtk_snapshot_append_scaled_texture (snapshot, texture, GSK_SCALING_FILTER_NEAREST,
+                                      &GRAPHENE_RECT_INIT (120, 100, 64, 64));
+  gtk_snapshot_append_texture (snapshot, texture, &GRAPHENE_RECT_INIT (230, 150, 60, 40));
+  g_object_unref (texture);
+
+  if (!with_text)
+    return gtk_snapshot_free_to_node (snapshot);
+
+  context = pango_font_map_create_context (pango_cairo_font_map_get_default ());
+  layout = pango_layout_new (context);
+  pango_layout_set_text (layout, "Tiles are drawn in threads", -1);
+  gtk_snapshot_save (snapshot);
+  gtk_snapshot_translate (snapshot, &GRAPHENE_POINT_INIT (20, 120));
+  gtk_snapshot_append_layout (snapshot, layout, &(GdkRGBA) { 0, 0, 0, 1 });
+  gtk_snapshot_restore (snapshot);
+  g_object_unref (layout);
+  g_object_unref (context);
+
+  return gtk_snapshot_free_to_node (snapshot);
+}
+
+static void
+test_tiles (const graphene_rect_t *viewport,
+            gboolean               with_text)
+{
+  GskRenderer *renderer, *tiled_renderer;
+  GdkTexture *texture, *tiled, *diff;
+  GskRenderNode *node;
+
+  renderer = create_renderer (NULL);
+  tiled_renderer = create_renderer ("64");
+  node = create_node (with_text);
+
+  texture = gsk_renderer_render_texture (renderer, node, viewport);
+  tiled = gsk_renderer_render_texture (tiled_renderer, node, viewport);
+
+  diff = reftest_compare_textures (texture, tiled);
+  g_assert_null (diff);
+
+  /* again, now that the cache is populated */
+  g_object_unref (tiled);
+  tiled = gsk_renderer_render_texture (tiled_renderer, node, viewport);
+
+  diff = reftest_compare_textures (texture, tiled);
+  g_assert_null (diff);
+
+  g_object_unref (texture);
+  g_object_unref (tiled);
+  gsk_render_node_unref (node);
+  gsk_renderer_unrealize (renderer);
+  gsk_renderer_unrealize (tiled_renderer);
+  g_object_unref (renderer);
+  g_object_unref (tiled_renderer);
+}
+
+static void
+test_tiles_aligned (void)
+{
+  test_tiles (&GRAPHENE_RECT_INIT (0, 0, 300, 200), FALSE);
+}
+
+static void
+test_tiles_offset (void)
+{
+  test_tiles (&GRAPHENE_RECT_INIT (-7, 13, 290, 180), FALSE);
+}
+
+static void
+test_tiles_text (void)
+{
+  test_tiles (&GRAPHENE_RECT_INIT (0, 0, 300, 200), TRUE);
+}
+
+int
+main (int argc, char *argv[])
+{
+  gtk_test_init (&argc, &argv, NULL);
+
+  g_test_add_func ("/cairo-tiles/aligned", test_tiles_aligned);
+  g_test_add_func ("/cairo-tiles/offset", test_tiles_offset);
+  g_test_add_func ("/cairo-tiles/text", test_tiles_text);
+
+  return g_test_run ();
+}
@@ -1,7 +1,9 @@
 #include <gtk/gtk.h>
 #include "gsk/gskrendernodeprivate.h"
+#include "gsk/gskcairoblurprivate.h"
 
 #include <gobject/gvaluecollector.h>
+#include <math.h>
 
 static void
 test_rendernode_gvalue (void)
@@ -235,6 +237,199 @@ test_vulkan_renderer (void)
 #endif
 }
 
+/* Blurring ARGB32 must be the same as blurring each channel on its own */
+static void
+test_cairo_blur_argb32 (void)
+{
+  cairo_surface_t *argb, *a8[4];
+  guchar *argb_data, *a8_data;
+  int width = 64, height = 48;
+  int x, y, c;
+
+  argb = cairo_image_surface_create (CAIRO_FORMAT_ARGB32, width, height);
+  argb_data = cairo_image_surface_get_data (argb);
+  for (c = 0; c < 4; c++)
+    a8[c] = cairo_image_surface_create (CAIRO_FORMAT_A8, width, height);
+
+  for (y = 0; y < height; y++)
+    for (x = 0; x < width; x++)
+      for (c = 0; c < 4; c++)
+        {
+          guchar value = g_test_rand_int_range (0, 256);
+
+          argb_data[y * cairo_image_surface_get_stride (argb) + 4 * x + c] = value;
+          a8_data = cairo_image_surface_get_data (a8[c]);
+          a8_data[y * cairo_image_surface_get_stride (a8[c]) + x] = value;
+        }
+  cairo_surface_mark_dirty (argb);
+
+  gsk_cairo_blur_surface (argb, 7, GSK_BLUR_X | GSK_BLUR_Y);
+
+  for (c = 0; c < 4; c++)
+    {
+      cairo_surface_mark_dirty (a8[c]);
+      gsk_cairo_blur_surface (a8[c], 7, GSK_BLUR_X | GSK_BLUR_Y);
+      a8_data = cairo_image_surface_get_data (a8[c]);
+
+      for (y = 0; y < height; y++)
+        for (x = 0; x < width; x++)
+          g_assert_cmpuint (argb_data[y * cairo_image_surface_get_stride (argb) + 4 * x + c], ==,
+                            a8_data[y * cairo_image_surface_get_stride (a8[c]) + x]);
+
+      cairo_surface_destroy (a8[c]);
+    }
+
+  cairo_surface_destroy (argb);
+}
+
+/* The box blur as it was before it learned about ARGB32 and
+ * threads. It transposed the buffer for the vertical pass;
+ * walking the columns with a stride is equivalent.
+ */
+static void
+reference_blur_span (guchar *data,
+                     gsize   step,
+                     int     n,
+                     guchar *line,
+                     guchar *tmp,
+                     int     d,
+                     int     shift)
+{
+  int offset;
+  int sum = 0;
+  int i;
+
+  if (d % 2 == 1)
+    offset = d / 2;
+  else
+    offset = (d - shift) / 2;
+
+  for (i = 0; i < n; i++)
+    line[i] = data[i * step];
+
+  for (i = -d + offset; i < n + offset; i++)
+    {
+      if (i >= 0 && i < n)
+        sum += line[i];
+
+      if (i >= offset)
+        {
+          if (i >= d)
+            sum -= line[i - d];
+
+          tmp[i - offset] = (sum + d / 2) / d;
+        }
+    }
+
+  for (i = 0; i < n; i++)
+    data[i * step] = tmp[i];
+}
+
+static void
+reference_blur (guchar *data,
+                gsize   step,
+                int     n,
+                int     d)
+{
+  guchar *line = g_malloc (2 * n);
+  guchar *tmp = line + n;
+
+  if (d % 2 == 1)
+    {
+      reference_blur_span (data, step, n, line, tmp, d, 0);
+      reference_blur_span (data, step, n, line, tmp, d, 0);
+      reference_blur_span (data, step, n, line, tmp, d, 0);
+    }
+  else
+    {
+      reference_blur_span (data, step, n, line, tmp, d, 1);
+      reference_blur_span (data, step, n, line, tmp, d, -1);
+      reference_blur_span (data, step, n, line, tmp, d + 1, 0);
+    }
+
+  g_free (line);
+}
+
+static void
+reference_blur_surface (cairo_surface_t *surface,
+                        int              radius,
+                        GskBlurFlags     flags)
+{
+  guchar *data = cairo_image_surface_get_data (surface);
+  int stride = cairo_image_surface_get_stride (surface);
+  int height = cairo_image_surface_get_height (surface);
+  int d = (int) ((3.0 * sqrt (2 * G_PI) / 4) * radius);
+  int i;
+
+  if (radius <= 1)
+    return;
+
+  /* Like the old code, this blurs the padding at the end of the rows */
+  if (flags & GSK_BLUR_Y)
+    {
+      for (i = 0; i < stride; i++)
+        reference_blur (data + i, stride, height, d);
+    }
+
+  if (flags & GSK_BLUR_X)
+    {
+      for (i = 0; i < height; i++)
+        reference_blur (data + i * stride, 1, stride, d);
+    }
+}
+
+/* The A8 output must match the old implementation exactly, that is
+ * with a tolerance of 0. The radii cover odd and even filter sizes,
+ * and filters both below and above the size up to which divisions
+ * are replaced by multiplications.
+ */
+static void
+test_cairo_blur_reference (void)
+{
+  const int radii[] = { 2, 3, 4, 5, 9, 10, 20, 75, 100 };
+  const GskBlurFlags flags[] = { GSK_BLUR_X, GSK_BLUR_Y, GSK_BLUR_X | GSK_BLUR_Y };
+  /* An odd width, so that the rows have padding */
+  int width = 197, height = 131;
+  guint tolerance = 0;
+  int r, f, i;
+
+  for (r = 0; r < G_N_ELEMENTS (radii); r++)
+    for (f = 0; f < G_N_ELEMENTS (flags); f++)
+      {
+        cairo_surface_t *surface, *reference;
+        guchar *data, *reference_data;
+        int stride;
+
+        surface = cairo_image_surface_create (CAIRO_FORMAT_A8, width, height);
+        reference = cairo_image_surface_create (CAIRO_FORMAT_A8, width, height);
+        stride = cairo_image_surface_get_stride (surface);
+        g_assert_cmpint (stride, ==, cairo_image_surface_get_stride (reference));
+        data = cairo_image_surface_get_data (surface);
+        reference_data = cairo_image_surface_get_data (reference);
+
+        for (i = 0; i < stride * height; i++)
+          data[i] = reference_data[i] = g_test_rand_int_range (0, 256);
+        cairo_surface_mark_dirty (surface);
+        cairo_surface_mark_dirty (reference);
+
+        gsk_cairo_blur_surface (surface, radii[r], flags[f]);
+        reference_blur_surface (reference, radii[r], flags[f]);
+
+        for (i = 0; i < stride * height; i++)
+          {
+            guint diff = ABS ((int) data[i] - (int) reference_data[i]);
+
+            if (diff > tolerance)
+              g_error ("radius %d, flags %d: byte %d (%d, %d) is %u, expected %u",
+                       radii[r], flags[f], i, i % stride, i / stride,
+                       data[i], reference_data[i]);
+          }
+
+        cairo_surface_destroy (reference);
+        cairo_surface_destroy (surface);
+      }
+}
+
 int
 main (int argc, char *argv[])
 {
@@ -249,6 +444,8 @@ main (int argc, char *argv[])
   g_test_add_func ("/renderer/cairo", test_cairo_renderer);
   g_test_add_func ("/renderer/ngl", test_ngl_renderer);
   g_test_add_func ("/renderer/vulkan", test_vulkan_renderer);
+  g_test_add_func ("/cairo-blur/argb32", test_cairo_blur_argb32);
+  g_test_add_func ("/cairo-blur/reference", test_cairo_blur_reference);
 
   return g_test_run ();
 }
@@ -324,6 +324,77 @@ test_string_properties (void)
   g_object_unref (filter);
 }
 
+static char *
+buffers_to_string (GListModel *model)
+{
+  GString *string = g_string_new (NULL);
+  guint i;
+
+  for (i = 0; i < g_list_model_get_n_items (model); i++)
+    {
+      GtkEntryBuffer *buffer = g_list_model_get_item (model, i);
+
+      if (i > 0)
+        g_string_append (string, " ");
+      g_string_append (string, gtk_entry_buffer_get_text (buffer));
+      g_object_unref (buffer);
+    }
+
+  return g_string_free (string, FALSE);
+}
+
+#define assert_buffers(model, expected) G_STMT_START{ \
+  char *s = buffers_to_string (G_LIST_MODEL (model)); \
+  if (!g_str_equal (s, expected)) \
+     g_assertion_message_cmpstr (G_LOG_DOMAIN, __FILE__, __LINE__, G_STRFUNC, \
+         #model " == " #expected, s, "==", expected); \
+  g_free (s); \
+}G_STMT_END
+
+/* The filter caches the strings of items, check that it
+ * notices when they change.
+ */
+static void
+test_string_changes (void)
+{
+  const char *words[] = { "apple", "banana", "cherry" };
+  GtkFilterListModel *model;
+  GtkFilter *filter;
+  GListStore *store;
+  GtkEntryBuffer *buffers[G_N_ELEMENTS (words)];
+  guint i;
+
+  store = g_list_store_new (GTK_TYPE_ENTRY_BUFFER);
+  for (i = 0; i < G_N_ELEMENTS (words); i++)
+    {
+      buffers[i] = gtk_entry_buffer_new (words[i], -1);
+      g_list_store_append (store, buffers[i]);
+      g_object_unref (buffers[i]);
+    }
+
+  filter = GTK_FILTER (gtk_string_filter_new (gtk_property_expression_new (GTK_TYPE_ENTRY_BUFFER, NULL, "text")));
+  model = gtk_filter_list_model_new (G_LIST_MODEL (store), filter);
+
+  gtk_string_filter_set_search (GTK_STRING_FILTER (filter), "an");
+  assert_buffers (model, "banana");
+
+  gtk_entry_buffer_set_text (buffers[0], "MANGO", -1);
+  gtk_string_filter_set_search (GTK_STRING_FILTER (filter), "n");
+  assert_buffers (model, "MANGO banana");
+
+  gtk_string_filter_set_ignore_case (GTK_STRING_FILTER (filter), FALSE);
+  assert_buffers (model, "banana");
+
+  gtk_string_filter_set_match_mode (GTK_STRING_FILTER (filter), GTK_STRING_FILTER_MATCH_MODE_PREFIX);
+  gtk_string_filter_set_search (GTK_STRING_FILTER (filter), "MAN");
+  assert_buffers (model, "MANGO");
+
+  gtk_string_filter_set_expression (GTK_STRING_FILTER (filter), NULL);
+  assert_buffers (model, "");
+
+  g_object_unref (model);
+}
+
 static void
 test_bool_simple (void)
 {
@@ -405,6 +476,7 @@ main (int argc, char *argv[])
   g_test_add_func ("/filter/any/simple", test_any_simple);
   g_test_add_func ("/filter/string/simple", test_string_simple);
   g_test_add_func ("/filter/string/properties", test_string_properties);
+  g_test_add_func ("/filter/string/changes", test_string_changes);
   g_test_add_func ("/filter/bool/simple", test_bool_simple);
   g_test_add_func ("/filter/every/dispose", test_every_dispose);
 
@@ -561,6 +561,84 @@ test_sections (void)
   g_object_unref (sorted);
 }
 
+static void
+wait_for_filtering (GtkFilterListModel *model)
+{
+  while (gtk_filter_list_model_get_pending (model) > 0)
+    g_main_context_iteration (NULL, TRUE);
+}
+
+static void
+test_threaded (void)
+{
+  GtkFilterListModel *model;
+  GtkStringList *list;
+  GtkFilter *filter;
+  GString *changes;
+  char buffer[32];
+  guint i;
+
+  list = gtk_string_list_new (NULL);
+  for (i = 1; i <= 10000; i++)
+    {
+      g_snprintf (buffer, sizeof (buffer), "%u", i);
+      gtk_string_list_append (list, buffer);
+    }
+
+  filter = GTK_FILTER (gtk_string_filter_new (gtk_property_expression_new (GTK_TYPE_STRING_OBJECT, NULL, "string")));
+  gtk_string_filter_set_match_mode (GTK_STRING_FILTER (filter), GTK_STRING_FILTER_MATCH_MODE_PREFIX);
+  gtk_string_filter_set_search (GTK_STRING_FILTER (filter), "999");
+
+  model = gtk_filter_list_model_new (G_LIST_MODEL (g_object_ref (list)), NULL);
+  changes = g_string_new ("");
+  g_object_set_qdata_full (G_OBJECT (model), changes_quark, changes, free_changes);
+  g_signal_connect (model, "items-changed", G_CALLBACK (items_changed), changes);
+  g_signal_connect (model, "notify::n-items", G_CALLBACK (notify_n_items), changes);
+
+  gtk_filter_list_model_set_threaded (model, TRUE);
+  gtk_filter_list_model_set_filter (model, filter);
+  g_assert_cmpuint (gtk_filter_list_model_get_pending (model), ==, 10000);
+  /* the unfiltered items stay until filtering is done */
+  assert_changes (model, "");
+  g_assert_cmpuint (g_list_model_get_n_items (G_LIST_MODEL (model)), ==, 10000);
+
+  /* the results arrive all at once */
+  wait_for_filtering (model);
+  assert_changes (model, "0-10000+11*");
+  g_assert_cmpuint (g_list_model_get_n_items (G_LIST_MODEL (model)), ==, 11);
+
+  /* changing the filter while filtering starts over */
+  gtk_string_filter_set_search (GTK_STRING_FILTER (filter), "99");
+  g_assert_cmpuint (gtk_filter_list_model_get_pending (model), >, 0);
+  gtk_string_filter_set_search (GTK_STRING_FILTER (filter), "1000");
+  assert_changes (model, "");
+  g_assert_cmpuint (g_list_model_get_n_items (G_LIST_MODEL (model)), ==, 11);
+  wait_for_filtering (model);
+  assert_changes (model, "0-11+2*");
+
+  /* so does changing the model */
+  gtk_string_filter_set_search (GTK_STRING_FILTER (filter), "5000");
+  assert_changes (model, "");
+  gtk_string_list_append (list, "5000!");
+  assert_changes (model, "");
+  wait_for_filtering (model);
+  assert_changes (model, "0-2+2");
+  g_assert_cmpstr (gtk_string_list_get_string (GTK_STRING_LIST (list), 10000), ==, "5000!");
+  g_assert_cmpuint (g_list_model_get_n_items (G_LIST_MODEL (model)), ==, 2);
+
+  /* short lists are filtered right away */
+  g_object_unref (list);
+  list = gtk_string_list_new ((const char *[]) { "1", "5000", NULL });
+  gtk_filter_list_model_set_model (model, G_LIST_MODEL (list));
+  g_assert_cmpuint (gtk_filter_list_model_get_pending (model), ==, 0);
+  g_assert_cmpuint (g_list_model_get_n_items (G_LIST_MODEL (model)), ==, 1);
+  ignore_changes (model);
+
+  g_object_unref (model);
+  g_object_unref (filter);
+  g_object_unref (list);
+}
+
 int
 main (int argc, char *argv[])
 {
@@ -577,6 +655,7 @@ main (int argc, char *argv[])
   g_test_add_func ("/filterlistmodel/empty", test_empty);
   g_test_add_func ("/filterlistmodel/add_remove_item", test_add_remove_item);
   g_test_add_func ("/filterlistmodel/sections", test_sections);
+  g_test_add_func ("/filterlistmodel/threaded", test_threaded);
 
   return g_test_run ();
 }
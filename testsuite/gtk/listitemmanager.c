@@ -107,7 +107,7 @@ check_list_item_manager (GtkListItemManager  *items,
 {
   GListModel *model = G_LIST_MODEL (gtk_list_item_manager_get_model (items));
   GtkListTile *tile;
-  guint n_items, n_tile_widgets;
+  guint n_items, n_measured, n_tile_widgets;
   guint i;
   gboolean has_sections;
   enum {
@@ -219,6 +219,7 @@ check_list_item_manager (GtkListItemManager  *items,
   gtk_list_item_manager_gc_tiles (items);
 
   n_items = 0;
+  n_measured = 0;
   n_tile_widgets = 0;
 
   for (tile = gtk_list_item_manager_get_first (items);
@@ -263,9 +264,13 @@ check_list_item_manager (GtkListItemManager  *items,
 
           case GTK_LIST_TILE_ITEM:
             g_assert_cmpint (section_state, !=, NO_SECTION);
+            /* every measured item has size 1, see below */
+            g_assert_cmpuint (tile->n_measured, <=, tile->n_items);
+            g_assert_cmpint (tile->measured_size, ==, tile->n_measured);
             if (tile->widget)
               {
                 g_assert_cmpint (tile->n_items, ==, 1);
+                gtk_list_tile_set_measured_size (items, tile, 1);
                 after_items = FALSE;
               }
             else
@@ -275,6 +280,7 @@ check_list_item_manager (GtkListItemManager  *items,
               }
             if (tile->n_items)
               n_items += tile->n_items;
+            n_measured += tile->n_measured;
             break;
 
           case GTK_LIST_TILE_REMOVED:
@@ -291,6 +297,38 @@ check_list_item_manager (GtkListItemManager  *items,
   g_assert_cmpint (n_items, ==, g_list_model_get_n_items (model));
   g_assert_cmpint (n_tile_widgets, ==, widget_count_children (widget));
 
+  tile = gtk_list_item_manager_get_root (items);
+  if (tile)
+    {
+      GtkListTileAugment *aug = gtk_list_tile_get_augment (items, tile);
+
+      g_assert_cmpuint (aug->n_measured, ==, n_measured);
+      g_assert_cmpint (aug->measured_size, ==, n_measured);
+    }
+
+  /* the section sums from the augments match the tiles */
+  for (tile = gtk_list_item_manager_get_first (items);
+       tile != NULL;
+       tile = gtk_rb_tree_node_get_next (tile))
+    {
+      GtkListTile *item;
+      guint section_n_measured, expected;
+      gint64 section_size;
+
+      if (!gtk_list_tile_is_header (tile))
+        continue;
+
+      expected = 0;
+      for (item = gtk_rb_tree_node_get_next (tile);
+           item != NULL && !gtk_list_tile_is_header (item);
+           item = gtk_rb_tree_node_get_next (item))
+        expected += item->n_measured;
+
+      gtk_list_tile_get_section_measured_size (items, tile, &section_n_measured, &section_size);
+      g_assert_cmpuint (section_n_measured, ==, expected);
+      g_assert_cmpint (section_size, ==, expected);
+    }
+
   for (i = 0; i < n_trackers; i++)
     {
       guint pos, offset;
@@ -553,6 +591,288 @@ test_exhaustive (void)
   gtk_window_destroy (GTK_WINDOW (widget));
 }
 
+typedef struct {
+  GtkWidget *view;
+  GHashTable *frames;
+} BindData;
+
+static void
+setup_sized_item (GtkSignalListItemFactory *factory,
+                  GtkListItem              *item,
+                  gpointer                  data)
+{
+  gtk_list_item_set_child (item, gtk_box_new (GTK_ORIENTATION_VERTICAL, 0));
+}
+
+static void
+bind_sized_item (GtkSignalListItemFactory *factory,
+                 GtkListItem              *item,
+                 BindData                 *data)
+{
+  GtkWidget *child = gtk_list_item_get_child (item);
+  GdkFrameClock *clock;
+
+  /* make binding expensive, so that the budget runs out */
+  g_usleep (1000);
+
+  gtk_widget_set_size_request (child, 30, 20 + (gtk_list_item_get_position (item) % 3) * 10);
+
+  clock = gtk_widget_get_frame_clock (data->view);
+  if (clock)
+    g_hash_table_add (data->frames, GSIZE_TO_POINTER (gdk_frame_clock_get_frame_counter (clock)));
+}
+
+static void
+unbind_sized_item (GtkSignalListItemFactory *factory,
+                   GtkListItem              *item,
+                   gpointer                  data)
+{
+  /* so that placeholders are smaller than any bound item */
+  gtk_widget_set_size_request (gtk_list_item_get_child (item), -1, -1);
+}
+
+static GtkListItemFactory *
+create_sized_factory (BindData *data)
+{
+  GtkListItemFactory *factory;
+
+  factory = gtk_signal_list_item_factory_new ();
+  g_signal_connect (factory, "setup", G_CALLBACK (setup_sized_item), NULL);
+  g_signal_connect (factory, "bind", G_CALLBACK (bind_sized_item), data);
+  g_signal_connect (factory, "unbind", G_CALLBACK (unbind_sized_item), NULL);
+
+  return factory;
+}
+
+static GtkSelectionModel *
+create_sized_model (void)
+{
+  GtkStringList *list;
+  guint i;
+
+  list = gtk_string_list_new (NULL);
+  for (i = 0; i < 200; i++)
+    gtk_string_list_take (list, g_strdup_printf ("%u", i));
+
+  return GTK_SELECTION_MODEL (gtk_no_selection_new (G_LIST_MODEL (list)));
+}
+
+static gboolean
+has_placeholders (GtkListItemManager *items)
+{
+  GtkListTile *tile;
+
+  for (tile = gtk_list_item_manager_get_first (items);
+       tile != NULL;
+       tile = gtk_rb_tree_node_get_next (tile))
+    {
+      if (gtk_list_tile_is_placeholder (tile))
+        return TRUE;
+    }
+
+  return FALSE;
+}
+
+static gboolean
+count_frames_cb (GtkWidget     *widget,
+                 GdkFrameClock *frame_clock,
+                 gpointer       data)
+{
+  guint *n_frames = data;
+
+  (*n_frames)++;
+
+  return G_SOURCE_CONTINUE;
+}
+
+/* Binds all rows, and lets the view do a layout with them */
+static void
+wait_for_binds (GtkWidget *view)
+{
+  GtkListItemManager *items = gtk_list_base_get_manager (GTK_LIST_BASE (view));
+  guint n_frames, id;
+
+  while (!gtk_widget_get_mapped (view) || has_placeholders (items))
+    g_main_context_iteration (NULL, TRUE);
+
+  n_frames = 0;
+  id = gtk_widget_add_tick_callback (view, count_frames_cb, &n_frames, NULL);
+  while (n_frames < 3)
+    g_main_context_iteration (NULL, TRUE);
+  gtk_widget_remove_tick_callback (view, id);
+}
+
+static void
+check_budgeted_binds (GtkWidget *view,
+                      BindData  *data)
+{
+  GtkListItemManager *items = gtk_list_base_get_manager (GTK_LIST_BASE (view));
+  GtkWidget *window, *sw;
+  GtkListTile *tile;
+  guint n_widgets;
+
+  window = gtk_window_new ();
+  gtk_window_set_default_size (GTK_WINDOW (window), 200, 300);
+  sw = gtk_scrolled_window_new ();
+  gtk_window_set_child (GTK_WINDOW (window), sw);
+  gtk_scrolled_window_set_child (GTK_SCROLLED_WINDOW (sw), view);
+  gtk_window_present (GTK_WINDOW (window));
+
+  wait_for_binds (view);
+
+  /* the rows were bound over several frames */
+  g_assert_cmpuint (g_hash_table_size (data->frames), >, 1);
+
+  n_widgets = 0;
+  for (tile = gtk_list_item_manager_get_first (items);
+       tile != NULL;
+       tile = gtk_rb_tree_node_get_next (tile))
+    {
+      int min, nat;
+
+      if (tile->type != GTK_LIST_TILE_ITEM || tile->widget == NULL)
+        continue;
+
+      g_assert_false (gtk_list_tile_is_placeholder (tile));
+      gtk_widget_measure (tile->widget, GTK_ORIENTATION_VERTICAL, tile->area.width, &min, &nat, NULL, NULL);
+      g_assert_cmpint (min, >=, 20);
+
+      if (GTK_IS_LIST_VIEW (view))
+        {
+          /* the size of the bound row was remembered, not the placeholder's */
+          g_assert_cmpuint (tile->n_measured, ==, 1);
+          g_assert_cmpint (tile->measured_size, ==, tile->area.height);
+          g_assert_cmpint (tile->area.height, ==, min);
+        }
+      else
+        {
+          g_assert_cmpint (tile->area.height, >=, min);
+        }
+
+      n_widgets++;
+    }
+  g_assert_cmpuint (n_widgets, >, 1);
+
+  gtk_window_destroy (GTK_WINDOW (window));
+}
+
+static void
+test_list_view_bind_budget (void)
+{
+  BindData data;
+  GtkWidget *view;
+
+  data.frames = g_hash_table_new (NULL, NULL);
+  view = gtk_list_view_new (create_sized_model (), create_sized_factory (&data));
+  data.view = view;
+  gtk_list_view_set_bind_budget (GTK_LIST_VIEW (view), 1);
+
+  check_budgeted_binds (view, &data);
+
+  g_hash_table_unref (data.frames);
+}
+
+static void
+test_grid_view_bind_budget (void)
+{
+  BindData data;
+  GtkWidget *view;
+
+  data.frames = g_hash_table_new (NULL, NULL);
+  view = gtk_grid_view_new (create_sized_model (), create_sized_factory (&data));
+  data.view = view;
+  gtk_grid_view_set_max_columns (GTK_GRID_VIEW (view), 3);
+  gtk_grid_view_set_bind_budget (GTK_GRID_VIEW (view), 1);
+
+  check_budgeted_binds (view, &data);
+
+  g_hash_table_unref (data.frames);
+}
+
+static GtkListTile *
+get_tile_at (GtkListItemManager *items,
+             int                 y)
+{
+  GtkListTile *tile;
+
+  for (tile = gtk_list_item_manager_get_first (items);
+       tile != NULL;
+       tile = gtk_rb_tree_node_get_next (tile))
+    {
+      if (tile->widget && tile->area.y <= y && y < tile->area.y + tile->area.height)
+        return tile;
+    }
+
+  return NULL;
+}
+
+static void
+assert_measure_matches_allocation (GtkWidget *view)
+{
+  GtkListItemManager *items = gtk_list_base_get_manager (GTK_LIST_BASE (view));
+  GdkRectangle bounds;
+  int min, nat;
+
+  gtk_list_item_manager_get_tile_bounds (items, &bounds);
+  gtk_widget_measure (view, GTK_ORIENTATION_VERTICAL, bounds.width, &min, &nat, NULL, NULL);
+  g_assert_cmpint (min, ==, bounds.height);
+}
+
+/* Unknown rows are estimated the same way when measuring and
+ * allocating, and realizing them doesn't move the visible rows.
+ */
+static void
+test_list_view_estimates (void)
+{
+  GtkListItemManager *items;
+  GtkAdjustment *vadjustment;
+  GtkWidget *window, *sw, *view;
+  GtkListTile *tile;
+  BindData data;
+  int offset;
+  guint position;
+
+  data.frames = g_hash_table_new (NULL, NULL);
+  view = gtk_list_view_new (create_sized_model (), create_sized_factory (&data));
+  data.view = view;
+  items = gtk_list_base_get_manager (GTK_LIST_BASE (view));
+
+  window = gtk_window_new ();
+  gtk_window_set_default_size (GTK_WINDOW (window), 200, 300);
+  sw = gtk_scrolled_window_new ();
+  gtk_window_set_child (GTK_WINDOW (window), sw);
+  gtk_scrolled_window_set_child (GTK_SCROLLED_WINDOW (sw), view);
+  gtk_window_present (GTK_WINDOW (window));
+
+  wait_for_binds (view);
+  assert_measure_matches_allocation (view);
+
+  /* jump into rows that were never realized */
+  vadjustment = gtk_scrollable_get_vadjustment (GTK_SCROLLABLE (view));
+  gtk_adjustment_set_value (vadjustment, 2000);
+  wait_for_binds (view);
+  assert_measure_matches_allocation (view);
+
+  tile = get_tile_at (items, gtk_adjustment_get_value (vadjustment) + 150);
+  g_assert_nonnull (tile);
+  position = gtk_list_tile_get_position (items, tile);
+  offset = tile->area.y - gtk_adjustment_get_value (vadjustment);
+
+  /* scrolling a bit realizes more unknown rows, which changes the
+   * estimates, but the rows that stay visible don't move */
+  gtk_adjustment_set_value (vadjustment, gtk_adjustment_get_value (vadjustment) + 100);
+  wait_for_binds (view);
+  assert_measure_matches_allocation (view);
+
+  tile = gtk_list_item_manager_get_nth (items, position, NULL);
+  g_assert_nonnull (tile);
+  g_assert_nonnull (tile->widget);
+  g_assert_cmpint (tile->area.y - gtk_adjustment_get_value (vadjustment), ==, offset - 100);
+
+  gtk_window_destroy (GTK_WINDOW (window));
+  g_hash_table_unref (data.frames);
+}
+
 int
 main (int argc, char *argv[])
 {
@@ -561,6 +881,9 @@ main (int argc, char *argv[])
   g_test_add_func ("/listitemmanager/create", test_create);
   g_test_add_func ("/listitemmanager/create_with_items", test_create_with_items);
   g_test_add_func ("/listitemmanager/exhaustive", test_exhaustive);
+  g_test_add_func ("/listitemmanager/listview-bind-budget", test_list_view_bind_budget);
+  g_test_add_func ("/listitemmanager/gridview-bind-budget", test_grid_view_bind_budget);
+  g_test_add_func ("/listitemmanager/listview-estimates", test_list_view_estimates);
 
   return g_test_run ();
 }
@@ -590,6 +590,66 @@ test_incremental_remove (void)
   g_object_unref (removed);
 }
 
+static guint
+get_number (GObject *object)
+{
+  return GPOINTER_TO_UINT (g_object_get_qdata (object, number_quark));
+}
+
+/* Numeric sorters can be sorted in other threads,
+ * check that this gives the same results.
+ */
+static void
+test_parallel (void)
+{
+  GListStore *store;
+  GtkSortListModel *model;
+  GtkNumericSorter *sorter;
+  GtkExpression *expression;
+  const guint n_items = 100000;
+  guint i;
+
+  store = new_shuffled_store (n_items);
+  model = new_model (NULL);
+
+  expression = gtk_cclosure_expression_new (G_TYPE_UINT, NULL, 0, NULL,
+                                            G_CALLBACK (get_number), NULL, NULL);
+  sorter = gtk_numeric_sorter_new (expression);
+  gtk_sort_list_model_set_sorter (model, GTK_SORTER (sorter));
+  gtk_sort_list_model_set_model (model, G_LIST_MODEL (store));
+
+  for (i = 0; i < n_items; i++)
+    g_assert_cmpuint (i + 1, ==, get (G_LIST_MODEL (model), i));
+
+  gtk_sort_list_model_set_incremental (model, TRUE);
+  gtk_numeric_sorter_set_sort_order (sorter, GTK_SORT_DESCENDING);
+  g_assert_cmpuint (gtk_sort_list_model_get_pending (model), >, 0);
+
+  while (gtk_sort_list_model_get_pending (model) != 0)
+    g_main_context_iteration (NULL, TRUE);
+
+  for (i = 0; i < n_items; i++)
+    g_assert_cmpuint (n_items - i, ==, get (G_LIST_MODEL (model), i));
+
+  /* Change the model while the threads are sorting */
+  gtk_numeric_sorter_set_sort_order (sorter, GTK_SORT_ASCENDING);
+  while (gtk_sort_list_model_get_pending (model) != 0)
+    {
+      g_main_context_iteration (NULL, TRUE);
+      if (g_list_model_get_n_items (G_LIST_MODEL (store)) == n_items)
+        g_list_store_remove (store, 0);
+    }
+
+  for (i = 1; i < n_items - 1; i++)
+    g_assert_cmpuint (get (G_LIST_MODEL (model), i - 1), <, get (G_LIST_MODEL (model), i));
+
+  ignore_changes (model);
+
+  g_object_unref (sorter);
+  g_object_unref (store);
+  g_object_unref (model);
+}
+
 static void
 test_out_of_bounds_access (void)
 {
@@ -726,6 +786,7 @@ main (int argc, char *argv[])
   g_test_add_func ("/sortlistmodel/remove_items", test_remove_items);
   g_test_add_func ("/sortlistmodel/stability", test_stability);
   g_test_add_func ("/sortlistmodel/incremental/remove", test_incremental_remove);
+  g_test_add_func ("/sortlistmodel/parallel", test_parallel);
   g_test_add_func ("/sortlistmodel/oob-access", test_out_of_bounds_access);
   g_test_add_func ("/sortlistmodel/add-remove-item", test_add_remove_item);
   g_test_add_func ("/sortlistmodel/sections", test_sections);
@@ -281,6 +281,101 @@ test_find (void)
   g_object_unref (list);
 }
 
+static void
+test_from_bytes (void)
+{
+  static const char data[] = "a\0bb\0\0ccc\0dd";
+  GtkStringList *list;
+  GBytes *bytes;
+
+  bytes = g_bytes_new_static (data, sizeof (data) - 1);
+  list = gtk_string_list_new_from_bytes (bytes);
+  g_bytes_unref (bytes);
+
+  g_assert_cmpuint (g_list_model_get_n_items (G_LIST_MODEL (list)), ==, 5);
+  assert_model (list, "a bb  ccc dd");
+  g_assert_true (gtk_string_list_get_string (list, 1) == data + 2);
+
+  g_object_unref (list);
+}
+
+static void
+test_objects (void)
+{
+  GtkStringList *list;
+  GtkStringObject *a, *b;
+
+  list = new_model ((const char *[]){ "a", "b", "c", NULL });
+
+  /* objects are shared while they are alive */
+  a = g_list_model_get_item (G_LIST_MODEL (list), 1);
+  b = g_list_model_get_item (G_LIST_MODEL (list), 1);
+  g_assert_true (a == b);
+  g_assert_cmpstr (gtk_string_object_get_string (a), ==, "b");
+  g_object_unref (b);
+
+  b = g_list_model_get_item (G_LIST_MODEL (list), 1);
+  g_assert_true (a == b);
+  g_object_unref (b);
+
+  /* and outlive their row */
+  gtk_string_list_splice (list, 0, 2, (const char *[]){ "x", NULL });
+  assert_changes (list, "0-2+1");
+  g_assert_cmpstr (gtk_string_object_get_string (a), ==, "b");
+
+  b = g_list_model_get_item (G_LIST_MODEL (list), 0);
+  g_assert_true (a != b);
+  g_assert_cmpstr (gtk_string_object_get_string (b), ==, "x");
+  g_object_unref (b);
+
+  /* and their list */
+  g_object_unref (list);
+  g_assert_cmpstr (gtk_string_object_get_string (a), ==, "b");
+  g_object_unref (a);
+}
+
+static gpointer
+unref_thread (gpointer data)
+{
+  GAsyncQueue *queue = data;
+  gpointer item;
+
+  while ((item = g_async_queue_pop (queue)) != queue)
+    g_object_unref (item);
+
+  return NULL;
+}
+
+/* Items that are dropped in other threads must not
+ * corrupt the list's object cache.
+ */
+static void
+test_objects_threads (void)
+{
+  GtkStringList *list;
+  GAsyncQueue *queue;
+  GThread *thread;
+  guint i;
+
+  list = new_model ((const char *[]){ "a", "b", "c", "d", NULL });
+  queue = g_async_queue_new ();
+  thread = g_thread_new ("unref", unref_thread, queue);
+
+  for (i = 0; i < 100000; i++)
+    {
+      GtkStringObject *object = g_list_model_get_item (G_LIST_MODEL (list), i % 4);
+
+      g_assert_cmpstr (gtk_string_object_get_string (object), ==, (const char *[]) { "a", "b", "c", "d" }[i % 4]);
+      g_async_queue_push (queue, object);
+    }
+
+  g_async_queue_push (queue, queue);
+  g_thread_join (thread);
+  g_async_queue_unref (queue);
+
+  g_object_unref (list);
+}
+
 int
 main (int argc, char *argv[])
 {
@@ -298,6 +393,9 @@ main (int argc, char *argv[])
   g_test_add_func ("/stringlist/add_remove", test_add_remove);
   g_test_add_func ("/stringlist/take", test_take);
   g_test_add_func ("/stringlist/find", test_find);
+  g_test_add_func ("/stringlist/from_bytes", test_from_bytes);
+  g_test_add_func ("/stringlist/objects", test_objects);
+  g_test_add_func ("/stringlist/objects-threads", test_objects_threads);
 
   return g_test_run ();
 }
@@ -23,6 +23,8 @@
 #include <gtk/gtk.h>
 #include "gtk/gtktexttypesprivate.h" /* Private header, for UNKNOWN_CHAR */
 #include "gtk/gtktextbufferprivate.h" /* Private header */
+#include "gtk/gtktextlayoutprivate.h" /* Private header */
+#include "gtk/gtktextiterprivate.h" /* Private header */
 
 static void
 gtk_text_iter_spew (const GtkTextIter *iter, const char *desc)
@@ -1921,6 +1923,730 @@ test_serialize_wrap_mode (void)
   g_assert_finalize_object (buffer);
 }
 
+static void
+check_snapshot (GtkTextBuffer         *buffer,
+                GtkTextBufferSnapshot *snapshot)
+{
+  GtkTextIter start, end;
+  char *text, *copy;
+  gsize n_bytes, offset;
+  guint i;
+
+  gtk_text_buffer_get_bounds (buffer, &start, &end);
+  text = gtk_text_buffer_get_slice (buffer, &start, &end, TRUE);
+
+  copy = gtk_text_buffer_snapshot_get_text (snapshot, 0, G_MAXSIZE);
+  g_assert_cmpstr (copy, ==, text);
+  g_free (copy);
+
+  g_assert_cmpuint (gtk_text_buffer_snapshot_get_n_bytes (snapshot), ==, strlen (text));
+  g_assert_cmpuint (gtk_text_buffer_snapshot_get_n_chars (snapshot), ==, gtk_text_buffer_get_char_count (buffer));
+  g_assert_cmpuint (gtk_text_buffer_snapshot_get_n_lines (snapshot), ==, gtk_text_buffer_get_line_count (buffer));
+
+  offset = 0;
+  for (i = 0; i < gtk_text_buffer_snapshot_get_n_chunks (snapshot); i++)
+    {
+      const char *chunk;
+      gsize chunk_offset;
+
+      chunk = gtk_text_buffer_snapshot_get_chunk (snapshot, i, &chunk_offset, &n_bytes);
+      g_assert_cmpuint (chunk_offset, ==, offset);
+      g_assert_true (strncmp (chunk, text + offset, n_bytes) == 0);
+      offset += n_bytes;
+    }
+  g_assert_cmpuint (offset, ==, strlen (text));
+
+  for (i = 0; i < gtk_text_buffer_get_line_count (buffer); i++)
+    {
+      gsize line_offset;
+
+      gtk_text_buffer_get_start_iter (buffer, &start);
+      gtk_text_buffer_get_iter_at_line (buffer, &end, i);
+      copy = gtk_text_buffer_get_slice (buffer, &start, &end, TRUE);
+      line_offset = gtk_text_buffer_snapshot_get_line_offset (snapshot, i);
+      g_assert_cmpuint (line_offset, ==, strlen (copy));
+      g_assert_cmpuint (gtk_text_buffer_snapshot_get_line_at_offset (snapshot, line_offset), ==, i);
+      g_assert_cmpuint (gtk_text_buffer_snapshot_get_char_offset (snapshot, line_offset), ==, gtk_text_iter_get_offset (&end));
+      g_assert_cmpuint (gtk_text_buffer_snapshot_get_byte_offset (snapshot, gtk_text_iter_get_offset (&end)), ==, line_offset);
+      g_free (copy);
+    }
+
+  g_free (text);
+}
+
+static void
+test_snapshot (void)
+{
+  GtkTextBuffer *buffer;
+  GtkTextBufferSnapshot *snapshot, *old;
+  GtkTextIter iter, end;
+  GString *text;
+  const char *first_chunk;
+  int i;
+
+  buffer = gtk_text_buffer_new (NULL);
+
+  snapshot = gtk_text_buffer_get_snapshot (buffer);
+  g_assert_cmpuint (gtk_text_buffer_snapshot_get_n_lines (snapshot), ==, 1);
+  check_snapshot (buffer, snapshot);
+  gtk_text_buffer_snapshot_unref (snapshot);
+
+  text = g_string_new (NULL);
+  for (i = 0; i < 1000; i++)
+    g_string_append_printf (text, "Line %d \xc3\xa4\xc3\xb6\xc3\xbc\n", i);
+  gtk_text_buffer_set_text (buffer, text->str, text->len);
+  g_string_free (text, TRUE);
+
+  snapshot = gtk_text_buffer_get_snapshot (buffer);
+  check_snapshot (buffer, snapshot);
+  g_assert_cmpuint (gtk_text_buffer_snapshot_get_n_chunks (snapshot), >, 1);
+
+  /* No changes, no copies */
+  old = snapshot;
+  snapshot = gtk_text_buffer_get_snapshot (buffer);
+  g_assert_true (snapshot == old);
+  gtk_text_buffer_snapshot_unref (old);
+
+  /* Editing the end keeps the start */
+  old = snapshot;
+  first_chunk = gtk_text_buffer_snapshot_get_chunk (old, 0, NULL, NULL);
+  gtk_text_buffer_get_end_iter (buffer, &iter);
+  gtk_text_buffer_insert (buffer, &iter, "more\ntext", -1);
+  snapshot = gtk_text_buffer_get_snapshot (buffer);
+  check_snapshot (buffer, snapshot);
+  g_assert_true (gtk_text_buffer_snapshot_get_chunk (snapshot, 0, NULL, NULL) == first_chunk);
+
+  /* Old snapshots don't change */
+  g_assert_cmpuint (gtk_text_buffer_snapshot_get_n_lines (old), ==, 1001);
+  gtk_text_buffer_snapshot_unref (old);
+
+  /* Edits in the middle, with paintables and deletions across lines */
+  gtk_text_buffer_get_iter_at_line (buffer, &iter, 500);
+  gtk_text_buffer_insert (buffer, &iter, "new\nlines\n", -1);
+  gtk_text_buffer_get_iter_at_line (buffer, &iter, 20);
+  gtk_text_buffer_create_child_anchor (buffer, &iter);
+  gtk_text_buffer_get_iter_at_line (buffer, &iter, 700);
+  gtk_text_buffer_get_iter_at_line (buffer, &end, 703);
+  gtk_text_buffer_delete (buffer, &iter, &end);
+  old = snapshot;
+  snapshot = gtk_text_buffer_get_snapshot (buffer);
+  gtk_text_buffer_snapshot_unref (old);
+  check_snapshot (buffer, snapshot);
+
+  gtk_text_buffer_get_iter_at_line (buffer, &iter, 0);
+  gtk_text_buffer_insert (buffer, &iter, "first ", -1);
+  old = snapshot;
+  snapshot = gtk_text_buffer_get_snapshot (buffer);
+  gtk_text_buffer_snapshot_unref (old);
+  check_snapshot (buffer, snapshot);
+
+  gtk_text_buffer_get_bounds (buffer, &iter, &end);
+  gtk_text_buffer_delete (buffer, &iter, &end);
+  old = snapshot;
+  snapshot = gtk_text_buffer_get_snapshot (buffer);
+  gtk_text_buffer_snapshot_unref (old);
+  check_snapshot (buffer, snapshot);
+  gtk_text_buffer_snapshot_unref (snapshot);
+
+  g_object_unref (buffer);
+}
+
+static GtkTextLayout *
+create_layout (GtkTextBuffer *buffer)
+{
+  GtkTextLayout *layout;
+  GtkTextAttributes *style;
+  PangoContext *ltr_context, *rtl_context;
+
+  layout = gtk_text_layout_new ();
+  gtk_text_layout_set_buffer (layout, buffer);
+
+  ltr_context = pango_font_map_create_context (pango_cairo_font_map_get_default ());
+  pango_context_set_base_dir (ltr_context, PANGO_DIRECTION_LTR);
+  rtl_context = pango_font_map_create_context (pango_cairo_font_map_get_default ());
+  pango_context_set_base_dir (rtl_context, PANGO_DIRECTION_RTL);
+  gtk_text_layout_set_contexts (layout, ltr_context, rtl_context);
+  g_object_unref (ltr_context);
+  g_object_unref (rtl_context);
+
+  style = gtk_text_attributes_new ();
+  style->font = pango_font_description_from_string ("Sans 10");
+  style->wrap_mode = GTK_WRAP_WORD;
+  style->pixels_above_lines = 2;
+  gtk_text_layout_set_default_style (layout, style);
+  gtk_text_attributes_unref (style);
+
+  gtk_text_layout_set_screen_width (layout, 200);
+
+  return layout;
+}
+
+static void
+test_prefetch_sizes (void)
+{
+  GtkTextBuffer *buffer;
+  GtkTextLayout *sync_layout, *layout;
+  GtkTextIter start, end;
+  GtkTextTag *tag;
+  GString *text;
+  int i, width, height, sync_width, sync_height;
+
+  text = g_string_new (NULL);
+  for (i = 0; i < 3000; i++)
+    {
+      int j;
+
+      g_string_append_printf (text, "Line %d:", i);
+      for (j = 0; j < i % 13; j++)
+        g_string_append (text, " some words to wrap");
+      if (i % 100 == 7)
+        g_string_append (text, " \xd7\xa9\xd7\x9c\xd7\x95\xd7\x9d");
+      g_string_append_c (text, '\n');
+    }
+
+  buffer = gtk_text_buffer_new (NULL);
+  gtk_text_buffer_set_text (buffer, text->str, text->len);
+  g_string_free (text, TRUE);
+
+  /* Some lines that have to be wrapped in the main thread */
+  tag = gtk_text_buffer_create_tag (buffer, NULL, "scale", 2.0, NULL);
+  for (i = 100; i < 3000; i += 250)
+    {
+      gtk_text_buffer_get_iter_at_line (buffer, &start, i);
+      gtk_text_buffer_get_iter_at_line (buffer, &end, i + 3);
+      gtk_text_buffer_apply_tag (buffer, tag, &start, &end);
+    }
+
+  sync_layout = create_layout (buffer);
+  while (!gtk_text_layout_is_valid (sync_layout))
+    gtk_text_layout_validate (sync_layout, 2000);
+
+  layout = create_layout (buffer);
+
+  /* Wait for the first batch of lines to be measured */
+  gtk_text_layout_prefetch_sizes (layout);
+  g_main_context_iteration (NULL, TRUE);
+
+  while (!gtk_text_layout_is_valid (layout))
+    {
+      gtk_text_layout_prefetch_sizes (layout);
+      while (g_main_context_pending (NULL))
+        g_main_context_iteration (NULL, FALSE);
+      gtk_text_layout_validate (layout, 2000);
+    }
+
+  for (i = 0; i < gtk_text_buffer_get_line_count (buffer); i++)
+    {
+      int y, sync_y;
+
+      gtk_text_buffer_get_iter_at_line (buffer, &start, i);
+      gtk_text_layout_get_line_yrange (sync_layout, &start, &sync_y, &sync_height);
+      gtk_text_layout_get_line_yrange (layout, &start, &y, &height);
+      g_assert_cmpint (y, ==, sync_y);
+      g_assert_cmpint (height, ==, sync_height);
+    }
+
+  gtk_text_layout_get_size (sync_layout, &sync_width, &sync_height);
+  gtk_text_layout_get_size (layout, &width, &height);
+  g_assert_cmpint (width, ==, sync_width);
+  g_assert_cmpint (height, ==, sync_height);
+
+  /* At least the first batch, which was waited for, must have been
+   * measured in the threads. A batch has at least 256 lines.
+   */
+  g_assert_cmpuint (gtk_text_layout_get_n_prefetch_hits (layout), >=, 256);
+  g_assert_cmpuint (gtk_text_layout_get_n_prefetch_hits (sync_layout), ==, 0);
+
+  g_object_unref (layout);
+  g_object_unref (sync_layout);
+  g_object_unref (buffer);
+}
+
+static GtkTextLineDisplay *
+get_display (GtkTextLayout *layout,
+             GtkTextBuffer *buffer,
+             int            line)
+{
+  GtkTextIter iter;
+
+  gtk_text_buffer_get_iter_at_line (buffer, &iter, line);
+
+  return gtk_text_layout_get_line_display (layout, _gtk_text_iter_get_text_line (&iter), FALSE);
+}
+
+static void
+test_display_cache (void)
+{
+  GtkTextBuffer *buffer;
+  GtkTextLayout *layout;
+  GtkTextLineDisplayCacheStats stats;
+  GString *text;
+  int i;
+
+  text = g_string_new (NULL);
+  for (i = 0; i < 100; i++)
+    g_string_append_printf (text, "Line %d\n", i);
+
+  buffer = gtk_text_buffer_new (NULL);
+  gtk_text_buffer_set_text (buffer, text->str, text->len);
+  g_string_free (text, TRUE);
+
+  layout = create_layout (buffer);
+  gtk_text_layout_set_mru_size (layout, 10);
+
+  for (i = 0; i < 5; i++)
+    gtk_text_line_display_unref (get_display (layout, buffer, i));
+  for (i = 0; i < 5; i++)
+    gtk_text_line_display_unref (get_display (layout, buffer, i));
+
+  gtk_text_layout_get_display_cache_stats (layout, &stats);
+  g_assert_cmpuint (stats.misses, ==, 5);
+  g_assert_cmpuint (stats.hits, ==, 5);
+  g_assert_cmpuint (stats.n_displays, ==, 5);
+  g_assert_cmpuint (stats.capacity, ==, 10);
+  g_assert_cmpuint (stats.cost, >, 0);
+
+  /* Going over capacity evicts the least recently used lines */
+  for (i = 5; i < 50; i++)
+    gtk_text_line_display_unref (get_display (layout, buffer, i));
+
+  gtk_text_layout_get_display_cache_stats (layout, &stats);
+  g_assert_cmpuint (stats.n_displays, ==, 10);
+  g_assert_cmpuint (stats.evicted, ==, 40);
+
+  gtk_text_line_display_unref (get_display (layout, buffer, 49));
+  gtk_text_line_display_unref (get_display (layout, buffer, 0));
+
+  gtk_text_layout_get_display_cache_stats (layout, &stats);
+  g_assert_cmpuint (stats.hits, ==, 6);
+  g_assert_cmpuint (stats.misses, ==, 51);
+
+  g_object_unref (layout);
+  g_object_unref (buffer);
+}
+
+static GtkTextLine *
+get_text_line (GtkTextBuffer *buffer,
+               int            line)
+{
+  GtkTextIter iter;
+
+  gtk_text_buffer_get_iter_at_line (buffer, &iter, line);
+
+  return _gtk_text_iter_get_text_line (&iter);
+}
+
+static void
+test_display_cache_trim (void)
+{
+  GtkTextBuffer *buffer;
+  GtkTextLayout *layout;
+  GtkTextLineDisplayCacheStats stats;
+  guint64 hits, misses;
+  GString *text;
+  int i;
+
+  text = g_string_new (NULL);
+  for (i = 0; i < 200; i++)
+    g_string_append_printf (text, "Line %d\n", i);
+
+  buffer = gtk_text_buffer_new (NULL);
+  gtk_text_buffer_set_text (buffer, text->str, text->len);
+  g_string_free (text, TRUE);
+
+  layout = create_layout (buffer);
+  gtk_text_layout_set_mru_size (layout, 20);
+
+  /* Show lines 50 to 59, and let the lines after them get prefetched */
+  for (i = 50; i < 60; i++)
+    gtk_text_line_display_unref (get_display (layout, buffer, i));
+  gtk_text_layout_set_visible_lines (layout, get_text_line (buffer, 50), get_text_line (buffer, 59));
+  while (g_main_context_iteration (NULL, FALSE));
+
+  gtk_text_layout_get_display_cache_stats (layout, &stats);
+  g_assert_cmpuint (stats.prefetched, >, 0);
+  g_assert_cmpuint (stats.n_displays, ==, 10 + stats.prefetched);
+
+  /* The prefetched lines are the most recently used ones now,
+   * but trimming must keep what is visible */
+  gtk_text_layout_trim_display_cache (layout);
+
+  gtk_text_layout_get_display_cache_stats (layout, &stats);
+  g_assert_cmpuint (stats.n_displays, ==, 10);
+  hits = stats.hits;
+  misses = stats.misses;
+
+  for (i = 50; i < 60; i++)
+    gtk_text_line_display_unref (get_display (layout, buffer, i));
+
+  gtk_text_layout_get_display_cache_stats (layout, &stats);
+  g_assert_cmpuint (stats.hits, ==, hits + 10);
+  g_assert_cmpuint (stats.misses, ==, misses);
+
+  /* Going over capacity doesn't evict them either */
+  for (i = 100; i < 150; i++)
+    gtk_text_line_display_unref (get_display (layout, buffer, i));
+  for (i = 50; i < 60; i++)
+    gtk_text_line_display_unref (get_display (layout, buffer, i));
+
+  gtk_text_layout_get_display_cache_stats (layout, &stats);
+  g_assert_cmpuint (stats.hits, ==, hits + 20);
+
+  g_object_unref (layout);
+  g_object_unref (buffer);
+}
+
+static void
+test_display_cache_visible_after_edit (void)
+{
+  GtkTextBuffer *buffer;
+  GtkTextLayout *layout;
+  GtkTextLineDisplayCacheStats stats;
+  GtkTextIter iter;
+  guint64 hits, misses;
+  GString *text;
+  int i;
+
+  text = g_string_new (NULL);
+  for (i = 0; i < 200; i++)
+    g_string_append_printf (text, "Line %d\n", i);
+
+  buffer = gtk_text_buffer_new (NULL);
+  gtk_text_buffer_set_text (buffer, text->str, text->len);
+  g_string_free (text, TRUE);
+
+  layout = create_layout (buffer);
+  gtk_text_layout_set_mru_size (layout, 20);
+
+  for (i = 50; i < 60; i++)
+    gtk_text_line_display_unref (get_display (layout, buffer, i));
+  gtk_text_layout_set_visible_lines (layout, get_text_line (buffer, 50), get_text_line (buffer, 59));
+
+  /* Lines inserted above the visible ones move them to 70 to 79 */
+  gtk_text_buffer_get_start_iter (buffer, &iter);
+  for (i = 0; i < 20; i++)
+    gtk_text_buffer_insert (buffer, &iter, "New line\n", -1);
+
+  gtk_text_layout_trim_display_cache (layout);
+
+  gtk_text_layout_get_display_cache_stats (layout, &stats);
+  g_assert_cmpuint (stats.n_displays, ==, 10);
+  hits = stats.hits;
+  misses = stats.misses;
+
+  for (i = 70; i < 80; i++)
+    gtk_text_line_display_unref (get_display (layout, buffer, i));
+
+  gtk_text_layout_get_display_cache_stats (layout, &stats);
+  g_assert_cmpuint (stats.hits, ==, hits + 10);
+  g_assert_cmpuint (stats.misses, ==, misses);
+
+  g_object_unref (layout);
+  g_object_unref (buffer);
+}
+
+static void
+check_same_toggles (GtkTextBuffer *a,
+                    GtkTextBuffer *b,
+                    const char    *tag_name)
+{
+  GtkTextTag *tag_a, *tag_b;
+  GtkTextIter iter_a, iter_b;
+  gboolean more_a, more_b;
+
+  tag_a = gtk_text_tag_table_lookup (gtk_text_buffer_get_tag_table (a), tag_name);
+  tag_b = gtk_text_tag_table_lookup (gtk_text_buffer_get_tag_table (b), tag_name);
+
+  gtk_text_buffer_get_start_iter (a, &iter_a);
+  gtk_text_buffer_get_start_iter (b, &iter_b);
+  g_assert_cmpint (gtk_text_iter_has_tag (&iter_a, tag_a), ==, gtk_text_iter_has_tag (&iter_b, tag_b));
+
+  do
+    {
+      more_a = gtk_text_iter_forward_to_tag_toggle (&iter_a, tag_a);
+      more_b = gtk_text_iter_forward_to_tag_toggle (&iter_b, tag_b);
+      g_assert_cmpint (more_a, ==, more_b);
+      g_assert_cmpint (gtk_text_iter_get_offset (&iter_a), ==, gtk_text_iter_get_offset (&iter_b));
+    }
+  while (more_a);
+
+  do
+    {
+      more_a = gtk_text_iter_backward_to_tag_toggle (&iter_a, tag_a);
+      more_b = gtk_text_iter_backward_to_tag_toggle (&iter_b, tag_b);
+      g_assert_cmpint (more_a, ==, more_b);
+      g_assert_cmpint (gtk_text_iter_get_offset (&iter_a), ==, gtk_text_iter_get_offset (&iter_b));
+    }
+  while (more_a);
+}
+
+static void
+test_tag_ranges (void)
+{
+  GtkTextBuffer *batched, *single;
+  GtkTextTagRange *ranges;
+  GtkTextIter start, end;
+  GString *text;
+  guint i, n_ranges;
+  int offset;
+
+  text = g_string_new (NULL);
+  for (i = 0; i < 2000; i++)
+    g_string_append_printf (text, "int line_%u = foo (bar, %u);\n", i, i * 7);
+
+  batched = gtk_text_buffer_new (NULL);
+  single = gtk_text_buffer_new (NULL);
+  gtk_text_buffer_set_text (batched, text->str, text->len);
+  gtk_text_buffer_set_text (single, text->str, text->len);
+
+  gtk_text_buffer_create_tag (batched, "keyword", "foreground", "blue", NULL);
+  gtk_text_buffer_create_tag (batched, "number", "weight", PANGO_WEIGHT_BOLD, NULL);
+  gtk_text_buffer_create_tag (single, "keyword", "foreground", "blue", NULL);
+  gtk_text_buffer_create_tag (single, "number", "weight", PANGO_WEIGHT_BOLD, NULL);
+
+  /* Highlight the type and every number, with some overlaps
+   * of existing ranges
+   */
+  ranges = g_new (GtkTextTagRange, 3 * 2000);
+  n_ranges = 0;
+  for (i = 0; i < 2000; i++)
+    {
+      gtk_text_buffer_get_iter_at_line (batched, &start, i);
+      offset = gtk_text_iter_get_offset (&start);
+
+      ranges[n_ranges++] = (GtkTextTagRange) {
+        gtk_text_tag_table_lookup (gtk_text_buffer_get_tag_table (batched), "keyword"),
+        offset, offset + 3
+      };
+      ranges[n_ranges++] = (GtkTextTagRange) {
+        gtk_text_tag_table_lookup (gtk_text_buffer_get_tag_table (batched), "number"),
+        offset + 9, offset + 13
+      };
+      if (i % 3 == 0)
+        ranges[n_ranges++] = (GtkTextTagRange) {
+          gtk_text_tag_table_lookup (gtk_text_buffer_get_tag_table (batched), "number"),
+          offset + 10, offset + 30
+        };
+    }
+
+  gtk_text_buffer_apply_tag_ranges (batched, ranges, n_ranges);
+
+  for (i = 0; i < n_ranges; i++)
+    {
+      gtk_text_buffer_get_iter_at_offset (single, &start, ranges[i].start);
+      gtk_text_buffer_get_iter_at_offset (single, &end, ranges[i].end);
+      gtk_text_buffer_apply_tag_by_name (single, gtk_text_tag_get_name (ranges[i].tag), &start, &end);
+    }
+
+  check_same_toggles (batched, single, "keyword");
+  check_same_toggles (batched, single, "number");
+
+  /* Remove every other range again */
+  for (i = 0; i < n_ranges; i += 2)
+    {
+      gtk_text_buffer_get_iter_at_offset (single, &start, ranges[i].start);
+      gtk_text_buffer_get_iter_at_offset (single, &end, ranges[i].end);
+      gtk_text_buffer_remove_tag_by_name (single, gtk_text_tag_get_name (ranges[i].tag), &start, &end);
+      ranges[i / 2] = ranges[i];
+    }
+
+  gtk_text_buffer_remove_tag_ranges (batched, ranges, (n_ranges + 1) / 2);
+
+  check_same_toggles (batched, single, "keyword");
+  check_same_toggles (batched, single, "number");
+
+  g_free (ranges);
+  g_string_free (text, TRUE);
+  g_object_unref (batched);
+  g_object_unref (single);
+}
+
+/* Finds the next offset after @offset where @tagged changes */
+static int
+find_next_change (const gboolean *tagged,
+                  int             n_chars,
+                  int             offset)
+{
+  for (offset++; offset <= n_chars; offset++)
+    {
+      gboolean before = tagged[offset - 1];
+      gboolean after = offset < n_chars && tagged[offset];
+
+      if (before != after)
+        return offset;
+    }
+
+  return -1;
+}
+
+/* Checks the toggles of @tag against @tagged, which says for every
+ * character whether it should have the tag. The searches from the
+ * middle of the buffer need to skip over many untagged leaves.
+ */
+static void
+check_toggles (GtkTextBuffer  *buffer,
+               GtkTextTag     *tag,
+               const gboolean *tagged,
+               int             n_chars)
+{
+  GtkTextIter iter;
+  int offset, change;
+
+  /* The ranges don't touch the ends of the buffer */
+  g_assert_false (tagged[0]);
+  g_assert_false (tagged[n_chars - 1]);
+
+  gtk_text_buffer_get_start_iter (buffer, &iter);
+  for (change = find_next_change (tagged, n_chars, 0);
+       change >= 0;
+       change = find_next_change (tagged, n_chars, change))
+    {
+      g_assert_true (gtk_text_iter_forward_to_tag_toggle (&iter, tag));
+      g_assert_cmpint (gtk_text_iter_get_offset (&iter), ==, change);
+    }
+  g_assert_false (gtk_text_iter_forward_to_tag_toggle (&iter, tag));
+
+  for (offset = 0; offset < n_chars; offset += 97)
+    {
+      int prev;
+
+      gtk_text_buffer_get_iter_at_offset (buffer, &iter, offset);
+      g_assert_cmpint (gtk_text_iter_has_tag (&iter, tag), ==, tagged[offset]);
+
+      /* Don't start on a toggle */
+      if (offset > 0 && tagged[offset] != tagged[offset - 1])
+        continue;
+
+      change = find_next_change (tagged, n_chars, offset);
+      if (change < 0)
+        {
+          g_assert_false (gtk_text_iter_forward_to_tag_toggle (&iter, tag));
+        }
+      else
+        {
+          g_assert_true (gtk_text_iter_forward_to_tag_toggle (&iter, tag));
+          g_assert_cmpint (gtk_text_iter_get_offset (&iter), ==, change);
+        }
+
+      prev = -1;
+      for (change = find_next_change (tagged, n_chars, 0);
+           change >= 0 && change < offset;
+           change = find_next_change (tagged, n_chars, change))
+        prev = change;
+
+      gtk_text_buffer_get_iter_at_offset (buffer, &iter, offset);
+      if (prev < 0)
+        {
+          g_assert_false (gtk_text_iter_backward_to_tag_toggle (&iter, tag));
+        }
+      else
+        {
+          g_assert_true (gtk_text_iter_backward_to_tag_toggle (&iter, tag));
+          g_assert_cmpint (gtk_text_iter_get_offset (&iter), ==, prev);
+        }
+    }
+}
+
+static GtkTextTagRange
+make_range (GtkTextBuffer *buffer,
+            GtkTextTag    *tag,
+            int            start_line,
+            int            start_column,
+            int            end_line,
+            int            end_column)
+{
+  GtkTextIter start, end;
+
+  gtk_text_buffer_get_iter_at_line_offset (buffer, &start, start_line, start_column);
+  gtk_text_buffer_get_iter_at_line_offset (buffer, &end, end_line, end_column);
+
+  return (GtkTextTagRange) {
+    tag,
+    gtk_text_iter_get_offset (&start),
+    gtk_text_iter_get_offset (&end)
+  };
+}
+
+/* Ranges spanning many lines cover several leaves of the btree,
+ * and most leaves don't have toggles for the tag.
+ */
+static void
+test_tag_ranges_multiline (void)
+{
+  GtkTextBuffer *batched, *single;
+  GtkTextTag *tag;
+  GtkTextTagRange ranges[6], removed[2];
+  GtkTextIter start, end;
+  gboolean *tagged;
+  GString *text;
+  int n_chars;
+  guint i;
+  int j;
+
+  text = g_string_new (NULL);
+  for (i = 0; i < 2000; i++)
+    g_string_append_printf (text, "int line_%u = foo (bar, %u);\n", i, i * 7);
+
+  batched = gtk_text_buffer_new (NULL);
+  single = gtk_text_buffer_new (NULL);
+  gtk_text_buffer_set_text (batched, text->str, text->len);
+  gtk_text_buffer_set_text (single, text->str, text->len);
+  tag = gtk_text_buffer_create_tag (batched, "block", "background", "yellow", NULL);
+  gtk_text_buffer_create_tag (single, "block", "background", "yellow", NULL);
+
+  n_chars = gtk_text_buffer_get_char_count (batched);
+  tagged = g_new0 (gboolean, n_chars);
+
+  /* Overlapping, adjacent and unsorted ranges */
+  ranges[0] = make_range (batched, tag, 300, 0, 420, 10);
+  ranges[1] = make_range (batched, tag, 5, 4, 180, 7);
+  ranges[2] = make_range (batched, tag, 400, 3, 520, 1);
+  ranges[3] = make_range (batched, tag, 520, 1, 530, 0);
+  ranges[4] = make_range (batched, tag, 1200, 2, 1201, 2);
+  ranges[5] = make_range (batched, tag, 1990, 1, 1995, 3);
+
+  gtk_text_buffer_apply_tag_ranges (batched, ranges, G_N_ELEMENTS (ranges));
+
+  for (i = 0; i < G_N_ELEMENTS (ranges); i++)
+    {
+      for (j = ranges[i].start; j < ranges[i].end; j++)
+        tagged[j] = TRUE;
+
+      gtk_text_buffer_get_iter_at_offset (single, &start, ranges[i].start);
+      gtk_text_buffer_get_iter_at_offset (single, &end, ranges[i].end);
+      gtk_text_buffer_apply_tag_by_name (single, "block", &start, &end);
+    }
+
+  check_toggles (batched, tag, tagged, n_chars);
+  check_same_toggles (batched, single, "block");
+
+  /* Split the first range, and remove a part spanning
+   * several ranges
+   */
+  removed[0] = make_range (batched, tag, 100, 0, 150, 0);
+  removed[1] = make_range (batched, tag, 410, 0, 1300, 0);
+
+  gtk_text_buffer_remove_tag_ranges (batched, removed, G_N_ELEMENTS (removed));
+
+  for (i = 0; i < G_N_ELEMENTS (removed); i++)
+    {
+      for (j = removed[i].start; j < removed[i].end; j++)
+        tagged[j] = FALSE;
+
+      gtk_text_buffer_get_iter_at_offset (single, &start, removed[i].start);
+      gtk_text_buffer_get_iter_at_offset (single, &end, removed[i].end);
+      gtk_text_buffer_remove_tag_by_name (single, "block", &start, &end);
+    }
+
+  check_toggles (batched, tag, tagged, n_chars);
+  check_same_toggles (batched, single, "block");
+
+  g_free (tagged);
+  g_string_free (text, TRUE);
+  g_object_unref (batched);
+  g_object_unref (single);
+}
+
 int
 main (int argc, char** argv)
 {
@@ -1949,6 +2675,13 @@ main (int argc, char** argv)
   g_test_add_func ("/TextBuffer/Undo 4", test_undo4);
   g_test_add_func ("/TextBuffer/Undo 5", test_undo5);
   g_test_add_func ("/TextBuffer/Serialize wrap-mode", test_serialize_wrap_mode);
+  g_test_add_func ("/TextBuffer/Snapshot", test_snapshot);
+  g_test_add_func ("/TextBuffer/Prefetch sizes", test_prefetch_sizes);
+  g_test_add_func ("/TextBuffer/Tag ranges", test_tag_ranges);
+  g_test_add_func ("/TextBuffer/Tag ranges multiline", test_tag_ranges_multiline);
+  g_test_add_func ("/TextBuffer/Display cache", test_display_cache);
+  g_test_add_func ("/TextBuffer/Display cache trim", test_display_cache_trim);
+  g_test_add_func ("/TextBuffer/Display cache visible after edit", test_display_cache_visible_after_edit);
 
   return g_test_run();
 }
@@ -664,6 +664,60 @@ test_issue_5777 (void)
   run_test (commands, G_N_ELEMENTS (commands), 4);
 }
 
+static void
+test_max_bytes (void)
+{
+  Text *text = text_new ();
+  char block[20000];
+  guint i;
+
+  /* Blocks this large get a storage chunk of their own */
+  memset (block, 'x', sizeof block);
+  block[sizeof block - 1] = '\n';
+
+  gtk_text_history_set_max_bytes (text->history, 2 * sizeof block + 1024);
+
+  /* Typing is coalesced into a single run, but the run keeps
+   * a whole shared chunk alive, so that is what it costs */
+  for (i = 0; i < 5; i++)
+    {
+      Command cmd = { INSERT, i, -1, "a" };
+      command_insert (&cmd, text);
+    }
+  g_assert_cmpuint (gtk_text_history_get_n_bytes (text->history), >, sizeof block);
+
+  /* Pastes that exceed the budget push out the oldest steps */
+  for (i = 0; i < 4; i++)
+    {
+      g_string_append_len (text->buf, block, sizeof block);
+      gtk_text_history_text_inserted (text->history, 5 + i * sizeof block, block, sizeof block);
+    }
+  g_assert_cmpuint (gtk_text_history_get_n_bytes (text->history), >=, 2 * sizeof block);
+  g_assert_cmpuint (gtk_text_history_get_n_bytes (text->history), <=, 2 * sizeof block + 1024);
+
+  gtk_text_history_undo (text->history);
+  gtk_text_history_undo (text->history);
+  g_assert_cmpuint (text->buf->len, ==, 5 + 2 * sizeof block);
+  g_assert_false (text->can_undo);
+  g_assert_true (text->can_redo);
+
+  gtk_text_history_redo (text->history);
+  gtk_text_history_redo (text->history);
+  g_assert_cmpuint (text->buf->len, ==, 5 + 4 * sizeof block);
+
+  /* The most recent step is kept, even when it is over budget */
+  gtk_text_history_set_max_bytes (text->history, 16);
+  g_assert_cmpuint (gtk_text_history_get_n_bytes (text->history), >=, sizeof block);
+  g_assert_cmpuint (gtk_text_history_get_n_bytes (text->history), <, 2 * sizeof block);
+  g_assert_true (text->can_undo);
+
+  gtk_text_history_undo (text->history);
+  g_assert_cmpuint (text->buf->len, ==, 5 + 3 * sizeof block);
+  g_assert_false (text->can_undo);
+
+  text_free (text);
+}
+
 int
 main (int   argc,
       char *argv[])
@@ -687,6 +741,7 @@ main (int   argc,
   g_test_add_func ("/Gtk/TextHistory/issue_4276", test_issue_4276);
   g_test_add_func ("/Gtk/TextHistory/issue_4575", test_issue_4575);
   g_test_add_func ("/Gtk/TextHistory/issue_5777", test_issue_5777);
+  g_test_add_func ("/Gtk/TextHistory/max_bytes", test_max_bytes);
 
   return g_test_run ();
 }
@@ -22,6 +22,14 @@
 #include <stdlib.h>
 #include <string.h>
 #include <errno.h>
+#include <math.h>
+
+#ifdef HAVE_SYS_RESOURCE_H
+#include <sys/resource.h>
+#endif
+#ifdef HAVE_MALLOC_H
+#include <malloc.h>
+#endif
 
 #include <glib/gi18n-lib.h>
 #include <glib/gprintf.h>
@@ -29,58 +37,437 @@
 #include <gtk/gtk.h>
 #include "gtk-rendernode-tool.h"
 
+typedef struct
+{
+  char *name;
+  GskRenderNode *node;
+} BenchmarkFile;
+
+typedef struct
+{
+  const char *name;
+  const char *renderer;
+  guint runs;
+  double min;
+  double median;
+  double p95;
+  double p99;
+  double mean;
+  double stddev;
+  gint64 process_peak_rss;
+  gint64 heap_size;
+} BenchmarkResult;
+
 static void
-benchmark_node (GskRenderNode *node,
-                const char    *renderer_name,
-                guint          runs,
-                gboolean       download)
+benchmark_file_clear (gpointer data)
 {
-  GError *error = NULL;
-  GskRenderer *renderer;
+  BenchmarkFile *file = data;
+
+  g_free (file->name);
+  gsk_render_node_unref (file->node);
+}
+
+/* peak resident set size of the process in bytes, or -1.
+ * This covers everything the process did so far, not just
+ * the latest benchmark.
+ */
+static gint64
+get_peak_rss (void)
+{
+#if defined (HAVE_GETRUSAGE) && defined (HAVE_SYS_RESOURCE_H)
+  struct rusage usage;
+
+  if (getrusage (RUSAGE_SELF, &usage) != 0)
+    return -1;
+
+#ifdef __APPLE__
+  return usage.ru_maxrss;
+#else
+  return (gint64) usage.ru_maxrss * 1024;
+#endif
+#else
+  return -1;
+#endif
+}
+
+/* bytes currently allocated with malloc(), or -1 */
+static gint64
+get_heap_size (void)
+{
+#if defined (HAVE_MALLINFO2) && defined (HAVE_MALLOC_H)
+  struct mallinfo2 info = mallinfo2 ();
+
+  return info.uordblks + info.hblkhd;
+#else
+  return -1;
+#endif
+}
+
+static int
+compare_durations (gconstpointer a,
+                   gconstpointer b)
+{
+  gint64 da = *(const gint64 *) a;
+  gint64 db = *(const gint64 *) b;
+
+  return (da > db) - (da < db);
+}
+
+/* nearest-rank percentile of sorted durations, in milliseconds */
+static double
+percentile (const gint64 *durations,
+            guint         n,
+            double        p)
+{
+  guint rank = ceil (p / 100.0 * n);
+
+  return durations[CLAMP (rank, 1, n) - 1] / 1000.0;
+}
+
+static void
+compute_statistics (BenchmarkResult *result,
+                    gint64          *durations,
+                    guint            n)
+{
+  double sum, sum_sq;
   guint i;
 
-  renderer = create_renderer (renderer_name, &error);
-  if (renderer == NULL)
+  result->runs = n;
+  if (n == 0)
+    return;
+
+  qsort (durations, n, sizeof (gint64), compare_durations);
+
+  result->min = durations[0] / 1000.0;
+  if (n % 2)
+    result->median = durations[n / 2] / 1000.0;
+  else
+    result->median = (durations[n / 2 - 1] + durations[n / 2]) / 2000.0;
+  result->p95 = percentile (durations, n, 95);
+  result->p99 = percentile (durations, n, 99);
+
+  sum = 0;
+  for (i = 0; i < n; i++)
+    sum += durations[i] / 1000.0;
+  result->mean = sum / n;
+
+  sum_sq = 0;
+  for (i = 0; i < n; i++)
+    {
+      double diff = durations[i] / 1000.0 - result->mean;
+      sum_sq += diff * diff;
+    }
+  result->stddev = n > 1 ? sqrt (sum_sq / (n - 1)) : 0;
+}
+
+static gint64
+render_once (GskRenderer   *renderer,
+             GskRenderNode *node,
+             gboolean       download)
+{
+  GdkTexture *texture;
+  gint64 start_time, end_time;
+
+  start_time = g_get_monotonic_time ();
+
+  texture = gsk_renderer_render_texture (renderer, node, NULL);
+  if (download)
     {
-      g_printerr ("Could not benchmark renderer \"%s\": %s\n", renderer_name, error->message);
-      g_clear_error (&error);
-      return;
+      GdkTextureDownloader *downloader;
+      GBytes *bytes;
+      gsize stride;
+
+      downloader = gdk_texture_downloader_new (texture);
+      gdk_texture_downloader_set_format (downloader, gdk_texture_get_format (texture));
+      gdk_texture_downloader_set_color_state (downloader, gdk_texture_get_color_state (texture));
+      bytes = gdk_texture_downloader_download_bytes (downloader, &stride);
+      g_bytes_unref (bytes);
+      gdk_texture_downloader_free (downloader);
     }
 
+  end_time = g_get_monotonic_time ();
+
+  g_object_unref (texture);
+
+  return end_time - start_time;
+}
+
+static void
+benchmark_node (GskRenderer     *renderer,
+                GskRenderNode   *node,
+                guint            warmup,
+                guint            runs,
+                gboolean         download,
+                gboolean         print_runs,
+                BenchmarkResult *result)
+{
+  gint64 *durations;
+  guint i;
+
+  for (i = 0; i < warmup; i++)
+    render_once (renderer, node, download);
+
+  durations = g_new (gint64, runs);
+
   for (i = 0; i < runs; i++)
     {
-      GdkTexture *texture;
-      gint64 start_time, end_time, duration;
+      gint64 duration;
 
-      start_time = g_get_monotonic_time ();
+      duration = render_once (renderer, node, download);
+      durations[i] = duration;
 
-      texture = gsk_renderer_render_texture (renderer, node, NULL);
-      if (download)
+      if (print_runs)
+        g_print ("%s\t%lld.%03ds\n",
+                 result->renderer,
+                 (long long) duration / G_USEC_PER_SEC,
+                 (int) ((duration * 1000 / G_USEC_PER_SEC) % 1000));
+    }
+
+  compute_statistics (result, durations, runs);
+  result->process_peak_rss = get_peak_rss ();
+  result->heap_size = get_heap_size ();
+
+  g_free (durations);
+}
+
+static void
+print_result (const BenchmarkResult *result)
+{
+  g_print ("%s\t%s\tmin %.3fms\tmedian %.3fms\tp95 %.3fms\tp99 %.3fms\tstddev %.3fms\n",
+           result->name, result->renderer,
+           result->min, result->median, result->p95, result->p99, result->stddev);
+}
+
+static void
+append_json_number (GString    *string,
+                    const char *key,
+                    double      value,
+                    gboolean    last)
+{
+  char buffer[G_ASCII_DTOSTR_BUF_SIZE];
+
+  g_string_append_printf (string, "        \"%s\": %s%s\n",
+                          key,
+                          g_ascii_formatd (buffer, sizeof (buffer), "%.6f", value),
+                          last ? "" : ",");
+}
+
+static void
+append_json_string (GString    *string,
+                    const char *str)
+{
+  const char *p;
+
+  g_string_append_c (string, '"');
+  for (p = str; *p; p++)
+    {
+      if (*p == '"' || *p == '\\')
+        g_string_append_printf (string, "\\%c", *p);
+      else if ((guchar) *p < 0x20)
+        g_string_append_printf (string, "\\u%04x", *p);
+      else
+        g_string_append_c (string, *p);
+    }
+  g_string_append_c (string, '"');
+}
+
+/* The format only uses nested objects with numbers, so that
+ * g_variant_parse() can read it back as a baseline.
+ */
+static char *
+results_to_json (GPtrArray *results)
+{
+  GString *string;
+  const char *last_name = NULL;
+  guint i;
+
+  string = g_string_new ("{\n");
+
+  for (i = 0; i < results->len; i++)
+    {
+      const BenchmarkResult *result = g_ptr_array_index (results, i);
+
+      if (g_strcmp0 (last_name, result->name) != 0)
         {
-          GdkTextureDownloader *downloader;
-          GBytes *bytes;
-          gsize stride;
-
-          downloader = gdk_texture_downloader_new (texture);
-          gdk_texture_downloader_set_format (downloader, gdk_texture_get_format (texture));
-          gdk_texture_downloader_set_color_state (downloader, gdk_texture_get_color_state (texture));
-          bytes = gdk_texture_downloader_download_bytes (downloader, &stride);
-          g_bytes_unref (bytes);
-          gdk_texture_downloader_free (downloader);
+          if (last_name)
+            g_string_append (string, "  },\n");
+          g_string_append (string, "  ");
+          append_json_string (string, result->name);
+          g_string_append (string, ": {\n");
+          last_name = result->name;
         }
+      else
+        g_string_append (string, ",\n");
+
+      g_string_append (string, "    ");
+      append_json_string (string, result->renderer);
+      g_string_append (string, ": {\n");
+      append_json_number (string, "runs", result->runs, FALSE);
+      append_json_number (string, "min", result->min, FALSE);
+      append_json_number (string, "median", result->median, FALSE);
+      append_json_number (string, "p95", result->p95, FALSE);
+      append_json_number (string, "p99", result->p99, FALSE);
+      append_json_number (string, "mean", result->mean, FALSE);
+      append_json_number (string, "stddev", result->stddev, result->process_peak_rss < 0 && result->heap_size < 0);
+      if (result->process_peak_rss >= 0)
+        append_json_number (string, "process-peak-rss", result->process_peak_rss, result->heap_size < 0);
+      if (result->heap_size >= 0)
+        append_json_number (string, "heap-size", result->heap_size, TRUE);
+      g_string_append (string, "    }");
+
+      if (i + 1 == results->len ||
+          g_strcmp0 (result->name, ((BenchmarkResult *) g_ptr_array_index (results, i + 1))->name) != 0)
+        g_string_append (string, "\n");
+    }
 
-      end_time = g_get_monotonic_time ();
+  if (last_name)
+    g_string_append (string, "  }\n");
+  g_string_append (string, "}\n");
 
-      duration = end_time - start_time;
-      g_print ("%s\t%lld.%03ds\n",
-               renderer_name,
-               (long long) duration / G_USEC_PER_SEC,
-               (int) ((duration * 1000 / G_USEC_PER_SEC) % 1000)); 
-      g_object_unref (texture);
+  return g_string_free (string, FALSE);
+}
+
+static GVariant *
+load_baseline (const char *filename)
+{
+  GVariant *baseline;
+  GError *error = NULL;
+  char *contents;
+
+  if (!g_file_get_contents (filename, &contents, NULL, &error))
+    {
+      g_printerr (_("Failed to load baseline: %s\n"), error->message);
+      exit (1);
+    }
+
+  baseline = g_variant_parse (G_VARIANT_TYPE ("a{sa{sa{sd}}}"), contents, NULL, NULL, &error);
+  if (baseline == NULL)
+    {
+      g_printerr (_("Failed to parse baseline %s: %s\n"), filename, error->message);
+      exit (1);
+    }
+
+  g_free (contents);
+
+  return baseline;
+}
+
+/* Returns the number of regressions */
+static guint
+compare_to_baseline (GPtrArray *results,
+                     GVariant  *baseline,
+                     double     threshold)
+{
+  guint i, n_regressions = 0;
+
+  for (i = 0; i < results->len; i++)
+    {
+      const BenchmarkResult *result = g_ptr_array_index (results, i);
+      GVariant *renderers, *values;
+      double base_median, change;
+
+      renderers = g_variant_lookup_value (baseline, result->name, G_VARIANT_TYPE ("a{sa{sd}}"));
+      if (renderers == NULL)
+        continue;
+
+      values = g_variant_lookup_value (renderers, result->renderer, G_VARIANT_TYPE ("a{sd}"));
+      g_variant_unref (renderers);
+      if (values == NULL)
+        continue;
+
+      if (!g_variant_lookup (values, "median", "d", &base_median) || base_median <= 0)
+        {
+          g_variant_unref (values);
+          continue;
+        }
+      g_variant_unref (values);
+
+      change = (result->median - base_median) / base_median * 100;
+      if (change > threshold)
+        {
+          g_print ("REGRESSION\t%s\t%s\tmedian %.3fms -> %.3fms (%+.1f%%)\n",
+                   result->name, result->renderer, base_median, result->median, change);
+          n_regressions++;
+        }
+      else
+        {
+          g_print ("ok\t%s\t%s\tmedian %.3fms -> %.3fms (%+.1f%%)\n",
+                   result->name, result->renderer, base_median, result->median, change);
+        }
     }
 
-  gsk_renderer_unrealize (renderer);
-  g_object_unref (renderer);
+  return n_regressions;
+}
+
+static int
+compare_results (gconstpointer a,
+                 gconstpointer b)
+{
+  const BenchmarkResult *ra = *(const BenchmarkResult **) a;
+  const BenchmarkResult *rb = *(const BenchmarkResult **) b;
+
+  return strcmp (ra->name, rb->name);
+}
+
+static int
+compare_files (gconstpointer a,
+               gconstpointer b)
+{
+  const BenchmarkFile *fa = a;
+  const BenchmarkFile *fb = b;
+
+  return strcmp (fa->name, fb->name);
+}
+
+static void
+add_files (GArray     *files,
+           const char *filename)
+{
+  BenchmarkFile file;
+
+  if (g_file_test (filename, G_FILE_TEST_IS_DIR))
+    {
+      GError *error = NULL;
+      const char *name;
+      GArray *dir_files;
+      GDir *dir;
+
+      dir = g_dir_open (filename, 0, &error);
+      if (dir == NULL)
+        {
+          g_printerr ("%s\n", error->message);
+          exit (1);
+        }
+
+      dir_files = g_array_new (FALSE, FALSE, sizeof (BenchmarkFile));
+      while ((name = g_dir_read_name (dir)))
+        {
+          char *path;
+
+          if (!g_str_has_suffix (name, ".node"))
+            continue;
+
+          /* Files with the same name in different directories
+           * must not end up with the same key in the results.
+           */
+          path = g_build_filename (filename, name, NULL);
+          file.name = path;
+          file.node = load_node_file (path);
+
+          g_array_append_val (dir_files, file);
+        }
+      g_dir_close (dir);
+
+      g_array_sort (dir_files, compare_files);
+      g_array_append_vals (files, dir_files->data, dir_files->len);
+      g_array_free (dir_files, TRUE);
+    }
+  else
+    {
+      file.name = g_strdup (filename);
+      file.node = load_node_file (filename);
+      g_array_append_val (files, file);
+    }
 }
 
 void
@@ -90,18 +477,29 @@ do_benchmark (int          *argc,
   GOptionContext *context;
   char **filenames = NULL;
   char **renderers = NULL;
+  char *json_file = NULL;
+  char *baseline_file = NULL;
   gboolean nodownload = FALSE;
   int runs = 3;
+  int warmup = 0;
+  double threshold = 10;
   const GOptionEntry entries[] = {
     { "renderer", 0, 0, G_OPTION_ARG_STRING_ARRAY, &renderers, N_("Add renderer to benchmark"), N_("RENDERER") },
     { "runs", 0, 0, G_OPTION_ARG_INT, &runs, N_("Number of runs with each renderer"), N_("RUNS") },
+    { "warmup", 0, 0, G_OPTION_ARG_INT, &warmup, N_("Number of unmeasured runs before the measured ones"), N_("RUNS") },
     { "no-download", 0, 0, G_OPTION_ARG_NONE, &nodownload, N_("Don’t download result/wait for GPU to finish"), NULL },
+    { "json", 0, 0, G_OPTION_ARG_FILENAME, &json_file, N_("Write results as JSON to FILE"), N_("FILE") },
+    { "baseline", 0, 0, G_OPTION_ARG_FILENAME, &baseline_file, N_("Compare results to JSON written by an earlier run"), N_("FILE") },
+    { "threshold", 0, 0, G_OPTION_ARG_DOUBLE, &threshold, N_("Percentage by which the median may be slower than the baseline"), N_("PERCENT") },
     { G_OPTION_REMAINING, 0, 0, G_OPTION_ARG_FILENAME_ARRAY, &filenames, NULL, N_("FILE…") },
     { NULL, }
   };
-  GskRenderNode *node;
+  GArray *files;
+  GPtrArray *results;
   GError *error = NULL;
-  gsize i;
+  gboolean print_runs;
+  guint n_regressions = 0;
+  gsize i, j;
 
   if (gdk_display_get_default () == NULL)
     {
@@ -113,7 +511,7 @@ do_benchmark (int          *argc,
   context = g_option_context_new (NULL);
   g_option_context_set_translation_domain (context, GETTEXT_PACKAGE);
   g_option_context_add_main_entries (context, entries, NULL);
-  g_option_context_set_summary (context, _("Benchmark rendering of a .node file."));
+  g_option_context_set_summary (context, _("Benchmark rendering of .node files."));
 
   if (!g_option_context_parse (context, argc, (char ***)argv, &error))
     {
@@ -130,24 +528,88 @@ do_benchmark (int          *argc,
       exit (1);
     }
 
-  if (g_strv_length (filenames) > 1)
+  if (runs < 1 || warmup < 0)
     {
-      g_printerr (_("Can only benchmark a single .node file\n"));
+      g_printerr (_("Invalid number of runs\n"));
       exit (1);
     }
 
   if (renderers == NULL || renderers[0] == NULL)
     renderers = g_strdupv ((char **) (const char *[]) { "gl", "ngl", "vulkan", "cairo", NULL });
-  
-  node = load_node_file (filenames[0]);
+
+  files = g_array_new (FALSE, FALSE, sizeof (BenchmarkFile));
+  g_array_set_clear_func (files, benchmark_file_clear);
+  for (i = 0; filenames[i] != NULL; i++)
+    add_files (files, filenames[i]);
+
+  /* Keep the traditional output when benchmarking a single file */
+  print_runs = files->len == 1 && json_file == NULL;
+
+  results = g_ptr_array_new_with_free_func (g_free);
 
   for (i = 0; renderers[i] != NULL; i++)
     {
-      benchmark_node (node, renderers[i], runs, !nodownload);
+      GskRenderer *renderer;
+
+      renderer = create_renderer (renderers[i], &error);
+      if (renderer == NULL)
+        {
+          g_printerr ("Could not benchmark renderer \"%s\": %s\n", renderers[i], error->message);
+          g_clear_error (&error);
+          continue;
+        }
+
+      for (j = 0; j < files->len; j++)
+        {
+          BenchmarkFile *file = &g_array_index (files, BenchmarkFile, j);
+          BenchmarkResult *result;
+
+          result = g_new0 (BenchmarkResult, 1);
+          result->name = file->name;
+          result->renderer = renderers[i];
+
+          benchmark_node (renderer, file->node, warmup, runs, !nodownload, print_runs, result);
+          print_result (result);
+
+          g_ptr_array_add (results, result);
+        }
+
+      gsk_renderer_unrealize (renderer);
+      g_object_unref (renderer);
+    }
+
+  /* Group results by file for the JSON output */
+  g_ptr_array_sort (results, compare_results);
+
+  if (json_file)
+    {
+      char *json = results_to_json (results);
+
+      if (!g_file_set_contents (json_file, json, -1, &error))
+        {
+          g_printerr (_("Failed to write JSON: %s\n"), error->message);
+          exit (1);
+        }
+
+      g_free (json);
     }
 
-  gsk_render_node_unref (node);
+  if (baseline_file)
+    {
+      GVariant *baseline = load_baseline (baseline_file);
+
+      n_regressions = compare_to_baseline (results, baseline, threshold);
+      g_variant_unref (baseline);
+    }
+
+  g_ptr_array_unref (results);
+  g_array_unref (files);
 
   g_strfreev (filenames);
   g_strfreev (renderers);
+  g_free (json_file);
+  g_free (baseline_file);
+
+  if (n_regressions > 0)
+    exit (1);
 }